@@ -0,0 +1,69 @@
+dnl -------------------------------------------------------- -*- autoconf -*-
+dnl Licensed to the Apache Software Foundation (ASF) under one or more
+dnl contributor license agreements.  See the NOTICE file distributed with
+dnl this work for additional information regarding copyright ownership.
+dnl The ASF licenses this file to You under the Apache License, Version 2.0
+dnl (the "License"); you may not use this file except in compliance with
+dnl the License.  You may obtain a copy of the License at
+dnl
+dnl     http://www.apache.org/licenses/LICENSE-2.0
+dnl
+dnl Unless required by applicable law or agreed to in writing, software
+dnl distributed under the License is distributed on an "AS IS" BASIS,
+dnl WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+dnl See the License for the specific language governing permissions and
+dnl limitations under the License.
+
+dnl
+dnl brotli.m4: Trafficserver's brotli autoconf macros
+dnl
+
+dnl
+dnl TS_CHECK_BROTLI: look for the brotli encoder library and headers
+dnl
+AC_DEFUN([TS_CHECK_BROTLI], [
+enable_brotli=no
+AC_ARG_WITH(brotli, [AC_HELP_STRING([--with-brotli=DIR],[use a specific brotli library])],
+[
+  if test "x$withval" != "xyes" && test "x$withval" != "x"; then
+    brotli_base_dir="$withval"
+  fi
+])
+
+if test "x$brotli_base_dir" = "x"; then
+  AC_MSG_CHECKING([for brotli location])
+  AC_CACHE_VAL(ats_cv_brotli_dir,[
+  for dir in /usr/local /usr ; do
+    if test -d $dir && test -f $dir/include/brotli/encode.h; then
+      ats_cv_brotli_dir=$dir
+      break
+    fi
+  done
+  ])
+  brotli_base_dir=$ats_cv_brotli_dir
+  if test "x$brotli_base_dir" = "x"; then
+    AC_MSG_RESULT([not found])
+  else
+    AC_MSG_RESULT([$brotli_base_dir])
+  fi
+fi
+
+if test "x$brotli_base_dir" != "x" && test "$brotli_base_dir" != "no"; then
+  saved_ldflags=$LDFLAGS
+  saved_cppflags=$CPPFLAGS
+  if test "$brotli_base_dir" != "/usr"; then
+    TS_ADDTO(CPPFLAGS, [-I${brotli_base_dir}/include])
+    TS_ADDTO(LDFLAGS, [-L${brotli_base_dir}/lib])
+    TS_ADDTO_RPATH(${brotli_base_dir}/lib)
+  fi
+  AC_CHECK_LIB([brotlienc], [BrotliEncoderCreateInstance], [
+    AC_CHECK_HEADERS(brotli/encode.h, [enable_brotli=yes])
+  ])
+  if test "$enable_brotli" != "no"; then
+    AC_SUBST(LIBBROTLIENC, [-lbrotlienc])
+  else
+    CPPFLAGS=$saved_cppflags
+    LDFLAGS=$saved_ldflags
+  fi
+fi
+])
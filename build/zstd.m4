@@ -0,0 +1,69 @@
+dnl -------------------------------------------------------- -*- autoconf -*-
+dnl Licensed to the Apache Software Foundation (ASF) under one or more
+dnl contributor license agreements.  See the NOTICE file distributed with
+dnl this work for additional information regarding copyright ownership.
+dnl The ASF licenses this file to You under the Apache License, Version 2.0
+dnl (the "License"); you may not use this file except in compliance with
+dnl the License.  You may obtain a copy of the License at
+dnl
+dnl     http://www.apache.org/licenses/LICENSE-2.0
+dnl
+dnl Unless required by applicable law or agreed to in writing, software
+dnl distributed under the License is distributed on an "AS IS" BASIS,
+dnl WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+dnl See the License for the specific language governing permissions and
+dnl limitations under the License.
+
+dnl
+dnl zstd.m4: Trafficserver's zstd autoconf macros
+dnl
+
+dnl
+dnl TS_CHECK_ZSTD: look for the zstd library and headers
+dnl
+AC_DEFUN([TS_CHECK_ZSTD], [
+enable_zstd=no
+AC_ARG_WITH(zstd, [AC_HELP_STRING([--with-zstd=DIR],[use a specific zstd library])],
+[
+  if test "x$withval" != "xyes" && test "x$withval" != "x"; then
+    zstd_base_dir="$withval"
+  fi
+])
+
+if test "x$zstd_base_dir" = "x"; then
+  AC_MSG_CHECKING([for zstd location])
+  AC_CACHE_VAL(ats_cv_zstd_dir,[
+  for dir in /usr/local /usr ; do
+    if test -d $dir && test -f $dir/include/zstd.h; then
+      ats_cv_zstd_dir=$dir
+      break
+    fi
+  done
+  ])
+  zstd_base_dir=$ats_cv_zstd_dir
+  if test "x$zstd_base_dir" = "x"; then
+    AC_MSG_RESULT([not found])
+  else
+    AC_MSG_RESULT([$zstd_base_dir])
+  fi
+fi
+
+if test "x$zstd_base_dir" != "x" && test "$zstd_base_dir" != "no"; then
+  saved_ldflags=$LDFLAGS
+  saved_cppflags=$CPPFLAGS
+  if test "$zstd_base_dir" != "/usr"; then
+    TS_ADDTO(CPPFLAGS, [-I${zstd_base_dir}/include])
+    TS_ADDTO(LDFLAGS, [-L${zstd_base_dir}/lib])
+    TS_ADDTO_RPATH(${zstd_base_dir}/lib)
+  fi
+  AC_CHECK_LIB([zstd], [ZSTD_compressStream2], [
+    AC_CHECK_HEADERS(zstd.h, [enable_zstd=yes])
+  ])
+  if test "$enable_zstd" != "no"; then
+    AC_SUBST(LIBZSTD, [-lzstd])
+  else
+    CPPFLAGS=$saved_cppflags
+    LDFLAGS=$saved_ldflags
+  fi
+fi
+])
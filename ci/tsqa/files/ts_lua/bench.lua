@@ -0,0 +1,33 @@
+--  Licensed to the Apache Software Foundation (ASF) under one
+--  or more contributor license agreements.  See the NOTICE file
+--  distributed with this work for additional information
+--  regarding copyright ownership.  The ASF licenses this file
+--  to you under the Apache License, Version 2.0 (the
+--  "License"); you may not use this file except in compliance
+--  with the License.  You may obtain a copy of the License at
+--
+--  http://www.apache.org/licenses/LICENSE-2.0
+--
+--  Unless required by applicable law or agreed to in writing, software
+--  distributed under the License is distributed on an "AS IS" BASIS,
+--  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+--  See the License for the specific language governing permissions and
+--  limitations under the License.
+
+-- Used by ci/tsqa/tests/test_ts_lua.py: two hook invocations per transaction, the remap and
+-- the response header hook. With an X-Sleep request header the response hook sleeps first,
+-- so that it resumes from a timer that may fire on another thread.
+
+function send_response()
+    if ts.client_request.header['X-Sleep'] then
+        ts.sleep(1)
+    end
+    ts.client_response.header['X-Lua'] = ts.ctx['path']
+    return 0
+end
+
+function do_remap()
+    ts.ctx['path'] = ts.client_request.get_uri()
+    ts.hook(TS_LUA_HOOK_SEND_RESPONSE_HDR, send_response)
+    return 0
+end
@@ -0,0 +1,204 @@
+'''
+Test and benchmark the ESI parsed document cache
+'''
+#  Licensed to the Apache Software Foundation (ASF) under one
+#  or more contributor license agreements.  See the NOTICE file
+#  distributed with this work for additional information
+#  regarding copyright ownership.  The ASF licenses this file
+#  to you under the Apache License, Version 2.0 (the
+#  "License"); you may not use this file except in compliance
+#  with the License.  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+import os
+import re
+import time
+import logging
+import requests
+import subprocess
+import SocketServer
+
+import helpers
+import tsqa.test_cases
+import tsqa.endpoint
+import tsqa.utils
+
+log = logging.getLogger(__name__)
+
+# templates served by the origin, each including FRAGMENTS fragments
+TEMPLATES = 5
+FRAGMENTS = 10
+# requests per benchmark run
+BENCH_REQUESTS = 500
+
+
+def template(path):
+    '''
+    About 45KB of markup with an include and a variable after every 60 lines
+    '''
+    parts = []
+    for k in xrange(FRAGMENTS):
+        parts.extend('<p>static {0}.{1} of {2}: the quick brown fox jumps over the lazy dog</p>\n'.format(k, i, path)
+                     for i in xrange(60))
+        parts.append('<esi:include src="http://esi.test/frag/{0}"/>\n'.format(k))
+        parts.append('<!--esi <esi:vars>$(QUERY_STRING{v})</esi:vars> -->\n')
+    return ''.join(parts)
+
+
+def fragment(path):
+    return ''.join('<li>fragment {0} item {1}</li>\n'.format(path, i) for i in xrange(80))
+
+
+def expected(path, v):
+    '''
+    What ATS makes of template(path) when requested with ?v=<v>
+    '''
+    body = re.sub(r'<esi:include src="http://esi.test(/frag/\d+)"/>', lambda m: fragment(m.group(1)), template(path))
+    return body.replace('<!--esi <esi:vars>$(QUERY_STRING{v})</esi:vars> -->', v + ' ')
+
+
+class EsiOriginHandler(SocketServer.BaseRequestHandler):
+    """
+    Origin stand-in serving ESI templates under /tmpl/ and fragments under /frag/, one request per connection
+    """
+
+    def handle(self):
+        data = ''
+        while '\r\n\r\n' not in data:
+            buf = self.request.recv(4096)
+            if not buf:
+                return
+            data += buf
+
+        path = data.split('\r\n')[0].split(' ')[1].split('?')[0]
+        if path.startswith('/tmpl/'):
+            body = template(path)
+            extra = 'X-Esi: 1\r\nETag: "{0}-v1"\r\n'.format(path)
+        else:
+            body = fragment(path)
+            extra = ''
+
+        resp = ('HTTP/1.1 200 OK\r\n'
+                'Content-Type: text/html\r\n'
+                'Content-Length: {0}\r\n'
+                'Last-Modified: Sat, 17 Oct 2015 10:00:00 GMT\r\n'
+                'Cache-Control: max-age=3600\r\n'
+                '{1}'
+                'Connection: close\r\n'
+                '\r\n'.format(len(body), extra))
+        self.request.sendall(resp + body)
+
+
+class TestEsiParsedDocCache(helpers.EnvironmentCase):
+    '''
+    Tests that documents assembled from the parsed document cache match the ones assembled from a
+    fresh parse, and compares the request rates of both.
+    '''
+    @classmethod
+    def setUpEnv(cls, env):
+        cls.socket_server = tsqa.endpoint.SocketServerDaemon(EsiOriginHandler)
+        cls.socket_server.start()
+        cls.socket_server.ready.wait()
+
+        # the includes
+        cls.configs['remap.config'].add_line('map http://esi.test/ http://127.0.0.1:{0}/'.format(cls.socket_server.port))
+        cls.configs['remap.config'].add_line(
+            'map http://cache.esi.test/ http://127.0.0.1:{0}/ @plugin=esi.so'.format(cls.socket_server.port)
+        )
+        cls.configs['remap.config'].add_line(
+            'map http://nocache.esi.test/ http://127.0.0.1:{0}/ @plugin=esi.so @pparam=--parsed-doc-cache-size=0'.format(
+                cls.socket_server.port)
+        )
+
+        cls.configs['records.config']['CONFIG'].update({
+            'proxy.config.http.wait_for_cache': 1,
+        })
+
+    def _url(self, path, v):
+        return 'http://127.0.0.1:{0}{1}?v={2}'.format(
+            self.configs['records.config']['CONFIG']['proxy.config.http.server_ports'],
+            path,
+            v
+        )
+
+    def _fetch(self, session, host, path, v):
+        ret = session.get(self._url(path, v), headers={'Host': host})
+        self.assertEqual(ret.status_code, 200)
+        return ret.content
+
+    def _ctl(self, *args):
+        cmd = [os.path.join(self.environment.layout.bindir, 'traffic_ctl')] + list(args)
+        out, _ = tsqa.utils.run_sync_command(
+            cmd,
+            env=self.environment.shell_env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT
+        )
+        return out
+
+    def _parsed_doc_hits(self):
+        # the metric is unknown until traffic_server first syncs its metrics
+        for _ in xrange(30):
+            try:
+                # prints "esi.n_parsed_doc_hits <count>"
+                return int(self._ctl('metric', 'get', 'esi.n_parsed_doc_hits').split()[1])
+            except Exception:
+                time.sleep(1)
+
+        self.fail('Failed to get the number of parsed document hits')
+
+    def _settled_parsed_doc_hits(self):
+        # the metrics take a few seconds to get from traffic_server to traffic_ctl, wait until the
+        # count stays put long enough that earlier requests are accounted for
+        hits, since = self._parsed_doc_hits(), time.time()
+        for _ in xrange(60):
+            time.sleep(1)
+            last, hits = hits, self._parsed_doc_hits()
+            if hits != last:
+                since = time.time()
+            elif time.time() - since > 12:
+                break
+        return hits
+
+    def _bench(self, host):
+        '''
+        Returns the requests per second of BENCH_REQUESTS keep-alive requests to host
+        '''
+        session = requests.Session()
+        begin = time.time()
+        for i in xrange(BENCH_REQUESTS):
+            path = '/tmpl/{0}'.format(i % TEMPLATES)
+            v = 'q{0}'.format(i % 4)
+            self.assertEqual(self._fetch(session, host, path, v), expected(path, v), msg='{0}{1}?v={2}'.format(host, path, v))
+        return BENCH_REQUESTS / (time.time() - begin)
+
+    def test_output_matches(self):
+        '''Test that cached and freshly parsed documents are assembled the same'''
+        session = requests.Session()
+        for n in xrange(TEMPLATES):
+            path = '/tmpl/{0}'.format(n)
+            for v in ('a', 'b'):
+                body = self._fetch(session, 'cache.esi.test', path, v)
+                self.assertEqual(body, expected(path, v))
+                self.assertEqual(body, self._fetch(session, 'nocache.esi.test', path, v))
+
+    def test_benchmark(self):
+        '''Compare the request rates with and without the parsed document cache'''
+        self._settled_parsed_doc_hits()
+
+        # fill the HTTP cache, and the parsed document cache
+        self._bench('nocache.esi.test')
+        self._bench('cache.esi.test')
+        hits = self._settled_parsed_doc_hits()
+
+        nocache = self._bench('nocache.esi.test')
+        cache = self._bench('cache.esi.test')
+        log.info('parsed document cache: {0:.1f} req/s, without: {1:.1f} req/s'.format(cache, nocache))
+
+        # every request of the second run was served from the parsed document cache
+        self.assertEqual(self._settled_parsed_doc_hits(), hits + BENCH_REQUESTS)
@@ -0,0 +1,227 @@
+'''
+Test the mp4 plugin
+'''
+
+#  Licensed to the Apache Software Foundation (ASF) under one
+#  or more contributor license agreements.  See the NOTICE file
+#  distributed with this work for additional information
+#  regarding copyright ownership.  The ASF licenses this file
+#  to you under the Apache License, Version 2.0 (the
+#  "License"); you may not use this file except in compliance
+#  with the License.  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+import os
+import time
+import logging
+import random
+import struct
+import requests
+import subprocess
+import SocketServer
+
+import helpers
+import tsqa.test_cases
+import tsqa.endpoint
+import tsqa.utils
+
+log = logging.getLogger(__name__)
+
+
+def _atom(name, body):
+    return struct.pack('>I', 8 + len(body)) + name + body
+
+
+def _full_atom(name, body):
+    return _atom(name, '\0\0\0\0' + body)
+
+
+def make_mp4(co64=False, seed=0):
+    '''
+    A 10s file with one video trak: 25 samples a second, a key frame every second, composition
+    offsets, 5 samples a chunk for the first 4s and 3 samples a chunk after, and random data as
+    samples.
+    '''
+    rnd = random.Random(seed)
+    timescale, delta, samples = 2500, 100, 250
+    sizes = [rnd.randint(200, 2000) for _ in xrange(samples)]
+    chunks = [range(i, i + 5) for i in xrange(0, 100, 5)] + [range(i, min(i + 3, samples)) for i in xrange(100, samples, 3)]
+    keys = range(1, samples + 1, 25)
+    # (count, offset) runs, of lengths that do not line up with the key frames
+    ctts_runs = [(n, rnd.randint(0, 4) * delta) for n in [7, 11, 13] * 7]
+    ctts_runs.append((samples - sum(n for n, _ in ctts_runs), 0))
+
+    def moov(offsets):
+        stsd = _full_atom('stsd', struct.pack('>I', 1) + _atom('avc1', '\0' * 20))
+        stts = _full_atom('stts', struct.pack('>IIIII', 2, 100, delta, samples - 100, delta))
+        stss = _full_atom('stss', struct.pack('>I', len(keys)) + ''.join(struct.pack('>I', k) for k in keys))
+        ctts = _full_atom('ctts', struct.pack('>I', len(ctts_runs)) + ''.join(struct.pack('>II', n, o) for n, o in ctts_runs))
+        stsc = _full_atom('stsc', struct.pack('>IIIIIII', 2, 1, 5, 1, 21, 3, 1))
+        stsz = _full_atom('stsz', struct.pack('>II', 0, samples) + ''.join(struct.pack('>I', s) for s in sizes))
+        if co64:
+            stco = _full_atom('co64', struct.pack('>I', len(offsets)) + ''.join(struct.pack('>Q', o) for o in offsets))
+        else:
+            stco = _full_atom('stco', struct.pack('>I', len(offsets)) + ''.join(struct.pack('>I', o) for o in offsets))
+        stbl = _atom('stbl', stsd + stts + stss + ctts + stsc + stsz + stco)
+        dinf = _atom('dinf', _full_atom('dref', struct.pack('>I', 1) + _full_atom('url ', '')))
+        minf = _atom('minf', _full_atom('vmhd', '\0' * 8) + dinf + stbl)
+        mdhd = _full_atom('mdhd', struct.pack('>IIII', 0, 0, timescale, samples * delta) + '\0' * 4)
+        hdlr = _full_atom('hdlr', '\0' * 4 + 'vide' + '\0' * 12 + 'v\0')
+        tkhd = _full_atom('tkhd', struct.pack('>IIIII', 0, 0, 1, 0, 10000) + '\0' * 60)
+        trak = _atom('trak', tkhd + _atom('mdia', mdhd + hdlr + minf))
+        mvhd = _full_atom('mvhd', struct.pack('>IIII', 0, 0, 1000, 10000) + '\0' * 80)
+        return _atom('moov', mvhd + trak)
+
+    ftyp = _atom('ftyp', 'isom\0\0\2\0isomavc1')
+    pos = len(ftyp) + len(moov([0] * len(chunks))) + 8
+    offsets = []
+    for chunk in chunks:
+        offsets.append(pos)
+        pos += sum(sizes[s] for s in chunk)
+
+    data = ''.join(chr(rnd.randint(0, 255)) for _ in xrange(sum(sizes)))
+    return ftyp + moov(offsets) + _atom('mdat', data)
+
+
+files = {
+    '/stco.mp4': make_mp4(),
+    '/co64.mp4': make_mp4(co64=True, seed=1),
+}
+
+# the request headers of every request the origin served
+origin_requests = []
+
+
+class Mp4ServerHandler(SocketServer.BaseRequestHandler):
+    """
+    Serves the files, one request per connection
+    """
+
+    def handle(self):
+        data = ''
+        while '\r\n\r\n' not in data:
+            buf = self.request.recv(4096)
+            if not buf:
+                return
+            data += buf
+
+        lines = data.split('\r\n\r\n')[0].split('\r\n')
+        path = lines[0].split(' ')[1].split('?')[0]
+        headers = dict((k.strip().lower(), v.strip()) for k, v in (l.split(':', 1) for l in lines[1:]))
+        origin_requests.append(headers)
+
+        body = files[path]
+        resp = ('HTTP/1.1 200 OK\r\n'
+                'Content-Length: {0}\r\n'
+                'Cache-Control: max-age=3600\r\n'
+                'ETag: "{1}"\r\n'
+                'Connection: close\r\n'
+                '\r\n'.format(len(body), path))
+        self.request.sendall(resp + body)
+
+
+class TestMp4Index(helpers.EnvironmentCase):
+    '''
+    Tests that seeks into cached files are served from the index of the file, and that the index
+    serves the same bytes as a parse of the whole file.
+    '''
+    @classmethod
+    def setUpEnv(cls, env):
+        cls.socket_server = tsqa.endpoint.SocketServerDaemon(Mp4ServerHandler)
+        cls.socket_server.start()
+        cls.socket_server.ready.wait()
+
+        cls.configs['remap.config'].add_line(
+            'map /index/ http://127.0.0.1:{0}/ @plugin=mp4.so'.format(cls.socket_server.port)
+        )
+        cls.configs['remap.config'].add_line(
+            'map /noindex/ http://127.0.0.1:{0}/ @plugin=mp4.so @pparam=--index-cache-size=0'.format(cls.socket_server.port)
+        )
+
+        cls.configs['records.config']['CONFIG'].update({
+            'proxy.config.http.wait_for_cache': 1,
+            'proxy.config.diags.debug.enabled': 1,
+            'proxy.config.diags.debug.tags': 'ts_mp4',
+        })
+
+    def _fetch(self, path, start):
+        url = 'http://127.0.0.1:{0}{1}?start={2}'.format(
+            self.configs['records.config']['CONFIG']['proxy.config.http.server_ports'],
+            path,
+            start
+        )
+        ret = requests.get(url)
+        self.assertEqual(ret.status_code, 200)
+        self.assertEqual(int(ret.headers['content-length']), len(ret.content))
+        return ret.content
+
+    def _ctl(self, *args):
+        cmd = [os.path.join(self.environment.layout.bindir, 'traffic_ctl')] + list(args)
+        out, _ = tsqa.utils.run_sync_command(
+            cmd,
+            env=self.environment.shell_env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT
+        )
+        return out
+
+    def _index_hits(self):
+        # the metric is unknown until traffic_server first syncs its metrics
+        for _ in xrange(30):
+            try:
+                # prints "mp4.index_hits <count>"
+                return int(self._ctl('metric', 'get', 'mp4.index_hits').split()[1])
+            except Exception:
+                time.sleep(1)
+
+        self.fail('Failed to get the number of index hits')
+
+    def _wait_index_hits(self, hits):
+        # the metrics are synced once a while
+        for _ in xrange(30):
+            if self._index_hits() >= hits:
+                break
+            time.sleep(1)
+
+        self.assertEqual(self._index_hits(), hits)
+
+    def test_index_seek(self):
+        '''Test that seeks served from the index match seeks parsed from the whole file'''
+        hits = self._index_hits()
+
+        for name in ('/stco.mp4', '/co64.mp4'):
+            # fill the cache, the first fetch through /index/ also indexes the file
+            self._fetch('/index' + name, 1)
+            self._fetch('/noindex' + name, 1)
+            requests_before = len(origin_requests)
+
+            for start in (0.5, 1, 2.3, 4.04, 5.2, 6, 7.5, 9.99):
+                body = self._fetch('/index' + name, start)
+                self.assertEqual(body, self._fetch('/noindex' + name, start), msg='{0} start={1}'.format(name, start))
+                self.assertTrue(body.startswith(files[name][:8]))
+                hits += 1
+
+            # the files were served from the cache only
+            self.assertEqual(len(origin_requests), requests_before)
+
+        self._wait_index_hits(hits)
+
+    def test_range_not_forwarded(self):
+        '''Test that the Range header added for the cache read never reaches the origin'''
+        self._fetch('/index/stco.mp4', 3)
+        self._fetch('/index/stco.mp4', 6)
+
+        for headers in origin_requests:
+            self.assertNotIn('range', headers)
+
+    def test_start_out_of_range(self):
+        '''Test that a start beyond the end of the file is served the same from the index'''
+        self._fetch('/index/co64.mp4', 1)
+        body = self._fetch('/index/co64.mp4', 20)
+        self.assertEqual(body, self._fetch('/noindex/co64.mp4', 20))
+        self.assertTrue(len(body) < len(files['/co64.mp4']))
@@ -0,0 +1,143 @@
+'''
+Test TLS reconnect storms with the SSL handshake offloaded to ET_SSL_HANDSHAKE threads
+'''
+#  Licensed to the Apache Software Foundation (ASF) under one
+#  or more contributor license agreements.  See the NOTICE file
+#  distributed with this work for additional information
+#  regarding copyright ownership.  The ASF licenses this file
+#  to you under the Apache License, Version 2.0 (the
+#  "License"); you may not use this file except in compliance
+#  with the License.  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+from OpenSSL import SSL
+import socket
+import struct
+import threading
+import logging
+
+import helpers
+import tsqa.test_cases
+import tsqa.utils
+unittest = tsqa.utils.import_unittest()
+
+log = logging.getLogger(__name__)
+
+# number of connections per storm, and how many clients hammer at once
+STORM_CONNECTIONS = 500
+STORM_CLIENTS = 32
+
+
+class TestSSLHandshakeOffload(tsqa.test_cases.DynamicHTTPEndpointCase, helpers.EnvironmentCase):
+    @classmethod
+    def setUpEnv(cls, env):
+        def hello(request):
+            return 'hello'
+        cls.http_endpoint.add_handler('/storm/', hello)
+
+        cls.configs['remap.config'].add_line('map /storm/ http://127.0.0.1:{0}/storm/'.format(cls.http_endpoint.address[1]))
+
+        # add an SSL port to ATS
+        cls.ssl_port = tsqa.utils.bind_unused_port()[1]
+        cls.configs['records.config']['CONFIG']['proxy.config.http.server_ports'] += ' {0}:ssl'.format(cls.ssl_port)
+        cls.configs['records.config']['CONFIG'].update({
+            'proxy.config.ssl.handshake_offload.threads': 2,
+            'proxy.config.http.keep_alive_enabled_in': 0,
+        })
+
+        cls.configs['ssl_multicert.config'].add_line('dest_ip=* ssl_cert_name={0}'.format(
+            helpers.tests_file_path('rsa_keys/www.example.com.pem'),
+        ))
+
+    def _storm(self, fn, count=STORM_CONNECTIONS, clients=STORM_CLIENTS):
+        '''
+        Run fn(i) for i in range(count) from `clients` threads, return the results
+        '''
+        results = [None] * count
+        lock = threading.Lock()
+        todo = iter(range(count))
+
+        def worker():
+            while True:
+                with lock:
+                    i = next(todo, None)
+                if i is None:
+                    return
+                try:
+                    results[i] = fn(i)
+                except Exception as e:
+                    log.warning('connection {0} failed: {1}'.format(i, e))
+                    results[i] = False
+
+        threads = [threading.Thread(target=worker) for _ in range(clients)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        return results
+
+    def _fetch(self, i):
+        '''
+        Full handshake, one request, then the server closes the connection
+        '''
+        ctx = SSL.Context(SSL.TLSv1_2_METHOD)
+        sock = SSL.Connection(ctx, socket.socket(socket.AF_INET, socket.SOCK_STREAM))
+        sock.settimeout(10)
+        sock.connect(('127.0.0.1', self.ssl_port))
+        sock.do_handshake()
+        sock.sendall('GET /storm/{0} HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n'.format(i))
+        data = ''
+        while True:
+            try:
+                buf = sock.recv(4096)
+            except (SSL.ZeroReturnError, SSL.SysCallError):
+                break
+            if not buf:
+                break
+            data += buf
+        sock.close()
+        return data.startswith('HTTP/1.1 200') and data.endswith('hello')
+
+    def _abandon(self, i):
+        '''
+        Send a ClientHello and reset the connection while the handshake is still in flight
+        '''
+        ctx = SSL.Context(SSL.TLSv1_2_METHOD)
+        raw = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        raw.connect(('127.0.0.1', self.ssl_port))
+        sock = SSL.Connection(ctx, raw)
+        sock.set_connect_state()
+        raw.setblocking(0)
+        try:
+            sock.do_handshake()
+        except SSL.WantReadError:
+            pass
+        raw.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack('ii', 1, 0))
+        raw.close()
+        return True
+
+    def test_reconnect_storm(self):
+        '''
+        Every connection in a reconnect storm completes the handshake and gets its response
+        '''
+        results = self._storm(self._fetch)
+        self.assertEqual(results.count(True), STORM_CONNECTIONS)
+
+    def test_abandoned_handshakes(self):
+        '''
+        Clients that go away mid-handshake free their VCs while the offload is
+        queued or running; the server must keep serving afterwards
+        '''
+        results = self._storm(lambda i: self._abandon(i) if i % 2 else self._fetch(i))
+        self.assertEqual(results.count(True), STORM_CONNECTIONS)
+
+        # make sure it is still alive
+        results = self._storm(self._fetch, count=50)
+        self.assertEqual(results.count(True), 50)
@@ -0,0 +1,171 @@
+'''
+Test and benchmark ts_lua hook invocations
+'''
+#  Licensed to the Apache Software Foundation (ASF) under one
+#  or more contributor license agreements.  See the NOTICE file
+#  distributed with this work for additional information
+#  regarding copyright ownership.  The ASF licenses this file
+#  to you under the Apache License, Version 2.0 (the
+#  "License"); you may not use this file except in compliance
+#  with the License.  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+import os
+import re
+import time
+import logging
+import requests
+import threading
+import SocketServer
+
+import helpers
+import tsqa.test_cases
+import tsqa.endpoint
+import tsqa.utils
+
+log = logging.getLogger(__name__)
+
+# requests per benchmark run, each one invokes two hooks
+BENCH_REQUESTS = 2000
+# requests, and clients sending them, whose response hook resumes from a timer
+SLEEP_REQUESTS = 64
+SLEEP_CLIENTS = 16
+
+# what ts_lua reports under the ts_lua_bench debug tag, every 1000 invocations per vm
+BENCH_RE = re.compile(r'\(ts_lua_bench\) vm (0x[0-9a-f]+): (\d+) hook invocations, (\d+) ns per invocation')
+
+
+class OriginHandler(SocketServer.BaseRequestHandler):
+    """
+    Cacheable hello, one request per connection
+    """
+
+    def handle(self):
+        data = ''
+        while '\r\n\r\n' not in data:
+            buf = self.request.recv(4096)
+            if not buf:
+                return
+            data += buf
+
+        self.request.sendall('HTTP/1.1 200 OK\r\n'
+                             'Content-Length: 5\r\n'
+                             'Cache-Control: max-age=3600\r\n'
+                             'Connection: close\r\n'
+                             '\r\n'
+                             'hello')
+
+
+class TestTsLua(helpers.EnvironmentCase):
+    '''
+    Tests that transactions see their own lua context when hooks run on several threads, and
+    measures what a hook invocation costs.
+    '''
+    @classmethod
+    def setUpEnv(cls, env):
+        cls.socket_server = tsqa.endpoint.SocketServerDaemon(OriginHandler)
+        cls.socket_server.start()
+        cls.socket_server.ready.wait()
+
+        cls.configs['remap.config'].add_line('map /lua/ http://127.0.0.1:{0}/ @plugin=tslua.so @pparam={1}'.format(
+            cls.socket_server.port,
+            helpers.tests_file_path('ts_lua/bench.lua'),
+        ))
+        cls.configs['remap.config'].add_line('map /nolua/ http://127.0.0.1:{0}/'.format(cls.socket_server.port))
+
+        cls.configs['records.config']['CONFIG'].update({
+            # several threads, so that resumed hooks can end up on another thread than their vm
+            'proxy.config.exec_thread.autoconfig': 0,
+            'proxy.config.exec_thread.limit': 4,
+            'proxy.config.diags.debug.enabled': 1,
+            'proxy.config.diags.debug.tags': 'ts_lua_bench',
+            'proxy.config.diags.output.diag': 'L',
+        })
+
+    def _url(self, path):
+        return 'http://127.0.0.1:{0}{1}'.format(self.configs['records.config']['CONFIG']['proxy.config.http.server_ports'], path)
+
+    def _fetch(self, session, path, headers=None):
+        ret = session.get(self._url(path), headers=headers)
+        self.assertEqual(ret.status_code, 200)
+        self.assertEqual(ret.content, 'hello')
+        return ret
+
+    def _diags_log(self):
+        return os.path.join(self.environment.layout.logdir, 'diags.log')
+
+    def _bench(self, prefix):
+        '''
+        Returns the wall clock time per request of BENCH_REQUESTS keep-alive requests
+        '''
+        session = requests.Session()
+        begin = time.time()
+        for i in xrange(BENCH_REQUESTS):
+            ret = self._fetch(session, '{0}{1}'.format(prefix, i % 10))
+            if prefix == '/lua/':
+                self.assertEqual(ret.headers['x-lua'], '{0}{1}'.format(prefix, i % 10))
+        return (time.time() - begin) / BENCH_REQUESTS
+
+    def test_resumed_hooks(self):
+        '''Test that hooks resumed from a timer on any thread see their own transaction'''
+        results = [None] * SLEEP_REQUESTS
+        lock = threading.Lock()
+        todo = iter(xrange(SLEEP_REQUESTS))
+
+        def worker():
+            session = requests.Session()
+            while True:
+                with lock:
+                    i = next(todo, None)
+                if i is None:
+                    return
+                ret = self._fetch(session, '/lua/sleep{0}'.format(i), headers={'X-Sleep': '1'})
+                results[i] = ret.headers.get('x-lua')
+
+        threads = [threading.Thread(target=worker) for _ in xrange(SLEEP_CLIENTS)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        self.assertEqual(results, ['/lua/sleep{0}'.format(i) for i in xrange(SLEEP_REQUESTS)])
+
+    def test_benchmark(self):
+        '''Measure the time spent per hook invocation, and the added time per request'''
+        # fill the cache
+        session = requests.Session()
+        for i in xrange(10):
+            self._fetch(session, '/lua/{0}'.format(i))
+            self._fetch(session, '/nolua/{0}'.format(i))
+
+        with open(self._diags_log()) as f:
+            f.seek(0, os.SEEK_END)
+            offset = f.tell()
+
+        lua = self._bench('/lua/')
+        nolua = self._bench('/nolua/')
+        log.info('per request: {0:.1f} us with two lua hooks, {1:.1f} us without'.format(lua * 1e6, nolua * 1e6))
+
+        # diags.log is flushed as it is written, give the last lines a moment anyway
+        time.sleep(1)
+        with open(self._diags_log()) as f:
+            f.seek(offset)
+            reports = BENCH_RE.findall(f.read())
+
+        # the report with the most invocations of each vm counts
+        vms = {}
+        for vm, calls, ns in reports:
+            if int(calls) > vms.get(vm, (0, 0))[0]:
+                vms[vm] = (int(calls), int(ns))
+        self.assertTrue(vms, msg='no ts_lua_bench reports in diags.log')
+
+        calls = sum(c for c, _ in vms.values())
+        ns = sum(c * n for c, n in vms.values()) / calls
+        log.info('ts_lua_bench: {0} ns per hook invocation, over {1} invocations in {2} vms'.format(ns, calls, len(vms)))
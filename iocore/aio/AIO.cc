@@ -187,6 +187,7 @@ struct AIOThreadInfo : public Continuation {
   {
     (void)event;
     (void)e;
+    eventProcessor.bind_to_numa_node(req->numa_node);
     aio_thread_main(this);
     return EVENT_DONE;
   }
@@ -230,12 +231,14 @@ aio_init_fildes(int fildes, int fromAPI = 0)
   if (fromAPI) {
     request->index = 0;
     request->filedes = -1;
+    request->numa_node = -1;
     aio_reqs[0] = request;
     thread_is_created = 1;
     thread_num = api_config_threads_per_disk;
   } else {
     request->index = num_filedes;
     request->filedes = fildes;
+    request->numa_node = eventProcessor.numa_node_of_fd(fildes);
     aio_reqs[num_filedes] = request;
     thread_num = cache_config_threads_per_disk;
   }
@@ -499,7 +502,7 @@ aio_thread_main(void *arg)
         if (!op->action.cancelled)
           op->action.continuation->handleEvent(AIO_EVENT_DONE, op);
       } else if (op->thread == AIO_CALLBACK_THREAD_ANY)
-        eventProcessor.schedule_imm_signal(op);
+        eventProcessor.assign_thread_on_node(current_req->numa_node)->schedule_imm_signal(op);
       else
         op->thread->schedule_imm_signal(op);
       ink_mutex_acquire(&my_aio_req->aio_mutex);
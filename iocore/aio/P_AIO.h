@@ -131,6 +131,7 @@ struct AIO_Reqs {
   volatile int queued;  /* total number of aio_todo and http_todo requests */
   volatile int filedes; /* the file descriptor for the requests */
   volatile int requests_queued;
+  int numa_node; /* NUMA node of the disk, -1 if unknown */
 };
 
 #endif // AIO_MODE == AIO_MODE_NATIVE
@@ -73,6 +73,10 @@ int64_t cache_config_ram_cache_cutoff = AGG_SIZE;
 int cache_config_max_disk_errors = 5;
 int cache_config_hit_evacuate_percent = 10;
 int cache_config_hit_evacuate_size_limit = 0;
+int cache_config_admission_threshold = 2;
+bool cache_admission_forced = false; // some volume has admission=on
+int cache_config_tier_promote_threshold = 3;
+int cache_config_tier_demote = 1;
 int cache_config_force_sector_size = 0;
 int cache_config_target_fragment_size = DEFAULT_TARGET_FRAGMENT_SIZE;
 int cache_config_agg_write_backlog = AGG_SIZE * 2;
@@ -93,6 +97,7 @@ int cache_config_compatibility_4_2_0_fixup = 1;
 // Globals
 
 RecRawStatBlock *cache_rsb = NULL;
+RecRawHistogramBlock *cache_rhb = NULL;
 Cache *theStreamCache = 0;
 Cache *theCache = 0;
 CacheDisk **gdisks = NULL;
@@ -1372,6 +1377,8 @@ Vol::init(char *s, off_t blocks, off_t dir_skip, bool clear)
   vol_init_data(this);
   data_blocks = (len - (start - skip)) / STORE_BLOCK_SIZE;
   hit_evacuate_window = (data_blocks * cache_config_hit_evacuate_percent) / 100;
+  admission.init(vol_direntries(this));
+  tier_hits.init(vol_direntries(this));
 
   evacuate_size = (int)(len / EVACUATION_BUCKET_SIZE) + 2;
   int evac_len = (int)evacuate_size * sizeof(DLL<EvacuationBlock>);
@@ -2120,6 +2127,15 @@ Cache::open_done()
   hosttable = new CacheHostTable(this, scheme);
   hosttable->register_config_callback(&hosttable);
 
+  if (scheme == CACHE_HTTP_TYPE) {
+    CacheHostRecord *rec = new CacheHostRecord();
+    if (rec->Init(scheme, true) == 0) {
+      Note("cache tiering enabled: %d fast tier volumes", rec->num_cachevols);
+      tier_host_rec = rec;
+    } else
+      delete rec;
+  }
+
   if (hosttable->gen_host_rec.num_cachevols == 0)
     ready = CACHE_INIT_FAILED;
   else
@@ -2630,6 +2646,7 @@ Cache::remove(Continuation *cont, const CacheKey *key, CacheFragType type, const
   CACHE_TRY_LOCK(lock, cont->mutex, this_ethread());
   ink_assert(lock.is_locked());
   Vol *vol = key_to_vol(key, hostname, host_len);
+  tier_invalidate(key);
   // coverity[var_decl]
   Dir result;
   dir_clear(&result); // initialized here, set result empty so we can recognize missed lock
@@ -2807,6 +2824,7 @@ cplist_reconfigure()
   ConfigVol *config_vol;
 
   gnvol = 0;
+  cache_admission_forced = false;
   if (config_volumes.num_volumes == 0) {
     /* only the http cache */
     CacheVol *cp = new CacheVol();
@@ -3008,6 +3026,15 @@ cplist_reconfigure()
       }
       gnvol += cp->num_vols;
     }
+
+    for (config_vol = config_volumes.cp_queue.head; config_vol; config_vol = config_vol->link.next) {
+      if (config_vol->cachep) {
+        config_vol->cachep->fast_tier = config_vol->fast_tier;
+        config_vol->cachep->admission = config_vol->admission;
+        if (config_vol->admission == CACHE_ADMISSION_ON)
+          cache_admission_forced = true;
+      }
+    }
   }
   return 0;
 }
@@ -3080,6 +3107,8 @@ void
 rebuild_host_table(Cache *cache)
 {
   build_vol_hash_table(&cache->hosttable->gen_host_rec);
+  if (cache->tier_host_rec)
+    build_vol_hash_table(cache->tier_host_rec);
   if (cache->hosttable->m_numEntries != 0) {
     CacheHostMatcher *hm = cache->hosttable->getHostMatcher();
     CacheHostRecord *h_rec = hm->getDataArray();
@@ -3185,6 +3214,15 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("hdr_marshal_bytes", cache_hdr_marshal_bytes_stat);
   REG_INT("gc_bytes_evacuated", cache_gc_bytes_evacuated_stat);
   REG_INT("gc_frags_evacuated", cache_gc_frags_evacuated_stat);
+  REG_INT("evacuate.batch_reads", cache_evacuate_batch_reads_stat);
+  REG_INT("evacuate.read_bytes", cache_evacuate_read_bytes_stat);
+  REG_INT("evacuate.deferred_writes", cache_evacuate_deferred_writes_stat);
+  REG_INT("admission.admitted", cache_admission_admitted_stat);
+  REG_INT("admission.rejected", cache_admission_rejected_stat);
+  REG_INT("tier.fast.hits", cache_tier_fast_hits_stat);
+  REG_INT("tier.slow.hits", cache_tier_slow_hits_stat);
+  REG_INT("tier.promotions", cache_tier_promotions_stat);
+  REG_INT("tier.demotions", cache_tier_demotions_stat);
   REG_INT("wrap_count", cache_directory_wrap_stat);
   REG_INT("sync.count", cache_directory_sync_count_stat);
   REG_INT("sync.bytes", cache_directory_sync_bytes_stat);
@@ -3198,6 +3236,7 @@ ink_cache_init(ModuleVersion v)
   ink_release_assert(!checkModuleVersion(v, CACHE_MODULE_VERSION));
 
   cache_rsb = RecAllocateRawStatBlock((int)cache_stat_count);
+  cache_rhb = RecAllocateRawHistogramBlock((int)cache_histogram_count);
 
   REC_EstablishStaticConfigInteger(cache_config_ram_cache_size, "proxy.config.cache.ram_cache.size");
   Debug("cache_init", "proxy.config.cache.ram_cache.size = %" PRId64 " = %" PRId64 "Mb", cache_config_ram_cache_size,
@@ -3243,6 +3282,15 @@ ink_cache_init(ModuleVersion v)
   REC_EstablishStaticConfigInt32(cache_config_hit_evacuate_size_limit, "proxy.config.cache.hit_evacuate_size_limit");
   Debug("cache_init", "proxy.config.cache.hit_evacuate_size_limit = %d", cache_config_hit_evacuate_size_limit);
 
+  REC_EstablishStaticConfigInt32(cache_config_admission_threshold, "proxy.config.cache.admission.threshold");
+  Debug("cache_init", "proxy.config.cache.admission.threshold = %d", cache_config_admission_threshold);
+
+  REC_EstablishStaticConfigInt32(cache_config_tier_promote_threshold, "proxy.config.cache.tier.promote_threshold");
+  Debug("cache_init", "proxy.config.cache.tier.promote_threshold = %d", cache_config_tier_promote_threshold);
+
+  REC_EstablishStaticConfigInt32(cache_config_tier_demote, "proxy.config.cache.tier.demote");
+  Debug("cache_init", "proxy.config.cache.tier.demote = %d", cache_config_tier_demote);
+
   REC_EstablishStaticConfigInt32(cache_config_force_sector_size, "proxy.config.cache.force_sector_size");
   REC_EstablishStaticConfigInt32(cache_config_target_fragment_size, "proxy.config.cache.target_fragment_size");
 
@@ -3274,6 +3322,10 @@ ink_cache_init(ModuleVersion v)
   Debug("cache_init", "proxy.config.cache.enable_read_while_writer = %d", cache_config_read_while_writer);
 
   register_cache_stats(cache_rsb, "proxy.process.cache");
+  RecRegisterRawHistogram(cache_rhb, RECT_PROCESS, "proxy.process.cache.tier.fast.read_latency",
+                          (int)cache_tier_fast_read_histogram);
+  RecRegisterRawHistogram(cache_rhb, RECT_PROCESS, "proxy.process.cache.tier.slow.read_latency",
+                          (int)cache_tier_slow_read_histogram);
 
   REC_ReadConfigInteger(cacheProcessor.wait_for_cache, "proxy.config.http.wait_for_cache");
 
@@ -3318,6 +3370,34 @@ CacheProcessor::open_write(Continuation *cont, int expected_size, const HttpCach
   return caches[type]->open_write(cont, &key->hash, old_info, pin_in_cache, NULL /* key1 */, type, key->hostname, key->hostlen);
 }
 
+//----------------------------------------------------------------------------
+// Consult the admission filter of the volume the document maps to. This
+// is always local, as the filter only has to see the requests which reach
+// this cache. The admission= setting of the volume overrides filter.
+bool
+CacheProcessor::admit(const HttpCacheKey *key, bool filter, CacheFragType type)
+{
+  if ((!filter && !cache_admission_forced) || !CacheProcessor::IsCacheReady(type))
+    return true;
+  Vol *vol = caches[type]->key_to_vol(&key->hash, key->hostname, key->hostlen);
+  switch (vol->cache_vol->admission) {
+  case CACHE_ADMISSION_ON:
+    break;
+  case CACHE_ADMISSION_OFF:
+    return true;
+  default:
+    if (!filter)
+      return true;
+    break;
+  }
+  if (vol->admission.admit(&key->hash, cache_config_admission_threshold)) {
+    CACHE_SUM_DYN_STAT_THREAD(cache_admission_admitted_stat, 1);
+    return true;
+  }
+  CACHE_SUM_DYN_STAT_THREAD(cache_admission_rejected_stat, 1);
+  return false;
+}
+
 //----------------------------------------------------------------------------
 // Note: this should not be called from from the cluster processor, or bad
 // recursion could occur. This is merely a convenience wrapper.
@@ -0,0 +1,190 @@
+/** @file
+
+  Admission filter for new cache documents
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "P_Cache.h"
+
+#define CACHE_ADMISSION_ROWS 4
+#define CACHE_ADMISSION_MIN_WIDTH_BITS 10
+#define CACHE_ADMISSION_MAX_WIDTH_BITS 20 // 2MB of counters
+#define CACHE_ADMISSION_MAX_COUNT 15
+#define CACHE_ADMISSION_DOORKEEPER_BITS 3 // 8 doorkeeper bits per counter
+#define CACHE_ADMISSION_SAMPLE_FACTOR 8   // requests per counter between agings
+
+// odd multipliers, one per sketch row and two for the doorkeeper
+static const uint64_t admission_seeds[CACHE_ADMISSION_ROWS + 2] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+                                                                   0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL,
+                                                                   0xFF51AFD7ED558CCDULL, 0xC4CEB9FE1A85EC53ULL};
+
+static inline uint64_t
+admission_hash(const CryptoHash *key)
+{
+  // cache keys are already hashes, but the test keys are not
+  uint64_t h = key->u64[0] ^ (key->u64[1] * admission_seeds[0]);
+  h ^= h >> 33;
+  return h;
+}
+
+CacheAdmission::CacheAdmission()
+  : sketch(NULL), doorkeeper(NULL), width_bits(CACHE_ADMISSION_MIN_WIDTH_BITS), additions(0), sample_size(0)
+{
+  ink_mutex_init(&mutex, "CacheAdmission");
+}
+
+CacheAdmission::~CacheAdmission()
+{
+  ats_free(sketch);
+  ats_free(doorkeeper);
+  ink_mutex_destroy(&mutex);
+}
+
+void
+CacheAdmission::init(int64_t entries)
+{
+  if (sketch)
+    return;
+  width_bits = CACHE_ADMISSION_MIN_WIDTH_BITS;
+  while (width_bits < CACHE_ADMISSION_MAX_WIDTH_BITS && ((int64_t)1 << width_bits) < entries)
+    width_bits++;
+}
+
+// The tables are only allocated on first use, so volumes which never see
+// a transaction with the filter enabled pay nothing for it.
+void
+CacheAdmission::allocate()
+{
+  size_t sketch_bytes = ((size_t)CACHE_ADMISSION_ROWS << width_bits) / 2;
+  size_t doorkeeper_bytes = ((size_t)1 << (width_bits + CACHE_ADMISSION_DOORKEEPER_BITS)) / 8;
+  sketch = (uint64_t *)ats_malloc(sketch_bytes);
+  memset(sketch, 0, sketch_bytes);
+  doorkeeper = (uint64_t *)ats_malloc(doorkeeper_bytes);
+  memset(doorkeeper, 0, doorkeeper_bytes);
+  sample_size = (int64_t)CACHE_ADMISSION_SAMPLE_FACTOR << width_bits;
+  additions = 0;
+  Debug("cache_admission", "allocated %zu sketch bytes, %zu doorkeeper bytes, sample size %" PRId64, sketch_bytes,
+        doorkeeper_bytes, sample_size);
+}
+
+void
+CacheAdmission::reset()
+{
+  int64_t words = ((int64_t)CACHE_ADMISSION_ROWS << width_bits) / 16;
+  for (int64_t i = 0; i < words; i++)
+    sketch[i] = (sketch[i] >> 1) & 0x7777777777777777ULL;
+  memset(doorkeeper, 0, ((size_t)1 << (width_bits + CACHE_ADMISSION_DOORKEEPER_BITS)) / 8);
+  additions = additions / 2;
+}
+
+bool
+CacheAdmission::doorkeeper_test(uint64_t h)
+{
+  int bits = width_bits + CACHE_ADMISSION_DOORKEEPER_BITS;
+  for (int i = 0; i < 2; i++) {
+    uint64_t b = (h * admission_seeds[CACHE_ADMISSION_ROWS + i]) >> (64 - bits);
+    if (!(doorkeeper[b >> 6] & (1ULL << (b & 63))))
+      return false;
+  }
+  return true;
+}
+
+// returns true if the key was already in the doorkeeper
+bool
+CacheAdmission::doorkeeper_set(uint64_t h)
+{
+  int bits = width_bits + CACHE_ADMISSION_DOORKEEPER_BITS;
+  bool present = true;
+  for (int i = 0; i < 2; i++) {
+    uint64_t b = (h * admission_seeds[CACHE_ADMISSION_ROWS + i]) >> (64 - bits);
+    if (!(doorkeeper[b >> 6] & (1ULL << (b & 63)))) {
+      doorkeeper[b >> 6] |= 1ULL << (b & 63);
+      present = false;
+    }
+  }
+  return present;
+}
+
+int
+CacheAdmission::estimate(uint64_t h)
+{
+  int min = CACHE_ADMISSION_MAX_COUNT;
+  for (int i = 0; i < CACHE_ADMISSION_ROWS; i++) {
+    uint64_t c = (h * admission_seeds[i]) >> (64 - width_bits);
+    uint64_t *w = &sketch[((uint64_t)i << (width_bits - 4)) + (c >> 4)];
+    int v = (*w >> ((c & 15) << 2)) & 15;
+    if (v < min)
+      min = v;
+  }
+  return min;
+}
+
+// conservative update: only the counters holding the minimum are bumped
+int
+CacheAdmission::increment(uint64_t h)
+{
+  int min = estimate(h);
+  if (min >= CACHE_ADMISSION_MAX_COUNT)
+    return min;
+  for (int i = 0; i < CACHE_ADMISSION_ROWS; i++) {
+    uint64_t c = (h * admission_seeds[i]) >> (64 - width_bits);
+    uint64_t *w = &sketch[((uint64_t)i << (width_bits - 4)) + (c >> 4)];
+    int shift = (c & 15) << 2;
+    if ((int)((*w >> shift) & 15) == min)
+      *w += 1ULL << shift;
+  }
+  return min + 1;
+}
+
+bool
+CacheAdmission::admit(const CryptoHash *key, int threshold)
+{
+  if (threshold <= 1)
+    return true;
+  uint64_t h = admission_hash(key);
+  int freq;
+
+  ink_mutex_acquire(&mutex);
+  if (!sketch)
+    allocate();
+  // the doorkeeper absorbs the first request, so documents requested
+  // only once never reach the sketch
+  if (!doorkeeper_set(h))
+    freq = 1;
+  else
+    freq = increment(h) + 1;
+  if (++additions >= sample_size)
+    reset();
+  ink_mutex_release(&mutex);
+  return freq >= threshold;
+}
+
+int
+CacheAdmission::frequency(const CryptoHash *key)
+{
+  uint64_t h = admission_hash(key);
+  int freq = 0;
+
+  ink_mutex_acquire(&mutex);
+  if (sketch && doorkeeper_test(h))
+    freq = estimate(h) + 1;
+  ink_mutex_release(&mutex);
+  return freq;
+}
@@ -412,7 +412,7 @@ CacheHostTable::BuildTable(const char *config_file_path)
 }
 
 int
-CacheHostRecord::Init(CacheType typ)
+CacheHostRecord::Init(CacheType typ, bool fast_tier)
 {
   int i, j;
   extern Queue<CacheVol> cp_list;
@@ -425,7 +425,7 @@ CacheHostRecord::Init(CacheType typ)
   num_cachevols = 0;
   CacheVol *cachep = cp_list.head;
   for (; cachep; cachep = cachep->link.next) {
-    if (cachep->scheme == type) {
+    if (cachep->scheme == type && cachep->fast_tier == fast_tier) {
       Debug("cache_hosting", "Host Record: %p, Volume: %d, size: %" PRId64, this, cachep->vol_number, (int64_t)cachep->size);
       cp[num_cachevols] = cachep;
       num_cachevols++;
@@ -433,7 +433,8 @@ CacheHostRecord::Init(CacheType typ)
     }
   }
   if (!num_cachevols) {
-    RecSignalWarning(REC_SIGNAL_CONFIG_ERROR, "error: No volumes found for Cache Type %d", type);
+    if (!fast_tier)
+      RecSignalWarning(REC_SIGNAL_CONFIG_ERROR, "error: No volumes found for Cache Type %d", type);
     return -1;
   }
   vols = (Vol **)ats_malloc(num_vols * sizeof(Vol *));
@@ -629,6 +630,8 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
   CacheType scheme = CACHE_NONE_TYPE;
   int size = 0;
   int in_percent = 0;
+  bool fast_tier = false;
+  CacheAdmissionMode admission = CACHE_ADMISSION_DEFAULT;
   const char *matcher_name = "[CacheVolition]";
 
   memset(volume_seen, 0, sizeof(volume_seen));
@@ -645,6 +648,8 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
   tmp = bufTok.iterFirst(&i_state);
   while (tmp != NULL) {
     state = PAIR_ZERO;
+    fast_tier = false;
+    admission = CACHE_ADMISSION_DEFAULT;
     line_num++;
 
     // skip all blank spaces at beginning of line
@@ -666,6 +671,8 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
         }
         configp->scheme = scheme;
         configp->size = size;
+        configp->fast_tier = fast_tier;
+        configp->admission = admission;
         configp->cachep = NULL;
         cp_queue.enqueue(configp);
         num_volumes++;
@@ -673,7 +680,8 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
           num_http_volumes++;
         else
           num_stream_volumes++;
-        Debug("cache_hosting", "added volume=%d, scheme=%d, size=%d percent=%d\n", volume_number, scheme, size, in_percent);
+        Debug("cache_hosting", "added volume=%d, scheme=%d, size=%d percent=%d tier=%s admission=%d\n", volume_number, scheme, size,
+              in_percent, fast_tier ? "fast" : "slow", admission);
         break;
       }
 
@@ -784,6 +792,34 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
           in_percent = 0;
         state = DONE;
         break;
+
+      case DONE:
+        // optional tier=fast and admission=on|off
+        if (!strcasecmp(tmp, "tier")) {
+          tmp += 5;
+          if (!strcasecmp(tmp, "fast")) {
+            tmp += 4;
+            fast_tier = true;
+          } else if (!strcasecmp(tmp, "slow")) {
+            tmp += 4;
+          } else {
+            state = INK_ERROR;
+          }
+        } else if (!strcasecmp(tmp, "admission")) {
+          tmp += 10;
+          if (!strcasecmp(tmp, "on")) {
+            tmp += 2;
+            admission = CACHE_ADMISSION_ON;
+          } else if (!strcasecmp(tmp, "off")) {
+            tmp += 3;
+            admission = CACHE_ADMISSION_OFF;
+          } else {
+            state = INK_ERROR;
+          }
+        } else {
+          state = INK_ERROR;
+        }
+        break;
       }
 
       if (state == INK_ERROR || *tmp) {
@@ -1134,3 +1170,39 @@ restore_state()
   memcpy(&config_volumes, &saved_config_volumes, sizeof(ConfigVolumes));
   gnvol = saved_gnvol;
 }
+
+REGRESSION_TEST(Cache_volume_options)(RegressionTest *t, int /* atype ATS_UNUSED */, int *status)
+{
+  char config[] = "volume=1 scheme=http size=50% admission=on\n"
+                  "volume=2 scheme=http size=256 tier=fast admission=off\n"
+                  "volume=3 scheme=http size=10%\n"
+                  "volume=4 scheme=http size=10% admission=maybe\n";
+  ConfigVolumes volumes;
+  ConfigVol *cp;
+
+  *status = REGRESSION_TEST_PASSED;
+  volumes.BuildListFromString((char *)"volume.config", config);
+  if (volumes.num_volumes != 3) {
+    rprintf(t, "expected 3 volumes, got %d\n", volumes.num_volumes);
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  cp = volumes.cp_queue.head;
+  if (!cp || cp->admission != CACHE_ADMISSION_ON || cp->fast_tier) {
+    rprintf(t, "volume 1 should have admission=on\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+  cp = cp ? cp->link.next : NULL;
+  if (!cp || cp->admission != CACHE_ADMISSION_OFF || !cp->fast_tier) {
+    rprintf(t, "volume 2 should have tier=fast admission=off\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+  cp = cp ? cp->link.next : NULL;
+  if (!cp || cp->admission != CACHE_ADMISSION_DEFAULT || cp->fast_tier) {
+    rprintf(t, "volume 3 should have the default options\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  while ((cp = volumes.cp_queue.pop()))
+    delete cp;
+}
@@ -102,14 +102,20 @@ Cache::open_read(Continuation *cont, const CacheKey *key, CacheHTTPHdr *request,
   }
   ink_assert(caches[type] == this);
 
-  Vol *vol = key_to_vol(key, hostname, host_len);
-  Dir result, *last_collision = NULL;
   ProxyMutex *mutex = cont->mutex;
+  Vol *fast = tier_host_rec ? tier_lookup(key, mutex->thread_holding) : NULL;
+  Vol *vol = fast ? fast : key_to_vol(key, hostname, host_len);
+  bool other_tier = false;
+  Dir result, *last_collision;
   OpenDirEntry *od = NULL;
   CacheVC *c = NULL;
 
+Lprobe:
+  last_collision = NULL;
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
+    if (other_tier && !lock.is_locked())
+      goto Lmiss;
     if (!lock.is_locked() || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
       c = new_CacheVC(cont);
       c->first_key = c->key = c->earliest_key = *key;
@@ -128,7 +134,7 @@ Cache::open_read(Continuation *cont, const CacheKey *key, CacheHTTPHdr *request,
       return &c->_action;
     }
     if (!c)
-      goto Lmiss;
+      goto Lother;
     if (c->od)
       goto Lwriter;
     // hit
@@ -144,6 +150,18 @@ Cache::open_read(Continuation *cont, const CacheKey *key, CacheHTTPHdr *request,
       return &c->_action;
     }
   }
+Lother:
+  // The document may have been promoted to or dropped from the fast tier
+  // since tier_lookup(), look in the other tier before reporting a miss.
+  if (tier_host_rec && !other_tier) {
+    Vol *other = fast ? key_to_vol(key, hostname, host_len) : tier_vol(key);
+    if (other && other != vol) {
+      DDebug("cache_tier", "open_read %X missed in %s tier, trying the other one", key->slice32(0), fast ? "fast" : "slow");
+      vol = other;
+      other_tier = true;
+      goto Lprobe;
+    }
+  }
 Lmiss:
   CACHE_INCREMENT_DYN_STAT(cache_read_failure_stat);
   cont->handleEvent(CACHE_EVENT_OPEN_READ_FAILED, (void *)-ECACHE_NO_DOC);
@@ -915,6 +933,8 @@ Lcallreturn:
 Lsuccess:
   if (write_vc)
     CACHE_INCREMENT_DYN_STAT(cache_read_busy_success_stat);
+  if (vol->cache->tier_host_rec)
+    tier_read_done();
   SET_HANDLER(&CacheVC::openReadMain);
   return callcont(CACHE_EVENT_OPEN_READ);
 }
@@ -1157,6 +1177,8 @@ Ldone:
 Lcallreturn:
   return handleEvent(AIO_EVENT_DONE, 0); // hopefully a tail call
 Lsuccess:
+  if (vol->cache->tier_host_rec)
+    tier_read_done();
   SET_HANDLER(&CacheVC::openReadMain);
   return callcont(CACHE_EVENT_OPEN_READ);
 Lookup:
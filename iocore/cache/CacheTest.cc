@@ -25,7 +25,12 @@
 #include "P_Cache.h"
 #include "P_CacheTest.h"
 #include "api/ts/ts.h"
+#include "ts/hugepages.h"
 #include <vector>
+#if defined(linux)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 using namespace std;
 
@@ -631,3 +636,186 @@ REGRESSION_TEST(ram_cache)(RegressionTest *t, int level, int *pstatus)
       *pstatus = REGRESSION_TEST_FAILED;
   }
 }
+
+// Start counting the data TLB read misses of this thread, -1 if the kernel won't give us a counter.
+static int
+open_dtlb_counter()
+{
+#if defined(linux)
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+// Stream RAM cache hits of large documents and read every page of each hit,
+// to compare the TLB behaviour of the IOBuffer memory with and without
+// proxy.config.allocator.hugepages.
+REGRESSION_TEST(ram_cache_hit_stream)(RegressionTest *t, int level, int *pstatus)
+{
+  if (REGRESSION_TEST_EXTENDED > level) {
+    *pstatus = REGRESSION_TEST_PASSED;
+    return;
+  }
+
+  if (cacheProcessor.IsCacheEnabled() != CACHE_INITIALIZED) {
+    rprintf(t, "cache not initialized");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+
+  const int ndocs = 1024;
+  const int nhits = 1 << 16;
+  CacheKey key;
+  Vol *vol = theCache->key_to_vol(&key, "example.com", sizeof("example.com") - 1);
+  RamCache *cache = new_RamCacheCLFUS();
+  vector<Ptr<IOBufferData> > data;
+  int64_t cache_size = 0;
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  for (int i = 0; i < ndocs; i++)
+    cache_size += BUFFER_SIZE_FOR_INDEX(BUFFER_SIZE_INDEX_32K + i % 4) + 1024;
+  cache->init(cache_size, vol);
+
+  for (int i = 0; i < ndocs; i++) {
+    IOBufferData *d = THREAD_ALLOC(ioDataAllocator, this_thread());
+    INK_MD5 md5;
+
+    d->alloc(BUFFER_SIZE_INDEX_32K + i % 4);
+    memset(d->data(), i, d->block_size());
+    data.push_back(make_ptr(d));
+    md5.u64[0] = ((uint64_t)i << 32) + i;
+    md5.u64[1] = ((uint64_t)i << 32) + i;
+    cache->put(&md5, data.back(), d->block_size());
+  }
+  data.clear();
+
+  int fd = open_dtlb_counter();
+  int misses = 0;
+  uint64_t sum = 0;
+  srand48(13);
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int i = 0; i < nhits; i++) {
+    // coverity[dont_call]
+    int n = (int)(drand48() * ndocs);
+    INK_MD5 md5;
+    Ptr<IOBufferData> get_data;
+
+    md5.u64[0] = ((uint64_t)n << 32) + n;
+    md5.u64[1] = ((uint64_t)n << 32) + n;
+    if (!cache->get(&md5, &get_data)) {
+      misses++;
+      continue;
+    }
+    for (int64_t o = 0; o < get_data->block_size(); o += 4096)
+      sum += (unsigned char)get_data->data()[o];
+  }
+  ink_hrtime elapsed = ink_get_hrtime_internal() - start;
+
+  uint64_t tlb_misses = 0;
+  if (fd >= 0) {
+    if (read(fd, &tlb_misses, sizeof(tlb_misses)) != sizeof(tlb_misses))
+      tlb_misses = 0;
+    close(fd);
+  }
+
+  rprintf(t, "RamCache hit stream: %d hits in %" PRId64 " ns/hit, checksum %" PRIu64 "\n", nhits - misses,
+          (int64_t)(elapsed / nhits), sum);
+  if (fd >= 0)
+    rprintf(t, "RamCache hit stream: %.2f data TLB misses per hit\n", (double)tlb_misses / nhits);
+  else
+    rprintf(t, "RamCache hit stream: data TLB miss counter not available\n");
+  rprintf(t, "RamCache hit stream: huge page arena 1GB %zu, hugetlb %zu, transparent %zu bytes\n",
+          ats_hugepage_arena_size(HUGEPAGE_ARENA_GIGANTIC), ats_hugepage_arena_size(HUGEPAGE_ARENA_HUGETLB),
+          ats_hugepage_arena_size(HUGEPAGE_ARENA_TRANSPARENT));
+
+  // Everything fits, so every get must hit.
+  if (misses)
+    *pstatus = REGRESSION_TEST_FAILED;
+}
+
+// Hit rate of a cyclic (FIFO) cache of capacity documents for the request
+// stream r, with and without an admission filter in front of the writes.
+static double
+admission_hit_rate(CacheAdmission *admission, int *r, int n, int capacity)
+{
+  vector<char> present(ZIPF_SIZE, 0);
+  vector<int> fifo(capacity, -1);
+  int pos = 0, hits = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (present[r[i]]) {
+      if (i >= n / 2)
+        hits++; // Sample last half of the requests.
+      continue;
+    }
+    CryptoHash key;
+    key.u64[0] = ((uint64_t)r[i] << 32) + r[i];
+    key.u64[1] = ((uint64_t)r[i] << 32) + r[i];
+    if (admission && !admission->admit(&key, 2))
+      continue;
+    if (fifo[pos] >= 0)
+      present[fifo[pos]] = 0;
+    fifo[pos] = r[i];
+    present[r[i]] = 1;
+    pos = (pos + 1) % capacity;
+  }
+  return (double)hits / (n - n / 2);
+}
+
+REGRESSION_TEST(cache_admission)(RegressionTest *t, int /* level ATS_UNUSED */, int *pstatus)
+{
+  CacheAdmission admission;
+  CryptoHash key;
+  int rejected = 0;
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  admission.init(1 << 16);
+
+  // Documents are admitted on their second request.
+  key.u64[0] = 0x1234;
+  key.u64[1] = 0x5678;
+  if (admission.admit(&key, 2) || !admission.admit(&key, 2) || admission.frequency(&key) != 2) {
+    rprintf(t, "admission of a document on its second request failed\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  // One-hit wonders are turned away, up to the doorkeeper false positives.
+  for (int i = 0; i < 50000; i++) {
+    key.u64[0] = ((uint64_t)i << 32) + i + 1;
+    key.u64[1] = ((uint64_t)i << 32) + i + 1;
+    if (!admission.admit(&key, 2))
+      rejected++;
+  }
+  rprintf(t, "CacheAdmission rejected %d of 50000 one-hit wonders\n", rejected);
+  if (rejected < 50000 * 0.95)
+    *pstatus = REGRESSION_TEST_FAILED;
+
+  // Compare the hit rate of a cyclic cache with and without the filter.
+  int capacity = 1 << 14;
+  int sample_size = 1 << 20;
+  build_zipf();
+  srand48(13);
+  int *r = (int *)ats_malloc(sample_size * sizeof(int));
+  for (int i = 0; i < sample_size; i++)
+    // coverity[dont_call]
+    r[i] = get_zipf(drand48());
+
+  CacheAdmission filter;
+  filter.init(capacity);
+  double fifo_hit_rate = admission_hit_rate(NULL, r, sample_size, capacity);
+  double filter_hit_rate = admission_hit_rate(&filter, r, sample_size, capacity);
+  rprintf(t, "CacheAdmission FIFO Hit Rate %f, with admission filter %f\n", fifo_hit_rate, filter_hit_rate);
+  if (filter_hit_rate < fifo_hit_rate)
+    *pstatus = REGRESSION_TEST_FAILED;
+
+  ats_free(r);
+}
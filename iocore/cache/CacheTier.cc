@@ -0,0 +1,405 @@
+/** @file
+
+  Tiered cache: promotion to and demotion from fast tier volumes
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+/*
+  Volumes marked tier=fast in volume.config form the fast tier.  They are
+  left out of the hosting tables, so documents are always written to the
+  other (slow tier) volumes.  A fast tier volume holds copies:
+
+  - A single fragment HTTP document which is read from the slow tier
+    proxy.config.cache.tier.promote_threshold times is copied to the fast
+    tier volume its key hashes to.
+  - Reads probe the fast tier first, so the copy serves every later hit.
+  - Writing or removing the document pushes its key onto the invalidation
+    list of the fast tier volume, which is applied under the volume lock
+    before the next probe.  A generation counted per key hash lets a
+    promotion which raced with a write of its key notice that its copy is
+    stale.
+  - Documents about to be overwritten in the fast tier are read by the
+    evacuation code and written back to the slow tier if it lost its copy
+    in the meantime.
+
+  Copies are written through the aggregation buffer of the target volume
+  as evacuators, and are dropped rather than delayed when that volume is
+  busy.
+ */
+
+#include "P_Cache.h"
+
+ClassAllocator<TierInvalidation> tierInvalidationAllocator("tierInvalidationAllocator");
+
+// A CacheVC which writes a copy of a document of nbytes to vol. cont
+// must be locked by the calling thread, which the CacheVC is allocated on.
+static CacheVC *
+new_TierCopy(Continuation *cont, Vol *vol, int nbytes)
+{
+  CacheVC *c = new_CacheVC(cont);
+  ProxyMutex *mutex = cont->mutex;
+  c->_action = vol;
+  c->mutex = vol->mutex;
+  c->vol = vol;
+  c->base_stat = cache_evacuate_active_stat;
+  CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
+  c->buf = new_IOBufferData(iobuffer_size_to_index(nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+  c->f.evacuator = 1;
+  c->earliest_key = zero_key;
+  SET_CONTINUATION_HANDLER(c, &CacheVC::tierCopyStart);
+  return c;
+}
+
+// The slow tier volume of a document read from the fast tier, or NULL if
+// it is not a single alternate HTTP document.
+static Vol *
+tier_home_vol(Cache *cache, Doc *doc)
+{
+  if (doc->doc_type != CACHE_FRAG_TYPE_HTTP || !doc->hlen || !doc->data_len() || !doc->single_fragment())
+    return NULL;
+  // the vector is unmarshalled in place, so work on a copy of it
+  char *hdr = (char *)ats_malloc(doc->hlen);
+  memcpy(hdr, doc->hdr(), doc->hlen);
+  CacheHTTPInfoVector vector;
+  Vol *vol = NULL;
+  if (vector.get_handles(hdr, doc->hlen) == doc->hlen && vector.count() == 1) {
+    int host_len = 0;
+    const char *hostname = vector.get(0)->request_get()->host_get(&host_len);
+    vol = cache->key_to_vol(&doc->first_key, hostname, host_len);
+  }
+  vector.clear();
+  ats_free(hdr);
+  return vol;
+}
+
+Vol *
+Cache::tier_vol(const CacheKey *key)
+{
+  if (!tier_host_rec || !tier_host_rec->vol_hash_table)
+    return NULL;
+  uint32_t h = (key->slice32(2) >> DIR_TAG_WIDTH) % VOL_HASH_TABLE_SIZE;
+  return tier_host_rec->vols[tier_host_rec->vol_hash_table[h]];
+}
+
+// Returns the fast tier volume of key if the document has been promoted
+// there. A busy volume is treated as a miss, the slow tier still has the
+// document most of the time.
+Vol *
+Cache::tier_lookup(const CacheKey *key, EThread *t)
+{
+  Vol *vol = tier_vol(key);
+  if (!vol)
+    return NULL;
+  Dir result, *last_collision = NULL;
+  CACHE_TRY_LOCK(lock, vol->mutex, t);
+  if (!lock.is_locked())
+    return NULL;
+  vol->tier_apply_invalidations();
+  return dir_probe(key, vol, &result, &last_collision) ? vol : NULL;
+}
+
+void
+Cache::tier_invalidate(const CacheKey *key)
+{
+  Vol *vol = tier_vol(key);
+  if (vol)
+    vol->tier_invalidate(key);
+}
+
+void
+Vol::tier_invalidate(const CacheKey *key)
+{
+  TierInvalidation *ti = tierInvalidationAllocator.alloc();
+  ti->key = *key;
+  // bump the generation before the push, so that a promotion which still
+  // sees the old generation is inserted before the invalidation is applied
+  ink_atomic_increment(tier_generation(key), 1);
+  tier_invalidations.push(ti);
+}
+
+void
+Vol::tier_apply_invalidations()
+{
+  ink_assert(mutex->thread_holding == this_ethread());
+  TierInvalidation *ti = tier_invalidations.popall();
+  while (ti) {
+    TierInvalidation *next = ti->link.next;
+    Dir del_dir, *last_collision = NULL;
+    // entries of other keys with the same tag go too, they are only copies
+    while (dir_probe(&ti->key, this, &del_dir, &last_collision)) {
+      dir_delete(&ti->key, this, &del_dir);
+      last_collision = NULL;
+    }
+    tierInvalidationAllocator.free(ti);
+    ti = next;
+  }
+}
+
+// Queue the heads of the documents ahead of the write position for
+// demotion, over the same window as scan_for_pinned_documents(). The
+// evacuation reads them in batches and calls tier_demote().
+void
+Vol::scan_for_demotion()
+{
+  if (!cache_vol->fast_tier || !cache_config_tier_demote)
+    return;
+  tier_apply_invalidations();
+  int64_t ps = offset_to_vol_offset(this, header->write_pos + AGG_SIZE);
+  int64_t pe = offset_to_vol_offset(this, header->write_pos + 2 * EVACUATION_SIZE + (len / PIN_SCAN_EVERY));
+  int64_t vol_end_offset = offset_to_vol_offset(this, len + skip);
+  bool before_end_of_vol = pe < vol_end_offset;
+  for (int i = 0; i < vol_direntries(this); i++) {
+    if (dir_is_empty(&dir[i]) || !dir_head(&dir[i]))
+      continue;
+    int64_t o = dir_offset(&dir[i]);
+    if (dir_phase(&dir[i]) == header->phase) {
+      if (before_end_of_vol || o >= (pe - vol_end_offset))
+        continue;
+    } else {
+      if (o < ps || o >= pe)
+        continue;
+    }
+    // documents which are hit evacuated or pinned stay in this tier
+    if (evacuation_block_exists(&dir[i], this))
+      continue;
+    EvacuationBlock *b = new_EvacuationBlock(mutex->thread_holding);
+    b->dir = dir[i];
+    b->f.demote = 1;
+    evacuate[dir_evac_bucket(&dir[i])].push(b);
+  }
+}
+
+void
+Vol::tier_demote(EvacuationBlock *b, Doc *doc)
+{
+  ink_assert(mutex->thread_holding == this_ethread());
+  if (!dir_head(&b->dir) || !dir_compare_tag(&b->dir, &doc->first_key))
+    return;
+  // the document may have been invalidated since the scan
+  tier_apply_invalidations();
+  Dir probe, *last_collision = NULL;
+  bool present = false;
+  while (!present && dir_probe(&doc->first_key, this, &probe, &last_collision))
+    present = dir_offset(&probe) == dir_offset(&b->dir);
+  if (!present)
+    return;
+  Vol *home = tier_home_vol(cache, doc);
+  if (!home)
+    return;
+  CacheVC *c = new_TierCopy(this, home, doc->len);
+  memcpy(c->buf->data(), doc, doc->len);
+  c->first_key = c->key = doc->first_key;
+  c->overwrite_dir = b->dir;
+  DDebug("cache_tier", "demote %X offset %d", doc->first_key.slice32(0), (int)dir_offset(&b->dir));
+  eventProcessor.schedule_imm(c, ET_CALL);
+}
+
+// Called by a successful read when the cache has a fast tier: records the
+// per tier statistics, and promotes the document once it is hot.
+void
+CacheVC::tier_read_done()
+{
+  bool fast = vol->cache_vol->fast_tier;
+  if (!f.doc_from_ram_cache) {
+    CACHE_INCREMENT_DYN_STAT(fast ? cache_tier_fast_hits_stat : cache_tier_slow_hits_stat);
+    RecRecordRawHistogram(cache_rhb, mutex->thread_holding, fast ? cache_tier_fast_read_histogram : cache_tier_slow_read_histogram,
+                          ink_hrtime_to_usec(Thread::get_hrtime() - start_time));
+  }
+  if (fast || !cache_config_tier_promote_threshold || frag_type != CACHE_FRAG_TYPE_HTTP || !f.single_fragment ||
+      vector.count() != 1)
+    return;
+  if (!vol->tier_hits.admit(&first_key, cache_config_tier_promote_threshold))
+    return;
+  Vol *to = vol->cache->tier_vol(&first_key);
+  if (!to)
+    return;
+
+  // The vector in first_buf has been unmarshalled in place, so the copy is
+  // put together from a fresh marshal of the vector and the data.
+  Doc *doc = (Doc *)first_buf->data();
+  int hlen = vector.marshal_length();
+  uint32_t len = sizeofDoc + hlen + doc->data_len();
+  CacheVC *c = new_TierCopy(this, to, len);
+  Doc *copy = (Doc *)c->buf->data();
+  memcpy((char *)copy, (char *)doc, sizeofDoc);
+  copy->len = len;
+  copy->hlen = hlen;
+  if (vector.marshal(copy->hdr(), hlen) != hlen)
+    copy->magic = DOC_CORRUPT; // dropped by tierCopyStart()
+  memcpy(copy->data(), doc->data(), doc->data_len());
+  copy->checksum = DOC_NO_CHECKSUM;
+  if (cache_config_enable_checksum) {
+    copy->checksum = 0;
+    for (char *b = copy->hdr(); b < (char *)copy + copy->len; b++)
+      copy->checksum += *b;
+  }
+  c->first_key = c->key = first_key;
+  c->overwrite_dir = first_dir;
+  c->tier_generation = *to->tier_generation(&first_key);
+  DDebug("cache_tier", "promote %X", first_key.slice32(0));
+  eventProcessor.schedule_imm(c, ET_CALL);
+}
+
+// Runs under the lock of the target volume.
+int
+CacheVC::tierCopyStart(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  ink_assert(vol->mutex->thread_holding == this_ethread());
+  Doc *doc = (Doc *)buf->data();
+  Dir probe, *last_collision = NULL;
+  if (doc->magic != DOC_MAGIC)
+    return free_CacheVC(this);
+  if (vol->cache_vol->fast_tier) {
+    // a promotion is dropped if the document was written after it was
+    // read, or if an earlier promotion already copied it
+    vol->tier_apply_invalidations();
+    if (tier_generation != *vol->tier_generation(&first_key) || dir_probe(&first_key, vol, &probe, &last_collision))
+      return free_CacheVC(this);
+  } else if (vol->open_read(&first_key) || dir_probe(&first_key, vol, &probe, &last_collision)) {
+    // a demotion is only needed if the slow tier lost its copy
+    return free_CacheVC(this);
+  }
+  agg_len = vol->round_to_approx_size(doc->len);
+  if (agg_len > AGG_SIZE || vol->agg_todo_size > cache_config_agg_write_backlog + AGG_SIZE)
+    return free_CacheVC(this);
+  dir_set_approx_size(&overwrite_dir, agg_len);
+  vol->agg_todo_size += agg_len;
+  vol->agg.enqueue(this);
+  SET_HANDLER(&CacheVC::tierCopyDone);
+  if (!vol->is_io_in_progress())
+    vol->aggWrite(EVENT_NONE, 0);
+  return EVENT_CONT;
+}
+
+// Called by aggWrite() once the copy is in the aggregation buffer.
+int
+CacheVC::tierCopyDone(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  ink_assert(vol->mutex->thread_holding == this_ethread());
+  bool fast = vol->cache_vol->fast_tier;
+  if (!fast || tier_generation == *vol->tier_generation(&first_key)) {
+    Dir old, *last_collision = NULL;
+    if (dir_probe(&first_key, vol, &old, &last_collision))
+      dir_overwrite(&first_key, vol, &dir, &old);
+    else
+      dir_insert(&first_key, vol, &dir);
+    CACHE_INCREMENT_DYN_STAT(fast ? cache_tier_promotions_stat : cache_tier_demotions_stat);
+  }
+  return free_CacheVC(this);
+}
+
+// Commits a copy of key to vol as tierCopyDone() does once the copy has
+// been written, and returns whether the directory has the key afterwards.
+static bool
+tier_test_copy(Vol *vol, CacheKey *key, uint32_t generation)
+{
+  CacheVC *c = new_TierCopy(vol, vol, 512);
+  c->first_key = c->key = *key;
+  c->tier_generation = generation;
+  dir_clear(&c->dir);
+  dir_set_phase(&c->dir, vol->header->phase);
+  dir_set_head(&c->dir, true);
+  dir_set_offset(&c->dir, 1);
+  c->tierCopyDone(EVENT_NONE, NULL);
+  Dir result, *last_collision = NULL;
+  return dir_probe(key, vol, &result, &last_collision);
+}
+
+EXCLUSIVE_REGRESSION_TEST(Cache_tier)(RegressionTest *t, int /* atype ATS_UNUSED */, int *status)
+{
+  *status = REGRESSION_TEST_PASSED;
+  if ((CacheProcessor::IsCacheEnabled() != CACHE_INITIALIZED) || gnvol < 1) {
+    rprintf(t, "cache not ready/configured");
+    *status = REGRESSION_TEST_FAILED;
+    return;
+  }
+  Vol *vol = gvol[0];
+  EThread *thread = this_ethread();
+  MUTEX_TRY_LOCK(lock, vol->mutex, thread);
+  ink_release_assert(lock.is_locked());
+  bool fast_tier = vol->cache_vol->fast_tier;
+  vol->cache_vol->fast_tier = true;
+  vol_dir_clear(vol);
+  vol->header->agg_pos = vol->header->write_pos += 1024;
+
+  CacheKey promoted, raced, other;
+  rand_CacheKey(&promoted, thread->mutex);
+  rand_CacheKey(&raced, thread->mutex);
+  do {
+    rand_CacheKey(&other, thread->mutex);
+  } while (vol->tier_generation(&other) == vol->tier_generation(&raced));
+
+  // promote
+  if (!tier_test_copy(vol, &promoted, *vol->tier_generation(&promoted))) {
+    rprintf(t, "promotion was not inserted\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  // a write of another document does not drop a promotion in flight
+  uint32_t generation = *vol->tier_generation(&raced);
+  vol->tier_invalidate(&other);
+  vol->tier_apply_invalidations();
+  if (!tier_test_copy(vol, &raced, generation)) {
+    rprintf(t, "promotion was dropped by the invalidation of another key\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  // a write of the same document does
+  rand_CacheKey(&raced, thread->mutex);
+  generation = *vol->tier_generation(&raced);
+  vol->tier_invalidate(&raced);
+  vol->tier_apply_invalidations();
+  if (tier_test_copy(vol, &raced, generation)) {
+    rprintf(t, "promotion of an invalidated key was inserted\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  // invalidate
+  Dir result, *last_collision = NULL;
+  vol->tier_invalidate(&promoted);
+  vol->tier_apply_invalidations();
+  if (dir_probe(&promoted, vol, &result, &last_collision)) {
+    rprintf(t, "invalidated key is still in the fast tier\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  // demote: the slow tier ignores the fast tier generations, and keeps the
+  // copy it already has
+  vol->cache_vol->fast_tier = false;
+  CacheKey demoted;
+  rand_CacheKey(&demoted, thread->mutex);
+  vol->tier_invalidate(&demoted);
+  if (!tier_test_copy(vol, &demoted, *vol->tier_generation(&demoted) - 1)) {
+    rprintf(t, "demotion was not inserted\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+  CacheVC *c = new_TierCopy(vol, vol, 512);
+  Doc *doc = (Doc *)c->buf->data();
+  doc->magic = DOC_MAGIC;
+  c->first_key = c->key = demoted;
+  if (c->tierCopyStart(EVENT_NONE, NULL) != EVENT_DONE) {
+    rprintf(t, "demotion of a document the slow tier has was not dropped\n");
+    *status = REGRESSION_TEST_FAILED;
+  }
+
+  vol->tier_apply_invalidations();
+  vol->cache_vol->fast_tier = fast_tier;
+  vol_dir_clear(vol);
+}
@@ -258,6 +258,7 @@ Vol::force_evacuate_head(Dir *evac_dir, int pinned)
   }
   b->f.pinned = pinned;
   b->f.evacuate_head = 1;
+  b->f.demote = 0; // keep it in this tier
   b->evac_frags.key = zero_key; // ensure that the block gets
   // evacuated no matter what
   b->readers = 0; // ensure that the block does not disappear
@@ -565,77 +566,68 @@ evacuate_fragments(CacheKey *key, CacheKey *earliest_key, int force, Vol *vol)
   return i;
 }
 
-int
-Vol::evacuateWrite(CacheVC *evacuator, int event, Event *e)
+// Evacuated documents are queued in this order: pinned documents, then
+// documents with open readers or recent hits, then the remaining fragments.
+static inline int
+evacuation_priority(EvacuationBlock *b)
 {
-  // push to front of aggregation write list, so it is written first
-
-  evacuator->agg_len = round_to_approx_size(((Doc *)evacuator->buf->data())->len);
-  agg_todo_size += evacuator->agg_len;
-  /* insert the evacuator after all the other evacuators */
-  CacheVC *cur = (CacheVC *)agg.head;
-  CacheVC *after = NULL;
-  for (; cur && cur->f.evacuator; cur = (CacheVC *)cur->link.next)
-    after = cur;
-  ink_assert(evacuator->agg_len <= AGG_SIZE);
-  agg.insert(evacuator, after);
-  return aggWrite(event, e);
+  if (b->f.pinned)
+    return 0;
+  if (b->readers || b->f.evacuate_head)
+    return 1;
+  return 2;
 }
 
-int
-Vol::evacuateDocReadDone(int event, Event *e)
+#define EVACUATION_PRIORITIES 3
+
+CacheVC *
+Vol::evacuate_block(EvacuationBlock *b)
 {
-  cancel_trigger();
-  if (event != AIO_EVENT_DONE)
-    return EVENT_DONE;
-  ink_assert(is_io_in_progress());
-  set_io_not_in_progress();
-  ink_assert(mutex->thread_holding == this_ethread());
-  Doc *doc = (Doc *)doc_evacuator->buf->data();
+  off_t o = vol_offset(this, &b->dir) - evac_buffer_offset;
+  Doc *doc = (Doc *)(evac_buffer + o);
+  CacheVC *evacuator = NULL;
   CacheKey next_key;
-  EvacuationBlock *b = NULL;
-  if (doc->magic != DOC_MAGIC) {
-    Debug("cache_evac", "DOC magic: %X %d", (int)dir_tag(&doc_evacuator->overwrite_dir),
-          (int)dir_offset(&doc_evacuator->overwrite_dir));
+  if (doc->magic != DOC_MAGIC || doc->len > (uint32_t)(evac_buffer_len - o)) {
+    Debug("cache_evac", "DOC magic: %X %d", (int)dir_tag(&b->dir), (int)dir_offset(&b->dir));
     ink_assert(doc->magic == DOC_MAGIC);
-    goto Ldone;
+    return NULL;
   }
-  DDebug("cache_evac", "evacuateDocReadDone %X offset %d", (int)doc->key.slice32(0),
-         (int)dir_offset(&doc_evacuator->overwrite_dir));
+  DDebug("cache_evac", "evacuate_block %X offset %d", (int)doc->key.slice32(0), (int)dir_offset(&b->dir));
 
-  b = evacuate[dir_evac_bucket(&doc_evacuator->overwrite_dir)].head;
-  while (b) {
-    if (dir_offset(&b->dir) == dir_offset(&doc_evacuator->overwrite_dir))
-      break;
-    b = b->link.next;
+  if (b->f.demote) {
+    tier_demote(b, doc);
+    return NULL;
   }
-  if (!b)
-    goto Ldone;
   if ((b->f.pinned && !b->readers) && doc->pinned < (uint32_t)(Thread::get_hrtime() / HRTIME_SECOND))
-    goto Ldone;
+    return NULL;
+
+  evacuator = new_DocEvacuator(doc->len, this);
+  memcpy(evacuator->buf->data(), doc, doc->len);
+  doc = (Doc *)evacuator->buf->data();
+  evacuator->overwrite_dir = b->dir;
 
   if (dir_head(&b->dir) && b->f.evacuate_head) {
     ink_assert(!b->evac_frags.key.fold());
     // if its a head (vector), evacuation is real simple...we just
     // need to write this vector down and overwrite the directory entry.
     if (dir_compare_tag(&b->dir, &doc->first_key)) {
-      doc_evacuator->key = doc->first_key;
+      evacuator->key = doc->first_key;
       b->evac_frags.key = doc->first_key;
       DDebug("cache_evac", "evacuating vector %X offset %d", (int)doc->first_key.slice32(0),
-             (int)dir_offset(&doc_evacuator->overwrite_dir));
+             (int)dir_offset(&evacuator->overwrite_dir));
       b->f.unused = 57;
     } else {
       // if its an earliest fragment (alternate) evacuation, things get
       // a little tricky. We have to propagate the earliest key to the next
       // fragments for this alternate. The last fragment to be evacuated
       // fixes up the lookaside buffer.
-      doc_evacuator->key = doc->key;
-      doc_evacuator->earliest_key = doc->key;
+      evacuator->key = doc->key;
+      evacuator->earliest_key = doc->key;
       b->evac_frags.key = doc->key;
       b->evac_frags.earliest_key = doc->key;
-      b->earliest_evacuator = doc_evacuator;
+      b->earliest_evacuator = evacuator;
       DDebug("cache_evac", "evacuating earliest %X %X evac: %p offset: %d", (int)b->evac_frags.key.slice32(0),
-             (int)doc->key.slice32(0), doc_evacuator, (int)dir_offset(&doc_evacuator->overwrite_dir));
+             (int)doc->key.slice32(0), evacuator, (int)dir_offset(&evacuator->overwrite_dir));
       b->f.unused = 67;
     }
   } else {
@@ -645,11 +637,12 @@ Vol::evacuateDocReadDone(int event, Event *e)
       ;
     if (!ek) {
       b->f.unused = 77;
-      goto Ldone;
+      free_CacheVC(evacuator);
+      return NULL;
     }
-    doc_evacuator->key = ek->key;
-    doc_evacuator->earliest_key = ek->earliest_key;
-    DDebug("cache_evac", "evacuateDocReadDone key: %X earliest: %X", (int)ek->key.slice32(0), (int)ek->earliest_key.slice32(0));
+    evacuator->key = ek->key;
+    evacuator->earliest_key = ek->earliest_key;
+    DDebug("cache_evac", "evacuate_block key: %X earliest: %X", (int)ek->key.slice32(0), (int)ek->earliest_key.slice32(0));
     b->f.unused = 87;
   }
   // if the tag in the c->dir does match the first_key in the
@@ -658,15 +651,97 @@ Vol::evacuateDocReadDone(int event, Event *e)
   // Cache::open_write).
   if (!dir_head(&b->dir) || !dir_compare_tag(&b->dir, &doc->first_key)) {
     next_CacheKey(&next_key, &doc->key);
-    evacuate_fragments(&next_key, &doc_evacuator->earliest_key, !b->readers, this);
+    evacuate_fragments(&next_key, &evacuator->earliest_key, !b->readers, this);
+  }
+  return evacuator;
+}
+
+static int
+cmp_evacuation_block(const void *aa, const void *bb)
+{
+  int64_t a = dir_offset(&(*(EvacuationBlock **)aa)->dir);
+  int64_t b = dir_offset(&(*(EvacuationBlock **)bb)->dir);
+  if (a < b)
+    return -1;
+  if (a > b)
+    return 1;
+  return 0;
+}
+
+/* Handles the completion of a batched evacuation read: every block that
+   was part of the read is turned into an evacuator and all of them are
+   queued in front of the aggregation writers, so that they are packed
+   into the next AGG_SIZE writes together. */
+int
+Vol::evacuateDocReadDone(int event, Event *e)
+{
+  cancel_trigger();
+  if (event != AIO_EVENT_DONE)
+    return EVENT_DONE;
+  ink_assert(is_io_in_progress());
+  set_io_not_in_progress();
+  ink_assert(mutex->thread_holding == this_ethread());
+  Que(CacheVC, link) evacuators[EVACUATION_PRIORITIES];
+  int si = dir_offset_evac_bucket(offset_to_vol_offset(this, evac_buffer_offset));
+  int ei = dir_offset_evac_bucket(offset_to_vol_offset(this, evac_buffer_offset + evac_buffer_len - 1));
+  int i, n = 0;
+  EvacuationBlock *b;
+
+  for (i = si; i <= ei; i++)
+    for (b = evacuate[i].head; b; b = b->link.next)
+      if (b->f.batched)
+        n++;
+  // Blocks are handled in disk order, as the read of a fragment may add
+  // the key of the next fragment to a block further in the batch.
+  EvacuationBlock **blocks = (EvacuationBlock **)ats_malloc((n + 1) * sizeof(EvacuationBlock *));
+  n = 0;
+  for (i = si; i <= ei; i++)
+    for (b = evacuate[i].head; b; b = b->link.next)
+      if (b->f.batched) {
+        b->f.batched = 0;
+        blocks[n++] = b;
+      }
+  if (io.ok()) {
+    qsort(blocks, n, sizeof(EvacuationBlock *), cmp_evacuation_block);
+    for (i = 0; i < n; i++) {
+      CacheVC *evacuator = evacuate_block(blocks[i]);
+      if (evacuator)
+        evacuators[evacuation_priority(blocks[i])].enqueue(evacuator);
+    }
+  } else if (n > 1) {
+    // Keep the blocks pending and read them again one at a time, so that
+    // a bad sector only loses the documents stored on it.
+    Debug("cache_evac", "batch read of %d blocks at %" PRId64 " failed, reading them one by one", n, (int64_t)evac_buffer_offset);
+    for (i = 0; i < n; i++)
+      blocks[i]->f.done = 0;
+    evac_single_start = evac_buffer_offset;
+    evac_single_end = evac_buffer_offset + evac_buffer_len;
+  }
+  ats_free(blocks);
+
+  // push to front of aggregation write list, after all the other
+  // evacuators, so they are written first
+  CacheVC *after = NULL;
+  for (CacheVC *cur = (CacheVC *)agg.head; cur && cur->f.evacuator; cur = (CacheVC *)cur->link.next)
+    after = cur;
+  for (int p = 0; p < EVACUATION_PRIORITIES; p++) {
+    CacheVC *evacuator;
+    while ((evacuator = evacuators[p].dequeue())) {
+      evacuator->agg_len = round_to_approx_size(((Doc *)evacuator->buf->data())->len);
+      ink_assert(evacuator->agg_len <= AGG_SIZE);
+      agg_todo_size += evacuator->agg_len;
+      agg.insert(evacuator, after);
+      after = evacuator;
+    }
   }
-  return evacuateWrite(doc_evacuator, event, e);
-Ldone:
-  free_CacheVC(doc_evacuator);
-  doc_evacuator = 0;
   return aggWrite(event, e);
 }
 
+/* Starts one sequential read covering the pending evacuation block
+   nearest to the write cursor and every other pending block in
+   [low, high) that fits in the following EVACUATION_BATCH_SIZE bytes.
+   Blocks of a batch read which failed are read one at a time.
+   Returns -1 if a read was started. */
 int
 Vol::evac_range(off_t low, off_t high, int evac_phase)
 {
@@ -674,12 +749,12 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
   off_t e = offset_to_vol_offset(this, high);
   int si = dir_offset_evac_bucket(s);
   int ei = dir_offset_evac_bucket(e);
+  EvacuationBlock *first = 0;
+  int64_t first_offset = INT64_MAX;
+  int fi;
 
-  for (int i = si; i <= ei; i++) {
-    EvacuationBlock *b = evacuate[i].head;
-    EvacuationBlock *first = 0;
-    int64_t first_offset = INT64_MAX;
-    for (; b; b = b->link.next) {
+  for (fi = si; fi <= ei; fi++) {
+    for (EvacuationBlock *b = evacuate[fi].head; b; b = b->link.next) {
       int64_t offset = dir_offset(&b->dir);
       int phase = dir_phase(&b->dir);
       if (offset >= s && offset < e && !b->f.done && phase == evac_phase)
@@ -688,26 +763,66 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
           first_offset = offset;
         }
     }
-    if (first) {
-      first->f.done = 1;
-      io.aiocb.aio_fildes = fd;
-      io.aiocb.aio_nbytes = dir_approx_size(&first->dir);
-      io.aiocb.aio_offset = vol_offset(this, &first->dir);
-      if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(skip + len))
-        io.aiocb.aio_nbytes = skip + len - io.aiocb.aio_offset;
-      doc_evacuator = new_DocEvacuator(io.aiocb.aio_nbytes, this);
-      doc_evacuator->overwrite_dir = first->dir;
-
-      io.aiocb.aio_buf = doc_evacuator->buf->data();
-      io.action = this;
-      io.thread = AIO_CALLBACK_THREAD_ANY;
-      DDebug("cache_evac", "evac_range evacuating %X %d", (int)dir_tag(&first->dir), (int)dir_offset(&first->dir));
-      SET_HANDLER(&Vol::evacuateDocReadDone);
-      ink_assert(ink_aio_read(&io) >= 0);
-      return -1;
+    if (first)
+      break;
+  }
+  if (!first)
+    return 0;
+
+  off_t batch_start = vol_offset(this, &first->dir);
+  off_t batch_limit = batch_start + EVACUATION_BATCH_SIZE;
+  off_t batch_end = batch_start;
+  bool single = batch_start >= evac_single_start && batch_start < evac_single_end;
+  if (batch_limit > (off_t)(skip + len))
+    batch_limit = skip + len;
+  int bi = dir_offset_evac_bucket(offset_to_vol_offset(this, batch_limit - 1));
+  if (bi > ei)
+    bi = ei;
+  for (int i = fi; i <= bi; i++) {
+    for (EvacuationBlock *b = evacuate[i].head; b; b = b->link.next) {
+      int64_t offset = dir_offset(&b->dir);
+      if (offset < first_offset || offset >= e || b->f.done || dir_phase(&b->dir) != evac_phase)
+        continue;
+      if (single && b != first)
+        continue;
+      off_t block_end = vol_offset(this, &b->dir) + dir_approx_size(&b->dir);
+      if (block_end > batch_limit) {
+        if (b != first)
+          continue;
+        block_end = batch_limit;
+      }
+      b->f.done = 1;
+      b->f.batched = 1;
+      if (block_end > batch_end)
+        batch_end = block_end;
+      DDebug("cache_evac", "evac_range evacuating %X %d", (int)dir_tag(&b->dir), (int)offset);
     }
   }
-  return 0;
+
+  if (!evac_buffer)
+    evac_buffer = (char *)ats_memalign(ats_pagesize(), EVACUATION_BATCH_SIZE);
+  evac_buffer_offset = batch_start;
+  evac_buffer_len = batch_end - batch_start;
+  if (!single)
+    evac_single_start = evac_single_end = 0;
+  {
+    Vol *vol = this;
+    CACHE_INCREMENT_DYN_STAT(cache_evacuate_batch_reads_stat);
+    CACHE_SUM_DYN_STAT(cache_evacuate_read_bytes_stat, evac_buffer_len);
+  }
+  // the aggregation buffer is ready to go, but has to wait for the read
+  if (agg_buf_pos >= AGG_HIGH_WATER || agg.head || sync.head || dir_sync_waiting)
+    evac_write_deferred = true;
+
+  io.aiocb.aio_fildes = fd;
+  io.aiocb.aio_nbytes = evac_buffer_len;
+  io.aiocb.aio_offset = batch_start;
+  io.aiocb.aio_buf = evac_buffer;
+  io.action = this;
+  io.thread = AIO_CALLBACK_THREAD_ANY;
+  SET_HANDLER(&Vol::evacuateDocReadDone);
+  ink_assert(ink_aio_read(&io) >= 0);
+  return -1;
 }
 
 
@@ -843,10 +958,10 @@ agg_copy(char *p, CacheVC *vc)
     Doc *doc = (Doc *)vc->buf->data();
     int l = vc->vol->round_to_approx_size(doc->len);
     {
-      ProxyMutex *mutex ATS_UNUSED = vc->vol->mutex;
+      ProxyMutex *mutex = vc->vol->mutex;
       ink_assert(mutex->thread_holding == this_ethread());
-      CACHE_DEBUG_INCREMENT_DYN_STAT(cache_gc_frags_evacuated_stat);
-      CACHE_DEBUG_SUM_DYN_STAT(cache_gc_bytes_evacuated_stat, l);
+      CACHE_INCREMENT_DYN_STAT(cache_gc_frags_evacuated_stat);
+      CACHE_SUM_DYN_STAT(cache_gc_bytes_evacuated_stat, l);
     }
 
     doc->sync_serial = vc->vol->header->sync_serial;
@@ -910,6 +1025,7 @@ Vol::periodic_scan()
 {
   evacuate_cleanup();
   scan_for_pinned_documents();
+  scan_for_demotion();
   if (header->write_pos == start)
     scan_pos = start;
   scan_pos += len / PIN_SCAN_EVERY;
@@ -1030,6 +1146,12 @@ Lagain:
   // set write limit
   header->agg_pos = header->write_pos + agg_buf_pos;
 
+  if (evac_write_deferred) {
+    Vol *vol = this;
+    CACHE_INCREMENT_DYN_STAT(cache_evacuate_deferred_writes_stat);
+    evac_write_deferred = false;
+  }
+
   io.aiocb.aio_fildes = fd;
   io.aiocb.aio_offset = header->write_pos;
   io.aiocb.aio_buf = agg_buffer;
@@ -1670,6 +1792,7 @@ Cache::open_write(Continuation *cont, const CacheKey *key, CacheHTTPInfo *info,
   c->frag_type = CACHE_FRAG_TYPE_HTTP;
   c->vol = key_to_vol(key, hostname, host_len);
   Vol *vol = c->vol;
+  tier_invalidate(key);
   c->info = info;
   if (c->info && (uintptr_t)info != CACHE_ALLOW_MULTIPLE_WRITES) {
     /*
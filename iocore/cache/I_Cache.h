@@ -99,6 +99,10 @@ struct CacheProcessor : public Processor {
                      CacheFragType frag_type = CACHE_FRAG_TYPE_HTTP);
   Action *remove(Continuation *cont, const HttpCacheKey *key, bool cluster_cache_local,
                  CacheFragType frag_type = CACHE_FRAG_TYPE_HTTP);
+  /// Record a request for a document that is not in the cache, and return
+  /// whether the admission filter lets it be written. @a filter is the
+  /// transaction setting, used unless the volume sets admission= itself.
+  bool admit(const HttpCacheKey *key, bool filter, CacheFragType frag_type = CACHE_FRAG_TYPE_HTTP);
 #endif
   Action *link(Continuation *cont, CacheKey *from, CacheKey *to, bool cluster_cache_local,
                CacheFragType frag_type = CACHE_FRAG_TYPE_HTTP, char *hostname = 0, int host_len = 0);
@@ -0,0 +1,71 @@
+/** @file
+
+  Admission filter for new cache documents
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_CACHE_ADMISSION_H__
+#define _P_CACHE_ADMISSION_H__
+
+#include "ts/ink_mutex.h"
+#include "ts/CryptoHash.h"
+
+// admission= setting of a volume in volume.config
+enum CacheAdmissionMode {
+  CACHE_ADMISSION_DEFAULT, // follow proxy.config.http.cache.admission_filter
+  CACHE_ADMISSION_OFF,
+  CACHE_ADMISSION_ON,
+};
+
+// TinyLFU style admission filter.  Every request for a document which is
+// not in the cache is recorded, first in a bloom filter (the doorkeeper)
+// and, once the doorkeeper has seen the key, in a count-min sketch of 4 bit
+// counters.  A document is admitted once it has been requested a threshold
+// number of times.  The sketch is aged by halving all the counters and
+// clearing the doorkeeper every sample_size requests, so the frequencies
+// follow the recent request stream.
+struct CacheAdmission {
+  // records a request for key and returns true if it should be written
+  bool admit(const CryptoHash *key, int threshold);
+  // returns the number of recent requests recorded for key
+  int frequency(const CryptoHash *key);
+  // size the filter for a cache holding up to entries documents
+  void init(int64_t entries);
+
+  CacheAdmission();
+  ~CacheAdmission();
+
+  // private
+  ink_mutex mutex;
+  uint64_t *sketch;     // 16 counters per word, CACHE_ADMISSION_ROWS rows
+  uint64_t *doorkeeper; // bloom filter bits
+  int width_bits;       // counters per row is 1 << width_bits
+  int64_t additions;
+  int64_t sample_size;
+
+  void allocate();
+  void reset();
+  int increment(uint64_t h);
+  int estimate(uint64_t h);
+  bool doorkeeper_set(uint64_t h);
+  bool doorkeeper_test(uint64_t h);
+};
+
+#endif /* _P_CACHE_ADMISSION_H__ */
@@ -34,7 +34,7 @@ struct CacheHostResult;
 struct Cache;
 
 struct CacheHostRecord {
-  int Init(CacheType typ);
+  int Init(CacheType typ, bool fast_tier = false);
   int Init(matcher_line *line_info, CacheType typ);
   void UpdateMatch(CacheHostResult *r, char *rd);
   void Print();
@@ -177,6 +177,8 @@ struct ConfigVol {
   off_t size;
   bool in_percent;
   int percent;
+  bool fast_tier;
+  CacheAdmissionMode admission;
   CacheVol *cachep;
   LINK(ConfigVol, link);
 };
@@ -145,6 +145,15 @@ enum {
   cache_read_busy_failure_stat,
   cache_gc_bytes_evacuated_stat,
   cache_gc_frags_evacuated_stat,
+  cache_evacuate_batch_reads_stat,
+  cache_evacuate_read_bytes_stat,
+  cache_evacuate_deferred_writes_stat,
+  cache_admission_admitted_stat,
+  cache_admission_rejected_stat,
+  cache_tier_fast_hits_stat,
+  cache_tier_slow_hits_stat,
+  cache_tier_promotions_stat,
+  cache_tier_demotions_stat,
   cache_write_bytes_stat,
   cache_hdr_vector_marshal_stat,
   cache_hdr_marshal_stat,
@@ -157,7 +166,15 @@ enum {
 };
 
 
+// Latency histograms, in microseconds
+enum {
+  cache_tier_fast_read_histogram,
+  cache_tier_slow_read_histogram,
+  cache_histogram_count
+};
+
 extern RecRawStatBlock *cache_rsb;
+extern RecRawHistogramBlock *cache_rhb;
 
 #define GLOBAL_CACHE_SET_DYN_STAT(x, y) RecSetGlobalRawStatSum(cache_rsb, (x), (y))
 
@@ -213,6 +230,10 @@ extern int cache_config_ram_cache_compress_percent;
 extern int cache_config_ram_cache_use_seen_filter;
 extern int cache_config_hit_evacuate_percent;
 extern int cache_config_hit_evacuate_size_limit;
+extern int cache_config_admission_threshold;
+extern bool cache_admission_forced;
+extern int cache_config_tier_promote_threshold;
+extern int cache_config_tier_demote;
 extern int cache_config_force_sector_size;
 extern int cache_config_target_fragment_size;
 extern int cache_config_mutex_retry_delay;
@@ -357,6 +378,9 @@ struct CacheVC : public CacheVConnection {
   }
   int evacuateDocDone(int event, Event *e);
   int evacuateReadHead(int event, Event *e);
+  int tierCopyStart(int event, Event *e);
+  int tierCopyDone(int event, Event *e);
+  void tier_read_done();
 
   void cancel_trigger();
   virtual int64_t get_object_size();
@@ -449,6 +473,7 @@ struct CacheVC : public CacheVConnection {
   ContinuationHandler save_handler;
   uint32_t pin_in_cache;
   ink_hrtime start_time;
+  uint32_t tier_generation; // of the key on the fast tier volume, when a promotion was started
   int base_stat;
   int recursive;
   int closed;
@@ -996,9 +1021,15 @@ struct Cache {
 
   Vol *key_to_vol(const CacheKey *key, char const *hostname, int host_len);
 
+  // fast tier, see CacheTier.cc
+  CacheHostRecord *tier_host_rec; // volumes with tier=fast, NULL if there are none
+  Vol *tier_vol(const CacheKey *key);
+  Vol *tier_lookup(const CacheKey *key, EThread *t);
+  void tier_invalidate(const CacheKey *key);
+
   Cache()
     : cache_read_done(0), total_good_nvol(0), total_nvol(0), ready(CACHE_INITIALIZING), cache_size(0), // in store block size
-      hosttable(NULL), total_initialized_vol(0), scheme(CACHE_NONE_TYPE)
+      hosttable(NULL), total_initialized_vol(0), scheme(CACHE_NONE_TYPE), tier_host_rec(NULL)
   {
   }
 };
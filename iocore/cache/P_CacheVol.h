@@ -51,6 +51,7 @@
 #define LOOKASIDE_SIZE 256
 #define EVACUATION_BUCKET_SIZE (2 * EVACUATION_SIZE) // 16MB
 #define RECOVERY_SIZE EVACUATION_SIZE                // 8MB
+#define EVACUATION_BATCH_SIZE AGG_SIZE               // 4MB
 #define AIO_NOT_IN_PROGRESS 0
 #define AIO_AGG_WRITE_IN_PROGRESS -1
 #define AUTO_SIZE_RAM_CACHE -1                             // 1-1 with directory size
@@ -77,6 +78,7 @@ struct CacheDisk;
 struct VolInitInfo;
 struct DiskVol;
 struct CacheVol;
+struct Doc;
 
 struct VolHeaderFooter {
   unsigned int magic;
@@ -110,7 +112,9 @@ struct EvacuationBlock {
       unsigned int done : 1;          // has been evacuated
       unsigned int pinned : 1;        // check pinning timeout
       unsigned int evacuate_head : 1; // check pinning timeout
-      unsigned int unused : 29;
+      unsigned int batched : 1;       // part of the evacuation read in progress
+      unsigned int demote : 1;        // move to the slow tier rather than evacuate
+      unsigned int unused : 27;
     } f;
   };
 
@@ -124,6 +128,16 @@ struct EvacuationBlock {
 };
 
 
+// Invalidations are counted per slot of the key hash, so that a promotion
+// is only dropped by a write to its own key (or a rare collision).
+#define TIER_GENERATION_SLOTS 1024
+
+// Key of a document to drop from a fast tier volume
+struct TierInvalidation {
+  CryptoHash key;
+  SLINK(TierInvalidation, link);
+};
+
 struct Vol : public Continuation {
   char *path;
   ats_scoped_str hash_text;
@@ -157,10 +171,19 @@ struct Vol : public Continuation {
 
   OpenDir open_dir;
   RamCache *ram_cache;
+  CacheAdmission admission;
+  CacheAdmission tier_hits;                                  // hit frequencies, for promotion to the fast tier
+  ASLL(TierInvalidation, link) tier_invalidations;           // documents rewritten since they were promoted here
+  volatile uint32_t tier_generations[TIER_GENERATION_SLOTS]; // invalidations pushed, by key hash
   int evacuate_size;
   DLL<EvacuationBlock> *evacuate;
   DLL<EvacuationBlock> lookaside[LOOKASIDE_SIZE];
-  CacheVC *doc_evacuator;
+  char *evac_buffer;
+  off_t evac_buffer_offset;
+  int evac_buffer_len;
+  off_t evac_single_start; // blocks of a failed batch read, read again one at a time
+  off_t evac_single_end;
+  bool evac_write_deferred; // the pending aggregation write waits for an evacuation read
 
   VolInitInfo *init_info;
 
@@ -238,7 +261,7 @@ struct Vol : public Continuation {
   int aggWrite(int event, void *e);
   void agg_wrap();
 
-  int evacuateWrite(CacheVC *evacuator, int event, Event *e);
+  CacheVC *evacuate_block(EvacuationBlock *b);
   int evacuateDocReadDone(int event, Event *e);
   int evacuateDoc(int event, Event *e);
 
@@ -251,19 +274,36 @@ struct Vol : public Continuation {
   int within_hit_evacuate_window(Dir *dir);
   uint32_t round_to_approx_size(uint32_t l);
 
+  volatile uint32_t *
+  tier_generation(const CacheKey *key)
+  {
+    return &tier_generations[key->slice32(3) % TIER_GENERATION_SLOTS];
+  }
+  void tier_invalidate(const CacheKey *key);
+  void tier_apply_invalidations();
+  void scan_for_demotion();
+  void tier_demote(EvacuationBlock *b, Doc *doc);
+
   Vol()
     : Continuation(new_ProxyMutex()), path(NULL), fd(-1), dir(0), buckets(0), recover_pos(0), prev_recover_pos(0), scan_pos(0),
       skip(0), start(0), len(0), data_blocks(0), hit_evacuate_window(0), agg_todo_size(0), agg_buf_pos(0), trigger(0),
-      evacuate_size(0), disk(NULL), last_sync_serial(0), last_write_serial(0), recover_wrapped(false), dir_sync_waiting(0),
-      dir_sync_in_progress(0), writing_end_marker(0)
+      evacuate_size(0), evac_buffer(NULL), evac_buffer_offset(0), evac_buffer_len(0), evac_single_start(0), evac_single_end(0),
+      evac_write_deferred(false), disk(NULL), last_sync_serial(0), last_write_serial(0), recover_wrapped(false),
+      dir_sync_waiting(0), dir_sync_in_progress(0), writing_end_marker(0)
   {
     open_dir.mutex = mutex;
+    memset((void *)tier_generations, 0, sizeof(tier_generations));
     agg_buffer = (char *)ats_memalign(ats_pagesize(), AGG_SIZE);
     memset(agg_buffer, 0, AGG_SIZE);
     SET_HANDLER(&Vol::aggWrite);
   }
 
-  ~Vol() { ats_memalign_free(agg_buffer); }
+  ~Vol()
+  {
+    ats_memalign_free(agg_buffer);
+    if (evac_buffer)
+      ats_memalign_free(evac_buffer);
+  }
 };
 
 struct AIO_Callback_handler : public Continuation {
@@ -277,13 +317,19 @@ struct CacheVol {
   int scheme;
   off_t size;
   int num_vols;
+  bool fast_tier;               // tier=fast in volume.config
+  CacheAdmissionMode admission; // admission= in volume.config
   Vol **vols;
   DiskVol **disk_vols;
   LINK(CacheVol, link);
   // per volume stats
   RecRawStatBlock *vol_rsb;
 
-  CacheVol() : vol_number(-1), scheme(0), size(0), num_vols(0), vols(NULL), disk_vols(0), vol_rsb(0) {}
+  CacheVol()
+    : vol_number(-1), scheme(0), size(0), num_vols(0), fast_tier(false), admission(CACHE_ADMISSION_DEFAULT), vols(NULL),
+      disk_vols(0), vol_rsb(0)
+  {
+  }
 };
 
 // Note : hdr() needs to be 8 byte aligned.
@@ -235,6 +235,7 @@ RamCacheCLFUS::get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1,
     return 0;
   int64_t i = key->slice32(3) % nbuckets;
   RamCacheCLFUSEntry *e = bucket[i].head;
+  IOBufferData *udata = 0;
   char *b = 0;
   while (e) {
     if (e->key == *key && e->auxkey1 == auxkey1 && e->auxkey2 == auxkey2) {
@@ -247,7 +248,9 @@ RamCacheCLFUS::get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1,
         e->hits++;
         uint32_t ram_hit_state = RAM_HIT_COMPRESS_NONE;
         if (e->flag_bits.compressed) {
-          b = (char *)ats_malloc(e->len);
+          // Decompress into a pooled buffer, so the hot copy lives in the (huge page backed) IOBuffer memory.
+          udata = new_IOBufferData(iobuffer_size_to_index(e->len, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+          b = udata->data();
           switch (e->flag_bits.compressed) {
           default:
             goto Lfailed;
@@ -279,13 +282,13 @@ RamCacheCLFUS::get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1,
           }
 #endif
           }
-          IOBufferData *data = new_xmalloc_IOBufferData(b, e->len);
-          data->_mem_type = DEFAULT_ALLOC;
+          IOBufferData *data = udata;
           if (!e->flag_bits.copy) { // don't bother if we have to copy anyway
-            int64_t delta = ((int64_t)e->compressed_len) - (int64_t)e->size;
+            // Charge the whole pooled block, as put() does for uncopied data.
+            int64_t delta = ((int64_t)data->block_size()) - (int64_t)e->size;
             bytes += delta;
             CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, delta);
-            e->size = e->compressed_len;
+            e->size = data->block_size();
             check_accounting(this);
             e->flag_bits.compressed = 0;
             e->data = data;
@@ -316,7 +319,7 @@ Lerror:
   CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_misses_stat, 1);
   return 0;
 Lfailed:
-  ats_free(b);
+  udata->free();
   destroy(e);
   DDebug("ram_cache", "get %X %d %d Z_ERR", key->slice32(3), auxkey1, auxkey2);
   goto Lerror;
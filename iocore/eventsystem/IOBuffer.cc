@@ -27,11 +27,14 @@
 **************************************************************************/
 #include "ts/ink_defs.h"
 #include "P_EventSystem.h"
+#include "ts/TestBox.h"
 
 //
 // General Buffer Allocator
 //
 inkcoreapi Allocator ioBufAllocator[DEFAULT_BUFFER_SIZES];
+inkcoreapi int ioBufNumaNodes = 1;
+static Allocator *ioBufNodeAllocator[MAX_NUMA_NODES];
 inkcoreapi ClassAllocator<MIOBuffer> ioAllocator("ioAllocator", DEFAULT_BUFFER_NUMBER);
 inkcoreapi ClassAllocator<IOBufferData> ioDataAllocator("ioDataAllocator", DEFAULT_BUFFER_NUMBER);
 inkcoreapi ClassAllocator<IOBufferBlock> ioBlockAllocator("ioBlockAllocator", DEFAULT_BUFFER_NUMBER);
@@ -42,8 +45,8 @@ int64_t max_iobuffer_size = DEFAULT_BUFFER_SIZES - 1;
 //
 // Initialization
 //
-void
-init_buffer_allocators()
+static void
+init_buffer_pools(Allocator *pools, int node)
 {
   char *name;
   int advice = 0;
@@ -60,9 +63,63 @@ init_buffer_allocators()
       a = s;
 
     name = new char[64];
-    snprintf(name, 64, "ioBufAllocator[%d]", i);
-    ioBufAllocator[i].re_init(name, s, n, a, advice);
+    if (node == 0)
+      snprintf(name, 64, "ioBufAllocator[%d]", i);
+    else
+      snprintf(name, 64, "ioBufAllocator[%d][%d]", node, i);
+    pools[i].re_init(name, s, n, a, advice);
+  }
+}
+
+void
+init_buffer_allocators()
+{
+  init_buffer_pools(ioBufAllocator, 0);
+  ioBufNodeAllocator[0] = ioBufAllocator;
+}
+
+//
+// NUMA node pools
+//
+RecRawStatBlock *ioBufNumaRsb = NULL;
+
+// Called by the EventProcessor before the event threads start.  The
+// freelists of a pool are refilled by the threads of its node, so the
+// memory is first touched, and placed, on that node.
+void
+init_buffer_numa_pools(int n_nodes)
+{
+  ink_release_assert(n_nodes <= MAX_NUMA_NODES);
+  for (int node = 1; node < n_nodes; node++) {
+    if (!ioBufNodeAllocator[node]) {
+      ioBufNodeAllocator[node] = new Allocator[DEFAULT_BUFFER_SIZES];
+      init_buffer_pools(ioBufNodeAllocator[node], node);
+    }
   }
+  ioBufNumaNodes = n_nodes;
+}
+
+void *
+iobuffer_numa_alloc(int64_t size_index, int *node)
+{
+  EThread *t = this_ethread();
+  int n = t ? t->numa_node : 0;
+
+  if (t && ioBufNumaRsb)
+    RecIncrRawStat(ioBufNumaRsb, t, n * iobuf_numa_stat_count + iobuf_numa_allocs_stat, 1);
+  *node = n;
+  return ioBufNodeAllocator[n][size_index].alloc_void();
+}
+
+void
+iobuffer_numa_free(void *b, int64_t size_index, int node)
+{
+  EThread *t = this_ethread();
+
+  // count buffers released on another node than the one they live on
+  if (t && ioBufNumaRsb && t->numa_node != node)
+    RecIncrRawStat(ioBufNumaRsb, t, node * iobuf_numa_stat_count + iobuf_numa_remote_frees_stat, 1);
+  ioBufNodeAllocator[node][size_index].free_void(b);
 }
 
 int64_t
@@ -273,3 +330,61 @@ IOBufferReader::memcpy(const void *ap, int64_t len, int64_t offset)
 
   return p;
 }
+
+#if TS_HAS_TESTS
+// Runs the per node pools on a single node host by setting up a second
+// node and moving the test thread between the two.
+REGRESSION_TEST(IOBuffer_numa_pools)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  EThread *thread = this_ethread();
+  int saved_nodes = ioBufNumaNodes;
+  int saved_node = thread->numa_node;
+  int64_t size_index = BUFFER_SIZE_INDEX_4K;
+  char pattern[1000];
+
+  box = REGRESSION_TEST_PASSED;
+  if (saved_nodes < 2) {
+    init_buffer_numa_pools(2);
+  }
+
+  // a buffer comes from the pool of the allocating thread's node
+  thread->numa_node = 0;
+  IOBufferData *d0 = new_IOBufferData(size_index);
+  box.check(d0->_numa_node == 0, "buffer allocated on node 0 is in pool %d", d0->_numa_node);
+  thread->numa_node = 1;
+  IOBufferData *d1 = new_IOBufferData(size_index);
+  box.check(d1->_numa_node == 1, "buffer allocated on node 1 is in pool %d", d1->_numa_node);
+  box.check(d0->data() != d1->data(), "both nodes handed out the same buffer");
+
+  // and goes back to that pool when it is freed on another node
+  thread->numa_node = 0;
+  d1->free();
+  thread->numa_node = 1;
+  d0->free();
+
+  // data written through buffers of one node reads back on the other
+  for (unsigned i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = (char)i;
+  }
+  thread->numa_node = 1;
+  MIOBuffer *b = new_MIOBuffer(size_index);
+  IOBufferReader *r = b->alloc_reader();
+  for (int i = 0; i < 20; i++) {
+    b->write(pattern, sizeof(pattern));
+  }
+  box.check(b->first_write_block()->data->_numa_node == 1, "MIOBuffer block allocated on node 1 is in pool %d",
+            b->first_write_block()->data->_numa_node);
+  thread->numa_node = 0;
+  bool same = true;
+  for (int i = 0; i < 20; i++) {
+    char out[sizeof(pattern)];
+    same = same && r->read(out, sizeof(out)) == (int64_t)sizeof(out) && memcmp(out, pattern, sizeof(out)) == 0;
+  }
+  box.check(same, "data read back on node 0 differs from the data written on node 1");
+  free_MIOBuffer(b);
+
+  thread->numa_node = saved_node;
+  ioBufNumaNodes = saved_nodes;
+}
+#endif
@@ -47,6 +47,7 @@ struct DiskHandler;
 struct EventIO;
 
 class ServerSessionPool;
+class Http2ServerSessionPool;
 class Event;
 class Continuation;
 
@@ -291,6 +292,20 @@ public:
   ProtectedQueue EventQueueExternal;
   PriorityEventQueue EventQueue;
 
+  // Immediate events which any ET_CALL thread may run, see
+  // EventProcessor::work_stealing. Producers push on StealQueue, the
+  // thread dequeuing moves them to StealLocal in arrival order.
+  InkAtomicList StealQueue;
+  Que(Event, link) StealLocal;
+  ink_mutex steal_lock; // protects StealLocal
+  volatile int steal_queue_length;
+  int64_t events_stolen; // events taken from other threads' StealQueue
+  void enqueue_stealable(Event *e, bool fast_signal);
+  int dequeue_stealable(Que(Event, link) & q, int max);
+  void run_stealable();
+  bool may_steal(ink_hrtime now);
+  void steal_events();
+
   EThread **ethreads_to_be_signalled;
   int n_ethreads_to_be_signalled;
 
@@ -298,6 +313,7 @@ public:
   int main_accept_index;
 
   int id;
+  int numa_node; // NUMA node the thread is bound to, 0 if not bound
   unsigned int event_types;
   bool is_event_type(EventType et);
   void set_event_type(EventType et);
@@ -320,6 +336,7 @@ public:
   Event *oneevent; // For dedicated event thread
 
   ServerSessionPool *server_session_pool;
+  Http2ServerSessionPool *h2_server_session_pool;
 };
 
 /**
@@ -41,6 +41,8 @@ const int MAX_EVENT_THREADS = TS_MAX_NUMBER_EVENT_THREADS;
 const int MAX_EVENT_THREADS = 4096;
 #endif
 
+const int MAX_NUMA_NODES = 8;
+
 class EThread;
 
 /**
@@ -299,6 +301,8 @@ private:
   EventProcessor(const EventProcessor &);
   EventProcessor &operator=(const EventProcessor &);
 
+  void setup_numa_nodes(int obj_type, int obj_count);
+
 public:
   /*------------------------------------------------------*\
   | Unix & non NT Interface                                |
@@ -307,6 +311,48 @@ public:
   Event *schedule(Event *e, EventType etype, bool fast_signal = false);
   EThread *assign_thread(EventType etype);
 
+  /**
+    Returns an ET_CALL thread bound to the given NUMA node, or any
+    ET_CALL thread if there is none.
+
+  */
+  EThread *assign_thread_on_node(int node);
+
+  /**
+    Binds the calling dedicated thread to the CPUs of a NUMA node.
+
+  */
+  void bind_to_numa_node(int node);
+
+  /**
+    Returns the NUMA node of the device holding the file descriptor,
+    or -1 if it is not known or the threads are not spread over NUMA
+    nodes.
+
+  */
+  int numa_node_of_fd(int fd);
+
+  /**
+    Number of NUMA nodes the ET_CALL threads are spread over. This is 1
+    unless proxy.config.exec_thread.numa is set and the threads are
+    bound to more than one NUMA node, in which case every node gets its
+    own IOBuffer pools.
+
+  */
+  int n_numa_nodes;
+  int n_threads_for_node[MAX_NUMA_NODES];
+  unsigned int next_thread_for_node[MAX_NUMA_NODES];
+  EThread **threads_for_node[MAX_NUMA_NODES];
+
+  /**
+    When set, immediate events scheduled on ET_CALL without a specific
+    thread, whose continuation has its own mutex, can be run by any
+    ET_CALL thread: a thread which has run out of work takes them from
+    the queues of the others. See proxy.config.exec_thread.work_stealing.
+
+  */
+  int work_stealing;
+
   EThread *all_dthreads[MAX_EVENT_THREADS];
   int n_dthreads; // No. of dedicated threads
   volatile int thread_data_used;
@@ -128,6 +128,25 @@ inkcoreapi extern Allocator ioBufAllocator[DEFAULT_BUFFER_SIZES];
 
 void init_buffer_allocators();
 
+// Per NUMA node buffer pools.  ioBufAllocator is the pool of node 0; the
+// pools of the other nodes are only used once init_buffer_numa_pools has
+// been called, when the event threads are spread over several nodes.
+inkcoreapi extern int ioBufNumaNodes;
+void init_buffer_numa_pools(int n_nodes);
+void *iobuffer_numa_alloc(int64_t size_index, int *node);
+void iobuffer_numa_free(void *b, int64_t size_index, int node);
+
+// Per node stats, ids are node * iobuf_numa_stat_count + stat.  The block
+// is registered by traffic_server once the event threads are running.
+enum IOBufferNumaStat {
+  iobuf_numa_allocs_stat,
+  iobuf_numa_remote_frees_stat,
+  iobuf_numa_stat_count,
+};
+
+struct RecRawStatBlock;
+extern RecRawStatBlock *ioBufNumaRsb;
+
 /**
   A reference counted wrapper around fast allocated or malloced memory.
   The IOBufferData class provides two basic services around a portion
@@ -243,6 +262,13 @@ public:
   */
   AllocType _mem_type;
 
+  /**
+    NUMA node of the buffer pool the fast allocated memory came from, the
+    memory is returned to the same pool.
+
+  */
+  int _numa_node;
+
   /**
     Points to the allocated memory. This member stores the address of
     the allocated memory. You should not modify its value directly,
@@ -261,7 +287,7 @@ public:
 
   */
   IOBufferData()
-    : _size_index(BUFFER_SIZE_NOT_ALLOCATED), _mem_type(NO_ALLOC), _data(NULL)
+    : _size_index(BUFFER_SIZE_NOT_ALLOCATED), _mem_type(NO_ALLOC), _numa_node(0), _data(NULL)
 #ifdef TRACK_BUFFER_USER
       ,
       _location(NULL)
@@ -55,5 +55,6 @@ struct ProtectedQueue {
 };
 
 void flush_signals(EThread *t);
+void signal_ethread(EThread *t, bool fast_signal);
 
 #endif
@@ -256,6 +256,25 @@ new_IOBufferData_internal(
   return d;
 }
 
+TS_INLINE void *
+iobuffer_fast_alloc(int64_t size_index, int *node)
+{
+  if (likely(ioBufNumaNodes <= 1)) {
+    *node = 0;
+    return ioBufAllocator[size_index].alloc_void();
+  }
+  return iobuffer_numa_alloc(size_index, node);
+}
+
+TS_INLINE void
+iobuffer_fast_free(void *b, int64_t size_index, int node)
+{
+  if (likely(ioBufNumaNodes <= 1))
+    ioBufAllocator[size_index].free_void(b);
+  else
+    iobuffer_numa_free(b, size_index, node);
+}
+
 // IRIX has a compiler bug which prevents this function
 // from being compiled correctly at -O3
 // so it is DUPLICATED in IOBuffer.cc
@@ -273,7 +292,7 @@ IOBufferData::alloc(int64_t size_index, AllocType type)
   switch (type) {
   case MEMALIGNED:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index))
-      _data = (char *)ioBufAllocator[size_index].alloc_void();
+      _data = (char *)iobuffer_fast_alloc(size_index, &_numa_node);
     // coverity[dead_error_condition]
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(size_index))
       _data = (char *)ats_memalign(ats_pagesize(), index_to_buffer_size(size_index));
@@ -281,7 +300,7 @@ IOBufferData::alloc(int64_t size_index, AllocType type)
   default:
   case DEFAULT_ALLOC:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index))
-      _data = (char *)ioBufAllocator[size_index].alloc_void();
+      _data = (char *)iobuffer_fast_alloc(size_index, &_numa_node);
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(size_index))
       _data = (char *)ats_malloc(BUFFER_SIZE_FOR_XMALLOC(size_index));
     break;
@@ -300,14 +319,14 @@ IOBufferData::dealloc()
   switch (_mem_type) {
   case MEMALIGNED:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(_size_index))
-      ioBufAllocator[_size_index].free_void(_data);
+      iobuffer_fast_free(_data, _size_index, _numa_node);
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(_size_index))
       ::free((void *)_data);
     break;
   default:
   case DEFAULT_ALLOC:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(_size_index))
-      ioBufAllocator[_size_index].free_void(_data);
+      iobuffer_fast_free(_data, _size_index, _numa_node);
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(_size_index))
       ats_free(_data);
     break;
@@ -315,6 +334,7 @@ IOBufferData::dealloc()
   _data = 0;
   _size_index = BUFFER_SIZE_NOT_ALLOCATED;
   _mem_type = NO_ALLOC;
+  _numa_node = 0;
 }
 
 TS_INLINE void
@@ -516,8 +536,10 @@ IOBufferBlock::realloc(int64_t i)
   }
 
   ink_release_assert(i > data->_size_index && i != BUFFER_SIZE_NOT_ALLOCATED);
-  void *b = ioBufAllocator[i].alloc_void();
+  int node;
+  void *b = iobuffer_fast_alloc(i, &node);
   realloc_set_internal(b, BUFFER_SIZE_FOR_INDEX(i), i);
+  data->_numa_node = node;
 }
 
 //////////////////////////////////////////////////////////////////
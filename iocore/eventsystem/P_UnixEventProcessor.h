@@ -31,12 +31,16 @@ const int LOAD_BALANCE_INTERVAL = 1;
 
 
 TS_INLINE
-EventProcessor::EventProcessor() : n_ethreads(0), n_thread_groups(0), n_dthreads(0), thread_data_used(0)
+EventProcessor::EventProcessor()
+  : n_ethreads(0), n_thread_groups(0), n_numa_nodes(1), work_stealing(0), n_dthreads(0), thread_data_used(0)
 {
   memset(all_ethreads, 0, sizeof(all_ethreads));
   memset(all_dthreads, 0, sizeof(all_dthreads));
   memset(n_threads_for_type, 0, sizeof(n_threads_for_type));
   memset(next_thread_for_type, 0, sizeof(next_thread_for_type));
+  memset(n_threads_for_node, 0, sizeof(n_threads_for_node));
+  memset(next_thread_for_node, 0, sizeof(next_thread_for_node));
+  memset(threads_for_node, 0, sizeof(threads_for_node));
 }
 
 TS_INLINE off_t
@@ -69,6 +73,14 @@ EventProcessor::assign_thread(EventType etype)
   return (eventthread[etype][next]);
 }
 
+TS_INLINE EThread *
+EventProcessor::assign_thread_on_node(int node)
+{
+  if (node < 0 || node >= n_numa_nodes || n_threads_for_node[node] == 0)
+    return assign_thread(ET_CALL);
+  return threads_for_node[node][next_thread_for_node[node]++ % n_threads_for_node[node]];
+}
+
 TS_INLINE Event *
 EventProcessor::schedule(Event *e, EventType etype, bool fast_signal)
 {
@@ -78,7 +90,10 @@ EventProcessor::schedule(Event *e, EventType etype, bool fast_signal)
     e->mutex = e->continuation->mutex;
   else
     e->mutex = e->continuation->mutex = e->ethread->mutex;
-  e->ethread->EventQueueExternal.enqueue(e, fast_signal);
+  if (work_stealing && etype == ET_CALL && e->immediate && e->mutex != e->ethread->mutex)
+    e->ethread->enqueue_stealable(e, fast_signal);
+  else
+    e->ethread->EventQueueExternal.enqueue(e, fast_signal);
   return e;
 }
 
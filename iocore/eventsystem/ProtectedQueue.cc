@@ -52,55 +52,62 @@ ProtectedQueue::enqueue(Event *e, bool fast_signal)
   e->in_the_prot_queue = 1;
   bool was_empty = (ink_atomiclist_push(&al, e) == NULL);
 
-  if (was_empty) {
-    EThread *inserting_thread = this_ethread();
-    // queue e->ethread in the list of threads to be signalled
-    // inserting_thread == 0 means it is not a regular EThread
-    if (inserting_thread != e_ethread) {
-      if (!inserting_thread || !inserting_thread->ethreads_to_be_signalled) {
-        signal();
-        if (fast_signal) {
-          if (e_ethread->signal_hook)
-            e_ethread->signal_hook(e_ethread);
-        }
-      } else {
+  if (was_empty)
+    signal_ethread(e_ethread, fast_signal);
+}
+
+// Wake up e_ethread, which has just been given work by the calling thread.
+// Regular EThreads defer the signal until they go to sleep themselves.
+void
+signal_ethread(EThread *e_ethread, bool fast_signal)
+{
+  EThread *inserting_thread = this_ethread();
+  // queue e->ethread in the list of threads to be signalled
+  // inserting_thread == 0 means it is not a regular EThread
+  if (inserting_thread != e_ethread) {
+    if (!inserting_thread || !inserting_thread->ethreads_to_be_signalled) {
+      e_ethread->EventQueueExternal.signal();
+      if (fast_signal) {
+        if (e_ethread->signal_hook)
+          e_ethread->signal_hook(e_ethread);
+      }
+    } else {
 #ifdef EAGER_SIGNALLING
-        // Try to signal now and avoid deferred posting.
-        if (e_ethread->EventQueueExternal.try_signal())
-          return;
+      // Try to signal now and avoid deferred posting.
+      if (e_ethread->EventQueueExternal.try_signal())
+        return;
 #endif
-        if (fast_signal) {
-          if (e_ethread->signal_hook)
-            e_ethread->signal_hook(e_ethread);
-        }
-        int &t = inserting_thread->n_ethreads_to_be_signalled;
-        EThread **sig_e = inserting_thread->ethreads_to_be_signalled;
-        if ((t + 1) >= eventProcessor.n_ethreads) {
-          // we have run out of room
-          if ((t + 1) == eventProcessor.n_ethreads) {
-            // convert to direct map, put each ethread (sig_e[i]) into
-            // the direct map loation: sig_e[sig_e[i]->id]
-            for (int i = 0; i < t; i++) {
-              EThread *cur = sig_e[i]; // put this ethread
-              while (cur) {
-                EThread *next = sig_e[cur->id]; // into this location
-                if (next == cur)
-                  break;
-                sig_e[cur->id] = cur;
-                cur = next;
-              }
-              // if not overwritten
-              if (sig_e[i] && sig_e[i]->id != i)
-                sig_e[i] = 0;
+      if (fast_signal) {
+        if (e_ethread->signal_hook)
+          e_ethread->signal_hook(e_ethread);
+      }
+      int &t = inserting_thread->n_ethreads_to_be_signalled;
+      EThread **sig_e = inserting_thread->ethreads_to_be_signalled;
+      if ((t + 1) >= eventProcessor.n_ethreads) {
+        // we have run out of room
+        if ((t + 1) == eventProcessor.n_ethreads) {
+          // convert to direct map, put each ethread (sig_e[i]) into
+          // the direct map loation: sig_e[sig_e[i]->id]
+          for (int i = 0; i < t; i++) {
+            EThread *cur = sig_e[i]; // put this ethread
+            while (cur) {
+              EThread *next = sig_e[cur->id]; // into this location
+              if (next == cur)
+                break;
+              sig_e[cur->id] = cur;
+              cur = next;
             }
-            t++;
+            // if not overwritten
+            if (sig_e[i] && sig_e[i]->id != i)
+              sig_e[i] = 0;
           }
-          // we have a direct map, insert this EThread
-          sig_e[e_ethread->id] = e_ethread;
-        } else
-          // insert into vector
-          sig_e[t++] = e_ethread;
-      }
+          t++;
+        }
+        // we have a direct map, insert this EThread
+        sig_e[e_ethread->id] = e_ethread;
+      } else
+        // insert into vector
+        sig_e[t++] = e_ethread;
     }
   }
 }
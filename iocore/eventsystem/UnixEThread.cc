@@ -38,22 +38,36 @@ struct AIOCallback;
 #define NO_HEARTBEAT -1
 #define THREAD_MAX_HEARTBEAT_MSECONDS 60
 #define NO_ETHREAD_ID -1
+#define STEAL_BATCH 8                           // most events stolen in one go
+#define STEAL_IDLE_WAKEUP (10 * HRTIME_MSECOND) // longest sleep with work stealing on
+
+static void
+init_steal_queue(EThread *t)
+{
+  ink_atomiclist_init(&t->StealQueue, "StealQueue", (uintptr_t) & ((Event *)0)->link.next);
+  ink_mutex_init(&t->steal_lock, "StealLock");
+  t->steal_queue_length = 0;
+  t->events_stolen = 0;
+}
 
 EThread::EThread()
   : generator((uint64_t)ink_get_hrtime_internal() ^ (uint64_t)(uintptr_t) this), ethreads_to_be_signalled(NULL),
-    n_ethreads_to_be_signalled(0), main_accept_index(-1), id(NO_ETHREAD_ID), event_types(0), signal_hook(0), tt(REGULAR)
+    n_ethreads_to_be_signalled(0), main_accept_index(-1), id(NO_ETHREAD_ID), numa_node(0), event_types(0), signal_hook(0),
+    tt(REGULAR)
 {
   memset(thread_private, 0, PER_THREAD_DATA);
+  init_steal_queue(this);
 }
 
 EThread::EThread(ThreadType att, int anid)
   : generator((uint64_t)ink_get_hrtime_internal() ^ (uint64_t)(uintptr_t) this), ethreads_to_be_signalled(NULL),
-    n_ethreads_to_be_signalled(0), main_accept_index(-1), id(anid), event_types(0), signal_hook(0), tt(att),
-    server_session_pool(NULL)
+    n_ethreads_to_be_signalled(0), main_accept_index(-1), id(anid), numa_node(0), event_types(0), signal_hook(0), tt(att),
+    server_session_pool(NULL), h2_server_session_pool(NULL)
 {
   ethreads_to_be_signalled = (EThread **)ats_malloc(MAX_EVENT_THREADS * sizeof(EThread *));
   memset((char *)ethreads_to_be_signalled, 0, MAX_EVENT_THREADS * sizeof(EThread *));
   memset(thread_private, 0, PER_THREAD_DATA);
+  init_steal_queue(this);
 #if HAVE_EVENTFD
   evfd = eventfd(0, O_NONBLOCK | FD_CLOEXEC);
   if (evfd < 0) {
@@ -81,10 +95,11 @@ EThread::EThread(ThreadType att, int anid)
 
 EThread::EThread(ThreadType att, Event *e)
   : generator((uint32_t)((uintptr_t)time(NULL) ^ (uintptr_t) this)), ethreads_to_be_signalled(NULL), n_ethreads_to_be_signalled(0),
-    main_accept_index(-1), id(NO_ETHREAD_ID), event_types(0), signal_hook(0), tt(att), oneevent(e)
+    main_accept_index(-1), id(NO_ETHREAD_ID), numa_node(0), event_types(0), signal_hook(0), tt(att), oneevent(e)
 {
   ink_assert(att == DEDICATED);
   memset(thread_private, 0, PER_THREAD_DATA);
+  init_steal_queue(this);
 }
 
 
@@ -146,6 +161,103 @@ EThread::process_event(Event *e, int calling_code)
   }
 }
 
+// Stealable events are pushed on a lock free list of the thread picked by
+// the EventProcessor, which signals it the same way an external event
+// would.  The thread runs them after its external events, and threads
+// with nothing left to do take them from the lists of the others.
+void
+EThread::enqueue_stealable(Event *e, bool fast_signal)
+{
+  ink_assert(!e->in_the_prot_queue && !e->in_the_priority_queue);
+  e->in_the_prot_queue = 1;
+  ink_atomic_increment(&steal_queue_length, 1);
+  if (ink_atomiclist_push(&StealQueue, e) == NULL)
+    signal_ethread(this, fast_signal);
+}
+
+// Move up to max of the oldest stealable events of this thread to q, for
+// the calling thread to run. Returns 0 if another thread is already
+// dequeuing them.
+int
+EThread::dequeue_stealable(Que(Event, link) & q, int max)
+{
+  Event *e;
+  int n = 0;
+
+  if (!ink_mutex_try_acquire(&steal_lock))
+    return 0;
+  if (!StealLocal.head) {
+    e = (Event *)ink_atomiclist_popall(&StealQueue);
+    // invert the list, to preserve order
+    SLL<Event, Event::Link_link> l, t;
+    t.head = e;
+    while ((e = t.pop()))
+      l.push(e);
+    while ((e = l.pop()))
+      StealLocal.enqueue(e);
+  }
+  while (n < max && (e = StealLocal.dequeue())) {
+    e->in_the_prot_queue = 0;
+    e->ethread = this_ethread();
+    q.enqueue(e);
+    n++;
+  }
+  ink_mutex_release(&steal_lock);
+  if (n)
+    ink_atomic_increment(&steal_queue_length, -n);
+  return n;
+}
+
+static void
+run_dequeued_stealable(EThread *t, Que(Event, link) & q)
+{
+  Event *e;
+
+  while ((e = q.dequeue())) {
+    if (e->cancelled)
+      t->free_event(e);
+    else
+      t->process_event(e, e->callback_event);
+  }
+}
+
+// Run the stealable events queued on this thread so far, leaving those
+// that arrive meanwhile for the next loop, or for other threads. They are
+// taken one at a time so that idle threads can still steal the rest.
+void
+EThread::run_stealable()
+{
+  Que(Event, link) q;
+
+  for (int n = steal_queue_length; n > 0 && dequeue_stealable(q, 1); n--)
+    run_dequeued_stealable(this, q);
+}
+
+// Work is only taken from other threads by a thread which would otherwise
+// go to sleep: none of its own queues has an event to run.
+bool
+EThread::may_steal(ink_hrtime now)
+{
+  return eventProcessor.work_stealing && is_event_type(ET_CALL) && steal_queue_length == 0 &&
+         INK_ATOMICLIST_EMPTY(EventQueueExternal.al) && !EventQueueExternal.localQueue.head && EventQueue.earliest_timeout() > now;
+}
+
+void
+EThread::steal_events()
+{
+  int n = eventProcessor.n_threads_for_type[ET_CALL];
+  int stolen = 0;
+  Que(Event, link) q;
+
+  for (int i = 1; i < n && stolen < STEAL_BATCH; i++) {
+    EThread *victim = eventProcessor.eventthread[ET_CALL][(id + i) % n];
+    if (victim != this && victim->steal_queue_length > 0)
+      stolen += victim->dequeue_stealable(q, STEAL_BATCH - stolen);
+  }
+  run_dequeued_stealable(this, q);
+  events_stolen += stolen;
+}
+
 //
 // void  EThread::execute()
 //
@@ -192,6 +304,8 @@ EThread::execute()
             NegativeQueue.insert(e, p);
         }
       }
+      if (steal_queue_length > 0)
+        run_stealable();
       bool done_one;
       do {
         done_one = false;
@@ -247,6 +361,8 @@ EThread::execute()
             }
           }
         }
+        if (may_steal(cur_time))
+          steal_events();
         // execute poll events
         while ((e = NegativeQueue.dequeue()))
           process_event(e, EVENT_POLL);
@@ -259,6 +375,13 @@ EThread::execute()
         if (sleep_time > THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND) {
           next_time = cur_time + THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND;
         }
+        if (eventProcessor.work_stealing && is_event_type(ET_CALL)) {
+          if (may_steal(cur_time))
+            steal_events();
+          // wake up regularly to look for work on the other threads
+          if (next_time > cur_time + STEAL_IDLE_WAKEUP)
+            next_time = cur_time + STEAL_IDLE_WAKEUP;
+        }
         // dequeue all the external events and put them in a local
         // queue. If there are no external events available, do a
         // cond_timedwait.
@@ -65,6 +65,134 @@ EventProcessor::spawn_event_threads(int n_threads, const char *et_name, size_t s
 
 class EventProcessor eventProcessor;
 
+#if TS_USE_HWLOC
+// Returns the index of the NUMA node holding all of the cpuset, or -1.
+static int
+numa_node_of_cpuset(hwloc_const_cpuset_t cpuset)
+{
+  int n = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_NODE);
+
+  for (int i = 0; i < n && i < MAX_NUMA_NODES; i++) {
+    hwloc_obj_t node = hwloc_get_obj_by_type(ink_get_topology(), HWLOC_OBJ_NODE, i);
+    if (node->cpuset && hwloc_bitmap_isincluded(cpuset, node->cpuset)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Called before the ET_CALL threads start, with the objects they are going
+// to be bound to.  If every thread ends up within a single NUMA node, and
+// there is more than one such node, group the threads by node and give
+// each node its own buffer pools.
+void
+EventProcessor::setup_numa_nodes(int obj_type, int obj_count)
+{
+  int nodes = 0;
+
+  for (int i = 0; i < n_ethreads; i++) {
+    hwloc_obj_t obj = hwloc_get_obj_by_type(ink_get_topology(), (hwloc_obj_type_t)obj_type, i % obj_count);
+    int node = obj ? numa_node_of_cpuset(obj->cpuset) : -1;
+    if (node < 0) {
+      Debug("iocore_thread", "EThread %d is not bound to a single NUMA node, NUMA pools disabled", i);
+      nodes = 0;
+      break;
+    }
+    all_ethreads[i]->numa_node = node;
+    n_threads_for_node[node]++;
+    if (node >= nodes) {
+      nodes = node + 1;
+    }
+  }
+  if (nodes <= 1) {
+    for (int i = 0; i < n_ethreads; i++) {
+      all_ethreads[i]->numa_node = 0;
+    }
+    memset(n_threads_for_node, 0, sizeof(n_threads_for_node));
+    return;
+  }
+
+  for (int node = 0; node < nodes; node++) {
+    threads_for_node[node] = (EThread **)ats_malloc(sizeof(EThread *) * n_threads_for_node[node]);
+    n_threads_for_node[node] = 0;
+  }
+  for (int i = 0; i < n_ethreads; i++) {
+    int node = all_ethreads[i]->numa_node;
+    threads_for_node[node][n_threads_for_node[node]++] = all_ethreads[i];
+  }
+  n_numa_nodes = nodes;
+  init_buffer_numa_pools(nodes);
+  Note("event threads spread over %d NUMA nodes", nodes);
+}
+#endif
+
+void
+EventProcessor::bind_to_numa_node(int node)
+{
+#if TS_USE_HWLOC
+  EThread *t = this_ethread();
+
+  if (!t || node < 0 || node >= n_numa_nodes) {
+    return;
+  }
+  hwloc_obj_t obj = hwloc_get_obj_by_type(ink_get_topology(), HWLOC_OBJ_NODE, node);
+  if (obj && hwloc_set_cpubind(ink_get_topology(), obj->cpuset, HWLOC_CPUBIND_THREAD) == 0) {
+    Debug("iocore_thread", "dedicated thread bound to NUMA node %d", node);
+  }
+  // the pools are per node whether or not the binding succeeded
+  t->numa_node = node;
+#else
+  (void)node;
+#endif
+}
+
+int
+EventProcessor::numa_node_of_fd(int fd)
+{
+#if TS_USE_HWLOC && defined(linux)
+  struct stat sb;
+  char path[PATH_NAME_MAX];
+  char real[PATH_NAME_MAX];
+
+  if (n_numa_nodes <= 1 || fstat(fd, &sb) < 0) {
+    return -1;
+  }
+
+  // Walk up the sysfs device path of the block device (or of the device
+  // holding the file) to the first parent which knows its NUMA node.
+  dev_t dev = S_ISBLK(sb.st_mode) ? sb.st_rdev : sb.st_dev;
+  snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", major(dev), minor(dev));
+  if (!realpath(path, real)) {
+    return -1;
+  }
+  for (char *slash = strrchr(real, '/'); slash && slash > real; slash = strrchr(real, '/')) {
+    int os_index = -1;
+    snprintf(path, sizeof(path), "%s/numa_node", real);
+    FILE *f = fopen(path, "r");
+    if (f) {
+      if (fscanf(f, "%d", &os_index) != 1) {
+        os_index = -1;
+      }
+      fclose(f);
+      if (os_index < 0) {
+        return -1;
+      }
+      for (int i = 0; i < n_numa_nodes; i++) {
+        hwloc_obj_t obj = hwloc_get_obj_by_type(ink_get_topology(), HWLOC_OBJ_NODE, i);
+        if (obj && (int)obj->os_index == os_index) {
+          return i;
+        }
+      }
+      return -1;
+    }
+    *slash = '\0';
+  }
+#else
+  (void)fd;
+#endif
+  return -1;
+}
+
 int
 EventProcessor::start(int n_event_threads, size_t stacksize)
 {
@@ -94,6 +222,13 @@ EventProcessor::start(int n_event_threads, size_t stacksize)
   }
   n_threads_for_type[ET_CALL] = n_event_threads;
 
+  REC_ReadConfigInteger(work_stealing, "proxy.config.exec_thread.work_stealing");
+  if (work_stealing && n_event_threads > 1) {
+    Note("work stealing enabled over %d event threads", n_event_threads);
+  } else {
+    work_stealing = 0;
+  }
+
 #if TS_USE_HWLOC
   int affinity = 1;
   REC_ReadConfigInteger(affinity, "proxy.config.exec_thread.affinity");
@@ -132,6 +267,11 @@ EventProcessor::start(int n_event_threads, size_t stacksize)
   obj_count = hwloc_get_nbobjs_by_type(ink_get_topology(), obj_type);
   Debug("iocore_thread", "Affinity: %d %ss: %d PU: %d", affinity, obj_name, obj_count, ink_number_of_processors());
 
+  int numa = 1;
+  REC_ReadConfigInteger(numa, "proxy.config.exec_thread.numa");
+  if (numa && obj_count > 0) {
+    setup_numa_nodes(obj_type, obj_count);
+  }
 #endif
   for (i = 0; i < n_ethreads; i++) {
     ink_thread tid;
@@ -56,6 +56,83 @@ struct process_killer : public Continuation {
   }
 };
 
+#define STEAL_TEST_EVENTS 64
+#define STEAL_TEST_HEAVY_USECS 2000
+
+static int steal_done;
+static ink_hrtime steal_end;
+static Continuation *steal_driver_cont;
+
+// Every event meant for the first event thread is slow, so they all queue up
+// there unless the other threads steal them.
+struct steal_worker : public Continuation {
+  bool heavy;
+  steal_worker() : Continuation(new_ProxyMutex()), heavy(false) { SET_HANDLER(&steal_worker::work_function); }
+  int
+  work_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    if (heavy)
+      usleep(STEAL_TEST_HEAVY_USECS);
+    if (ink_atomic_increment(&steal_done, 1) == STEAL_TEST_EVENTS - 1) {
+      steal_end = ink_get_hrtime_internal();
+      eventProcessor.schedule_imm(steal_driver_cont);
+    }
+    return 0;
+  }
+};
+
+// Runs the same load with work stealing off and then on, and afterwards
+// starts the alarm test.
+struct steal_driver : public Continuation {
+  int phase;
+  ink_hrtime start;
+  int64_t steals_before;
+  steal_driver() : Continuation(new_ProxyMutex()), phase(0), start(0), steals_before(0)
+  {
+    SET_HANDLER(&steal_driver::drive_function);
+  }
+  int64_t
+  steals()
+  {
+    int64_t n = 0;
+    for (int i = 0; i < eventProcessor.n_threads_for_type[ET_CALL]; i++)
+      n += eventProcessor.eventthread[ET_CALL][i]->events_stolen;
+    return n;
+  }
+  int
+  drive_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    if (phase > 0)
+      printf("work stealing %s: %d events in %" PRId64 " usecs, %" PRId64 " stolen\n", phase > 1 ? "on" : "off",
+             STEAL_TEST_EVENTS, (int64_t)((steal_end - start) / HRTIME_USECOND), steals() - steals_before);
+    if (phase == 2) {
+      eventProcessor.work_stealing = 0;
+      start_alarm_test();
+      return 0;
+    }
+    eventProcessor.work_stealing = phase++;
+    steal_done = 0;
+    steals_before = steals();
+    start = ink_get_hrtime_internal();
+    for (int i = 0; i < STEAL_TEST_EVENTS; i++) {
+      steal_worker *w = new steal_worker;
+      w->heavy = eventProcessor.next_thread_for_type[ET_CALL] % eventProcessor.n_threads_for_type[ET_CALL] == 0;
+      eventProcessor.schedule_imm(w);
+    }
+    return 0;
+  }
+  void start_alarm_test();
+};
+
+void
+steal_driver::start_alarm_test()
+{
+  alarm_printer *alrm = new alarm_printer(new_ProxyMutex());
+  process_killer *killer = new process_killer(new_ProxyMutex());
+  eventProcessor.schedule_in(killer, HRTIME_SECONDS(10));
+  eventProcessor.schedule_every(alrm, HRTIME_SECONDS(1));
+}
+
 int
 main(int /* argc ATS_UNUSED */, const char * /* argv ATS_UNUSED */ [])
 {
@@ -69,10 +146,8 @@ main(int /* argc ATS_UNUSED */, const char * /* argv ATS_UNUSED */ [])
   ink_event_system_init(EVENT_SYSTEM_MODULE_VERSION);
   eventProcessor.start(TEST_THREADS, 1048576); // Hardcoded stacksize at 1MB
 
-  alarm_printer *alrm = new alarm_printer(new_ProxyMutex());
-  process_killer *killer = new process_killer(new_ProxyMutex());
-  eventProcessor.schedule_in(killer, HRTIME_SECONDS(10));
-  eventProcessor.schedule_every(alrm, HRTIME_SECONDS(1));
+  steal_driver_cont = new steal_driver;
+  eventProcessor.schedule_imm(steal_driver_cont);
   this_thread()->execute();
   return 0;
 }
@@ -168,6 +168,13 @@ struct NetVCOptions {
    */
   ats_scoped_str sni_servername;
 
+  /** Protocols to offer with ALPN on an outbound connection, in the wire format of a list of length prefixed names.
+      This is not copied, it must point to static storage.
+   */
+  const unsigned char *alpn_protos;
+  /// Length of @c alpn_protos.
+  unsigned alpn_protos_len;
+
   /// Reset all values to defaults.
   void reset();
 
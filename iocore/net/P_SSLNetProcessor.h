@@ -64,6 +64,11 @@ public:
 
   static EventType ET_SSL;
 
+  /// Threads which run server handshakes parked by their net threads, so
+  /// the private key operations do not stall other connections.
+  static EventType ET_SSL_HANDSHAKE;
+  static int handshake_offload_threads;
+
   //
   // Private
   //
@@ -135,6 +135,9 @@ public:
 
   SSL *ssl;
   ink_hrtime sslHandshakeBeginTime;
+  /// Pending handshake offload event, either queued on an ET_SSL_HANDSHAKE
+  /// thread or handing the result back to this VC's thread.
+  Event *sslHandshakeOffloadEvent;
   ink_hrtime sslLastWriteTime;
   int64_t sslTotalBytesSent;
 
@@ -267,6 +270,12 @@ public:
 
   bool computeSSLTrace();
 
+  /// Park the server handshake and run its next step on an ET_SSL_HANDSHAKE
+  /// thread. Returns false if the step should run inline.
+  bool sslHandshakeOffload();
+  /// Drop any pending handshake offload, the VC is going away.
+  void sslHandshakeOffloadCancel();
+
   const char *
   getSSLProtocol(void) const
   {
@@ -332,6 +341,17 @@ private:
   IOBufferReader *reader;
   bool eosRcvd;
   bool sslTrace;
+
+  enum {
+    SSL_OFFLOAD_NONE,   ///< Handshake runs on this VC's thread.
+    SSL_OFFLOAD_QUEUED, ///< Waiting for or running on an ET_SSL_HANDSHAKE thread.
+    SSL_OFFLOAD_DONE    ///< Result of the offloaded step is ready.
+  } sslHandshakeOffloadState;
+  int sslOffloadError;
+  int sslOffloadErrno;
+  bool sslHandshakeOffloaded; ///< A step of this handshake ran on an ET_SSL_HANDSHAKE thread.
+
+  friend struct SSLHandshakeOffload;
 };
 
 typedef int (SSLNetVConnection::*SSLNetVConnHandler)(int, void *);
@@ -90,6 +90,7 @@ enum SSL_Stats {
   ssl_error_ssl,
   ssl_sni_name_set_failure,
   ssl_total_success_handshake_count_out_stat,
+  ssl_total_handshakes_offloaded_stat,
 
   /* ocsp stapling stats */
   ssl_ocsp_revoked_cert_stat,
@@ -101,13 +102,23 @@ enum SSL_Stats {
   Ssl_Stat_Count
 };
 
+// Latency histograms, in microseconds
+enum SSL_Histograms {
+  ssl_handshake_time_histogram,
+  ssl_handshake_offload_wait_histogram,
+  ssl_handshake_offload_time_histogram,
+  ssl_histogram_count
+};
+
 extern RecRawStatBlock *ssl_rsb;
+extern RecRawHistogramBlock *ssl_rhb;
 
 /* Stats should only be accessed using these macros */
 #define SSL_INCREMENT_DYN_STAT(x) RecIncrRawStat(ssl_rsb, NULL, (int)x, 1)
 #define SSL_DECREMENT_DYN_STAT(x) RecIncrRawStat(ssl_rsb, NULL, (int)x, -1)
 #define SSL_SET_COUNT_DYN_STAT(x, count) RecSetRawStatCount(ssl_rsb, x, count)
 #define SSL_INCREMENT_DYN_STAT_EX(x, y) RecIncrRawStat(ssl_rsb, NULL, (int)x, y)
+#define SSL_RECORD_HISTOGRAM(x, y) RecRecordRawHistogram(ssl_rhb, this_ethread(), (int)x, (uint64_t)y)
 #define SSL_CLEAR_DYN_STAT(x)            \
   do {                                   \
     RecSetRawStatSum(ssl_rsb, (x), 0);   \
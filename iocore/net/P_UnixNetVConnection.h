@@ -67,6 +67,8 @@ NetVCOptions::reset()
   etype = ET_NET;
 
   sni_servername = NULL;
+  alpn_protos = NULL;
+  alpn_protos_len = 0;
 }
 
 TS_INLINE void
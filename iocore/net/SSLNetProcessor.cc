@@ -34,6 +34,8 @@
 SSLNetProcessor ssl_NetProcessor;
 NetProcessor &sslNetProcessor = ssl_NetProcessor;
 EventType SSLNetProcessor::ET_SSL;
+EventType SSLNetProcessor::ET_SSL_HANDSHAKE;
+int SSLNetProcessor::handshake_offload_threads = 0;
 
 #ifdef HAVE_OPENSSL_OCSP_STAPLING
 struct OCSPContinuation : public Continuation {
@@ -94,6 +96,14 @@ SSLNetProcessor::start(int number_of_ssl_threads, size_t stacksize)
   }
 #endif /* HAVE_OPENSSL_OCSP_STAPLING */
 
+  REC_ReadConfigInteger(handshake_offload_threads, "proxy.config.ssl.handshake_offload.threads");
+  if (handshake_offload_threads > 0) {
+    SSLNetProcessor::ET_SSL_HANDSHAKE =
+      eventProcessor.spawn_event_threads(handshake_offload_threads, "ET_SSL_HANDSHAKE", stacksize);
+    Note("offloading TLS handshakes to %d threads", handshake_offload_threads);
+  } else {
+    handshake_offload_threads = 0;
+  }
 
   if (number_of_ssl_threads == -1) {
     // We've disabled ET_SSL threads, so we will mark all ET_NET threads as having
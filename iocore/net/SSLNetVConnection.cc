@@ -56,6 +56,7 @@ void SSL_set_rbio(SSL *ssl, BIO *rbio);
 #define SSL_HANDSHAKE_WANT_CONNECT 9
 #define SSL_WRITE_WOULD_BLOCK 10
 #define SSL_WAIT_FOR_HOOK 11
+#define SSL_WAIT_FOR_OFFLOAD 12
 
 #ifndef UIO_MAXIOV
 #define NET_MAX_IOV 16 // UIO_MAXIOV shall be at least 16 1003.1g (5.4.1.1)
@@ -551,7 +552,9 @@ SSLNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
           } else {
             Error("failed to allocate MIOBuffer after handshake, vc %p", this);
           }
-          read.triggered = 0;
+          // The epoll event for data sent while the handshake was offloaded
+          // went to the parked VC, so check the socket once reads are enabled.
+          read.triggered = sslHandshakeOffloaded;
           read_disable(nh, this);
         }
         readSignalDone(VC_EVENT_READ_COMPLETE, nh);
@@ -562,6 +565,10 @@ SSLNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
       }
     } else if (ret == SSL_WAIT_FOR_HOOK) {
       // avoid readReschedule - done when the plugin calls us back to reenable
+    } else if (ret == SSL_WAIT_FOR_OFFLOAD) {
+      // parked until the ET_SSL_HANDSHAKE thread hands the result back
+      read.triggered = 0;
+      nh->read_ready_list.remove(this);
     } else {
       readReschedule(nh);
     }
@@ -852,17 +859,19 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
 }
 
 SSLNetVConnection::SSLNetVConnection()
-  : ssl(NULL), sslHandshakeBeginTime(0), sslLastWriteTime(0), sslTotalBytesSent(0), hookOpRequested(TS_SSL_HOOK_OP_DEFAULT),
-    sslHandShakeComplete(false), sslClientConnection(false), sslClientRenegotiationAbort(false), sslSessionCacheHit(false),
-    handShakeBuffer(NULL), handShakeHolder(NULL), handShakeReader(NULL), handShakeBioStored(0),
-    sslPreAcceptHookState(SSL_HOOKS_INIT), sslHandshakeHookState(HANDSHAKE_HOOKS_PRE), npnSet(NULL), npnEndpoint(NULL),
-    sessionAcceptPtr(NULL), iobuf(NULL), reader(NULL), eosRcvd(false), sslTrace(false)
+  : ssl(NULL), sslHandshakeBeginTime(0), sslHandshakeOffloadEvent(NULL), sslLastWriteTime(0), sslTotalBytesSent(0),
+    hookOpRequested(TS_SSL_HOOK_OP_DEFAULT), sslHandShakeComplete(false), sslClientConnection(false),
+    sslClientRenegotiationAbort(false), sslSessionCacheHit(false), handShakeBuffer(NULL), handShakeHolder(NULL),
+    handShakeReader(NULL), handShakeBioStored(0), sslPreAcceptHookState(SSL_HOOKS_INIT), sslHandshakeHookState(HANDSHAKE_HOOKS_PRE),
+    npnSet(NULL), npnEndpoint(NULL), sessionAcceptPtr(NULL), iobuf(NULL), reader(NULL), eosRcvd(false), sslTrace(false),
+    sslHandshakeOffloadState(SSL_OFFLOAD_NONE), sslOffloadError(SSL_ERROR_NONE), sslOffloadErrno(0), sslHandshakeOffloaded(false)
 {
 }
 
 void
 SSLNetVConnection::do_io_close(int lerrno)
 {
+  sslHandshakeOffloadCancel();
   if (this->ssl != NULL && sslHandShakeComplete) {
     int shutdown_mode = SSL_get_shutdown(ssl);
     Debug("ssl-shutdown", "previous shutdown state 0x%x", shutdown_mode);
@@ -896,6 +905,9 @@ SSLNetVConnection::do_io_close(int lerrno)
 void
 SSLNetVConnection::free(EThread *t)
 {
+  // The offloaded handshake holds a pointer to this VC and its SSL object,
+  // so it has to be gone before either is torn down.
+  sslHandshakeOffloadCancel();
   NET_SUM_GLOBAL_DYN_STAT(net_connections_currently_open_stat, -1);
   got_remote_addr = 0;
   got_local_addr = 0;
@@ -1094,20 +1106,43 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
   }
 
   int retval = 1; // Initialze with a non-error value
+  ssl_error_t ssl_error;
+
+  if (SSL_OFFLOAD_QUEUED == sslHandshakeOffloadState) {
+    return SSL_WAIT_FOR_OFFLOAD;
+  } else if (SSL_OFFLOAD_DONE == sslHandshakeOffloadState && SSL_ERROR_WANT_READ != sslOffloadError) {
+    // An ET_SSL_HANDSHAKE thread already ran SSLAccept(), pick up its result.
+    sslHandshakeOffloadState = SSL_OFFLOAD_NONE;
+    ssl_error = sslOffloadError;
+    errno = sslOffloadErrno;
+  } else {
+    // Read events that came in while the handshake was offloaded did not
+    // read the socket, so an offloaded step that wants more data goes
+    // back to the socket here instead of waiting for the next event.
+    // Drop the handshake data it used up first, as net_read_io does.
+    if (SSL_OFFLOAD_DONE == sslHandshakeOffloadState && BIO_eof(SSL_get_rbio(this->ssl))) {
+      this->handShakeReader->consume(this->handShakeBioStored);
+      this->handShakeBioStored = 0;
+    }
+    sslHandshakeOffloadState = SSL_OFFLOAD_NONE;
+
+    // All the pre-accept hooks have completed, proceed with the actual accept.
+    if (BIO_eof(SSL_get_rbio(this->ssl))) { // No more data in the buffer
+      // Read from socket to fill in the BIO buffer with the
+      // raw handshake data before calling the ssl accept calls.
+      retval = this->read_raw_data();
+      if (retval == 0) {
+        // EOF, go away, we stopped in the handshake
+        SSLDebugVC(this, "SSL handshake error: EOF");
+        return EVENT_ERROR;
+      }
+    }
 
-  // All the pre-accept hooks have completed, proceed with the actual accept.
-  if (BIO_eof(SSL_get_rbio(this->ssl))) { // No more data in the buffer
-    // Read from socket to fill in the BIO buffer with the
-    // raw handshake data before calling the ssl accept calls.
-    retval = this->read_raw_data();
-    if (retval == 0) {
-      // EOF, go away, we stopped in the handshake
-      SSLDebugVC(this, "SSL handshake error: EOF");
-      return EVENT_ERROR;
+    if (retval > 0 && sslHandshakeOffload()) {
+      return SSL_WAIT_FOR_OFFLOAD;
     }
+    ssl_error = SSLAccept(ssl);
   }
-
-  ssl_error_t ssl_error = SSLAccept(ssl);
   bool trace = getSSLTrace();
   Debug("ssl", "trace=%s", trace ? "TRUE" : "FALSE");
 
@@ -1149,6 +1184,7 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
       sslHandshakeBeginTime = 0;
       SSL_INCREMENT_DYN_STAT_EX(ssl_total_handshake_time_stat, ssl_handshake_time);
       SSL_INCREMENT_DYN_STAT(ssl_total_success_handshake_count_in_stat);
+      SSL_RECORD_HISTOGRAM(ssl_handshake_time_histogram, ink_hrtime_to_usec(ssl_handshake_time));
     }
 
     {
@@ -1262,6 +1298,78 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
   }
 }
 
+// Runs one SSLAccept() step of a server handshake on an ET_SSL_HANDSHAKE
+// thread, then hands the result back to the thread of the VC. It holds the
+// VC mutex while it runs, which keeps the net thread and the owner of the
+// VC away from the SSL object.
+struct SSLHandshakeOffload : public Continuation {
+  SSLHandshakeOffload(SSLNetVConnection *vc) : Continuation(vc->mutex), m_vc(vc), m_parked(ink_get_hrtime_internal())
+  {
+    SET_HANDLER(&SSLHandshakeOffload::acceptEvent);
+  }
+
+  int
+  acceptEvent(int, Event *)
+  {
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    m_vc->sslOffloadError = SSLAccept(m_vc->ssl);
+    m_vc->sslOffloadErrno = errno;
+    m_vc->sslHandshakeOffloadState = SSLNetVConnection::SSL_OFFLOAD_DONE;
+
+    SSL_INCREMENT_DYN_STAT(ssl_total_handshakes_offloaded_stat);
+    SSL_RECORD_HISTOGRAM(ssl_handshake_offload_wait_histogram, ink_hrtime_to_usec(start - m_parked));
+    SSL_RECORD_HISTOGRAM(ssl_handshake_offload_time_histogram, ink_hrtime_to_usec(ink_get_hrtime_internal() - start));
+
+    SET_HANDLER(&SSLHandshakeOffload::resumeEvent);
+    m_vc->sslHandshakeOffloadEvent = m_vc->thread->schedule_imm(this);
+    return EVENT_DONE;
+  }
+
+  int
+  resumeEvent(int, Event *)
+  {
+    m_vc->sslHandshakeOffloadEvent = NULL;
+    m_vc->read.triggered = 1;
+    m_vc->readReschedule(m_vc->nh);
+    delete this;
+    return EVENT_DONE;
+  }
+
+private:
+  SSLNetVConnection *m_vc;
+  ink_hrtime m_parked;
+};
+
+bool
+SSLNetVConnection::sslHandshakeOffload()
+{
+  // The offload thread runs under the VC mutex, so that has to be the lock
+  // the net thread and the owner of the VC take as well. Handshakes with
+  // certificate hooks stay here, the hooks expect to run on this thread.
+  if (SSLNetProcessor::handshake_offload_threads == 0 || sslHandshakeOffloadEvent != NULL || read.vio.mutex != mutex ||
+      BIO_eof(SSL_get_rbio(ssl)) || ssl_hooks->get(TS_SSL_CERT_INTERNAL_HOOK) != NULL) {
+    return false;
+  }
+
+  SSLDebugVC(this, "offloading SSL handshake");
+  sslHandshakeOffloadState = SSL_OFFLOAD_QUEUED;
+  sslHandshakeOffloaded = true;
+  sslHandshakeOffloadEvent = eventProcessor.schedule_imm(new SSLHandshakeOffload(this), SSLNetProcessor::ET_SSL_HANDSHAKE);
+  return true;
+}
+
+void
+SSLNetVConnection::sslHandshakeOffloadCancel()
+{
+  if (sslHandshakeOffloadEvent != NULL) {
+    delete sslHandshakeOffloadEvent->continuation;
+    sslHandshakeOffloadEvent->cancel();
+    sslHandshakeOffloadEvent = NULL;
+  }
+  sslHandshakeOffloadState = SSL_OFFLOAD_NONE;
+  sslHandshakeOffloaded = false;
+}
 
 int
 SSLNetVConnection::sslClientHandShakeEvent(int &err)
@@ -1278,6 +1386,12 @@ SSLNetVConnection::sslClientHandShakeEvent(int &err)
 
 #endif
 
+#if TS_USE_TLS_ALPN
+  if (options.alpn_protos && SSL_set_alpn_protos(ssl, options.alpn_protos, options.alpn_protos_len) != 0) {
+    Debug("ssl.error", "failed to set ALPN protocols for client handshake");
+  }
+#endif /* TS_USE_TLS_ALPN */
+
   SSL_set_ex_data(ssl, get_ssl_client_data_index(), this);
   ssl_error_t ssl_error = SSLConnect(ssl);
   bool trace = getSSLTrace();
@@ -126,6 +126,7 @@ static ink_mutex *mutex_buf = NULL;
 static bool open_ssl_initialized = false;
 
 RecRawStatBlock *ssl_rsb = NULL;
+RecRawHistogramBlock *ssl_rhb = NULL;
 static InkHashTable *ssl_cipher_name_table = NULL;
 
 /* Using pthread thread ID and mutex functions directly, instead of
@@ -847,6 +848,8 @@ SSLInitializeStatistics()
   // Allocate SSL statistics block.
   ssl_rsb = RecAllocateRawStatBlock((int)Ssl_Stat_Count);
   ink_assert(ssl_rsb != NULL);
+  ssl_rhb = RecAllocateRawHistogramBlock((int)ssl_histogram_count);
+  ink_assert(ssl_rhb != NULL);
 
   // SSL client errors.
   RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.user_agent_other_errors", RECD_INT, RECP_PERSISTENT,
@@ -906,6 +909,13 @@ SSLInitializeStatistics()
                      (int)ssl_total_success_handshake_count_in_stat, RecRawStatSyncCount);
   RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.total_success_handshake_count_out", RECD_INT, RECP_PERSISTENT,
                      (int)ssl_total_success_handshake_count_out_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.total_handshakes_offloaded", RECD_INT, RECP_NON_PERSISTENT,
+                     (int)ssl_total_handshakes_offloaded_stat, RecRawStatSyncCount);
+  RecRegisterRawHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.latency.handshake", (int)ssl_handshake_time_histogram);
+  RecRegisterRawHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.latency.handshake_offload_wait",
+                          (int)ssl_handshake_offload_wait_histogram);
+  RecRegisterRawHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.latency.handshake_offload",
+                          (int)ssl_handshake_offload_time_histogram);
 
   // TLS tickets
   RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.total_tickets_created", RECD_INT, RECP_PERSISTENT,
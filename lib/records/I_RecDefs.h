@@ -169,15 +169,42 @@ struct RecRawStat {
   uint32_t version;
 };
 
+// The thread local copy of a raw-stat only needs the running values, so
+// four of them fit in a cache line.  A thread's copies of the stats of a
+// block are contiguous, which lets the sync sweep them sequentially.
+struct RecRawStatLocal {
+  int64_t sum;
+  int64_t count;
+};
+
 
 // WARNING!  It's advised that developers do not modify the contents of
 // the RecRawStatBlock.  ^_^
 struct RecRawStatBlock {
-  off_t ethr_stat_offset; // thread local raw-stat storage
-  RecRawStat **global;    // global raw-stat storage (ptr to RecRecord)
-  int num_stats;          // number of stats in this block
-  int max_stats;          // maximum number of stats for this block
+  off_t ethr_stat_offset;  // thread local raw-stat storage
+  RecRawStat **global;     // global raw-stat storage (ptr to RecRecord)
+  RecRawStatLocal *totals; // sum of the thread local values at the last sweep
+  int num_stats;           // number of stats in this block
+  int max_stats;           // maximum number of stats for this block
   ink_mutex mutex;
+  RecRawStatBlock *next; // list of all blocks, for the periodic sync
+};
+
+
+//-------------------------------------------------------------------------
+// RawHistogram Structures
+//-------------------------------------------------------------------------
+struct RecRawHistogram; // global merge state, private to RecProcess.cc
+
+// Thread local storage for each histogram of the block is a
+// LogLinearHistogram (see ts/Histogram.h), so recording a sample is a
+// couple of plain increments on the calling thread.
+struct RecRawHistogramBlock {
+  off_t ethr_hist_offset;     // thread local histogram storage
+  RecRawHistogram *global;    // merged histograms and their records
+  int max_histograms;         // maximum number of histograms for this block
+  ink_mutex mutex;            // protects global
+  RecRawHistogramBlock *next; // list of all blocks, for the periodic sync
 };
 
 
@@ -26,6 +26,7 @@
 
 #include "I_RecCore.h"
 #include "I_EventSystem.h"
+#include "ts/Histogram.h"
 
 
 //-------------------------------------------------------------------------
@@ -41,6 +42,7 @@ int RecProcessStart(void);
 void RecProcess_set_raw_stat_sync_interval_ms(int ms);
 void RecProcess_set_config_update_interval_ms(int ms);
 void RecProcess_set_remote_sync_interval_ms(int ms);
+void RecProcess_set_raw_histogram_window_ms(int ms);
 
 //-------------------------------------------------------------------------
 // RawStat Registration
@@ -63,6 +65,18 @@ int _RecRegisterRawStat(RecRawStatBlock *rsb, RecT rec_type, const char *name, R
 //                           RecInt max);
 
 
+//-------------------------------------------------------------------------
+// RawHistogram Registration
+//-------------------------------------------------------------------------
+RecRawHistogramBlock *RecAllocateRawHistogramBlock(int num_histograms);
+
+// Registers the process stats <name>.count and <name>.sum (all samples
+// since startup) and <name>.p50, .p90, .p99, .p999 and .max (samples of
+// the last completed window, REC_RAW_HISTOGRAM_WINDOW_MS long by default).  They are updated by the
+// raw stat sync, from the merge of all thread local histograms.
+int RecRegisterRawHistogram(RecRawHistogramBlock *rhb, RecT rec_type, const char *name, int id);
+
+
 //-------------------------------------------------------------------------
 // Predefined RawStat Callbacks
 //-------------------------------------------------------------------------
@@ -85,6 +99,7 @@ inline int RecIncrRawStat(RecRawStatBlock *rsb, EThread *ethread, int id, int64_
 inline int RecIncrRawStatSum(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr = 1);
 inline int RecIncrRawStatCount(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr = 1);
 int RecIncrRawStatBlock(RecRawStatBlock *rsb, EThread *ethread, RecRawStat *stat_array);
+inline int RecRecordRawHistogram(RecRawHistogramBlock *rhb, EThread *ethread, int id, uint64_t value);
 
 int RecSetRawStatSum(RecRawStatBlock *rsb, int id, int64_t data);
 int RecSetRawStatCount(RecRawStatBlock *rsb, int id, int64_t data);
@@ -117,20 +132,20 @@ int64_t *RecGetGlobalRawStatCountPtr(RecRawStatBlock *rsb, int id);
 //-------------------------------------------------------------------------
 // inlined functions that are used very frequently.
 // FIXME: move it to Inline.cc
-inline RecRawStat *
+inline RecRawStatLocal *
 raw_stat_get_tlp(RecRawStatBlock *rsb, int id, EThread *ethread)
 {
   ink_assert((id >= 0) && (id < rsb->max_stats));
   if (ethread == NULL) {
     ethread = this_ethread();
   }
-  return (((RecRawStat *)((char *)(ethread) + rsb->ethr_stat_offset)) + id);
+  return (((RecRawStatLocal *)((char *)(ethread) + rsb->ethr_stat_offset)) + id);
 }
 
 inline int
 RecIncrRawStat(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatLocal *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum += incr;
   tlp->count += 1;
   return REC_ERR_OKAY;
@@ -139,7 +154,7 @@ RecIncrRawStat(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr)
 inline int
 RecDecrRawStat(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t decr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatLocal *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum -= decr;
   tlp->count += 1;
   return REC_ERR_OKAY;
@@ -148,7 +163,7 @@ RecDecrRawStat(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t decr)
 inline int
 RecIncrRawStatSum(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatLocal *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum += incr;
   return REC_ERR_OKAY;
 }
@@ -156,9 +171,29 @@ RecIncrRawStatSum(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr)
 inline int
 RecIncrRawStatCount(RecRawStatBlock *rsb, EThread *ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatLocal *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->count += incr;
   return REC_ERR_OKAY;
 }
 
+//-------------------------------------------------------------------------
+// RecRecordRawHistogram
+//-------------------------------------------------------------------------
+inline LogLinearHistogram *
+raw_histogram_get_tlp(RecRawHistogramBlock *rhb, int id, EThread *ethread)
+{
+  ink_assert((id >= 0) && (id < rhb->max_histograms));
+  if (ethread == NULL) {
+    ethread = this_ethread();
+  }
+  return (((LogLinearHistogram *)((char *)(ethread) + rhb->ethr_hist_offset)) + id);
+}
+
+inline int
+RecRecordRawHistogram(RecRawHistogramBlock *rhb, EThread *ethread, int id, uint64_t value)
+{
+  raw_histogram_get_tlp(rhb, id, ethread)->record(value);
+  return REC_ERR_OKAY;
+}
+
 #endif /* !_I_REC_PROCESS_H_ */
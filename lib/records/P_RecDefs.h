@@ -44,6 +44,9 @@
 #define REC_RAW_STAT_SYNC_INTERVAL_MS 5000
 #define REC_STAT_UPDATE_INTERVAL_MS 10000
 
+// Percentiles of raw histograms are computed over windows of this length
+#define REC_RAW_HISTOGRAM_WINDOW_MS 60000
+
 //-------------------------------------------------------------------------
 // Record Items
 //-------------------------------------------------------------------------
@@ -43,9 +43,14 @@ static EventNotify g_force_req_notify;
 static int g_rec_raw_stat_sync_interval_ms = REC_RAW_STAT_SYNC_INTERVAL_MS;
 static int g_rec_config_update_interval_ms = REC_CONFIG_UPDATE_INTERVAL_MS;
 static int g_rec_remote_sync_interval_ms = REC_REMOTE_SYNC_INTERVAL_MS;
+static int g_rec_raw_histogram_window_ms = REC_RAW_HISTOGRAM_WINDOW_MS;
 static Event *raw_stat_sync_cont_event;
 static Event *config_update_cont_event;
 static Event *sync_cont_event;
+static RecRawStatBlock *g_rsb_list;
+static ink_mutex g_rsb_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RecRawHistogramBlock *g_rhb_list;
+static ink_mutex g_rhb_list_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 //-------------------------------------------------------------------------
 // i_am_the_record_owner, only used for librecords_p.a
@@ -118,6 +123,12 @@ RecProcess_set_remote_sync_interval_ms(int ms)
     sync_cont_event->schedule_every(HRTIME_MSECONDS(g_rec_remote_sync_interval_ms));
   }
 }
+void
+RecProcess_set_raw_histogram_window_ms(int ms)
+{
+  Debug("statsproc", "g_rec_raw_histogram_window_ms -> %d", ms);
+  g_rec_raw_histogram_window_ms = ms;
+}
 
 //-------------------------------------------------------------------------
 // raw_stat_get_total
@@ -126,7 +137,7 @@ static int
 raw_stat_get_total(RecRawStatBlock *rsb, int id, RecRawStat *total)
 {
   int i;
-  RecRawStat *tlp;
+  RecRawStatLocal *tlp;
 
   total->sum = 0;
   total->count = 0;
@@ -137,13 +148,13 @@ raw_stat_get_total(RecRawStatBlock *rsb, int id, RecRawStat *total)
 
   // get thread local values
   for (i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_ethreads[i]);
     total->sum += tlp->sum;
     total->count += tlp->count;
   }
 
   for (i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_dthreads[i]);
     total->sum += tlp->sum;
     total->count += tlp->count;
   }
@@ -156,39 +167,56 @@ raw_stat_get_total(RecRawStatBlock *rsb, int id, RecRawStat *total)
 }
 
 
+//-------------------------------------------------------------------------
+// raw_stat_sweep
+//-------------------------------------------------------------------------
+// Add the thread local values of every stat of the block to totals.  Each
+// thread's values are read in one sequential pass, instead of visiting
+// every thread once per stat.
+static void
+raw_stat_sweep_threads(RecRawStatBlock *rsb, RecRawStatLocal *totals, EThread **threads, int n_threads)
+{
+  for (int i = 0; i < n_threads; i++) {
+    const RecRawStatLocal *tlp = (RecRawStatLocal *)((char *)(threads[i]) + rsb->ethr_stat_offset);
+
+    for (int id = 0; id < rsb->max_stats; id++) {
+      totals[id].sum += tlp[id].sum;
+      totals[id].count += tlp[id].count;
+    }
+  }
+}
+
+static void
+raw_stat_sweep(RecRawStatBlock *rsb)
+{
+  // lock so a concurrent clear can not be undone by stale totals
+  ink_mutex_acquire(&(rsb->mutex));
+  memset(rsb->totals, 0, rsb->max_stats * sizeof(RecRawStatLocal));
+  raw_stat_sweep_threads(rsb, rsb->totals, eventProcessor.all_ethreads, eventProcessor.n_ethreads);
+  raw_stat_sweep_threads(rsb, rsb->totals, eventProcessor.all_dthreads, eventProcessor.n_dthreads);
+  ink_mutex_release(&(rsb->mutex));
+}
+
+
 //-------------------------------------------------------------------------
 // raw_stat_sync_to_global
 //-------------------------------------------------------------------------
 static int
 raw_stat_sync_to_global(RecRawStatBlock *rsb, int id)
 {
-  int i;
-  RecRawStat *tlp;
   RecRawStat total;
 
-  total.sum = 0;
-  total.count = 0;
-
-  // sum the thread local values
-  for (i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
-    total.sum += tlp->sum;
-    total.count += tlp->count;
-  }
+  // lock so the setting of the globals and last values are atomic
+  ink_mutex_acquire(&(rsb->mutex));
 
-  for (i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
-    total.sum += tlp->sum;
-    total.count += tlp->count;
-  }
+  // the sum of the thread local values, from the sweep that started this sync
+  total.sum = rsb->totals[id].sum;
+  total.count = rsb->totals[id].count;
 
   if (total.sum < 0) { // Assure that we stay positive
     total.sum = 0;
   }
 
-  // lock so the setting of the globals and last values are atomic
-  ink_mutex_acquire(&(rsb->mutex));
-
   // get the delta from the last sync
   RecRawStat delta;
   delta.sum = total.sum - rsb->global[id]->last_sum;
@@ -222,28 +250,31 @@ raw_stat_clear(RecRawStatBlock *rsb, int id)
   Debug("stats", "raw_stat_clear(): rsb pointer:%p id:%d\n", rsb, id);
 
   // the globals need to be reset too
-  // lock so the setting of the globals and last values are atomic
+  // lock so the setting of the globals, last values and totals are atomic
   ink_mutex_acquire(&(rsb->mutex));
   ink_atomic_swap(&(rsb->global[id]->sum), (int64_t)0);
   ink_atomic_swap(&(rsb->global[id]->last_sum), (int64_t)0);
   ink_atomic_swap(&(rsb->global[id]->count), (int64_t)0);
   ink_atomic_swap(&(rsb->global[id]->last_count), (int64_t)0);
-  ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatLocal *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_ethreads[i]);
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_dthreads[i]);
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
+  rsb->totals[id].sum = 0;
+  rsb->totals[id].count = 0;
+  ink_mutex_release(&(rsb->mutex));
+
   return REC_ERR_OKAY;
 }
 
@@ -257,24 +288,26 @@ raw_stat_clear_sum(RecRawStatBlock *rsb, int id)
   Debug("stats", "raw_stat_clear_sum(): rsb pointer:%p id:%d\n", rsb, id);
 
   // the globals need to be reset too
-  // lock so the setting of the globals and last values are atomic
+  // lock so the setting of the globals, last values and totals are atomic
   ink_mutex_acquire(&(rsb->mutex));
   ink_atomic_swap(&(rsb->global[id]->sum), (int64_t)0);
   ink_atomic_swap(&(rsb->global[id]->last_sum), (int64_t)0);
-  ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatLocal *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_ethreads[i]);
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_dthreads[i]);
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
   }
 
+  rsb->totals[id].sum = 0;
+  ink_mutex_release(&(rsb->mutex));
+
   return REC_ERR_OKAY;
 }
 
@@ -288,24 +321,26 @@ raw_stat_clear_count(RecRawStatBlock *rsb, int id)
   Debug("stats", "raw_stat_clear_count(): rsb pointer:%p id:%d\n", rsb, id);
 
   // the globals need to be reset too
-  // lock so the setting of the globals and last values are atomic
+  // lock so the setting of the globals, last values and totals are atomic
   ink_mutex_acquire(&(rsb->mutex));
   ink_atomic_swap(&(rsb->global[id]->count), (int64_t)0);
   ink_atomic_swap(&(rsb->global[id]->last_count), (int64_t)0);
-  ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatLocal *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_ethreads[i]);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *)((char *)(eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = raw_stat_get_tlp(rsb, id, eventProcessor.all_dthreads[i]);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
+  rsb->totals[id].count = 0;
+  ink_mutex_release(&(rsb->mutex));
+
   return REC_ERR_OKAY;
 }
 
@@ -339,6 +374,7 @@ struct raw_stat_sync_cont : public Continuation {
   exec_callbacks(int /* event */, Event * /* e */)
   {
     RecExecRawStatSyncCbs();
+    RecExecRawHistogramSyncs();
     Debug("statsproc", "raw_stat_sync_cont() processed");
 
     return EVENT_CONT;
@@ -525,7 +561,7 @@ RecAllocateRawStatBlock(int num_stats)
   RecRawStatBlock *rsb;
 
   // allocate thread-local raw-stat memory
-  if ((ethr_stat_offset = eventProcessor.allocate(num_stats * sizeof(RecRawStat))) == -1) {
+  if ((ethr_stat_offset = eventProcessor.allocate(num_stats * sizeof(RecRawStatLocal))) == -1) {
     return NULL;
   }
   // create the raw-stat-block structure
@@ -534,9 +570,17 @@ RecAllocateRawStatBlock(int num_stats)
   rsb->ethr_stat_offset = ethr_stat_offset;
   rsb->global = (RecRawStat **)ats_malloc(num_stats * sizeof(RecRawStat *));
   memset(rsb->global, 0, num_stats * sizeof(RecRawStat *));
+  rsb->totals = (RecRawStatLocal *)ats_malloc(num_stats * sizeof(RecRawStatLocal));
+  memset(rsb->totals, 0, num_stats * sizeof(RecRawStatLocal));
   rsb->num_stats = 0;
   rsb->max_stats = num_stats;
   ink_mutex_init(&(rsb->mutex), "net stat mutex");
+
+  ink_mutex_acquire(&g_rsb_list_mutex);
+  rsb->next = g_rsb_list;
+  g_rsb_list = rsb;
+  ink_mutex_release(&g_rsb_list_mutex);
+
   return rsb;
 }
 
@@ -584,6 +628,159 @@ Ldone:
 }
 
 
+//-------------------------------------------------------------------------
+// RecRawHistogram
+//-------------------------------------------------------------------------
+enum RecRawHistogramMetric {
+  RAW_HISTOGRAM_COUNT,
+  RAW_HISTOGRAM_SUM,
+  RAW_HISTOGRAM_P50,
+  RAW_HISTOGRAM_P90,
+  RAW_HISTOGRAM_P99,
+  RAW_HISTOGRAM_P999,
+  RAW_HISTOGRAM_MAX,
+  RAW_HISTOGRAM_METRICS
+};
+
+static const char *const raw_histogram_suffix[RAW_HISTOGRAM_METRICS] = {"count", "sum", "p50", "p90", "p99", "p999", "max"};
+
+struct RecRawHistogram {
+  char *names[RAW_HISTOGRAM_METRICS]; // NULL until the histogram is registered
+  LogLinearHistogram total;           // merge of the thread local histograms
+  LogLinearHistogram window_start;    // total at the start of the current window
+  LogLinearHistogram window;          // samples of the last completed window
+  ink_hrtime window_time;             // start time of the current window
+};
+
+//-------------------------------------------------------------------------
+// raw_histogram_sync
+//-------------------------------------------------------------------------
+static void
+raw_histogram_sync(RecRawHistogramBlock *rhb, int id, ink_hrtime now)
+{
+  RecRawHistogram *h = &rhb->global[id];
+  int64_t values[RAW_HISTOGRAM_METRICS];
+
+  // The thread local histograms only ever grow, so their merge is the
+  // histogram of all samples since startup.  A sample being recorded
+  // during the merge can be missed by count() and sum(); it is picked up
+  // at the next sync.
+  h->total.reset();
+  for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+    h->total.merge(*raw_histogram_get_tlp(rhb, id, eventProcessor.all_ethreads[i]));
+  }
+  for (int i = 0; i < eventProcessor.n_dthreads; i++) {
+    h->total.merge(*raw_histogram_get_tlp(rhb, id, eventProcessor.all_dthreads[i]));
+  }
+
+  if (now - h->window_time >= HRTIME_MSECONDS(g_rec_raw_histogram_window_ms)) {
+    h->window.delta(h->total, h->window_start);
+    h->window_start = h->total;
+    h->window_time = now;
+  }
+
+  values[RAW_HISTOGRAM_COUNT] = h->total.count();
+  values[RAW_HISTOGRAM_SUM] = h->total.sum();
+  values[RAW_HISTOGRAM_P50] = h->window.percentile(0.5);
+  values[RAW_HISTOGRAM_P90] = h->window.percentile(0.9);
+  values[RAW_HISTOGRAM_P99] = h->window.percentile(0.99);
+  values[RAW_HISTOGRAM_P999] = h->window.percentile(0.999);
+  values[RAW_HISTOGRAM_MAX] = h->window.max();
+
+  for (int m = 0; m < RAW_HISTOGRAM_METRICS; m++) {
+    RecSetRecordInt(h->names[m], values[m], REC_SOURCE_DEFAULT, true, false);
+  }
+}
+
+//-------------------------------------------------------------------------
+// RecAllocateRawHistogramBlock
+//-------------------------------------------------------------------------
+RecRawHistogramBlock *
+RecAllocateRawHistogramBlock(int num_histograms)
+{
+  off_t ethr_hist_offset;
+  RecRawHistogramBlock *rhb;
+
+  // allocate thread-local histogram memory
+  if ((ethr_hist_offset = eventProcessor.allocate(num_histograms * sizeof(LogLinearHistogram))) == -1) {
+    return NULL;
+  }
+
+  rhb = (RecRawHistogramBlock *)ats_malloc(sizeof(RecRawHistogramBlock));
+  memset(rhb, 0, sizeof(RecRawHistogramBlock));
+  rhb->ethr_hist_offset = ethr_hist_offset;
+  rhb->global = new RecRawHistogram[num_histograms]();
+  rhb->max_histograms = num_histograms;
+  ink_mutex_init(&(rhb->mutex), "raw histogram mutex");
+
+  ink_mutex_acquire(&g_rhb_list_mutex);
+  rhb->next = g_rhb_list;
+  g_rhb_list = rhb;
+  ink_mutex_release(&g_rhb_list_mutex);
+
+  return rhb;
+}
+
+//-------------------------------------------------------------------------
+// RecRegisterRawHistogram
+//-------------------------------------------------------------------------
+int
+RecRegisterRawHistogram(RecRawHistogramBlock *rhb, RecT rec_type, const char *name, int id)
+{
+  Debug("stats", "RecRegisterRawHistogram(%s): rhb pointer:%p id:%d", name, rhb, id);
+
+  ink_assert(id < rhb->max_histograms);
+
+  RecRawHistogram *h = &rhb->global[id];
+  char *names[RAW_HISTOGRAM_METRICS];
+  RecData data_default;
+
+  memset(&data_default, 0, sizeof(RecData));
+  for (int m = 0; m < RAW_HISTOGRAM_METRICS; m++) {
+    size_t len = strlen(name) + strlen(raw_histogram_suffix[m]) + 2;
+
+    names[m] = (char *)ats_malloc(len);
+    snprintf(names[m], len, "%s.%s", name, raw_histogram_suffix[m]);
+    if (RecRegisterStat(rec_type, names[m], RECD_INT, data_default, RECP_NON_PERSISTENT) == NULL) {
+      for (int i = 0; i <= m; i++) {
+        ats_free(names[i]);
+      }
+      return REC_ERR_FAIL;
+    }
+  }
+
+  ink_mutex_acquire(&(rhb->mutex));
+  memcpy(h->names, names, sizeof(names));
+  h->window_time = Thread::get_hrtime();
+  ink_mutex_release(&(rhb->mutex));
+
+  return REC_ERR_OKAY;
+}
+
+//-------------------------------------------------------------------------
+// RecExecRawHistogramSyncs
+//-------------------------------------------------------------------------
+int
+RecExecRawHistogramSyncs()
+{
+  ink_hrtime now = Thread::get_hrtime();
+
+  ink_mutex_acquire(&g_rhb_list_mutex);
+  for (RecRawHistogramBlock *rhb = g_rhb_list; rhb; rhb = rhb->next) {
+    ink_mutex_acquire(&(rhb->mutex));
+    for (int id = 0; id < rhb->max_histograms; id++) {
+      if (rhb->global[id].names[0]) {
+        raw_histogram_sync(rhb, id, now);
+      }
+    }
+    ink_mutex_release(&(rhb->mutex));
+  }
+  ink_mutex_release(&g_rhb_list_mutex);
+
+  return REC_ERR_OKAY;
+}
+
+
 //-------------------------------------------------------------------------
 // RecRawStatSync...
 //-------------------------------------------------------------------------
@@ -880,6 +1077,13 @@ RecExecRawStatSyncCbs()
   RecRecord *r;
   int i, num_records;
 
+  // gather the thread local values of all blocks, for the callbacks below
+  ink_mutex_acquire(&g_rsb_list_mutex);
+  for (RecRawStatBlock *rsb = g_rsb_list; rsb; rsb = rsb->next) {
+    raw_stat_sweep(rsb);
+  }
+  ink_mutex_release(&g_rsb_list_mutex);
+
   num_records = g_num_records;
   for (i = 0; i < num_records; i++) {
     r = &(g_records[i]);
@@ -935,3 +1139,107 @@ RecMessageSend(RecMessage *msg)
 
   return REC_ERR_OKAY;
 }
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+REGRESSION_TEST(RecRawHistogram)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  RecRawHistogramBlock *rhb = RecAllocateRawHistogramBlock(1);
+  RecInt count = 0, sum = 0, p50 = 0, p99 = 0, max = 0;
+
+  box = REGRESSION_TEST_PASSED;
+
+  box.check(rhb != NULL, "allocated a raw histogram block");
+  if (rhb == NULL) {
+    return;
+  }
+  box.check(RecRegisterRawHistogram(rhb, RECT_PROCESS, "proxy.process.regression.raw_histogram", 0) == REC_ERR_OKAY,
+            "registered a raw histogram");
+
+  for (int v = 1; v <= 1000; v++) {
+    RecRecordRawHistogram(rhb, this_ethread(), 0, v);
+  }
+
+  // close the current window right away, so the percentiles are exported
+  RecProcess_set_raw_histogram_window_ms(0);
+  RecExecRawHistogramSyncs();
+  RecProcess_set_raw_histogram_window_ms(REC_RAW_HISTOGRAM_WINDOW_MS);
+
+  RecGetRecordInt("proxy.process.regression.raw_histogram.count", &count);
+  RecGetRecordInt("proxy.process.regression.raw_histogram.sum", &sum);
+  RecGetRecordInt("proxy.process.regression.raw_histogram.p50", &p50);
+  RecGetRecordInt("proxy.process.regression.raw_histogram.p99", &p99);
+  RecGetRecordInt("proxy.process.regression.raw_histogram.max", &max);
+
+  box.check(count == 1000, "count is %" PRId64 ", expected 1000", count);
+  box.check(sum == 500500, "sum is %" PRId64 ", expected 500500", sum);
+  box.check(p50 >= 500 && p50 <= 532, "p50 is %" PRId64 ", expected 500 to 532", p50);
+  box.check(p99 >= 990 && p99 <= 1000, "p99 is %" PRId64 ", expected 990 to 1000", p99);
+  box.check(max == 1000, "max is %" PRId64 ", expected 1000", max);
+}
+
+// Compare the single sweep over each thread's stats with summing every
+// stat over all threads, for a large block and many threads.
+REGRESSION_TEST(RecRawStat_Sweep)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  const int n_stats = 5000;
+  const int n_threads = 64;
+  const int rounds = 20;
+
+  TestBox box(t, pstatus);
+  RecRawStatBlock rsb;
+  EThread *threads[n_threads];
+  RecRawStatLocal *totals = (RecRawStatLocal *)ats_malloc(n_stats * sizeof(RecRawStatLocal));
+  RecRawStatLocal *expected = (RecRawStatLocal *)ats_malloc(n_stats * sizeof(RecRawStatLocal));
+  ink_hrtime start, per_stat_time, sweep_time;
+
+  box = REGRESSION_TEST_PASSED;
+
+  // stand-in threads, holding only the stats of this block
+  memset(&rsb, 0, sizeof(rsb));
+  rsb.ethr_stat_offset = 0;
+  rsb.max_stats = n_stats;
+  for (int i = 0; i < n_threads; i++) {
+    RecRawStatLocal *tlp = (RecRawStatLocal *)ats_malloc(n_stats * sizeof(RecRawStatLocal));
+    for (int id = 0; id < n_stats; id++) {
+      tlp[id].sum = i * id;
+      tlp[id].count = i + id;
+    }
+    threads[i] = (EThread *)tlp;
+  }
+
+  start = ink_get_hrtime_internal();
+  for (int r = 0; r < rounds; r++) {
+    for (int id = 0; id < n_stats; id++) {
+      expected[id].sum = 0;
+      expected[id].count = 0;
+      for (int i = 0; i < n_threads; i++) {
+        RecRawStatLocal *tlp = raw_stat_get_tlp(&rsb, id, threads[i]);
+        expected[id].sum += tlp->sum;
+        expected[id].count += tlp->count;
+      }
+    }
+  }
+  per_stat_time = ink_get_hrtime_internal() - start;
+
+  start = ink_get_hrtime_internal();
+  for (int r = 0; r < rounds; r++) {
+    memset(totals, 0, n_stats * sizeof(RecRawStatLocal));
+    raw_stat_sweep_threads(&rsb, totals, threads, n_threads);
+  }
+  sweep_time = ink_get_hrtime_internal() - start;
+
+  box.check(memcmp(totals, expected, n_stats * sizeof(RecRawStatLocal)) == 0, "sweep totals differ from per stat totals");
+  rprintf(t, "%d stats, %d threads: per stat %.1f us/sync, sweep %.1f us/sync\n", n_stats, n_threads,
+          (double)per_stat_time / rounds / HRTIME_USECOND, (double)sweep_time / rounds / HRTIME_USECOND);
+
+  for (int i = 0; i < n_threads; i++) {
+    ats_free(threads[i]);
+  }
+  ats_free(totals);
+  ats_free(expected);
+}
+
+#endif /* TS_HAS_TESTS */
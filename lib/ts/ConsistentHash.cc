@@ -32,7 +32,7 @@ std::ostream &operator<<(std::ostream &os, ATSConsistentHashNode &thing)
   return os << thing.name;
 }
 
-ATSConsistentHash::ATSConsistentHash(int r, ATSHash64 *h) : replicas(r), hash(h)
+ATSConsistentHash::ATSConsistentHash(int r, ATSHash64 *h, ATSConsistentHashType t) : replicas(r), hash(h), type(t)
 {
 }
 
@@ -56,6 +56,29 @@ ATSConsistentHash::insert(ATSConsistentHashNode *node, float weight, ATSHash64 *
   string_stream << *node;
   std_string = string_stream.str();
 
+  if (type == ATS_CONSISTENT_HASH_MAGLEV) {
+    TableNode tnode;
+    uint64_t hashval[2];
+
+    for (i = 0; i < 2; i++) {
+      snprintf(numstr, 256, "%d-", i);
+      thash->update(numstr, strlen(numstr));
+      thash->update(std_string.c_str(), strlen(std_string.c_str()));
+      thash->final();
+      hashval[i] = thash->get();
+      thash->clear();
+    }
+
+    tnode.node = node;
+    tnode.weight = weight;
+    tnode.offset = hashval[0] % ATS_CONSISTENT_HASH_TABLE_SIZE;
+    tnode.skip = hashval[1] % (ATS_CONSISTENT_HASH_TABLE_SIZE - 1) + 1;
+    TableNodes.push_back(tnode);
+
+    build_table();
+    return;
+  }
+
   for (i = 0; i < (int)roundf(replicas * weight); i++) {
     snprintf(numstr, 256, "%d-", i);
     thash->update(numstr, strlen(numstr));
@@ -99,27 +122,38 @@ ATSConsistentHash::lookup(const char *url, ATSConsistentHashIter *i, bool *w, AT
     thash->final();
     url_hash = thash->get();
     thash->clear();
+  }
+
+  if (type == ATS_CONSISTENT_HASH_MAGLEV) {
+    if (url && !Table.empty()) {
+      iter->slot = url_hash % Table.size();
+      return Table[iter->slot];
+    }
+
+    return table_walk(iter, wptr);
+  }
 
-    *iter = NodeMap.lower_bound(url_hash);
+  if (url) {
+    iter->ring = NodeMap.lower_bound(url_hash);
 
-    if (*iter == NodeMap.end()) {
+    if (iter->ring == NodeMap.end()) {
       *wptr = true;
-      *iter = NodeMap.begin();
+      iter->ring = NodeMap.begin();
     }
   } else {
-    (*iter)++;
+    iter->ring++;
   }
 
-  if (!(*wptr) && *iter == NodeMap.end()) {
+  if (!(*wptr) && iter->ring == NodeMap.end()) {
     *wptr = true;
-    *iter = NodeMap.begin();
+    iter->ring = NodeMap.begin();
   }
 
-  if (*wptr && *iter == NodeMap.end()) {
+  if (*wptr && iter->ring == NodeMap.end()) {
     return NULL;
   }
 
-  return (*iter)->second;
+  return iter->ring->second;
 }
 
 ATSConsistentHashNode *
@@ -155,27 +189,52 @@ ATSConsistentHash::lookup_available(const char *url, ATSConsistentHashIter *i, b
     thash->final();
     url_hash = thash->get();
     thash->clear();
+  }
+
+  if (type == ATS_CONSISTENT_HASH_MAGLEV) {
+    ATSConsistentHashNode *node;
+
+    if (Table.empty()) {
+      return NULL;
+    }
+
+    if (url) {
+      iter->slot = url_hash % Table.size();
+    } else if (iter->slot >= Table.size()) {
+      *wptr = true;
+      iter->slot = 0;
+    }
+
+    node = Table[iter->slot];
+
+    while (node && !node->available) {
+      node = table_walk(iter, wptr);
+    }
+
+    return node;
+  }
 
-    *iter = NodeMap.lower_bound(url_hash);
+  if (url) {
+    iter->ring = NodeMap.lower_bound(url_hash);
   }
 
-  if (*iter == NodeMap.end()) {
+  if (iter->ring == NodeMap.end()) {
     *wptr = true;
-    *iter = NodeMap.begin();
+    iter->ring = NodeMap.begin();
   }
 
-  while (!(*iter)->second->available) {
-    (*iter)++;
+  while (!iter->ring->second->available) {
+    iter->ring++;
 
-    if (!(*wptr) && *iter == NodeMap.end()) {
+    if (!(*wptr) && iter->ring == NodeMap.end()) {
       *wptr = true;
-      *iter = NodeMap.begin();
-    } else if (*wptr && *iter == NodeMap.end()) {
+      iter->ring = NodeMap.begin();
+    } else if (*wptr && iter->ring == NodeMap.end()) {
       return NULL;
     }
   }
 
-  return (*iter)->second;
+  return iter->ring->second;
 }
 
 ATSConsistentHashNode *
@@ -196,14 +255,97 @@ ATSConsistentHash::lookup_by_hashval(uint64_t hashval, ATSConsistentHashIter *i,
     iter = &NodeMapIterUp;
   }
 
-  *iter = NodeMap.lower_bound(hashval);
+  if (type == ATS_CONSISTENT_HASH_MAGLEV) {
+    if (Table.empty()) {
+      return NULL;
+    }
+
+    iter->slot = hashval % Table.size();
+    return Table[iter->slot];
+  }
+
+  iter->ring = NodeMap.lower_bound(hashval);
+
+  if (iter->ring == NodeMap.end()) {
+    *wptr = true;
+    iter->ring = NodeMap.begin();
+  }
+
+  return iter->ring->second;
+}
+
+/*
+  Steps on to the next slot of the table, wrapping around to its start once,
+  like the walk on the ring does.
+ */
+ATSConsistentHashNode *
+ATSConsistentHash::table_walk(ATSConsistentHashIter *iter, bool *wptr)
+{
+  if (Table.empty()) {
+    return NULL;
+  }
+
+  iter->slot++;
+
+  if (iter->slot >= Table.size()) {
+    if (*wptr) {
+      return NULL;
+    }
 
-  if (*iter == NodeMap.end()) {
     *wptr = true;
-    *iter = NodeMap.begin();
+    iter->slot = 0;
+  }
+
+  return Table[iter->slot];
+}
+
+/*
+  Populates the Maglev table. In turn, every node takes the next free slot
+  of its permutation, (offset + j * skip) % size, until all slots are taken.
+  Nodes with less than the largest weight skip their turn in proportion.
+ */
+void
+ATSConsistentHash::build_table()
+{
+  const uint32_t size = ATS_CONSISTENT_HASH_TABLE_SIZE;
+  std::vector<uint32_t> next(TableNodes.size(), 0);
+  std::vector<float> credit(TableNodes.size(), 0);
+  float max_weight = 0;
+  uint32_t i, slot, filled = 0;
+
+  for (i = 0; i < TableNodes.size(); i++) {
+    if (TableNodes[i].weight > max_weight) {
+      max_weight = TableNodes[i].weight;
+    }
+  }
+
+  Table.clear();
+
+  if (max_weight <= 0) {
+    return;
   }
 
-  return (*iter)->second;
+  Table.resize(size, NULL);
+
+  while (filled < size) {
+    for (i = 0; i < TableNodes.size() && filled < size; i++) {
+      TableNode &tnode = TableNodes[i];
+
+      credit[i] += tnode.weight / max_weight;
+      if (credit[i] < 1.0) {
+        continue;
+      }
+      credit[i] -= 1.0;
+
+      do {
+        slot = (tnode.offset + (uint64_t)next[i] * tnode.skip) % size;
+        next[i]++;
+      } while (Table[slot] != NULL);
+
+      Table[slot] = tnode.node;
+      filled++;
+    }
+  }
 }
 
 ATSConsistentHash::~ATSConsistentHash()
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <iostream>
 #include <map>
+#include <vector>
 
 /*
   Helper class to be extended to make ring nodes.
@@ -38,7 +39,31 @@ struct ATSConsistentHashNode {
 
 std::ostream &operator<<(std::ostream &os, ATSConsistentHashNode &thing);
 
-typedef std::map<uint64_t, ATSConsistentHashNode *>::iterator ATSConsistentHashIter;
+/*
+  The ring places replicas of every node at the hashes of their names, and a
+  lookup is a search for the next replica on the ring. The Maglev table
+  (Eisenbud et al, NSDI 2016) fills a table of a prime size with nodes,
+  each node in the order of its own permutation of the slots, and a lookup
+  is an index into the table. Both move few keys when a node is added or
+  removed, and walk on from the position of a lookup to find other nodes.
+ */
+
+enum ATSConsistentHashType {
+  ATS_CONSISTENT_HASH_RING,
+  ATS_CONSISTENT_HASH_MAGLEV,
+};
+
+// Must be prime, and much larger than the number of nodes for an even spread.
+#define ATS_CONSISTENT_HASH_TABLE_SIZE 65537
+
+typedef std::map<uint64_t, ATSConsistentHashNode *>::iterator ATSConsistentHashRingIter;
+
+struct ATSConsistentHashIter {
+  ATSConsistentHashRingIter ring; // ATS_CONSISTENT_HASH_RING
+  uint32_t slot;                  // ATS_CONSISTENT_HASH_MAGLEV
+
+  ATSConsistentHashIter() : slot(0) {}
+};
 
 /*
   TSConsistentHash requires a TSHash64 object
@@ -47,7 +72,7 @@ typedef std::map<uint64_t, ATSConsistentHashNode *>::iterator ATSConsistentHashI
  */
 
 struct ATSConsistentHash {
-  ATSConsistentHash(int r = 1024, ATSHash64 *h = NULL);
+  ATSConsistentHash(int r = 1024, ATSHash64 *h = NULL, ATSConsistentHashType t = ATS_CONSISTENT_HASH_RING);
   void insert(ATSConsistentHashNode *node, float weight = 1.0, ATSHash64 *h = NULL);
   ATSConsistentHashNode *lookup(const char *url = NULL, ATSConsistentHashIter *i = NULL, bool *w = NULL, ATSHash64 *h = NULL);
   ATSConsistentHashNode *lookup_available(const char *url = NULL, ATSConsistentHashIter *i = NULL, bool *w = NULL,
@@ -56,9 +81,22 @@ struct ATSConsistentHash {
   ~ATSConsistentHash();
 
 private:
+  struct TableNode {
+    ATSConsistentHashNode *node;
+    float weight;
+    uint32_t offset; // first slot of the permutation of the node
+    uint32_t skip;   // step of the permutation of the node
+  };
+
+  void build_table();
+  ATSConsistentHashNode *table_walk(ATSConsistentHashIter *iter, bool *wptr);
+
   int replicas;
   ATSHash64 *hash;
+  ATSConsistentHashType type;
   std::map<uint64_t, ATSConsistentHashNode *> NodeMap;
+  std::vector<TableNode> TableNodes;
+  std::vector<ATSConsistentHashNode *> Table;
 };
 
 #endif
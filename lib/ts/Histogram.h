@@ -0,0 +1,214 @@
+/** @file
+
+  Log-linear (HDR style) histogram of unsigned integer samples.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _TS_HISTOGRAM_H_
+#define _TS_HISTOGRAM_H_
+
+#include "ts/ink_platform.h"
+#include "ts/ink_atomic.h"
+
+/** Fixed size log-linear histogram.
+
+    Values below @c SUB_BUCKETS are counted exactly. Above that, every power
+    of two range is split into @c SUB_BUCKETS linear buckets, so a bucket is
+    never wider than 1/SUB_BUCKETS (6.25%) of its lower bound. Values at or
+    above 2^MAX_BITS are counted in the last bucket.
+
+    The bucket array has a fixed size and no pointers, so histograms can be
+    embedded in other structures, merged by adding counts, and updated from
+    several threads with record_atomic().
+*/
+class LogLinearHistogram
+{
+public:
+  static const unsigned SUB_BITS = 4;
+  static const unsigned SUB_BUCKETS = 1 << SUB_BITS;
+  static const unsigned MAX_BITS = 40;
+  static const unsigned N_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+  LogLinearHistogram() { reset(); }
+
+  /// Bucket index for @a value.
+  static unsigned
+  bucket(uint64_t value)
+  {
+    if (value < SUB_BUCKETS) {
+      return static_cast<unsigned>(value);
+    }
+    if (value >> MAX_BITS) {
+      return N_BUCKETS - 1;
+    }
+
+    unsigned shift = (63 - __builtin_clzll(value)) - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<unsigned>((value >> shift) & (SUB_BUCKETS - 1));
+  }
+
+  /// Smallest value counted in bucket @a idx.
+  static uint64_t
+  lower_bound(unsigned idx)
+  {
+    if (idx < SUB_BUCKETS) {
+      return idx;
+    }
+
+    unsigned shift = idx / SUB_BUCKETS - 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + idx % SUB_BUCKETS) << shift;
+  }
+
+  /// Largest value counted in bucket @a idx (the last bucket is open ended).
+  static uint64_t
+  upper_bound(unsigned idx)
+  {
+    return idx + 1 < N_BUCKETS ? lower_bound(idx + 1) - 1 : UINT64_MAX;
+  }
+
+  void
+  record(uint64_t value, uint64_t n = 1)
+  {
+    m_buckets[bucket(value)] += n;
+    m_count += n;
+    m_sum += value * n;
+    if (value > m_max) {
+      m_max = value;
+    }
+  }
+
+  /// Thread safe version of record(); concurrent readers may see a sample
+  /// in the buckets before it shows up in count() or sum().
+  void
+  record_atomic(uint64_t value)
+  {
+    ink_atomic_increment(&m_buckets[bucket(value)], (uint64_t)1);
+    ink_atomic_increment(&m_count, (uint64_t)1);
+    ink_atomic_increment(&m_sum, value);
+
+    uint64_t max = m_max;
+    while (value > max && !ink_atomic_cas(&m_max, max, value)) {
+      max = m_max;
+    }
+  }
+
+  void
+  merge(const LogLinearHistogram &that)
+  {
+    for (unsigned i = 0; i < N_BUCKETS; ++i) {
+      m_buckets[i] += that.m_buckets[i];
+    }
+    m_count += that.m_count;
+    m_sum += that.m_sum;
+    if (that.m_max > m_max) {
+      m_max = that.m_max;
+    }
+  }
+
+  /** Set this histogram to the samples recorded into @a now since @a then
+      was copied from it. The maximum is the upper bound of the highest
+      bucket that grew, capped at the maximum of @a now.
+  */
+  void
+  delta(const LogLinearHistogram &now, const LogLinearHistogram &then)
+  {
+    m_count = 0;
+    m_max = 0;
+    for (unsigned i = 0; i < N_BUCKETS; ++i) {
+      m_buckets[i] = now.m_buckets[i] - then.m_buckets[i];
+      if (m_buckets[i]) {
+        m_count += m_buckets[i];
+        m_max = upper_bound(i);
+      }
+    }
+    m_sum = now.m_sum - then.m_sum;
+    if (m_max > now.m_max) {
+      m_max = now.m_max;
+    }
+  }
+
+  void
+  reset()
+  {
+    memset(this, 0, sizeof(*this));
+  }
+
+  /** Value at quantile @a q (0.0 to 1.0).
+
+      This is the upper bound of the bucket holding the sample of that rank,
+      capped at the largest recorded value. Returns 0 if the histogram is
+      empty.
+  */
+  uint64_t
+  percentile(double q) const
+  {
+    if (m_count == 0) {
+      return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(q * m_count + 0.5);
+    uint64_t seen = 0;
+
+    if (rank < 1) {
+      rank = 1;
+    } else if (rank > m_count) {
+      rank = m_count;
+    }
+    for (unsigned i = 0; i < N_BUCKETS; ++i) {
+      seen += m_buckets[i];
+      if (seen >= rank) {
+        uint64_t bound = upper_bound(i);
+        return bound < m_max ? bound : m_max;
+      }
+    }
+    return m_max;
+  }
+
+  uint64_t
+  count() const
+  {
+    return m_count;
+  }
+
+  uint64_t
+  sum() const
+  {
+    return m_sum;
+  }
+
+  uint64_t
+  max() const
+  {
+    return m_max;
+  }
+
+  uint64_t
+  bucket_count(unsigned idx) const
+  {
+    return m_buckets[idx];
+  }
+
+private:
+  uint64_t m_count;
+  uint64_t m_sum;
+  uint64_t m_max;
+  uint64_t m_buckets[N_BUCKETS];
+};
+
+#endif /* _TS_HISTOGRAM_H_ */
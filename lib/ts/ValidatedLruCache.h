@@ -0,0 +1,197 @@
+/** @file
+
+    Size bounded LRU cache of reference counted, validated entries.
+
+    @note This is a header only library, so that plugins can use it
+    without linking against libtsutil.
+
+    @section license License
+
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#if !defined(TS_VALIDATED_LRU_CACHE_HEADER)
+#define TS_VALIDATED_LRU_CACHE_HEADER
+
+#include <stddef.h>
+#include <pthread.h>
+#include <algorithm>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/** Size bounded LRU cache of values derived from a document, e.g. its
+    parsed form.
+
+    An entry is keyed on the cache key of the document, and a lookup
+    only hits if the validator presented by the caller (built from the
+    ETag, Last-Modified etc. of the document) matches the stored one. A
+    lookup with a different validator drops the stale entry.
+
+    Entries handed out by acquire() are reference counted, so an entry
+    that is in use stays valid until it is handed back via release(),
+    even if it is replaced or evicted meanwhile. All methods are thread
+    safe.
+
+    @a T must be default constructible and swappable.
+ */
+template <typename T> class ValidatedLruCache
+{
+public:
+  struct Entry {
+    std::string key;
+    std::string validator;
+    T value;
+    size_t bytes; ///< What the entry is charged against the cache size.
+
+  private:
+    friend class ValidatedLruCache;
+    int _ref_count;
+    bool _evicted;
+  };
+
+  /// @a max_bytes bounds the sum of the entry sizes held.
+  explicit ValidatedLruCache(size_t max_bytes) : _max_bytes(max_bytes), _bytes(0) { pthread_mutex_init(&_mutex, NULL); }
+
+  ~ValidatedLruCache()
+  {
+    while (!_lru.empty()) {
+      _evict(_lru.begin());
+    }
+    pthread_mutex_destroy(&_mutex);
+  }
+
+  /** Returns the entry for @a key if its validator matches, NULL
+      otherwise. The entry has to be handed back via release(). */
+  const Entry *
+  acquire(const std::string &key, const std::string &validator)
+  {
+    Entry *entry = NULL;
+
+    pthread_mutex_lock(&_mutex);
+    typename EntryMap::iterator map_iter = _entries.find(key);
+    if (map_iter != _entries.end()) {
+      typename EntryList::iterator lru_iter = map_iter->second;
+      if ((*lru_iter)->validator == validator) {
+        entry = *lru_iter;
+        ++entry->_ref_count;
+        _lru.splice(_lru.begin(), _lru, lru_iter);
+      } else {
+        // the document changed, the stale entry is of no further use
+        _evict(lru_iter);
+      }
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    return entry;
+  }
+
+  /** Adds (or replaces) the entry for @a key. @a value is swapped into
+      the cache. @a bytes is the size of the value, the entry is charged
+      that plus the sizes of @a key and @a validator. Returns false, and
+      leaves @a value alone, if the entry is bigger than the cache. */
+  bool
+  insert(const std::string &key, const std::string &validator, T &value, size_t bytes)
+  {
+    bytes += key.size() + validator.size();
+    if (bytes > _max_bytes) {
+      return false;
+    }
+
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->validator = validator;
+    std::swap(entry->value, value);
+    entry->bytes = bytes;
+    entry->_ref_count = 1; // held by the cache itself
+    entry->_evicted = false;
+
+    pthread_mutex_lock(&_mutex);
+    typename EntryMap::iterator map_iter = _entries.find(key);
+    if (map_iter != _entries.end()) {
+      _evict(map_iter->second);
+    }
+    while (!_lru.empty() && _bytes + bytes > _max_bytes) {
+      _evict(--_lru.end());
+    }
+    _lru.push_front(entry);
+    _entries[key] = _lru.begin();
+    _bytes += bytes;
+    pthread_mutex_unlock(&_mutex);
+
+    return true;
+  }
+
+  /// Gives up a reference obtained via acquire().
+  void
+  release(const Entry *entry)
+  {
+    pthread_mutex_lock(&_mutex);
+    _unref(const_cast<Entry *>(entry));
+    pthread_mutex_unlock(&_mutex);
+  }
+
+  size_t
+  bytes() const
+  {
+    return _bytes;
+  }
+
+  int
+  size() const
+  {
+    return _entries.size();
+  }
+
+private:
+  typedef std::list<Entry *> EntryList;
+  typedef std::unordered_map<std::string, typename EntryList::iterator> EntryMap;
+
+  size_t _max_bytes;
+  size_t _bytes;
+  EntryList _lru; ///< Most recently used at the front.
+  EntryMap _entries;
+  pthread_mutex_t _mutex;
+
+  // Called with the mutex held.
+  void
+  _evict(typename EntryList::iterator lru_iter)
+  {
+    Entry *entry = *lru_iter;
+
+    _bytes -= entry->bytes;
+    _entries.erase(entry->key);
+    _lru.erase(lru_iter);
+    entry->_evicted = true;
+    _unref(entry);
+  }
+
+  // Called with the mutex held.
+  void
+  _unref(Entry *entry)
+  {
+    if (--entry->_ref_count == 0 && entry->_evicted) {
+      delete entry;
+    }
+  }
+
+  // not copyable
+  ValidatedLruCache(const ValidatedLruCache &);
+  ValidatedLruCache &operator=(const ValidatedLruCache &);
+};
+
+#endif // TS_VALIDATED_LRU_CACHE_HEADER
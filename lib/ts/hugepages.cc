@@ -20,9 +20,12 @@
  */
 
 #include <cstdio>
+#include <unistd.h>
 #include <sys/mman.h>
 #include "ts/Diags.h"
 #include "ts/ink_align.h"
+#include "ts/ink_mutex.h"
+#include "ts/hugepages.h"
 
 #define DEBUG_TAG "hugepages"
 
@@ -32,8 +35,27 @@
 #define TOKEN "Hugepagesize:"
 #define TOKEN_SIZE (strlen(TOKEN))
 
+#define GIGANTIC_PATH "/sys/kernel/mm/hugepages/hugepages-1048576kB"
+#define GIGANTIC_SIZE (1024 * 1024 * 1024)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// The arena maps this much at a time and hands out pieces of it, unless it
+// has 1GB pages, then a slab is one such page.
+#define ARENA_SLAB_SIZE (64 * 1024 * 1024)
+
 static int hugepage_size = -1;
 static bool hugepage_enabled;
+static bool hugepage_gigantic;
+
+static ink_mutex arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *arena_cur;
+static char *arena_end;
+static size_t arena_size[HUGEPAGE_ARENA_BACKINGS];
 #endif
 
 size_t
@@ -100,7 +122,12 @@ ats_hugepage_init(int enabled)
     hugepage_enabled = true;
   }
 
-  Debug(DEBUG_TAG, "Hugepage size = %d", hugepage_size);
+  // 2 also lets the arena use 1GB pages, if the kernel has a pool of them.
+  if (hugepage_enabled && enabled > 1 && hugepage_size < GIGANTIC_SIZE && access(GIGANTIC_PATH, F_OK) == 0) {
+    hugepage_gigantic = true;
+  }
+
+  Debug(DEBUG_TAG, "Hugepage size = %d, 1GB pages %s", hugepage_size, hugepage_gigantic ? "enabled" : "disabled");
 #else
   Debug(DEBUG_TAG, "MAP_HUGETLB not defined");
 #endif
@@ -145,3 +172,130 @@ ats_free_hugepage(void *ptr, size_t s)
   return false;
 #endif
 }
+
+#ifdef MAP_HUGETLB
+// Map size bytes (a multiple of the page size of backing) for the arena.
+static char *
+arena_map(size_t size, HugepageArenaBacking backing)
+{
+  void *mem = MAP_FAILED;
+
+  switch (backing) {
+  case HUGEPAGE_ARENA_GIGANTIC:
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    break;
+  case HUGEPAGE_ARENA_HUGETLB:
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    break;
+  default: {
+    // No reserved huge pages left, map regular pages aligned to the huge page
+    // size and ask the kernel to back them with transparent huge pages.
+    size_t align = ats_hugepage_size();
+    char *p;
+
+    mem = mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      break;
+    }
+    p = (char *)INK_ALIGN((uintptr_t)mem, align);
+    if (p != mem) {
+      munmap(mem, p - (char *)mem);
+    }
+    munmap(p + size, align - (p - (char *)mem));
+    mem = p;
+#ifdef MADV_HUGEPAGE
+    madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    break;
+  }
+  }
+
+  if (mem == MAP_FAILED) {
+    Debug(DEBUG_TAG, "Could not map arena size = %zu", size);
+    return NULL;
+  }
+
+  arena_size[backing] += size;
+  Debug(DEBUG_TAG, "Arena mapped %zu bytes of %s", size,
+        backing == HUGEPAGE_ARENA_GIGANTIC ? "1GB pages" : backing == HUGEPAGE_ARENA_HUGETLB ? "huge pages" : "THP");
+
+  return (char *)mem;
+}
+
+// Map size bytes of default sized huge pages, or of THP if the pool is empty.
+static char *
+arena_map_default(size_t size)
+{
+  char *mem = arena_map(size, HUGEPAGE_ARENA_HUGETLB);
+
+  return mem ? mem : arena_map(size, HUGEPAGE_ARENA_TRANSPARENT);
+}
+#endif
+
+void *
+ats_alloc_hugepage_arena(size_t s)
+{
+#ifdef MAP_HUGETLB
+  size_t size;
+  char *mem = NULL;
+
+  if (!hugepage_enabled) {
+    return NULL;
+  }
+
+  size = INK_ALIGN(s, ats_hugepage_size());
+
+  ink_mutex_acquire(&arena_mutex);
+  if (size >= ARENA_SLAB_SIZE) {
+    // Big enough to get its own mapping, keep carving the current slab. Only
+    // use 1GB pages when the mapping fills them.
+    if (hugepage_gigantic && size % GIGANTIC_SIZE == 0) {
+      mem = arena_map(size, HUGEPAGE_ARENA_GIGANTIC);
+    }
+    if (!mem) {
+      mem = arena_map_default(size);
+    }
+  } else {
+    if ((size_t)(arena_end - arena_cur) < size) {
+      // The tail of the old slab is abandoned, it is less than size. A slab
+      // is a single 1GB page when there are any, else ARENA_SLAB_SIZE.
+      size_t slab_size = GIGANTIC_SIZE;
+      char *slab = NULL;
+
+      if (hugepage_gigantic) {
+        slab = arena_map(slab_size, HUGEPAGE_ARENA_GIGANTIC);
+      }
+      if (!slab) {
+        slab_size = ARENA_SLAB_SIZE;
+        slab = arena_map_default(slab_size);
+      }
+      if (slab) {
+        arena_cur = slab;
+        arena_end = slab + slab_size;
+      }
+    }
+    if ((size_t)(arena_end - arena_cur) >= size) {
+      mem = arena_cur;
+      arena_cur += size;
+    }
+  }
+  ink_mutex_release(&arena_mutex);
+
+  return mem;
+#else
+  (void)s;
+  Debug(DEBUG_TAG, "MAP_HUGETLB not defined");
+  return NULL;
+#endif
+}
+
+size_t
+ats_hugepage_arena_size(HugepageArenaBacking backing)
+{
+#ifdef MAP_HUGETLB
+  return arena_size[backing];
+#else
+  (void)backing;
+  return 0;
+#endif
+}
@@ -29,4 +29,19 @@ void ats_hugepage_init(int);
 void *ats_alloc_hugepage(size_t);
 bool ats_free_hugepage(void *, size_t);
 
+// Carve memory that is never freed (e.g. freelist chunks) out of large huge
+// page backed slabs. Falls back from 1GB to default sized huge pages and then
+// to transparent huge pages. Returns NULL if huge pages are not enabled.
+void *ats_alloc_hugepage_arena(size_t);
+
+enum HugepageArenaBacking {
+  HUGEPAGE_ARENA_GIGANTIC,    // 1GB pages
+  HUGEPAGE_ARENA_HUGETLB,     // default size hugetlb pages
+  HUGEPAGE_ARENA_TRANSPARENT, // madvise(MADV_HUGEPAGE) on regular pages
+  HUGEPAGE_ARENA_BACKINGS
+};
+
+// Bytes mapped by the arena with the given backing.
+size_t ats_hugepage_arena_size(HugepageArenaBacking);
+
 #endif
@@ -49,6 +49,7 @@
 #include "ts/ink_error.h"
 #include "ts/ink_assert.h"
 #include "ts/ink_align.h"
+#include "ts/ink_thread.h"
 #include "ts/hugepages.h"
 
 inkcoreapi volatile int64_t fastalloc_mem_in_use = 0;
@@ -91,6 +92,50 @@ static const ink_freelist_ops *default_ops = &freelist_ops;
 static ink_freelist_list *freelists = NULL;
 static const ink_freelist_ops *freelist_freelist_ops = default_ops;
 
+/*
+ * Per-thread magazines.
+ *
+ * Every thread keeps, for each freelist it touches, a loaded magazine and
+ * a previous one, both plain item chains linked through the first word of
+ * each item. Allocation and free only touch these. When both are empty
+ * (or both full) a whole magazine is taken from (or handed to) the
+ * freelist's depot with a single atomic list operation. Empty magazine
+ * descriptors are recycled through the depot and never freed, so the
+ * atomic lists never see a stale pointer.
+ */
+
+#define FREELIST_MAGAZINE_BYTES (64 * 1024)
+#define FREELIST_MAGAZINE_DEFAULT 32
+
+typedef struct _ink_freelist_magazine {
+  struct _ink_freelist_magazine *next;
+  void *head;
+  uint32_t count;
+} ink_freelist_magazine;
+
+struct _InkFreeListDepot {
+  InkAtomicList full;  // magazines holding free items
+  InkAtomicList empty; // spare descriptors
+};
+
+typedef struct {
+  InkFreeList *fl;
+  void *loaded;
+  void *previous;
+  uint32_t loaded_count, previous_count;
+} ink_freelist_cache;
+
+typedef struct {
+  uint32_t size;
+  ink_freelist_cache slot[1];
+} ink_freelist_thread_cache;
+
+static uint32_t freelist_count = 0;
+static uint32_t freelist_magazine_items = FREELIST_MAGAZINE_DEFAULT;
+static ink_thread_key freelist_cache_key;
+
+static void freelist_cache_destroy(void *data);
+
 const InkFreeListOps *
 ink_freelist_malloc_ops()
 {
@@ -111,6 +156,32 @@ ink_freelist_init_ops(const InkFreeListOps *ops)
   ink_release_assert(freelist_freelist_ops == default_ops);
 
   freelist_freelist_ops = ops;
+  // The thread caches sit on top of the freelist ops, the other ops hand every object straight back.
+  ink_freelist_set_magazine_size(freelist_magazine_items);
+}
+
+static uint32_t
+freelist_magazine_size(InkFreeList *f)
+{
+  uint32_t n;
+
+  if (freelist_freelist_ops != &freelist_ops)
+    return 0;
+  n = FREELIST_MAGAZINE_BYTES / f->type_size;
+  if (n > freelist_magazine_items)
+    n = freelist_magazine_items;
+  // A single item magazine just moves the contention to the depot.
+  return n < 2 ? 0 : n;
+}
+
+void
+ink_freelist_set_magazine_size(uint32_t items)
+{
+  ink_freelist_list *fll;
+
+  freelist_magazine_items = items;
+  for (fll = freelists; fll; fll = fll->next)
+    fll->fl->magazine_size = freelist_magazine_size(fll->fl);
 }
 
 void
@@ -129,6 +200,10 @@ ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size, uint32
   fll->next = freelists;
   freelists = fll;
 
+  if (freelist_count == 0)
+    ink_thread_key_create(&freelist_cache_key, freelist_cache_destroy);
+  f->index = freelist_count++;
+
 
   f->name = name;
   /* quick test for power of 2 */
@@ -147,6 +222,11 @@ ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size, uint32
   }
   SET_FREELIST_POINTER_VERSION(f->head, FROM_PTR(0), 0);
 
+  f->depot = (struct _InkFreeListDepot *)ats_malloc(sizeof(struct _InkFreeListDepot));
+  ink_atomiclist_init(&f->depot->full, name, 0);
+  ink_atomiclist_init(&f->depot->empty, name, 0);
+  f->magazine_size = freelist_magazine_size(f);
+
   *fl = f;
 }
 
@@ -173,11 +253,129 @@ ink_freelist_create(const char *name, uint32_t type_size, uint32_t chunk_size, u
 int fake_global_for_ink_queue = 0;
 #endif
 
+static ink_freelist_cache *
+freelist_cache_grow(InkFreeList *f, ink_freelist_thread_cache *tc)
+{
+  uint32_t old_size = tc ? tc->size : 0;
+  uint32_t size = freelist_count > f->index ? freelist_count : f->index + 1;
+
+  tc = (ink_freelist_thread_cache *)ats_realloc(tc, sizeof(ink_freelist_thread_cache) + (size - 1) * sizeof(ink_freelist_cache));
+  memset(&tc->slot[old_size], 0, (size - old_size) * sizeof(ink_freelist_cache));
+  tc->size = size;
+  ink_thread_setspecific(freelist_cache_key, tc);
+
+  return &tc->slot[f->index];
+}
+
+static inline ink_freelist_cache *
+freelist_cache(InkFreeList *f)
+{
+  ink_freelist_thread_cache *tc = (ink_freelist_thread_cache *)ink_thread_getspecific(freelist_cache_key);
+
+  if (likely(tc && f->index < tc->size))
+    return &tc->slot[f->index];
+  return freelist_cache_grow(f, tc);
+}
+
+// Load an empty thread cache with a magazine from the depot, or with a
+// fresh magazine pulled off the shared list if the depot is empty.
+static void
+freelist_magazine_refill(InkFreeList *f, ink_freelist_cache *c)
+{
+  ink_freelist_magazine *m = (ink_freelist_magazine *)ink_atomiclist_pop(&f->depot->full);
+
+  if (m) {
+    c->loaded = m->head;
+    c->loaded_count = m->count;
+    ink_atomiclist_push(&f->depot->empty, m);
+  } else {
+    c->loaded = NULL;
+    for (c->loaded_count = 0; c->loaded_count < f->magazine_size; c->loaded_count++) {
+      void *item = freelist_new(f);
+      *ADDRESS_OF_NEXT(item, 0) = c->loaded;
+      c->loaded = item;
+    }
+  }
+  c->fl = f;
+
+  ink_atomic_increment((int *)&f->used, c->loaded_count);
+  ink_atomic_increment(&fastalloc_mem_in_use, (int64_t)f->type_size * c->loaded_count);
+}
+
+// Hand the previous magazine of a full thread cache to the depot.
+static void
+freelist_magazine_flush(InkFreeList *f, ink_freelist_cache *c)
+{
+  ink_freelist_magazine *m = (ink_freelist_magazine *)ink_atomiclist_pop(&f->depot->empty);
+
+  if (m == NULL)
+    m = (ink_freelist_magazine *)ats_malloc(sizeof(ink_freelist_magazine));
+  m->head = c->previous;
+  m->count = c->previous_count;
+  ink_atomiclist_push(&f->depot->full, m);
+
+  ink_atomic_decrement((int *)&f->used, c->previous_count);
+  ink_atomic_decrement(&fastalloc_mem_in_use, (int64_t)f->type_size * c->previous_count);
+
+  c->previous = NULL;
+  c->previous_count = 0;
+}
+
+static void
+freelist_cache_release(InkFreeList *f, void *head, uint32_t count)
+{
+  void *tail = head;
+
+  if (count == 0)
+    return;
+  while (*ADDRESS_OF_NEXT(tail, 0))
+    tail = *ADDRESS_OF_NEXT(tail, 0);
+  freelist_bulkfree(f, head, tail, count);
+  ink_atomic_decrement((int *)&f->used, count);
+  ink_atomic_decrement(&fastalloc_mem_in_use, (int64_t)f->type_size * count);
+}
+
+// Thread exit, give everything the thread still caches back to the shared lists.
+static void
+freelist_cache_destroy(void *data)
+{
+  ink_freelist_thread_cache *tc = (ink_freelist_thread_cache *)data;
+
+  for (uint32_t i = 0; i < tc->size; i++) {
+    ink_freelist_cache *c = &tc->slot[i];
+    if (c->fl) {
+      freelist_cache_release(c->fl, c->loaded, c->loaded_count);
+      freelist_cache_release(c->fl, c->previous, c->previous_count);
+    }
+  }
+  ats_free(tc);
+}
+
 void *
 ink_freelist_new(InkFreeList *f)
 {
   void *ptr;
 
+  if (f->magazine_size) {
+    ink_freelist_cache *c = freelist_cache(f);
+
+    if (unlikely(c->loaded_count == 0)) {
+      if (c->previous_count) {
+        c->loaded = c->previous;
+        c->loaded_count = c->previous_count;
+        c->previous = NULL;
+        c->previous_count = 0;
+      } else {
+        freelist_magazine_refill(f, c);
+      }
+    }
+    ptr = c->loaded;
+    c->loaded = *ADDRESS_OF_NEXT(ptr, 0);
+    c->loaded_count--;
+    ink_assert(!((uintptr_t)ptr & (((uintptr_t)f->alignment) - 1)));
+    return ptr;
+  }
+
   if (likely(ptr = freelist_freelist_ops->fl_new(f))) {
     ink_atomic_increment((int *)&f->used, 1);
     ink_atomic_increment(&fastalloc_mem_in_use, (int64_t)f->type_size);
@@ -203,7 +401,7 @@ freelist_new(InkFreeList *f)
 
       if (ats_hugepage_enabled()) {
         alloc_size = INK_ALIGN(f->chunk_size * f->type_size, ats_hugepage_size());
-        newp = ats_alloc_hugepage(alloc_size);
+        newp = ats_alloc_hugepage_arena(alloc_size);
       }
 
       if (newp == NULL) {
@@ -267,6 +465,33 @@ ink_freelist_free(InkFreeList *f, void *item)
 {
   if (likely(item != NULL)) {
     ink_assert(f->used != 0);
+    if (f->magazine_size) {
+      ink_freelist_cache *c = freelist_cache(f);
+
+#ifdef DEADBEEF
+      static const char str[4] = {(char)0xde, (char)0xad, (char)0xbe, (char)0xef};
+      for (int j = 0; j < (int)f->type_size; j++)
+        ((char *)item)[j] = str[j % 4];
+#endif /* DEADBEEF */
+#ifdef SANITY
+      if (c->loaded == item || c->previous == item)
+        ink_fatal("ink_freelist_free: trying to free item twice");
+#endif /* SANITY */
+
+      if (unlikely(c->loaded_count >= f->magazine_size)) {
+        if (c->previous_count)
+          freelist_magazine_flush(f, c);
+        c->previous = c->loaded;
+        c->previous_count = c->loaded_count;
+        c->loaded = NULL;
+        c->loaded_count = 0;
+      }
+      *ADDRESS_OF_NEXT(item, 0) = c->loaded;
+      c->loaded = item;
+      c->loaded_count++;
+      c->fl = f;
+      return;
+    }
     freelist_freelist_ops->fl_free(f, item);
     ink_atomic_decrement((int *)&f->used, 1);
     ink_atomic_decrement(&fastalloc_mem_in_use, f->type_size);
@@ -144,12 +144,19 @@ typedef union {
 #error "unsupported processor"
 #endif
 
+struct _InkFreeListDepot;
+
 struct _InkFreeList {
   volatile head_p head;
   const char *name;
   uint32_t type_size, chunk_size, used, allocated, alignment;
   uint32_t allocated_base, used_base;
   int advice;
+  /* Per-thread magazine state. index selects this list's slot in each thread's
+     cache, magazine_size is the number of items moved to/from the depot at a
+     time (0 when the list bypasses the thread caches). */
+  uint32_t index, magazine_size;
+  struct _InkFreeListDepot *depot;
 };
 
 inkcoreapi extern volatile int64_t fastalloc_mem_in_use;
@@ -174,6 +181,16 @@ inkcoreapi void ink_freelist_madvise_init(InkFreeList **fl, const char *name, ui
 inkcoreapi void *ink_freelist_new(InkFreeList *f);
 inkcoreapi void ink_freelist_free(InkFreeList *f, void *item);
 inkcoreapi void ink_freelist_free_bulk(InkFreeList *f, void *head, void *tail, size_t num_item);
+
+/*
+ * Set the maximum number of items in a per-thread magazine. Each thread
+ * caches up to two magazines per freelist and trades whole magazines with
+ * a shared depot, so the list head is touched once per magazine rather
+ * than once per item. Magazines are also capped by size in bytes, so very
+ * large types bypass the caches. 0 disables the caches. Items held in a
+ * thread cache are reported as in use.
+ */
+inkcoreapi void ink_freelist_set_magazine_size(uint32_t items);
 void ink_freelists_dump(FILE *f);
 void ink_freelists_dump_baselinerel(FILE *f);
 void ink_freelists_snap_baseline();
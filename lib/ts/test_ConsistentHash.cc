@@ -0,0 +1,221 @@
+/** @file
+
+  Test code for the consistent hash ring and Maglev table.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ts/ink_assert.h"
+#include "ts/ink_defs.h"
+#include "ts/ConsistentHash.h"
+#include "ts/HashSip.h"
+
+#define N_NODES 10
+#define N_BENCH_NODES 64
+#define N_KEYS 100000
+
+static const char *type_names[] = {"ring", "maglev"};
+
+struct TestNode : ATSConsistentHashNode {
+  int idx;
+};
+
+static TestNode nodes[N_BENCH_NODES];
+
+// Builds a hash of the nodes [0, n), skipping the node skip, with node 0 weighted double if weighted is set.
+static ATSConsistentHash *
+build(ATSConsistentHashType type, int n, int skip = -1, bool weighted = false)
+{
+  ATSConsistentHash *chash = new ATSConsistentHash(1024, new ATSHash64Sip24, type);
+
+  for (int i = 0; i < n; i++) {
+    if (i != skip) {
+      chash->insert(&nodes[i], (weighted && i == 0) ? 2.0 : 1.0);
+    }
+  }
+
+  return chash;
+}
+
+static uint64_t
+key_hash(int key)
+{
+  ATSHash64Sip24 h;
+
+  h.update(&key, sizeof(key));
+  h.final();
+  return h.get();
+}
+
+static int
+lookup(ATSConsistentHash *chash, int key)
+{
+  return static_cast<TestNode *>(chash->lookup_by_hashval(key_hash(key)))->idx;
+}
+
+static void
+test_spread(ATSConsistentHashType type)
+{
+  int counts[N_NODES] = {0};
+  ATSConsistentHash *chash = build(type, N_NODES, -1, true);
+
+  for (int key = 0; key < N_KEYS; key++) {
+    counts[lookup(chash, key)]++;
+  }
+
+  // node 0 has double weight, so 2/11th of the keys are expected on it and 1/11th on all others.
+  printf("%s spread:", type_names[type]);
+  for (int i = 0; i < N_NODES; i++) {
+    double expected = (i == 0 ? 2.0 : 1.0) * N_KEYS / (N_NODES + 1);
+
+    printf(" %d", counts[i]);
+    ink_release_assert(counts[i] > expected * 0.8 && counts[i] < expected * 1.2);
+  }
+  printf("\n");
+
+  delete chash;
+}
+
+// Returns the percentage of the keys which move to another node between two hashes, leaving out the keys
+// which have to move, those of a removed node and those which a new node takes.
+static double
+test_disruption(ATSConsistentHashType type, const char *what, ATSConsistentHash *before, ATSConsistentHash *after, int changed)
+{
+  int moved = 0;
+
+  for (int key = 0; key < N_KEYS; key++) {
+    int b = lookup(before, key);
+    int a = lookup(after, key);
+
+    if (a != b && a != changed && b != changed) {
+      moved++;
+    }
+  }
+
+  printf("%s %s: %.2f%% of the other keys moved\n", type_names[type], what, 100.0 * moved / N_KEYS);
+
+  delete before;
+  delete after;
+
+  return 100.0 * moved / N_KEYS;
+}
+
+static void
+test_walk(ATSConsistentHashType type)
+{
+  ATSConsistentHash *chash = build(type, N_NODES);
+
+  for (int key = 0; key < 100; key++) {
+    ATSConsistentHashIter iter;
+    bool wrapped = false, seen[N_NODES] = {false};
+    int n_seen = 0;
+    TestNode *node = static_cast<TestNode *>(chash->lookup_by_hashval(key_hash(key), &iter, &wrapped));
+
+    // Walking on from a lookup visits every node before it ends
+    while (node) {
+      if (!seen[node->idx]) {
+        seen[node->idx] = true;
+        n_seen++;
+      }
+      node = static_cast<TestNode *>(chash->lookup(NULL, &iter, &wrapped));
+    }
+    ink_release_assert(n_seen == N_NODES);
+  }
+
+  // The first available node is the first node of the walk which is available
+  for (int key = 0; key < 100; key++) {
+    ATSConsistentHashIter iter;
+    bool wrapped = false;
+    char url[32];
+    TestNode *first, *avail;
+
+    snprintf(url, sizeof(url), "/%d", key);
+    first = static_cast<TestNode *>(chash->lookup(url));
+    first->available = false;
+
+    avail = static_cast<TestNode *>(chash->lookup_available(url, &iter, &wrapped));
+    ink_release_assert(avail != NULL && avail != first && avail->available);
+
+    first->available = true;
+  }
+
+  for (int i = 0; i < N_NODES; i++) {
+    nodes[i].available = false;
+  }
+  ink_release_assert(chash->lookup_available("/all-down") == NULL);
+  for (int i = 0; i < N_NODES; i++) {
+    nodes[i].available = true;
+  }
+
+  delete chash;
+}
+
+static void
+test_benchmark(ATSConsistentHashType type)
+{
+  const int n_lookups = 1000000;
+  ATSConsistentHash *chash = build(type, N_BENCH_NODES);
+  struct timespec start, end;
+  uint64_t hashval = 0x9e3779b97f4a7c15ULL, sum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < n_lookups; i++) {
+    hashval = hashval * 6364136223846793005ULL + 1442695040888963407ULL;
+    sum += static_cast<TestNode *>(chash->lookup_by_hashval(hashval))->idx;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("%s lookup of %d nodes: %.1f ns (%llu)\n", type_names[type], N_BENCH_NODES,
+         ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / n_lookups, (unsigned long long)sum);
+
+  delete chash;
+}
+
+int
+main(int /* argc ATS_UNUSED */, char ** /* argv ATS_UNUSED */)
+{
+  static char names[N_BENCH_NODES][32];
+
+  for (int i = 0; i < N_BENCH_NODES; i++) {
+    snprintf(names[i], sizeof(names[i]), "parent%d.example.com", i);
+    nodes[i].available = true;
+    nodes[i].name = names[i];
+    nodes[i].idx = i;
+  }
+
+  for (int t = ATS_CONSISTENT_HASH_RING; t <= ATS_CONSISTENT_HASH_MAGLEV; t++) {
+    ATSConsistentHashType type = static_cast<ATSConsistentHashType>(t);
+
+    test_spread(type);
+    test_walk(type);
+
+    // Removing or adding a node moves few of the keys which neither were nor are on that node
+    ink_release_assert(test_disruption(type, "removing a node", build(type, N_NODES), build(type, N_NODES, 3), 3) < 5.0);
+    ink_release_assert(test_disruption(type, "adding a node", build(type, N_NODES), build(type, N_NODES + 1), N_NODES) < 5.0);
+  }
+
+  for (int t = ATS_CONSISTENT_HASH_RING; t <= ATS_CONSISTENT_HASH_MAGLEV; t++) {
+    test_benchmark(static_cast<ATSConsistentHashType>(t));
+  }
+
+  printf("test_ConsistentHash PASSED\n");
+}
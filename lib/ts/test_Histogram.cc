@@ -0,0 +1,114 @@
+/** @file
+
+  Unit tests for LogLinearHistogram.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdio.h>
+#include "ts/ink_assert.h"
+#include "ts/Histogram.h"
+
+typedef LogLinearHistogram H;
+
+static void
+test_buckets()
+{
+  // Buckets are contiguous and every value lands between its bounds.
+  for (unsigned i = 0; i + 1 < H::N_BUCKETS; ++i) {
+    ink_release_assert(H::upper_bound(i) + 1 == H::lower_bound(i + 1));
+    ink_release_assert(H::bucket(H::lower_bound(i)) == i);
+    ink_release_assert(H::bucket(H::upper_bound(i)) == i);
+  }
+
+  for (uint64_t v = 1; v < (1ULL << H::MAX_BITS); v = v * 3 + 1) {
+    unsigned idx = H::bucket(v);
+    ink_release_assert(H::lower_bound(idx) <= v && v <= H::upper_bound(idx));
+    // relative width is bounded by 1/SUB_BUCKETS
+    ink_release_assert((H::upper_bound(idx) - H::lower_bound(idx)) * H::SUB_BUCKETS <= H::lower_bound(idx) + H::SUB_BUCKETS);
+  }
+
+  ink_release_assert(H::bucket(UINT64_MAX) == H::N_BUCKETS - 1);
+  ink_release_assert(H::bucket(1ULL << H::MAX_BITS) == H::N_BUCKETS - 1);
+}
+
+static void
+test_percentiles()
+{
+  H h;
+
+  ink_release_assert(h.percentile(0.5) == 0);
+
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    h.record(v);
+  }
+  ink_release_assert(h.count() == 10000);
+  ink_release_assert(h.sum() == 10000ULL * 10001 / 2);
+  ink_release_assert(h.max() == 10000);
+  ink_release_assert(h.percentile(1.0) == 10000);
+
+  const double qs[] = {0.5, 0.9, 0.99, 0.999};
+  for (unsigned i = 0; i < sizeof(qs) / sizeof(qs[0]); ++i) {
+    uint64_t exact = (uint64_t)(qs[i] * 10000);
+    uint64_t p = h.percentile(qs[i]);
+    ink_release_assert(p >= exact && p - exact <= exact / H::SUB_BUCKETS);
+  }
+
+  H other;
+  other.record(50000, 10000);
+  h.merge(other);
+  ink_release_assert(h.count() == 20000);
+  ink_release_assert(h.max() == 50000);
+  ink_release_assert(h.percentile(0.25) < 10000);
+  ink_release_assert(h.percentile(0.75) >= 50000 - 50000 / H::SUB_BUCKETS);
+
+  H window;
+  window.delta(h, other);
+  ink_release_assert(window.count() == 10000);
+  ink_release_assert(window.sum() == 10000ULL * 10001 / 2);
+  ink_release_assert(window.max() >= 10000 && window.max() - 10000 <= 10000 / H::SUB_BUCKETS);
+
+  h.reset();
+  ink_release_assert(h.count() == 0 && h.max() == 0 && h.percentile(0.99) == 0);
+}
+
+static void
+test_atomic()
+{
+  H a, b;
+
+  for (uint64_t v = 0; v < 5000; v += 7) {
+    a.record(v);
+    b.record_atomic(v);
+  }
+  ink_release_assert(a.count() == b.count() && a.sum() == b.sum() && a.max() == b.max());
+  for (unsigned i = 0; i < H::N_BUCKETS; ++i) {
+    ink_release_assert(a.bucket_count(i) == b.bucket_count(i));
+  }
+}
+
+int
+main(int /* argc ATS_UNUSED */, const char ** /* argv ATS_UNUSED */)
+{
+  test_buckets();
+  test_percentiles();
+  test_atomic();
+  printf("test_Histogram PASSED\n");
+  return 0;
+}
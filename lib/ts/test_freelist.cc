@@ -25,10 +25,14 @@
 #include <string.h>
 #include "ts/ink_thread.h"
 #include "ts/ink_queue.h"
+#include "ts/ink_atomic.h"
 
 
 #define NTHREADS 64
+#define RUN_SECONDS 1
 InkFreeList *flist = NULL;
+volatile int running = 0;
+volatile int64_t total_pairs = 0;
 
 
 void *
@@ -39,9 +43,8 @@ test(void *d)
 
   id = (intptr_t)d;
 
-  time_t start = time(NULL);
-  int count = 0;
-  for (;;) {
+  int64_t count = 0;
+  while (running) {
     m1 = ink_freelist_new(flist);
     m2 = ink_freelist_new(flist);
     m3 = ink_freelist_new(flist);
@@ -60,27 +63,51 @@ test(void *d)
     ink_freelist_free(flist, m2);
     ink_freelist_free(flist, m3);
 
-    // break out of the test if we have run more then 60 seconds
-    if (++count % 1000 == 0 && (start + 60) < time(NULL)) {
-      return NULL;
-    }
+    count += 3;
+  }
+
+  ink_atomic_increment(&total_pairs, count);
+  return NULL;
+}
+
+// Run nthreads allocating and freeing for RUN_SECONDS and report the alloc/free pairs per second.
+static void
+bench(int nthreads, uint32_t magazine_size)
+{
+  ink_thread threads[NTHREADS];
+
+  ink_freelist_set_magazine_size(magazine_size);
+  total_pairs = 0;
+  running = 1;
+  for (int i = 0; i < nthreads; i++) {
+    threads[i] = ink_thread_create(test, (void *)((intptr_t)i));
+  }
+
+  sleep(RUN_SECONDS);
+  running = 0;
+  for (int i = 0; i < nthreads; i++) {
+    ink_thread_join(threads[i]);
   }
+
+  printf("%2d threads, magazine %3u: %12" PRId64 " alloc/free pairs per second\n", nthreads, magazine_size,
+         total_pairs / RUN_SECONDS);
 }
 
 
 int
 main(int /* argc ATS_UNUSED */, char * /*argv ATS_UNUSED */ [])
 {
-  int i;
-
   flist = ink_freelist_create("woof", 64, 256, 8);
 
-  for (i = 0; i < NTHREADS; i++) {
-    fprintf(stderr, "Create thread %d\n", i);
-    ink_thread_create(test, (void *)((intptr_t)i));
+  for (int n = 1; n <= NTHREADS; n *= 2) {
+    bench(n, 0);
+    bench(n, 32);
   }
 
-  test((void *)NTHREADS);
+  if (flist->used != 0) {
+    printf("%u items still in use after all threads exited\n", flist->used);
+    exit(1);
+  }
 
   return 0;
 }
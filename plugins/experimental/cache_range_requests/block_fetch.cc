@@ -0,0 +1,663 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * The client transaction is intercepted, and the requested range is
+ * assembled from the blocks that cover it.  The blocks are fetched one
+ * after the other with TSHttpConnect(), each with a "Range: bytes=" header
+ * for exactly one block, so they are looked up in (and written to) the
+ * cache by range_header_check() like any other range request.
+ *
+ * The response to the client is built from the headers of the first
+ * block: the status is 206, and Content-Range and Content-Length describe
+ * the requested range.  Later blocks must agree with the first one on the
+ * object size and ETag; if they do not, the client connection is aborted,
+ * as the response headers are gone by then.  If the first block request
+ * does not get a usable 206 (e.g. the origin ignores ranges, or the range
+ * is not satisfiable), that response is passed to the client as is.
+ *
+ * The last block is always read to its end, even when the client range
+ * stops earlier, so that it is cached whole.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "ts/ts.h"
+#include "block_fetch.h"
+
+#define PLUGIN_NAME "cache_range_requests"
+#define DEBUG_LOG(fmt, ...) TSDebug(PLUGIN_NAME, "[%s:%d] %s(): " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
+#define ERROR_LOG(fmt, ...) TSError("[%s:%d] %s(): " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
+
+// Bytes queued for the client before we stop reading from the block.
+#define BLOCK_OUTPUT_WATERMARK (256 * 1024)
+
+static const char bad_gateway[] = "HTTP/1.1 502 Bad Gateway\r\n"
+                                  "Content-Length: 0\r\n"
+                                  "Connection: close\r\n"
+                                  "\r\n";
+
+struct IOChannel {
+  TSVIO vio;
+  TSIOBuffer iobuf;
+  TSIOBufferReader reader;
+
+  IOChannel() : vio(NULL), iobuf(TSIOBufferCreate()), reader(TSIOBufferReaderAlloc(iobuf)) {}
+  ~IOChannel()
+  {
+    TSIOBufferReaderFree(reader);
+    TSIOBufferDestroy(iobuf);
+  }
+
+  void
+  drain()
+  {
+    TSIOBufferReaderConsume(reader, TSIOBufferReaderAvail(reader));
+  }
+};
+
+struct BlockFetch {
+  TSCont contp;
+  int64_t block_size;
+  int64_t first;       // requested range, inclusive
+  int64_t last;        // -1 until the object size is known
+  int64_t object_size; // from the Content-Range of the first block
+  int64_t block;       // index of the block being fetched
+  int64_t skip;        // body bytes of the current block ahead of first
+  int64_t remaining;   // bytes of the range not yet passed to the client
+  int64_t body_left;   // body bytes of the current block still to read, -1 until EOS
+  int64_t written;     // bytes passed to the client, headers included
+  bool relay;          // pass the first block response through unchanged
+  bool header_sent;
+  bool client_finished;
+  bool fetch_eos;
+  char *etag;
+  int etag_len;
+  struct sockaddr_storage client_addr;
+
+  // template for the block requests, a copy of the client request
+  TSMBuffer req_bufp;
+  TSMLoc req_hdr;
+
+  TSVConn client_vc;
+  IOChannel client_in;
+  IOChannel client_out;
+
+  TSVConn fetch_vc;
+  IOChannel fetch_in;
+  IOChannel fetch_out;
+  TSHttpParser parser;
+  TSMBuffer resp_bufp;
+  TSMLoc resp_hdr;
+  bool resp_parsed;
+
+  BlockFetch(int64_t size, int64_t from, int64_t to)
+    : contp(NULL), block_size(size), first(from), last(to), object_size(-1), block(from / size), skip(0), remaining(0),
+      body_left(-1), written(0), relay(false), header_sent(false), client_finished(false), fetch_eos(false), etag(NULL),
+      etag_len(0), req_bufp(TSMBufferCreate()), req_hdr(NULL), client_vc(NULL), fetch_vc(NULL), parser(TSHttpParserCreate()),
+      resp_bufp(TSMBufferCreate()), resp_hdr(TSHttpHdrCreate(resp_bufp)), resp_parsed(false)
+  {
+    memset(&client_addr, 0, sizeof(client_addr));
+  }
+
+  ~BlockFetch()
+  {
+    if (req_hdr) {
+      TSHandleMLocRelease(req_bufp, TS_NULL_MLOC, req_hdr);
+    }
+    TSMBufferDestroy(req_bufp);
+    TSHttpHdrDestroy(resp_bufp, resp_hdr);
+    TSHandleMLocRelease(resp_bufp, TS_NULL_MLOC, resp_hdr);
+    TSMBufferDestroy(resp_bufp);
+    TSHttpParserDestroy(parser);
+    TSfree(etag);
+  }
+};
+
+static int block_fetch_handler(TSCont contp, TSEvent event, void *edata);
+
+/**
+ * Returns the value of the first field named name, or NULL.
+ */
+static const char *
+field_value_get(TSMBuffer bufp, TSMLoc hdr, const char *name, int name_len, int *len)
+{
+  const char *value = NULL;
+  TSMLoc field = TSMimeHdrFieldFind(bufp, hdr, name, name_len);
+
+  *len = 0;
+  if (field) {
+    value = TSMimeHdrFieldValueStringGet(bufp, hdr, field, -1, len);
+    TSHandleMLocRelease(bufp, hdr, field);
+  }
+  return value;
+}
+
+static void
+field_remove(TSMBuffer bufp, TSMLoc hdr, const char *name, int name_len)
+{
+  TSMLoc field = TSMimeHdrFieldFind(bufp, hdr, name, name_len);
+
+  while (field) {
+    TSMLoc next = TSMimeHdrFieldNextDup(bufp, hdr, field);
+
+    TSMimeHdrFieldDestroy(bufp, hdr, field);
+    TSHandleMLocRelease(bufp, hdr, field);
+    field = next;
+  }
+}
+
+static void
+field_set(TSMBuffer bufp, TSMLoc hdr, const char *name, int name_len, const char *value, int value_len)
+{
+  TSMLoc field;
+
+  field_remove(bufp, hdr, name, name_len);
+  if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(bufp, hdr, name, name_len, &field)) {
+    TSMimeHdrFieldValueStringSet(bufp, hdr, field, -1, value, value_len);
+    TSMimeHdrFieldAppend(bufp, hdr, field);
+    TSHandleMLocRelease(bufp, hdr, field);
+  }
+}
+
+/**
+ * Parses "bytes start-end/total".
+ */
+static bool
+parse_content_range(const char *value, int len, int64_t *start, int64_t *end, int64_t *total)
+{
+  char buf[128];
+  long long s, e, t;
+
+  if (!value || len <= 0 || len >= (int)sizeof(buf)) {
+    return false;
+  }
+  memcpy(buf, value, len);
+  buf[len] = '\0';
+  if (sscanf(buf, "bytes %lld-%lld/%lld", &s, &e, &t) != 3 || s < 0 || e < s || t <= e) {
+    return false;
+  }
+  *start = s;
+  *end = e;
+  *total = t;
+  return true;
+}
+
+bool
+block_parse_range(const char *value, int len, int64_t *first, int64_t *last)
+{
+  const char *p = value;
+  const char *end = value + len;
+  int64_t from = 0, to = -1;
+
+  if (len <= 6 || strncasecmp(p, "bytes=", 6) != 0) {
+    return false;
+  }
+  p += 6;
+  while (p < end && isspace(*p)) {
+    ++p;
+  }
+  // suffix ranges would need the object size before the first block
+  if (p == end || !isdigit(*p)) {
+    return false;
+  }
+  while (p < end && isdigit(*p)) {
+    from = from * 10 + (*p++ - '0');
+  }
+  if (p == end || *p++ != '-') {
+    return false;
+  }
+  if (p < end && isdigit(*p)) {
+    to = 0;
+    while (p < end && isdigit(*p)) {
+      to = to * 10 + (*p++ - '0');
+    }
+    if (to < from) {
+      return false;
+    }
+  }
+  while (p < end && isspace(*p)) {
+    ++p;
+  }
+  if (p != end) {
+    return false;
+  }
+
+  *first = from;
+  *last = to;
+  return true;
+}
+
+static void
+block_fetch_destroy(BlockFetch *bf)
+{
+  DEBUG_LOG("done with range %" PRId64 "-%" PRId64 ", %" PRId64 " bytes sent", bf->first, bf->last, bf->written);
+  if (bf->fetch_vc) {
+    TSVConnClose(bf->fetch_vc);
+  }
+  if (bf->client_vc) {
+    TSVConnClose(bf->client_vc);
+  }
+  TSContDestroy(bf->contp);
+  delete bf;
+}
+
+/**
+ * Lets the client write complete once everything queued so far is sent.
+ */
+static void
+finish_client(BlockFetch *bf)
+{
+  if (!bf->client_finished && bf->client_vc) {
+    bf->client_finished = true;
+    TSVIONBytesSet(bf->client_out.vio, bf->written);
+    TSVIOReenable(bf->client_out.vio);
+  }
+}
+
+/**
+ * Gives up on the request.  Before the response headers went out the
+ * client gets a 502, afterwards its connection is aborted.
+ */
+static void
+block_fetch_fail(BlockFetch *bf, const char *reason)
+{
+  ERROR_LOG("range %" PRId64 "-%" PRId64 ", block %" PRId64 ": %s", bf->first, bf->last, bf->block, reason);
+
+  if (bf->fetch_vc) {
+    TSVConnAbort(bf->fetch_vc, 1);
+    bf->fetch_vc = NULL;
+  }
+  if (bf->client_vc && !bf->header_sent) {
+    bf->header_sent = true;
+    bf->written += TSIOBufferWrite(bf->client_out.iobuf, bad_gateway, sizeof(bad_gateway) - 1);
+    finish_client(bf);
+    return;
+  }
+  if (bf->client_vc) {
+    TSVConnAbort(bf->client_vc, 1);
+    bf->client_vc = NULL;
+  }
+  block_fetch_destroy(bf);
+}
+
+/**
+ * Sends the request for the current block.
+ */
+static void
+fetch_block(BlockFetch *bf)
+{
+  char range[64];
+  int64_t start = bf->block * bf->block_size;
+  int len = snprintf(range, sizeof(range), "bytes=%" PRId64 "-%" PRId64, start, start + bf->block_size - 1);
+
+  DEBUG_LOG("fetching block %" PRId64 ": %s", bf->block, range);
+  field_set(bf->req_bufp, bf->req_hdr, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE, range, len);
+
+  bf->fetch_in.drain();
+  bf->fetch_out.drain();
+  TSHttpHdrPrint(bf->req_bufp, bf->req_hdr, bf->fetch_out.iobuf);
+
+  TSHttpParserClear(bf->parser);
+  TSHttpHdrDestroy(bf->resp_bufp, bf->resp_hdr);
+  TSHandleMLocRelease(bf->resp_bufp, TS_NULL_MLOC, bf->resp_hdr);
+  bf->resp_hdr = TSHttpHdrCreate(bf->resp_bufp);
+  bf->resp_parsed = false;
+  bf->fetch_eos = false;
+  bf->body_left = -1;
+
+  if (NULL == (bf->fetch_vc = TSHttpConnect(reinterpret_cast<struct sockaddr *>(&bf->client_addr)))) {
+    block_fetch_fail(bf, "TSHttpConnect() failed");
+    return;
+  }
+  bf->fetch_in.vio = TSVConnRead(bf->fetch_vc, bf->contp, bf->fetch_in.iobuf, INT64_MAX);
+  bf->fetch_out.vio = TSVConnWrite(bf->fetch_vc, bf->contp, bf->fetch_out.reader, TSIOBufferReaderAvail(bf->fetch_out.reader));
+}
+
+/**
+ * Queues a response header for the client.
+ */
+static void
+send_header(BlockFetch *bf)
+{
+  int64_t before = TSIOBufferReaderAvail(bf->client_out.reader);
+
+  TSHttpHdrPrint(bf->resp_bufp, bf->resp_hdr, bf->client_out.iobuf);
+  bf->written += TSIOBufferReaderAvail(bf->client_out.reader) - before;
+  bf->header_sent = true;
+  TSVIOReenable(bf->client_out.vio);
+}
+
+/**
+ * Checks the response for the current block and sets up the copy of
+ * its body.  Returns false if the request had to be failed.
+ */
+static bool
+handle_response(BlockFetch *bf)
+{
+  TSHttpStatus status = TSHttpHdrStatusGet(bf->resp_bufp, bf->resp_hdr);
+  int64_t block_start = bf->block * bf->block_size;
+  int64_t start = 0, end = -1, total = -1;
+  const char *value;
+  int len;
+
+  value = field_value_get(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_CONTENT_RANGE, TS_MIME_LEN_CONTENT_RANGE, &len);
+  bool ranged = TS_HTTP_STATUS_PARTIAL_CONTENT == status && parse_content_range(value, len, &start, &end, &total) &&
+                start == block_start;
+
+  value = field_value_get(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_CONTENT_LENGTH, TS_MIME_LEN_CONTENT_LENGTH, &len);
+  bf->body_left = value ? strtoll(value, NULL, 10) : -1;
+
+  DEBUG_LOG("block %" PRId64 ": status %d, content range %" PRId64 "-%" PRId64 "/%" PRId64 ", body %" PRId64, bf->block, status,
+            start, end, total, bf->body_left);
+
+  if (!bf->header_sent) {
+    char buf[128];
+
+    if (!ranged) {
+      // whatever this is, it is the answer to the client's request as well
+      DEBUG_LOG("passing the block response through");
+      bf->relay = true;
+      bf->remaining = INT64_MAX;
+      send_header(bf);
+      return true;
+    }
+
+    bf->object_size = total;
+    if (bf->last < 0 || bf->last >= total) {
+      bf->last = total - 1;
+    }
+    bf->skip = bf->first - block_start;
+    bf->remaining = bf->last - bf->first + 1;
+    if (bf->body_left < 0) {
+      bf->body_left = end - start + 1;
+    }
+
+    value = field_value_get(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG, &len);
+    if (value && len > 0) {
+      bf->etag = TSstrndup(value, len);
+      bf->etag_len = len;
+    }
+
+    TSHttpHdrVersionSet(bf->resp_bufp, bf->resp_hdr, TS_HTTP_VERSION(1, 1));
+    len = snprintf(buf, sizeof(buf), "bytes %" PRId64 "-%" PRId64 "/%" PRId64, bf->first, bf->last, total);
+    field_set(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_CONTENT_RANGE, TS_MIME_LEN_CONTENT_RANGE, buf, len);
+    len = snprintf(buf, sizeof(buf), "%" PRId64, bf->remaining);
+    field_set(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_CONTENT_LENGTH, TS_MIME_LEN_CONTENT_LENGTH, buf, len);
+    field_remove(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_TRANSFER_ENCODING, TS_MIME_LEN_TRANSFER_ENCODING);
+    send_header(bf);
+    return true;
+  }
+
+  // later blocks must be parts of the same object
+  if (!ranged || total != bf->object_size) {
+    block_fetch_fail(bf, "block response does not match the first block");
+    return false;
+  }
+  value = field_value_get(bf->resp_bufp, bf->resp_hdr, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG, &len);
+  if (bf->etag && (!value || len != bf->etag_len || memcmp(value, bf->etag, len) != 0)) {
+    block_fetch_fail(bf, "object changed between blocks");
+    return false;
+  }
+  if (bf->body_left < 0) {
+    bf->body_left = end - start + 1;
+  }
+  return true;
+}
+
+/**
+ * Reads the response header of the current block.  Returns false if the
+ * request had to be failed.
+ */
+static bool
+parse_response(BlockFetch *bf)
+{
+  TSIOBufferBlock blk;
+  TSParseResult result = TS_PARSE_CONT;
+
+  while (!bf->resp_parsed && NULL != (blk = TSIOBufferReaderStart(bf->fetch_in.reader))) {
+    int64_t avail;
+    const char *start = TSIOBufferBlockReadStart(blk, bf->fetch_in.reader, &avail);
+    const char *ptr = start;
+
+    if (avail == 0) {
+      break;
+    }
+    result = TSHttpHdrParseResp(bf->parser, bf->resp_bufp, bf->resp_hdr, &ptr, start + avail);
+    TSIOBufferReaderConsume(bf->fetch_in.reader, ptr - start);
+
+    switch (result) {
+    case TS_PARSE_ERROR:
+      block_fetch_fail(bf, "cannot parse the block response header");
+      return false;
+    case TS_PARSE_DONE:
+    case TS_PARSE_OK:
+      bf->resp_parsed = true;
+      return handle_response(bf);
+    default:
+      break;
+    }
+  }
+
+  if (bf->fetch_eos && !bf->resp_parsed) {
+    block_fetch_fail(bf, "no block response header");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * The current block is complete: move on to the next one, or finish.
+ */
+static void
+block_done(BlockFetch *bf)
+{
+  TSVConnClose(bf->fetch_vc);
+  bf->fetch_vc = NULL;
+
+  if (!bf->relay && bf->remaining > 0) {
+    ++bf->block;
+    fetch_block(bf);
+    return;
+  }
+
+  finish_client(bf);
+  if (!bf->client_vc) {
+    block_fetch_destroy(bf);
+  }
+}
+
+/**
+ * Moves body bytes of the current block to the client, as far as the
+ * client side buffer allows.
+ */
+static void
+pump(BlockFetch *bf)
+{
+  int64_t avail;
+
+  if (!bf->fetch_vc || !bf->resp_parsed) {
+    return;
+  }
+
+  while (bf->body_left != 0 && (avail = TSIOBufferReaderAvail(bf->fetch_in.reader)) > 0) {
+    int64_t n = (bf->body_left > 0 && avail > bf->body_left) ? bf->body_left : avail;
+
+    if (bf->skip > 0) {
+      if (n > bf->skip) {
+        n = bf->skip;
+      }
+      bf->skip -= n;
+    } else if (bf->remaining > 0 && bf->client_vc) {
+      int64_t room = BLOCK_OUTPUT_WATERMARK - TSIOBufferReaderAvail(bf->client_out.reader);
+
+      if (room <= 0) {
+        break; // wait for the client to take some
+      }
+      if (n > room) {
+        n = room;
+      }
+      if (n > bf->remaining) {
+        n = bf->remaining;
+      }
+      TSIOBufferCopy(bf->client_out.iobuf, bf->fetch_in.reader, n, 0);
+      bf->remaining -= n;
+      bf->written += n;
+      TSVIOReenable(bf->client_out.vio);
+    }
+    // anything else is the tail of the last block, which is read only
+    // so that the block gets cached completely
+    TSIOBufferReaderConsume(bf->fetch_in.reader, n);
+    if (bf->body_left > 0) {
+      bf->body_left -= n;
+    }
+  }
+
+  if (bf->remaining == 0) {
+    finish_client(bf);
+  }
+
+  if (bf->body_left == 0 || (bf->fetch_eos && bf->body_left < 0)) {
+    block_done(bf);
+  } else if (bf->fetch_eos) {
+    if (TSIOBufferReaderAvail(bf->fetch_in.reader) == 0) {
+      block_fetch_fail(bf, "block response is truncated");
+    }
+  } else {
+    TSVIOReenable(bf->fetch_in.vio);
+  }
+}
+
+static int
+block_fetch_handler(TSCont contp, TSEvent event, void *edata)
+{
+  BlockFetch *bf = static_cast<BlockFetch *>(TSContDataGet(contp));
+
+  switch (event) {
+  case TS_EVENT_NET_ACCEPT:
+    bf->client_vc = static_cast<TSVConn>(edata);
+    bf->client_in.vio = TSVConnRead(bf->client_vc, contp, bf->client_in.iobuf, INT64_MAX);
+    bf->client_out.vio = TSVConnWrite(bf->client_vc, contp, bf->client_out.reader, INT64_MAX);
+    fetch_block(bf);
+    return 0;
+
+  case TS_EVENT_NET_ACCEPT_FAILED:
+    block_fetch_destroy(bf);
+    return 0;
+
+  default:
+    break;
+  }
+
+  TSVIO vio = static_cast<TSVIO>(edata);
+  if (bf->client_vc && TSVIOVConnGet(vio) == bf->client_vc) {
+    switch (event) {
+    case TS_EVENT_VCONN_READ_READY:
+      // the request was already taken from the transaction
+      bf->client_in.drain();
+      TSVIOReenable(vio);
+      break;
+    case TS_EVENT_VCONN_WRITE_READY:
+      pump(bf);
+      break;
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+      TSVConnClose(bf->client_vc);
+      bf->client_vc = NULL;
+      if (!bf->fetch_vc) {
+        block_fetch_destroy(bf);
+      }
+      break;
+    case TS_EVENT_VCONN_READ_COMPLETE:
+      break;
+    default:
+      // the client went away
+      DEBUG_LOG("client event %d", event);
+      TSVConnClose(bf->client_vc);
+      bf->client_vc = NULL;
+      block_fetch_destroy(bf);
+      break;
+    }
+  } else if (bf->fetch_vc && TSVIOVConnGet(vio) == bf->fetch_vc) {
+    switch (event) {
+    case TS_EVENT_VCONN_READ_READY:
+      if (parse_response(bf)) {
+        pump(bf);
+      }
+      break;
+    case TS_EVENT_VCONN_READ_COMPLETE:
+    case TS_EVENT_VCONN_EOS:
+      bf->fetch_eos = true;
+      if (parse_response(bf)) {
+        pump(bf);
+      }
+      break;
+    case TS_EVENT_VCONN_WRITE_READY:
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+      break;
+    default:
+      block_fetch_fail(bf, "block request failed");
+      break;
+    }
+  } else {
+    DEBUG_LOG("stale event %d", event);
+  }
+
+  return 0;
+}
+
+bool
+block_fetch_start(TSHttpTxn txnp, int64_t block_size, int64_t first, int64_t last)
+{
+  TSMBuffer bufp;
+  TSMLoc hdr;
+  struct sockaddr const *addr = TSHttpTxnClientAddrGet(txnp);
+
+  if (!addr || TS_SUCCESS != TSHttpTxnClientReqGet(txnp, &bufp, &hdr)) {
+    return false;
+  }
+
+  BlockFetch *bf = new BlockFetch(block_size, first, last);
+  if (TS_SUCCESS != TSHttpHdrClone(bf->req_bufp, bufp, hdr, &bf->req_hdr)) {
+    TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr);
+    delete bf;
+    return false;
+  }
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr);
+
+  // block requests are plain HTTP/1.0 requests for a single block
+  TSHttpHdrVersionSet(bf->req_bufp, bf->req_hdr, TS_HTTP_VERSION(1, 0));
+  field_remove(bf->req_bufp, bf->req_hdr, TS_MIME_FIELD_IF_RANGE, TS_MIME_LEN_IF_RANGE);
+  field_remove(bf->req_bufp, bf->req_hdr, TS_MIME_FIELD_CONNECTION, TS_MIME_LEN_CONNECTION);
+  field_remove(bf->req_bufp, bf->req_hdr, TS_MIME_FIELD_PROXY_CONNECTION, TS_MIME_LEN_PROXY_CONNECTION);
+  field_remove(bf->req_bufp, bf->req_hdr, TS_MIME_FIELD_KEEP_ALIVE, TS_MIME_LEN_KEEP_ALIVE);
+
+  memcpy(&bf->client_addr, addr, addr->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+
+  bf->contp = TSContCreate(block_fetch_handler, TSMutexCreate());
+  TSContDataSet(bf->contp, bf);
+  TSHttpTxnIntercept(bf->contp, txnp);
+
+  DEBUG_LOG("serving range %" PRId64 "-%" PRId64 " from %" PRId64 " byte blocks", first, last, block_size);
+  return true;
+}
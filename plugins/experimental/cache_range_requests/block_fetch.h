@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Block mode: a range request is answered from fixed size, block aligned
+ * range requests that are sent back through traffic server.  Each block is
+ * cached as an individual object (see range_header_check()), so the cache
+ * ends up holding the parts of a large object that clients actually asked
+ * for, and any range that overlaps cached blocks is served from disk.
+ */
+
+#ifndef CACHE_RANGE_REQUESTS_BLOCK_FETCH_H
+#define CACHE_RANGE_REQUESTS_BLOCK_FETCH_H
+
+#include "ts/ts.h"
+
+/**
+ * Parses a Range header value holding a single "bytes=first-last" or
+ * "bytes=first-" range.  last is set to -1 for an open ended range.
+ * Suffix ranges and multiple ranges are rejected.
+ */
+bool block_parse_range(const char *value, int len, int64_t *first, int64_t *last);
+
+/**
+ * Takes over the transaction and serves the bytes [first, last] from
+ * block_size aligned range requests.  Must be called before the
+ * transaction leaves the remap stage.
+ */
+bool block_fetch_start(TSHttpTxn txnp, int64_t block_size, int64_t first, int64_t last);
+
+#endif
@@ -24,23 +24,36 @@
  * requests are read accross different disk drives reducing I/O
  * wait and load averages when there are large numbers of range
  * requests.
+ *
+ * With --block-size, a single range request is instead served from
+ * the block aligned ranges that cover it, see block_fetch.h.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include "ts/ts.h"
 #include "ts/remap.h"
+#include "block_fetch.h"
 
 #define PLUGIN_NAME "cache_range_requests"
 #define DEBUG_LOG(fmt, ...) TSDebug(PLUGIN_NAME, "[%s:%d] %s(): " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
 #define ERROR_LOG(fmt, ...) TSError("[%s:%d] %s(): " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
 
+struct pluginconfig {
+  int64_t block_size; // 0 unless block mode is enabled
+};
+
 struct txndata {
   char *range_value;
 };
 
+static struct pluginconfig *create_pluginconfig(int argc, const char *argv[]);
 static void handle_read_request_header(TSCont, TSEvent, void *);
-static void range_header_check(TSHttpTxn txnp);
+static bool block_mode_request(TSHttpTxn, struct pluginconfig *, TSMBuffer, TSMLoc);
+static void range_header_check(TSHttpTxn txnp, struct pluginconfig *pc);
 static void handle_send_origin_request(TSCont, TSHttpTxn, struct txndata *);
 static void handle_client_send_response(TSHttpTxn, struct txndata *);
 static void handle_server_read_response(TSHttpTxn, struct txndata *);
@@ -57,11 +70,32 @@ handle_read_request_header(TSCont txn_contp, TSEvent event, void *edata)
 {
   TSHttpTxn txnp = static_cast<TSHttpTxn>(edata);
 
-  range_header_check(txnp);
+  range_header_check(txnp, static_cast<struct pluginconfig *>(TSContDataGet(txn_contp)));
 
   TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
 }
 
+/**
+ * Block mode applies to plain GET requests from clients; the block
+ * requests themselves are internal.
+ */
+static bool
+block_mode_request(TSHttpTxn txnp, struct pluginconfig *pc, TSMBuffer bufp, TSMLoc hdr)
+{
+  int len;
+  TSMLoc loc;
+
+  if (!pc || pc->block_size <= 0 || TSHttpHdrMethodGet(bufp, hdr, &len) != TS_HTTP_METHOD_GET ||
+      TS_SUCCESS == TSHttpTxnIsInternal(txnp)) {
+    return false;
+  }
+  if (TS_NULL_MLOC != (loc = TSMimeHdrFieldFind(bufp, hdr, TS_MIME_FIELD_IF_RANGE, TS_MIME_LEN_IF_RANGE))) {
+    TSHandleMLocRelease(bufp, hdr, loc);
+    return false;
+  }
+  return true;
+}
+
 /**
  * Reads the client request header and if this is a range request:
  *
@@ -71,9 +105,13 @@ handle_read_request_header(TSCont txn_contp, TSEvent event, void *edata)
  *    be written to cache.
  * 3. Schedules TS_HTTP_SEND_REQUEST_HDR_HOOK, TS_HTTP_SEND_RESPONSE_HDR_HOOK,
  *    and TS_HTTP_TXN_CLOSE_HOOK for further processing.
+ *
+ * In block mode, client requests for a single range are handed to
+ * block_fetch_start() instead.  The block requests it sends come back
+ * here as internal requests, and are cached as described above.
  */
 static void
-range_header_check(TSHttpTxn txnp)
+range_header_check(TSHttpTxn txnp, struct pluginconfig *pc)
 {
   char cache_key_url[8192] = {0};
   char *req_url;
@@ -88,8 +126,13 @@ range_header_check(TSHttpTxn txnp)
     loc = TSMimeHdrFieldFind(hdr_bufp, req_hdrs, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE);
     if (TS_NULL_MLOC != loc) {
       const char *hdr_value = TSMimeHdrFieldValueStringGet(hdr_bufp, req_hdrs, loc, 0, &length);
+      int64_t first, last;
+
       if (!hdr_value || length <= 0) {
         DEBUG_LOG("Not a range request.");
+      } else if (block_mode_request(txnp, pc, hdr_bufp, req_hdrs) && block_parse_range(hdr_value, length, &first, &last) &&
+                 block_fetch_start(txnp, pc->block_size, first, last)) {
+        DEBUG_LOG("Serving %.*s from blocks.", length, hdr_value);
       } else {
         if (NULL == (txn_contp = TSContCreate((TSEventFunc)transaction_handler, NULL))) {
           ERROR_LOG("failed to create the transaction handler continuation.");
@@ -301,6 +344,66 @@ set_header(TSMBuffer bufp, TSMLoc hdr_loc, const char *header, int len, const ch
   return ret;
 }
 
+/**
+ * Parses the plugin arguments:
+ *
+ *   --block-size=<bytes>[k|m|g]  serve single range requests from block
+ *                                aligned ranges of this size.
+ *
+ * Returns NULL on an invalid argument.
+ */
+static struct pluginconfig *
+create_pluginconfig(int argc, const char *argv[])
+{
+  static const struct option longopt[] = {{const_cast<char *>("block-size"), required_argument, NULL, 'b'},
+                                          {NULL, no_argument, NULL, '\0'}};
+  struct pluginconfig *pc = (struct pluginconfig *)TSmalloc(sizeof(struct pluginconfig));
+
+  pc->block_size = 0;
+  optind = 0;
+  while (true) {
+    int opt = getopt_long(argc, (char *const *)argv, "", longopt, NULL);
+
+    if (opt == -1) {
+      break;
+    } else if (opt == 'b') {
+      char *end;
+      int64_t size = strtoll(optarg, &end, 10);
+
+      switch (*end) {
+      case 'g':
+      case 'G':
+        size <<= 10;
+      // fall through
+      case 'm':
+      case 'M':
+        size <<= 10;
+      // fall through
+      case 'k':
+      case 'K':
+        size <<= 10;
+        ++end;
+        break;
+      default:
+        break;
+      }
+      if (*end != '\0' || size <= 0) {
+        ERROR_LOG("invalid block size '%s'", optarg);
+        TSfree(pc);
+        return NULL;
+      }
+      pc->block_size = size;
+      DEBUG_LOG("block size: %" PRId64, pc->block_size);
+    } else {
+      ERROR_LOG("unknown option");
+      TSfree(pc);
+      return NULL;
+    }
+  }
+
+  return pc;
+}
+
 /**
  * Remap initialization.
  */
@@ -323,21 +426,28 @@ TSRemapInit(TSRemapInterface *api_info, char *errbuf, int errbuf_size)
 }
 
 /**
- * not used.
+ * Remap instance initialization; argv[0] and argv[1] are the remap urls.
  */
 TSReturnCode
-TSRemapNewInstance(int argc, char *argv[], void **ih, char * /*errbuf */, int /* errbuf_size */)
+TSRemapNewInstance(int argc, char *argv[], void **ih, char *errbuf, int errbuf_size)
 {
+  struct pluginconfig *pc = create_pluginconfig(argc - 1, const_cast<const char **>(argv + 1));
+
+  if (NULL == pc) {
+    snprintf(errbuf, errbuf_size - 1, "[TSRemapNewInstance] - invalid %s arguments", PLUGIN_NAME);
+    return TS_ERROR;
+  }
+  *ih = pc;
   return TS_SUCCESS;
 }
 
 /**
- * not used.
+ * Remap instance cleanup.
  */
 void
 TSRemapDeleteInstance(void *ih)
 {
-  DEBUG_LOG("no op");
+  TSfree(ih);
 }
 
 /**
@@ -346,7 +456,7 @@ TSRemapDeleteInstance(void *ih)
 TSRemapStatus
 TSRemapDoRemap(void *ih, TSHttpTxn txnp, TSRemapRequestInfo * /* rri */)
 {
-  range_header_check(txnp);
+  range_header_check(txnp, static_cast<struct pluginconfig *>(ih));
   return TSREMAP_NO_REMAP;
 }
 
@@ -358,6 +468,7 @@ TSPluginInit(int argc, const char *argv[])
 {
   TSPluginRegistrationInfo info;
   TSCont txnp_cont;
+  struct pluginconfig *pc;
 
   info.plugin_name = (char *)PLUGIN_NAME;
   info.vendor_name = (char *)"Comcast";
@@ -369,10 +480,17 @@ TSPluginInit(int argc, const char *argv[])
     return;
   }
 
+  if (NULL == (pc = create_pluginconfig(argc, argv))) {
+    ERROR_LOG("Unable to initialize plugin (disabled).");
+    return;
+  }
+
   if (NULL == (txnp_cont = TSContCreate((TSEventFunc)handle_read_request_header, NULL))) {
     ERROR_LOG("failed to create the transaction continuation handler.");
+    TSfree(pc);
     return;
   } else {
+    TSContDataSet(txnp_cont, pc);
     TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, txnp_cont);
   }
 }
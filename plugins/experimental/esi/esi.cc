@@ -48,6 +48,7 @@
 #include "Stats.h"
 #include "HttpDataFetcherImpl.h"
 #include "FailureInfo.h"
+#include "ParsedDocCache.h"
 using std::string;
 using std::list;
 using namespace EsiLib;
@@ -58,10 +59,16 @@ struct OptionInfo {
   bool private_response;
   bool disable_gzip_output;
   bool first_byte_flush;
+  ParsedDocCache *parsed_doc_cache;
 };
 
+#define DEFAULT_PARSED_DOC_CACHE_SIZE (16 * 1024 * 1024)
+
 static HandlerManager *gHandlerManager = NULL;
 
+// Shared by the global plugin and all remap instances, sized by the first one that enables it.
+static ParsedDocCache *gParsedDocCache = NULL;
+
 #define DEBUG_TAG "plugin_esi"
 #define PROCESSOR_DEBUG_TAG "plugin_esi_processor"
 #define GZIP_DEBUG_TAG "plugin_esi_gzip"
@@ -124,11 +131,16 @@ struct ContData {
   bool os_response_cacheable;
   list<string> post_headers;
 
+  const ParsedDocCache::Entry *parsed_doc; // set if the parsed document was found in cache
+  string doc_cache_key;                    // set if the parsed document is to be cached
+  string doc_validator;
+
   ContData(TSCont contptr, TSHttpTxn tx)
     : curr_state(READING_ESI_DOC), input_vio(NULL), output_vio(NULL), output_buffer(NULL), output_reader(NULL), esi_vars(NULL),
       data_fetcher(NULL), esi_proc(NULL), esi_gzip(NULL), esi_gunzip(NULL), contp(contptr), txnp(tx), request_url(NULL),
       input_type(DATA_TYPE_RAW_ESI), packed_node_list(""), gzipped_data(""), gzip_output(false), initialized(false),
-      xform_closed(false), intercept_header(false), cache_txn(false), head_only(false), os_response_cacheable(true)
+      xform_closed(false), intercept_header(false), cache_txn(false), head_only(false), os_response_cacheable(true),
+      parsed_doc(NULL)
   {
     client_addr = TSHttpTxnClientAddrGet(txnp);
     *debug_tag = '\0';
@@ -140,6 +152,8 @@ struct ContData {
 
   void getServerState();
 
+  void lookupParsedDoc(TSMBuffer bufp, TSMLoc hdr_loc);
+
   void checkXformStatus();
 
   bool init();
@@ -243,6 +257,7 @@ ContData::init()
     esi_proc = new EsiProcessor(
       createDebugTag(PROCESSOR_DEBUG_TAG, contp, proc_tag), createDebugTag(PARSER_DEBUG_TAG, contp, fetcher_tag),
       createDebugTag(EXPR_DEBUG_TAG, contp, expr_tag), &TSDebug, &TSError, *data_fetcher, *esi_vars, *gHandlerManager);
+    esi_proc->retainParsedNodes(!doc_cache_key.empty());
 
     esi_gzip = new EsiGzip(createDebugTag(GZIP_DEBUG_TAG, contp, gzip_tag), &TSDebug, &TSError);
     esi_gunzip = new EsiGunzip(createDebugTag(GUNZIP_DEBUG_TAG, contp, gunzip_tag), &TSDebug, &TSError);
@@ -458,9 +473,81 @@ ContData::getServerState()
     fillPostHeader(bufp, hdr_loc);
   }
 
+  if (option_info->parsed_doc_cache && !head_only) {
+    lookupParsedDoc(bufp, hdr_loc);
+  }
+
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
 }
 
+static void
+appendHeaderValue(TSMBuffer bufp, TSMLoc hdr_loc, const char *name, int name_len, string &dest)
+{
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, name, name_len);
+  if (field_loc) {
+    int value_len;
+    const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, -1, &value_len);
+    if (value && value_len) {
+      dest.append(value, value_len);
+    }
+    TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+  }
+}
+
+// The parsed document is reused only if the response carries a strong
+// ETag or a Last-Modified date; the cache key of the transaction plus
+// those (and the body length/encoding) identify the document content.
+void
+ContData::lookupParsedDoc(TSMBuffer bufp, TSMLoc hdr_loc)
+{
+  string validator;
+  appendHeaderValue(bufp, hdr_loc, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG, validator);
+  if ((validator.size() >= 2) && (validator[0] == 'W') && (validator[1] == '/')) {
+    TSDebug(DEBUG_TAG, "[%s] Not using parsed document cache for weak etag [%s]", __FUNCTION__, validator.c_str());
+    return;
+  }
+  validator.append("|");
+  appendHeaderValue(bufp, hdr_loc, TS_MIME_FIELD_LAST_MODIFIED, TS_MIME_LEN_LAST_MODIFIED, validator);
+  if (validator.size() == 1) {
+    TSDebug(DEBUG_TAG, "[%s] Response has no validator; not using parsed document cache", __FUNCTION__);
+    return;
+  }
+  validator.append("|");
+  appendHeaderValue(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_LENGTH, TS_MIME_LEN_CONTENT_LENGTH, validator);
+  validator.append("|");
+  appendHeaderValue(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_ENCODING, TS_MIME_LEN_CONTENT_ENCODING, validator);
+
+  TSMBuffer url_bufp = TSMBufferCreate();
+  TSMLoc url_loc;
+  if (TSUrlCreate(url_bufp, &url_loc) == TS_SUCCESS) {
+    if (TSHttpTxnCacheLookupUrlGet(txnp, url_bufp, url_loc) == TS_SUCCESS) {
+      int key_len;
+      char *key = TSUrlStringGet(url_bufp, url_loc, &key_len);
+      if (key) {
+        doc_cache_key.assign(key, key_len);
+        TSfree(key);
+      }
+    }
+    TSHandleMLocRelease(url_bufp, TS_NULL_MLOC, url_loc);
+  }
+  TSMBufferDestroy(url_bufp);
+  if (doc_cache_key.empty()) {
+    TSDebug(DEBUG_TAG, "[%s] Could not get cache key; not using parsed document cache", __FUNCTION__);
+    return;
+  }
+
+  parsed_doc = option_info->parsed_doc_cache->acquire(doc_cache_key, validator);
+  if (parsed_doc) {
+    TSDebug(DEBUG_TAG, "[%s] Found parsed document for [%s]", __FUNCTION__, doc_cache_key.c_str());
+    Stats::increment(Stats::N_PARSED_DOC_HITS);
+    doc_cache_key.clear();
+  } else {
+    TSDebug(DEBUG_TAG, "[%s] Parsed document for [%s] not cached", __FUNCTION__, doc_cache_key.c_str());
+    Stats::increment(Stats::N_PARSED_DOC_MISSES);
+    doc_validator.swap(validator);
+  }
+}
+
 ContData::~ContData()
 {
   TSDebug(debug_tag, "[%s] Destroying continuation data", __FUNCTION__);
@@ -488,6 +575,9 @@ ContData::~ContData()
   if (esi_gunzip) {
     delete esi_gunzip;
   }
+  if (parsed_doc) {
+    option_info->parsed_doc_cache->release(parsed_doc);
+  }
 }
 
 static int
@@ -605,6 +695,33 @@ cacheNodeList(ContData *cont_data)
   TSFetchUrl(post_request.data(), post_request.size(), cont_data->client_addr, cont_data->contp, NO_CALLBACK, event_ids);
 }
 
+static void
+cacheParsedDoc(ContData *cont_data)
+{
+  string packed_doc;
+  if (cont_data->esi_proc->packParsedNodeList(packed_doc)) {
+    TSDebug(cont_data->debug_tag, "[%s] Caching parsed document of packed size %d", __FUNCTION__, (int)packed_doc.size());
+    cont_data->option_info->parsed_doc_cache->insert(cont_data->doc_cache_key, cont_data->doc_validator, packed_doc);
+  }
+}
+
+static bool
+writeOutputSegments(ContData *cont_data, TSIOBuffer output_buffer, const EsiProcessor::OutputSegmentList &segments)
+{
+  TSIOBufferReader reader;
+  for (EsiProcessor::OutputSegmentList::const_iterator iter = segments.begin(); iter != segments.end(); ++iter) {
+    if (iter->include_url && cont_data->data_fetcher->getContentReader(*(iter->include_url), reader)) {
+      // reference the blocks holding the fetched content
+      if (TSIOBufferCopy(output_buffer, reader, iter->data_len, 0) != iter->data_len) {
+        return false;
+      }
+    } else if (TSIOBufferWrite(output_buffer, iter->data, iter->data_len) == TS_ERROR) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static int
 transformData(TSCont contp)
 {
@@ -657,7 +774,9 @@ transformData(TSCont contp)
         // Now start extraction
         while (block != NULL) {
           data = TSIOBufferBlockReadStart(block, cont_data->input_reader, &data_len);
-          if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
+          if (cont_data->parsed_doc) {
+            // document has been parsed before; just drain the input
+          } else if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
             cont_data->esi_proc->addParseData(data, data_len);
           } else if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
             string udata = "";
@@ -693,7 +812,13 @@ transformData(TSCont contp)
   }
   if (process_input_complete) {
     TSDebug(cont_data->debug_tag, "[%s] Completed reading input...", __FUNCTION__);
-    if (cont_data->input_type == DATA_TYPE_PACKED_ESI) {
+    if (cont_data->parsed_doc) {
+      TSDebug(cont_data->debug_tag, "[%s] Going to use parsed document of packed size %d", __FUNCTION__,
+              (int)cont_data->parsed_doc->value.size());
+      if (cont_data->esi_proc->useParsedNodeList(cont_data->parsed_doc->value) != EsiProcessor::PROCESS_SUCCESS) {
+        TSError("[esi][%s] Could not use parsed document from cache", __FUNCTION__);
+      }
+    } else if (cont_data->input_type == DATA_TYPE_PACKED_ESI) {
       TSDebug(DEBUG_TAG, "[%s] Going to use packed node list of size %d", __FUNCTION__, (int)cont_data->packed_node_list.size());
       if (cont_data->esi_proc->usePackedNodeList(cont_data->packed_node_list) == EsiProcessor::UNPACK_FAILURE) {
         removeCacheKey(cont_data->txnp);
@@ -704,7 +829,7 @@ transformData(TSCont contp)
       }
     }
 
-    if (cont_data->input_type != DATA_TYPE_PACKED_ESI) {
+    if (!cont_data->parsed_doc && (cont_data->input_type != DATA_TYPE_PACKED_ESI)) {
       bool gunzip_complete = true;
       if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
         gunzip_complete = cont_data->esi_gunzip->stream_finish();
@@ -714,6 +839,9 @@ transformData(TSCont contp)
             !cont_data->head_only) {
           cacheNodeList(cont_data);
         }
+        if (!cont_data->doc_cache_key.empty()) {
+          cacheParsedDoc(cont_data);
+        }
       }
     }
 
@@ -727,9 +855,16 @@ transformData(TSCont contp)
       (!cont_data->option_info->first_byte_flush)) { // retest as state may have changed in previous block
     if (cont_data->data_fetcher->isFetchComplete()) {
       TSDebug(cont_data->debug_tag, "[%s] data ready; going to process doc", __FUNCTION__);
-      const char *out_data;
-      int out_data_len;
-      EsiProcessor::ReturnCode retval = cont_data->esi_proc->process(out_data, out_data_len);
+      const char *out_data = "";
+      int out_data_len = 0;
+      EsiProcessor::OutputSegmentList out_segments;
+      EsiProcessor::ReturnCode retval;
+      if (cont_data->gzip_output) {
+        retval = cont_data->esi_proc->process(out_data, out_data_len);
+      } else {
+        // output is assembled from references to the document and fetched data
+        retval = cont_data->esi_proc->process(out_segments, out_data_len);
+      }
       TSDebug(cont_data->debug_tag, "[%s] data length: %d, retval: %d", __FUNCTION__, out_data_len, retval);
       if (retval == EsiProcessor::NEED_MORE_DATA) {
         TSDebug(cont_data->debug_tag, "[%s] ESI processor needs more data; "
@@ -739,12 +874,12 @@ transformData(TSCont contp)
       }
       cont_data->curr_state = ContData::PROCESSING_COMPLETE;
       if (retval == EsiProcessor::SUCCESS) {
-        TSDebug(cont_data->debug_tag, "[%s] ESI processor output document of size %d starting with [%.10s]", __FUNCTION__,
-                out_data_len, (out_data_len ? out_data : "(null)"));
+        TSDebug(cont_data->debug_tag, "[%s] ESI processor output document of size %d", __FUNCTION__, out_data_len);
       } else {
         TSError("[esi][%s] ESI processor failed to process document; will return empty document", __FUNCTION__);
         out_data = "";
         out_data_len = 0;
+        out_segments.clear();
       }
 
       // make sure transformation has not been prematurely terminated
@@ -774,7 +909,12 @@ transformData(TSCont contp)
         TSVIO output_vio;
         output_vio = TSVConnWrite(output_conn, contp, cont_data->output_reader, out_data_len);
 
-        if (TSIOBufferWrite(TSVIOBufferGet(output_vio), out_data, out_data_len) == TS_ERROR) {
+        if (cont_data->gzip_output) {
+          if (TSIOBufferWrite(TSVIOBufferGet(output_vio), out_data, out_data_len) == TS_ERROR) {
+            TSError("[esi][%s] Error while writing bytes to downstream VC", __FUNCTION__);
+            return 0;
+          }
+        } else if (!writeOutputSegments(cont_data, TSVIOBufferGet(output_vio), out_segments)) {
           TSError("[esi][%s] Error while writing bytes to downstream VC", __FUNCTION__);
           return 0;
         }
@@ -1577,6 +1717,7 @@ esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptionInfo)
   }
 
   memset(pOptionInfo, 0, sizeof(struct OptionInfo));
+  int64_t parsed_doc_cache_size = DEFAULT_PARSED_DOC_CACHE_SIZE;
 
   if (argc > 1) {
     int c;
@@ -1585,12 +1726,13 @@ esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptionInfo)
                                              {const_cast<char *>("disable-gzip-output"), no_argument, NULL, 'z'},
                                              {const_cast<char *>("first-byte-flush"), no_argument, NULL, 'b'},
                                              {const_cast<char *>("handler-filename"), required_argument, NULL, 'f'},
+                                             {const_cast<char *>("parsed-doc-cache-size"), required_argument, NULL, 'c'},
                                              {NULL, 0, NULL, 0}};
 
     optarg = NULL;
     optind = opterr = optopt = 0;
     int longindex = 0;
-    while ((c = getopt_long(argc, (char *const *)argv, "npzbf:", longopts, &longindex)) != -1) {
+    while ((c = getopt_long(argc, (char *const *)argv, "npzbf:c:", longopts, &longindex)) != -1) {
       switch (c) {
       case 'n':
         pOptionInfo->packed_node_support = true;
@@ -1610,12 +1752,25 @@ esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptionInfo)
         gHandlerManager->loadObjects(handler_conf);
         break;
       }
+      case 'c':
+        parsed_doc_cache_size = strtoll(optarg, NULL, 10);
+        break;
       default:
         break;
       }
     }
   }
 
+  if (parsed_doc_cache_size > 0) {
+    if (gParsedDocCache == NULL) {
+      gParsedDocCache = new ParsedDocCache(parsed_doc_cache_size);
+    } else {
+      TSDebug(DEBUG_TAG, "[%s] Parsed document cache already exists, ignoring parsed-doc-cache-size %" PRId64, __FUNCTION__,
+              parsed_doc_cache_size);
+    }
+    pOptionInfo->parsed_doc_cache = gParsedDocCache;
+  }
+
   int result = 0;
   bool bKeySet;
   if (threadKey == 0) {
@@ -1631,9 +1786,9 @@ esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptionInfo)
   if (result == 0) {
     TSDebug(DEBUG_TAG, "[%s] Plugin started%s, "
                        "packed-node-support: %d, private-response: %d, "
-                       "disable-gzip-output: %d, first-byte-flush: %d ",
+                       "disable-gzip-output: %d, first-byte-flush: %d, parsed-doc-cache-size: %" PRId64,
             __FUNCTION__, bKeySet ? " and key is set" : "", pOptionInfo->packed_node_support, pOptionInfo->private_response,
-            pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush);
+            pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush, parsed_doc_cache_size);
   }
 
   return result;
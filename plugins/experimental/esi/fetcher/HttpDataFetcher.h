@@ -79,6 +79,8 @@ public:
     return getContent(std::string(url), content, content_len);
   }
 
+  /** content returned has to remain valid until the fetcher is cleared
+   * or destroyed; the ESI processor references it in its output */
   virtual bool getContent(const std::string &url, const char *&content, int &content_len) const = 0;
 
   virtual ~HttpDataFetcher(){};
@@ -44,6 +44,54 @@ HttpDataFetcherImpl::_release(RequestData &req_data)
     TSMBufferDestroy(req_data.bufp);
     req_data.bufp = 0;
   }
+  if (req_data.body_buf) {
+    TSIOBufferReaderFree(req_data.body_reader);
+    TSIOBufferDestroy(req_data.body_buf);
+    req_data.body_reader = 0;
+    req_data.body_buf = 0;
+  }
+}
+
+void
+HttpDataFetcherImpl::_storeBody(RequestData &req_data, const char *body, int body_len)
+{
+  if (body_len == 0) {
+    req_data.body = "";
+    req_data.body_len = 0;
+    return;
+  }
+
+  // bodies that fit a single block are kept in an IO buffer; this keeps
+  // the data contiguous for getContent() and lets the ESI transform
+  // reference the block in its output instead of copying it
+  int size_index = TS_IOBUFFER_SIZE_INDEX_128;
+  while ((size_index < TS_IOBUFFER_SIZE_INDEX_32K) && ((128 << size_index) < body_len)) {
+    ++size_index;
+  }
+  if ((128 << size_index) >= body_len) {
+    req_data.body_buf = TSIOBufferSizedCreate(static_cast<TSIOBufferSizeIndex>(size_index));
+    req_data.body_reader = TSIOBufferReaderAlloc(req_data.body_buf);
+    TSIOBufferWrite(req_data.body_buf, body, body_len);
+    int64_t avail;
+    req_data.body = TSIOBufferBlockReadStart(TSIOBufferReaderStart(req_data.body_reader), req_data.body_reader, &avail);
+    if (avail == body_len) {
+      req_data.body_len = body_len;
+      req_data.raw_response.clear();
+      return;
+    }
+    TSIOBufferReaderFree(req_data.body_reader);
+    TSIOBufferDestroy(req_data.body_buf);
+    req_data.body_reader = 0;
+    req_data.body_buf = 0;
+  }
+
+  if (body != req_data.raw_response.data()) {
+    req_data.response.assign(body, body_len);
+  } else {
+    req_data.response.swap(req_data.raw_response);
+  }
+  req_data.body = req_data.response.data();
+  req_data.body_len = body_len;
 }
 
 HttpDataFetcherImpl::HttpDataFetcherImpl(TSCont contp, sockaddr const *client_addr, const char *debug_tag)
@@ -149,9 +197,8 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
 
   int page_data_len;
   const char *page_data = TSFetchRespGet(static_cast<TSHttpTxn>(edata), &page_data_len);
-  req_data.response.assign(page_data, page_data_len);
   bool valid_data_received = false;
-  const char *startptr = req_data.response.data(), *endptr = startptr + page_data_len;
+  const char *startptr = page_data, *endptr = startptr + page_data_len;
 
   req_data.bufp = TSMBufferCreate();
   req_data.hdr_loc = TSHttpHdrCreate(req_data.bufp);
@@ -162,25 +209,26 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
     req_data.resp_status = TSHttpHdrStatusGet(req_data.bufp, req_data.hdr_loc);
     valid_data_received = true;
     if (req_data.resp_status == TS_HTTP_STATUS_OK) {
-      req_data.body_len = endptr - startptr;
-      req_data.body = startptr;
-      TSDebug(_debug_tag, "[%s] Inserted page data of size %d starting with [%.6s] for request [%s]", __FUNCTION__,
-              req_data.body_len, (req_data.body_len ? req_data.body : "(null)"), req_str.c_str());
+      const char *body = startptr;
+      int body_len = endptr - startptr;
+      TSDebug(_debug_tag, "[%s] Inserted page data of size %d starting with [%.6s] for request [%s]", __FUNCTION__, body_len,
+              (body_len ? body : "(null)"), req_str.c_str());
 
       if (_checkHeaderValue(req_data.bufp, req_data.hdr_loc, TS_MIME_FIELD_CONTENT_ENCODING, TS_MIME_LEN_CONTENT_ENCODING,
                             TS_HTTP_VALUE_GZIP, TS_HTTP_LEN_GZIP, false)) {
         BufferList buf_list;
         req_data.raw_response = "";
-        if (gunzip(req_data.body, req_data.body_len, buf_list)) {
+        if (gunzip(body, body_len, buf_list)) {
           for (BufferList::iterator iter = buf_list.begin(); iter != buf_list.end(); ++iter) {
             req_data.raw_response.append(iter->data(), iter->size());
           }
         } else {
           TSError("[HttpDataFetcherImpl][%s] Error while gunzipping data", __FUNCTION__);
         }
-        req_data.body_len = req_data.raw_response.size();
-        req_data.body = req_data.raw_response.data();
+        body_len = req_data.raw_response.size();
+        body = req_data.raw_response.data();
       }
+      _storeBody(req_data, body, body_len);
 
       for (CallbackObjectList::iterator list_iter = req_data.callback_objects.begin(); list_iter != req_data.callback_objects.end();
            ++list_iter) {
@@ -200,9 +248,10 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
     TSDebug(_debug_tag, "[%s] Could not parse response for request [%s]", __FUNCTION__, req_str.data());
   }
 
-  if (!valid_data_received) {
+  if (valid_data_received) {
+    req_data.valid = true;
+  } else {
     _release(req_data);
-    req_data.response.clear();
   }
 
   return true;
@@ -263,7 +312,7 @@ HttpDataFetcherImpl::getData(const string &url, ResponseData &resp_data) const
     TSError("[HttpDataFetcherImpl]Request for URL [%s] not complete", url.data());
     return false;
   }
-  if (req_data.response.empty()) {
+  if (!req_data.valid) {
     // did not receive valid data
     TSError("[HttpDataFetcherImpl]No valid data received for URL [%s]; returning empty data to be safe", url.data());
     resp_data.clear();
@@ -276,6 +325,17 @@ HttpDataFetcherImpl::getData(const string &url, ResponseData &resp_data) const
   return true;
 }
 
+bool
+HttpDataFetcherImpl::getContentReader(const string &url, TSIOBufferReader &reader) const
+{
+  UrlToContentMap::const_iterator iter = _pages.find(url);
+  if ((iter == _pages.end()) || !iter->second.body_reader) {
+    return false;
+  }
+  reader = iter->second.body_reader;
+  return true;
+}
+
 void
 HttpDataFetcherImpl::clear()
 {
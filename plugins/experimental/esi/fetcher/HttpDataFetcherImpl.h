@@ -97,6 +97,11 @@ public:
     return false;
   }
 
+  /** gives access to the buffer holding the body fetched for url so
+   * that it can be referenced (e.g., via TSIOBufferCopy()) instead of
+   * copied; returns false if the body is not held in a buffer */
+  bool getContentReader(const std::string &url, TSIOBufferReader &reader) const;
+
   void clear();
 
   ~HttpDataFetcherImpl();
@@ -109,17 +114,24 @@ private:
 
   // used to track a request that was made
   struct RequestData {
-    std::string response;
+    std::string response; // body when too big for body_buf
     std::string raw_response;
     const char *body;
     int body_len;
+    TSIOBuffer body_buf;
+    TSIOBufferReader body_reader;
     TSHttpStatus resp_status;
     CallbackObjectList callback_objects;
     bool complete;
+    bool valid;
     TSMBuffer bufp;
     TSMLoc hdr_loc;
 
-    RequestData() : body(0), body_len(0), resp_status(TS_HTTP_STATUS_NONE), complete(false), bufp(0), hdr_loc(0) {}
+    RequestData()
+      : body(0), body_len(0), body_buf(0), body_reader(0), resp_status(TS_HTTP_STATUS_NONE), complete(false), valid(false), bufp(0),
+        hdr_loc(0)
+    {
+    }
   };
 
   typedef __gnu_cxx::hash_map<std::string, RequestData, EsiLib::StringHasher> UrlToContentMap;
@@ -149,6 +161,8 @@ private:
 
   inline void _release(RequestData &req_data);
 
+  void _storeBody(RequestData &req_data, const char *body, int body_len);
+
   sockaddr const *_client_addr;
 };
 
@@ -38,9 +38,10 @@ const char *EsiProcessor::INCLUDE_DATA_ID_ATTR = reinterpret_cast<const char *>(
 EsiProcessor::EsiProcessor(const char *debug_tag, const char *parser_debug_tag, const char *expression_debug_tag,
                            ComponentBase::Debug debug_func, ComponentBase::Error error_func, HttpDataFetcher &fetcher,
                            Variables &variables, const HandlerManager &handler_mgr)
-  : ComponentBase(debug_tag, debug_func, error_func), _curr_state(STOPPED), _parser(parser_debug_tag, debug_func, error_func),
-    _n_prescanned_nodes(0), _n_processed_nodes(0), _n_processed_try_nodes(0), _overall_len(0), _fetcher(fetcher), _reqAdded(false),
-    _usePackedNodeList(false), _esi_vars(variables), _expression(expression_debug_tag, debug_func, error_func, _esi_vars),
+  : ComponentBase(debug_tag, debug_func, error_func), _curr_state(STOPPED), _output_segments(0),
+    _parser(parser_debug_tag, debug_func, error_func), _n_prescanned_nodes(0), _n_processed_nodes(0), _n_processed_try_nodes(0),
+    _overall_len(0), _fetcher(fetcher), _reqAdded(false), _usePackedNodeList(false), _retain_parsed_nodes(false),
+    _parsed_nodes_valid(false), _esi_vars(variables), _expression(expression_debug_tag, debug_func, error_func, _esi_vars),
     _n_try_blocks_processed(0), _handler_manager(handler_mgr)
 {
 }
@@ -77,6 +78,7 @@ EsiProcessor::addParseData(const char *data, int data_len)
     Stats::increment(Stats::N_PARSE_ERRS);
     return false;
   }
+  _retainParsedNodes();
   if (!_preprocess(_node_list, _n_prescanned_nodes)) {
     _errorLog("[%s] Failed to preprocess parsed nodes; Stopping processor...", __FUNCTION__);
     error();
@@ -105,11 +107,50 @@ EsiProcessor::completeParse(const char *data /* = 0 */, int data_len /* = -1 */)
     Stats::increment(Stats::N_PARSE_ERRS);
     return false;
   }
-  return _handleParseComplete();
+  _retainParsedNodes();
+  if (!_handleParseComplete()) {
+    return false;
+  }
+  _parsed_nodes_valid = _retain_parsed_nodes;
+  return true;
+}
+
+void
+EsiProcessor::_retainParsedNodes()
+{
+  if (_retain_parsed_nodes) {
+    // nodes beyond the prescanned ones are fresh from the parser
+    DocNodeList::iterator iter = _node_list.begin();
+    for (int i = 0; i < _n_prescanned_nodes; ++i, ++iter)
+      ;
+    _parsed_nodes.insert(_parsed_nodes.end(), iter, _node_list.end());
+  }
+}
+
+bool
+EsiProcessor::packParsedNodeList(string &buffer) const
+{
+  if (!_parsed_nodes_valid) {
+    return false;
+  }
+  _parsed_nodes.pack(buffer);
+  return true;
 }
 
 EsiProcessor::UsePackedNodeResult
 EsiProcessor::usePackedNodeList(const char *data, int data_len)
+{
+  return _useNodeList(data, data_len, true);
+}
+
+EsiProcessor::UsePackedNodeResult
+EsiProcessor::useParsedNodeList(const char *data, int data_len)
+{
+  return _useNodeList(data, data_len, false);
+}
+
+EsiProcessor::UsePackedNodeResult
+EsiProcessor::_useNodeList(const char *data, int data_len, bool preprocessed)
 {
   if (_curr_state != STOPPED) {
     _errorLog("[%s] Cannot use packed node list whilst processing other data", __FUNCTION__);
@@ -121,7 +162,7 @@ EsiProcessor::usePackedNodeList(const char *data, int data_len)
     error();
     return UNPACK_FAILURE;
   }
-  _usePackedNodeList = true;
+  _usePackedNodeList = preprocessed;
   return _handleParseComplete() ? PROCESS_SUCCESS : PROCESS_FAILURE;
 }
 
@@ -188,7 +229,8 @@ EsiProcessor::_getIncludeStatus(const DocNode &node)
 }
 
 bool
-EsiProcessor::_getIncludeData(const DocNode &node, const char **content_ptr /* = 0 */, int *content_len_ptr /* = 0 */)
+EsiProcessor::_getIncludeData(const DocNode &node, const char **content_ptr /* = 0 */, int *content_len_ptr /* = 0 */,
+                              const string **url_ptr /* = 0 */)
 {
   if (node.type == DocNode::TYPE_INCLUDE) {
     const Attribute &url = node.attr_list.front();
@@ -197,6 +239,9 @@ EsiProcessor::_getIncludeData(const DocNode &node, const char **content_ptr /* =
       if (content_ptr && content_len_ptr) {
         *content_ptr = NULL;
         *content_len_ptr = 0;
+        if (url_ptr) {
+          *url_ptr = NULL;
+        }
         return true;
       } else {
         return false;
@@ -222,6 +267,9 @@ EsiProcessor::_getIncludeData(const DocNode &node, const char **content_ptr /* =
       return false;
     }
     _debugLog(_debug_tag, "[%s] Got content successfully for URL [%.*s]", __FUNCTION__, processed_url.size(), processed_url.data());
+    if (url_ptr) {
+      *url_ptr = &processed_url;
+    }
     return true;
   } else if (node.type == DocNode::TYPE_SPECIAL_INCLUDE) {
     AttributeList::const_iterator attr_iter;
@@ -252,6 +300,38 @@ EsiProcessor::_getIncludeData(const DocNode &node, const char **content_ptr /* =
 
 EsiProcessor::ReturnCode
 EsiProcessor::process(const char *&data, int &data_len)
+{
+  _output_segments = 0;
+  ReturnCode retval = _process();
+  if (retval == SUCCESS) {
+    data = _output_data.c_str();
+    data_len = _output_data.size();
+    _debugLog(_debug_tag, "[%s] ESI processed document of size %d starting with [%.10s]", __FUNCTION__, data_len,
+              (data_len ? data : "(null)"));
+  }
+  return retval;
+}
+
+EsiProcessor::ReturnCode
+EsiProcessor::process(OutputSegmentList &segments, int &overall_len)
+{
+  segments.clear();
+  _output_segments = &segments;
+  ReturnCode retval = _process();
+  _output_segments = 0;
+  if (retval == SUCCESS) {
+    overall_len = 0;
+    for (OutputSegmentList::const_iterator iter = segments.begin(); iter != segments.end(); ++iter) {
+      overall_len += iter->data_len;
+    }
+    _debugLog(_debug_tag, "[%s] ESI processed document of size %d in %d segments", __FUNCTION__, overall_len,
+              static_cast<int>(segments.size()));
+  }
+  return retval;
+}
+
+EsiProcessor::ReturnCode
+EsiProcessor::_process()
 {
   if (_curr_state == ERRORED) {
     return FAILURE;
@@ -345,7 +425,7 @@ EsiProcessor::process(const char *&data, int &data_len)
               DocNode::type_names_[doc_node.type], doc_node.data_len, (doc_node.data_len ? doc_node.data : "(null)"));
     if (doc_node.type == DocNode::TYPE_PRE) {
       // just copy the data
-      _output_data.append(doc_node.data, doc_node.data_len);
+      _addOutput(doc_node.data, doc_node.data_len, false);
     } else if (!_processEsiNode(node_iter)) {
       _errorLog("[%s] Failed to process ESI node [%.*s]", __FUNCTION__, doc_node.data_len, doc_node.data);
       stop();
@@ -353,10 +433,6 @@ EsiProcessor::process(const char *&data, int &data_len)
     }
   }
   _addFooterData();
-  data = _output_data.c_str();
-  data_len = _output_data.size();
-  _debugLog(_debug_tag, "[%s] ESI processed document of size %d starting with [%.10s]", __FUNCTION__, data_len,
-            (data_len ? data : "(null)"));
   return SUCCESS;
 }
 
@@ -495,7 +571,7 @@ EsiProcessor::flush(string &data, int &overall_len)
 
     if (doc_node.type == DocNode::TYPE_PRE) {
       // just copy the data
-      _output_data.append(doc_node.data, doc_node.data_len);
+      _addOutput(doc_node.data, doc_node.data_len, false);
       ++_n_processed_nodes;
     } else if (!_processEsiNode(node_iter)) {
       _errorLog("[%s] Failed to process ESI node [%.*s]", __FUNCTION__, doc_node.data_len, doc_node.data);
@@ -522,7 +598,11 @@ void
 EsiProcessor::stop()
 {
   _output_data.clear();
+  _output_chunks.clear();
+  _parser.clear();
   _node_list.clear();
+  _parsed_nodes.clear();
+  _parsed_nodes_valid = false;
   _include_urls.clear();
   _try_blocks.clear();
   _n_prescanned_nodes = 0;
@@ -550,10 +630,11 @@ EsiProcessor::_processEsiNode(const DocNodeList::iterator &iter)
   if ((node.type == DocNode::TYPE_INCLUDE) || (node.type == DocNode::TYPE_SPECIAL_INCLUDE)) {
     const char *content;
     int content_len;
-    if ((retval = _getIncludeData(node, &content, &content_len))) {
-      if (content_len > 0) {
-        _output_data.append(content, content_len);
-      }
+    const string *url = 0;
+    if ((retval = _getIncludeData(node, &content, &content_len, &url))) {
+      // fetched content stays with the fetcher; special include data is
+      // owned by handlers which make no such promise
+      _addOutput(content, content_len, (node.type == DocNode::TYPE_SPECIAL_INCLUDE), url);
     }
   } else if ((node.type == DocNode::TYPE_COMMENT) || (node.type == DocNode::TYPE_REMOVE) || (node.type == DocNode::TYPE_TRY) ||
              (node.type == DocNode::TYPE_CHOOSE) || (node.type == DocNode::TYPE_HTML_COMMENT)) {
@@ -654,7 +735,7 @@ EsiProcessor::_handleVars(const char *str, int str_len)
   const string &str_value = _expression.expand(str, str_len);
   _debugLog(_debug_tag, "[%s] Vars expression [%.*s] expanded to [%.*s]", __FUNCTION__, str_len, str, str_value.size(),
             str_value.data());
-  _output_data.append(str_value);
+  _addOutput(str_value.data(), str_value.size(), true);
   return true;
 }
 
@@ -819,8 +900,24 @@ EsiProcessor::_addFooterData()
   int footer_len;
   for (IncludeHandlerMap::iterator iter = _include_handlers.begin(); iter != _include_handlers.end(); ++iter) {
     iter->second->getFooter(footer, footer_len);
-    if (footer_len > 0) {
-      _output_data.append(footer, footer_len);
-    }
+    _addOutput(footer, footer_len, true);
+  }
+}
+
+void
+EsiProcessor::_addOutput(const char *data, int data_len, bool copy, const string *include_url /* = 0 */)
+{
+  if (data_len <= 0) {
+    return;
+  }
+  if (!_output_segments) {
+    _output_data.append(data, data_len);
+    return;
+  }
+  if (copy) {
+    _output_chunks.push_back(string(data, data_len));
+    data = _output_chunks.back().data();
   }
+  OutputSegment segment = {data, data_len, include_url};
+  _output_segments->push_back(segment);
 }
@@ -26,6 +26,8 @@
 
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 #include <pthread.h>
 #include "lib/ComponentBase.h"
 #include "lib/StringHash.h"
@@ -91,6 +93,22 @@ public:
    * else FAILURE/SUCCESS is returned. */
   ReturnCode process(const char *&data, int &data_len);
 
+  /** A piece of the processed document. Data stays valid until stop()
+   * is called. Segments holding the content of an include also carry
+   * the URL it was fetched from, so that callers with access to the
+   * fetcher's buffers can reference them instead of copying data */
+  struct OutputSegment {
+    const char *data;
+    int data_len;
+    const std::string *include_url;
+  };
+  typedef std::vector<OutputSegment> OutputSegmentList;
+
+  /** Same as process() above, but returns the document as a list of
+   * segments pointing to the template, fetched content, etc. instead
+   * of assembling a copy of it; overall_len is the sum of segment sizes */
+  ReturnCode process(OutputSegmentList &segments, int &overall_len);
+
   /** Process the ESI document and flush processed data as much as
    * possible. Can be called when fetcher hasn't finished pulling
    * in all data. */
@@ -115,6 +133,32 @@ public:
     return usePackedNodeList(data.data(), data.size());
   }
 
+  /** Makes the processor retain a copy of the nodes as they come out
+   * of the parser, i.e., before any request specific processing, so
+   * that they can be packed via packParsedNodeList() */
+  void
+  retainParsedNodes(bool retain)
+  {
+    _retain_parsed_nodes = retain;
+  }
+
+  /** packs the parser output retained for the current document;
+   * returns false if none was retained or parsing did not complete */
+  bool packParsedNodeList(std::string &buffer) const;
+
+  /** Unpacks a node list packed by packParsedNodeList() and preps for
+   * process(); as opposed to usePackedNodeList(), the nodes are
+   * preprocessed for the current request. Unpacked document will
+   * point to data in argument (i.e., caller space) */
+  UsePackedNodeResult useParsedNodeList(const char *data, int data_len);
+
+  /** convenient alternative to method above */
+  inline UsePackedNodeResult
+  useParsedNodeList(const std::string &data)
+  {
+    return useParsedNodeList(data.data(), data.size());
+  }
+
   /** Clears state from current request */
   void stop();
 
@@ -131,6 +175,8 @@ private:
   EXEC_STATE _curr_state;
 
   std::string _output_data;
+  OutputSegmentList *_output_segments;
+  std::list<std::string> _output_chunks; // data referenced by _output_segments
 
   EsiParser _parser;
   EsiLib::DocNodeList _node_list;
@@ -144,10 +190,18 @@ private:
 
   bool _reqAdded;
   bool _usePackedNodeList;
+  bool _retain_parsed_nodes;
+  bool _parsed_nodes_valid;
+  EsiLib::DocNodeList _parsed_nodes;
 
   bool _processEsiNode(const EsiLib::DocNodeList::iterator &iter);
   bool _handleParseComplete();
-  bool _getIncludeData(const EsiLib::DocNode &node, const char **content_ptr = 0, int *content_len_ptr = 0);
+  UsePackedNodeResult _useNodeList(const char *data, int data_len, bool preprocessed);
+  void _retainParsedNodes();
+  ReturnCode _process();
+  void _addOutput(const char *data, int data_len, bool copy, const std::string *include_url = 0);
+  bool _getIncludeData(const EsiLib::DocNode &node, const char **content_ptr = 0, int *content_len_ptr = 0,
+                       const std::string **url_ptr = 0);
   DataStatus _getIncludeStatus(const EsiLib::DocNode &node);
   bool _handleVars(const char *str, int str_len);
   bool _handleChoose(EsiLib::DocNodeList::iterator &curr_node);
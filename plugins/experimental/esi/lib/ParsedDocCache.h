@@ -0,0 +1,56 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _PARSED_DOC_CACHE_H
+#define _PARSED_DOC_CACHE_H
+
+#include <string>
+
+#include "ts/ValidatedLruCache.h"
+
+namespace EsiLib
+{
+/** Process-wide, size bounded LRU cache of parsed ESI documents. Each
+ * entry holds the packed parser output of a document (see
+ * EsiProcessor::packParsedNodeList()) as its value and is keyed on the
+ * document's cache key; a lookup only hits if the validator presented
+ * by the caller (built from ETag/Last-Modified) matches the stored one.
+ * See ValidatedLruCache for the reference counting of entries. */
+class ParsedDocCache : public ValidatedLruCache<std::string>
+{
+public:
+  /** max_bytes is the upper bound for the sum of the packed document
+   * sizes held; documents bigger than that are never cached */
+  explicit ParsedDocCache(size_t max_bytes) : ValidatedLruCache<std::string>(max_bytes) {}
+
+  /** adds (or replaces) the entry for key; packed_doc is swapped into
+   * the cache and hence empty on return */
+  bool
+  insert(const std::string &key, const std::string &validator, std::string &packed_doc)
+  {
+    return ValidatedLruCache<std::string>::insert(key, validator, packed_doc, packed_doc.size());
+  }
+};
+};
+
+#endif // _PARSED_DOC_CACHE_H
@@ -25,6 +25,7 @@
 #define _TEST_HTTP_DATA_FETCHER_H
 
 #include <string>
+#include <list>
 
 #include "HttpDataFetcher.h"
 
@@ -62,12 +63,12 @@ public:
     TestHttpDataFetcher &curr_obj = const_cast<TestHttpDataFetcher &>(*this);
     --curr_obj._n_pending_requests;
     if (_return_data) {
-      curr_obj._data.clear();
-      curr_obj._data.append(">>>>> Content for URL [");
-      curr_obj._data.append(url);
-      curr_obj._data.append("] <<<<<");
-      content = curr_obj._data.data();
-      content_len = curr_obj._data.size();
+      curr_obj._data.push_back(">>>>> Content for URL [");
+      std::string &data = curr_obj._data.back();
+      data.append(url);
+      data.append("] <<<<<");
+      content = data.data();
+      content_len = data.size();
       return true;
     }
     return false;
@@ -87,7 +88,7 @@ public:
 
 private:
   int _n_pending_requests;
-  std::string _data;
+  std::list<std::string> _data;
   bool _return_data;
 };
 
@@ -0,0 +1,119 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <iostream>
+#include <assert.h>
+#include <string>
+
+#include "ParsedDocCache.h"
+#include "print_funcs.h"
+#include "Utils.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace EsiLib;
+
+pthread_key_t threadKey;
+
+int
+main()
+{
+  pthread_key_create(&threadKey, NULL);
+  Utils::init(&Debug, &Error);
+
+  {
+    cout << endl << "===================== Test 1) hit and validator mismatch" << endl;
+    ParsedDocCache cache(1024);
+    string doc("packed doc");
+    assert(cache.acquire("key1", "v1") == 0);
+    assert(cache.insert("key1", "v1", doc) == true);
+    assert(doc.empty());
+    assert(cache.size() == 1);
+
+    const ParsedDocCache::Entry *entry = cache.acquire("key1", "v1");
+    assert(entry != 0);
+    assert(entry->value == "packed doc");
+    cache.release(entry);
+
+    // a changed document drops the stale entry
+    assert(cache.acquire("key1", "v2") == 0);
+    assert(cache.size() == 0);
+    assert(cache.bytes() == 0);
+  }
+
+  {
+    cout << endl << "===================== Test 2) LRU eviction" << endl;
+    ParsedDocCache cache(3 * (4 + 2 + 10));
+    string doc;
+    doc.assign("0123456789");
+    assert(cache.insert("key1", "v1", doc) == true);
+    doc.assign("0123456789");
+    assert(cache.insert("key2", "v1", doc) == true);
+    doc.assign("0123456789");
+    assert(cache.insert("key3", "v1", doc) == true);
+    assert(cache.size() == 3);
+
+    // touch key1 so that key2 is the least recently used
+    cache.release(cache.acquire("key1", "v1"));
+    doc.assign("0123456789");
+    assert(cache.insert("key4", "v1", doc) == true);
+    assert(cache.size() == 3);
+    assert(cache.bytes() == 3 * (4 + 2 + 10));
+
+    const ParsedDocCache::Entry *entry;
+    assert((entry = cache.acquire("key1", "v1")) != 0);
+    cache.release(entry);
+    assert(cache.acquire("key2", "v1") == 0);
+    assert((entry = cache.acquire("key3", "v1")) != 0);
+    cache.release(entry);
+
+    // too big to be cached at all
+    doc.assign(100, 'x');
+    assert(cache.insert("key5", "v1", doc) == false);
+    assert(cache.size() == 3);
+  }
+
+  {
+    cout << endl << "===================== Test 3) entries in use outlive replacement" << endl;
+    ParsedDocCache cache(1024);
+    string doc("old doc");
+    cache.insert("key1", "v1", doc);
+    const ParsedDocCache::Entry *old_entry = cache.acquire("key1", "v1");
+    assert(old_entry != 0);
+
+    doc.assign("new doc");
+    cache.insert("key1", "v2", doc);
+    assert(cache.size() == 1);
+    assert(old_entry->value == "old doc");
+
+    const ParsedDocCache::Entry *new_entry = cache.acquire("key1", "v2");
+    assert(new_entry != 0);
+    assert(new_entry->value == "new doc");
+    cache.release(old_entry);
+    cache.release(new_entry);
+  }
+
+  cout << endl << "All tests passed!" << endl;
+  return 0;
+}
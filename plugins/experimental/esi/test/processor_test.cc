@@ -1066,6 +1066,75 @@ main()
     assert(esi_proc.usePackedNodeList(packedNodeList.data(), 0) == EsiProcessor::UNPACK_FAILURE);
   }
 
+  {
+    cout << endl << "===================== Test 49) using parsed node list" << endl;
+    TestHttpDataFetcher data_fetcher;
+    string input_data("<esi:choose>"
+                      "<esi:when test=foo>"
+                      "<esi:include src=foo />"
+                      "</esi:when>"
+                      "</esi:choose>"
+                      " pre <!--esi <esi:include src=bar />--> post");
+    string parsed_doc;
+    string expected_output(">>>>> Content for URL [foo] <<<<< pre >>>>> Content for URL [bar] <<<<< post");
+
+    EsiProcessor esi_proc("processor", "parser", "expression", &Debug, &Error, data_fetcher, esi_vars, handler_mgr);
+    const char *output_data;
+    int output_data_len = 0;
+
+    assert(esi_proc.addParseData(input_data.c_str(), input_data.size()) == true);
+    assert(esi_proc.completeParse() == true);
+    assert(esi_proc.packParsedNodeList(parsed_doc) == false);
+    esi_proc.stop();
+
+    esi_proc.retainParsedNodes(true);
+    assert(esi_proc.addParseData(input_data.c_str(), 20) == true);
+    assert(esi_proc.completeParse(input_data.c_str() + 20, input_data.size() - 20) == true);
+    assert(esi_proc.packParsedNodeList(parsed_doc) == true);
+    assert(esi_proc.process(output_data, output_data_len) == EsiProcessor::SUCCESS);
+    assert(string(output_data, output_data_len) == expected_output);
+    esi_proc.stop();
+    assert(esi_proc.packParsedNodeList(parsed_doc) == false);
+
+    // choose and html comment nodes are handled again for each request
+    EsiProcessor esi_proc2("processor", "parser", "expression", &Debug, &Error, data_fetcher, esi_vars, handler_mgr);
+    assert(esi_proc2.useParsedNodeList(parsed_doc) == EsiProcessor::PROCESS_SUCCESS);
+    assert(esi_proc2.process(output_data, output_data_len) == EsiProcessor::SUCCESS);
+    assert(string(output_data, output_data_len) == expected_output);
+    esi_proc2.stop();
+
+    assert(esi_proc2.useParsedNodeList(parsed_doc.data(), 0) == EsiProcessor::UNPACK_FAILURE);
+  }
+
+  {
+    cout << endl << "===================== Test 50) output segments" << endl;
+    TestHttpDataFetcher data_fetcher;
+    EsiProcessor esi_proc("processor", "parser", "expression", &Debug, &Error, data_fetcher, esi_vars, handler_mgr);
+    string input_data("foo <esi:include src=url1 /> bar <esi:vars>baz</esi:vars>"
+                      "<esi:include src=url2 /><esi:special-include handler=stub />");
+    EsiProcessor::OutputSegmentList segments;
+    int overall_len = 0;
+
+    assert(esi_proc.addParseData(input_data.c_str(), input_data.size()) == true);
+    assert(esi_proc.completeParse() == true);
+    assert(esi_proc.process(segments, overall_len) == EsiProcessor::SUCCESS);
+    assert(segments.size() == 6);
+    string output;
+    for (EsiProcessor::OutputSegmentList::iterator iter = segments.begin(); iter != segments.end(); ++iter) {
+      output.append(iter->data, iter->data_len);
+    }
+    assert(overall_len == static_cast<int>(output.size()));
+    assert(output == "foo >>>>> Content for URL [url1] <<<<< bar baz>>>>> Content for URL [url2] <<<<<"
+                     "Special data for include id 1");
+    assert(segments[0].include_url == 0);
+    assert(segments[0].data_len == 4);
+    assert(segments[1].include_url && (*segments[1].include_url == "url1"));
+    assert(segments[3].include_url == 0);
+    assert(segments[4].include_url && (*segments[4].include_url == "url2"));
+    assert(segments[5].include_url == 0);
+    esi_proc.stop();
+  }
+
   cout << endl << "All tests passed!" << endl;
   return 0;
 }
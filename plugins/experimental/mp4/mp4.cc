@@ -21,12 +21,17 @@
 
 static char *ts_arg(const char *param, size_t param_len, const char *key, size_t key_len, size_t *val_len);
 static int mp4_handler(TSCont contp, TSEvent event, void *edata);
-static void mp4_cache_lookup_complete(Mp4Context *mc, TSHttpTxn txnp);
+static void mp4_cache_lookup_complete(Mp4Context *mc, TSHttpTxn txnp, TSCont contp);
 static void mp4_read_response(Mp4Context *mc, TSHttpTxn txnp);
 static void mp4_add_transform(Mp4Context *mc, TSHttpTxn txnp);
 static int mp4_transform_entry(TSCont contp, TSEvent event, void *edata);
 static int mp4_transform_handler(TSCont contp, Mp4Context *mc);
-static int mp4_parse_meta(Mp4TransformContext *mtc, bool body_complete);
+static int mp4_parse_meta(Mp4Context *mc, bool body_complete);
+static bool mp4_index_key(Mp4Context *mc, TSHttpTxn txnp, TSMBuffer bufp, TSMLoc hdrp);
+static void mp4_index_seek(Mp4Context *mc, TSHttpTxn txnp, TSCont contp);
+static void mp4_send_request(TSHttpTxn txnp);
+
+static int index_hits_stat;
 
 
 TSReturnCode
@@ -42,28 +47,81 @@ TSRemapInit(TSRemapInterface *api_info, char *errbuf, int errbuf_size)
     return TS_ERROR;
   }
 
+  if (TSStatFindName("mp4.index_hits", &index_hits_stat) == TS_ERROR) {
+    index_hits_stat = TSStatCreate("mp4.index_hits", TS_RECORDDATATYPE_COUNTER, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_COUNT);
+  }
+
   return TS_SUCCESS;
 }
 
+/*
+ * The indexes of the files of a remap rule are kept in a cache of --index-cache-size bytes, with
+ * an optional K, M or G suffix. A size of 0 turns indexing off.
+ */
 TSReturnCode
-TSRemapNewInstance(int argc, char ** /* argv ATS_UNUSED */, void **ih, char *errbuf, int errbuf_size)
+TSRemapNewInstance(int argc, char *argv[], void **ih, char *errbuf, int errbuf_size)
 {
-  if (argc > 2) {
-    snprintf(errbuf, errbuf_size, "[TSRemapNewInstance] - Argument should be removed");
+  static const struct option longopt[] = {{const_cast<char *>("index-cache-size"), required_argument, NULL, 's'},
+                                          {NULL, no_argument, NULL, '\0'}};
+  int64_t size;
+  char *end;
+  int opt;
+
+  size = MP4_INDEX_CACHE_SIZE;
+
+  // argv[0] is the from url, which getopt skips like a program name
+  optind = 0;
+  while ((opt = getopt_long(argc - 1, argv + 1, "", longopt, NULL)) != -1) {
+    if (opt != 's') {
+      snprintf(errbuf, errbuf_size, "[TSRemapNewInstance] - Unknown argument");
+      return TS_ERROR;
+    }
+
+    size = strtoll(optarg, &end, 10);
+
+    switch (*end) {
+    case 'g':
+    case 'G':
+      size <<= 10;
+    // fall through
+    case 'm':
+    case 'M':
+      size <<= 10;
+    // fall through
+    case 'k':
+    case 'K':
+      size <<= 10;
+      ++end;
+      break;
+    default:
+      break;
+    }
+
+    if (*end != '\0' || size < 0) {
+      snprintf(errbuf, errbuf_size, "[TSRemapNewInstance] - Invalid index cache size '%s'", optarg);
+      return TS_ERROR;
+    }
   }
 
-  *ih = NULL;
+  std::shared_ptr<Mp4IndexCache> *cache = new std::shared_ptr<Mp4IndexCache>();
+
+  if (size > 0) {
+    cache->reset(new Mp4IndexCache(size));
+  }
+
+  *ih = cache;
   return TS_SUCCESS;
 }
 
 void
-TSRemapDeleteInstance(void * /* ih ATS_UNUSED */)
+TSRemapDeleteInstance(void *ih)
 {
-  return;
+  // transactions of the rule still running hold their own reference to the cache
+  delete static_cast<std::shared_ptr<Mp4IndexCache> *>(ih);
 }
 
 TSRemapStatus
-TSRemapDoRemap(void * /* ih ATS_UNUSED */, TSHttpTxn rh, TSRemapRequestInfo *rri)
+TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
 {
   const char *method, *query, *path;
   int method_len, query_len, path_len;
@@ -140,7 +198,7 @@ TSRemapDoRemap(void * /* ih ATS_UNUSED */, TSHttpTxn rh, TSRemapRequestInfo *rri
     TSHandleMLocRelease(rri->requestBufp, rri->requestHdrp, range_field);
   }
 
-  mc = new Mp4Context(start);
+  mc = new Mp4Context(start, *static_cast<std::shared_ptr<Mp4IndexCache> *>(ih));
   contp = TSContCreate(mp4_handler, NULL);
   TSContDataSet(contp, mc);
 
@@ -161,13 +219,17 @@ mp4_handler(TSCont contp, TSEvent event, void *edata)
 
   switch (event) {
   case TS_EVENT_HTTP_CACHE_LOOKUP_COMPLETE:
-    mp4_cache_lookup_complete(mc, txnp);
+    mp4_cache_lookup_complete(mc, txnp, contp);
     break;
 
   case TS_EVENT_HTTP_READ_RESPONSE_HDR:
     mp4_read_response(mc, txnp);
     break;
 
+  case TS_EVENT_HTTP_SEND_REQUEST_HDR:
+    mp4_send_request(txnp);
+    break;
+
   case TS_EVENT_HTTP_TXN_CLOSE:
     delete mc;
     TSContDestroy(contp);
@@ -182,7 +244,7 @@ mp4_handler(TSCont contp, TSEvent event, void *edata)
 }
 
 static void
-mp4_cache_lookup_complete(Mp4Context *mc, TSHttpTxn txnp)
+mp4_cache_lookup_complete(Mp4Context *mc, TSHttpTxn txnp, TSCont contp)
 {
   TSMBuffer bufp;
   TSMLoc hdrp;
@@ -223,6 +285,9 @@ mp4_cache_lookup_complete(Mp4Context *mc, TSHttpTxn txnp)
   mc->cl = n;
   mp4_add_transform(mc, txnp);
 
+  if (mp4_index_key(mc, txnp, bufp, hdrp) && obj_status == TS_CACHE_LOOKUP_HIT_FRESH)
+    mp4_index_seek(mc, txnp, contp);
+
 release:
 
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdrp);
@@ -259,6 +324,185 @@ mp4_read_response(Mp4Context *mc, TSHttpTxn txnp)
   mc->cl = n;
   mp4_add_transform(mc, txnp);
 
+  // the transform may have been set up for a stale copy of another size
+  if (mc->mtc->mm.cl == n) {
+    mp4_index_key(mc, txnp, bufp, hdrp);
+
+  } else {
+    mc->mtc->indexing = false;
+  }
+
+release:
+
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdrp);
+}
+
+static void
+mp4_send_request(TSHttpTxn txnp)
+{
+  TSMBuffer bufp;
+  TSMLoc hdrp;
+  TSMLoc range_field;
+
+  if (TSHttpTxnServerReqGet(txnp, &bufp, &hdrp) != TS_SUCCESS) {
+    TSError("[%s] could not get server request", __FUNCTION__);
+    return;
+  }
+
+  // the Range added for the cache read must not reach the origin, the transform needs the whole file
+  range_field = TSMimeHdrFieldFind(bufp, hdrp, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE);
+  if (range_field) {
+    TSMimeHdrFieldDestroy(bufp, hdrp, range_field);
+    TSHandleMLocRelease(bufp, hdrp, range_field);
+  }
+
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdrp);
+}
+
+/*
+ * Sets the key and validator under which the meta data of the response is indexed, and keeps the
+ * head of the file for the index as it is parsed. Responses without ETag or Last-Modified are not
+ * indexed, as a changed file could not be told apart.
+ */
+static bool
+mp4_index_key(Mp4Context *mc, TSHttpTxn txnp, TSMBuffer bufp, TSMLoc hdrp)
+{
+  int i, len, key_len;
+  const char *val;
+  char *key;
+  char buf[32];
+  TSMLoc field;
+  TSMBuffer url_bufp;
+  TSMLoc url_loc;
+  std::string validator;
+  bool validated;
+  Mp4TransformContext *mtc;
+
+  static const struct {
+    const char *name;
+    int len;
+  } fields[] = {{TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG}, {TS_MIME_FIELD_LAST_MODIFIED, TS_MIME_LEN_LAST_MODIFIED}};
+
+  if (!mc->index_cache)
+    return false;
+
+  mtc = mc->mtc;
+  validated = false;
+
+  for (i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) {
+    field = TSMimeHdrFieldFind(bufp, hdrp, fields[i].name, fields[i].len);
+    if (field) {
+      val = TSMimeHdrFieldValueStringGet(bufp, hdrp, field, -1, &len);
+      if (val && len > 0) {
+        validator.append(val, len);
+        validated = true;
+      }
+      TSHandleMLocRelease(bufp, hdrp, field);
+    }
+
+    validator.append("|");
+  }
+
+  if (!validated)
+    return false;
+
+  len = snprintf(buf, sizeof(buf), "%" PRId64, mtc->mm.cl);
+  validator.append(buf, len);
+
+  url_bufp = TSMBufferCreate();
+  key = NULL;
+
+  if (TSUrlCreate(url_bufp, &url_loc) == TS_SUCCESS) {
+    if (TSHttpTxnCacheLookupUrlGet(txnp, url_bufp, url_loc) == TS_SUCCESS) {
+      key = TSUrlStringGet(url_bufp, url_loc, &key_len);
+    }
+    TSHandleMLocRelease(url_bufp, TS_NULL_MLOC, url_loc);
+  }
+
+  TSMBufferDestroy(url_bufp);
+
+  if (key == NULL)
+    return false;
+
+  mtc->index_key.assign(key, key_len);
+  mtc->index_validator.swap(validator);
+
+  mtc->indexing = true;
+
+  TSfree(key);
+  return true;
+}
+
+/*
+ * Generates the new meta data from the index of the file, and asks the cache for the file from
+ * where the new mdat data starts only, instead of parsing the meta data of the whole file.
+ */
+static void
+mp4_index_seek(Mp4Context *mc, TSHttpTxn txnp, TSCont contp)
+{
+  const Mp4IndexCache::Entry *index;
+  Mp4TransformContext *mtc;
+  Mp4Meta *mm;
+  int64_t start_pos;
+  bool found;
+  TSMBuffer bufp;
+  TSMLoc hdrp;
+  TSMLoc range_field;
+  char buf[64];
+  int buf_len;
+
+  mtc = mc->mtc;
+  mm = &mtc->mm;
+
+  index = mc->index_cache->acquire(mtc->index_key, mtc->index_validator);
+  if (index == NULL)
+    return;
+
+  mtc->indexing = false;
+
+  found = index->value->seek(mm);
+  mc->index_cache->release(index);
+
+  if (!found) {
+    // mm is spent, the transform parses the file with a new one
+    delete mc->mtc;
+    mc->mtc = new Mp4TransformContext(mc->start, mc->cl);
+    return;
+  }
+
+  start_pos = mm->start_pos;
+
+  TSDebug(DEBUG_TAG, "[%s] Index hit for %s, new file starts at %" PRId64, __FUNCTION__, mtc->index_key.c_str(), start_pos);
+  TSStatIntIncrement(index_hits_stat, 1);
+
+  mtc->meta_ready = true;
+  mtc->tail = start_pos;
+  mtc->content_length = mm->content_length;
+  mtc->meta_length = TSIOBufferReaderAvail(mm->out_handle.reader);
+
+  TSIOBufferReaderFree(mtc->dup_reader);
+  mtc->dup_reader = NULL;
+
+  if (start_pos == 0 || TSHttpTxnClientReqGet(txnp, &bufp, &hdrp) != TS_SUCCESS)
+    return;
+
+  // the cache serves ranges to HTTP/1.1 requests only, others would be sent to the origin
+  if (TSHttpHdrVersionGet(bufp, hdrp) != TS_HTTP_VERSION(1, 1))
+    goto release;
+
+  buf_len = snprintf(buf, sizeof(buf), "bytes=%" PRId64 "-", start_pos);
+
+  if (TSMimeHdrFieldCreateNamed(bufp, hdrp, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE, &range_field) == TS_SUCCESS) {
+    TSMimeHdrFieldValueStringSet(bufp, hdrp, range_field, -1, buf, buf_len);
+    TSMimeHdrFieldAppend(bufp, hdrp, range_field);
+    TSHandleMLocRelease(bufp, hdrp, range_field);
+
+    if (!mc->range_added) {
+      TSHttpTxnHookAdd(txnp, TS_HTTP_SEND_REQUEST_HDR_HOOK, contp);
+      mc->range_added = true;
+    }
+  }
+
 release:
 
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdrp);
@@ -350,9 +594,19 @@ mp4_transform_handler(TSCont contp, Mp4Context *mc)
   write_down = false;
 
   if (!mtc->parse_over) {
-    ret = mp4_parse_meta(mtc, toread <= 0);
-    if (ret == 0)
-      goto trans;
+    if (mtc->meta_ready) {
+      // the cache sends the file from the new mdat data on, unless it could not serve the range
+      if (TSVIONBytesGet(input_vio) == mc->cl - mtc->tail) {
+        mtc->tail = 0;
+      }
+
+      ret = 1;
+
+    } else {
+      ret = mp4_parse_meta(mc, toread <= 0);
+      if (ret == 0)
+        goto trans;
+    }
 
     mtc->parse_over = true;
     mtc->output.buffer = TSIOBufferCreate();
@@ -431,14 +685,17 @@ trans:
 }
 
 static int
-mp4_parse_meta(Mp4TransformContext *mtc, bool body_complete)
+mp4_parse_meta(Mp4Context *mc, bool body_complete)
 {
   int ret;
   int64_t avail, bytes;
   TSIOBufferBlock blk;
   const char *data;
   Mp4Meta *mm;
+  Mp4Index *index;
+  Mp4TransformContext *mtc;
 
+  mtc = mc->mtc;
   mm = &mtc->mm;
 
   avail = TSIOBufferReaderAvail(mtc->dup_reader);
@@ -448,6 +705,10 @@ mp4_parse_meta(Mp4TransformContext *mtc, bool body_complete)
     data = TSIOBufferBlockReadStart(blk, mtc->dup_reader, &bytes);
     if (bytes > 0) {
       TSIOBufferWrite(mm->meta_buffer, data, bytes);
+
+      // the parse rewrites the meta buffer in place
+      if (mtc->indexing)
+        mtc->index_head.append(data, bytes);
     }
 
     blk = TSIOBufferBlockNext(blk);
@@ -457,6 +718,17 @@ mp4_parse_meta(Mp4TransformContext *mtc, bool body_complete)
 
   ret = mm->parse_meta(body_complete);
 
+  if (mtc->indexing && ret != 0) {
+    if (ret > 0) {
+      index = Mp4Index::create(mm, mtc->index_head);
+      if (index)
+        mc->index_cache->insert(mtc->index_key, mtc->index_validator, index);
+    }
+
+    mtc->indexing = false;
+    mtc->index_head.clear();
+  }
+
   if (ret > 0) { // meta success
     mtc->tail = mm->start_pos;
     mtc->content_length = mm->content_length;
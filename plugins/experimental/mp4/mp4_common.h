@@ -24,11 +24,13 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <memory>
 
 #include <ts/ts.h>
 #include <ts/experimental.h>
 #include <ts/remap.h>
 #include "mp4_meta.h"
+#include "mp4_index.h"
 
 
 class IOHandle
@@ -59,7 +61,8 @@ class Mp4TransformContext
 {
 public:
   Mp4TransformContext(float offset, int64_t cl)
-    : total(0), tail(0), pos(0), content_length(0), meta_length(0), parse_over(false), raw_transform(false)
+    : total(0), tail(0), pos(0), content_length(0), meta_length(0), parse_over(false), raw_transform(false), meta_ready(false),
+      indexing(false)
   {
     res_buffer = TSIOBufferCreate();
     res_reader = TSIOBufferReaderAlloc(res_buffer);
@@ -99,12 +102,19 @@ public:
 
   bool parse_over;
   bool raw_transform;
+  bool meta_ready; // the new meta data was parsed from a cached index
+  bool indexing;   // the head of the file is kept in index_head until it is parsed
+
+  std::string index_key;
+  std::string index_validator;
+  std::string index_head;
 };
 
 class Mp4Context
 {
 public:
-  Mp4Context(float s) : start(s), cl(0), mtc(NULL), transform_added(false){};
+  Mp4Context(float s, const std::shared_ptr<Mp4IndexCache> &cache)
+    : start(s), cl(0), mtc(NULL), index_cache(cache), transform_added(false), range_added(false){};
 
   ~Mp4Context()
   {
@@ -119,8 +129,10 @@ public:
   int64_t cl;
 
   Mp4TransformContext *mtc;
+  std::shared_ptr<Mp4IndexCache> index_cache; // NULL if the remap rule does not index files
 
   bool transform_added;
+  bool range_added;
 };
 
 #endif
@@ -0,0 +1,809 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "mp4_index.h"
+
+
+/*
+ * Where one trak is cut for a start time, this mirrors the state the mp4_update_xxx_atom()
+ * functions of Mp4Meta keep in Mp4Trak.
+ */
+class Mp4TrakSeek
+{
+public:
+  Mp4TrakSeek()
+    : start_sample(0), start_chunk(0), chunk_samples(0), chunk_samples_size(0), start_offset(0), stts_entry(0), stts_count(0),
+      stss_entry(0), ctts_entry(0), ctts_count(0), stsc_entry(0), stsc_samples(0), stsc_next_chunk(0), size(0), tkhd_cut(0),
+      mdhd_cut(0)
+  {
+  }
+
+public:
+  uint32_t start_sample;
+  uint32_t start_chunk;
+  uint32_t chunk_samples;
+  uint64_t chunk_samples_size;
+  off_t start_offset;
+
+  uint32_t stts_entry; // the first entry kept, and its count of samples left
+  uint32_t stts_count;
+  uint32_t stss_entry;
+  uint32_t ctts_entry; // no entries are kept if it is the number of entries
+  uint32_t ctts_count;
+  uint32_t stsc_entry; // the entry of the start chunk, its samples per chunk and the next chunk with other samples
+  uint32_t stsc_samples;
+  uint32_t stsc_next_chunk;
+
+  size_t size;
+  uint64_t tkhd_cut;
+  uint64_t mdhd_cut;
+};
+
+
+static void
+mp4_handle_copy(const BufferHandle &handle, std::string &s)
+{
+  TSIOBufferBlock blk;
+  const char *data;
+  int64_t avail;
+
+  if (handle.reader == NULL)
+    return;
+
+  for (blk = TSIOBufferReaderStart(handle.reader); blk != NULL; blk = TSIOBufferBlockNext(blk)) {
+    data = TSIOBufferBlockReadStart(blk, handle.reader, &avail);
+    s.append(data, avail);
+  }
+}
+
+// Whether a version 0 or version 1 atom is long enough for its duration to be updated
+static bool
+mp4_full_atom_complete(const std::string &atom, size_t size, size_t size64)
+{
+  if (atom.size() <= offsetof(mp4_mvhd_atom, version))
+    return false;
+
+  return atom.size() >= (atom[offsetof(mp4_mvhd_atom, version)] == 0 ? size : size64);
+}
+
+static inline uint32_t
+mp4_string_get_32value(const std::string &s, size_t offset)
+{
+  return mp4_get_32value(s.data() + offset);
+}
+
+static inline uint64_t
+mp4_string_get_64value(const std::string &s, size_t offset)
+{
+  return mp4_get_64value(s.data() + offset);
+}
+
+static inline void
+mp4_string_set_32value(std::string &s, size_t offset, uint32_t n)
+{
+  mp4_set_32value(&s[offset], n);
+}
+
+static inline void
+mp4_string_set_64value(std::string &s, size_t offset, uint64_t n)
+{
+  mp4_set_64value(&s[offset], n);
+}
+
+static inline void
+mp4_string_append_32value(std::string &s, uint32_t n)
+{
+  u_char buf[4];
+
+  mp4_set_32value(buf, n);
+  s.append((const char *)buf, sizeof(buf));
+}
+
+static inline void
+mp4_string_append_64value(std::string &s, uint64_t n)
+{
+  u_char buf[8];
+
+  mp4_set_64value(buf, n);
+  s.append((const char *)buf, sizeof(buf));
+}
+
+
+Mp4Index *
+Mp4Index::create(const Mp4Meta *mm, const std::string &head)
+{
+  uint32_t i;
+  int64_t head_size;
+  Mp4Index *index;
+  Mp4Meta meta;
+
+  // the parse must have stopped at the mdat header, which is 8 or 16 bytes
+  if (mm->mdat_atom.buffer == NULL)
+    return NULL;
+
+  // mm has cut its atoms already, parse them again from the head as they are in the file
+  head_size = mm->passed + sizeof(mp4_atom_header64);
+
+  meta.cl = mm->cl;
+  TSIOBufferWrite(meta.meta_buffer, head.data(), head_size);
+  meta.meta_avail = TSIOBufferReaderAvail(meta.meta_reader);
+
+  if (meta.parse_root_atoms() <= 0)
+    return NULL;
+
+  if (meta.trak_num == 0 || meta.mdat_atom.buffer == NULL || meta.moov_atom.buffer == NULL || meta.mvhd_atom.buffer == NULL)
+    return NULL;
+
+  index = new Mp4Index();
+  index->_cl = meta.cl;
+  index->_timescale = meta.timescale;
+
+  mp4_handle_copy(meta.ftyp_atom, index->_ftyp);
+  mp4_handle_copy(meta.moov_atom, index->_moov);
+  mp4_handle_copy(meta.mvhd_atom, index->_mvhd);
+
+  index->_bytes = sizeof(Mp4Index) + index->_ftyp.size() + index->_moov.size() + index->_mvhd.size();
+
+  if (!mp4_full_atom_complete(index->_mvhd, sizeof(mp4_mvhd_atom), sizeof(mp4_mvhd64_atom)))
+    goto fail;
+
+  for (i = 0; i < meta.trak_num; i++) {
+    if (!index->add_trak(meta.trak_vec[i]))
+      goto fail;
+  }
+
+  return index;
+
+fail:
+  delete index;
+  return NULL;
+}
+
+/*
+ * Decodes the tables of trak. The binary searches of a seek find the same entries as the linear
+ * scans of Mp4Meta as long as the tables are sorted and their totals fit in 32 bits, files that
+ * do not are not indexed.
+ */
+bool
+Mp4Index::add_trak(const Mp4Trak *trak)
+{
+  uint32_t i, entries;
+  uint64_t samples, time, n;
+  std::string data;
+
+  _traks.resize(_traks.size() + 1);
+  Mp4IndexTrak &t = _traks.back();
+
+  t.timescale = trak->timescale;
+  t.duration = trak->duration;
+  t.chunks = trak->chunks;
+  t.sample_sizes_entries = trak->sample_sizes_entries;
+  t.tkhd_size = trak->tkhd_size;
+  t.mdhd_size = trak->mdhd_size;
+  t.hdlr_size = trak->hdlr_size;
+  t.vmhd_size = trak->vmhd_size;
+  t.smhd_size = trak->smhd_size;
+  t.dinf_size = trak->dinf_size;
+  t.size = trak->size;
+
+  for (i = MP4_TRAK_ATOM; i <= MP4_LAST_ATOM; i++) {
+    if (i == MP4_STTS_DATA || i == MP4_STSS_DATA || i == MP4_CTTS_DATA || i == MP4_STSC_DATA || i == MP4_STCO_DATA ||
+        i == MP4_CO64_DATA)
+      continue;
+
+    mp4_handle_copy(trak->atoms[i], t.atoms[i]);
+  }
+
+  // These are required, as are the sizes the durations are updated at
+  if (!mp4_full_atom_complete(t.atoms[MP4_TKHD_ATOM], sizeof(mp4_tkhd_atom), sizeof(mp4_tkhd64_atom)) ||
+      !mp4_full_atom_complete(t.atoms[MP4_MDHD_ATOM], sizeof(mp4_mdhd_atom), sizeof(mp4_mdhd64_atom)) ||
+      trak->atoms[MP4_STTS_DATA].buffer == NULL || trak->atoms[MP4_STSC_DATA].buffer == NULL ||
+      (trak->atoms[MP4_STCO_DATA].buffer == NULL && trak->atoms[MP4_CO64_DATA].buffer == NULL)) {
+    return false;
+  }
+
+  // Headers of container atoms are only updated in their first 4 bytes, like in Mp4Meta
+  if (t.atoms[MP4_TRAK_ATOM].empty() || t.atoms[MP4_MDIA_ATOM].empty() || t.atoms[MP4_MINF_ATOM].empty() ||
+      t.atoms[MP4_STBL_ATOM].empty()) {
+    return false;
+  }
+
+  // sample sizes are copied as they are, from the start sample on
+  if (trak->atoms[MP4_STSZ_DATA].buffer && t.atoms[MP4_STSZ_DATA].empty())
+    return false;
+
+  // stts
+  data.clear();
+  mp4_handle_copy(trak->atoms[MP4_STTS_DATA], data);
+  entries = data.size() / sizeof(mp4_stts_entry);
+  t.stts.resize(entries);
+  samples = time = 0;
+
+  for (i = 0; i < entries; i++) {
+    Mp4IndexStts &e = t.stts[i];
+
+    e.count = mp4_string_get_32value(data, i * sizeof(mp4_stts_entry) + offsetof(mp4_stts_entry, count));
+    e.duration = mp4_string_get_32value(data, i * sizeof(mp4_stts_entry) + offsetof(mp4_stts_entry, duration));
+
+    samples += e.count;
+    n = (uint64_t)e.count * e.duration;
+    if (samples > UINT32_MAX || time + n < time)
+      return false;
+
+    time += n;
+    e.samples_end = samples;
+    e.time_end = time;
+  }
+
+  // stss
+  if (trak->atoms[MP4_STSS_DATA].buffer) {
+    data.clear();
+    mp4_handle_copy(trak->atoms[MP4_STSS_DATA], data);
+    entries = data.size() / sizeof(uint32_t);
+    t.stss.resize(entries);
+
+    for (i = 0; i < entries; i++) {
+      t.stss[i] = mp4_string_get_32value(data, i * sizeof(uint32_t));
+      if (t.stss[i] == 0 || (i > 0 && t.stss[i] < t.stss[i - 1]))
+        return false;
+    }
+  }
+
+  // ctts
+  if (trak->atoms[MP4_CTTS_DATA].buffer) {
+    data.clear();
+    mp4_handle_copy(trak->atoms[MP4_CTTS_DATA], data);
+    entries = data.size() / sizeof(mp4_ctts_entry);
+    t.ctts.resize(entries);
+    samples = 0;
+
+    for (i = 0; i < entries; i++) {
+      Mp4IndexCtts &e = t.ctts[i];
+
+      e.count = mp4_string_get_32value(data, i * sizeof(mp4_ctts_entry) + offsetof(mp4_ctts_entry, count));
+      e.offset = mp4_string_get_32value(data, i * sizeof(mp4_ctts_entry) + offsetof(mp4_ctts_entry, offset));
+
+      samples += e.count;
+      if (samples > UINT32_MAX)
+        return false;
+
+      e.samples_end = samples;
+    }
+  }
+
+  // stsc, the chunks of the entries must follow each other within the chunk offsets
+  data.clear();
+  mp4_handle_copy(trak->atoms[MP4_STSC_DATA], data);
+  entries = data.size() / sizeof(mp4_stsc_entry);
+  if (entries == 0)
+    return false;
+
+  t.stsc.resize(entries);
+  samples = 0;
+
+  for (i = 0; i < entries; i++) {
+    Mp4IndexStsc &e = t.stsc[i];
+
+    e.chunk = mp4_string_get_32value(data, i * sizeof(mp4_stsc_entry) + offsetof(mp4_stsc_entry, chunk));
+    e.samples = mp4_string_get_32value(data, i * sizeof(mp4_stsc_entry) + offsetof(mp4_stsc_entry, samples));
+    e.id = mp4_string_get_32value(data, i * sizeof(mp4_stsc_entry) + offsetof(mp4_stsc_entry, id));
+
+    if (e.chunk == 0 || e.chunk > t.chunks || (i > 0 && e.chunk <= t.stsc[i - 1].chunk))
+      return false;
+
+    if (i > 0) {
+      n = (uint64_t)(e.chunk - t.stsc[i - 1].chunk) * t.stsc[i - 1].samples;
+      samples += n;
+      if (n > UINT32_MAX || samples > UINT32_MAX)
+        return false;
+    }
+
+    e.samples_before = samples;
+  }
+
+  if ((uint64_t)(t.chunks - t.stsc.back().chunk) * t.stsc.back().samples > UINT32_MAX)
+    return false;
+
+  // stco or co64
+  data.clear();
+
+  if (trak->atoms[MP4_CO64_DATA].buffer) {
+    mp4_handle_copy(trak->atoms[MP4_CO64_DATA], data);
+    entries = data.size() / sizeof(uint64_t);
+    t.chunk_offsets.resize(entries);
+
+    for (i = 0; i < entries; i++) {
+      t.chunk_offsets[i] = mp4_string_get_64value(data, i * sizeof(uint64_t));
+    }
+
+  } else {
+    mp4_handle_copy(trak->atoms[MP4_STCO_DATA], data);
+    entries = data.size() / sizeof(uint32_t);
+    t.chunk_offsets.resize(entries);
+
+    for (i = 0; i < entries; i++) {
+      t.chunk_offsets[i] = mp4_string_get_32value(data, i * sizeof(uint32_t));
+    }
+  }
+
+  if (entries != t.chunks)
+    return false;
+
+  for (i = 0; i <= MP4_LAST_ATOM; i++) {
+    _bytes += t.atoms[i].size();
+  }
+
+  _bytes += sizeof(Mp4IndexTrak) + t.stts.size() * sizeof(Mp4IndexStts) + t.stss.size() * sizeof(uint32_t) +
+            t.ctts.size() * sizeof(Mp4IndexCtts) + t.stsc.size() * sizeof(Mp4IndexStsc) + t.chunk_offsets.size() * sizeof(uint64_t);
+
+  return true;
+}
+
+
+static bool
+mp4_stts_time_less(uint64_t time, const Mp4IndexStts &e)
+{
+  return time < e.time_end;
+}
+
+static bool
+mp4_stts_samples_less(uint64_t samples, const Mp4IndexStts &e)
+{
+  return samples < e.samples_end;
+}
+
+static bool
+mp4_ctts_samples_less(const Mp4IndexCtts &e, uint64_t samples)
+{
+  return e.samples_end < samples;
+}
+
+static bool
+mp4_stsc_samples_less(const Mp4IndexStsc &e, uint64_t samples)
+{
+  return e.samples_before < samples;
+}
+
+/*
+ * Finds the start sample from the start time, moved back to a key frame, see
+ * Mp4Meta::mp4_update_stts_atom()
+ */
+static void
+mp4_seek_stts(const Mp4IndexTrak &t, Mp4TrakSeek &s, int64_t start, double &rs)
+{
+  uint32_t start_sample, key_sample;
+  uint64_t start_time, sum;
+  std::vector<Mp4IndexStts>::const_iterator it;
+  std::vector<uint32_t>::const_iterator key;
+
+  start_time = start * t.timescale / 1000;
+  if (rs > 0) {
+    start_time = (uint64_t)(rs * t.timescale / 1000);
+  }
+
+  // the first entry that ends after the start time
+  it = std::upper_bound(t.stts.begin(), t.stts.end(), start_time, mp4_stts_time_less);
+
+  if (it == t.stts.end()) {
+    start_sample = t.stts.empty() ? 0 : t.stts.back().samples_end;
+
+  } else {
+    start_sample = it->samples_end - it->count;
+    start_sample += (uint32_t)((start_time - (it->time_end - (uint64_t)it->count * it->duration)) / it->duration);
+  }
+
+  // the last key frame before start_sample
+  if (!t.stss.empty()) {
+    key = std::upper_bound(t.stss.begin(), t.stss.end(), start_sample);
+    key_sample = key == t.stss.begin() ? 1 : *(key - 1);
+
+    if (key_sample != start_sample) {
+      start_sample = key_sample - 1;
+    }
+  }
+
+  s.start_sample = start_sample;
+
+  // the entry the new first sample is in
+  it = std::upper_bound(t.stts.begin(), t.stts.end(), (uint64_t)start_sample, mp4_stts_samples_less);
+  s.stts_entry = it - t.stts.begin();
+
+  if (it == t.stts.end()) {
+    sum = t.stts.empty() ? 0 : t.stts.back().time_end;
+
+  } else {
+    start_sample -= it->samples_end - it->count;
+    s.stts_count = it->count - start_sample;
+    sum = it->time_end - (uint64_t)it->count * it->duration + (uint64_t)start_sample * it->duration;
+  }
+
+  if (rs == 0) {
+    rs = ((double)sum / t.duration) * ((double)t.duration / t.timescale) * 1000;
+  }
+
+  s.size += sizeof(mp4_stts_atom) + (t.stts.size() - s.stts_entry) * sizeof(mp4_stts_entry);
+}
+
+static bool
+mp4_seek_stss(const Mp4IndexTrak &t, Mp4TrakSeek &s)
+{
+  if (t.atoms[MP4_STSS_ATOM].empty())
+    return true;
+
+  s.stss_entry = std::lower_bound(t.stss.begin(), t.stss.end(), s.start_sample + 1) - t.stss.begin();
+  if (s.stss_entry == t.stss.size())
+    return false;
+
+  s.size += sizeof(mp4_stss_atom) + (t.stss.size() - s.stss_entry) * sizeof(uint32_t);
+
+  return true;
+}
+
+static void
+mp4_seek_ctts(const Mp4IndexTrak &t, Mp4TrakSeek &s)
+{
+  std::vector<Mp4IndexCtts>::const_iterator it;
+
+  if (t.atoms[MP4_CTTS_ATOM].empty())
+    return;
+
+  // the first entry that ends at or after the new first sample, counted from 1
+  it = std::lower_bound(t.ctts.begin(), t.ctts.end(), (uint64_t)s.start_sample + 1, mp4_ctts_samples_less);
+  s.ctts_entry = it - t.ctts.begin();
+
+  if (it == t.ctts.end()) // the composition offsets are all before the start, drop them
+    return;
+
+  s.ctts_count = it->samples_end - s.start_sample;
+  s.size += sizeof(mp4_ctts_atom) + (t.ctts.size() - s.ctts_entry) * sizeof(mp4_ctts_entry);
+}
+
+static bool
+mp4_seek_stsc(const Mp4IndexTrak &t, Mp4TrakSeek &s)
+{
+  uint32_t start_sample, entries;
+  std::vector<Mp4IndexStsc>::const_iterator it;
+
+  // the first entry whose chunks start at or after the start sample, the start is in the one before
+  it = std::lower_bound(t.stsc.begin() + 1, t.stsc.end(), (uint64_t)s.start_sample, mp4_stsc_samples_less);
+
+  if (it == t.stsc.end()) {
+    s.stsc_next_chunk = t.chunks;
+
+  } else {
+    s.stsc_next_chunk = it->chunk;
+  }
+
+  --it;
+  s.stsc_entry = it - t.stsc.begin();
+  s.stsc_samples = it->samples;
+  start_sample = s.start_sample - it->samples_before;
+
+  if (start_sample > (uint64_t)(s.stsc_next_chunk - it->chunk) * it->samples)
+    return false;
+
+  if (it->samples == 0)
+    return false;
+
+  s.start_chunk = it->chunk - 1;
+  s.start_chunk += start_sample / it->samples;
+  s.chunk_samples = start_sample % it->samples;
+
+  entries = t.stsc.size() - s.stsc_entry;
+  if (s.chunk_samples && s.stsc_next_chunk - s.start_chunk != 2) {
+    entries++;
+  }
+
+  s.size += sizeof(mp4_stsc_atom) + entries * sizeof(mp4_stsc_entry);
+
+  return true;
+}
+
+static bool
+mp4_seek_stsz(const Mp4IndexTrak &t, Mp4TrakSeek &s)
+{
+  uint32_t i;
+  const std::string &stsz = t.atoms[MP4_STSZ_DATA];
+
+  if (t.atoms[MP4_STSZ_DATA].empty()) // uniform sample size, accounted for in t.size
+    return true;
+
+  if (s.start_sample > t.sample_sizes_entries || s.chunk_samples > s.start_sample)
+    return false;
+
+  for (i = s.start_sample - s.chunk_samples; i < s.start_sample; i++) {
+    s.chunk_samples_size += mp4_string_get_32value(stsz, i * sizeof(uint32_t));
+  }
+
+  s.size += sizeof(mp4_stsz_atom) + stsz.size() - s.start_sample * sizeof(uint32_t);
+
+  return true;
+}
+
+static bool
+mp4_seek_chunk_offsets(const Mp4IndexTrak &t, Mp4TrakSeek &s)
+{
+  bool co64 = !t.atoms[MP4_CO64_ATOM].empty();
+
+  if (s.start_chunk >= t.chunks)
+    return false;
+
+  if (co64) {
+    s.start_offset = t.chunk_offsets[s.start_chunk] + s.chunk_samples_size;
+    s.size += sizeof(mp4_co64_atom) + (t.chunks - s.start_chunk) * sizeof(uint64_t);
+
+  } else {
+    s.start_offset = (uint32_t)t.chunk_offsets[s.start_chunk] + s.chunk_samples_size;
+    s.size += sizeof(mp4_stco_atom) + (t.chunks - s.start_chunk) * sizeof(uint32_t);
+  }
+
+  return true;
+}
+
+static void
+mp4_set_duration(std::string &atom, size_t offset32, size_t offset64, uint64_t cut)
+{
+  if (atom[offsetof(mp4_mvhd_atom, version)] == 0) {
+    mp4_string_set_32value(atom, offset32, mp4_string_get_32value(atom, offset32) - cut);
+  } else {
+    mp4_string_set_64value(atom, offset64, mp4_string_get_64value(atom, offset64) - cut);
+  }
+}
+
+static void
+mp4_append_atom(std::string &meta, const std::string &atom, size_t size)
+{
+  size_t pos = meta.size();
+
+  meta.append(atom);
+  mp4_string_set_32value(meta, pos, size);
+}
+
+/*
+ * Appends the atoms of one trak, as Mp4Meta::post_process_meta() copies them once it has cut
+ * them, with the chunk offsets moved by adjustment.
+ */
+static void
+mp4_append_trak(std::string &meta, const Mp4IndexTrak &t, const Mp4TrakSeek &s, off_t adjustment)
+{
+  uint32_t i, entries;
+  size_t stbl_size, minf_size, mdia_size, pos;
+  bool split;
+  const Mp4IndexStsc *first;
+  std::string atom;
+
+  stbl_size = s.size - t.tkhd_size - t.mdhd_size - t.hdlr_size - 3 * sizeof(mp4_atom_header);
+  stbl_size -= t.vmhd_size + t.smhd_size + t.dinf_size;
+  minf_size = stbl_size + sizeof(mp4_atom_header) + t.vmhd_size + t.smhd_size + t.dinf_size;
+  mdia_size = minf_size + t.mdhd_size + t.hdlr_size + sizeof(mp4_atom_header);
+
+  mp4_append_atom(meta, t.atoms[MP4_TRAK_ATOM], s.size);
+
+  atom = t.atoms[MP4_TKHD_ATOM];
+  mp4_set_duration(atom, offsetof(mp4_tkhd_atom, duration), offsetof(mp4_tkhd64_atom, duration), s.tkhd_cut);
+  meta.append(atom);
+
+  mp4_append_atom(meta, t.atoms[MP4_MDIA_ATOM], mdia_size);
+
+  atom = t.atoms[MP4_MDHD_ATOM];
+  mp4_set_duration(atom, offsetof(mp4_mdhd_atom, duration), offsetof(mp4_mdhd64_atom, duration), s.mdhd_cut);
+  meta.append(atom);
+
+  meta.append(t.atoms[MP4_HDLR_ATOM]);
+  mp4_append_atom(meta, t.atoms[MP4_MINF_ATOM], minf_size);
+  meta.append(t.atoms[MP4_VMHD_ATOM]);
+  meta.append(t.atoms[MP4_SMHD_ATOM]);
+  meta.append(t.atoms[MP4_DINF_ATOM]);
+  mp4_append_atom(meta, t.atoms[MP4_STBL_ATOM], stbl_size);
+  meta.append(t.atoms[MP4_STSD_ATOM]);
+
+  // stts
+  pos = meta.size();
+  meta.append(t.atoms[MP4_STTS_ATOM]);
+  mp4_string_set_32value(meta, pos + offsetof(mp4_stts_atom, size),
+                         sizeof(mp4_stts_atom) + (t.stts.size() - s.stts_entry) * sizeof(mp4_stts_entry));
+  mp4_string_set_32value(meta, pos + offsetof(mp4_stts_atom, entries), t.stts.size() - s.stts_entry);
+
+  for (i = s.stts_entry; i < t.stts.size(); i++) {
+    mp4_string_append_32value(meta, i == s.stts_entry ? s.stts_count : t.stts[i].count);
+    mp4_string_append_32value(meta, t.stts[i].duration);
+  }
+
+  // stss
+  if (!t.atoms[MP4_STSS_ATOM].empty()) {
+    pos = meta.size();
+    meta.append(t.atoms[MP4_STSS_ATOM]);
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stss_atom, size),
+                           sizeof(mp4_stss_atom) + (t.stss.size() - s.stss_entry) * sizeof(uint32_t));
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stss_atom, entries), t.stss.size() - s.stss_entry);
+
+    for (i = s.stss_entry; i < t.stss.size(); i++) {
+      mp4_string_append_32value(meta, t.stss[i] - s.start_sample);
+    }
+  }
+
+  // ctts
+  if (!t.atoms[MP4_CTTS_ATOM].empty() && s.ctts_entry < t.ctts.size()) {
+    pos = meta.size();
+    meta.append(t.atoms[MP4_CTTS_ATOM]);
+    mp4_string_set_32value(meta, pos + offsetof(mp4_ctts_atom, size),
+                           sizeof(mp4_ctts_atom) + (t.ctts.size() - s.ctts_entry) * sizeof(mp4_ctts_entry));
+    mp4_string_set_32value(meta, pos + offsetof(mp4_ctts_atom, entries), t.ctts.size() - s.ctts_entry);
+
+    for (i = s.ctts_entry; i < t.ctts.size(); i++) {
+      mp4_string_append_32value(meta, i == s.ctts_entry ? s.ctts_count : t.ctts[i].count);
+      mp4_string_append_32value(meta, t.ctts[i].offset);
+    }
+  }
+
+  // stsc, with an entry of its own for the rest of the start chunk if needed
+  first = &t.stsc[s.stsc_entry];
+  entries = t.stsc.size() - s.stsc_entry;
+  split = s.chunk_samples && s.stsc_next_chunk - s.start_chunk != 2;
+
+  if (split) {
+    entries++;
+  }
+
+  pos = meta.size();
+  meta.append(t.atoms[MP4_STSC_ATOM]);
+  mp4_string_set_32value(meta, pos + offsetof(mp4_stsc_atom, size), sizeof(mp4_stsc_atom) + entries * sizeof(mp4_stsc_entry));
+  mp4_string_set_32value(meta, pos + offsetof(mp4_stsc_atom, entries), entries);
+
+  if (split) {
+    mp4_string_append_32value(meta, 1);
+    mp4_string_append_32value(meta, first->samples - s.chunk_samples);
+    mp4_string_append_32value(meta, first->id);
+  }
+
+  mp4_string_append_32value(meta, split ? 2 : 1);
+  mp4_string_append_32value(meta, s.chunk_samples && !split ? first->samples - s.chunk_samples : first->samples);
+  mp4_string_append_32value(meta, first->id);
+
+  for (i = s.stsc_entry + 1; i < t.stsc.size(); i++) {
+    mp4_string_append_32value(meta, t.stsc[i].chunk - s.start_chunk);
+    mp4_string_append_32value(meta, t.stsc[i].samples);
+    mp4_string_append_32value(meta, t.stsc[i].id);
+  }
+
+  // stsz
+  meta.append(t.atoms[MP4_STSZ_ATOM]);
+
+  if (!t.atoms[MP4_STSZ_DATA].empty()) {
+    pos = meta.size() - sizeof(mp4_stsz_atom);
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stsz_atom, size),
+                           sizeof(mp4_stsz_atom) + t.atoms[MP4_STSZ_DATA].size() - s.start_sample * sizeof(uint32_t));
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stsz_atom, entries), t.sample_sizes_entries - s.start_sample);
+    meta.append(t.atoms[MP4_STSZ_DATA], s.start_sample * sizeof(uint32_t), std::string::npos);
+  }
+
+  // stco or co64, the first chunk starts at the first sample kept
+  if (!t.atoms[MP4_CO64_ATOM].empty()) {
+    pos = meta.size();
+    meta.append(t.atoms[MP4_CO64_ATOM]);
+    mp4_string_set_32value(meta, pos + offsetof(mp4_co64_atom, size),
+                           sizeof(mp4_co64_atom) + (t.chunks - s.start_chunk) * sizeof(uint64_t));
+    mp4_string_set_32value(meta, pos + offsetof(mp4_co64_atom, entries), t.chunks - s.start_chunk);
+
+    mp4_string_append_64value(meta, s.start_offset + adjustment);
+    for (i = s.start_chunk + 1; i < t.chunks; i++) {
+      mp4_string_append_64value(meta, t.chunk_offsets[i] + adjustment);
+    }
+
+  } else {
+    pos = meta.size();
+    meta.append(t.atoms[MP4_STCO_ATOM]);
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stco_atom, size),
+                           sizeof(mp4_stco_atom) + (t.chunks - s.start_chunk) * sizeof(uint32_t));
+    mp4_string_set_32value(meta, pos + offsetof(mp4_stco_atom, entries), t.chunks - s.start_chunk);
+
+    mp4_string_append_32value(meta, (uint32_t)s.start_offset + (int32_t)adjustment);
+    for (i = s.start_chunk + 1; i < t.chunks; i++) {
+      mp4_string_append_32value(meta, (uint32_t)t.chunk_offsets[i] + (int32_t)adjustment);
+    }
+  }
+}
+
+bool
+Mp4Index::seek(Mp4Meta *mm) const
+{
+  uint32_t i;
+  int64_t start, moov_size, mdat_header_size, mdat_data_size;
+  off_t start_offset, adjustment;
+  double rs;
+  u_char mdat_header[16];
+  std::string meta;
+  std::string mvhd(_mvhd);
+  std::vector<Mp4TrakSeek> seeks(_traks.size());
+
+  if (mm->cl != _cl)
+    return false;
+
+  start = mm->start;
+  rs = 0;
+  start_offset = _cl;
+  moov_size = mvhd.size() + 8;
+
+  for (i = 0; i < _traks.size(); i++) {
+    const Mp4IndexTrak &t = _traks[i];
+    Mp4TrakSeek &s = seeks[i];
+
+    s.size = t.size;
+
+    mp4_seek_stts(t, s, start, rs);
+    mp4_seek_ctts(t, s);
+
+    if (!mp4_seek_stss(t, s) || !mp4_seek_stsc(t, s) || !mp4_seek_stsz(t, s) || !mp4_seek_chunk_offsets(t, s)) {
+      TSDebug(DEBUG_TAG, "[%s] trak %u can not be cut at %" PRId64 " ms", __FUNCTION__, i, start);
+      return false;
+    }
+
+    s.size += 3 * sizeof(mp4_atom_header) + t.vmhd_size + t.smhd_size + t.dinf_size + t.mdhd_size + t.hdlr_size;
+    s.size += t.tkhd_size + sizeof(mp4_atom_header);
+
+    moov_size += s.size;
+
+    if (start_offset > s.start_offset)
+      start_offset = s.start_offset;
+
+    s.tkhd_cut = rs > 0 ? (uint64_t)(rs * _timescale / 1000) : start * _timescale / 1000;
+    s.mdhd_cut = rs > 0 ? (uint64_t)(rs * t.timescale / 1000) : start * t.timescale / 1000;
+  }
+
+  mp4_set_duration(mvhd, offsetof(mp4_mvhd_atom, duration), offsetof(mp4_mvhd64_atom, duration),
+                   rs > 0 ? (uint64_t)(rs * _timescale / 1000) : start * _timescale / 1000);
+
+  // the new mdat atom
+  mdat_data_size = _cl - start_offset;
+
+  if (mdat_data_size > 0xffffffff) {
+    mdat_header_size = sizeof(mp4_atom_header64);
+    mp4_set_32value(mdat_header, 1);
+    mp4_set_64value(mdat_header + sizeof(mp4_atom_header), sizeof(mp4_atom_header64) + mdat_data_size);
+
+  } else {
+    mdat_header_size = sizeof(mp4_atom_header);
+    mp4_set_32value(mdat_header, sizeof(mp4_atom_header) + mdat_data_size);
+  }
+
+  mp4_set_atom_name(mdat_header, 'm', 'd', 'a', 't');
+
+  adjustment = _ftyp.size() + moov_size + mdat_header_size - start_offset;
+
+  meta.reserve(_ftyp.size() + moov_size + mdat_header_size);
+  meta.append(_ftyp);
+  mp4_append_atom(meta, _moov, moov_size);
+  meta.append(mvhd);
+
+  for (i = 0; i < _traks.size(); i++) {
+    mp4_append_trak(meta, _traks[i], seeks[i], adjustment);
+  }
+
+  meta.append((const char *)mdat_header, mdat_header_size);
+
+  mm->out_handle.buffer = TSIOBufferCreate();
+  mm->out_handle.reader = TSIOBufferReaderAlloc(mm->out_handle.buffer);
+  TSIOBufferWrite(mm->out_handle.buffer, meta.data(), meta.size());
+
+  mm->start_pos = start_offset;
+  mm->content_length = _ftyp.size() + moov_size + mdat_header_size + mdat_data_size;
+
+  return true;
+}
@@ -0,0 +1,159 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _MP4_INDEX_H
+#define _MP4_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "ts/ValidatedLruCache.h"
+#include "mp4_meta.h"
+
+#define MP4_INDEX_CACHE_SIZE (64 * 1024 * 1024)
+
+
+/* An stts entry, with the number of samples and the time up to and including it */
+struct Mp4IndexStts {
+  uint32_t count;
+  uint32_t duration;
+  uint64_t samples_end;
+  uint64_t time_end;
+};
+
+/* A ctts entry, with the number of samples up to and including it */
+struct Mp4IndexCtts {
+  uint32_t count;
+  uint32_t offset;
+  uint64_t samples_end;
+};
+
+/* An stsc entry, with the number of samples in the chunks before its first chunk */
+struct Mp4IndexStsc {
+  uint32_t chunk;
+  uint32_t samples;
+  uint32_t id;
+  uint64_t samples_before;
+};
+
+/*
+ * The atoms of one trak: the atoms which are copied as they are, the fixed size heads of the
+ * sample tables, and the tables decoded once, with running totals to find the start of a seek
+ * by binary search. Sample sizes are kept in the byte order of the file, they are copied from
+ * the start sample on.
+ */
+class Mp4IndexTrak
+{
+public:
+  Mp4IndexTrak()
+    : timescale(0), duration(0), chunks(0), sample_sizes_entries(0), tkhd_size(0), mdhd_size(0), hdlr_size(0), vmhd_size(0),
+      smhd_size(0), dinf_size(0), size(0)
+  {
+  }
+
+public:
+  uint32_t timescale;
+  int64_t duration;
+  uint32_t chunks;
+  uint32_t sample_sizes_entries;
+
+  size_t tkhd_size;
+  size_t mdhd_size;
+  size_t hdlr_size;
+  size_t vmhd_size;
+  size_t smhd_size;
+  size_t dinf_size;
+  size_t size; // stsd, and stsz with uniform sample size
+
+  std::string atoms[MP4_LAST_ATOM + 1]; // the _DATA ones are empty, but MP4_STSZ_DATA
+
+  std::vector<Mp4IndexStts> stts;
+  std::vector<uint32_t> stss;
+  std::vector<Mp4IndexCtts> ctts;
+  std::vector<Mp4IndexStsc> stsc;
+  std::vector<uint64_t> chunk_offsets; // stco or co64
+};
+
+/*
+ * The meta data of an mp4 file, taken from the head of the file as it was read by the first
+ * parse. Generating the meta data of a start time looks up the start sample, chunk and offset
+ * of each trak in the decoded tables, and copies the table entries from there on. It yields the
+ * offset in the file from which the body of the new file is copied, which allows to read just
+ * that part of the file from the cache.
+ */
+class Mp4Index
+{
+public:
+  /*
+   * Returns NULL if the file is not supported, e.g. mdat precedes moov, or its tables are not
+   * sorted. head holds the file as it was read by mm, which must have parsed the meta data.
+   */
+  static Mp4Index *create(const Mp4Meta *mm, const std::string &head);
+
+  /*
+   * Generates the meta data for mm->start with mm, which must not have parsed anything yet. On
+   * success, mm holds the new meta data, its start position and the size of the new file, as if
+   * it had parsed the file itself. Returns false if the start time can not be served from the
+   * index.
+   */
+  bool seek(Mp4Meta *mm) const;
+
+  size_t
+  bytes() const
+  {
+    return _bytes;
+  }
+
+private:
+  Mp4Index() : _cl(0), _timescale(0), _bytes(0) {}
+
+  bool add_trak(const Mp4Trak *trak);
+
+  int64_t _cl;
+  uint32_t _timescale;
+  size_t _bytes;
+
+  std::string _ftyp;
+  std::string _moov;
+  std::string _mvhd;
+  std::vector<Mp4IndexTrak> _traks;
+};
+
+/*
+ * Size bounded LRU cache of indexes. An index is keyed on the cache key of the file, and a lookup
+ * only hits if the validator (from Content-Length, ETag and Last-Modified) matches. Entries handed
+ * out by acquire() stay valid until they are handed back through release(), even if they are
+ * evicted meanwhile.
+ */
+class Mp4IndexCache : public ValidatedLruCache<std::unique_ptr<Mp4Index>>
+{
+public:
+  explicit Mp4IndexCache(size_t max_bytes) : ValidatedLruCache<std::unique_ptr<Mp4Index>>(max_bytes) {}
+
+  /* Takes ownership of index */
+  void
+  insert(const std::string &key, const std::string &validator, Mp4Index *index)
+  {
+    std::unique_ptr<Mp4Index> value(index);
+
+    ValidatedLruCache<std::unique_ptr<Mp4Index>>::insert(key, validator, value, index->bytes());
+  }
+};
+
+#endif
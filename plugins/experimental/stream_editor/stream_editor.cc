@@ -68,6 +68,10 @@
  *   The default is 20.
  *
  *   Performance tips:
+ *    - String (non-regexp) rules are all matched together in a single
+ *      pass over the data, so adding more of them costs next to nothing.
+ *      Each regexp rule is a separate pass, which also rescans the data
+ *      held back for continuity, so prefer strings where you can.
  *    - A high len: value on any rule can severely impact on performance,
  *      especially if mixed with short matches that match frequently.
  *    - Specify high-precedence rules (low prio: values) first in your
@@ -92,6 +96,7 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
 #include <regex.h>
 #include <ctype.h>
 #include <assert.h>
@@ -261,6 +266,14 @@ class match_t
 public:
   virtual bool find(const char *, size_t, size_t &, size_t &, const char *, std::string &) const = 0;
   virtual size_t cont_size() const = 0;
+  /* literal matches are not searched for one by one: they all go into
+   * the ruleset's automaton, which finds them in a single pass.
+   */
+  virtual const char *
+  literal(size_t &, bool &) const
+  {
+    return NULL;
+  }
   virtual ~match_t() {}
 };
 
@@ -273,17 +286,18 @@ class strmatch : public match_t
 
 public:
   virtual bool
-  find(const char *buf, size_t len, size_t &found, size_t &found_len, const char *to, std::string &repl) const
-  {
-    const char *match = icase ? strcasestr(buf, str) : strstr(buf, str);
-    if (match) {
-      found = match - buf;
-      found_len = slen;
-      repl = to;
-      return (found + slen > len) ? false : true;
-    } else {
-      return false;
-    }
+  find(const char *, size_t, size_t &, size_t &, const char *, std::string &) const
+  {
+    /* found by literal_matcher instead */
+    return false;
+  }
+
+  virtual const char *
+  literal(size_t &len, bool &i) const
+  {
+    len = slen;
+    i = icase;
+    return str;
   }
 
   strmatch(const bool i, const char *pattern, int len) : icase(i), slen(len) { str = TSstrndup(pattern, len); }
@@ -296,7 +310,7 @@ public:
   virtual size_t
   cont_size() const
   {
-    return slen;
+    return 0;
   }
 };
 
@@ -529,6 +543,24 @@ public:
     return from->cont_size();
   }
 
+  const char *
+  literal(size_t &len, bool &icase) const
+  {
+    return from->literal(len, icase);
+  }
+
+  const char *
+  replacement() const
+  {
+    return to;
+  }
+
+  int
+  prio() const
+  {
+    return priority;
+  }
+
   void
   apply(const char *buf, size_t len, editset_t &edits) const
   {
@@ -549,21 +581,194 @@ public:
     }
   }
 };
-typedef std::vector<rule_t> ruleset_t;
-typedef ruleset_t::const_iterator rule_p;
+typedef std::vector<rule_t> rulelist_t;
+typedef rulelist_t::const_iterator rule_p;
+
+/* Aho-Corasick automaton over all the literal from: strings of a ruleset.
+ * It is built as a full DFA on case-folded bytes, so scanning costs one
+ * table lookup per input byte however many strings there are.  Matches
+ * of case-sensitive strings are verified against the input when found.
+ */
+class literal_matcher
+{
+public:
+  struct literal_t {
+    size_t rule;
+    std::string str;
+    bool icase;
+    literal_t(size_t r, const char *s, size_t len, bool i) : rule(r), str(s, len), icase(i) { ; }
+  };
+
+private:
+  std::vector<literal_t> literals;
+  std::vector<int> delta;                   /* 256 transitions per state */
+  std::vector<size_t> depth;                /* length of the prefix a state stands for */
+  std::vector<std::vector<size_t> > output; /* literals that end in a state */
+  unsigned char fold[256];
+
+public:
+  literal_matcher()
+  {
+    for (int c = 0; c < 256; ++c)
+      fold[c] = tolower(c);
+  }
+
+  void
+  add(size_t rule, const char *str, size_t len, bool icase)
+  {
+    if (len == 0) {
+      TSError("stream-editor: ignoring empty from: string");
+      return;
+    }
+    literals.push_back(literal_t(rule, str, len, icase));
+  }
+
+  void
+  compile()
+  {
+    /* the trie of all literals */
+    delta.assign(256, -1);
+    depth.assign(1, 0);
+    output.assign(1, std::vector<size_t>());
+    for (size_t i = 0; i < literals.size(); ++i) {
+      const std::string &str = literals[i].str;
+      int state = 0;
+      for (size_t j = 0; j < str.length(); ++j) {
+        size_t t = (state << 8) + fold[(unsigned char)str[j]];
+        if (delta[t] < 0) {
+          delta[t] = depth.size();
+          depth.push_back(j + 1);
+          output.push_back(std::vector<size_t>());
+          delta.resize(delta.size() + 256, -1);
+        }
+        state = delta[t];
+      }
+      output[state].push_back(i);
+    }
+
+    /* breadth first, fill in missing transitions from the failure state,
+     * and inherit its output: those are the literals that end here too.
+     */
+    std::vector<int> fail(depth.size(), 0);
+    std::vector<int> queue;
+    for (int c = 0; c < 256; ++c) {
+      if (delta[c] < 0) {
+        delta[c] = 0;
+      } else {
+        queue.push_back(delta[c]);
+      }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int state = queue[head];
+      const std::vector<size_t> &inherited = output[fail[state]];
+      output[state].insert(output[state].end(), inherited.begin(), inherited.end());
+      for (int c = 0; c < 256; ++c) {
+        size_t t = (state << 8) + c;
+        int f = delta[(fail[state] << 8) + c];
+        if (delta[t] < 0) {
+          delta[t] = f;
+        } else {
+          fail[delta[t]] = f;
+          queue.push_back(delta[t]);
+        }
+      }
+    }
+    TSDebug("stream-editor", "compiled %zu literals into %zu states", literals.size(), depth.size());
+  }
+
+  int
+  next(int state, char c) const
+  {
+    return delta[(state << 8) + fold[(unsigned char)c]];
+  }
+
+  /* the longest match that may be in progress in this state */
+  size_t
+  pending(int state) const
+  {
+    return depth[state];
+  }
+
+  const std::vector<size_t> &
+  matches(int state) const
+  {
+    return output[state];
+  }
+
+  const literal_t &
+  literal(size_t i) const
+  {
+    return literals[i];
+  }
+};
+
+struct ruleset_t {
+  rulelist_t rules;
+  literal_matcher literals;
+
+  void
+  compile()
+  {
+    size_t len;
+    bool icase;
+    for (size_t i = 0; i < rules.size(); ++i) {
+      const char *str = rules[i].literal(len, icase);
+      if (str) {
+        literals.add(i, str, len, icase);
+      }
+    }
+    literals.compile();
+  }
+};
+
+/* a literal match that has not been passed on yet */
+struct literal_hit_t {
+  int64_t start;
+  size_t literal;
+  literal_hit_t(int64_t s, size_t l) : start(s), literal(l) { ; }
+};
+
+/* The data not yet passed on: what we held back last time, followed by
+ * the block we are processing (unless that was appended to the former).
+ */
+struct window_t {
+  const char *held;
+  size_t held_len;
+  const char *block;
+  size_t block_len;
+  window_t(const char *h, size_t hl, const char *b, size_t bl) : held(h), held_len(hl), block(b), block_len(bl) { ; }
+
+  size_t
+  length() const
+  {
+    return held_len + block_len;
+  }
+
+  char operator[](size_t i) const { return i < held_len ? held[i] : block[i - held_len]; }
+};
 
 typedef struct contdata_t {
   TSCont cont;
   TSIOBuffer out_buf;
   TSIOBufferReader out_rd;
   TSVIO out_vio;
-  ruleset_t rules;
+  rulelist_t rules; /* regexp rules in scope */
+  const ruleset_t *ruleset;
+  const literal_matcher *literals; /* NULL if no literal rule is in scope */
+  std::vector<char> literal_in_scope;
+  std::vector<int64_t> next_start; /* per rule, where its next match may start */
+  std::vector<literal_hit_t> hits;
+  int state;
   std::string contbuf;
   size_t contbuf_sz;
   int64_t bytes_in;
   int64_t bytes_out;
   /* Use new/delete so destructor does cleanup for us */
-  contdata_t() : cont(NULL), out_buf(NULL), out_rd(NULL), out_vio(NULL), contbuf_sz(0), bytes_in(0), bytes_out(0) {}
+  contdata_t(const ruleset_t *r)
+    : cont(NULL), out_buf(NULL), out_rd(NULL), out_vio(NULL), ruleset(r), literals(NULL), state(0), contbuf_sz(0), bytes_in(0),
+      bytes_out(0)
+  {
+  }
   ~contdata_t()
   {
     if (out_rd)
@@ -579,84 +784,160 @@ typedef struct contdata_t {
     if (contbuf_sz < 2 * sz)
       contbuf_sz = 2 * sz - 1;
   }
+  void
+  add_literal_rule(size_t rule)
+  {
+    if (literals == NULL) {
+      literals = &ruleset->literals;
+      literal_in_scope.resize(ruleset->rules.size(), 0);
+      next_start.resize(ruleset->rules.size(), 0);
+    }
+    literal_in_scope[rule] = 1;
+  }
+  void
+  literal_matched(const window_t &window, size_t end, int state)
+  {
+    /* record the matches ending at offset end of the window, keeping
+     * each rule's matches from overlapping, like rule_t::apply does.
+     */
+    const std::vector<size_t> &matches = literals->matches(state);
+    for (size_t i = 0; i < matches.size(); ++i) {
+      const literal_matcher::literal_t &lit = literals->literal(matches[i]);
+      size_t len = lit.str.length();
+      int64_t start = bytes_in + end - len;
+
+      if (!literal_in_scope[lit.rule] || start < next_start[lit.rule])
+        continue;
+      if (!lit.icase) {
+        size_t j = 0;
+        while (j < len && window[end - len + j] == lit.str[j])
+          ++j;
+        if (j < len)
+          continue;
+      }
+      next_start[lit.rule] = start + len;
+      hits.push_back(literal_hit_t(start, matches[i]));
+    }
+  }
 } contdata_t;
 
+static void
+write_window(contdata_t *contdata, const window_t &window, size_t from, size_t to)
+{
+  size_t n;
+  if (from < window.held_len && from < to) {
+    n = TSIOBufferWrite(contdata->out_buf, window.held + from, std::min(to, window.held_len) - from);
+    assert(n > 0); // FIXME - handle error
+    contdata->bytes_out += n;
+    from += n;
+  }
+  if (from < to) {
+    n = TSIOBufferWrite(contdata->out_buf, window.block + from - window.held_len, to - from);
+    assert(n == to - from); // FIXME - handle error
+    contdata->bytes_out += n;
+  }
+}
+
 static int64_t
 process_block(contdata_t *contdata, TSIOBufferReader reader)
 {
-  int64_t nbytes, start;
+  int64_t nbytes = 0;
   size_t n = 0;
-  size_t buflen;
-  size_t keep;
-  const char *buf;
+  size_t keep = 0;
+  const char *buf = NULL;
   TSIOBufferBlock block;
 
-  if (reader == NULL) { // We're just flushing anything we have buffered
-    keep = 0;
-    buf = contdata->contbuf.c_str();
-    buflen = contdata->contbuf.length();
-    nbytes = 0;
-  } else {
+  if (reader != NULL) {
     block = TSIOBufferReaderStart(reader);
     buf = TSIOBufferBlockReadStart(block, reader, &nbytes);
+  } // else we're just flushing anything we have buffered
 
-    if (contdata->contbuf.empty()) {
-      /* Use the data as-is */
-      buflen = nbytes;
-    } else {
-      contdata->contbuf.append(buf, nbytes);
-      buf = contdata->contbuf.c_str();
-      buflen = contdata->contbuf.length();
+  /* regexps need all the data in one nul-terminated string */
+  bool contiguous = !contdata->rules.empty();
+  if (contiguous && nbytes > 0) {
+    contdata->contbuf.append(buf, nbytes);
+    buf = contdata->contbuf.c_str() + contdata->contbuf.length() - nbytes;
+  }
+  window_t window(contdata->contbuf.c_str(), contdata->contbuf.length(), buf, contiguous ? 0 : nbytes);
+  size_t buflen = window.length();
+
+  /* run the new data through the automaton, once for all literal rules */
+  if (contdata->literals) {
+    const literal_matcher *literals = contdata->literals;
+    size_t offset = buflen - nbytes;
+    int state = contdata->state;
+    for (int64_t i = 0; i < nbytes; ++i) {
+      state = literals->next(state, buf[i]);
+      if (!literals->matches(state).empty()) {
+        contdata->literal_matched(window, offset + i + 1, state);
+      }
     }
-    keep = contdata->contbuf_sz;
+    contdata->state = state;
+    /* hold back the start of any match still in progress */
+    keep = literals->pending(state);
+  }
+  if (reader == NULL) {
+    keep = 0;
+  } else {
+    keep = std::min(std::max(keep, contdata->contbuf_sz), buflen);
   }
-  size_t bytes_read = 0;
 
   editset_t edits;
 
+  for (size_t i = 0; i < contdata->hits.size(); ++i) {
+    const literal_hit_t &hit = contdata->hits[i];
+    const literal_matcher::literal_t &lit = contdata->literals->literal(hit.literal);
+    const rule_t &rule = contdata->ruleset->rules[lit.rule];
+    edit_t(hit.start - contdata->bytes_in, lit.str.length(), rule.replacement(), rule.prio()).saveto(edits);
+  }
+
   for (rule_p r = contdata->rules.begin(); r != contdata->rules.end(); ++r) {
-    r->apply(buf, buflen, edits);
+    r->apply(window.held, buflen, edits);
   }
 
-  for (edit_p p = edits.begin(); p != edits.end(); ++p) {
-    /* Preserve continuity buffer */
-    if (p->start >= buflen - keep)
+  /* Preserve continuity buffer, and any edit reaching into it */
+  size_t safe = buflen - keep;
+  for (edit_p p = edits.begin(); p != edits.end() && p->start < safe; ++p) {
+    if (p->start + p->bytes > safe) {
+      safe = p->start;
       break;
+    }
+  }
 
+  size_t bytes_read = 0;
+  for (edit_p p = edits.begin(); p != edits.end() && p->start < safe; ++p) {
     /* pass through bytes before edit */
-    start = p->start - bytes_read;
-
-    while (start > 0) {
-      // FIXME: would this be quicker if we managed a TSIOBuffer
-      //        so we could use TSIOBufferCopy ?
-      n = TSIOBufferWrite(contdata->out_buf, buf + bytes_read, start);
-      assert(n > 0); // FIXME - handle error
-      bytes_read += n;
-      contdata->bytes_out += n;
-      start -= n;
-    }
+    write_window(contdata, window, bytes_read, p->start);
 
     /* omit deleted bytes */
-    bytes_read += p->bytes;
+    bytes_read = p->start + p->bytes;
 
     /* insert replacement bytes */
     n = TSIOBufferWrite(contdata->out_buf, p->repl.c_str(), p->repl.length());
     assert(n == p->repl.length()); // FIXME (if this ever happens)!
     contdata->bytes_out += n;
-
-    /* increment counts  - done */
   }
-  contdata->bytes_in += bytes_read;
 
   /* data after the last edit */
-  if (bytes_read < buflen - keep) {
-    n = TSIOBufferWrite(contdata->out_buf, buf + bytes_read, buflen - bytes_read - keep);
-    contdata->bytes_in += n;
-    contdata->bytes_out += n;
-    bytes_read += n;
+  write_window(contdata, window, bytes_read, safe);
+  contdata->bytes_in += safe;
+
+  /* literal matches before that point have been applied or lost a conflict */
+  size_t kept = 0;
+  for (size_t i = 0; i < contdata->hits.size(); ++i) {
+    if (contdata->hits[i].start >= contdata->bytes_in) {
+      contdata->hits[kept++] = contdata->hits[i];
+    }
   }
+  contdata->hits.resize(kept, literal_hit_t(0, 0));
+
   /* reset buf to what we've not processed */
-  contdata->contbuf = buf + bytes_read;
+  if (safe < window.held_len) {
+    contdata->contbuf.erase(0, safe);
+    contdata->contbuf.append(window.block, window.block_len);
+  } else {
+    contdata->contbuf.assign(window.block + (safe - window.held_len), buflen - safe);
+  }
 
   return nbytes;
 }
@@ -763,13 +1044,20 @@ streamedit_setup(TSCont contp, TSEvent event, void *edata)
   assert((event == TS_EVENT_HTTP_READ_RESPONSE_HDR) || (event == TS_EVENT_HTTP_READ_REQUEST_HDR));
 
   /* make a new list comprising those rules that are in scope */
-  for (rule_p r = rules_in->begin(); r != rules_in->end(); ++r) {
-    if (r->in_scope(txn)) {
+  for (size_t i = 0; i < rules_in->rules.size(); ++i) {
+    const rule_t &r = rules_in->rules[i];
+    size_t len;
+    bool icase;
+    if (r.in_scope(txn)) {
       if (contdata == NULL) {
-        contdata = new contdata_t();
+        contdata = new contdata_t(rules_in);
+      }
+      if (r.literal(len, icase)) {
+        contdata->add_literal_rule(i);
+      } else {
+        contdata->rules.push_back(r);
+        contdata->set_cont_size(r.cont_size());
       }
-      contdata->rules.push_back(*r);
-      contdata->set_cont_size(r->cont_size());
     }
   }
 
@@ -809,12 +1097,12 @@ read_conf(const char *filename, ruleset_t *&in, ruleset_t *&out)
         if (in == NULL) {
           in = new ruleset_t();
         }
-        in->push_back(rule_t(buf));
+        in->rules.push_back(rule_t(buf));
       } else if (!strncasecmp(buf, "[out]", 5)) {
         if (out == NULL) {
           out = new ruleset_t();
         }
-        out->push_back(rule_t(buf));
+        out->rules.push_back(rule_t(buf));
       }
     } catch (...) {
       TSError("stream-editor: failed to parse rule %s", buf);
@@ -847,6 +1135,7 @@ TSPluginInit(int argc, const char *argv[])
 
   if (rewrites_in != NULL) {
     TSDebug("[stream-editor]", "initialising input filtering");
+    rewrites_in->compile();
     inputcont = TSContCreate(streamedit_setup, NULL);
     if (inputcont == NULL) {
       TSError("[stream-editor] failed to initialise input filtering!");
@@ -860,6 +1149,7 @@ TSPluginInit(int argc, const char *argv[])
 
   if (rewrites_out != NULL) {
     TSDebug("[stream-editor]", "initialising output filtering");
+    rewrites_out->compile();
     outputcont = TSContCreate(streamedit_setup, NULL);
     if (outputcont == NULL) {
       TSError("[stream-editor] failed to initialise output filtering!");
@@ -25,9 +25,6 @@
 
 #define TS_LUA_MAX_STATE_COUNT 256
 
-static uint64_t ts_lua_http_next_id = 0;
-static uint64_t ts_lua_g_http_next_id = 0;
-
 static ts_lua_main_ctx *ts_lua_main_ctx_array;
 static ts_lua_main_ctx *ts_lua_g_main_ctx_array;
 
@@ -46,6 +43,8 @@ TSRemapInit(TSRemapInterface *api_info, char *errbuf, int errbuf_size)
   if (ts_lua_main_ctx_array != NULL)
     return TS_SUCCESS;
 
+  ts_lua_bench_init();
+
   ts_lua_main_ctx_array = TSmalloc(sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
   memset(ts_lua_main_ctx_array, 0, sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
 
@@ -122,7 +121,7 @@ TSRemapStatus
 TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
 {
   int ret;
-  uint64_t req_id;
+  TSHRTime start = ts_lua_bench ? ts_lua_bench_now() : 0;
 
   TSCont contp;
   lua_State *L;
@@ -134,11 +133,10 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
   ts_lua_instance_conf *instance_conf;
 
   instance_conf = (ts_lua_instance_conf *)ih;
-  req_id = __sync_fetch_and_add(&ts_lua_http_next_id, 1);
 
-  main_ctx = &ts_lua_main_ctx_array[req_id % TS_LUA_MAX_STATE_COUNT];
+  main_ctx = ts_lua_get_main_ctx(ts_lua_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
 
-  TSMutexLock(main_ctx->mutexp);
+  ts_lua_main_ctx_enter(main_ctx);
 
   http_ctx = ts_lua_create_http_ctx(main_ctx, instance_conf);
 
@@ -161,7 +159,7 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
 
   lua_getglobal(L, TS_LUA_FUNCTION_REMAP);
   if (lua_type(L, -1) != LUA_TFUNCTION) {
-    TSMutexUnlock(main_ctx->mutexp);
+    ts_lua_main_ctx_leave(main_ctx);
     return TSREMAP_NO_REMAP;
   }
 
@@ -184,7 +182,11 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
     ts_lua_destroy_http_ctx(http_ctx);
   }
 
-  TSMutexUnlock(main_ctx->mutexp);
+  if (start) {
+    ts_lua_bench_account(main_ctx, start);
+  }
+
+  ts_lua_main_ctx_leave(main_ctx);
 
   return ret;
 }
@@ -199,7 +201,7 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   TSMLoc url_loc;
 
   int ret;
-  uint64_t req_id;
+  TSHRTime start = ts_lua_bench ? ts_lua_bench_now() : 0;
   TSCont txn_contp;
 
   lua_State *l;
@@ -210,12 +212,10 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
 
   ts_lua_instance_conf *conf = (ts_lua_instance_conf *)TSContDataGet(contp);
 
-  req_id = __sync_fetch_and_add(&ts_lua_g_http_next_id, 1);
+  main_ctx = ts_lua_get_main_ctx(ts_lua_g_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
 
-  main_ctx = &ts_lua_g_main_ctx_array[req_id % TS_LUA_MAX_STATE_COUNT];
-
-  TSDebug(TS_LUA_DEBUG_TAG, "[%s] req_id: %" PRId64, __FUNCTION__, req_id);
-  TSMutexLock(main_ctx->mutexp);
+  TSDebug(TS_LUA_DEBUG_TAG, "[%s] main_ctx: %p", __FUNCTION__, main_ctx);
+  ts_lua_main_ctx_enter(main_ctx);
 
   http_ctx = ts_lua_create_http_ctx(main_ctx, conf);
   http_ctx->txnp = txnp;
@@ -236,7 +236,7 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
 
   if (!http_ctx->client_request_hdrp) {
     ts_lua_destroy_http_ctx(http_ctx);
-    TSMutexUnlock(main_ctx->mutexp);
+    ts_lua_main_ctx_leave(main_ctx);
 
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     return 0;
@@ -302,7 +302,7 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
 
   default:
     ts_lua_destroy_http_ctx(http_ctx);
-    TSMutexUnlock(main_ctx->mutexp);
+    ts_lua_main_ctx_leave(main_ctx);
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     return 0;
   }
@@ -310,7 +310,7 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   if (lua_type(l, -1) != LUA_TFUNCTION) {
     lua_pop(l, 1);
     ts_lua_destroy_http_ctx(http_ctx);
-    TSMutexUnlock(main_ctx->mutexp);
+    ts_lua_main_ctx_leave(main_ctx);
 
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     return 0;
@@ -334,7 +334,11 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
     ts_lua_destroy_http_ctx(http_ctx);
   }
 
-  TSMutexUnlock(main_ctx->mutexp);
+  if (start) {
+    ts_lua_bench_account(main_ctx, start);
+  }
+
+  ts_lua_main_ctx_leave(main_ctx);
 
   if (ret) {
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_ERROR);
@@ -359,6 +363,7 @@ TSPluginInit(int argc, const char *argv[])
   }
 
   int ret = 0;
+  ts_lua_bench_init();
   ts_lua_g_main_ctx_array = TSmalloc(sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
   memset(ts_lua_g_main_ctx_array, 0, sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
 
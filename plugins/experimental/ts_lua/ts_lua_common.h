@@ -63,6 +63,7 @@
 
 
 #define TS_LUA_DEBUG_TAG "ts_lua"
+#define TS_LUA_BENCH_TAG "ts_lua_bench"
 
 #define TS_LUA_EVENT_COROUTINE_CONT 20000
 
@@ -16,8 +16,74 @@
   limitations under the License.
 */
 
+#include <sched.h>
+
 #include "ts_lua_coroutine.h"
 
+static __thread int ts_lua_thread_index = -1;
+static int ts_lua_next_thread_index = 0;
+
+int
+ts_lua_thread_self()
+{
+  if (ts_lua_thread_index < 0) {
+    ts_lua_thread_index = __sync_fetch_and_add(&ts_lua_next_thread_index, 1);
+  }
+
+  return ts_lua_thread_index;
+}
+
+/*
+ * A vm is owned by one thread, see ts_lua_get_main_ctx(), which enters it without taking the vm
+ * mutex. Other threads get in through the mutex, and then wait for the owner to leave. As the owner
+ * announces itself in in_use before it looks at foreign, and other threads announce themselves in
+ * foreign before they look at in_use, they cannot both miss each other. The owner falls back to the
+ * mutex while other threads are around, and nested entries of the owner get in right away.
+ */
+void
+ts_lua_main_ctx_enter(ts_lua_main_ctx *mctx)
+{
+  if (mctx->owner == ts_lua_thread_self()) {
+    if (mctx->in_use > 0) {
+      mctx->in_use++;
+      return;
+    }
+
+    __sync_add_and_fetch(&mctx->in_use, 1);
+
+    if (mctx->foreign == 0) {
+      return;
+    }
+
+    __sync_sub_and_fetch(&mctx->in_use, 1);
+    TSMutexLock(mctx->mutexp);
+    return;
+  }
+
+  __sync_add_and_fetch(&mctx->foreign, 1);
+  TSMutexLock(mctx->mutexp);
+
+  while (mctx->in_use > 0) {
+    sched_yield();
+  }
+}
+
+void
+ts_lua_main_ctx_leave(ts_lua_main_ctx *mctx)
+{
+  if (mctx->owner == ts_lua_thread_self()) {
+    if (mctx->in_use > 0) {
+      __sync_sub_and_fetch(&mctx->in_use, 1);
+    } else {
+      TSMutexUnlock(mctx->mutexp);
+    }
+    return;
+  }
+
+  TSMutexUnlock(mctx->mutexp);
+  __sync_sub_and_fetch(&mctx->foreign, 1);
+}
+
 static void
 ts_lua_async_push_item(ts_lua_async_item **head, ts_lua_async_item *node)
 {
@@ -70,6 +136,19 @@ ts_lua_async_create_item(TSCont cont, async_clean func, void *d, ts_lua_cont_inf
   return ai;
 }
 
+/* release everything but the coroutine itself */
+void
+ts_lua_reset_cont_info(ts_lua_cont_info *ci)
+{
+  ts_lua_async_destroy_chain(&ci->async_chain);
+  ci->async_chain = NULL;
+
+  if (ci->contp) {
+    TSContDestroy(ci->contp);
+    ci->contp = NULL;
+  }
+}
+
 void
 ts_lua_release_cont_info(ts_lua_cont_info *ci)
 {
@@ -79,15 +158,11 @@ ts_lua_release_cont_info(ts_lua_cont_info *ci)
   crt = &ci->routine;
   mctx = crt->mctx;
 
-  ts_lua_async_destroy_chain(&ci->async_chain);
-
-  if (ci->contp) {
-    TSContDestroy(ci->contp);
-  }
+  ts_lua_reset_cont_info(ci);
 
   if (crt->lua) {
-    TSMutexLock(mctx->mutexp);
+    ts_lua_main_ctx_enter(mctx);
     luaL_unref(crt->lua, LUA_REGISTRYINDEX, crt->ref);
-    TSMutexUnlock(mctx->mutexp);
+    ts_lua_main_ctx_leave(mctx);
   }
 }
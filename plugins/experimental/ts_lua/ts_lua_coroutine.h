@@ -32,8 +32,18 @@ typedef int (*async_clean)(struct async_item *item);
 /* main context*/
 typedef struct {
   lua_State *lua; // basic lua vm, injected
-  TSMutex mutexp; // mutex for lua vm
+  TSMutex mutexp; // mutex for lua vm, see ts_lua_main_ctx_enter()
   int gref;       // reference for lua vm self, in reg table
+
+  int owner;            // index of the thread owning the vm
+  volatile int in_use;  // nesting depth of the owner inside the vm without the mutex
+  volatile int foreign; // threads other than the owner inside or waiting for the vm
+
+  void **ctx_pool;    // recycled http contexts, which keep their lua_thread
+  int ctx_pool_count; // number of contexts in ctx_pool
+
+  int64_t bench_calls; // hook invocations timed, see ts_lua_bench_account()
+  TSHRTime bench_time; // total time spent in them
 } ts_lua_main_ctx;
 
 /* coroutine */
@@ -65,7 +75,12 @@ typedef struct async_item {
 } ts_lua_async_item;
 
 
+int ts_lua_thread_self();
+void ts_lua_main_ctx_enter(ts_lua_main_ctx *mctx);
+void ts_lua_main_ctx_leave(ts_lua_main_ctx *mctx);
+
 ts_lua_async_item *ts_lua_async_create_item(TSCont cont, async_clean func, void *d, ts_lua_cont_info *ci);
+void ts_lua_reset_cont_info(ts_lua_cont_info *ci);
 void ts_lua_release_cont_info(ts_lua_cont_info *ci);
 
 #endif
@@ -508,7 +508,7 @@ ts_lua_fetch_multi_handler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
 {
   int i;
   lua_State *L;
-  TSMutex lmutex;
+  ts_lua_main_ctx *mctx;
 
   ts_lua_async_item *ai;
   ts_lua_cont_info *ci;
@@ -522,7 +522,7 @@ ts_lua_fetch_multi_handler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   fi = (ts_lua_fetch_info *)edata;
 
   L = ai->cinfo->routine.lua;
-  lmutex = ai->cinfo->routine.mctx->mutexp;
+  mctx = ai->cinfo->routine.mctx;
 
   fmi->done++;
 
@@ -530,7 +530,7 @@ ts_lua_fetch_multi_handler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
     return 0;
 
   // all finish
-  TSMutexLock(lmutex);
+  ts_lua_main_ctx_enter(mctx);
 
   if (fmi->total == 1 && !fmi->multi) {
     ts_lua_fill_one_result(L, fi);
@@ -547,7 +547,7 @@ ts_lua_fetch_multi_handler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
     TSContCall(ci->contp, TS_LUA_EVENT_COROUTINE_CONT, (void *)1);
   }
 
-  TSMutexUnlock(lmutex);
+  ts_lua_main_ctx_leave(mctx);
   return 0;
 }
 
@@ -161,11 +161,11 @@ ts_lua_http_intercept_process(ts_lua_http_intercept_ctx *ictx, TSVConn conn)
   int n;
   TSCont contp;
   lua_State *L;
-  TSMutex mtxp;
+  ts_lua_main_ctx *mctx;
   ts_lua_cont_info *ci;
 
   ci = &ictx->cinfo;
-  mtxp = ictx->cinfo.routine.mctx->mutexp;
+  mctx = ictx->cinfo.routine.mctx;
 
   contp = TSContCreate(ts_lua_http_intercept_handler, TSMutexCreate());
   TSContDataSet(contp, ictx);
@@ -184,13 +184,13 @@ ts_lua_http_intercept_process(ts_lua_http_intercept_ctx *ictx, TSVConn conn)
   // invoke function here
   L = ci->routine.lua;
 
-  TSMutexLock(mtxp);
+  ts_lua_main_ctx_enter(mctx);
 
   n = lua_gettop(L);
 
   ts_lua_http_intercept_run_coroutine(ictx, n - 1);
 
-  TSMutexUnlock(mtxp);
+  ts_lua_main_ctx_leave(mctx);
 }
 
 static void
@@ -213,11 +213,11 @@ static int
 ts_lua_http_intercept_handler(TSCont contp, TSEvent event, void *edata)
 {
   int ret, n;
-  TSMutex mtxp;
+  ts_lua_main_ctx *mctx;
   ts_lua_http_intercept_ctx *ictx;
 
   ictx = (ts_lua_http_intercept_ctx *)TSContDataGet(contp);
-  mtxp = NULL;
+  mctx = NULL;
 
   if (edata == ictx->input.vio) {
     ret = ts_lua_http_intercept_process_read(event, ictx);
@@ -226,12 +226,12 @@ ts_lua_http_intercept_handler(TSCont contp, TSEvent event, void *edata)
     ret = ts_lua_http_intercept_process_write(event, ictx);
 
   } else {
-    mtxp = ictx->cinfo.routine.mctx->mutexp;
+    mctx = ictx->cinfo.routine.mctx;
     n = (intptr_t)edata;
 
-    TSMutexLock(mtxp);
+    ts_lua_main_ctx_enter(mctx);
     ret = ts_lua_http_intercept_run_coroutine(ictx, n);
-    TSMutexUnlock(mtxp);
+    ts_lua_main_ctx_leave(mctx);
   }
 
   if (ret || (ictx->send_complete && ictx->recv_complete)) {
@@ -175,7 +175,7 @@ ts_lua_schedule_handler(TSCont contp, TSEvent ev, void *edata)
 
   ret = 0;
 
-  TSMutexLock(main_ctx->mutexp);
+  ts_lua_main_ctx_enter(main_ctx);
   ts_lua_set_cont_info(L, ci);
 
   if (event == TS_LUA_EVENT_COROUTINE_CONT) {
@@ -189,7 +189,7 @@ ts_lua_schedule_handler(TSCont contp, TSEvent ev, void *edata)
   }
 
   if (ret == LUA_YIELD) {
-    TSMutexUnlock(main_ctx->mutexp);
+    ts_lua_main_ctx_leave(main_ctx);
     goto done;
   }
 
@@ -198,7 +198,7 @@ ts_lua_schedule_handler(TSCont contp, TSEvent ev, void *edata)
   }
 
   lua_pop(L, lua_gettop(L));
-  TSMutexUnlock(main_ctx->mutexp);
+  ts_lua_main_ctx_leave(main_ctx);
   ts_lua_destroy_async_ctx(actx);
 
 done:
@@ -78,12 +78,12 @@ ts_lua_transform_handler(TSCont contp, ts_lua_http_transform_ctx *transform_ctx,
   ts_lua_cont_info *ci;
 
   lua_State *L;
-  TSMutex mtxp;
+  ts_lua_main_ctx *mctx;
 
   ci = &transform_ctx->cinfo;
   crt = &ci->routine;
 
-  mtxp = crt->mctx->mutexp;
+  mctx = crt->mctx;
   L = crt->lua;
 
   output_conn = TSTransformOutputVConnGet(contp);
@@ -132,7 +132,7 @@ ts_lua_transform_handler(TSCont contp, ts_lua_http_transform_ctx *transform_ctx,
   write_down = 0;
   towrite = TSIOBufferReaderAvail(transform_ctx->reserved.reader);
 
-  TSMutexLock(mtxp);
+  ts_lua_main_ctx_enter(mctx);
   ts_lua_set_cont_info(L, ci);
 
   do {
@@ -174,7 +174,7 @@ ts_lua_transform_handler(TSCont contp, ts_lua_http_transform_ctx *transform_ctx,
 
     switch (rc) {
     case LUA_YIELD: // coroutine yield
-      TSMutexUnlock(mtxp);
+      ts_lua_main_ctx_leave(mctx);
       return 0;
 
     case 0: // coroutine success
@@ -220,7 +220,7 @@ ts_lua_transform_handler(TSCont contp, ts_lua_http_transform_ctx *transform_ctx,
 
   } while (towrite > 0);
 
-  TSMutexUnlock(mtxp);
+  ts_lua_main_ctx_leave(mctx);
 
   if (eos && !transform_ctx->output.vio)
     transform_ctx->output.vio = TSVConnWrite(output_conn, contp, transform_ctx->output.reader, 0);
@@ -17,6 +17,8 @@
 */
 
 
+#include <time.h>
+
 #include "ts_lua_util.h"
 #include "ts_lua_remap.h"
 #include "ts_lua_constant.h"
@@ -37,6 +39,17 @@
 #include "ts_lua_fetch.h"
 #include "ts_lua_http_intercept.h"
 
+#define TS_LUA_MAX_CTX_POOL_SIZE 32
+
+/* compiled script, shared by all the lua vms */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t size;
+} ts_lua_chunk;
+
+int ts_lua_bench = 0;
+
 static lua_State *ts_lua_new_state();
 static void ts_lua_init_registry(lua_State *L);
 static void ts_lua_init_globals(lua_State *L);
@@ -60,6 +73,9 @@ ts_lua_create_vm(ts_lua_main_ctx *arr, int n)
     arr[i].gref = luaL_ref(L, LUA_REGISTRYINDEX); /* L[REG][gref] = L[GLOBAL] */
     arr[i].lua = L;
     arr[i].mutexp = TSMutexCreate();
+    arr[i].owner = i;
+    arr[i].ctx_pool = TSmalloc(sizeof(void *) * TS_LUA_MAX_CTX_POOL_SIZE);
+    arr[i].ctx_pool_count = 0;
   }
 
   return 0;
@@ -75,11 +91,70 @@ ts_lua_destroy_vm(ts_lua_main_ctx *arr, int n)
     L = arr[i].lua;
     if (L)
       lua_close(L);
+
+    while (arr[i].ctx_pool_count > 0) {
+      TSfree(arr[i].ctx_pool[--arr[i].ctx_pool_count]);
+    }
+    TSfree(arr[i].ctx_pool);
   }
 
   return;
 }
 
+/*
+ * Each thread gets a lua vm of its own (as long as there are at least as many vms as threads), which
+ * it enters without locking, see ts_lua_main_ctx_enter(). Only the continuations of a transaction
+ * that resume on another thread have to take the vm mutex.
+ */
+ts_lua_main_ctx *
+ts_lua_get_main_ctx(ts_lua_main_ctx *arr, int n)
+{
+  return &arr[ts_lua_thread_self() % n];
+}
+
+static int
+ts_lua_bench_refresh(TSCont contp ATS_UNUSED, TSEvent event ATS_UNUSED, void *edata ATS_UNUSED)
+{
+  ts_lua_bench = TSIsDebugTagSet(TS_LUA_BENCH_TAG);
+  return 0;
+}
+
+/* the debug tags may only be set up after the plugin is loaded, or be changed later on, look again every second */
+void
+ts_lua_bench_init()
+{
+  static int started = 0;
+
+  if (!__sync_bool_compare_and_swap(&started, 0, 1)) {
+    return;
+  }
+
+  ts_lua_bench = TSIsDebugTagSet(TS_LUA_BENCH_TAG);
+  TSContScheduleEvery(TSContCreate(ts_lua_bench_refresh, TSMutexCreate()), 1000, TS_THREAD_POOL_TASK);
+}
+
+/* TShrtime() is only updated once per event loop iteration, too coarse to time a single hook */
+TSHRTime
+ts_lua_bench_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (TSHRTime)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* account one hook invocation that started at "start", called inside the vm */
+void
+ts_lua_bench_account(ts_lua_main_ctx *main_ctx, TSHRTime start)
+{
+  main_ctx->bench_time += ts_lua_bench_now() - start;
+
+  if (++main_ctx->bench_calls % 1000 == 0) {
+    TSDebug(TS_LUA_BENCH_TAG, "vm %p: %" PRId64 " hook invocations, %" PRId64 " ns per invocation", main_ctx,
+            main_ctx->bench_calls, main_ctx->bench_time / main_ctx->bench_calls);
+  }
+}
+
 lua_State *
 ts_lua_new_state()
 {
@@ -100,100 +175,143 @@ ts_lua_new_state()
   return L;
 }
 
-int
-ts_lua_add_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n, int argc, char *argv[], char *errbuf, int errbuf_size)
+static int
+ts_lua_chunk_writer(lua_State *L ATS_UNUSED, const void *p, size_t sz, void *ud)
 {
-  int i, ret;
+  ts_lua_chunk *chunk = (ts_lua_chunk *)ud;
+
+  if (chunk->len + sz > chunk->size) {
+    chunk->size = (chunk->len + sz) * 2;
+    chunk->buf = TSrealloc(chunk->buf, chunk->size);
+  }
+
+  memcpy(chunk->buf + chunk->len, p, sz);
+  chunk->len += sz;
+
+  return 0;
+}
+
+/*
+ * Load the script of conf into one vm. The script is only parsed for the first vm, and
+ * the other vms load the bytecode dumped from that.
+ */
+static int
+ts_lua_load_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *main_ctx, ts_lua_chunk *chunk, int argc, char *argv[],
+                   char *errbuf, int errbuf_size)
+{
+  int ret;
   int t;
   lua_State *L;
 
-  for (i = 0; i < n; i++) {
-    conf->_first = (i == 0) ? 1 : 0;
-    conf->_last = (i == n - 1) ? 1 : 0;
+  L = main_ctx->lua;
 
-    TSMutexLock(arr[i].mutexp);
+  lua_newtable(L);                                  /* new TB1 */
+  lua_pushvalue(L, -1);                             /* new TB2 */
+  lua_setfield(L, -2, "_G");                        /* TB1[_G] = TB2 empty table, we can change _G to xx */
+  lua_newtable(L);                                  /* new TB3 */
+  lua_rawgeti(L, LUA_REGISTRYINDEX, main_ctx->gref); /* push L[GLOBAL] */
+  lua_setfield(L, -2, "__index");                   /* TB3[__index] = L[GLOBAL] which has ts.xxx api */
+  lua_setmetatable(L, -2);                          /* TB1[META]  = TB3 */
+  lua_replace(L, LUA_GLOBALSINDEX);                 /* L[GLOBAL] = TB1 */
 
-    L = arr[i].lua;
+  ts_lua_set_instance_conf(L, conf);
 
-    lua_newtable(L);                                /* new TB1 */
-    lua_pushvalue(L, -1);                           /* new TB2 */
-    lua_setfield(L, -2, "_G");                      /* TB1[_G] = TB2 empty table, we can change _G to xx */
-    lua_newtable(L);                                /* new TB3 */
-    lua_rawgeti(L, LUA_REGISTRYINDEX, arr[i].gref); /* push L[GLOBAL] */
-    lua_setfield(L, -2, "__index");                 /* TB3[__index] = L[GLOBAL] which has ts.xxx api */
-    lua_setmetatable(L, -2);                        /* TB1[META]  = TB3 */
-    lua_replace(L, LUA_GLOBALSINDEX);               /* L[GLOBAL] = TB1 */
-
-    ts_lua_set_instance_conf(L, conf);
-
-    if (conf->content) {
-      if (luaL_loadstring(L, conf->content)) {
-        snprintf(errbuf, errbuf_size - 1, "[%s] luaL_loadstring %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
-        lua_pop(L, 1);
-        TSMutexUnlock(arr[i].mutexp);
-        return -1;
-      }
+  if (chunk->len) {
+    if (luaL_loadbuffer(L, chunk->buf, chunk->len, conf->script)) {
+      snprintf(errbuf, errbuf_size - 1, "[%s] luaL_loadbuffer %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
+      lua_pop(L, 1);
+      return -1;
+    }
 
-    } else if (strlen(conf->script)) {
-      if (luaL_loadfile(L, conf->script)) {
-        snprintf(errbuf, errbuf_size - 1, "[%s] luaL_loadfile %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
-        lua_pop(L, 1);
-        TSMutexUnlock(arr[i].mutexp);
-        return -1;
-      }
+  } else if (conf->content) {
+    if (luaL_loadstring(L, conf->content)) {
+      snprintf(errbuf, errbuf_size - 1, "[%s] luaL_loadstring %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
+      lua_pop(L, 1);
+      return -1;
     }
 
-    if (lua_pcall(L, 0, 0, 0)) {
-      snprintf(errbuf, errbuf_size - 1, "[%s] lua_pcall %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
+  } else if (strlen(conf->script)) {
+    if (luaL_loadfile(L, conf->script)) {
+      snprintf(errbuf, errbuf_size - 1, "[%s] luaL_loadfile %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
       lua_pop(L, 1);
-      TSMutexUnlock(arr[i].mutexp);
       return -1;
     }
+  }
 
-    /* call "__init__", to parse parameters */
-    lua_getglobal(L, "__init__");
+  if (!chunk->len && lua_isfunction(L, -1)) {
+    if (lua_dump(L, ts_lua_chunk_writer, chunk)) {
+      chunk->len = 0; /* just parse the script again for every vm */
+    }
+  }
 
-    if (lua_type(L, -1) == LUA_TFUNCTION) {
-      lua_newtable(L);
+  if (lua_pcall(L, 0, 0, 0)) {
+    snprintf(errbuf, errbuf_size - 1, "[%s] lua_pcall %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return -1;
+  }
 
-      for (t = 0; t < argc; t++) {
-        lua_pushnumber(L, t);
-        lua_pushstring(L, argv[t]);
-        lua_rawset(L, -3);
-      }
+  /* call "__init__", to parse parameters */
+  lua_getglobal(L, "__init__");
 
-      if (lua_pcall(L, 1, 1, 0)) {
-        snprintf(errbuf, errbuf_size - 1, "[%s] lua_pcall %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
-        lua_pop(L, 1);
-        TSMutexUnlock(arr[i].mutexp);
-        return -1;
-      }
+  if (lua_type(L, -1) == LUA_TFUNCTION) {
+    lua_newtable(L);
 
-      ret = lua_tonumber(L, -1);
+    for (t = 0; t < argc; t++) {
+      lua_pushnumber(L, t);
+      lua_pushstring(L, argv[t]);
+      lua_rawset(L, -3);
+    }
+
+    if (lua_pcall(L, 1, 1, 0)) {
+      snprintf(errbuf, errbuf_size - 1, "[%s] lua_pcall %s failed: %s", __FUNCTION__, conf->script, lua_tostring(L, -1));
       lua_pop(L, 1);
+      return -1;
+    }
 
-      if (ret) {
-        TSMutexUnlock(arr[i].mutexp);
-        return -1; /* script parse error */
-      }
+    ret = lua_tonumber(L, -1);
+    lua_pop(L, 1);
 
-    } else {
-      lua_pop(L, 1); /* pop nil */
+    if (ret) {
+      return -1; /* script parse error */
     }
 
-    lua_pushlightuserdata(L, conf);
-    lua_pushvalue(L, LUA_GLOBALSINDEX);
-    lua_rawset(L, LUA_REGISTRYINDEX); /* L[REG][conf] = L[GLOBAL] */
+  } else {
+    lua_pop(L, 1); /* pop nil */
+  }
 
-    lua_newtable(L);
-    lua_replace(L, LUA_GLOBALSINDEX); /* L[GLOBAL] = EMPTY */
+  lua_pushlightuserdata(L, conf);
+  lua_pushvalue(L, LUA_GLOBALSINDEX);
+  lua_rawset(L, LUA_REGISTRYINDEX); /* L[REG][conf] = L[GLOBAL] */
 
-    TSMutexUnlock(arr[i].mutexp);
-  }
+  lua_newtable(L);
+  lua_replace(L, LUA_GLOBALSINDEX); /* L[GLOBAL] = EMPTY */
 
   return 0;
 }
 
+int
+ts_lua_add_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n, int argc, char *argv[], char *errbuf, int errbuf_size)
+{
+  int i, ret;
+  ts_lua_chunk chunk;
+
+  memset(&chunk, 0, sizeof(chunk));
+  ret = 0;
+
+  for (i = 0; i < n && ret == 0; i++) {
+    conf->_first = (i == 0) ? 1 : 0;
+    conf->_last = (i == n - 1) ? 1 : 0;
+
+    ts_lua_main_ctx_enter(&arr[i]);
+    ret = ts_lua_load_module(conf, &arr[i], &chunk, argc, argv, errbuf, errbuf_size);
+    ts_lua_main_ctx_leave(&arr[i]);
+  }
+
+  TSfree(chunk.buf);
+
+  return ret;
+}
+
 int
 ts_lua_del_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n)
 {
@@ -201,7 +319,7 @@ ts_lua_del_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n)
   lua_State *L;
 
   for (i = 0; i < n; i++) {
-    TSMutexLock(arr[i].mutexp);
+    ts_lua_main_ctx_enter(&arr[i]);
 
     L = arr[i].lua;
 
@@ -228,7 +346,7 @@ ts_lua_del_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n)
     lua_newtable(L);
     lua_replace(L, LUA_GLOBALSINDEX); /* L[GLOBAL] = EMPTY  */
 
-    TSMutexUnlock(arr[i].mutexp);
+    ts_lua_main_ctx_leave(&arr[i]);
   }
 
   return 0;
@@ -411,12 +529,31 @@ ts_lua_create_http_ctx(ts_lua_main_ctx *main_ctx, ts_lua_instance_conf *conf)
 
   L = main_ctx->lua;
 
-  http_ctx = TSmalloc(sizeof(ts_lua_http_ctx));
-  memset(http_ctx, 0, sizeof(ts_lua_http_ctx));
+  if (main_ctx->ctx_pool_count > 0) {
+    // reuse a released context and its coroutine
+    ts_lua_coroutine routine;
 
-  // create coroutine for http_ctx
-  crt = &http_ctx->cinfo.routine;
-  l = lua_newthread(L);
+    http_ctx = main_ctx->ctx_pool[--main_ctx->ctx_pool_count];
+    routine = http_ctx->cinfo.routine;
+    memset(http_ctx, 0, sizeof(ts_lua_http_ctx));
+
+    crt = &http_ctx->cinfo.routine;
+    *crt = routine;
+    l = crt->lua;
+    lua_settop(l, 0);
+
+  } else {
+    http_ctx = TSmalloc(sizeof(ts_lua_http_ctx));
+    memset(http_ctx, 0, sizeof(ts_lua_http_ctx));
+
+    // create coroutine for http_ctx
+    crt = &http_ctx->cinfo.routine;
+    l = lua_newthread(L);
+
+    crt->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    crt->lua = l;
+    crt->mctx = main_ctx;
+  }
 
   lua_pushlightuserdata(L, conf);
   lua_rawget(L, LUA_REGISTRYINDEX);
@@ -432,11 +569,6 @@ ts_lua_create_http_ctx(ts_lua_main_ctx *main_ctx, ts_lua_instance_conf *conf)
 
   lua_replace(l, LUA_GLOBALSINDEX);
 
-  // init coroutine
-  crt->ref = luaL_ref(L, LUA_REGISTRYINDEX);
-  crt->lua = l;
-  crt->mctx = main_ctx;
-
   http_ctx->instance_conf = conf;
 
   ts_lua_set_http_ctx(l, http_ctx);
@@ -450,6 +582,7 @@ void
 ts_lua_destroy_http_ctx(ts_lua_http_ctx *http_ctx)
 {
   ts_lua_cont_info *ci;
+  ts_lua_main_ctx *main_ctx;
 
   ci = &http_ctx->cinfo;
 
@@ -481,6 +614,19 @@ ts_lua_destroy_http_ctx(ts_lua_http_ctx *http_ctx)
     TSMBufferDestroy(http_ctx->cached_response_bufp);
   }
 
+  // keep the context for the next transaction, unless its coroutine is suspended or dead
+  main_ctx = ci->routine.mctx;
+  ts_lua_main_ctx_enter(main_ctx);
+
+  if (main_ctx->ctx_pool_count < TS_LUA_MAX_CTX_POOL_SIZE && lua_status(ci->routine.lua) == 0) {
+    ts_lua_reset_cont_info(ci);
+    main_ctx->ctx_pool[main_ctx->ctx_pool_count++] = http_ctx;
+    ts_lua_main_ctx_leave(main_ctx);
+    return;
+  }
+
+  ts_lua_main_ctx_leave(main_ctx);
+
   ts_lua_release_cont_info(ci);
   TSfree(http_ctx);
 }
@@ -649,6 +795,7 @@ ts_lua_http_cont_handler(TSCont contp, TSEvent ev, void *edata)
   ts_lua_main_ctx *main_ctx;
   ts_lua_cont_info *ci;
   ts_lua_coroutine *crt;
+  TSHRTime start = ts_lua_bench ? ts_lua_bench_now() : 0;
 
   event = (int)ev;
   http_ctx = (ts_lua_http_ctx *)TSContDataGet(contp);
@@ -662,7 +809,7 @@ ts_lua_http_cont_handler(TSCont contp, TSEvent ev, void *edata)
 
   rc = ret = 0;
 
-  TSMutexLock(main_ctx->mutexp);
+  ts_lua_main_ctx_enter(main_ctx);
   ts_lua_set_cont_info(L, ci);
 
   switch (event) {
@@ -809,7 +956,11 @@ ts_lua_http_cont_handler(TSCont contp, TSEvent ev, void *edata)
     break;
   }
 
-  TSMutexUnlock(main_ctx->mutexp);
+  if (start) {
+    ts_lua_bench_account(main_ctx, start);
+  }
+
+  ts_lua_main_ctx_leave(main_ctx);
 
   if (rc == 0) {
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
@@ -22,9 +22,17 @@
 
 #include "ts_lua_common.h"
 
+/* time each hook invocation, and report the average with the ts_lua_bench debug tag */
+extern int ts_lua_bench;
+
 int ts_lua_create_vm(ts_lua_main_ctx *arr, int n);
 void ts_lua_destroy_vm(ts_lua_main_ctx *arr, int n);
 
+ts_lua_main_ctx *ts_lua_get_main_ctx(ts_lua_main_ctx *arr, int n);
+void ts_lua_bench_init();
+TSHRTime ts_lua_bench_now();
+void ts_lua_bench_account(ts_lua_main_ctx *main_ctx, TSHRTime start);
+
 int ts_lua_add_module(ts_lua_instance_conf *conf, ts_lua_main_ctx *arr, int n, int argc, char *argv[], char *errbuf,
                       int errbuf_len);
 
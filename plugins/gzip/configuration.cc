@@ -93,7 +93,8 @@ enum ParserState {
   kParseEnable,
   kParseCache,
   kParseDisallow,
-  kParseFlush
+  kParseFlush,
+  kParseSupportedAlgorithms
 };
 
 void
@@ -114,6 +115,30 @@ HostConfiguration::add_compressible_content_type(const std::string &content_type
   compressible_content_types_.push_back(content_type);
 }
 
+void
+HostConfiguration::set_compression_algorithms(const std::string &algorithms)
+{
+  vector<string> v = tokenize(algorithms, ispunct);
+
+  compression_algorithms_ = 0;
+  for (size_t i = 0; i < v.size(); i++) {
+    int type = accept_encoding_type(v[i].c_str(), v[i].size());
+    if (type) {
+      compression_algorithms_ |= type;
+    } else {
+      warning("compression algorithm \"%s\" is unknown or not supported by this build", v[i].c_str());
+    }
+  }
+
+  // the core reduces Accept-Encoding to gzip before the plugin sees it
+  TSMgmtInt normalize_ae_gzip = 0;
+  if ((compression_algorithms_ & ~COMPRESSION_TYPE_GZIP) &&
+      TSMgmtIntGet("proxy.config.http.normalize_ae_gzip", &normalize_ae_gzip) == TS_SUCCESS && normalize_ae_gzip) {
+    warning("proxy.config.http.normalize_ae_gzip is enabled, only gzip of \"%s\" is used unless a remap rule sets it to 0",
+            algorithms.c_str());
+  }
+}
+
 HostConfiguration *
 Configuration::Find(const char *host, int host_length)
 {
@@ -248,6 +273,8 @@ Configuration::Parse(const char *path)
           state = kParseDisallow;
         } else if (token == "flush") {
           state = kParseFlush;
+        } else if (token == "supported-algorithms") {
+          state = kParseSupportedAlgorithms;
         } else {
           warning("failed to interpret \"%s\" at line %zu", token.c_str(), lineno);
         }
@@ -276,6 +303,10 @@ Configuration::Parse(const char *path)
         current_host_configuration->set_flush(token == "true");
         state = kParseStart;
         break;
+      case kParseSupportedAlgorithms:
+        current_host_configuration->set_compression_algorithms(token);
+        state = kParseStart;
+        break;
       }
     }
   }
@@ -28,6 +28,7 @@
 #include <string>
 #include <vector>
 #include "debug_macros.h"
+#include "misc.h"
 
 namespace Gzip
 {
@@ -35,7 +36,12 @@ class HostConfiguration
 {
 public: // todo -> only configuration should be able to construct hostconfig
   explicit HostConfiguration(const std::string &host)
-    : host_(host), enabled_(true), cache_(true), remove_accept_encoding_(false), flush_(false)
+    : host_(host),
+      enabled_(true),
+      cache_(true),
+      remove_accept_encoding_(false),
+      flush_(false),
+      compression_algorithms_(COMPRESSION_TYPE_GZIP | COMPRESSION_TYPE_DEFLATE)
   {
   }
 
@@ -84,6 +90,12 @@ public: // todo -> only configuration should be able to construct hostconfig
   {
     return host_;
   }
+  inline int
+  compression_algorithms()
+  {
+    return compression_algorithms_;
+  }
+  void set_compression_algorithms(const std::string &algorithms);
   void add_disallow(const std::string &disallow);
   void add_compressible_content_type(const std::string &content_type);
   bool IsUrlAllowed(const char *url, int url_len);
@@ -95,6 +107,7 @@ private:
   bool cache_;
   bool remove_accept_encoding_;
   bool flush_;
+  int compression_algorithms_;
   std::vector<std::string> compressible_content_types_;
   std::vector<std::string> disallows_;
   DISALLOW_COPY_AND_ASSIGN(HostConfiguration);
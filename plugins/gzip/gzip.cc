@@ -47,8 +47,22 @@ using namespace Gzip;
 // 0-9 based scale that GZIP does where '1' is 'Best speed'
 // and '9' is 'Best compression'. Testing has proved level '6'
 // to be about the best level to use in an HTTP Server.
+//
+// That holds for responses that are compressed on every request. A
+// response that is stored in the cache is compressed once and served many
+// times, so it is worth spending more CPU to make it smaller.
 
 const int ZLIB_COMPRESSION_LEVEL = 6;
+const int ZLIB_CACHED_COMPRESSION_LEVEL = 9;
+#if HAVE_BROTLI_ENCODE_H
+const int BROTLI_COMPRESSION_LEVEL = 4;
+const int BROTLI_CACHED_COMPRESSION_LEVEL = 9;
+const int BROTLI_LGW = 22;
+#endif
+#if HAVE_ZSTD_H
+const int ZSTD_COMPRESSION_LEVEL = 3;
+const int ZSTD_CACHED_COMPRESSION_LEVEL = 15;
+#endif
 
 int arg_idx_hooked;
 int arg_idx_host_configuration;
@@ -60,7 +74,7 @@ Configuration *config = NULL;
 const char *dictionary = NULL;
 
 static GzipData *
-gzip_data_alloc(int compression_type)
+gzip_data_alloc(int compression_type, bool cached)
 {
   GzipData *data;
   int err;
@@ -70,6 +84,7 @@ gzip_data_alloc(int compression_type)
   data->downstream_buffer = NULL;
   data->downstream_reader = NULL;
   data->downstream_length = 0;
+  data->upstream_length = 0;
   data->state = transform_state_initialized;
   data->compression_type = compression_type;
   data->zstrm.next_in = Z_NULL;
@@ -82,20 +97,52 @@ gzip_data_alloc(int compression_type)
   data->zstrm.zfree = gzip_free;
   data->zstrm.opaque = (voidpf)0;
   data->zstrm.data_type = Z_ASCII;
+#if HAVE_BROTLI_ENCODE_H
+  data->bstrm = NULL;
+#endif
+#if HAVE_ZSTD_H
+  data->zcs = NULL;
+#endif
+
+  switch (compression_type) {
+#if HAVE_BROTLI_ENCODE_H
+  case COMPRESSION_TYPE_BROTLI:
+    data->bstrm = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!data->bstrm) {
+      fatal("gzip-transform: ERROR: BrotliEncoderCreateInstance failed!");
+    }
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_QUALITY,
+                              cached ? BROTLI_CACHED_COMPRESSION_LEVEL : BROTLI_COMPRESSION_LEVEL);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_LGWIN, BROTLI_LGW);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    break;
+#endif
+#if HAVE_ZSTD_H
+  case COMPRESSION_TYPE_ZSTD:
+    data->zcs = ZSTD_createCStream();
+    if (!data->zcs) {
+      fatal("gzip-transform: ERROR: ZSTD_createCStream failed!");
+    }
+    ZSTD_CCtx_setParameter(data->zcs, ZSTD_c_compressionLevel, cached ? ZSTD_CACHED_COMPRESSION_LEVEL : ZSTD_COMPRESSION_LEVEL);
+    break;
+#endif
+  default: {
+    int window_bits = (compression_type == COMPRESSION_TYPE_GZIP) ? WINDOW_BITS_GZIP : WINDOW_BITS_DEFLATE;
+    int level = cached ? ZLIB_CACHED_COMPRESSION_LEVEL : ZLIB_COMPRESSION_LEVEL;
 
-  int window_bits = (compression_type == COMPRESSION_TYPE_GZIP) ? WINDOW_BITS_GZIP : WINDOW_BITS_DEFLATE;
-
-  err = deflateInit2(&data->zstrm, ZLIB_COMPRESSION_LEVEL, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
-
-  if (err != Z_OK) {
-    fatal("gzip-transform: ERROR: deflateInit (%d)!", err);
-  }
+    err = deflateInit2(&data->zstrm, level, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
 
-  if (dictionary) {
-    err = deflateSetDictionary(&data->zstrm, (const Bytef *)dictionary, strlen(dictionary));
     if (err != Z_OK) {
-      fatal("gzip-transform: ERROR: deflateSetDictionary (%d)!", err);
+      fatal("gzip-transform: ERROR: deflateInit (%d)!", err);
+    }
+
+    if (dictionary) {
+      err = deflateSetDictionary(&data->zstrm, (const Bytef *)dictionary, strlen(dictionary));
+      if (err != Z_OK) {
+        fatal("gzip-transform: ERROR: deflateSetDictionary (%d)!", err);
+      }
     }
+  } break;
   }
 
   return data;
@@ -107,9 +154,23 @@ gzip_data_destroy(GzipData *data)
 {
   TSReleaseAssert(data);
 
-  // deflateEnd returnvalue ignore is intentional
-  // it would spew log on every client abort
-  deflateEnd(&data->zstrm);
+  switch (data->compression_type) {
+#if HAVE_BROTLI_ENCODE_H
+  case COMPRESSION_TYPE_BROTLI:
+    BrotliEncoderDestroyInstance(data->bstrm);
+    break;
+#endif
+#if HAVE_ZSTD_H
+  case COMPRESSION_TYPE_ZSTD:
+    ZSTD_freeCStream(data->zcs);
+    break;
+#endif
+  default:
+    // deflateEnd returnvalue ignore is intentional
+    // it would spew log on every client abort
+    deflateEnd(&data->zstrm);
+    break;
+  }
 
   if (data->downstream_buffer) {
     TSIOBufferDestroy(data->downstream_buffer);
@@ -127,11 +188,8 @@ gzip_content_encoding_header(TSMBuffer bufp, TSMLoc hdr_loc, const int compressi
   // Delete Content-Encoding if present???
 
   if ((ret = TSMimeHdrFieldCreateNamed(bufp, hdr_loc, "Content-Encoding", sizeof("Content-Encoding") - 1, &ce_loc)) == TS_SUCCESS) {
-    if (compression_type == COMPRESSION_TYPE_DEFLATE) {
-      ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "deflate", sizeof("deflate") - 1);
-    } else if (compression_type == COMPRESSION_TYPE_GZIP) {
-      ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "gzip", sizeof("gzip") - 1);
-    }
+    const char *name = compression_type_name(compression_type);
+    ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, name, strlen(name));
     if (ret == TS_SUCCESS) {
       ret = TSMimeHdrFieldAppend(bufp, hdr_loc, ce_loc);
     }
@@ -189,7 +247,7 @@ gzip_vary_header(TSMBuffer bufp, TSMLoc hdr_loc)
 // FIXME: the etag alteration isn't proper. it should modify the value inside quotes
 //       specify a very header..
 static TSReturnCode
-gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc)
+gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc, const int compression_type)
 {
   TSReturnCode ret = TS_SUCCESS;
   TSMLoc ce_loc;
@@ -207,7 +265,14 @@ gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc)
         changetag = 0;
       }
       if (changetag) {
-        ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-df", 3);
+        // every encoding is its own alternate, so it needs its own etag
+        if (compression_type == COMPRESSION_TYPE_BROTLI) {
+          ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-br", 3);
+        } else if (compression_type == COMPRESSION_TYPE_ZSTD) {
+          ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-zs", 3);
+        } else {
+          ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-df", 3);
+        }
       }
     }
     TSHandleMLocRelease(bufp, hdr_loc, ce_loc);
@@ -239,7 +304,7 @@ gzip_transform_init(TSCont contp, GzipData *data)
   }
 
   if (gzip_content_encoding_header(bufp, hdr_loc, data->compression_type) == TS_SUCCESS &&
-      gzip_vary_header(bufp, hdr_loc) == TS_SUCCESS && gzip_etag_header(bufp, hdr_loc) == TS_SUCCESS) {
+      gzip_vary_header(bufp, hdr_loc) == TS_SUCCESS && gzip_etag_header(bufp, hdr_loc, data->compression_type) == TS_SUCCESS) {
     downstream_conn = TSTransformOutputVConnGet(contp);
     data->downstream_buffer = TSIOBufferCreate();
     data->downstream_reader = TSIOBufferReaderAlloc(data->downstream_buffer);
@@ -251,25 +316,119 @@ gzip_transform_init(TSCont contp, GzipData *data)
 
 
 static void
-gzip_transform_one(GzipData *data, TSIOBufferReader upstream_reader, int amount)
+deflate_transform_one(GzipData *data, const char *upstream_buffer, int64_t upstream_length, int flush)
 {
   TSIOBufferBlock downstream_blkp;
-  const char *upstream_buffer;
   char *downstream_buffer;
-  int64_t upstream_length, downstream_length;
+  int64_t downstream_length;
   int err;
 
+  data->zstrm.next_in = (unsigned char *)upstream_buffer;
+  data->zstrm.avail_in = upstream_length;
+
+  while (data->zstrm.avail_in > 0) {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+    downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
+
+    data->zstrm.next_out = (unsigned char *)downstream_buffer;
+    data->zstrm.avail_out = downstream_length;
+
+    err = deflate(&data->zstrm, flush);
+
+    if (err != Z_OK)
+      warning("deflate() call failed: %d", err);
+
+    if (downstream_length > data->zstrm.avail_out) {
+      TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
+      data->downstream_length += (downstream_length - data->zstrm.avail_out);
+    }
+
+    if (data->zstrm.avail_out > 0) {
+      if (data->zstrm.avail_in != 0) {
+        error("gzip-transform: ERROR: avail_in is (%d): should be 0", data->zstrm.avail_in);
+      }
+    }
+  }
+}
+
+#if HAVE_BROTLI_ENCODE_H
+static void
+brotli_transform_one(GzipData *data, const char *upstream_buffer, int64_t upstream_length, BrotliEncoderOperation op)
+{
+  TSIOBufferBlock downstream_blkp;
+  const uint8_t *next_in = (const uint8_t *)upstream_buffer;
+  size_t avail_in = upstream_length;
+  uint8_t *next_out;
+  size_t avail_out;
+  int64_t downstream_length;
+
+  do {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+    next_out = (uint8_t *)TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
+    avail_out = downstream_length;
+
+    if (!BrotliEncoderCompressStream(data->bstrm, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) {
+      error("BrotliEncoderCompressStream() call failed");
+      return;
+    }
+
+    if (downstream_length > (int64_t)avail_out) {
+      TSIOBufferProduce(data->downstream_buffer, downstream_length - avail_out);
+      data->downstream_length += (downstream_length - avail_out);
+    }
+  } while (avail_in > 0 || BrotliEncoderHasMoreOutput(data->bstrm) ||
+           (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(data->bstrm)));
+}
+#endif
+
+#if HAVE_ZSTD_H
+static void
+zstd_transform_one(GzipData *data, const char *upstream_buffer, int64_t upstream_length, ZSTD_EndDirective mode)
+{
+  TSIOBufferBlock downstream_blkp;
+  ZSTD_inBuffer in = {upstream_buffer, (size_t)upstream_length, 0};
+  ZSTD_outBuffer out;
+  int64_t downstream_length;
+  size_t remaining;
+
+  do {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+    out.dst = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
+    out.size = downstream_length;
+    out.pos = 0;
+
+    remaining = ZSTD_compressStream2(data->zcs, &out, &in, mode);
+    if (ZSTD_isError(remaining)) {
+      error("ZSTD_compressStream2() call failed: %s", ZSTD_getErrorName(remaining));
+      return;
+    }
+
+    if (out.pos > 0) {
+      TSIOBufferProduce(data->downstream_buffer, out.pos);
+      data->downstream_length += out.pos;
+    }
+  } while (in.pos < in.size || (mode != ZSTD_e_continue && remaining > 0));
+}
+#endif
+
+static void
+gzip_transform_one(GzipData *data, TSIOBufferReader upstream_reader, int amount)
+{
+  TSIOBufferBlock upstream_blkp;
+  const char *upstream_buffer;
+  int64_t upstream_length;
+
   TSHttpTxn txnp = (TSHttpTxn)data->txn;
   HostConfiguration *hc = (HostConfiguration *)TSHttpTxnArgGet(txnp, arg_idx_host_configuration);
 
   while (amount > 0) {
-    downstream_blkp = TSIOBufferReaderStart(upstream_reader);
-    if (!downstream_blkp) {
+    upstream_blkp = TSIOBufferReaderStart(upstream_reader);
+    if (!upstream_blkp) {
       error("couldn't get from IOBufferBlock");
       return;
     }
 
-    upstream_buffer = TSIOBufferBlockReadStart(downstream_blkp, upstream_reader, &upstream_length);
+    upstream_buffer = TSIOBufferBlockReadStart(upstream_blkp, upstream_reader, &upstream_length);
     if (!upstream_buffer) {
       error("couldn't get from TSIOBufferBlockReadStart");
       return;
@@ -279,84 +438,94 @@ gzip_transform_one(GzipData *data, TSIOBufferReader upstream_reader, int amount)
       upstream_length = amount;
     }
 
-    data->zstrm.next_in = (unsigned char *)upstream_buffer;
-    data->zstrm.avail_in = upstream_length;
-
-    while (data->zstrm.avail_in > 0) {
-      downstream_blkp = TSIOBufferStart(data->downstream_buffer);
-      downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
-
-      data->zstrm.next_out = (unsigned char *)downstream_buffer;
-      data->zstrm.avail_out = downstream_length;
-
+    switch (data->compression_type) {
+#if HAVE_BROTLI_ENCODE_H
+    case COMPRESSION_TYPE_BROTLI:
+      brotli_transform_one(data, upstream_buffer, upstream_length, hc->flush() ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS);
+      break;
+#endif
+#if HAVE_ZSTD_H
+    case COMPRESSION_TYPE_ZSTD:
+      zstd_transform_one(data, upstream_buffer, upstream_length, hc->flush() ? ZSTD_e_flush : ZSTD_e_continue);
+      break;
+#endif
+    default:
       if (!hc->flush()) {
         debug("gzip_transform: deflate with Z_NO_FLUSH");
-        err = deflate(&data->zstrm, Z_NO_FLUSH);
+        deflate_transform_one(data, upstream_buffer, upstream_length, Z_NO_FLUSH);
       } else {
         debug("gzip_transform: deflate with Z_SYNC_FLUSH");
-        err = deflate(&data->zstrm, Z_SYNC_FLUSH);
-      }
-
-      if (err != Z_OK)
-        warning("deflate() call failed: %d", err);
-
-      if (downstream_length > data->zstrm.avail_out) {
-        TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
-        data->downstream_length += (downstream_length - data->zstrm.avail_out);
-      }
-
-      if (data->zstrm.avail_out > 0) {
-        if (data->zstrm.avail_in != 0) {
-          error("gzip-transform: ERROR: avail_in is (%d): should be 0", data->zstrm.avail_in);
-        }
+        deflate_transform_one(data, upstream_buffer, upstream_length, Z_SYNC_FLUSH);
       }
+      break;
     }
 
+    data->upstream_length += upstream_length;
     TSIOBufferReaderConsume(upstream_reader, upstream_length);
     amount -= upstream_length;
   }
 }
 
 static void
-gzip_transform_finish(GzipData *data)
+deflate_transform_finish(GzipData *data)
 {
-  if (data->state == transform_state_output) {
-    TSIOBufferBlock downstream_blkp;
-    char *downstream_buffer;
-    int64_t downstream_length;
-    int err;
-
-    data->state = transform_state_finished;
+  TSIOBufferBlock downstream_blkp;
+  char *downstream_buffer;
+  int64_t downstream_length;
+  int err;
 
-    for (;;) {
-      downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+  for (;;) {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
 
-      downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
-      data->zstrm.next_out = (unsigned char *)downstream_buffer;
-      data->zstrm.avail_out = downstream_length;
+    downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
+    data->zstrm.next_out = (unsigned char *)downstream_buffer;
+    data->zstrm.avail_out = downstream_length;
 
-      err = deflate(&data->zstrm, Z_FINISH);
+    err = deflate(&data->zstrm, Z_FINISH);
 
-      if (downstream_length > (int64_t)data->zstrm.avail_out) {
-        TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
-        data->downstream_length += (downstream_length - data->zstrm.avail_out);
-      }
+    if (downstream_length > (int64_t)data->zstrm.avail_out) {
+      TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
+      data->downstream_length += (downstream_length - data->zstrm.avail_out);
+    }
 
-      if (err == Z_OK) { /* some more data to encode */
-        continue;
-      }
+    if (err == Z_OK) { /* some more data to encode */
+      continue;
+    }
 
-      if (err != Z_STREAM_END) {
-        warning("deflate should report Z_STREAM_END");
-      }
-      break;
+    if (err != Z_STREAM_END) {
+      warning("deflate should report Z_STREAM_END");
     }
+    break;
+  }
+
+  if (data->downstream_length != (int64_t)(data->zstrm.total_out)) {
+    error("gzip-transform: ERROR: output lengths don't match (%d, %ld)", data->downstream_length, data->zstrm.total_out);
+  }
+}
 
-    if (data->downstream_length != (int64_t)(data->zstrm.total_out)) {
-      error("gzip-transform: ERROR: output lengths don't match (%d, %ld)", data->downstream_length, data->zstrm.total_out);
+static void
+gzip_transform_finish(GzipData *data)
+{
+  if (data->state == transform_state_output) {
+    data->state = transform_state_finished;
+
+    switch (data->compression_type) {
+#if HAVE_BROTLI_ENCODE_H
+    case COMPRESSION_TYPE_BROTLI:
+      brotli_transform_one(data, NULL, 0, BROTLI_OPERATION_FINISH);
+      break;
+#endif
+#if HAVE_ZSTD_H
+    case COMPRESSION_TYPE_ZSTD:
+      zstd_transform_one(data, NULL, 0, ZSTD_e_end);
+      break;
+#endif
+    default:
+      deflate_transform_finish(data);
+      break;
     }
 
-    gzip_log_ratio(data->zstrm.total_in, data->downstream_length);
+    gzip_log_ratio(data->upstream_length, data->downstream_length);
   }
 }
 
@@ -503,28 +672,21 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration *host_configura
 
   cfield = TSMimeHdrFieldFind(cbuf, chdr, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
   if (cfield != TS_NULL_MLOC) {
-    compression_acceptable = 0;
+    int accepted = 0;
     nvalues = TSMimeHdrFieldValuesCount(cbuf, chdr, cfield);
     for (i = 0; i < nvalues; i++) {
       value = TSMimeHdrFieldValueStringGet(cbuf, chdr, cfield, i, &len);
       if (!value) {
         continue;
       }
-
-      if (strncasecmp(value, "deflate", sizeof("deflate") - 1) == 0) {
-        compression_acceptable = 1;
-        *compress_type = COMPRESSION_TYPE_DEFLATE;
-        break;
-      } else if (strncasecmp(value, "gzip", sizeof("gzip") - 1) == 0) {
-        compression_acceptable = 1;
-        *compress_type = COMPRESSION_TYPE_GZIP;
-        break;
-      }
+      accepted |= accept_encoding_type(value, len);
     }
 
     TSHandleMLocRelease(cbuf, chdr, cfield);
     TSHandleMLocRelease(cbuf, TS_NULL_MLOC, chdr);
 
+    *compress_type = preferred_compression_type(accepted & host_configuration->compression_algorithms());
+    compression_acceptable = *compress_type != 0;
     if (!compression_acceptable) {
       info("no acceptable encoding found in request header, not compressible");
       return 0;
@@ -574,7 +736,7 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration *host_configura
 
 
 static void
-gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguration *hc, int compress_type)
+gzip_transform_add(TSHttpTxn txnp, int server, HostConfiguration *hc, int compress_type)
 {
   int *tmp = (int *)TSHttpTxnArgGet(txnp, arg_idx_hooked);
   if (tmp) {
@@ -594,11 +756,15 @@ gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguratio
     TSHttpTxnTransformedRespCache(txnp, 1);
   }
 
+  // compress harder if the result goes into the cache, to be served many times
+  bool cached = hc->cache() && (!server || TSHttpTxnIsCacheable(txnp, NULL, NULL));
+  debug("compressing with %s at the %s level", compression_type_name(compress_type), cached ? "cached" : "streaming");
+
   TSVConn connp;
   GzipData *data;
 
   connp = TSTransformCreate(gzip_transform, txnp);
-  data = gzip_data_alloc(compress_type);
+  data = gzip_data_alloc(compress_type, cached);
   data->txn = txnp;
 
   TSContDataSet(connp, data);
@@ -648,7 +814,7 @@ static int
 transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
 {
   TSHttpTxn txnp = (TSHttpTxn)edata;
-  int compress_type = COMPRESSION_TYPE_DEFLATE;
+  int compress_type = 0;
 
   switch (event) {
   case TS_EVENT_HTTP_READ_REQUEST_HDR: {
@@ -666,7 +832,7 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
         TSHttpTxnArgSet(txnp, arg_idx_url_disallowed, (void *)&GZIP_ONE);
         info("url [%.*s] not allowed", url_len, url);
       } else {
-        normalize_accept_encoding(txnp, req_buf, req_loc);
+        normalize_accept_encoding(txnp, req_buf, req_loc, hc->compression_algorithms());
       }
       TSfree(url);
       TSHandleMLocRelease(req_buf, TS_NULL_MLOC, req_loc);
@@ -27,6 +27,7 @@
 #include "misc.h"
 #include <string.h>
 #include <inttypes.h>
+#include <algorithm>
 #include "debug_macros.h"
 
 voidpf
@@ -41,33 +42,101 @@ gzip_free(voidpf /* opaque ATS_UNUSED */, voidpf address)
   TSfree(address);
 }
 
+// Map one Accept-Encoding value (e.g. "gzip;q=0.8") to its compression type, 0 if we
+// can't produce it or the client refuses it with q=0.
+int
+accept_encoding_type(const char *value, int len)
+{
+  const char *params = (const char *)memchr(value, ';', len);
+  int token_len = params ? params - value : len;
+  int type = 0;
+
+  while (token_len > 0 && value[token_len - 1] == ' ')
+    --token_len;
+
+  if (token_len == (int)strlen("gzip") && !strncasecmp(value, "gzip", token_len))
+    type = COMPRESSION_TYPE_GZIP;
+  else if (token_len == (int)strlen("deflate") && !strncasecmp(value, "deflate", token_len))
+    type = COMPRESSION_TYPE_DEFLATE;
+#if HAVE_BROTLI_ENCODE_H
+  else if (token_len == (int)strlen("br") && !strncasecmp(value, "br", token_len))
+    type = COMPRESSION_TYPE_BROTLI;
+#endif
+#if HAVE_ZSTD_H
+  else if (token_len == (int)strlen("zstd") && !strncasecmp(value, "zstd", token_len))
+    type = COMPRESSION_TYPE_ZSTD;
+#endif
+
+  if (type && params) {
+    const char *end = value + len;
+    for (const char *p = params + 1; p + 1 < end; ++p) {
+      if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+        char qvalue[8];
+        int n = std::min((int)(end - p - 2), (int)sizeof(qvalue) - 1);
+        memcpy(qvalue, p + 2, n);
+        qvalue[n] = '\0';
+        if (qvalue[0] == '0' && atof(qvalue) == 0.0)
+          return 0; // q=0 means the client refuses this encoding
+        break;
+      }
+    }
+  }
+
+  return type;
+}
+
+// Of a set of compression types, the one that yields the smallest responses.
+int
+preferred_compression_type(int types)
+{
+  if (types & COMPRESSION_TYPE_BROTLI)
+    return COMPRESSION_TYPE_BROTLI;
+  if (types & COMPRESSION_TYPE_ZSTD)
+    return COMPRESSION_TYPE_ZSTD;
+  if (types & COMPRESSION_TYPE_GZIP)
+    return COMPRESSION_TYPE_GZIP;
+  if (types & COMPRESSION_TYPE_DEFLATE)
+    return COMPRESSION_TYPE_DEFLATE;
+  return 0;
+}
+
+// The Content-Encoding / Accept-Encoding token of a compression type.
+const char *
+compression_type_name(int compression_type)
+{
+  switch (compression_type) {
+  case COMPRESSION_TYPE_DEFLATE:
+    return "deflate";
+  case COMPRESSION_TYPE_GZIP:
+    return "gzip";
+  case COMPRESSION_TYPE_BROTLI:
+    return "br";
+  case COMPRESSION_TYPE_ZSTD:
+    return "zstd";
+  }
+  return NULL;
+}
+
 void
-normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc)
+normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc, int algorithms)
 {
   TSMLoc field = TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
-  int deflate = 0;
-  int gzip = 0;
+  int accepted = 0;
 
   // remove the accept encoding field(s),
-  // while finding out if gzip or deflate is supported.
+  // while finding out which of the encodings we support are accepted.
   while (field) {
     TSMLoc tmp;
+    int value_count = TSMimeHdrFieldValuesCount(reqp, hdr_loc, field);
 
-    if (!deflate && !gzip) {
-      int value_count = TSMimeHdrFieldValuesCount(reqp, hdr_loc, field);
-
-      while (value_count > 0) {
-        int val_len = 0;
-        const char *val;
+    while (value_count > 0) {
+      int val_len = 0;
+      const char *val;
 
-        --value_count;
-        val = TSMimeHdrFieldValueStringGet(reqp, hdr_loc, field, value_count, &val_len);
-
-        if (val_len == (int)strlen("gzip"))
-          gzip = !strncmp(val, "gzip", val_len);
-        else if (val_len == (int)strlen("deflate"))
-          deflate = !strncmp(val, "deflate", val_len);
-      }
+      --value_count;
+      val = TSMimeHdrFieldValueStringGet(reqp, hdr_loc, field, value_count, &val_len);
+      if (val)
+        accepted |= accept_encoding_type(val, val_len);
     }
 
     tmp = TSMimeHdrFieldNextDup(reqp, hdr_loc, field);
@@ -76,19 +145,14 @@ normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLo
     field = tmp;
   }
 
-  // append a new accept-encoding field in the header
-  if (deflate || gzip) {
+  // append a new accept-encoding field in the header, with just the one encoding we will use. This
+  // keeps the number of alternates down to one per encoding.
+  const char *name = compression_type_name(preferred_compression_type(accepted & algorithms));
+  if (name) {
     TSMimeHdrFieldCreate(reqp, hdr_loc, &field);
     TSMimeHdrFieldNameSet(reqp, hdr_loc, field, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
-
-    if (gzip) {
-      TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "gzip", strlen("gzip"));
-      info("normalized accept encoding to gzip");
-    } else if (deflate) {
-      TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "deflate", strlen("deflate"));
-      info("normalized accept encoding to deflate");
-    }
-
+    TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, name, strlen(name));
+    info("normalized accept encoding to %s", name);
     TSMimeHdrFieldAppend(reqp, hdr_loc, field);
     TSHandleMLocRelease(reqp, hdr_loc, field);
   }
@@ -26,8 +26,15 @@
 
 #include <zlib.h>
 #include <ts/ts.h>
+#include "ts/ink_defs.h"
 #include <stdlib.h> //exit()
 #include <stdio.h>
+#if HAVE_BROTLI_ENCODE_H
+#include <brotli/encode.h>
+#endif
+#if HAVE_ZSTD_H
+#include <zstd.h>
+#endif
 
 // zlib stuff, see [deflateInit2] at http://www.zlib.net/manual.html
 static const int ZLIB_MEMLEVEL = 9; // min=1 (optimize for memory),max=9 (optimized for speed)
@@ -35,8 +42,11 @@ static const int WINDOW_BITS_DEFLATE = -15;
 static const int WINDOW_BITS_GZIP = 31;
 
 // misc
+// the compression types are bits, so a set of them can describe the supported algorithms
 static const int COMPRESSION_TYPE_DEFLATE = 1;
 static const int COMPRESSION_TYPE_GZIP = 2;
+static const int COMPRESSION_TYPE_BROTLI = 4;
+static const int COMPRESSION_TYPE_ZSTD = 8;
 // this one is just for txnargset/get to point to
 static const int GZIP_ONE = 1;
 static const int DICT_PATH_MAX = 512;
@@ -59,7 +69,14 @@ typedef struct {
   TSIOBuffer downstream_buffer;
   TSIOBufferReader downstream_reader;
   int downstream_length;
+  int64_t upstream_length;
   z_stream zstrm;
+#if HAVE_BROTLI_ENCODE_H
+  BrotliEncoderState *bstrm;
+#endif
+#if HAVE_ZSTD_H
+  ZSTD_CStream *zcs;
+#endif
   enum transform_state state;
   int compression_type;
 } GzipData;
@@ -67,7 +84,10 @@ typedef struct {
 
 voidpf gzip_alloc(voidpf opaque, uInt items, uInt size);
 void gzip_free(voidpf opaque, voidpf address);
-void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc);
+int accept_encoding_type(const char *value, int len);
+int preferred_compression_type(int types);
+const char *compression_type_name(int compression_type);
+void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, int algorithms);
 void hide_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char *hidden_header_name);
 void restore_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char *hidden_header_name);
 const char *init_hidden_header_name();
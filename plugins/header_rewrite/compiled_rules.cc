@@ -0,0 +1,261 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+// compiled_rules.cc: grouping and dispatch of the rules of one hook
+//
+//
+#include <string>
+#include <algorithm>
+
+#include "ts/ts.h"
+
+#include "compiled_rules.h"
+
+
+// Regexes referring to their own groups by number (back references, recursion) can not be
+// wrapped into a larger alternation, since that renumbers the groups.
+static bool
+combinable_regex(const std::string &re)
+{
+  for (std::string::size_type i = 0; i + 1 < re.size(); ++i) {
+    if (re[i] == '\\') {
+      char c = re[i + 1];
+
+      if (isdigit(c) || (c == 'g') || (c == 'k')) {
+        return false;
+      }
+      ++i; // Skip the escaped character
+    } else if ((re[i] == '(') && (re[i + 1] == '?') && (i + 2 < re.size())) {
+      char c = re[i + 2];
+
+      if (isdigit(c) || (c == 'R') || (c == 'P') || (c == '|') || (c == '&') || (c == '+') || (c == '-')) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+CompiledRules::CompiledRules(RuleSet *rules) : _num_fields(0)
+{
+  std::unordered_map<std::string, int> slots;
+  std::vector<const RuleSet *> run;
+  GroupType run_type = GROUP_SINGLE;
+  std::string run_key;
+
+  for (RuleSet *rule = rules; rule; rule = rule->next) {
+    // Every condition inspecting a field shares the cache slot of that field
+    for (Statement *s = rule->get_condition(); s; s = s->next()) {
+      Condition *c = static_cast<Condition *>(s);
+      std::string key = c->get_field_key();
+
+      if (!key.empty()) {
+        std::unordered_map<std::string, int>::iterator iter = slots.find(key);
+
+        if (iter == slots.end()) {
+          iter = slots.insert(std::make_pair(key, _num_fields++)).first;
+        }
+        c->set_field_slot(iter->second);
+      }
+    }
+
+    std::string key;
+    GroupType type = classify(rule, key);
+
+    if ((type == GROUP_SINGLE) || (type != run_type) || (key != run_key)) {
+      add_group(run_type, run);
+    }
+    if (type == GROUP_SINGLE) {
+      run.push_back(rule);
+      add_group(GROUP_SINGLE, run);
+    } else {
+      run.push_back(rule);
+      run_type = type;
+      run_key = key;
+    }
+  }
+  add_group(run_type, run);
+
+  TSDebug(PLUGIN_NAME, "Compiled rules into %d groups, with %d cached fields", num_groups(), _num_fields);
+}
+
+
+CompiledRules::~CompiledRules()
+{
+  for (std::vector<Group *>::iterator iter = _groups.begin(); iter != _groups.end(); ++iter) {
+    delete *iter;
+  }
+}
+
+
+// A rule can be grouped if its only condition is a plain (possibly [L]) string match on a field.
+CompiledRules::GroupType
+CompiledRules::classify(const RuleSet *rule, std::string &key) const
+{
+  const Condition *c = rule->get_condition();
+
+  if ((NULL == c) || (NULL != c->next()) || (c->get_mods() & COND_NOT)) {
+    return GROUP_SINGLE;
+  }
+
+  key = c->get_field_key();
+  if (key.empty()) {
+    return GROUP_SINGLE;
+  }
+
+  switch (c->get_cond_op()) {
+  case MATCH_EQUAL:
+    return GROUP_EXACT;
+  case MATCH_REGULAR_EXPRESSION:
+    if (combinable_regex(static_cast<const Matchers<std::string> *>(c->get_matcher())->get())) {
+      return GROUP_REGEX;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return GROUP_SINGLE;
+}
+
+
+void
+CompiledRules::add_group(GroupType type, std::vector<const RuleSet *> &run)
+{
+  if (run.empty()) {
+    return;
+  }
+
+  if ((type == GROUP_SINGLE) || (run.size() < MIN_GROUP_SIZE)) {
+    for (std::vector<const RuleSet *>::iterator iter = run.begin(); iter != run.end(); ++iter) {
+      Group *g = new Group(GROUP_SINGLE);
+
+      g->rules.push_back(*iter);
+      _groups.push_back(g);
+    }
+  } else if (type == GROUP_EXACT) {
+    Group *g = new Group(GROUP_EXACT);
+
+    g->rules = run;
+    for (size_t i = 0; i < run.size(); ++i) {
+      g->exact[static_cast<const Matchers<std::string> *>(run[i]->get_condition()->get_matcher())->get()].push_back(i);
+    }
+    _groups.push_back(g);
+  } else {
+    for (size_t start = 0; start < run.size(); start += REGEX_GROUP_SIZE) {
+      Group *g = new Group(GROUP_REGEX);
+      std::string combined;
+
+      for (size_t i = start; (i < run.size()) && (i < start + REGEX_GROUP_SIZE); ++i) {
+        if (!combined.empty()) {
+          combined += '|';
+        }
+        combined += "(?:" + static_cast<const Matchers<std::string> *>(run[i]->get_condition()->get_matcher())->get() + ")";
+        g->rules.push_back(run[i]);
+      }
+
+      g->combined = new regexHelper();
+      if (!g->combined->setRegexMatch(combined)) {
+        TSDebug(PLUGIN_NAME, "Failed to combine regexes, evaluating them one by one");
+        delete g->combined;
+        g->combined = NULL;
+      }
+      _groups.push_back(g);
+    }
+  }
+
+  run.clear();
+}
+
+
+// Run the operators of a rule whose conditions matched, returns true if this was the last rule.
+bool
+CompiledRules::exec_rule(const RuleSet *rule, const Resources &res) const
+{
+  OperModifiers rt = rule->exec(res);
+
+  // Operators may have modified any of the cached fields
+  res.invalidate_fields();
+
+  return rule->last() || (rt & OPER_LAST);
+}
+
+
+void
+CompiledRules::execute(const Resources &res) const
+{
+  res.init_fields(_num_fields);
+
+  for (std::vector<Group *>::const_iterator iter = _groups.begin(); iter != _groups.end(); ++iter) {
+    const Group *g = *iter;
+
+    switch (g->type) {
+    case GROUP_SINGLE:
+      if (g->rules[0]->eval(res) && exec_rule(g->rules[0], res)) {
+        return;
+      }
+      break;
+
+    case GROUP_EXACT: {
+      size_t pos = 0;
+
+      // Look up the rules matching the current field value, in order. The value is fetched again
+      // after a rule executed, since its operators may have changed it.
+      while (pos < g->rules.size()) {
+        std::string s;
+        const std::string &value = g->rules[0]->get_condition()->fetch_value(s, res);
+        std::unordered_map<std::string, std::vector<size_t>>::const_iterator match = g->exact.find(value);
+
+        if (match == g->exact.end()) {
+          break;
+        }
+
+        std::vector<size_t>::const_iterator idx = std::lower_bound(match->second.begin(), match->second.end(), pos);
+
+        if (idx == match->second.end()) {
+          break;
+        }
+        TSDebug(PLUGIN_NAME, "Exact match on %s dispatched to rule %zu of group", value.c_str(), *idx);
+        if (exec_rule(g->rules[*idx], res)) {
+          return;
+        }
+        pos = *idx + 1;
+      }
+    } break;
+
+    case GROUP_REGEX: {
+      if (g->combined) {
+        std::string s;
+        const std::string &value = g->rules[0]->get_condition()->fetch_value(s, res);
+        int ovector[OVECCOUNT];
+
+        if (g->combined->regexMatch(value.c_str(), value.length(), ovector) <= 0) {
+          break; // None of the regexes in this group can match
+        }
+      }
+      for (std::vector<const RuleSet *>::const_iterator rule = g->rules.begin(); rule != g->rules.end(); ++rule) {
+        if ((*rule)->eval(res) && exec_rule(*rule, res)) {
+          return;
+        }
+      }
+    } break;
+    }
+  }
+}
@@ -0,0 +1,92 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+//
+// The rules of one hook, compiled for evaluation. Every field that conditions inspect gets a
+// slot in the per-hook field cache, and runs of rules that only test one field for an exact
+// string (or a regular expression) are grouped, such that a group is dispatched through a hash
+// table (or skipped with one combined regex) instead of evaluating each rule in turn.
+//
+#ifndef __COMPILED_RULES_H__
+#define __COMPILED_RULES_H__ 1
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "ruleset.h"
+#include "regex_helper.h"
+#include "resources.h"
+
+
+class CompiledRules
+{
+public:
+  explicit CompiledRules(RuleSet *rules);
+  ~CompiledRules();
+
+  // Evaluate the rules in order, until the end or a rule with [L]. This is equivalent to walking
+  // the RuleSet list, calling eval() / exec() on each.
+  void execute(const Resources &res) const;
+
+  int
+  num_fields() const
+  {
+    return _num_fields;
+  }
+  int
+  num_groups() const
+  {
+    return _groups.size();
+  }
+
+  // Runs shorter than this are not worth grouping.
+  static const size_t MIN_GROUP_SIZE = 4;
+  // Max number of regexes combined into one; this bounds the number of regexes that are
+  // evaluated one by one when the combined one matches.
+  static const size_t REGEX_GROUP_SIZE = 32;
+
+private:
+  DISALLOW_COPY_AND_ASSIGN(CompiledRules);
+
+  enum GroupType {
+    GROUP_SINGLE, // One rule, evaluated as is
+    GROUP_EXACT,  // Exact string matches on one field
+    GROUP_REGEX,  // Regular expression matches on one field
+  };
+
+  struct Group {
+    Group(GroupType t) : type(t), combined(NULL) {}
+    ~Group() { delete combined; }
+
+    GroupType type;
+    std::vector<const RuleSet *> rules;
+    std::unordered_map<std::string, std::vector<size_t>> exact; // Value -> (sorted) indices into rules
+    regexHelper *combined;                                      // All regexes of the group, or NULL
+  };
+
+  GroupType classify(const RuleSet *rule, std::string &key) const;
+  void add_group(GroupType type, std::vector<const RuleSet *> &run);
+  bool exec_rule(const RuleSet *rule, const Resources &res) const;
+
+  std::vector<Group *> _groups;
+  int _num_fields;
+};
+
+
+#endif // __COMPILED_RULES_H
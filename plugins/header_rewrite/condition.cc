@@ -79,3 +79,23 @@ Condition::initialize(Parser &p)
 
   _cond_op = parse_matcher_op(p.get_arg());
 }
+
+
+const std::string &
+Condition::fetch_value(std::string &s, const Resources &res)
+{
+  if ((_field_slot < 0) || (_field_slot >= res.num_fields())) {
+    append_value(s, res);
+    return s;
+  }
+
+  bool cached;
+  std::string *value = res.field(_field_slot, cached);
+
+  if (!cached) {
+    value->clear();
+    append_value(*value, res);
+  }
+
+  return *value;
+}
@@ -50,7 +50,7 @@ enum CondModifiers {
 class Condition : public Statement
 {
 public:
-  Condition() : _qualifier(""), _cond_op(MATCH_EQUAL), _matcher(NULL), _mods(COND_NONE)
+  Condition() : _qualifier(""), _cond_op(MATCH_EQUAL), _matcher(NULL), _mods(COND_NONE), _field_slot(-1)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for Condition");
   }
@@ -87,6 +87,29 @@ public:
     return _mods & COND_LAST;
   }
 
+  CondModifiers
+  get_mods() const
+  {
+    return _mods;
+  }
+
+  // Conditions that test a (string) field of the transaction return a key naming that field, e.g.
+  // "CLIENT-HEADER:Host". Conditions with the same key see the same value, which lets the rule
+  // compiler fetch it once per hook, and dispatch on it.
+  virtual std::string
+  get_field_key() const
+  {
+    return "";
+  }
+  void
+  set_field_slot(int slot)
+  {
+    _field_slot = slot;
+  }
+
+  // Return the value this condition tests, from the field cache in the resources when possible.
+  const std::string &fetch_value(std::string &s, const Resources &res);
+
   // Setters
   virtual void
   set_qualifier(const std::string &q)
@@ -127,6 +150,7 @@ private:
   DISALLOW_COPY_AND_ASSIGN(Condition);
 
   CondModifiers _mods;
+  int _field_slot;
 };
 
 
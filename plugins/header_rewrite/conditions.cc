@@ -88,10 +88,9 @@ bool
 ConditionMethod::eval(const Resources &res)
 {
   std::string s;
-
-  append_value(s, res);
-  bool rval = static_cast<const Matchers<std::string> *>(_matcher)->test(s);
-  TSDebug(PLUGIN_NAME, "Evaluating METHOD(): %s - rval: %d", s.c_str(), rval);
+  const std::string &value = fetch_value(s, res);
+  bool rval = static_cast<const Matchers<std::string> *>(_matcher)->test(value);
+  TSDebug(PLUGIN_NAME, "Evaluating METHOD(): %s - rval: %d", value.c_str(), rval);
   return rval;
 }
 
@@ -261,10 +260,9 @@ bool
 ConditionHeader::eval(const Resources &res)
 {
   std::string s;
-
-  append_value(s, res);
-  bool rval = static_cast<const Matchers<std::string> *>(_matcher)->test(s);
-  TSDebug(PLUGIN_NAME, "Evaluating HEADER(): %s - rval: %d", s.c_str(), rval);
+  const std::string &value = fetch_value(s, res);
+  bool rval = static_cast<const Matchers<std::string> *>(_matcher)->test(value);
+  TSDebug(PLUGIN_NAME, "Evaluating HEADER(): %s - rval: %d", value.c_str(), rval);
   return rval;
 }
 
@@ -301,11 +299,10 @@ bool
 ConditionPath::eval(const Resources &res)
 {
   std::string s;
-
-  append_value(s, res);
+  const std::string &value = fetch_value(s, res);
   TSDebug(PLUGIN_NAME, "Evaluating PATH");
 
-  return static_cast<const Matchers<std::string> *>(_matcher)->test(s);
+  return static_cast<const Matchers<std::string> *>(_matcher)->test(value);
 }
 
 // ConditionQuery
@@ -113,6 +113,12 @@ public:
   void initialize(Parser &p);
   void append_value(std::string &s, const Resources &res);
 
+  std::string
+  get_field_key() const
+  {
+    return "METHOD";
+  }
+
 protected:
   bool eval(const Resources &res);
 
@@ -232,6 +238,12 @@ public:
   void initialize(Parser &p);
   void append_value(std::string &s, const Resources &res);
 
+  std::string
+  get_field_key() const
+  {
+    return (_client ? "CLIENT-HEADER:" : "HEADER:") + _qualifier;
+  }
+
 protected:
   bool eval(const Resources &res);
 
@@ -250,6 +262,12 @@ public:
   void initialize(Parser &p);
   void append_value(std::string &s, const Resources &res);
 
+  std::string
+  get_field_key() const
+  {
+    return "PATH";
+  }
+
 protected:
   bool eval(const Resources &res);
 
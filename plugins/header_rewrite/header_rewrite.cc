@@ -26,6 +26,7 @@
 #include "parser.h"
 #include "ruleset.h"
 #include "resources.h"
+#include "compiled_rules.h"
 
 // Debugs
 const char PLUGIN_NAME[] = "header_rewrite";
@@ -42,6 +43,7 @@ public:
   RulesConfig() : _ref_count(0)
   {
     memset(_rules, 0, sizeof(_rules));
+    memset(_compiled, 0, sizeof(_compiled));
     memset(_resids, 0, sizeof(_resids));
 
     _cont = TSContCreate(cont_rewrite_headers, NULL);
@@ -64,6 +66,11 @@ public:
   {
     return _rules[hook];
   }
+  const CompiledRules *
+  compiled(int hook) const
+  {
+    return _compiled[hook];
+  }
 
   bool parse_config(const std::string fname, TSHttpHookID default_hook);
 
@@ -82,8 +89,9 @@ public:
 private:
   ~RulesConfig()
   {
-    for (int i = TS_HTTP_READ_REQUEST_HDR_HOOK; i < TS_HTTP_LAST_HOOK; ++i) {
+    for (int i = TS_HTTP_READ_REQUEST_HDR_HOOK; i <= TS_HTTP_LAST_HOOK; ++i) {
       delete _rules[i];
+      delete _compiled[i];
     }
     TSContDestroy(_cont);
   }
@@ -93,6 +101,7 @@ private:
   TSCont _cont;
   volatile int _ref_count;
   RuleSet *_rules[TS_HTTP_LAST_HOOK + 1];
+  CompiledRules *_compiled[TS_HTTP_LAST_HOOK + 1];
   ResourceIDs _resids[TS_HTTP_LAST_HOOK + 1];
 };
 
@@ -212,10 +221,12 @@ RulesConfig::parse_config(const std::string fname, TSHttpHookID default_hook)
   // Add the last rule (possibly the only rule)
   add_rule(rule);
 
-  // Collect all resource IDs that we need
-  for (int i = TS_HTTP_READ_REQUEST_HDR_HOOK; i < TS_HTTP_LAST_HOOK; ++i) {
+  // Collect all resource IDs that we need, and (re)compile the rules of each hook
+  for (int i = TS_HTTP_READ_REQUEST_HDR_HOOK; i <= TS_HTTP_LAST_HOOK; ++i) {
     if (_rules[i]) {
       _resids[i] = _rules[i]->get_all_resource_ids();
+      delete _compiled[i];
+      _compiled[i] = new CompiledRules(_rules[i]);
     }
   }
 
@@ -259,23 +270,13 @@ cont_rewrite_headers(TSCont contp, TSEvent event, void *edata)
   }
 
   if (hook != TS_HTTP_LAST_HOOK) {
-    const RuleSet *rule = conf->rule(hook);
     Resources res(txnp, contp);
 
     // Get the resources necessary to process this event
     res.gather(conf->resid(hook), hook);
 
-    // Evaluation of all rules. This code is sort of duplicate in DoRemap as well.
-    while (rule) {
-      if (rule->eval(res)) {
-        OperModifiers rt = rule->exec(res);
-
-        if (rule->last() || (rt & OPER_LAST)) {
-          break; // Conditional break, force a break with [L]
-        }
-      }
-      rule = rule->next;
-    }
+    // Evaluation of all rules (stops at a rule with [L]). This is shared with DoRemap.
+    conf->compiled(hook)->execute(res);
   }
 
   TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
@@ -443,23 +444,16 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
   // Now handle the remap specific rules for the "remap hook" (which is not a real hook).
   // This is sufficiently differen than the normal cont_rewrite_headers() callback, and
   // we can't (shouldn't) schedule this as a TXN hook.
-  RuleSet *rule = conf->rule(TS_REMAP_PSEUDO_HOOK);
+  const CompiledRules *rules = conf->compiled(TS_REMAP_PSEUDO_HOOK);
   Resources res(rh, rri);
 
-  res.gather(RSRC_CLIENT_REQUEST_HEADERS, TS_REMAP_PSEUDO_HOOK);
-  while (rule) {
-    if (rule->eval(res)) {
-      OperModifiers rt = rule->exec(res);
+  if (rules) {
+    res.gather(RSRC_CLIENT_REQUEST_HEADERS, TS_REMAP_PSEUDO_HOOK);
+    rules->execute(res);
 
-      if (res.changed_url == true) {
-        rval = TSREMAP_DID_REMAP;
-      }
-
-      if (rule->last() || (rt & OPER_LAST)) {
-        break; // Conditional break, force a break with [L]
-      }
+    if (res.changed_url == true) {
+      rval = TSREMAP_DID_REMAP;
     }
-    rule = rule->next;
   }
 
   TSDebug(PLUGIN_NAME_DBG, "Returing from TSRemapDoRemap with status: %d", rval);
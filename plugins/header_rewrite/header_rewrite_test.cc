@@ -22,11 +22,20 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <chrono>
 #include <parser.h>
 
+#include "ruleset.h"
+#include "compiled_rules.h"
+
 const char PLUGIN_NAME[] = "TEST_header_rewrite";
 const char PLUGIN_NAME_DBG[] = "TEST_dbg_header_rewrite";
 
+static bool debug_output = true;
+
 extern "C" void
 TSError(const char *fmt, ...)
 {
@@ -46,6 +55,10 @@ TSDebug(const char *tag, const char *fmt, ...)
   char buf[2048];
   int bytes = 0;
   va_list args;
+
+  if (!debug_output) {
+    return;
+  }
   va_start(args, fmt);
   if ((bytes = vsnprintf(buf, sizeof(buf), fmt, args)) > 0) {
     fprintf(stdout, "TSDebug: %s: %.*s\n", PLUGIN_NAME, bytes, buf);
@@ -53,6 +66,66 @@ TSDebug(const char *tag, const char *fmt, ...)
   va_end(args);
 }
 
+// The rest of the TS API used by the rules, the transaction related bits are never reached.
+extern "C" {
+tsapi const TSMLoc TS_NULL_MLOC = (TSMLoc)NULL;
+}
+
+extern "C" void
+_TSReleaseAssert(const char *txt, const char *f, int l)
+{
+  fprintf(stderr, "TSReleaseAssert: %s at %s:%d\n", txt, f, l);
+  abort();
+}
+
+extern "C" void
+_TSfree(void *ptr)
+{
+  free(ptr);
+}
+
+extern "C" const char *
+TSHttpHookNameLookup(TSHttpHookID /* hook ATS_UNUSED */)
+{
+  return "TEST_HOOK";
+}
+
+extern "C" TSReturnCode
+TSHandleMLocRelease(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* parent ATS_UNUSED */, TSMLoc /* mloc ATS_UNUSED */)
+{
+  return TS_SUCCESS;
+}
+
+extern "C" TSReturnCode
+TSHttpTxnClientReqGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */, TSMLoc * /* offset ATS_UNUSED */)
+{
+  return TS_ERROR;
+}
+
+extern "C" TSReturnCode
+TSHttpTxnClientRespGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */, TSMLoc * /* offset ATS_UNUSED */)
+{
+  return TS_ERROR;
+}
+
+extern "C" TSReturnCode
+TSHttpTxnServerReqGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */, TSMLoc * /* offset ATS_UNUSED */)
+{
+  return TS_ERROR;
+}
+
+extern "C" TSReturnCode
+TSHttpTxnServerRespGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */, TSMLoc * /* offset ATS_UNUSED */)
+{
+  return TS_ERROR;
+}
+
+extern "C" TSHttpStatus
+TSHttpHdrStatusGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* offset ATS_UNUSED */)
+{
+  return TS_HTTP_STATUS_NONE;
+}
+
 #define CHECK_EQ(x, y)                   \
   do {                                   \
     if ((x) != (y)) {                    \
@@ -221,13 +294,333 @@ test_processing()
   return 0;
 }
 
+/*
+ * Rules on a fake transaction: the conditions test entries of the "fields" map, and the operators
+ * record which rules executed (or modify the fields), such that the compiled rules can be checked
+ * against the plain, rule by rule evaluation.
+ */
+static std::map<std::string, std::string> fields;
+static std::vector<std::string> executed;
+static int field_fetches = 0;
+
+class ConditionTestField : public Condition
+{
+public:
+  void
+  initialize(Parser &p)
+  {
+    Condition::initialize(p);
+
+    Matchers<std::string> *match = new Matchers<std::string>(_cond_op);
+    match->set(p.get_arg());
+    _matcher = match;
+  }
+
+  void
+  append_value(std::string &s, const Resources & /* res ATS_UNUSED */)
+  {
+    ++field_fetches;
+    s += fields[_qualifier];
+  }
+
+  std::string
+  get_field_key() const
+  {
+    return "TEST-FIELD:" + _qualifier;
+  }
+
+protected:
+  bool
+  eval(const Resources &res)
+  {
+    std::string s;
+    return static_cast<const Matchers<std::string> *>(_matcher)->test(fetch_value(s, res));
+  }
+};
+
+class OperatorTestExec : public Operator
+{
+public:
+  void
+  initialize(Parser &p)
+  {
+    Operator::initialize(p);
+    _id = p.get_arg();
+  }
+
+protected:
+  void
+  exec(const Resources & /* res ATS_UNUSED */) const
+  {
+    executed.push_back(_id);
+  }
+
+private:
+  std::string _id;
+};
+
+class OperatorTestSetField : public Operator
+{
+public:
+  void
+  initialize(Parser &p)
+  {
+    Operator::initialize(p);
+    _field = p.get_arg();
+    _value = p.get_value();
+  }
+
+protected:
+  void
+  exec(const Resources & /* res ATS_UNUSED */) const
+  {
+    fields[_field] = _value;
+  }
+
+private:
+  std::string _field;
+  std::string _value;
+};
+
+Operator *
+operator_factory(const std::string &op)
+{
+  if (op == "test-exec") {
+    return new OperatorTestExec();
+  } else if (op == "test-set-field") {
+    return new OperatorTestSetField();
+  }
+  return NULL;
+}
+
+Condition *
+condition_factory(const std::string &cond)
+{
+  Condition *c = NULL;
+
+  if (cond.compare(0, 11, "TEST-FIELD:") == 0) {
+    c = new ConditionTestField();
+    c->set_qualifier(cond.substr(11));
+  }
+  return c;
+}
+
+// Same as RulesConfig::parse_config(), minus the hooks
+static RuleSet *
+parse_rules(const std::vector<std::string> &lines)
+{
+  RuleSet *rules = NULL;
+  RuleSet *rule = NULL;
+
+  for (size_t i = 0; i <= lines.size(); ++i) {
+    if (i == lines.size() || Parser(lines[i]).is_cond()) {
+      if (rule && rule->has_operator()) {
+        if (rules) {
+          rules->append(rule);
+        } else {
+          rules = rule;
+        }
+        rule = NULL;
+      }
+      if (i == lines.size()) {
+        break;
+      }
+    }
+
+    Parser p(lines[i]);
+
+    if (NULL == rule) {
+      rule = new RuleSet();
+    }
+    if (p.is_cond()) {
+      rule->add_condition(p);
+    } else {
+      rule->add_operator(p);
+    }
+  }
+
+  return rules;
+}
+
+static void
+delete_rules(RuleSet *rules)
+{
+  while (rules) {
+    RuleSet *next = rules->next;
+    delete rules;
+    rules = next;
+  }
+}
+
+// The evaluation loop header_rewrite used before rules were compiled
+static void
+execute_linear(const RuleSet *rule, const Resources &res)
+{
+  while (rule) {
+    if (rule->eval(res)) {
+      OperModifiers rt = rule->exec(res);
+
+      if (rule->last() || (rt & OPER_LAST)) {
+        break;
+      }
+    }
+    rule = rule->next;
+  }
+}
+
+// Run both evaluations on the same input, and compare what executed
+static bool
+same_execution(const RuleSet *rules, const CompiledRules &compiled, const std::map<std::string, std::string> &input)
+{
+  Resources res(NULL, static_cast<TSCont>(NULL));
+  std::vector<std::string> linear;
+
+  fields = input;
+  executed.clear();
+  execute_linear(rules, res);
+  linear.swap(executed);
+
+  fields = input;
+  compiled.execute(res);
+
+  if (linear != executed) {
+    fprintf(stderr, "Compiled rules executed %zu rules, expected %zu\n", executed.size(), linear.size());
+    return false;
+  }
+  return true;
+}
+
+static std::string
+rule_id(const char *prefix, int i)
+{
+  std::ostringstream oss;
+  oss << prefix << i;
+  return oss.str();
+}
+
+// N rules of "cond %{TEST-FIELD:<field>} <op><prefix>i", each executing "<prefix>i"
+static void
+add_match_rules(std::vector<std::string> &lines, const char *field, const char *op, const char *prefix, int n)
+{
+  for (int i = 0; i < n; ++i) {
+    lines.push_back(std::string("cond %{TEST-FIELD:") + field + "} " + op + rule_id(prefix, i) + (*op == '/' ? "$/" : ""));
+    lines.push_back("test-exec " + rule_id(prefix, i));
+  }
+}
+
+int
+test_compiled_rules()
+{
+  debug_output = false;
+
+  {
+    // Exact matches, including a duplicate, an [L] rule, and a rule changing the field it matched on
+    std::vector<std::string> lines;
+
+    add_match_rules(lines, "host", "=", "h", 10);
+    lines.push_back("cond %{TEST-FIELD:host} =h3");
+    lines.push_back("test-exec dup-h3");
+    lines.push_back("cond %{TEST-FIELD:host} =h5 [L]");
+    lines.push_back("test-exec last-h5");
+    lines.push_back("cond %{TEST-FIELD:host} =h7");
+    lines.push_back("test-set-field host h8");
+    add_match_rules(lines, "host", "=", "h", 10);
+    lines.push_back("cond %{TEST-FIELD:path} =p1 [NOT]");
+    lines.push_back("test-exec not-p1");
+
+    RuleSet *rules = parse_rules(lines);
+    CompiledRules compiled(rules);
+
+    CHECK_EQ(compiled.num_fields(), 2);
+    CHECK_EQ(compiled.num_groups(), 2);
+
+    const char *hosts[] = {"h0", "h3", "h5", "h7", "h8", "h9", "h10", ""};
+    for (size_t i = 0; i < sizeof(hosts) / sizeof(hosts[0]); ++i) {
+      std::map<std::string, std::string> input;
+
+      input["host"] = hosts[i];
+      input["path"] = (i % 2) ? "p1" : "p2";
+      CHECK_EQ(same_execution(rules, compiled, input), true);
+    }
+    delete_rules(rules);
+  }
+
+  {
+    // Regular expressions, one of which can not be combined with the others
+    std::vector<std::string> lines;
+
+    add_match_rules(lines, "path", "/^", "r", 70);
+    lines.push_back("cond %{TEST-FIELD:path} /(a)\\1/");
+    lines.push_back("test-exec backref");
+    add_match_rules(lines, "path", "/^x", "r", 5);
+
+    RuleSet *rules = parse_rules(lines);
+    CompiledRules compiled(rules);
+
+    // 70 regexes in chunks of 32, the back reference, and the last 5
+    CHECK_EQ(compiled.num_groups(), 5);
+
+    const char *paths[] = {"r0", "r31", "r32", "r69", "aa", "xr4", "none"};
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+      std::map<std::string, std::string> input;
+
+      input["path"] = paths[i];
+      CHECK_EQ(same_execution(rules, compiled, input), true);
+    }
+    delete_rules(rules);
+  }
+
+  debug_output = true;
+  return 0;
+}
+
+// Time the plain and the compiled evaluation of a 1000 rule configuration
+static void
+benchmark(const char *name, const char *op, int num_rules, int num_txns)
+{
+  std::vector<std::string> lines;
+  double elapsed[2];
+  int fetches[2];
+
+  debug_output = false;
+  add_match_rules(lines, "host", op, "h", num_rules);
+
+  RuleSet *rules = parse_rules(lines);
+  CompiledRules compiled(rules);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    field_fetches = 0;
+    for (int i = 0; i < num_txns; ++i) {
+      Resources res(NULL, static_cast<TSCont>(NULL));
+
+      fields["host"] = rule_id("h", (i * 7919) % (2 * num_rules)); // Half of these match nothing
+      if (pass == 0) {
+        execute_linear(rules, res);
+      } else {
+        compiled.execute(res);
+      }
+    }
+    elapsed[pass] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / num_txns;
+    fetches[pass] = field_fetches;
+  }
+  printf("%s, %d rules: %.2f us/txn (%d field fetches) linear, %.2f us/txn (%d field fetches) compiled\n", name, num_rules,
+         elapsed[0], fetches[0], elapsed[1], fetches[1]);
+  delete_rules(rules);
+  debug_output = true;
+}
+
 int
 tests()
 {
-  if (test_parsing() || test_processing()) {
+  if (test_parsing() || test_processing() || test_compiled_rules()) {
     return 1;
   }
 
+  benchmark("Exact matches", "=", 1000, 2000);
+  benchmark("Regex matches", "/^", 1000, 2000);
+
   return 0;
 }
 
@@ -71,6 +71,12 @@ public:
     _pdata = NULL;
   }
 
+  MatcherOps
+  get_op() const
+  {
+    return _op;
+  }
+
 protected:
   void *_pdata;
   const MatcherOps _op;
@@ -114,7 +120,7 @@ public:
   }
 
   void
-  set(const T d)
+  set(const T &d)
   {
     _data = d;
     if (_op == MATCH_REGULAR_EXPRESSION)
@@ -123,7 +129,7 @@ public:
 
   // Evaluate this matcher
   bool
-  test(const T t) const
+  test(const T &t) const
   {
     switch (_op) {
     case MATCH_EQUAL:
@@ -148,19 +154,19 @@ public:
 private:
   // For basic types
   bool
-  test_eq(const T t) const
+  test_eq(const T &t) const
   {
     // std::cout << "Testing: " << t << " == " << _data << std::endl;
     return t == _data;
   }
   bool
-  test_lt(const T t) const
+  test_lt(const T &t) const
   {
     // std::cout << "Testing: " << t << " < " << _data << std::endl;
     return t < _data;
   }
   bool
-  test_gt(const T t) const
+  test_gt(const T &t) const
   {
     // std::cout << "Testing: " << t << " > " << _data << std::endl;
     return t > _data;
@@ -181,7 +187,7 @@ private:
   }
 
   bool
-  test_reg(const std::string t) const
+  test_reg(const std::string &t) const
   {
     TSDebug(PLUGIN_NAME, "Test regular expression %s : %s", _data.c_str(), t.c_str());
     int ovector[OVECCOUNT];
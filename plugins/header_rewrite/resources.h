@@ -23,6 +23,8 @@
 #define __RESOURCES_H__ 1
 
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "ts/ts.h"
 #include "ts/remap.h"
@@ -71,6 +73,33 @@ public:
     return _ready;
   }
 
+  // Cache of the field values inspected by conditions, indexed by the field slots assigned
+  // when the rules for this hook were compiled (see CompiledRules). Values are fetched at most
+  // once, until an operator runs and possibly modifies them.
+  void
+  init_fields(int num_fields) const
+  {
+    _fields.resize(num_fields);
+    _field_cached.assign(num_fields, false);
+  }
+  int
+  num_fields() const
+  {
+    return _fields.size();
+  }
+  std::string *
+  field(int slot, bool &cached) const
+  {
+    cached = _field_cached[slot];
+    _field_cached[slot] = true;
+    return &_fields[slot];
+  }
+  void
+  invalidate_fields() const
+  {
+    std::fill(_field_cached.begin(), _field_cached.end(), false);
+  }
+
   TSHttpTxn txnp;
   TSCont contp;
   TSMBuffer bufp;
@@ -86,6 +115,8 @@ private:
   DISALLOW_COPY_AND_ASSIGN(Resources);
 
   bool _ready;
+  mutable std::vector<std::string> _fields;
+  mutable std::vector<bool> _field_cached;
 };
 
 
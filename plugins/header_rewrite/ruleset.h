@@ -56,6 +56,11 @@ public:
   {
     return NULL != _cond;
   }
+  Condition *
+  get_condition() const
+  {
+    return _cond;
+  }
 
   void
   set_hook(TSHttpHookID hook)
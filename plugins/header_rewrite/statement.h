@@ -95,6 +95,11 @@ public:
 
   // Linked list.
   void append(Statement *stmt);
+  Statement *
+  next() const
+  {
+    return _next;
+  }
 
   const ResourceIDs get_resource_ids() const;
 
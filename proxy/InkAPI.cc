@@ -7980,6 +7980,12 @@ _conf_to_memberp(TSOverridableConfigKey conf, OverridableHttpConfigParams *overr
     typ = OVERRIDABLE_TYPE_INT;
     ret = &overridableHttpConfig->redirect_use_orig_cache_key;
     break;
+  case TS_CONFIG_HTTP_CACHE_ADMISSION_FILTER:
+    ret = &overridableHttpConfig->cache_admission_filter;
+    break;
+  case TS_CONFIG_HTTP_SERVER_HTTP2:
+    ret = &overridableHttpConfig->server_http2;
+    break;
   // This helps avoiding compiler warnings, yet detect unhandled enum members.
   case TS_CONFIG_NULL:
   case TS_CONFIG_LAST_ENTRY:
@@ -8199,6 +8205,11 @@ TSHttpTxnConfigFind(const char *name, int length, TSOverridableConfigKey *conf,
       cnf = TS_CONFIG_SSL_HSTS_MAX_AGE;
     break;
 
+  case 30:
+    if (!strncmp(name, "proxy.config.http.server_http2", length))
+      cnf = TS_CONFIG_HTTP_SERVER_HTTP2;
+    break;
+
   case 31:
     if (!strncmp(name, "proxy.config.http.chunking.size", length))
       cnf = TS_CONFIG_HTTP_CHUNKING_SIZE;
@@ -8332,6 +8343,8 @@ TSHttpTxnConfigFind(const char *name, int length, TSOverridableConfigKey *conf,
         cnf = TS_CONFIG_HTTP_INSERT_REQUEST_VIA_STR;
       else if (!strncmp(name, "proxy.config.http.flow_control.low_water", length))
         cnf = TS_CONFIG_HTTP_FLOW_CONTROL_LOW_WATER_MARK;
+      else if (!strncmp(name, "proxy.config.http.cache.admission_filter", length))
+        cnf = TS_CONFIG_HTTP_CACHE_ADMISSION_FILTER;
       break;
     case 's':
       if (!strncmp(name, "proxy.config.http.origin_max_connections", length))
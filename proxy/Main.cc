@@ -371,6 +371,62 @@ init_memory_tracker(const char *config_var, RecDataT /* type ATS_UNUSED */, RecD
   return 1;
 }
 
+// Register the per NUMA node buffer pool stats, if the event threads have
+// been spread over several nodes.
+static void
+init_numa_stats()
+{
+  char name[128];
+  RecRawStatBlock *rsb;
+
+  if (eventProcessor.n_numa_nodes <= 1 || !(rsb = RecAllocateRawStatBlock(eventProcessor.n_numa_nodes * iobuf_numa_stat_count))) {
+    return;
+  }
+  for (int node = 0; node < eventProcessor.n_numa_nodes; node++) {
+    int id = node * iobuf_numa_stat_count;
+    snprintf(name, sizeof(name), "proxy.process.numa.node.%d.threads", node);
+    RecRegisterStatInt(RECT_PROCESS, name, eventProcessor.n_threads_for_node[node], RECP_NON_PERSISTENT);
+    snprintf(name, sizeof(name), "proxy.process.numa.node.%d.iobuf_allocs", node);
+    RecRegisterRawStat(rsb, RECT_PROCESS, name, RECD_INT, RECP_NON_PERSISTENT, id + iobuf_numa_allocs_stat, RecRawStatSyncSum);
+    snprintf(name, sizeof(name), "proxy.process.numa.node.%d.iobuf_remote_frees", node);
+    RecRegisterRawStat(rsb, RECT_PROCESS, name, RECD_INT, RECP_NON_PERSISTENT, id + iobuf_numa_remote_frees_stat,
+                       RecRawStatSyncSum);
+  }
+  ioBufNumaRsb = rsb;
+}
+
+static int
+steal_queue_length_sync(const char *, RecDataT, RecData *data, RecRawStatBlock *, int id)
+{
+  data->rec_int = eventProcessor.eventthread[ET_CALL][id]->steal_queue_length;
+  return REC_ERR_OKAY;
+}
+
+static int
+events_stolen_sync(const char *, RecDataT, RecData *data, RecRawStatBlock *, int id)
+{
+  data->rec_int = eventProcessor.eventthread[ET_CALL][id]->events_stolen;
+  return REC_ERR_OKAY;
+}
+
+static void
+init_work_stealing_stats()
+{
+  char name[128];
+  RecRawStatBlock *rsb;
+  int n = eventProcessor.n_threads_for_type[ET_CALL];
+
+  if (!eventProcessor.work_stealing || !(rsb = RecAllocateRawStatBlock(n))) {
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "proxy.process.eventloop.thread.%d.steal_queue_length", i);
+    RecRegisterRawStat(rsb, RECT_PROCESS, name, RECD_INT, RECP_NON_PERSISTENT, i, steal_queue_length_sync);
+    snprintf(name, sizeof(name), "proxy.process.eventloop.thread.%d.steals", i);
+    RecRegisterRawStat(rsb, RECT_PROCESS, name, RECD_INT, RECP_NON_PERSISTENT, i, events_stolen_sync);
+  }
+}
+
 static void
 proxy_signal_handler(int signo, siginfo_t *info, void *)
 {
@@ -1557,6 +1613,11 @@ main(int /* argc ATS_UNUSED */, const char **argv)
   Debug("hugepages", "ats_pagesize reporting %zu", ats_pagesize());
   Debug("hugepages", "ats_hugepage_size reporting %zu", ats_hugepage_size());
 
+  // size the per-thread freelist magazines
+  int magazine_size = 0;
+  REC_ReadConfigInteger(magazine_size, "proxy.config.allocator.magazine_size");
+  ink_freelist_set_magazine_size(magazine_size < 0 ? 0 : magazine_size);
+
   if (!num_accept_threads)
     REC_ReadConfigInteger(num_accept_threads, "proxy.config.accept_threads");
 
@@ -1726,6 +1787,8 @@ main(int /* argc ATS_UNUSED */, const char **argv)
   ink_dns_init(makeModuleVersion(HOSTDB_MODULE_MAJOR_VERSION, HOSTDB_MODULE_MINOR_VERSION, PRIVATE_MODULE_HEADER));
   ink_split_dns_init(makeModuleVersion(1, 0, PRIVATE_MODULE_HEADER));
   eventProcessor.start(num_of_net_threads, stacksize);
+  init_numa_stats();
+  init_work_stealing_stats();
 
   int num_remap_threads = 0;
   REC_ReadConfigInteger(num_remap_threads, "proxy.config.remap.num_remap_threads");
@@ -22,17 +22,19 @@
  */
 #include "ParentConsistentHash.h"
 
-ParentConsistentHash::ParentConsistentHash(ParentRecord *parent_record)
+ParentConsistentHash::ParentConsistentHash(ParentRecord *parent_record, ATSConsistentHashType hash_type)
 {
   int i;
 
   ink_assert(parent_record->num_parents > 0);
   parents[PRIMARY] = parent_record->parents;
   parents[SECONDARY] = parent_record->secondary_parents;
+  parent_count[PRIMARY] = parent_record->num_parents;
+  parent_count[SECONDARY] = parent_record->num_secondary_parents;
   ignore_query = parent_record->ignore_query;
   ink_zero(foundParents);
 
-  chash[PRIMARY] = new ATSConsistentHash();
+  chash[PRIMARY] = new ATSConsistentHash(1024, NULL, hash_type);
 
   for (i = 0; i < parent_record->num_parents; i++) {
     chash[PRIMARY]->insert(&(parent_record->parents[i]), parent_record->parents[i].weight, (ATSHash64 *)&hash[PRIMARY]);
@@ -40,7 +42,7 @@ ParentConsistentHash::ParentConsistentHash(ParentRecord *parent_record)
 
   if (parent_record->num_secondary_parents > 0) {
     Debug("parent_select", "ParentConsistentHash(): initializing the secondary parents hash.");
-    chash[SECONDARY] = new ATSConsistentHash();
+    chash[SECONDARY] = new ATSConsistentHash(1024, NULL, hash_type);
 
     for (i = 0; i < parent_record->num_secondary_parents; i++) {
       chash[SECONDARY]->insert(&(parent_record->secondary_parents[i]), parent_record->secondary_parents[i].weight,
@@ -52,6 +54,13 @@ ParentConsistentHash::ParentConsistentHash(ParentRecord *parent_record)
   Debug("parent_select", "Using a consistent hash parent selection strategy.");
 }
 
+// Parents which are marked down, or ejected as outliers, are passed over.
+static inline bool
+parent_usable(pRecord *pRec, time_t now)
+{
+  return pRec->available && !pRec->ejected(now);
+}
+
 ParentConsistentHash::~ParentConsistentHash()
 {
   delete chash[PRIMARY];
@@ -146,7 +155,7 @@ ParentConsistentHash::selectParent(const ParentSelectionPolicy *policy, bool fir
   }
 
   // didn't find a parent or the parent is marked unavailable.
-  if (!pRec || (pRec && !pRec->available)) {
+  if (!pRec || !parent_usable(pRec, request_info->xact_start)) {
     do {
       if (pRec && !pRec->available) {
         Debug("parent_select", "Parent.failedAt = %u, retry = %u, xact_start = %u", (unsigned int)pRec->failedAt,
@@ -194,11 +203,16 @@ ParentConsistentHash::selectParent(const ParentSelectionPolicy *policy, bool fir
         Debug("parent_select", "No available parents.");
         break;
       }
-    } while (!prtmp || !pRec->available);
+    } while (!prtmp || !parent_usable(pRec, request_info->xact_start));
+  }
+
+  // Spread the load over the first few parents of the url, if configured.
+  if (path_hash && pRec && parent_usable(pRec, request_info->xact_start) && policy->ConsistentHashCandidates > 1) {
+    pRec = leastLoaded(policy, last_lookup, path_hash, pRec, request_info->xact_start);
   }
 
   // use the available parent.
-  if (pRec && pRec->available) {
+  if (pRec && parent_usable(pRec, request_info->xact_start)) {
     result->r = PARENT_SPECIFIED;
     result->hostname = pRec->hostname;
     result->port = pRec->port;
@@ -284,6 +298,72 @@ ParentConsistentHash::markParentDown(const ParentSelectionPolicy *policy, Parent
   }
 }
 
+// Parents without a latency average, as they have not answered since
+//   they were added or returned from an ejection, are not compared.
+static inline bool
+parent_has_latency(pRecord *pRec)
+{
+  return pRec->samples > 0 && pRec->latency > 0;
+}
+
+// pRecord *ParentConsistentHash::leastLoaded(...)
+//
+//    Picks two of the first available parents for the hash value, up
+//      to the number of candidates, at random, and returns the one with
+//      the lower response latency average. If either has no average
+//      yet, the first one picked is returned, so that a parent which
+//      just came back gets its share of the load, neither all of it,
+//      nor none of the responses it needs for an average.
+//
+pRecord *
+ParentConsistentHash::leastLoaded(const ParentSelectionPolicy *policy, uint32_t last_lookup, uint64_t path_hash, pRecord *pRec,
+                                  time_t now)
+{
+  ATSHash64Sip24 hash;
+  ATSConsistentHashIter iter;
+  bool wrap_around = false;
+  bool seen[MAX_PARENTS] = {false};
+  pRecord *candidates[MAX_PARENTS];
+  int num_parents = parent_count[last_lookup];
+  int num_seen = 0, num_candidates = 0;
+  pRecord *prtmp, *first, *second;
+
+  prtmp = (pRecord *)chash[last_lookup]->lookup_by_hashval(path_hash, &iter, &wrap_around);
+  while (prtmp && num_seen < num_parents && num_candidates < policy->ConsistentHashCandidates) {
+    pRecord *candidate = parents[last_lookup] + prtmp->idx;
+
+    if (prtmp->idx < MAX_PARENTS && !seen[prtmp->idx]) {
+      seen[prtmp->idx] = true;
+      num_seen++;
+
+      if (parent_usable(candidate, now)) {
+        candidates[num_candidates++] = candidate;
+      }
+    }
+    prtmp = (pRecord *)chash[last_lookup]->lookup(NULL, &iter, &wrap_around, &hash);
+  }
+
+  if (num_candidates < 2) {
+    return pRec;
+  }
+
+  int i = this_ethread()->generator.random() % num_candidates;
+  int j = this_ethread()->generator.random() % (num_candidates - 1);
+
+  first = candidates[i];
+  second = candidates[j >= i ? j + 1 : j];
+
+  if (parent_has_latency(first) && parent_has_latency(second) && second->latency < first->latency) {
+    first = second;
+  }
+
+  if (first != pRec) {
+    Debug("parent_select", "Parent %s is less loaded than %s.", first->hostname, pRec->hostname);
+  }
+
+  return first;
+}
+
 uint32_t
 ParentConsistentHash::numParents(ParentResult *result) const
 {
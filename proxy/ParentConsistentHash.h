@@ -35,7 +35,7 @@
 
 //
 //  Implementation of round robin based upon consistent hash of the URL,
-//  ParentRR_t = P_CONSISTENT_HASH.
+//  ParentRR_t = P_CONSISTENT_HASH or P_CONSISTENT_HASH_MAGLEV.
 //
 class ParentConsistentHash : public ParentSelectionStrategy
 {
@@ -45,19 +45,21 @@ class ParentConsistentHash : public ParentSelectionStrategy
   ATSConsistentHash *chash[2];
   ATSConsistentHashIter chashIter[2];
   pRecord *parents[2];
+  int parent_count[2];
   bool foundParents[2][MAX_PARENTS];
   bool ignore_query;
 
 public:
   static const int PRIMARY = 0;
   static const int SECONDARY = 1;
-  ParentConsistentHash(ParentRecord *_parent_record);
+  ParentConsistentHash(ParentRecord *_parent_record, ATSConsistentHashType _hash_type);
   ~ParentConsistentHash();
   uint64_t getPathHash(HttpRequestData *hrdata, ATSHash64 *h);
   void selectParent(const ParentSelectionPolicy *policy, bool firstCall, ParentResult *result, RequestData *rdata);
   void markParentDown(const ParentSelectionPolicy *policy, ParentResult *result);
   uint32_t numParents(ParentResult *result) const;
   void markParentUp(ParentResult *result);
+  pRecord *leastLoaded(const ParentSelectionPolicy *policy, uint32_t last_lookup, uint64_t path_hash, pRecord *pRec, time_t now);
 };
 
 #endif
@@ -31,10 +31,19 @@
 #include "HTTP.h"
 #include "HttpTransact.h"
 
+#include <algorithm>
+#include <vector>
+
 #define PARENT_RegisterConfigUpdateFunc REC_RegisterConfigUpdateFunc
 #define PARENT_ReadConfigInteger REC_ReadConfigInteger
+#define PARENT_ReadConfigFloat REC_ReadConfigFloat
 #define PARENT_ReadConfigStringAlloc REC_ReadConfigStringAlloc
 
+// A parent is only judged an outlier once this many responses went into its averages
+#define PARENT_OUTLIER_MIN_SAMPLES 20
+// The ejection time doubles with consecutive ejections, up to this many times
+#define PARENT_OUTLIER_MAX_BACKOFF 5
+
 typedef ControlMatcher<ParentRecord, ParentResult> P_table;
 
 // Global Vars for Parent Selection
@@ -48,6 +57,13 @@ static const char *retry_var = "proxy.config.http.parent_proxy.retry_time";
 static const char *enable_var = "proxy.config.http.parent_proxy_routing_enable";
 static const char *threshold_var = "proxy.config.http.parent_proxy.fail_threshold";
 static const char *dns_parent_only_var = "proxy.config.http.no_dns_just_forward_to_parent";
+static const char *health_interval_var = "proxy.config.http.parent_proxy.health_check.interval";
+static const char *health_timeout_var = "proxy.config.http.parent_proxy.health_check.timeout";
+static const char *latency_factor_var = "proxy.config.http.parent_proxy.outlier.latency_factor";
+static const char *error_rate_var = "proxy.config.http.parent_proxy.outlier.error_rate";
+static const char *ejection_time_var = "proxy.config.http.parent_proxy.outlier.ejection_time";
+static const char *max_ejection_var = "proxy.config.http.parent_proxy.outlier.max_ejection_percent";
+static const char *candidates_var = "proxy.config.http.parent_proxy.consistent_hash.candidates";
 
 static const char *ParentResultStr[] = {"PARENT_UNDEFINED", "PARENT_DIRECT", "PARENT_SPECIFIED", "PARENT_AGENT", "PARENT_FAIL"};
 
@@ -85,6 +101,15 @@ ParentSelectionPolicy::ParentSelectionPolicy()
   // Handle dns parent only
   PARENT_ReadConfigInteger(dns_parent_only, dns_parent_only_var);
   DNS_ParentOnly = dns_parent_only;
+
+  // Handle active health checks and outlier ejection
+  PARENT_ReadConfigInteger(HealthCheckInterval, health_interval_var);
+  PARENT_ReadConfigInteger(HealthCheckTimeout, health_timeout_var);
+  PARENT_ReadConfigFloat(OutlierLatencyFactor, latency_factor_var);
+  PARENT_ReadConfigFloat(OutlierErrorRate, error_rate_var);
+  PARENT_ReadConfigInteger(OutlierEjectionTime, ejection_time_var);
+  PARENT_ReadConfigInteger(OutlierMaxEjectionPercent, max_ejection_var);
+  PARENT_ReadConfigInteger(ConsistentHashCandidates, candidates_var);
 }
 
 ParentConfigParams::ParentConfigParams(P_table *_parent_table) : parent_table(_parent_table), DefaultParent(NULL), policy()
@@ -241,6 +266,38 @@ ParentConfigParams::nextParent(HttpRequestData *rdata, ParentResult *result)
   }
 }
 
+void
+ParentConfigParams::recordParentResponse(ParentResult *result, ink_hrtime latency, bool failed)
+{
+  pRecord *pRec;
+
+  if (result->r != PARENT_SPECIFIED || result->rec == NULL || result->rec == extApiRecord) {
+    return;
+  }
+
+  if (result->last_lookup == ParentConsistentHash::SECONDARY) {
+    ink_assert(result->last_parent < (uint32_t)result->rec->num_secondary_parents);
+    pRec = result->rec->secondary_parents + result->last_parent;
+  } else {
+    ink_assert(result->last_parent < (uint32_t)result->rec->num_parents);
+    pRec = result->rec->parents + result->last_parent;
+  }
+
+  // New samples weigh 1/8th, as in the TCP round trip time estimate
+  if (!failed && latency > 0) {
+    if (pRec->latency == 0) {
+      pRec->latency = latency;
+    } else {
+      pRec->latency += (latency - pRec->latency) / 8;
+    }
+  }
+  pRec->errorRate += ((failed ? 1.0 : 0.0) - pRec->errorRate) / 8;
+  pRec->samples++;
+
+  Debug("parent_health", "Parent %s:%d latency %.2fms, error rate %.3f after %d samples", pRec->hostname, pRec->port,
+        (double)pRec->latency / HRTIME_MSECOND, pRec->errorRate, pRec->samples);
+}
+
 bool
 ParentConfigParams::parentExists(HttpRequestData *rdata)
 {
@@ -255,6 +312,347 @@ ParentConfigParams::parentExists(HttpRequestData *rdata)
   }
 }
 
+// void parent_probe_result(...)
+//
+//   Marks down a parent which failed a health check, so that requests
+//     do not retry it until a health check passes, and restores a
+//     marked down parent which passed one.
+//
+static void
+parent_probe_result(const ParentSelectionPolicy *policy, pRecord *pRec, bool up, time_t now)
+{
+  Debug("parent_health", "Health check of parent %s:%d %s", pRec->hostname, pRec->port, up ? "succeeded" : "failed");
+
+  if (up) {
+    if (pRec->failedAt != 0 || !pRec->available) {
+      ink_atomic_swap(&pRec->failedAt, (time_t)0);
+      ink_atomic_swap(&pRec->failCount, 0);
+      pRec->available = true;
+      Note("http parent proxy %s:%d restored by health check", pRec->hostname, pRec->port);
+    }
+  } else {
+    ProxyMutex *mutex = this_ethread()->mutex;
+
+    HTTP_INCREMENT_DYN_STAT(http_parent_proxy_health_check_failures_stat);
+    if (pRec->available) {
+      Note("http parent proxy %s:%d marked down by health check", pRec->hostname, pRec->port);
+    }
+    // Keep failedAt current, so that requests do not retry the parent until a health check passes
+    ink_atomic_swap(&pRec->failedAt, now);
+    ink_atomic_swap(&pRec->failCount, std::max(policy->FailThreshold, 1));
+    pRec->available = false;
+  }
+}
+
+// class ParentProbe
+//
+//   Health checks one parent with a TCP connect, after resolving its
+//     name through HostDB, on a net thread. The parent fails the check
+//     if it does not accept the connection within the health check
+//     timeout. The probe holds a reference to the configuration of the
+//     parent, so that the parent record outlives a reconfiguration,
+//     and deletes itself once it recorded the result.
+//
+class ParentProbe : public Continuation
+{
+public:
+  ParentProbe(ParentConfigParams *_params, pRecord *_pRec, time_t _now)
+    : Continuation(new_ProxyMutex()), params(_params), pRec(_pRec), now(_now), pending_action(NULL), timeout(NULL), vc(NULL),
+      buf(NULL)
+  {
+    params->refcount_inc();
+    SET_HANDLER(&ParentProbe::handle_event);
+  }
+
+  int handle_event(int event, void *data);
+
+private:
+  void connect(HostDBInfo *info);
+  void done(bool up);
+
+  ParentConfigParams *params;
+  pRecord *pRec;
+  time_t now;
+  Action *pending_action; // the HostDB lookup or the connect
+  Event *timeout;
+  NetVConnection *vc;
+  MIOBuffer *buf;
+};
+
+int
+ParentProbe::handle_event(int event, void *data)
+{
+  Action *action;
+
+  switch (event) {
+  case EVENT_IMMEDIATE:
+    HTTP_INCREMENT_DYN_STAT(http_parent_proxy_health_check_probes_stat);
+    timeout = this_ethread()->schedule_in(this, HRTIME_SECONDS(params->policy.HealthCheckTimeout));
+    // The lookup may call back, and finish the probe, before it returns
+    action = hostDBProcessor.getbyname_re(this, pRec->hostname, 0);
+    if (action != ACTION_RESULT_DONE) {
+      pending_action = action;
+    }
+    break;
+
+  case EVENT_HOST_DB_LOOKUP:
+    pending_action = NULL;
+    if (data == NULL) {
+      done(false);
+    } else {
+      connect(static_cast<HostDBInfo *>(data));
+    }
+    break;
+
+  case NET_EVENT_OPEN:
+    // The connect is under way, the first write ready tells its outcome
+    pending_action = NULL;
+    vc = static_cast<NetVConnection *>(data);
+    buf = new_empty_MIOBuffer();
+    vc->do_io_write(this, 1, buf->alloc_reader());
+    break;
+
+  case NET_EVENT_OPEN_FAILED:
+    pending_action = NULL;
+    done(false);
+    break;
+
+  case VC_EVENT_WRITE_READY: {
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(vc->get_socket(), SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+      err = errno;
+    }
+    done(err == 0);
+    break;
+  }
+
+  case EVENT_INTERVAL:
+    Debug("parent_health", "Health check of parent %s:%d timed out", pRec->hostname, pRec->port);
+    timeout = NULL;
+    done(false);
+    break;
+
+  default:
+    // VC_EVENT_ERROR, VC_EVENT_EOS and the vc timeouts
+    done(false);
+    break;
+  }
+
+  return EVENT_DONE;
+}
+
+void
+ParentProbe::connect(HostDBInfo *info)
+{
+  IpEndpoint target;
+  Action *action;
+
+  // Probe the first address of a round robin
+  if (info->is_rr()) {
+    HostDBRoundRobin *rr = info->rr();
+
+    if (rr == NULL || rr->rrcount <= 0) {
+      done(false);
+      return;
+    }
+    info = &rr->info[0];
+  }
+
+  ats_ip_copy(&target.sa, info->ip());
+  target.port() = htons(pRec->port);
+
+  // The connect may call back, and finish the probe, before it returns
+  action = netProcessor.connect_re(this, &target.sa);
+  if (action != ACTION_RESULT_DONE) {
+    pending_action = action;
+  }
+}
+
+void
+ParentProbe::done(bool up)
+{
+  parent_probe_result(&params->policy, pRec, up, now);
+
+  if (pending_action != NULL) {
+    pending_action->cancel();
+  }
+  if (timeout != NULL) {
+    timeout->cancel();
+  }
+  if (vc != NULL) {
+    vc->do_io_close();
+  }
+  if (buf != NULL) {
+    free_MIOBuffer(buf);
+  }
+
+  ParentConfig::release(params);
+  mutex.clear();
+  delete this;
+}
+
+// int find_parent_outliers(...)
+//
+//   Ejects the parents with a latency of more than the latency factor
+//     times the median of the set, or an error rate above the error
+//     rate threshold, keeping at least the share of parents set by
+//     the max ejection percent. The ejection time doubles for every
+//     consecutive ejection of a parent. Returns the number of parents
+//     ejected.
+//
+static int
+find_parent_outliers(const ParentSelectionPolicy *policy, pRecord *parents, int num_parents, time_t now)
+{
+  std::vector<ink_hrtime> latencies;
+  ink_hrtime median = 0;
+  int ejected = 0;
+
+  for (int i = 0; i < num_parents; i++) {
+    pRecord *pRec = parents + i;
+
+    if (pRec->ejectedUntil != 0 && !pRec->ejected(now)) {
+      // Start over, so that the averages from before the ejection do not eject the parent again
+      pRec->ejectedUntil = 0;
+      pRec->latency = 0;
+      pRec->errorRate = 0;
+      pRec->samples = 0;
+      Note("http parent proxy %s:%d returned from ejection", pRec->hostname, pRec->port);
+    }
+
+    if (pRec->ejected(now)) {
+      ejected++;
+    } else if (pRec->samples >= PARENT_OUTLIER_MIN_SAMPLES && pRec->latency > 0) {
+      latencies.push_back(pRec->latency);
+    }
+  }
+
+  if (latencies.size() >= 2) {
+    std::vector<ink_hrtime>::iterator mid = latencies.begin() + (latencies.size() - 1) / 2;
+
+    std::nth_element(latencies.begin(), mid, latencies.end());
+    median = *mid;
+  }
+
+  for (int i = 0; i < num_parents; i++) {
+    pRecord *pRec = parents + i;
+    bool slow, failing;
+
+    if (!pRec->available || pRec->ejected(now) || pRec->samples < PARENT_OUTLIER_MIN_SAMPLES) {
+      continue;
+    }
+
+    slow = policy->OutlierLatencyFactor > 0 && median > 0 && pRec->latency > median * policy->OutlierLatencyFactor;
+    failing = policy->OutlierErrorRate > 0 && pRec->errorRate > policy->OutlierErrorRate;
+
+    if (!slow && !failing) {
+      if (pRec->ejectCount > 0) {
+        pRec->ejectCount--;
+      }
+    } else if ((ejected + 1) * 100 <= num_parents * policy->OutlierMaxEjectionPercent) {
+      int ejection_time = policy->OutlierEjectionTime << std::min(pRec->ejectCount, PARENT_OUTLIER_MAX_BACKOFF);
+      ProxyMutex *mutex = this_ethread()->mutex;
+
+      pRec->ejectedUntil = now + ejection_time;
+      pRec->ejectCount++;
+      ejected++;
+      HTTP_INCREMENT_DYN_STAT(http_parent_proxy_outlier_ejections_stat);
+      Note("http parent proxy %s:%d ejected for %d seconds, latency %.2fms (median %.2fms), error rate %.2f", pRec->hostname,
+           pRec->port, ejection_time, (double)pRec->latency / HRTIME_MSECOND, (double)median / HRTIME_MSECOND, pRec->errorRate);
+    }
+  }
+
+  return ejected;
+}
+
+// class ParentHealthCheck
+//
+//   Runs every second on a task thread. Every health check interval
+//     it starts a ParentProbe for every parent. On every run, it ejects
+//     the parents whose response latency or error rate stand out from
+//     their set of parents for a while, and returns the parents whose
+//     ejection time is over.
+//
+class ParentHealthCheck : public Continuation
+{
+public:
+  ParentHealthCheck() : Continuation(new_ProxyMutex()), last_probe(0), last_ejected(0), last_down(0)
+  {
+    SET_HANDLER(&ParentHealthCheck::periodic);
+  }
+
+  int periodic(int event, Event *e);
+
+private:
+  time_t last_probe;
+  int last_ejected;
+  int last_down;
+};
+
+template <class Matcher>
+static void
+collect_parent_records(Matcher *matcher, std::vector<ParentRecord *> &records)
+{
+  if (matcher != NULL) {
+    for (int i = 0; i < matcher->getNumElements(); i++) {
+      records.push_back(matcher->getDataArray() + i);
+    }
+  }
+}
+
+int
+ParentHealthCheck::periodic(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  ParentConfigParams *params = ParentConfig::acquire();
+  const ParentSelectionPolicy *policy = &params->policy;
+  std::vector<ParentRecord *> records;
+  time_t now = time(NULL);
+  int ejected = 0, down = 0;
+
+  if (params->DefaultParent != NULL) {
+    records.push_back(params->DefaultParent);
+  }
+  collect_parent_records(params->parent_table->getReMatcher(), records);
+  collect_parent_records(params->parent_table->getUrlMatcher(), records);
+  collect_parent_records(params->parent_table->getHostMatcher(), records);
+  collect_parent_records(params->parent_table->getIPMatcher(), records);
+  collect_parent_records(params->parent_table->getHrMatcher(), records);
+
+  if (policy->HealthCheckInterval > 0 && now >= last_probe + policy->HealthCheckInterval) {
+    last_probe = now;
+    for (unsigned i = 0; i < records.size(); i++) {
+      for (int j = 0; j < records[i]->num_parents; j++) {
+        eventProcessor.schedule_imm(new ParentProbe(params, records[i]->parents + j, now), ET_NET);
+      }
+      for (int j = 0; j < records[i]->num_secondary_parents; j++) {
+        eventProcessor.schedule_imm(new ParentProbe(params, records[i]->secondary_parents + j, now), ET_NET);
+      }
+    }
+  }
+
+  for (unsigned i = 0; i < records.size(); i++) {
+    ejected += find_parent_outliers(policy, records[i]->parents, records[i]->num_parents, now);
+    ejected += find_parent_outliers(policy, records[i]->secondary_parents, records[i]->num_secondary_parents, now);
+
+    for (int j = 0; j < records[i]->num_parents; j++) {
+      down += !records[i]->parents[j].available;
+    }
+    for (int j = 0; j < records[i]->num_secondary_parents; j++) {
+      down += !records[i]->secondary_parents[j].available;
+    }
+  }
+
+  HTTP_SUM_DYN_STAT(http_current_parent_proxy_ejected_stat, ejected - last_ejected);
+  HTTP_SUM_DYN_STAT(http_current_parent_proxy_down_stat, down - last_down);
+  last_ejected = ejected;
+  last_down = down;
+
+  ParentConfig::release(params);
+
+  return EVENT_CONT;
+}
+
 int ParentConfig::m_id = 0;
 
 void
@@ -280,6 +678,17 @@ ParentConfig::startup()
 
   //   DNS Parent Only
   parentConfigUpdate->attach(dns_parent_only_var);
+
+  //   Health checks and outlier ejection
+  parentConfigUpdate->attach(health_interval_var);
+  parentConfigUpdate->attach(health_timeout_var);
+  parentConfigUpdate->attach(latency_factor_var);
+  parentConfigUpdate->attach(error_rate_var);
+  parentConfigUpdate->attach(ejection_time_var);
+  parentConfigUpdate->attach(max_ejection_var);
+  parentConfigUpdate->attach(candidates_var);
+
+  eventProcessor.schedule_every(new ParentHealthCheck, HRTIME_SECOND, ET_TASK);
 }
 
 void
@@ -358,11 +767,11 @@ ParentRecord::ProcessParents(char *val, bool isPrimary)
   if (numTok == 0) {
     return "No parents specified";
   }
-  // Allocate the parents array
+  // Allocate the parents array, zeroed for the health state
   if (isPrimary) {
-    this->parents = (pRecord *)ats_malloc(sizeof(pRecord) * numTok);
+    this->parents = (pRecord *)ats_calloc(numTok, sizeof(pRecord));
   } else {
-    this->secondary_parents = (pRecord *)ats_malloc(sizeof(pRecord) * numTok);
+    this->secondary_parents = (pRecord *)ats_calloc(numTok, sizeof(pRecord));
   }
 
   // Loop through the set of parents specified
@@ -532,6 +941,8 @@ ParentRecord::Init(matcher_line *line_info)
         round_robin = P_NO_ROUND_ROBIN;
       } else if (strcasecmp(val, "consistent_hash") == 0) {
         round_robin = P_CONSISTENT_HASH;
+      } else if (strcasecmp(val, "consistent_hash_maglev") == 0) {
+        round_robin = P_CONSISTENT_HASH_MAGLEV;
       } else {
         round_robin = P_NO_ROUND_ROBIN;
         errPtr = "invalid argument to round_robin directive";
@@ -608,7 +1019,11 @@ ParentRecord::Init(matcher_line *line_info)
     break;
   case P_CONSISTENT_HASH:
     TSDebug("parent_select", "allocating ParentConsistentHash() lookup strategy.");
-    selection_strategy = new ParentConsistentHash(this);
+    selection_strategy = new ParentConsistentHash(this, ATS_CONSISTENT_HASH_RING);
+    break;
+  case P_CONSISTENT_HASH_MAGLEV:
+    TSDebug("parent_select", "allocating ParentConsistentHash() Maglev lookup strategy.");
+    selection_strategy = new ParentConsistentHash(this, ATS_CONSISTENT_HASH_MAGLEV);
     break;
   default:
     ink_release_assert(0);
@@ -1085,6 +1500,84 @@ EXCLUSIVE_REGRESSION_TEST(PARENTSELECTION)(RegressionTest * /* t ATS_UNUSED */,
   FP sleep(1);
   RE(verify(result, PARENT_FAIL, NULL, 80), 177)
 
+  // Test 178 - 181, ejection and readmission of an outlier
+  tbl[0] = '\0';
+  ST(178)
+  T("dest_domain=. parent=red:80,orange:80,yellow:80,green:80 round_robin=strict\n")
+  REBUILD
+  params->policy.OutlierLatencyFactor = 3.0;
+  params->policy.OutlierErrorRate = 0;
+  params->policy.OutlierEjectionTime = 30;
+  params->policy.OutlierMaxEjectionPercent = 50;
+  REINIT br(request, "fruit_basket.net");
+  FP pRecord *outliers = result->rec->parents;
+  time_t now = time(NULL);
+  for (c = 0; c < 4; c++) {
+    outliers[c].samples = PARENT_OUTLIER_MIN_SAMPLES;
+    outliers[c].latency = (c == 3 ? 100 : 10) * HRTIME_MSECOND;
+  }
+  RE(find_parent_outliers(&params->policy, outliers, 4, now) == 1 && outliers[3].ejected(now) &&
+       outliers[3].ejectedUntil == now + 30,
+     178)
+
+  // Test 179, the ejected parent is skipped
+  ST(179)
+  red = orange = yellow = g = 0;
+  for (c = 0; c < 12; c++) {
+    REINIT br(request, "fruit_basket.net");
+    FP red += verify(result, PARENT_SPECIFIED, "red", 80);
+    orange += verify(result, PARENT_SPECIFIED, "orange", 80);
+    yellow += verify(result, PARENT_SPECIFIED, "yellow", 80);
+    g += verify(result, PARENT_SPECIFIED, "green", 80);
+  }
+  RE(red + orange + yellow == 12 && g == 0, 179)
+
+  // Test 180, the parent returns with its averages started over
+  ST(180)
+  now += 31;
+  RE(find_parent_outliers(&params->policy, outliers, 4, now) == 0 && !outliers[3].ejected(now) &&
+       outliers[3].ejectedUntil == 0 && outliers[3].latency == 0 && outliers[3].samples == 0,
+     180)
+
+  // Test 181, the ejection time doubles when it is ejected again
+  ST(181)
+  outliers[3].samples = PARENT_OUTLIER_MIN_SAMPLES;
+  outliers[3].latency = 100 * HRTIME_MSECOND;
+  RE(find_parent_outliers(&params->policy, outliers, 4, now) == 1 && outliers[3].ejectedUntil == now + 60, 181)
+
+  // Test 182, the lower latency of two candidates wins, the slowest never does
+  tbl[0] = '\0';
+  ST(182)
+  T("dest_domain=. parent=red:80,orange:80,yellow:80,green:80 round_robin=consistent_hash go_direct=false\n")
+  REBUILD
+  params->policy.ConsistentHashCandidates = 4;
+  REINIT br(request, "fruit_basket.net");
+  FP pRecord *loaded = result->rec->parents;
+  for (c = 0; c < 4; c++) {
+    loaded[c].samples = PARENT_OUTLIER_MIN_SAMPLES;
+    loaded[c].latency = (c + 1) * 10 * HRTIME_MSECOND;
+  }
+  red = orange = yellow = g = 0;
+  for (c = 0; c < 200; c++) {
+    REINIT br(request, "fruit_basket.net");
+    FP red += verify(result, PARENT_SPECIFIED, "red", 80);
+    orange += verify(result, PARENT_SPECIFIED, "orange", 80);
+    yellow += verify(result, PARENT_SPECIFIED, "yellow", 80);
+    g += verify(result, PARENT_SPECIFIED, "green", 80);
+  }
+  RE(red + orange + yellow == 200 && g == 0 && red > orange && orange > yellow, 182)
+
+  // Test 183, a parent without a latency average gets its share of the load, not all of it
+  ST(183)
+  loaded[3].samples = 0;
+  loaded[3].latency = 0;
+  red = orange = yellow = g = 0;
+  for (c = 0; c < 400; c++) {
+    REINIT br(request, "fruit_basket.net");
+    FP g += verify(result, PARENT_SPECIFIED, "green", 80);
+  }
+  RE(g > 40 && g < 200, 183)
+
   delete request;
   delete result;
   delete params;
@@ -61,6 +61,7 @@ enum ParentRR_t {
   P_STRICT_ROUND_ROBIN,
   P_HASH_ROUND_ROBIN,
   P_CONSISTENT_HASH,
+  P_CONSISTENT_HASH_MAGLEV,
 };
 
 // struct pRecord
@@ -76,6 +77,20 @@ struct pRecord : ATSConsistentHashNode {
   const char *scheme; // for which parent matches (if any)
   int idx;
   float weight;
+
+  // Passive health, and outlier ejection. Like failedAt and failCount,
+  //   these are updated without locks, the races are benign.
+  ink_hrtime latency; // EWMA of the time from connect to response header
+  float errorRate;    // EWMA of failed connects and 5xx responses
+  int32_t samples;    // responses since the EWMAs were (re)started
+  time_t ejectedUntil;
+  int32_t ejectCount; // consecutive ejections, doubles the ejection time
+
+  bool
+  ejected(time_t now) const
+  {
+    return ejectedUntil > now;
+  }
 };
 
 typedef ControlMatcher<ParentRecord, ParentResult> P_table;
@@ -155,6 +170,13 @@ struct ParentSelectionPolicy {
   int32_t ParentEnable;
   int32_t FailThreshold;
   int32_t DNS_ParentOnly;
+  int32_t HealthCheckInterval;
+  int32_t HealthCheckTimeout;
+  float OutlierLatencyFactor;
+  float OutlierErrorRate;
+  int32_t OutlierEjectionTime;
+  int32_t OutlierMaxEjectionPercent;
+  int32_t ConsistentHashCandidates;
   ParentSelectionPolicy();
 };
 
@@ -232,6 +254,13 @@ public:
     result->rec->selection_strategy->markParentUp(result);
   }
 
+  // void recordParentResponse(ParentResult *result, ink_hrtime latency, bool failed)
+  //
+  //    Feeds the outcome of a connection to the parent in result
+  //      into its latency and error rate averages
+  //
+  void recordParentResponse(ParentResult *result, ink_hrtime latency, bool failed);
+
   P_table *parent_table;
   ParentRecord *DefaultParent;
   ParentSelectionPolicy policy;
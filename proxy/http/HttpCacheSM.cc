@@ -57,16 +57,148 @@ HttpCacheAction::cancel(Continuation *c)
   ink_assert(this->cancelled == 0);
 
   this->cancelled = 1;
+  sm->collapse_wait_remove();
   if (sm->pending_action)
     sm->pending_action->cancel();
 }
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  Collapsed forwarding waiters
+//
+//  A collapsed reader which finds the object busy registers under its
+//  cache key. The transaction writing that key wakes the readers up as
+//  soon as it closes or aborts the cache write, so that they read the
+//  object or take over the write. The open read retry timer is only the
+//  fallback for a wake up that is missed or cannot take the reader lock.
+//
+//////////////////////////////////////////////////////////////////////////
+#define COLLAPSE_WAIT_BUCKETS 64
+
+struct CollapseWaitBucket {
+  CollapseWaitBucket() { ink_mutex_init(&mutex, "HttpCacheSM collapse wait"); }
+
+  ink_mutex mutex;
+  DLL<HttpCacheSM, HttpCacheSM::Link_collapse_link> waiters;
+};
+
+static CollapseWaitBucket collapse_wait_buckets[COLLAPSE_WAIT_BUCKETS];
+
+static inline CollapseWaitBucket *
+collapse_wait_bucket(const HttpCacheKey &key)
+{
+  return &collapse_wait_buckets[key.slice32(0) % COLLAPSE_WAIT_BUCKETS];
+}
+
 HttpCacheSM::HttpCacheSM()
   : Continuation(NULL), cache_read_vc(NULL), cache_write_vc(NULL), read_locked(false), write_locked(false),
     readwhilewrite_inprogress(false), master_sm(NULL), pending_action(NULL), captive_action(), open_read_cb(false),
     open_write_cb(false), open_read_tries(0), read_request_hdr(NULL), read_config(NULL), read_pin_in_cache(0), retry_write(true),
-    open_write_tries(0), lookup_url(NULL), lookup_max_recursive(0), current_lookup_level(0)
+    open_write_tries(0), lookup_url(NULL), lookup_max_recursive(0), current_lookup_level(0), collapsed(false), collapse_start(0)
+{
+}
+
+void
+HttpCacheSM::set_collapsed()
+{
+  if (!collapsed) {
+    collapsed = true;
+    collapse_start = Thread::get_hrtime();
+    HTTP_INCREMENT_DYN_STAT(http_cache_collapsed_requests_stat);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  HttpCacheSM::collapse_wait()
+//
+//  With collapsed forwarding, a reader that finds the object being
+//  written keeps retrying the open read, so that it attaches to the
+//  writer (read while writer) or reads the object once it is complete,
+//  for up to proxy.config.http.cache.collapsed_forwarding.max_wait.
+//
+//////////////////////////////////////////////////////////////////////////
+bool
+HttpCacheSM::collapse_wait()
+{
+  const HttpConfigParams *params = master_sm->t_state.http_config_param;
+
+  if (!params->cache_collapsed_forwarding) {
+    return false;
+  }
+  set_collapsed();
+  return Thread::get_hrtime() - collapse_start < HRTIME_MSECONDS(params->cache_collapsed_forwarding_max_wait);
+}
+
+void
+HttpCacheSM::collapse_wait_add()
+{
+  CollapseWaitBucket *b = collapse_wait_bucket(cache_key);
+
+  ink_assert(pending_action != NULL);
+  ink_mutex_acquire(&b->mutex);
+  if (!b->waiters.in(this)) {
+    b->waiters.push(this);
+  }
+  ink_mutex_release(&b->mutex);
+}
+
+void
+HttpCacheSM::collapse_wait_remove()
+{
+  if (!collapsed) {
+    return;
+  }
+
+  CollapseWaitBucket *b = collapse_wait_bucket(cache_key);
+
+  ink_mutex_acquire(&b->mutex);
+  if (b->waiters.in(this)) {
+    b->waiters.remove(this);
+  }
+  ink_mutex_release(&b->mutex);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  HttpCacheSM::collapse_wake()
+//
+//  Called by the writer when its cache write goes away. Replace the
+//  retry timer of every reader waiting on the same key with an immediate
+//  retry. A reader whose lock is busy is left to its timer.
+//
+//////////////////////////////////////////////////////////////////////////
+void
+HttpCacheSM::collapse_wake()
 {
+  if (!master_sm->t_state.http_config_param->cache_collapsed_forwarding) {
+    return;
+  }
+
+  CollapseWaitBucket *b = collapse_wait_bucket(cache_key);
+  EThread *ethread = this_ethread();
+  HttpCacheSM *w, *next;
+
+  ink_mutex_acquire(&b->mutex);
+  for (w = b->waiters.head; w; w = next) {
+    next = b->waiters.next(w);
+    if (!(w->cache_key.hash == cache_key.hash)) {
+      continue;
+    }
+
+    MUTEX_TRY_LOCK(lock, w->mutex, ethread);
+    if (!lock.is_locked()) {
+      continue;
+    }
+
+    Event *e = static_cast<Event *>(w->pending_action);
+    Debug("http_cache", "[%" PRId64 "] [HttpCacheSM::collapse_wake] waking collapsed reader [%" PRId64 "]", master_sm->sm_id,
+          w->master_sm->sm_id);
+    b->waiters.remove(w);
+    w->pending_action = e->ethread->schedule_imm(w, EVENT_INTERVAL);
+    e->cancel();
+  }
+  ink_mutex_release(&b->mutex);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -119,10 +251,13 @@ HttpCacheSM::state_cache_open_read(int event, void *data)
   case CACHE_EVENT_OPEN_READ_FAILED:
     if (data == (void *)-ECACHE_DOC_BUSY) {
       // Somebody else is writing the object
-      if (open_read_tries <= master_sm->t_state.txn_conf->max_cache_open_read_retries) {
+      if (open_read_tries <= master_sm->t_state.txn_conf->max_cache_open_read_retries || collapse_wait()) {
         // Retry to read; maybe the update finishes in time
         open_read_cb = false;
         do_schedule_in();
+        if (collapsed) {
+          collapse_wait_add();
+        }
       } else {
         // Give up; the update didn't finish in time
         // HttpSM will inform HttpTransact to 'proxy-only'
@@ -140,7 +275,8 @@ HttpCacheSM::state_cache_open_read(int event, void *data)
     // Retry the cache open read if the number retries is less
     // than or equal to the max number of open read retries,
     // else treat as a cache miss.
-    ink_assert(open_read_tries <= master_sm->t_state.txn_conf->max_cache_open_read_retries || write_locked);
+    ink_assert(open_read_tries <= master_sm->t_state.txn_conf->max_cache_open_read_retries || write_locked || collapsed);
+    collapse_wait_remove();
     Debug("http_cache", "[%" PRId64 "] [state_cache_open_read] cache open read failure %d. "
                         "retrying cache open read...",
           master_sm->sm_id, open_read_tries);
@@ -321,6 +457,14 @@ HttpCacheSM::open_write(const HttpCacheKey *key, URL *url, HTTPHdr *request, Cac
     master_sm->handleEvent(CACHE_EVENT_OPEN_WRITE_FAILED, (void *)-ECACHE_DOC_BUSY);
     return ACTION_RESULT_DONE;
   }
+  // A document which is not in the cache yet is only written once the
+  // admission filter has seen enough requests for it.
+  if (!old_info && !allow_multiple && open_write_tries == 1 &&
+      !cacheProcessor.admit(key, master_sm->t_state.txn_conf->cache_admission_filter)) {
+    Debug("http_cache", "[%" PRId64 "] [HttpCacheSM::open_write] not admitted to the cache", master_sm->sm_id);
+    master_sm->handleEvent(CACHE_EVENT_OPEN_WRITE_FAILED, (void *)-ECACHE_NOT_ADMITTED);
+    return ACTION_RESULT_DONE;
+  }
 
   Action *action_handle =
     cacheProcessor.open_write(this, 0, key, master_sm->t_state.cache_control.cluster_cache_local, request,
@@ -134,6 +134,22 @@ public:
     return open_write_tries;
   }
 
+  // Collapsed forwarding: this transaction found another one fetching
+  // the same object, and waits to read it from the cache instead of
+  // going to the origin server itself.
+  bool
+  is_collapsed() const
+  {
+    return collapsed;
+  }
+
+  void set_collapsed();
+  void collapse_wait_remove();
+  void collapse_wake();
+
+  // Collapsed readers waiting for the writer of the same cache key
+  LINK(HttpCacheSM, collapse_link);
+
   int
   get_volume_number()
   {
@@ -156,6 +172,7 @@ public:
       HTTP_DECREMENT_DYN_STAT(http_current_cache_connections_stat);
       cache_write_vc->do_io(VIO::ABORT);
       cache_write_vc = NULL;
+      collapse_wake();
     }
   }
   inline void
@@ -165,6 +182,7 @@ public:
       HTTP_DECREMENT_DYN_STAT(http_current_cache_connections_stat);
       cache_write_vc->do_io(VIO::CLOSE);
       cache_write_vc = NULL;
+      collapse_wake();
     }
   }
   inline void
@@ -188,6 +206,8 @@ public:
 private:
   void do_schedule_in();
   Action *do_cache_open_read(const HttpCacheKey &);
+  bool collapse_wait();
+  void collapse_wait_add();
 
   int state_cache_open_read(int event, void *data);
   int state_cache_open_write(int event, void *data);
@@ -213,6 +233,10 @@ private:
   // to keep track of multiple cache lookups
   int lookup_max_recursive;
   int current_lookup_level;
+
+  // Collapsed forwarding parameters
+  bool collapsed;
+  ink_hrtime collapse_start;
 };
 
 #endif
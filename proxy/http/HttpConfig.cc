@@ -51,6 +51,7 @@
 
 
 RecRawStatBlock *http_rsb;
+RecRawHistogramBlock *http_rhb;
 #define HTTP_CLEAR_DYN_STAT(x)          \
   do {                                  \
     RecSetRawStatSum(http_rsb, x, 0);   \
@@ -235,12 +236,40 @@ register_stat_callbacks()
   RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.current_parent_proxy_connections", RECD_INT, RECP_NON_PERSISTENT,
                      (int)http_current_parent_proxy_connections_stat, RecRawStatSyncSum);
   HTTP_CLEAR_DYN_STAT(http_current_parent_proxy_connections_stat);
+
+  // Parent health checks and outlier ejection stats
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.parent_proxy.health_check_probes", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_parent_proxy_health_check_probes_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.parent_proxy.health_check_failures", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_parent_proxy_health_check_failures_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.parent_proxy.outlier_ejections", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_parent_proxy_outlier_ejections_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.current_parent_proxy_ejected", RECD_INT, RECP_NON_PERSISTENT,
+                     (int)http_current_parent_proxy_ejected_stat, RecRawStatSyncSum);
+  HTTP_CLEAR_DYN_STAT(http_current_parent_proxy_ejected_stat);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.current_parent_proxy_down", RECD_INT, RECP_NON_PERSISTENT,
+                     (int)http_current_parent_proxy_down_stat, RecRawStatSyncSum);
+  HTTP_CLEAR_DYN_STAT(http_current_parent_proxy_down_stat);
   RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.current_server_connections", RECD_INT, RECP_NON_PERSISTENT,
                      (int)http_current_server_connections_stat, RecRawStatSyncSum);
   HTTP_CLEAR_DYN_STAT(http_current_server_connections_stat);
   RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.current_cache_connections", RECD_INT, RECP_NON_PERSISTENT,
                      (int)http_current_cache_connections_stat, RecRawStatSyncSum);
   HTTP_CLEAR_DYN_STAT(http_current_cache_connections_stat);
+
+  // Server session pool stats
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.hits", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_server_session_pool_hits_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.misses", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_server_session_pool_misses_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.evictions", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_server_session_pool_evictions_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.prewarm_connects", RECD_COUNTER,
+                     RECP_PERSISTENT, (int)http_server_session_pool_prewarm_connects_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.prewarm_failures", RECD_COUNTER,
+                     RECP_PERSISTENT, (int)http_server_session_pool_prewarm_failures_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.server_session_pool.prewarm_hits", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_server_session_pool_prewarm_hits_stat, RecRawStatSyncCount);
   RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.avg_transactions_per_client_connection", RECD_FLOAT,
                      RECP_PERSISTENT, (int)http_transactions_per_client_con, RecRawStatSyncAvg);
 
@@ -858,6 +887,24 @@ register_stat_callbacks()
                      (int)http_sm_start_time_stat, RecRawStatSyncSum);
   RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.milestone.sm_finish", RECD_COUNTER, RECP_PERSISTENT,
                      (int)http_sm_finish_time_stat, RecRawStatSyncSum);
+
+  // collapsed forwarding
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.cache_collapsed_requests", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_cache_collapsed_requests_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS, "proxy.process.http.cache_collapsed_hits", RECD_COUNTER, RECP_PERSISTENT,
+                     (int)http_cache_collapsed_hits_stat, RecRawStatSyncCount);
+
+  // milestone latency histograms
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.total", (int)http_total_time_histogram);
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.ua_first_byte",
+                          (int)http_ua_first_byte_time_histogram);
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.dns_lookup", (int)http_dns_lookup_time_histogram);
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.cache_open_read",
+                          (int)http_cache_open_read_time_histogram);
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.server_connect",
+                          (int)http_server_connect_time_histogram);
+  RecRegisterRawHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.latency.server_first_byte",
+                          (int)http_server_first_byte_time_histogram);
 }
 
 
@@ -870,6 +917,7 @@ void
 HttpConfig::startup()
 {
   http_rsb = RecAllocateRawStatBlock((int)http_stat_count);
+  http_rhb = RecAllocateRawHistogramBlock((int)http_histogram_count);
   register_stat_callbacks();
 
   HttpConfigParams &c = m_master;
@@ -934,6 +982,15 @@ HttpConfig::startup()
   http_config_enum_read("proxy.config.http.server_session_sharing.match", SessionSharingMatchStrings,
                         c.oride.server_session_sharing_match);
   http_config_enum_read("proxy.config.http.server_session_sharing.pool", SessionSharingPoolStrings, c.server_session_sharing_pool);
+  HttpEstablishStaticConfigLongLong(c.server_session_max_idle, "proxy.config.http.server_session_sharing.max_idle");
+  HttpEstablishStaticConfigLongLong(c.server_session_max_idle_per_origin,
+                                    "proxy.config.http.server_session_sharing.max_idle_per_origin");
+  HttpEstablishStaticConfigLongLong(c.server_session_prewarm_min_connections,
+                                    "proxy.config.http.server_session_sharing.prewarm.min_connections");
+  HttpEstablishStaticConfigLongLong(c.server_session_prewarm_max_origins,
+                                    "proxy.config.http.server_session_sharing.prewarm.max_origins");
+  HttpEstablishStaticConfigLongLong(c.server_session_prewarm_origin_timeout,
+                                    "proxy.config.http.server_session_sharing.prewarm.origin_timeout");
 
   HttpEstablishStaticConfigByte(c.oride.auth_server_session_private, "proxy.config.http.auth_server_session_private");
 
@@ -1037,6 +1094,8 @@ HttpConfig::startup()
   HttpEstablishStaticConfigByte(c.oride.cache_urls_that_look_dynamic, "proxy.config.http.cache.cache_urls_that_look_dynamic");
   HttpEstablishStaticConfigByte(c.cache_enable_default_vary_headers, "proxy.config.http.cache.enable_default_vary_headers");
   HttpEstablishStaticConfigByte(c.cache_post_method, "proxy.config.http.cache.post_method");
+  HttpEstablishStaticConfigByte(c.cache_collapsed_forwarding, "proxy.config.http.cache.collapsed_forwarding");
+  HttpEstablishStaticConfigLongLong(c.cache_collapsed_forwarding_max_wait, "proxy.config.http.cache.collapsed_forwarding.max_wait");
 
   HttpEstablishStaticConfigByte(c.ignore_accept_mismatch, "proxy.config.http.cache.ignore_accept_mismatch");
   HttpEstablishStaticConfigByte(c.ignore_accept_language_mismatch, "proxy.config.http.cache.ignore_accept_language_mismatch");
@@ -1052,6 +1111,7 @@ HttpConfig::startup()
   HttpEstablishStaticConfigByte(c.oride.cache_required_headers, "proxy.config.http.cache.required_headers");
   HttpEstablishStaticConfigByte(c.oride.cache_range_lookup, "proxy.config.http.cache.range.lookup");
   HttpEstablishStaticConfigByte(c.oride.cache_range_write, "proxy.config.http.cache.range.write");
+  HttpEstablishStaticConfigByte(c.oride.cache_admission_filter, "proxy.config.http.cache.admission_filter");
 
   HttpEstablishStaticConfigStringAlloc(c.connect_ports_string, "proxy.config.http.connect_ports");
 
@@ -1074,6 +1134,7 @@ HttpConfig::startup()
   HttpEstablishStaticConfigByte(c.record_cop_page, "proxy.config.http.record_heartbeat");
 
   HttpEstablishStaticConfigByte(c.oride.send_http11_requests, "proxy.config.http.send_http11_requests");
+  HttpEstablishStaticConfigByte(c.oride.server_http2, "proxy.config.http.server_http2");
 
   // HTTP Referer Filtering
   HttpEstablishStaticConfigByte(c.referer_filter_enabled, "proxy.config.http.referer_filter");
@@ -1211,6 +1272,11 @@ HttpConfig::reconfigure()
 
   params->oride.server_session_sharing_match = m_master.oride.server_session_sharing_match;
   params->server_session_sharing_pool = m_master.server_session_sharing_pool;
+  params->server_session_max_idle = m_master.server_session_max_idle;
+  params->server_session_max_idle_per_origin = m_master.server_session_max_idle_per_origin;
+  params->server_session_prewarm_min_connections = m_master.server_session_prewarm_min_connections;
+  params->server_session_prewarm_max_origins = m_master.server_session_prewarm_max_origins;
+  params->server_session_prewarm_origin_timeout = m_master.server_session_prewarm_origin_timeout;
   params->oride.keep_alive_post_out = m_master.oride.keep_alive_post_out;
 
   params->oride.keep_alive_no_activity_timeout_in = m_master.oride.keep_alive_no_activity_timeout_in;
@@ -1301,6 +1367,8 @@ HttpConfig::reconfigure()
   params->oride.cache_urls_that_look_dynamic = INT_TO_BOOL(m_master.oride.cache_urls_that_look_dynamic);
   params->cache_enable_default_vary_headers = INT_TO_BOOL(m_master.cache_enable_default_vary_headers);
   params->cache_post_method = INT_TO_BOOL(m_master.cache_post_method);
+  params->cache_collapsed_forwarding = INT_TO_BOOL(m_master.cache_collapsed_forwarding);
+  params->cache_collapsed_forwarding_max_wait = m_master.cache_collapsed_forwarding_max_wait;
 
   params->ignore_accept_mismatch = m_master.ignore_accept_mismatch;
   params->ignore_accept_language_mismatch = m_master.ignore_accept_language_mismatch;
@@ -1318,6 +1386,7 @@ HttpConfig::reconfigure()
   params->oride.cache_required_headers = m_master.oride.cache_required_headers;
   params->oride.cache_range_lookup = INT_TO_BOOL(m_master.oride.cache_range_lookup);
   params->oride.cache_range_write = INT_TO_BOOL(m_master.oride.cache_range_write);
+  params->oride.cache_admission_filter = INT_TO_BOOL(m_master.oride.cache_admission_filter);
 
   params->connect_ports_string = ats_strdup(m_master.connect_ports_string);
   params->connect_ports = parse_ports_list(params->connect_ports_string);
@@ -1333,6 +1402,7 @@ HttpConfig::reconfigure()
   params->oride.slow_log_threshold = m_master.oride.slow_log_threshold;
   params->record_cop_page = INT_TO_BOOL(m_master.record_cop_page);
   params->oride.send_http11_requests = m_master.oride.send_http11_requests;
+  params->oride.server_http2 = m_master.oride.server_http2;
   params->oride.doc_in_cache_skip_dns = INT_TO_BOOL(m_master.oride.doc_in_cache_skip_dns);
   params->oride.default_buffer_size_index = m_master.oride.default_buffer_size_index;
   params->oride.default_buffer_water_mark = m_master.oride.default_buffer_water_mark;
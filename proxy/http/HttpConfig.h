@@ -75,9 +75,22 @@ enum {
   http_total_server_connections_stat,
   http_total_parent_proxy_connections_stat,
   http_current_parent_proxy_connections_stat,
+  http_parent_proxy_health_check_probes_stat,
+  http_parent_proxy_health_check_failures_stat,
+  http_parent_proxy_outlier_ejections_stat,
+  http_current_parent_proxy_ejected_stat,
+  http_current_parent_proxy_down_stat,
   http_current_server_connections_stat,
   http_current_cache_connections_stat,
 
+  // Server session pool stats
+  http_server_session_pool_hits_stat,
+  http_server_session_pool_misses_stat,
+  http_server_session_pool_evictions_stat,
+  http_server_session_pool_prewarm_connects_stat,
+  http_server_session_pool_prewarm_failures_stat,
+  http_server_session_pool_prewarm_hits_stat,
+
   // Http K-A Stats
   http_transactions_per_client_con,
   http_transactions_per_server_con,
@@ -312,10 +325,27 @@ enum {
   http_sm_start_time_stat,
   http_sm_finish_time_stat,
 
+  // collapsed forwarding
+  http_cache_collapsed_requests_stat,
+  http_cache_collapsed_hits_stat,
+
   http_stat_count
 };
 
+// Latency histograms between transaction milestones, in microseconds
+enum {
+  http_total_time_histogram,
+  http_ua_first_byte_time_histogram,
+  http_dns_lookup_time_histogram,
+  http_cache_open_read_time_histogram,
+  http_server_connect_time_histogram,
+  http_server_first_byte_time_histogram,
+
+  http_histogram_count
+};
+
 extern RecRawStatBlock *http_rsb;
+extern RecRawHistogramBlock *http_rhb;
 
 /* Stats should only be accessed using these macros */
 #define HTTP_INCREMENT_DYN_STAT(x) RecIncrRawStat(http_rsb, mutex->thread_holding, (int)x, 1)
@@ -332,6 +362,8 @@ extern RecRawStatBlock *http_rsb;
 #define HTTP_READ_DYN_SUM(x, S) RecGetRawStatSum(http_rsb, (int)x, &S) // This aggregates threads too
 #define HTTP_READ_GLOBAL_DYN_SUM(x, S) RecGetGlobalRawStatSum(http_rsb, (int)x, &S)
 
+#define HTTP_RECORD_HISTOGRAM(x, y) RecRecordRawHistogram(http_rhb, this_ethread(), (int)x, (uint64_t)y)
+
 /////////////////////////////////////////////////////////////
 //
 // struct HttpConfigPortRange
@@ -367,23 +399,24 @@ struct OverridableHttpConfigParams {
       fwd_proxy_auth_to_parent(0), insert_age_in_response(1), anonymize_remove_from(0), anonymize_remove_referer(0),
       anonymize_remove_user_agent(0), anonymize_remove_cookie(0), anonymize_remove_client_ip(0), anonymize_insert_client_ip(1),
       proxy_response_server_enabled(1), proxy_response_hsts_max_age(-1), proxy_response_hsts_include_subdomains(0),
-      insert_squid_x_forwarded_for(1), send_http11_requests(1), cache_http(1), cache_cluster_cache_local(0),
+      insert_squid_x_forwarded_for(1), send_http11_requests(1), server_http2(0), cache_http(1), cache_cluster_cache_local(0),
       cache_ignore_client_no_cache(1), cache_ignore_client_cc_max_age(0), cache_ims_on_client_no_cache(1),
       cache_ignore_server_no_cache(0), cache_responses_to_cookies(1), cache_ignore_auth(0), cache_urls_that_look_dynamic(1),
-      cache_required_headers(2), cache_range_lookup(1), cache_range_write(0), insert_request_via_string(1),
-      insert_response_via_string(0), doc_in_cache_skip_dns(1), flow_control_enabled(0), accept_encoding_filter_enabled(0),
-      normalize_ae_gzip(0), negative_caching_lifetime(1800), negative_revalidating_lifetime(1800), sock_recv_buffer_size_out(0),
-      sock_send_buffer_size_out(0), sock_option_flag_out(0), sock_packet_mark_out(0), sock_packet_tos_out(0),
-      server_tcp_init_cwnd(0), request_hdr_max_size(131072), response_hdr_max_size(131072), post_check_content_length_enabled(1),
-      cache_heuristic_min_lifetime(3600), cache_heuristic_max_lifetime(86400), cache_guaranteed_min_lifetime(0),
-      cache_guaranteed_max_lifetime(31536000), cache_max_stale_age(604800), keep_alive_no_activity_timeout_in(115),
-      keep_alive_no_activity_timeout_out(120), transaction_no_activity_timeout_in(30), transaction_no_activity_timeout_out(30),
-      transaction_active_timeout_out(0), origin_max_connections(0), connect_attempts_max_retries(0),
-      connect_attempts_max_retries_dead_server(3), connect_attempts_rr_retries(3), connect_attempts_timeout(30),
-      post_connect_attempts_timeout(1800), down_server_timeout(300), client_abort_threshold(10), freshness_fuzz_time(240),
-      freshness_fuzz_min_time(0), max_cache_open_read_retries(-1), cache_open_read_retry_time(10), cache_generation_number(-1),
-      max_cache_open_write_retries(1), background_fill_active_timeout(60), http_chunking_size(4096), flow_high_water_mark(0),
-      flow_low_water_mark(0), default_buffer_size_index(8), default_buffer_water_mark(32768), slow_log_threshold(0),
+      cache_required_headers(2), cache_range_lookup(1), cache_range_write(0), cache_admission_filter(0),
+      insert_request_via_string(1), insert_response_via_string(0), doc_in_cache_skip_dns(1), flow_control_enabled(0),
+      accept_encoding_filter_enabled(0), normalize_ae_gzip(0), negative_caching_lifetime(1800),
+      negative_revalidating_lifetime(1800), sock_recv_buffer_size_out(0), sock_send_buffer_size_out(0), sock_option_flag_out(0),
+      sock_packet_mark_out(0), sock_packet_tos_out(0), server_tcp_init_cwnd(0), request_hdr_max_size(131072),
+      response_hdr_max_size(131072), post_check_content_length_enabled(1), cache_heuristic_min_lifetime(3600),
+      cache_heuristic_max_lifetime(86400), cache_guaranteed_min_lifetime(0), cache_guaranteed_max_lifetime(31536000),
+      cache_max_stale_age(604800), keep_alive_no_activity_timeout_in(115), keep_alive_no_activity_timeout_out(120),
+      transaction_no_activity_timeout_in(30), transaction_no_activity_timeout_out(30), transaction_active_timeout_out(0),
+      origin_max_connections(0), connect_attempts_max_retries(0), connect_attempts_max_retries_dead_server(3),
+      connect_attempts_rr_retries(3), connect_attempts_timeout(30), post_connect_attempts_timeout(1800), down_server_timeout(300),
+      client_abort_threshold(10), freshness_fuzz_time(240), freshness_fuzz_min_time(0), max_cache_open_read_retries(-1),
+      cache_open_read_retry_time(10), cache_generation_number(-1), max_cache_open_write_retries(1),
+      background_fill_active_timeout(60), http_chunking_size(4096), flow_high_water_mark(0), flow_low_water_mark(0),
+      default_buffer_size_index(8), default_buffer_water_mark(32768), slow_log_threshold(0),
 
       // Strings / floats must come last
       body_factory_template_base(NULL), body_factory_template_base_len(0), proxy_response_server_string(NULL),
@@ -443,6 +476,7 @@ struct OverridableHttpConfigParams {
   //  Version Hell    //
   //////////////////////
   MgmtByte send_http11_requests;
+  MgmtByte server_http2;
 
   ///////////////////
   // cache control //
@@ -459,6 +493,7 @@ struct OverridableHttpConfigParams {
   MgmtByte cache_required_headers;
   MgmtByte cache_range_lookup;
   MgmtByte cache_range_write;
+  MgmtByte cache_admission_filter;
 
   MgmtByte insert_request_via_string;
   MgmtByte insert_response_via_string;
@@ -693,6 +728,8 @@ public:
   ///////////////////
   MgmtByte cache_enable_default_vary_headers;
   MgmtByte cache_post_method;
+  MgmtByte cache_collapsed_forwarding;
+  MgmtInt cache_collapsed_forwarding_max_wait; // time is in mseconds
 
   ////////////////////////////////////////////
   // CONNECT ports (used to be == ssl_ports //
@@ -752,6 +789,11 @@ public:
   MgmtInt max_post_size;
 
   MgmtByte server_session_sharing_pool;
+  MgmtInt server_session_max_idle;
+  MgmtInt server_session_max_idle_per_origin;
+  MgmtInt server_session_prewarm_min_connections;
+  MgmtInt server_session_prewarm_max_origins;
+  MgmtInt server_session_prewarm_origin_timeout;
 
   OverridableHttpConfigParams oride;
 
@@ -854,13 +896,16 @@ inline HttpConfigParams::HttpConfigParams()
     session_auth_cache_keep_alive_enabled(1), transaction_active_timeout_in(900), accept_no_activity_timeout(120),
     parent_connect_attempts(4), per_parent_connect_attempts(2), parent_connect_timeout(30), anonymize_other_header_list(NULL),
     enable_http_stats(1), icp_enabled(0), stale_icp_enabled(0), cache_vary_default_text(NULL), cache_vary_default_images(NULL),
-    cache_vary_default_other(NULL), cache_enable_default_vary_headers(0), cache_post_method(0), connect_ports_string(NULL),
+    cache_vary_default_other(NULL), cache_enable_default_vary_headers(0), cache_post_method(0), cache_collapsed_forwarding(0),
+    cache_collapsed_forwarding_max_wait(2000), connect_ports_string(NULL),
     connect_ports(NULL), push_method_enabled(0), referer_filter_enabled(0), referer_format_redirect(0), reverse_proxy_enabled(0),
     url_remap_required(1), record_cop_page(0), errors_log_error_pages(1), enable_http_info(0), cluster_time_delta(0),
     redirection_host_no_port(1), post_copy_size(2048), ignore_accept_mismatch(0), ignore_accept_language_mismatch(0),
     ignore_accept_encoding_mismatch(0), ignore_accept_charset_mismatch(0), send_100_continue_response(0),
     disallow_post_100_continue(0), parser_allow_non_http(1), max_post_size(0),
-    server_session_sharing_pool(TS_SERVER_SESSION_SHARING_POOL_THREAD), synthetic_port(0)
+    server_session_sharing_pool(TS_SERVER_SESSION_SHARING_POOL_THREAD), server_session_max_idle(0),
+    server_session_max_idle_per_origin(0), server_session_prewarm_min_connections(0), server_session_prewarm_max_origins(256),
+    server_session_prewarm_origin_timeout(300), synthetic_port(0)
 {
 }
 
@@ -270,9 +270,10 @@ HttpSM::HttpSM()
     enable_redirection(false), redirect_url(NULL), redirect_url_len(0), redirection_tries(0), transfered_bytes(0),
     post_failed(false), debug_on(false), plugin_tunnel_type(HTTP_NO_PLUGIN_TUNNEL), plugin_tunnel(NULL), reentrancy_count(0),
     history_pos(0), tunnel(), ua_entry(NULL), ua_session(NULL), background_fill(BACKGROUND_FILL_NONE), ua_raw_buffer_reader(NULL),
-    server_entry(NULL), server_session(NULL), will_be_private_ss(false), shared_session_retries(0), server_buffer_reader(NULL),
-    transform_info(), post_transform_info(), has_active_plugin_agents(false), second_cache_sm(NULL), default_handler(NULL),
-    pending_action(NULL), historical_action(NULL), last_action(HttpTransact::SM_ACTION_UNDEFINED),
+    server_entry(NULL), server_session(NULL), will_be_private_ss(false), opening_http2_stream(false), shared_session_retries(0),
+    server_buffer_reader(NULL),
+    transform_info(), post_transform_info(), has_active_plugin_agents(false), second_cache_sm(NULL), cache_lookup_restarted(false),
+    default_handler(NULL), pending_action(NULL), historical_action(NULL), last_action(HttpTransact::SM_ACTION_UNDEFINED),
     // TODO:  Now that bodies can be empty, should the body counters be set to -1 ? TS-2213
     client_request_hdr_bytes(0), client_request_body_bytes(0), server_request_hdr_bytes(0), server_request_body_bytes(0),
     server_response_hdr_bytes(0), server_response_body_bytes(0), client_response_hdr_bytes(0), client_response_body_bytes(0),
@@ -1630,12 +1631,16 @@ HttpSM::state_http_server_open(int event, void *data)
                 httpServerSessionAllocator.alloc();
     session->sharing_pool = static_cast<TSServerSessionSharingPoolType>(t_state.http_config_param->server_session_sharing_pool);
     session->sharing_match = static_cast<TSServerSessionSharingMatchType>(t_state.txn_conf->server_session_sharing_match);
+    // A session on a HTTP/2 stream is counted by its connection instead.
+    session->http2_stream = opening_http2_stream;
+    opening_http2_stream = false;
     // If origin_max_connections or origin_min_keep_alive_connections is
     // set then we are metering the max and or min number
     // of connections per host.  Set enable_origin_connection_limiting
     // to true in the server session so it will increment and decrement
     // the connection count.
-    if (t_state.txn_conf->origin_max_connections > 0 || t_state.http_config_param->origin_min_keep_alive_connections > 0) {
+    if (!session->http2_stream &&
+        (t_state.txn_conf->origin_max_connections > 0 || t_state.http_config_param->origin_min_keep_alive_connections > 0)) {
       DebugSM("http_ss", "[%" PRId64 "] max number of connections: %" PRIu64, sm_id, t_state.txn_conf->origin_max_connections);
       session->enable_origin_connection_limiting = true;
     }
@@ -2381,6 +2386,30 @@ HttpSM::state_cache_open_write(int event, void *data)
       t_state.cache_info.write_lock_state = HttpTransact::CACHE_WL_FAIL;
       break;
     }
+    if ((intptr_t)data == -ECACHE_NOT_ADMITTED) {
+      // The admission filter turned the document away, fetch it without
+      // writing it to the cache.
+      t_state.cache_open_write_fail_action = HttpTransact::CACHE_WL_FAIL_ACTION_DEFAULT;
+      t_state.cache_info.write_lock_state = HttpTransact::CACHE_WL_FAIL;
+      break;
+    }
+    if (t_state.http_config_param->cache_collapsed_forwarding && is_collapsible_write_fail()) {
+      // Another transaction is fetching this object from the origin
+      // server. Go back to the cache and wait for its response, instead
+      // of fetching the object a second time.
+      DebugSM("http_cache", "[%" PRId64 "] cache open write failed on a miss, collapsing onto the writer", sm_id);
+      cache_sm.set_collapsed();
+      cache_lookup_restarted = true;
+      t_state.request_sent_time = UNDEFINED_TIME;
+      t_state.response_received_time = UNDEFINED_TIME;
+      t_state.cache_info.action = HttpTransact::CACHE_DO_LOOKUP;
+      t_state.cache_info.write_lock_state = HttpTransact::CACHE_WL_INIT;
+      t_state.hdr_info.server_request.destroy();
+      t_state.transact_return_point = NULL;
+      HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_cache_open_read);
+      do_cache_lookup_and_read();
+      return 0;
+    }
     if (t_state.txn_conf->cache_open_write_fail_action == HttpTransact::CACHE_WL_FAIL_ACTION_DEFAULT) {
       t_state.cache_info.write_lock_state = HttpTransact::CACHE_WL_FAIL;
       break;
@@ -2451,6 +2480,18 @@ HttpSM::state_cache_open_write(int event, void *data)
   return 0;
 }
 
+bool
+HttpSM::is_collapsible_write_fail() const
+{
+  // Only a plain miss that was about to write the origin response to
+  //  the cache can wait on the writer. The transform write is issued
+  //  while the response is already being tunneled, going back to the
+  //  cache lookup at that point would restart the transaction.
+  return t_state.next_action == HttpTransact::SM_ACTION_CACHE_ISSUE_WRITE && !tunnel.is_tunnel_active() &&
+         transform_info.vc == NULL && !cache_sm.is_collapsed() && !t_state.cache_info.object_read &&
+         t_state.api_lock_url == HttpTransact::LOCK_URL_FIRST;
+}
+
 inline void
 HttpSM::setup_cache_lookup_complete_api()
 {
@@ -3340,6 +3381,13 @@ HttpSM::tunnel_handler_cache_write(int event, HttpTunnelConsumer *c)
     break;
   }
 
+  // Readers collapsed onto this write can go back to the cache now
+  if (c->producer->vc_type == HT_TRANSFORM) {
+    transform_cache_sm.collapse_wake();
+  } else {
+    cache_sm.collapse_wake();
+  }
+
   HTTP_DECREMENT_DYN_STAT(http_current_cache_connections_stat);
   return 0;
 }
@@ -4385,11 +4433,13 @@ HttpSM::do_cache_lookup_and_read()
   // ink_assert(server_session == NULL);
   ink_assert(pending_action == 0);
 
-  HTTP_INCREMENT_TRANS_STAT(http_cache_lookups_stat);
+  if (!cache_lookup_restarted) {
+    HTTP_INCREMENT_TRANS_STAT(http_cache_lookups_stat);
+    t_state.cache_info.lookup_count++;
+  }
 
   milestones[TS_MILESTONE_CACHE_OPEN_READ_BEGIN] = Thread::get_hrtime();
   t_state.cache_lookup_result = HttpTransact::CACHE_LOOKUP_NONE;
-  t_state.cache_info.lookup_count++;
   // YTS Team, yamsat Plugin
   // Changed the lookup_url to c_url which enables even
   // the new redirect url to perform a CACHE_LOOKUP
@@ -4707,40 +4757,6 @@ HttpSM::do_http_server_open(bool raw)
       ua_session->attach_server_session(NULL);
     }
   }
-  // Check to see if we have reached the max number of connections.
-  // Atomically read the current number of connections and check to see
-  // if we have gone above the max allowed.
-  if (t_state.http_config_param->server_max_connections > 0) {
-    int64_t sum;
-
-    HTTP_READ_GLOBAL_DYN_SUM(http_current_server_connections_stat, sum);
-
-    // Note that there is a potential race condition here where
-    // the value of the http_current_server_connections_stat gets changed
-    // between the statement above and the check below.
-    // If this happens, we might go over the max by 1 but this is ok.
-    if (sum >= t_state.http_config_param->server_max_connections) {
-      ink_assert(pending_action == NULL);
-      pending_action = eventProcessor.schedule_in(this, HRTIME_MSECONDS(100));
-      httpSessionManager.purge_keepalives();
-      return;
-    }
-  }
-  // Check to see if we have reached the max number of connections on this
-  // host.
-  if (t_state.txn_conf->origin_max_connections > 0) {
-    ConnectionCount *connections = ConnectionCount::getInstance();
-
-    char addrbuf[INET6_ADDRSTRLEN];
-    if (connections->getCount((t_state.current.server->dst_addr)) >= t_state.txn_conf->origin_max_connections) {
-      DebugSM("http", "[%" PRId64 "] over the number of connection for this host: %s", sm_id,
-              ats_ip_ntop(&t_state.current.server->dst_addr.sa, addrbuf, sizeof(addrbuf)));
-      ink_assert(pending_action == NULL);
-      pending_action = eventProcessor.schedule_in(this, HRTIME_MSECONDS(100));
-      return;
-    }
-  }
-
   // We did not manage to get an existing session
   //  and need to open a new connection
   Action *connect_action_handle;
@@ -4789,6 +4805,69 @@ HttpSM::do_http_server_open(bool raw)
     }
   }
 
+  // Multiplex the transaction over a HTTP/2 connection to the origin if there is one. The request body
+  // has to be of a known length, as the stream sends it in DATA frames without the chunking.
+  if (!raw && (t_state.txn_conf->server_http2 == 2 || (t_state.txn_conf->server_http2 == 1 && scheme_to_use == URL_WKSIDX_HTTPS)) &&
+      t_state.method != HTTP_WKSIDX_CONNECT && !t_state.is_websocket && t_state.current.request_to != HttpTransact::PARENT_PROXY &&
+      opt.addr_binding != NetVCOptions::FOREIGN_ADDR && t_state.current.server->name != NULL &&
+      !t_state.hdr_info.server_request.presence(MIME_PRESENCE_TRANSFER_ENCODING | MIME_PRESENCE_UPGRADE)) {
+    bool tls = (scheme_to_use == URL_WKSIDX_HTTPS);
+
+    if (tls) {
+      int len = 0;
+      const char *host = t_state.hdr_info.server_request.host_get(&len);
+      if (host && len > 0)
+        opt.set_sni_servername(host, len);
+    }
+
+    PluginVCCore *core =
+      httpSessionManager.acquire_http2_stream(&t_state.current.server->dst_addr.sa, t_state.current.server->name, tls, opt);
+    if (core) {
+      DebugSM("http", "[%" PRId64 "] sending the request on a HTTP/2 stream", sm_id);
+      opening_http2_stream = true;
+      Action *pvc_action_handle = core->connect_re(this);
+
+      // This connect call is always reentrant
+      ink_release_assert(pvc_action_handle == ACTION_RESULT_DONE);
+      return;
+    }
+  }
+
+  // A stream on a HTTP/2 connection does not take a connection, so the limits apply only from here on.
+  // Check to see if we have reached the max number of connections.
+  // Atomically read the current number of connections and check to see
+  // if we have gone above the max allowed.
+  if (t_state.http_config_param->server_max_connections > 0) {
+    int64_t sum;
+
+    HTTP_READ_GLOBAL_DYN_SUM(http_current_server_connections_stat, sum);
+
+    // Note that there is a potential race condition here where
+    // the value of the http_current_server_connections_stat gets changed
+    // between the statement above and the check below.
+    // If this happens, we might go over the max by 1 but this is ok.
+    if (sum >= t_state.http_config_param->server_max_connections) {
+      ink_assert(pending_action == NULL);
+      pending_action = eventProcessor.schedule_in(this, HRTIME_MSECONDS(100));
+      httpSessionManager.purge_keepalives();
+      return;
+    }
+  }
+  // Check to see if we have reached the max number of connections on this
+  // host.
+  if (t_state.txn_conf->origin_max_connections > 0) {
+    ConnectionCount *connections = ConnectionCount::getInstance();
+
+    char addrbuf[INET6_ADDRSTRLEN];
+    if (connections->getCount((t_state.current.server->dst_addr)) >= t_state.txn_conf->origin_max_connections) {
+      DebugSM("http", "[%" PRId64 "] over the number of connection for this host: %s", sm_id,
+              ats_ip_ntop(&t_state.current.server->dst_addr.sa, addrbuf, sizeof(addrbuf)));
+      ink_assert(pending_action == NULL);
+      pending_action = eventProcessor.schedule_in(this, HRTIME_MSECONDS(100));
+      return;
+    }
+  }
+
   if (scheme_to_use == URL_WKSIDX_HTTPS) {
     DebugSM("http", "calling sslNetProcessor.connect_re");
     int len = 0;
@@ -6714,6 +6793,10 @@ HttpSM::update_stats()
 
   HttpTransact::client_result_stat(&t_state, total_time, request_process_time);
 
+  if (cache_sm.is_collapsed() && t_state.source == HttpTransact::SOURCE_CACHE) {
+    HTTP_INCREMENT_DYN_STAT(http_cache_collapsed_hits_stat);
+  }
+
   ink_hrtime ua_write_time;
   if (milestones[TS_MILESTONE_UA_BEGIN_WRITE] != 0 && milestones[TS_MILESTONE_UA_CLOSE] != 0) {
     ua_write_time = milestones.elapsed(TS_MILESTONE_UA_BEGIN_WRITE, TS_MILESTONE_UA_CLOSE);
@@ -6950,13 +7033,25 @@ HttpSM::set_next_state()
   case HttpTransact::SM_ACTION_API_SEND_REQUEST_HDR:
   case HttpTransact::SM_ACTION_API_READ_CACHE_HDR:
   case HttpTransact::SM_ACTION_API_READ_RESPONSE_HDR:
-  case HttpTransact::SM_ACTION_API_SEND_RESPONSE_HDR:
-  case HttpTransact::SM_ACTION_API_CACHE_LOOKUP_COMPLETE: {
+  case HttpTransact::SM_ACTION_API_SEND_RESPONSE_HDR: {
     t_state.api_next_action = t_state.next_action;
     do_api_callout();
     break;
   }
 
+  case HttpTransact::SM_ACTION_API_CACHE_LOOKUP_COMPLETE: {
+    t_state.api_next_action = t_state.next_action;
+    if (cache_lookup_restarted) {
+      // The plugins saw the lookup of this transaction already,
+      //  don't report the repeated lookup of a collapsed miss
+      cache_lookup_restarted = false;
+      call_transact_and_set_next_state(NULL);
+    } else {
+      do_api_callout();
+    }
+    break;
+  }
+
   case HttpTransact::SM_ACTION_POST_REMAP_SKIP: {
     call_transact_and_set_next_state(NULL);
     break;
@@ -265,6 +265,11 @@ public:
   bool is_private();
   bool is_redirect_required();
 
+  // Called on a failed cache open write. True when the transaction
+  //  can go back to the cache and wait on the writer of the object
+  //  instead of fetching it from the origin server.
+  bool is_collapsible_write_fail() const;
+
   int64_t sm_id;
   unsigned int magic;
 
@@ -321,6 +326,8 @@ protected:
    * we should create a new connection and then once we attach the session we'll mark it as private.
    */
   bool will_be_private_ss;
+  /// Set while connecting to a stream of a HTTP/2 connection, whose server session is not a connection of its own.
+  bool opening_http2_stream;
   int shared_session_retries;
   IOBufferReader *server_buffer_reader;
   void remove_server_entry();
@@ -334,6 +341,9 @@ protected:
   HttpCacheSM cache_sm;
   HttpCacheSM transform_cache_sm;
   HttpCacheSM *second_cache_sm;
+  // Set while a collapsed transaction repeats its cache lookup, so that
+  //  the lookup is not counted again and the hooks don't fire twice.
+  bool cache_lookup_restarted;
 
   HttpSMHandler default_handler;
   Action *pending_action;
@@ -70,8 +70,10 @@ HttpServerSession::new_connection(NetVConnection *new_vc)
   con_id = ink_atomic_increment((int64_t *)(&next_ss_id), 1);
 
   magic = HTTP_SS_MAGIC_ALIVE;
-  HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, 1); // Update the true global stat
-  HTTP_INCREMENT_DYN_STAT(http_total_server_connections_stat);
+  if (!http2_stream) {
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, 1); // Update the true global stat
+    HTTP_INCREMENT_DYN_STAT(http_total_server_connections_stat);
+  }
   // Check to see if we are limiting the number of connections
   // per host
   if (enable_origin_connection_limiting == true) {
@@ -133,7 +135,9 @@ HttpServerSession::do_io_close(int alerrno)
   }
   server_vc = NULL;
 
-  HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, -1); // Make sure to work on the global stat
+  if (!http2_stream) {
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, -1); // Make sure to work on the global stat
+  }
   HTTP_SUM_DYN_STAT(http_transactions_per_server_con, transact_count);
 
   // Check to see if we are limiting the number of connections
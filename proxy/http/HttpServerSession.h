@@ -70,7 +70,7 @@ class HttpServerSession : public VConnection
 public:
   HttpServerSession()
     : VConnection(NULL), hostname_hash(), con_id(0), transact_count(0), state(HSS_INIT), to_parent_proxy(false),
-      server_trans_stat(0), private_session(false), sharing_match(TS_SERVER_SESSION_SHARING_MATCH_BOTH),
+      server_trans_stat(0), private_session(false), prewarmed(false), http2_stream(false), sharing_match(TS_SERVER_SESSION_SHARING_MATCH_BOTH),
       sharing_pool(TS_SERVER_SESSION_SHARING_POOL_GLOBAL), enable_origin_connection_limiting(false), connection_count(NULL),
       read_buffer(NULL), server_vc(NULL), magic(HTTP_SS_MAGIC_DEAD), buf_reader(NULL)
   {
@@ -141,6 +141,13 @@ public:
   //  are sent over them
   bool private_session;
 
+  // Opened ahead of demand by the session pool and not used yet
+  bool prewarmed;
+
+  // Runs on a stream of a HTTP/2 connection, which is what counts as
+  //  the server connection
+  bool http2_stream;
+
   // Copy of the owning SM's server session sharing settings
   TSServerSessionSharingMatchType sharing_match;
   TSServerSessionSharingPoolType sharing_pool;
@@ -148,6 +155,7 @@ public:
 
   LINK(HttpServerSession, ip_hash_link);
   LINK(HttpServerSession, host_hash_link);
+  LINK(HttpServerSession, lru_link);
 
   // Keep track of connection limiting and a pointer to the
   // singleton that keeps track of the connection counts.
@@ -35,17 +35,110 @@
 #include "HttpServerSession.h"
 #include "HttpSM.h"
 #include "HttpDebugNames.h"
+#include "Http2ServerSession.h"
 
 // Initialize a thread to handle HTTP session management
 void
 initialize_thread_for_http_sessions(EThread *thread, int /* thread_index ATS_UNUSED */)
 {
   thread->server_session_pool = new ServerSessionPool;
+  thread->schedule_every(thread->server_session_pool, HRTIME_SECONDS(1));
+  thread->h2_server_session_pool = new Http2ServerSessionPool;
 }
 
 HttpSessionManager httpSessionManager;
 
-ServerSessionPool::ServerSessionPool() : Continuation(new_ProxyMutex()), m_ip_pool(1023), m_host_pool(1023)
+/** Opens a session for pre-warming.
+
+    The session is handed to the pool once the connection is established, and for TLS origins once the handshake is
+    done, so that the first transaction on it does not wait for either.
+*/
+class ServerSessionPrewarm : public Continuation
+{
+public:
+  ServerSessionPrewarm(ServerSessionPool *pool, ServerSessionOrigin const &origin, ink_hrtime timeout)
+    : Continuation(pool->mutex), m_pool(pool), m_timeout(timeout), m_vc(NULL), m_buffer(NULL)
+  {
+    m_origin = origin;
+    SET_HANDLER(&ServerSessionPrewarm::connectEvent);
+  }
+
+  int
+  connectEvent(int event, void *data)
+  {
+    if (event != NET_EVENT_OPEN) {
+      return done(false);
+    }
+
+    m_vc = static_cast<NetVConnection *>(data);
+    m_vc->set_inactivity_timeout(m_timeout);
+
+    // The write becomes ready once the connection is established, and the zero length read completes once the TLS
+    // handshake, which the write starts, is done.
+    m_buffer = new_empty_MIOBuffer();
+    m_vc->do_io_write(this, INT64_MAX, m_buffer->alloc_reader());
+    if (m_origin.ssl) {
+      m_vc->do_io_read(this, 0, m_buffer);
+    }
+
+    SET_HANDLER(&ServerSessionPrewarm::openEvent);
+    return EVENT_DONE;
+  }
+
+  int
+  openEvent(int event, void * /* data ATS_UNUSED */)
+  {
+    int err = 0;
+    int len = sizeof(err);
+
+    switch (event) {
+    case VC_EVENT_WRITE_READY:
+      if (m_origin.ssl) {
+        return EVENT_CONT;
+      }
+      // The socket turns writable also if the connect failed.
+      if (safe_getsockopt(m_vc->get_socket(), SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&err), &len) < 0 || err) {
+        return done(false);
+      }
+      return done(true);
+    case VC_EVENT_READ_COMPLETE:
+      return done(true);
+    default:
+      return done(false);
+    }
+  }
+
+private:
+  int
+  done(bool success)
+  {
+    if (m_vc) {
+      // Stop the I/O on the buffer, which goes away with us.
+      m_vc->do_io_read(NULL, 0, NULL);
+      m_vc->do_io_write(NULL, 0, NULL)->buffer.clear();
+      if (!success) {
+        m_vc->do_io_close();
+        m_vc = NULL;
+      }
+    }
+
+    m_pool->prewarmed(m_origin, m_vc);
+
+    if (m_buffer) {
+      free_MIOBuffer(m_buffer);
+    }
+    delete this;
+    return EVENT_DONE;
+  }
+
+  ServerSessionPool *m_pool;
+  ServerSessionOrigin m_origin;
+  ink_hrtime m_timeout;
+  NetVConnection *m_vc;
+  MIOBuffer *m_buffer;
+};
+
+ServerSessionPool::ServerSessionPool() : Continuation(new_ProxyMutex()), m_ip_pool(1023), m_host_pool(1023), m_origins(63)
 {
   SET_HANDLER(&ServerSessionPool::eventHandler);
   m_ip_pool.setExpansionPolicy(IPHashTable::MANUAL);
@@ -60,6 +153,227 @@ ServerSessionPool::purge()
   }
   m_ip_pool.clear();
   m_host_pool.clear();
+  m_lru.clear();
+}
+
+void
+ServerSessionPool::remove(HttpServerSession *ss)
+{
+  m_ip_pool.remove(m_ip_pool.find(ss));
+  m_host_pool.remove(m_host_pool.find(ss));
+  m_lru.remove(ss);
+}
+
+void
+ServerSessionPool::evict(HttpServerSession *ss)
+{
+  Debug("http_ss", "[%" PRId64 "] [session_pool] evicting idle session", ss->con_id);
+  HTTP_INCREMENT_DYN_STAT(http_server_session_pool_evictions_stat);
+  remove(ss);
+  ss->do_io_close();
+}
+
+int
+ServerSessionPool::count(sockaddr const *addr, INK_MD5 const &hostname_hash, HttpServerSession *&oldest)
+{
+  int n = 0;
+
+  // Sessions are pushed on the front of their hash chain, so the last one found is the one idle longest.
+  oldest = NULL;
+  for (IPHashTable::Location loc = m_ip_pool.find(addr); loc; ++loc) {
+    if (loc->hostname_hash == hostname_hash) {
+      oldest = loc;
+      ++n;
+    }
+  }
+  return n;
+}
+
+int64_t
+ServerSessionPool::prewarmTarget(HttpConfigParams const *params)
+{
+  int64_t target = params->server_session_prewarm_min_connections;
+
+  if (params->server_session_max_idle_per_origin > 0 && params->server_session_max_idle_per_origin < target) {
+    target = params->server_session_max_idle_per_origin;
+  }
+  return target;
+}
+
+ServerSessionOrigin *
+ServerSessionPool::findOrigin(sockaddr const *addr, INK_MD5 const &hostname_hash)
+{
+  ServerSessionOrigin key;
+
+  ats_ip_copy(&key.addr, addr);
+  key.hostname_hash = hostname_hash;
+  return m_origins.find(static_cast<OriginHashing::Key>(&key));
+}
+
+void
+ServerSessionPool::forget(ServerSessionOrigin *origin)
+{
+  m_origins.remove(m_origins.find(origin));
+  m_origin_lru.remove(origin);
+  delete origin;
+}
+
+void
+ServerSessionPool::touch(HttpServerSession *ss, HttpConfigParams const *params)
+{
+  NetVConnection *vc = ss->get_netvc();
+
+  // Sessions bound to the address of a client can not be opened ahead of it.
+  if (prewarmTarget(params) <= 0 || params->server_session_prewarm_max_origins <= 0 ||
+      vc->options.addr_binding == NetVCOptions::FOREIGN_ADDR) {
+    return;
+  }
+
+  ServerSessionOrigin *origin = findOrigin(&ss->server_ip.sa, ss->hostname_hash);
+
+  if (origin) {
+    m_origin_lru.remove(origin);
+  } else {
+    // Make room by forgetting the least recently used origin which has no session being opened.
+    if (m_origins.count() >= static_cast<size_t>(params->server_session_prewarm_max_origins)) {
+      ServerSessionOrigin *victim = m_origin_lru.head;
+
+      while (victim && victim->pending > 0) {
+        victim = victim->lru_link.next;
+      }
+      if (!victim) {
+        return;
+      }
+      forget(victim);
+    }
+
+    origin = new ServerSessionOrigin;
+    ats_ip_copy(&origin->addr, &ss->server_ip);
+    origin->hostname_hash = ss->hostname_hash;
+    origin->opt = vc->options;
+    origin->ssl = dynamic_cast<SSLNetVConnection *>(vc) != NULL;
+    origin->sharing_match = ss->sharing_match;
+    origin->sharing_pool = ss->sharing_pool;
+    origin->enable_origin_connection_limiting = ss->enable_origin_connection_limiting;
+    origin->to_parent_proxy = ss->to_parent_proxy;
+    m_origins.insert(origin);
+  }
+
+  origin->last_used = Thread::get_hrtime();
+  m_origin_lru.enqueue(origin);
+}
+
+bool
+ServerSessionPool::keepWarm(HttpServerSession *ss, HttpConfigParams const *params)
+{
+  HttpServerSession *oldest;
+  ServerSessionOrigin *origin;
+
+  if (prewarmTarget(params) <= 0) {
+    return false;
+  }
+  origin = findOrigin(&ss->server_ip.sa, ss->hostname_hash);
+  return origin && Thread::get_hrtime() - origin->last_used <= HRTIME_SECONDS(params->server_session_prewarm_origin_timeout) &&
+         count(&ss->server_ip.sa, ss->hostname_hash, oldest) <= prewarmTarget(params);
+}
+
+void
+ServerSessionPool::prewarm()
+{
+  HttpConfigParams *params = HttpConfig::acquire();
+  int64_t target = prewarmTarget(params);
+  ink_hrtime now = Thread::get_hrtime();
+  ServerSessionOrigin *next;
+
+  for (ServerSessionOrigin *origin = m_origin_lru.head; origin; origin = next) {
+    next = origin->lru_link.next;
+
+    // Origins which were not used for a while are forgotten, the others are kept at the minimum of idle sessions.
+    if (target <= 0 || now - origin->last_used > HRTIME_SECONDS(params->server_session_prewarm_origin_timeout)) {
+      if (origin->pending == 0) {
+        forget(origin);
+      }
+      continue;
+    }
+
+    HttpServerSession *oldest;
+    int64_t missing = target - count(&origin->addr.sa, origin->hostname_hash, oldest) - origin->pending;
+
+    for (; missing > 0; --missing) {
+      if (params->server_max_connections > 0) {
+        int64_t sum;
+
+        HTTP_READ_GLOBAL_DYN_SUM(http_current_server_connections_stat, sum);
+        if (sum + origin->pending >= params->server_max_connections) {
+          break;
+        }
+      }
+      if (params->server_session_max_idle > 0 &&
+          m_ip_pool.count() + origin->pending >= static_cast<size_t>(params->server_session_max_idle)) {
+        break;
+      }
+      if (origin->enable_origin_connection_limiting && params->oride.origin_max_connections > 0 &&
+          ConnectionCount::getInstance()->getCount(origin->addr) + origin->pending >= params->oride.origin_max_connections) {
+        break;
+      }
+
+      ServerSessionPrewarm *prewarm =
+        new ServerSessionPrewarm(this, *origin, HRTIME_SECONDS(params->oride.connect_attempts_timeout));
+
+      ++origin->pending;
+      if (origin->ssl) {
+        sslNetProcessor.connect_re(prewarm, &origin->addr.sa, &origin->opt);
+      } else {
+        netProcessor.connect_re(prewarm, &origin->addr.sa, &origin->opt);
+      }
+    }
+  }
+
+  HttpConfig::release(params);
+}
+
+void
+ServerSessionPool::prewarmed(ServerSessionOrigin const &origin, NetVConnection *vc)
+{
+  ServerSessionOrigin *current = findOrigin(&origin.addr.sa, origin.hostname_hash);
+
+  if (current) {
+    --current->pending;
+  }
+
+  // Stop warming an origin which fails, until it is used again.
+  if (!vc) {
+    HTTP_INCREMENT_DYN_STAT(http_server_session_pool_prewarm_failures_stat);
+    if (current) {
+      current->last_used = 0;
+    }
+    return;
+  }
+
+  HttpConfigParams *params = HttpConfig::acquire();
+  HttpServerSession *ss = (TS_SERVER_SESSION_SHARING_POOL_THREAD == origin.sharing_pool) ?
+                            THREAD_ALLOC_INIT(httpServerSessionAllocator, mutex->thread_holding) :
+                            httpServerSessionAllocator.alloc();
+
+  ss->sharing_pool = origin.sharing_pool;
+  ss->sharing_match = origin.sharing_match;
+  ss->enable_origin_connection_limiting = origin.enable_origin_connection_limiting;
+  ats_ip_copy(&ss->server_ip, &origin.addr);
+  ss->hostname_hash = origin.hostname_hash;
+  ss->new_connection(vc);
+  ss->prewarmed = true;
+  if (origin.to_parent_proxy) {
+    ss->to_parent_proxy = true;
+    HTTP_INCREMENT_DYN_STAT(http_current_parent_proxy_connections_stat);
+    HTTP_INCREMENT_DYN_STAT(http_total_parent_proxy_connections_stat);
+  }
+  HTTP_INCREMENT_DYN_STAT(http_server_session_pool_prewarm_connects_stat);
+
+  Debug("http_ss", "[%" PRId64 "] [session_pool] pre-warmed session", ss->con_id);
+
+  vc->set_inactivity_timeout(HRTIME_SECONDS(params->oride.keep_alive_no_activity_timeout_out));
+  HttpConfig::release(params);
+  releaseSession(ss);
 }
 
 bool
@@ -87,8 +401,7 @@ ServerSessionPool::acquireSession(sockaddr const *addr, INK_MD5 const &hostname_
       ++loc; // scan for matching port.
     if (loc) {
       to_return = loc;
-      m_host_pool.remove(loc);
-      m_ip_pool.remove(m_ip_pool.find(loc));
+      remove(to_return);
     }
   } else if (TS_SERVER_SESSION_SHARING_MATCH_NONE != match_style) { // matching is not disabled.
     IPHashTable::Location loc = m_ip_pool.find(addr);
@@ -101,16 +414,52 @@ ServerSessionPool::acquireSession(sockaddr const *addr, INK_MD5 const &hostname_
     }
     if (loc) {
       to_return = loc;
-      m_ip_pool.remove(loc);
-      m_host_pool.remove(m_host_pool.find(loc));
+      remove(to_return);
     }
   }
+
+  if (to_return) {
+    HTTP_INCREMENT_DYN_STAT(http_server_session_pool_hits_stat);
+    if (to_return->prewarmed) {
+      HTTP_INCREMENT_DYN_STAT(http_server_session_pool_prewarm_hits_stat);
+      to_return->prewarmed = false;
+    }
+  } else {
+    HTTP_INCREMENT_DYN_STAT(http_server_session_pool_misses_stat);
+  }
   return zret;
 }
 
 void
 ServerSessionPool::releaseSession(HttpServerSession *ss)
 {
+  HttpConfigParams *params = HttpConfig::acquire();
+  HttpServerSession *oldest;
+  bool origin_full = params->server_session_max_idle_per_origin > 0 &&
+                     count(&ss->server_ip.sa, ss->hostname_hash, oldest) >= params->server_session_max_idle_per_origin;
+  bool pool_full = params->server_session_max_idle > 0 && m_ip_pool.count() >= static_cast<size_t>(params->server_session_max_idle);
+
+  // A session opened ahead of demand does not push out sessions which were used.
+  if (ss->prewarmed && (origin_full || pool_full)) {
+    HttpConfig::release(params);
+    ss->do_io_close();
+    return;
+  }
+
+  // Make room for the session by closing the session idle longest, of its origin if that is at its limit and of all
+  // origins if the pool is.
+  if (origin_full) {
+    evict(oldest);
+  }
+  while (params->server_session_max_idle > 0 && m_ip_pool.count() >= static_cast<size_t>(params->server_session_max_idle) &&
+         m_lru.head) {
+    evict(m_lru.head);
+  }
+  if (!ss->prewarmed) {
+    touch(ss, params);
+  }
+  HttpConfig::release(params);
+
   ss->state = HSS_KA_SHARED;
   // Now we need to issue a read on the connection to detect
   //  if it closes on us.  We will get called back in the
@@ -127,6 +476,7 @@ ServerSessionPool::releaseSession(HttpServerSession *ss)
   // put it in the pools.
   m_ip_pool.insert(ss);
   m_host_pool.insert(ss);
+  m_lru.enqueue(ss);
 
   Debug("http_ss", "[%" PRId64 "] [release session] "
                    "session placed into shared pool",
@@ -143,6 +493,10 @@ ServerSessionPool::eventHandler(int event, void *data)
   HttpServerSession *s = NULL;
 
   switch (event) {
+  case EVENT_INTERVAL:
+    prewarm();
+    return 0;
+
   case VC_EVENT_READ_READY:
   // The server sent us data.  This is unexpected so
   //   close the connection
@@ -185,14 +539,25 @@ ServerSessionPool::eventHandler(int event, void *data)
         }
       }
 
+      // Likewise keep the sessions which pre-warming would otherwise have to open again.
+      if ((event == VC_EVENT_INACTIVITY_TIMEOUT || event == VC_EVENT_ACTIVE_TIMEOUT) && s->state == HSS_KA_SHARED &&
+          keepWarm(s, http_config_params)) {
+        Debug("http_ss", "[%" PRId64 "] [session_bucket] session received io notice [%s], "
+                         "reseting timeout to keep the origin warm",
+              s->con_id, HttpDebugNames::get_event_name(event));
+        s->get_netvc()->set_inactivity_timeout(s->get_netvc()->get_inactivity_timeout());
+        s->get_netvc()->set_active_timeout(s->get_netvc()->get_active_timeout());
+        found = true;
+        break;
+      }
+
       // We've found our server session. Remove it from
       //   our lists and close it down
       Debug("http_ss", "[%" PRId64 "] [session_pool] session %p received io notice [%s]", s->con_id, s,
             HttpDebugNames::get_event_name(event));
       ink_assert(s->state == HSS_KA_SHARED);
       // Out of the pool! Now!
-      m_ip_pool.remove(lh);
-      m_host_pool.remove(m_host_pool.find(s));
+      remove(s);
       // Drop connection on this end.
       s->do_io_close();
       found = true;
@@ -222,6 +587,29 @@ void
 HttpSessionManager::init()
 {
   m_g_pool = new ServerSessionPool;
+  eventProcessor.schedule_every(m_g_pool, HRTIME_SECONDS(1), ET_NET);
+}
+
+PluginVCCore *
+HttpSessionManager::acquire_http2_stream(sockaddr const *addr, const char *hostname, bool tls, NetVCOptions const &opt)
+{
+  EThread *ethread = this_ethread();
+  INK_MD5 hostname_hash;
+
+  // The HTTP/2 sessions are pooled per net thread.
+  if (ethread->h2_server_session_pool == NULL) {
+    return NULL;
+  }
+
+#if !TS_USE_TLS_ALPN
+  // HTTP/2 over TLS is negotiated by ALPN.
+  if (tls) {
+    return NULL;
+  }
+#endif
+
+  ink_code_md5((unsigned char *)hostname, strlen(hostname), (unsigned char *)&hostname_hash);
+  return ethread->h2_server_session_pool->acquire_stream(addr, hostname_hash, tls, opt);
 }
 
 // TODO: Should this really purge all keep-alive sessions?
@@ -350,3 +738,427 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
 
   return released_p ? HSM_DONE : HSM_RETRY;
 }
+
+#if TS_HAS_TESTS
+#include "ts/ink_code.h"
+#include "ts/TestBox.h"
+
+/***********************************************************************************
+ *                                                                                 *
+ *                  Regression tests for the server session pool                   *
+ *                                                                                 *
+ *  The sessions are opened to fake origins on the loopback, sockets listening for *
+ *  the kernel to complete the connections, and released to a pool of the test,   *
+ *  with the limits of the pool set in the running configuration meanwhile, which  *
+ *  is why the tests run exclusively.                                              *
+ *                                                                                 *
+ ***********************************************************************************/
+
+const static int SESSION_POOL_TEST_ORIGINS = 2;
+const static int SESSION_POOL_TEST_SESSIONS = 4;
+
+const static ink_hrtime SESSION_POOL_TEST_POLL_INTERVAL = HRTIME_MSECONDS(10);
+const static ink_hrtime SESSION_POOL_TEST_TIMEOUT = HRTIME_SECONDS(30);
+
+/// The configuration of the pool a test runs with.
+struct SessionPoolLimits {
+  MgmtInt max_idle;
+  MgmtInt max_idle_per_origin;
+  MgmtInt prewarm_min_connections;
+  MgmtInt prewarm_max_origins;
+  MgmtInt prewarm_origin_timeout;
+
+  void
+  get(HttpConfigParams const *params)
+  {
+    max_idle = params->server_session_max_idle;
+    max_idle_per_origin = params->server_session_max_idle_per_origin;
+    prewarm_min_connections = params->server_session_prewarm_min_connections;
+    prewarm_max_origins = params->server_session_prewarm_max_origins;
+    prewarm_origin_timeout = params->server_session_prewarm_origin_timeout;
+  }
+
+  void
+  set(HttpConfigParams *params) const
+  {
+    params->server_session_max_idle = max_idle;
+    params->server_session_max_idle_per_origin = max_idle_per_origin;
+    params->server_session_prewarm_min_connections = prewarm_min_connections;
+    params->server_session_prewarm_max_origins = prewarm_max_origins;
+    params->server_session_prewarm_origin_timeout = prewarm_origin_timeout;
+  }
+};
+
+/// A pool which lets the tests look at what it keeps.
+class TestServerSessionPool : public ServerSessionPool
+{
+public:
+  using ServerSessionPool::findOrigin;
+  using ServerSessionPool::prewarm;
+
+  virtual ~TestServerSessionPool()
+  {
+    purge();
+    while (m_origin_lru.head) {
+      forget(m_origin_lru.head);
+    }
+  }
+
+  /// Number of pooled sessions to an origin.
+  int
+  idle(sockaddr const *addr, INK_MD5 const &hostname_hash)
+  {
+    HttpServerSession *oldest;
+
+    return count(addr, hostname_hash, oldest);
+  }
+
+  /// Check if the session with the connection id @a con_id is pooled.
+  bool
+  pooled(int64_t con_id)
+  {
+    for (HttpServerSession *ss = m_lru.head; ss; ss = ss->lru_link.next) {
+      if (ss->con_id == con_id) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/// A fake origin, which never reads from or writes to its connections.
+struct SessionPoolTestOrigin {
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  int fd;
+  /// Sessions opened to the origin, until they are released to the pool.
+  HttpServerSession *sessions[SESSION_POOL_TEST_SESSIONS];
+  int64_t con_ids[SESSION_POOL_TEST_SESSIONS];
+  int nsessions;
+};
+
+/** Runs a test step by step, on the thread and under the lock of the pool as the sessions do.
+ */
+struct ServerSessionPoolTest : public Continuation {
+  ServerSessionPoolTest(RegressionTest *t, int *pstatus, SessionPoolLimits const &l)
+    : Continuation(NULL), box(t, pstatus), pool(new TestServerSessionPool), params(NULL), limits(l), connecting(0),
+      failed(false), stage(0), deadline(Thread::get_hrtime() + SESSION_POOL_TEST_TIMEOUT)
+  {
+    this->mutex = this->pool->mutex;
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      char host[32];
+
+      snprintf(host, sizeof(host), "origin%d.test", i);
+      ink_code_md5((unsigned char const *)host, strlen(host), (unsigned char *)&this->origins[i].hostname_hash);
+      this->origins[i].fd = -1;
+      this->origins[i].nsessions = 0;
+    }
+    SET_HANDLER(&ServerSessionPoolTest::main_event_handler);
+  }
+
+  virtual ~ServerSessionPoolTest()
+  {
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      if (this->origins[i].fd >= 0) {
+        ::close(this->origins[i].fd);
+      }
+    }
+  }
+
+  /// Do the next step, and return @c true once the test is over.
+  virtual bool step() = 0;
+
+  void
+  start()
+  {
+    this->box = REGRESSION_TEST_INPROGRESS;
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      SessionPoolTestOrigin &origin = this->origins[i];
+      socklen_t len = sizeof(origin.addr.sin);
+
+      ats_ip4_set(&origin.addr, htonl(INADDR_LOOPBACK), 0);
+      origin.fd = socket(AF_INET, SOCK_STREAM, 0);
+      if (!this->box.check(origin.fd >= 0 && bind(origin.fd, &origin.addr.sa, sizeof(origin.addr.sin)) == 0 &&
+                             listen(origin.fd, 16) == 0 && getsockname(origin.fd, &origin.addr.sa, &len) == 0,
+                           "failed to listen for a fake origin")) {
+        delete this->pool;
+        delete this;
+        return;
+      }
+    }
+
+    this->params = HttpConfig::acquire();
+    this->saved.get(this->params);
+    this->limits.set(this->params);
+    this_ethread()->schedule_imm(this);
+  }
+
+  int
+  main_event_handler(int event, void *edata)
+  {
+    switch (event) {
+    case NET_EVENT_OPEN:
+      --this->connecting;
+      this->opened(static_cast<NetVConnection *>(edata));
+      return EVENT_DONE;
+    case NET_EVENT_OPEN_FAILED:
+      --this->connecting;
+      this->box.check(false, "failed to connect to a fake origin");
+      this->failed = true;
+      return EVENT_DONE;
+    default:
+      break;
+    }
+
+    bool over = this->failed || this->step();
+
+    if (!over && Thread::get_hrtime() > this->deadline) {
+      this->box.check(false, "timed out in stage %d", this->stage);
+      over = true;
+    }
+
+    if (over) {
+      if (*this->box._status == REGRESSION_TEST_INPROGRESS) {
+        this->box = REGRESSION_TEST_PASSED;
+      }
+      this->saved.set(this->params);
+      HttpConfig::release(this->params);
+      this->finish();
+    } else {
+      this_ethread()->schedule_in(this, SESSION_POOL_TEST_POLL_INTERVAL);
+    }
+
+    return EVENT_DONE;
+  }
+
+  /// Open a session to origin @a i, which is added to the sessions of the origin once connected.
+  void
+  open(int i)
+  {
+    ++this->connecting;
+    netProcessor.connect_re(this, &this->origins[i].addr.sa);
+  }
+
+  void
+  opened(NetVConnection *vc)
+  {
+    SessionPoolTestOrigin *origin = NULL;
+
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      if (ats_ip_addr_port_eq(vc->get_remote_addr(), &this->origins[i].addr.sa)) {
+        origin = &this->origins[i];
+      }
+    }
+    ink_release_assert(origin && origin->nsessions < SESSION_POOL_TEST_SESSIONS);
+
+    // As the HttpSM does for the sessions it opens.
+    HttpServerSession *ss = httpServerSessionAllocator.alloc();
+
+    ats_ip_copy(&ss->server_ip, vc->get_remote_addr());
+    ss->hostname_hash = origin->hostname_hash;
+    ss->new_connection(vc);
+    origin->sessions[origin->nsessions] = ss;
+    origin->con_ids[origin->nsessions] = ss->con_id;
+    ++origin->nsessions;
+  }
+
+  /// Release session @a k of origin @a i to the pool.
+  void
+  release(int i, int k)
+  {
+    this->pool->releaseSession(this->origins[i].sessions[k]);
+    this->origins[i].sessions[k] = NULL;
+  }
+
+  bool
+  pooled(int i, int k)
+  {
+    return this->pool->pooled(this->origins[i].con_ids[k]);
+  }
+
+  int
+  idle(int i)
+  {
+    return this->pool->idle(&this->origins[i].addr.sa, this->origins[i].hostname_hash);
+  }
+
+  int
+  pending(int i)
+  {
+    ServerSessionOrigin *origin = this->pool->findOrigin(&this->origins[i].addr.sa, this->origins[i].hostname_hash);
+
+    return origin ? origin->pending : 0;
+  }
+
+  void
+  finish()
+  {
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      for (int k = 0; k < this->origins[i].nsessions; ++k) {
+        if (this->origins[i].sessions[k]) {
+          this->origins[i].sessions[k]->do_io_close();
+        }
+      }
+    }
+    // Connects still under way call back the test, and pre-warming ones the pool, which are then left to them.
+    for (int i = 0; i < SESSION_POOL_TEST_ORIGINS; ++i) {
+      if (this->connecting > 0 || this->pending(i) > 0) {
+        return;
+      }
+    }
+    delete this->pool;
+    delete this;
+  }
+
+  TestBox box;
+  TestServerSessionPool *pool;
+  HttpConfigParams *params;
+  SessionPoolLimits limits;
+  SessionPoolLimits saved;
+  SessionPoolTestOrigin origins[SESSION_POOL_TEST_ORIGINS];
+  int connecting;
+  bool failed;
+  int stage;
+  ink_hrtime deadline;
+};
+
+/** Pre-warming opens the sessions an origin misses to the minimum, and no more.
+ */
+struct ServerSessionPoolPrewarmTest : public ServerSessionPoolTest {
+  ServerSessionPoolPrewarmTest(RegressionTest *t, int *pstatus, SessionPoolLimits const &limits)
+    : ServerSessionPoolTest(t, pstatus, limits)
+  {
+  }
+
+  bool
+  step()
+  {
+    switch (this->stage) {
+    case 0:
+      this->open(0);
+      ++this->stage;
+      return false;
+    case 1:
+      if (this->origins[0].nsessions < 1) {
+        return false;
+      }
+      // Releasing the session records its origin for pre-warming.
+      this->release(0, 0);
+      this->pool->prewarm();
+      if (!this->box.check(this->pending(0) == 2, "expected 2 sessions being pre-warmed, got %d", this->pending(0))) {
+        return true;
+      }
+      ++this->stage;
+      return false;
+    case 2:
+      if (this->pending(0) > 0) {
+        return false;
+      }
+      this->box.check(this->idle(0) == 3, "expected 3 idle sessions, got %d", this->idle(0));
+      this->pool->prewarm();
+      this->box.check(this->pending(0) == 0, "pre-warmed %d sessions to an origin at the minimum", this->pending(0));
+      return true;
+    default:
+      return true;
+    }
+  }
+};
+
+/** The pool evicts the session idle longest to make room for a released one.
+ */
+struct ServerSessionPoolLruTest : public ServerSessionPoolTest {
+  ServerSessionPoolLruTest(RegressionTest *t, int *pstatus, SessionPoolLimits const &limits)
+    : ServerSessionPoolTest(t, pstatus, limits)
+  {
+  }
+
+  bool
+  step()
+  {
+    switch (this->stage) {
+    case 0:
+      for (int k = 0; k < 4; ++k) {
+        this->open(0);
+      }
+      ++this->stage;
+      return false;
+    case 1:
+      if (this->origins[0].nsessions < 4) {
+        return false;
+      }
+      this->release(0, 0);
+      this->release(0, 1);
+      this->release(0, 2);
+      this->box.check(!this->pooled(0, 0), "the session idle longest was not evicted");
+      this->box.check(this->pooled(0, 1) && this->pooled(0, 2), "evicted a session other than the one idle longest");
+      this->release(0, 3);
+      this->box.check(!this->pooled(0, 1), "the session idle longest was not evicted");
+      this->box.check(this->pooled(0, 2) && this->pooled(0, 3), "evicted a session other than the one idle longest");
+      this->box.check(this->idle(0) == 2, "expected 2 idle sessions, got %d", this->idle(0));
+      return true;
+    default:
+      return true;
+    }
+  }
+};
+
+/** The pool evicts the session idle longest of an origin at its limit to make room for a released one.
+ */
+struct ServerSessionPoolMaxIdlePerOriginTest : public ServerSessionPoolTest {
+  ServerSessionPoolMaxIdlePerOriginTest(RegressionTest *t, int *pstatus, SessionPoolLimits const &limits)
+    : ServerSessionPoolTest(t, pstatus, limits)
+  {
+  }
+
+  bool
+  step()
+  {
+    switch (this->stage) {
+    case 0:
+      for (int k = 0; k < 3; ++k) {
+        this->open(0);
+      }
+      this->open(1);
+      ++this->stage;
+      return false;
+    case 1:
+      if (this->origins[0].nsessions < 3 || this->origins[1].nsessions < 1) {
+        return false;
+      }
+      this->release(0, 0);
+      this->release(0, 1);
+      this->release(1, 0);
+      this->release(0, 2);
+      this->box.check(!this->pooled(0, 0), "the session idle longest of the origin was not evicted");
+      this->box.check(this->pooled(0, 1) && this->pooled(0, 2), "evicted a session other than the one idle longest");
+      this->box.check(this->pooled(1, 0), "evicted the session of an origin below its limit");
+      this->box.check(this->idle(0) == 2, "expected 2 idle sessions to the origin, got %d", this->idle(0));
+      this->box.check(this->idle(1) == 1, "expected 1 idle session to the other origin, got %d", this->idle(1));
+      return true;
+    default:
+      return true;
+    }
+  }
+};
+
+EXCLUSIVE_REGRESSION_TEST(HTTP_SESSION_POOL_Prewarm)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  SessionPoolLimits limits = {0, 0, 3, 4, 60};
+
+  (new ServerSessionPoolPrewarmTest(t, pstatus, limits))->start();
+}
+
+EXCLUSIVE_REGRESSION_TEST(HTTP_SESSION_POOL_Lru)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  SessionPoolLimits limits = {2, 0, 0, 0, 0};
+
+  (new ServerSessionPoolLruTest(t, pstatus, limits))->start();
+}
+
+EXCLUSIVE_REGRESSION_TEST(HTTP_SESSION_POOL_MaxIdlePerOrigin)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  SessionPoolLimits limits = {0, 2, 0, 0, 0};
+
+  (new ServerSessionPoolMaxIdlePerOriginTest(t, pstatus, limits))->start();
+}
+#endif // TS_HAS_TESTS
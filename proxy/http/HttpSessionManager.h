@@ -39,7 +39,9 @@
 #include <ts/Map.h>
 
 class HttpClientSession;
+struct HttpConfigParams;
 class HttpSM;
+class PluginVCCore;
 
 void initialize_thread_for_http_sessions(EThread *thread, int thread_index);
 
@@ -49,6 +51,34 @@ enum HSMresult_t {
   HSM_NOT_FOUND,
 };
 
+/** An origin to which a pool keeps warm sessions.
+
+    Origins are recorded as their sessions are released to the pool, along with what is needed to open more sessions
+    like them, and are forgotten once no session to them was used for a while.
+*/
+struct ServerSessionOrigin {
+  ServerSessionOrigin()
+    : ssl(false), sharing_match(TS_SERVER_SESSION_SHARING_MATCH_BOTH), sharing_pool(TS_SERVER_SESSION_SHARING_POOL_GLOBAL),
+      enable_origin_connection_limiting(false), to_parent_proxy(false), last_used(0), pending(0)
+  {
+    ink_zero(addr);
+  }
+
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  NetVCOptions opt;
+  bool ssl;
+  TSServerSessionSharingMatchType sharing_match;
+  TSServerSessionSharingPoolType sharing_pool;
+  bool enable_origin_connection_limiting;
+  bool to_parent_proxy;
+  ink_hrtime last_used;
+  int pending; ///< Sessions being opened.
+
+  LINK(ServerSessionOrigin, hash_link);
+  LINK(ServerSessionOrigin, lru_link);
+};
+
 /** A pool of server sessions.
 
     This is a continuation so that it can get callbacks from the server sessions.
@@ -64,7 +94,7 @@ public:
   /// Default constructor.
   /// Constructs an empty pool.
   ServerSessionPool();
-  /// Handle events from server sessions.
+  /// Handle events from server sessions and the periodic pre-warm event.
   int eventHandler(int event, void *data);
 
 protected:
@@ -120,8 +150,33 @@ protected:
     }
   };
 
-  typedef TSHashTable<IPHashing> IPHashTable;     ///< Sessions by IP address.
-  typedef TSHashTable<HostHashing> HostHashTable; ///< Sessions by host name.
+  /// Interface class for the origin map.
+  struct OriginHashing {
+    typedef uint64_t ID;
+    typedef ServerSessionOrigin const *Key;
+    typedef ServerSessionOrigin Value;
+    typedef DList(ServerSessionOrigin, hash_link) ListHead;
+
+    static ID
+    hash(Key key)
+    {
+      return key->hostname_hash.fold() ^ ats_ip_hash(&key->addr.sa);
+    }
+    static Key
+    key(Value const *value)
+    {
+      return value;
+    }
+    static bool
+    equal(Key lhs, Key rhs)
+    {
+      return ats_ip_addr_port_eq(&lhs->addr.sa, &rhs->addr.sa) && lhs->hostname_hash == rhs->hostname_hash;
+    }
+  };
+
+  typedef TSHashTable<IPHashing> IPHashTable;         ///< Sessions by IP address.
+  typedef TSHashTable<HostHashing> HostHashTable;     ///< Sessions by host name.
+  typedef TSHashTable<OriginHashing> OriginHashTable; ///< Pre-warmed origins.
 
 public:
   /** Check if a session matches address and host name.
@@ -145,10 +200,43 @@ public:
   /// Close all sessions and then clear the table.
   void purge();
 
+  /** Put a session opened by pre-warming into the pool.
+
+      @a origin is a copy of the origin the session was opened for, which is looked up again as it may have been
+      forgotten meanwhile. @a vc is @c NULL if the session could not be opened.
+  */
+  void prewarmed(ServerSessionOrigin const &origin, NetVConnection *vc);
+
   // Pools of server sessions.
   // Note that each server session is stored in both pools.
   IPHashTable m_ip_pool;
   HostHashTable m_host_pool;
+
+protected:
+  /// Remove a session from the pools.
+  void remove(HttpServerSession *ss);
+  /// Remove a session from the pools and close it.
+  void evict(HttpServerSession *ss);
+  /// Number of pooled sessions to an origin, and the one of them which is idle longest.
+  int count(sockaddr const *addr, INK_MD5 const &hostname_hash, HttpServerSession *&oldest);
+
+  /// Number of idle sessions to keep to each recently used origin.
+  static int64_t prewarmTarget(HttpConfigParams const *params);
+  ServerSessionOrigin *findOrigin(sockaddr const *addr, INK_MD5 const &hostname_hash);
+  void forget(ServerSessionOrigin *origin);
+  /// Record the use of the origin of @a ss for pre-warming.
+  void touch(HttpServerSession *ss, HttpConfigParams const *params);
+  /// Check if @a ss is needed to keep its origin at the minimum of idle sessions.
+  bool keepWarm(HttpServerSession *ss, HttpConfigParams const *params);
+  /// Open sessions to the recently used origins which have less than the minimum of idle sessions.
+  void prewarm();
+
+  /// Pooled sessions, least recently released first.
+  Queue<HttpServerSession, HttpServerSession::Link_lru_link> m_lru;
+  /// Origins to pre-warm.
+  OriginHashTable m_origins;
+  /// Origins to pre-warm, least recently used first.
+  Queue<ServerSessionOrigin, ServerSessionOrigin::Link_lru_link> m_origin_lru;
 };
 
 class HttpSessionManager
@@ -161,6 +249,11 @@ public:
   HSMresult_t acquire_session(Continuation *cont, sockaddr const *addr, const char *hostname, HttpClientSession *ua_session,
                               HttpSM *sm);
   HSMresult_t release_session(HttpServerSession *to_release);
+  /** Get a stream on a HTTP/2 session to the origin at @a addr, from the pool of the current thread.
+
+      @return The PluginVC core to connect the transaction to, or @c NULL if the origin is used over HTTP/1.1.
+  */
+  PluginVCCore *acquire_http2_stream(sockaddr const *addr, const char *hostname, bool tls, NetVCOptions const &opt);
   void purge_keepalives();
   void init();
   int main_handler(int event, void *data);
@@ -3517,19 +3517,26 @@ HttpTransact::handle_response_from_parent(State *s)
 
   s->parent_info.state = s->current.state;
   switch (s->current.state) {
-  case CONNECTION_ALIVE:
+  case CONNECTION_ALIVE: {
+    TransactionMilestones &milestones = s->state_machine->milestones;
+
     DebugTxn("http_trans", "[hrfp] connection alive");
     s->current.server->connect_result = 0;
     SET_VIA_STRING(VIA_DETAIL_PP_CONNECT, VIA_DETAIL_PP_SUCCESS);
+    s->parent_params->recordParentResponse(
+      &s->parent_result, milestones[TS_MILESTONE_SERVER_READ_HEADER_DONE] - milestones[TS_MILESTONE_SERVER_CONNECT],
+      s->hdr_info.server_response.status_get() >= HTTP_STATUS_INTERNAL_SERVER_ERROR);
     if (s->parent_result.retry) {
       s->parent_params->markParentUp(&s->parent_result);
     }
     handle_forward_server_connection_open(s);
     break;
+  }
   default: {
     LookingUp_t next_lookup = UNDEFINED_LOOKUP;
     DebugTxn("http_trans", "[hrfp] connection not alive");
     SET_VIA_STRING(VIA_DETAIL_PP_CONNECT, VIA_DETAIL_PP_FAILURE);
+    s->parent_params->recordParentResponse(&s->parent_result, 0, true);
 
     ink_assert(s->hdr_info.server_request.valid());
 
@@ -8733,6 +8740,15 @@ HttpTransact::origin_server_connection_speed(State *s, ink_hrtime transfer_time,
   return;
 }
 
+// Record the time between two milestones of the transaction, if both were reached.
+static inline void
+record_milestone_histogram(int id, const TransactionMilestones &milestones, TSMilestonesType ms_start, TSMilestonesType ms_end)
+{
+  if (milestones[ms_start] != 0 && milestones[ms_end] >= milestones[ms_start]) {
+    HTTP_RECORD_HISTOGRAM(id, ink_hrtime_to_usec(milestones.elapsed(ms_start, ms_end)));
+  }
+}
+
 void
 HttpTransact::update_size_and_time_stats(State *s, ink_hrtime total_time, ink_hrtime user_agent_write_time,
                                          ink_hrtime origin_server_read_time, int user_agent_request_header_size,
@@ -8951,6 +8967,17 @@ HttpTransact::update_size_and_time_stats(State *s, ink_hrtime total_time, ink_hr
   if (http_sm_finish_time_stat) {
     HTTP_SUM_TRANS_STAT(http_sm_finish_time_stat, milestones.difference_msec(TS_MILESTONE_SM_START, TS_MILESTONE_SM_FINISH))
   }
+
+  // update milestone latency histograms
+  record_milestone_histogram(http_total_time_histogram, milestones, TS_MILESTONE_SM_START, TS_MILESTONE_SM_FINISH);
+  record_milestone_histogram(http_ua_first_byte_time_histogram, milestones, TS_MILESTONE_SM_START, TS_MILESTONE_UA_BEGIN_WRITE);
+  record_milestone_histogram(http_dns_lookup_time_histogram, milestones, TS_MILESTONE_DNS_LOOKUP_BEGIN, TS_MILESTONE_DNS_LOOKUP_END);
+  record_milestone_histogram(http_cache_open_read_time_histogram, milestones, TS_MILESTONE_CACHE_OPEN_READ_BEGIN,
+                             TS_MILESTONE_CACHE_OPEN_READ_END);
+  record_milestone_histogram(http_server_connect_time_histogram, milestones, TS_MILESTONE_SERVER_CONNECT,
+                             TS_MILESTONE_SERVER_CONNECT_END);
+  record_milestone_histogram(http_server_first_byte_time_histogram, milestones, TS_MILESTONE_SERVER_BEGIN_WRITE,
+                             TS_MILESTONE_SERVER_FIRST_READ);
 }
 
 // void HttpTransact::add_new_stat_block(State* s)
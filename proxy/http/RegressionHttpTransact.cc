@@ -136,3 +136,33 @@ REGRESSION_TEST(HttpTransact_handle_request)(RegressionTest * /* t */, int /* le
   // To be added..
   *pstatus = REGRESSION_TEST_PASSED;
 }
+
+REGRESSION_TEST(HttpSM_is_collapsible_write_fail)(RegressionTest *t, int /* level */, int *pstatus)
+{
+  HttpSM sm;
+  *pstatus = REGRESSION_TEST_PASSED;
+
+  struct {
+    HttpTransact::StateMachineAction_t action;
+    HttpTransact::LockUrl_t lock_url;
+    bool result;
+  } cases[] = {// a miss about to write the origin response
+               {HttpTransact::SM_ACTION_CACHE_ISSUE_WRITE, HttpTransact::LOCK_URL_FIRST, true},
+               // the transformed response is written while the tunnel runs
+               {HttpTransact::SM_ACTION_CACHE_ISSUE_WRITE_TRANSFORM, HttpTransact::LOCK_URL_FIRST, false},
+               // a plugin asked for a different write lock
+               {HttpTransact::SM_ACTION_CACHE_ISSUE_WRITE, HttpTransact::LOCK_URL_SECOND, false},
+               {HttpTransact::SM_ACTION_UNDEFINED, HttpTransact::LOCK_URL_FIRST, false}};
+
+  for (unsigned i = 0; i < countof(cases); i++) {
+    init_sm(&sm);
+    sm.t_state.next_action = cases[i].action;
+    sm.t_state.api_lock_url = cases[i].lock_url;
+
+    if (cases[i].result != sm.is_collapsible_write_fail()) {
+      rprintf(t, "HttpSM::is_collapsible_write_fail - failed for case %u.  Expected result was %s\n", i,
+              (cases[i].result ? "true" : "false"));
+      *pstatus = REGRESSION_TEST_FAILED;
+    }
+  }
+}
@@ -40,6 +40,11 @@ static char const *const HTTP2_STAT_TOTAL_TRANSACTIONS_TIME_NAME = "proxy.proces
 static char const *const HTTP2_STAT_TOTAL_CLIENT_CONNECTION_NAME = "proxy.process.http2.total_client_connections";
 static char const *const HTTP2_STAT_CONNECTION_ERRORS_NAME = "proxy.process.http2.connection_errors";
 static char const *const HTTP2_STAT_STREAM_ERRORS_NAME = "proxy.process.http2.stream_errors";
+static char const *const HTTP2_STAT_CURRENT_SERVER_SESSION_NAME = "proxy.process.http2.current_server_sessions";
+static char const *const HTTP2_STAT_CURRENT_SERVER_STREAM_NAME = "proxy.process.http2.current_server_streams";
+static char const *const HTTP2_STAT_TOTAL_SERVER_CONNECTION_NAME = "proxy.process.http2.total_server_connections";
+static char const *const HTTP2_STAT_TOTAL_SERVER_STREAM_NAME = "proxy.process.http2.total_server_streams";
+static char const *const HTTP2_STAT_SERVER_NEGOTIATION_FAILURES_NAME = "proxy.process.http2.server_negotiation_failures";
 
 union byte_pointer {
   byte_pointer(void *p) : ptr(p) {}
@@ -449,10 +454,6 @@ convert_from_2_to_1_1_header(HTTPHdr *headers)
       headers->field_combine_dups(field, true, ';');
     }
 
-    // Convert HTTP version to 1.1
-    int32_t version = HTTP_VERSION(1, 1);
-    http_hdr_version_set(headers->m_http, version);
-
     // Remove HTTP/2 style headers
     headers->field_delete(HPACK_VALUE_SCHEME, HPACK_LEN_SCHEME);
     headers->field_delete(HPACK_VALUE_METHOD, HPACK_LEN_METHOD);
@@ -473,6 +474,10 @@ convert_from_2_to_1_1_header(HTTPHdr *headers)
     headers->field_delete(HPACK_VALUE_STATUS, HPACK_LEN_STATUS);
   }
 
+  // Convert HTTP version to 1.1
+  int32_t version = HTTP_VERSION(1, 1);
+  http_hdr_version_set(headers->m_http, version);
+
   // Check validity of all names and values
   MIMEFieldIter iter;
   for (const MIMEField *field = headers->iter_get_first(&iter); field != NULL; field = headers->iter_get_next(&iter)) {
@@ -513,6 +518,22 @@ http2_write_header_field(uint8_t *out, const uint8_t *end, MIMEFieldWrapper &hea
   }
 }
 
+// Encode a psuedo header field by adding a dummy header field to the header, and removing it again.
+static int64_t
+http2_write_psuedo_header_field(HTTPHdr *in, const char *name, int name_len, const char *value, int value_len, uint8_t *out,
+                                const uint8_t *end, Http2IndexingTable &indexing_table)
+{
+  MIMEField *field = mime_field_create(in->m_heap, in->m_http->m_fields_impl);
+  mime_field_name_value_set(in->m_heap, in->m_mime, field, -1, name, name_len, value, value_len, 0, name_len + value_len, true);
+  mime_hdr_field_attach(in->m_mime, field, 1, NULL);
+
+  MIMEFieldWrapper header(field, in->m_heap, in->m_http->m_fields_impl);
+  int64_t len = http2_write_header_field(out, end, header, indexing_table);
+
+  in->field_delete(name, name_len);
+  return len;
+}
+
 int64_t
 http2_write_psuedo_headers(HTTPHdr *in, uint8_t *out, uint64_t out_len, Http2IndexingTable &indexing_table)
 {
@@ -529,22 +550,73 @@ http2_write_psuedo_headers(HTTPHdr *in, uint8_t *out, uint64_t out_len, Http2Ind
     char status_str[HPACK_LEN_STATUS_VALUE_STR + 1];
     snprintf(status_str, sizeof(status_str), "%d", in->status_get());
 
-    // Add 'Status:' dummy header field
-    MIMEField *status_field = mime_field_create(in->m_heap, in->m_http->m_fields_impl);
-    mime_field_name_value_set(in->m_heap, in->m_mime, status_field, -1, HPACK_VALUE_STATUS, HPACK_LEN_STATUS, status_str,
-                              HPACK_LEN_STATUS_VALUE_STR, 0, HPACK_LEN_STATUS + HPACK_LEN_STATUS_VALUE_STR, true);
-    mime_hdr_field_attach(in->m_mime, status_field, 1, NULL);
-
-    // Encode psuedo headers by HPACK
-    MIMEFieldWrapper header(status_field, in->m_heap, in->m_http->m_fields_impl);
-
-    len = http2_write_header_field(p, end, header, indexing_table);
+    len = http2_write_psuedo_header_field(in, HPACK_VALUE_STATUS, HPACK_LEN_STATUS, status_str, HPACK_LEN_STATUS_VALUE_STR, p, end,
+                                          indexing_table);
     if (len == -1)
       return -1;
     p += len;
+  } else {
+    // [RFC 7540] 8.1.2.3. Request Pseudo-Header Fields
+    URL *url = in->url_get();
+    int method_len, scheme_len, authority_len, path_len, params_len, query_len;
+    const char *method = in->method_get(&method_len);
+    const char *scheme = url->scheme_get(&scheme_len);
+    const char *authority = in->value_get(MIME_FIELD_HOST, MIME_LEN_HOST, &authority_len);
+    const char *path = url->path_get(&path_len);
+    const char *params = url->params_get(&params_len);
+    const char *query = url->query_get(&query_len);
+
+    if (scheme == NULL) {
+      scheme = URL_SCHEME_HTTP;
+      scheme_len = URL_LEN_HTTP;
+    }
+    if (authority == NULL) {
+      authority = url->host_get(&authority_len);
+    }
 
-    // Remove dummy header field
-    in->field_delete(HPACK_VALUE_STATUS, HPACK_LEN_STATUS);
+    // The path includes the leading slash, the parameters and the query
+    Arena arena;
+    char *path_str = arena.str_alloc(path_len + params_len + query_len + 3);
+    char *cursor = path_str;
+
+    *cursor++ = '/';
+    memcpy(cursor, path, path_len);
+    cursor += path_len;
+    if (params_len > 0) {
+      *cursor++ = ';';
+      memcpy(cursor, params, params_len);
+      cursor += params_len;
+    }
+    if (query_len > 0) {
+      *cursor++ = '?';
+      memcpy(cursor, query, query_len);
+      cursor += query_len;
+    }
+
+    const struct {
+      const char *name;
+      int name_len;
+      const char *value;
+      int value_len;
+    } fields[] = {{HPACK_VALUE_METHOD, static_cast<int>(HPACK_LEN_METHOD), method, method_len},
+                  {HPACK_VALUE_SCHEME, static_cast<int>(HPACK_LEN_SCHEME), scheme, scheme_len},
+                  {HPACK_VALUE_AUTHORITY, static_cast<int>(HPACK_LEN_AUTHORITY), authority, authority_len},
+                  {HPACK_VALUE_PATH, static_cast<int>(HPACK_LEN_PATH), path_str, static_cast<int>(cursor - path_str)}};
+
+    // Check all the values before encoding any, which changes the indexing table
+    for (unsigned i = 0; i < countof(fields); ++i) {
+      if (fields[i].value == NULL || fields[i].value_len <= 0) {
+        return -1;
+      }
+    }
+
+    for (unsigned i = 0; i < countof(fields); ++i) {
+      len = http2_write_psuedo_header_field(in, fields[i].name, fields[i].name_len, fields[i].value, fields[i].value_len, p, end,
+                                            indexing_table);
+      if (len == -1)
+        return -1;
+      p += len;
+    }
   }
 
   return p - out;
@@ -706,7 +778,12 @@ http2_decode_header_blocks(HTTPHdr *hdr, const uint8_t *buf_start, const uint8_t
     mime_hdr_field_attach(hh->m_fields_impl, field, 1, NULL);
   }
 
-  if (!is_trailing_header) {
+  if (!is_trailing_header && http_hdr_type_get(hh) == HTTP_TYPE_RESPONSE) {
+    // [RFC 7540] 8.1.2.4. Response Pseudo-Header Fields
+    if (hdr->field_find(HPACK_VALUE_STATUS, HPACK_LEN_STATUS) == NULL) {
+      return HPACK_ERROR_HTTP2_PROTOCOL_ERROR;
+    }
+  } else if (!is_trailing_header) {
     // Check psuedo headers
     if (hdr->fields_count() >= 4) {
       if (hdr->field_find(HPACK_VALUE_SCHEME, HPACK_LEN_SCHEME) == NULL ||
@@ -735,6 +812,9 @@ uint32_t Http2::max_header_list_size = 4294967295;
 uint32_t Http2::max_request_header_size = 131072;
 uint32_t Http2::accept_no_activity_timeout = 120;
 uint32_t Http2::no_activity_timeout_in = 115;
+uint32_t Http2::max_concurrent_streams_out = 100;
+uint32_t Http2::no_activity_timeout_out = 120;
+uint32_t Http2::origin_fallback_time = 300;
 
 void
 Http2::init()
@@ -747,6 +827,9 @@ Http2::init()
   REC_EstablishStaticConfigInt32U(max_request_header_size, "proxy.config.http.request_header_max_size");
   REC_EstablishStaticConfigInt32U(accept_no_activity_timeout, "proxy.config.http2.accept_no_activity_timeout");
   REC_EstablishStaticConfigInt32U(no_activity_timeout_in, "proxy.config.http2.no_activity_timeout_in");
+  REC_EstablishStaticConfigInt32U(max_concurrent_streams_out, "proxy.config.http2.max_concurrent_streams_out");
+  REC_EstablishStaticConfigInt32U(no_activity_timeout_out, "proxy.config.http2.no_activity_timeout_out");
+  REC_EstablishStaticConfigInt32U(origin_fallback_time, "proxy.config.http2.origin_fallback_time");
 
   // If any settings is broken, ATS should not start
   ink_release_assert(http2_settings_parameter_is_valid({HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, max_concurrent_streams}) &&
@@ -771,6 +854,16 @@ Http2::init()
                      static_cast<int>(HTTP2_STAT_CONNECTION_ERRORS_COUNT), RecRawStatSyncSum);
   RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_STREAM_ERRORS_NAME, RECD_INT, RECP_PERSISTENT,
                      static_cast<int>(HTTP2_STAT_STREAM_ERRORS_COUNT), RecRawStatSyncSum);
+  RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_CURRENT_SERVER_SESSION_NAME, RECD_INT, RECP_NON_PERSISTENT,
+                     static_cast<int>(HTTP2_STAT_CURRENT_SERVER_SESSION_COUNT), RecRawStatSyncSum);
+  RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_CURRENT_SERVER_STREAM_NAME, RECD_INT, RECP_NON_PERSISTENT,
+                     static_cast<int>(HTTP2_STAT_CURRENT_SERVER_STREAM_COUNT), RecRawStatSyncSum);
+  RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_TOTAL_SERVER_CONNECTION_NAME, RECD_INT, RECP_PERSISTENT,
+                     static_cast<int>(HTTP2_STAT_TOTAL_SERVER_CONNECTION_COUNT), RecRawStatSyncSum);
+  RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_TOTAL_SERVER_STREAM_NAME, RECD_INT, RECP_PERSISTENT,
+                     static_cast<int>(HTTP2_STAT_TOTAL_SERVER_STREAM_COUNT), RecRawStatSyncSum);
+  RecRegisterRawStat(http2_rsb, RECT_PROCESS, HTTP2_STAT_SERVER_NEGOTIATION_FAILURES_NAME, RECD_INT, RECP_PERSISTENT,
+                     static_cast<int>(HTTP2_STAT_SERVER_NEGOTIATION_FAILURES), RecRawStatSyncSum);
 }
 
 #if TS_HAS_TESTS
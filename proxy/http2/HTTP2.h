@@ -69,6 +69,11 @@ enum {
   HTTP2_STAT_TOTAL_CLIENT_CONNECTION_COUNT, // Total connections running http2
   HTTP2_STAT_STREAM_ERRORS_COUNT,
   HTTP2_STAT_CONNECTION_ERRORS_COUNT,
+  HTTP2_STAT_CURRENT_SERVER_SESSION_COUNT,  // Current # of HTTP2 connections to origins.
+  HTTP2_STAT_CURRENT_SERVER_STREAM_COUNT,   // Current # of HTTP2 streams to origins.
+  HTTP2_STAT_TOTAL_SERVER_CONNECTION_COUNT, // Total HTTP2 connections opened to origins.
+  HTTP2_STAT_TOTAL_SERVER_STREAM_COUNT,     // Total HTTP2 streams opened to origins.
+  HTTP2_STAT_SERVER_NEGOTIATION_FAILURES,   // Origin connections which did not negotiate HTTP2.
 
   HTTP2_N_STATS // Terminal counter, NOT A STAT INDEX.
 };
@@ -350,6 +355,9 @@ public:
   static uint32_t max_request_header_size;
   static uint32_t accept_no_activity_timeout;
   static uint32_t no_activity_timeout_in;
+  static uint32_t max_concurrent_streams_out;
+  static uint32_t no_activity_timeout_out;
+  static uint32_t origin_fallback_time;
 
   static void init();
 };
@@ -0,0 +1,1415 @@
+/** @file
+
+  Http2ServerSession.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "Http2ServerSession.h"
+#include "HttpDebugNames.h"
+#include "HttpConfig.h"
+#include "HttpConnectionCount.h"
+
+#define DebugHttp2Ss(fmt, ...) Debug("http2_ss", "[%" PRId64 "] " fmt, this->con_id, __VA_ARGS__)
+
+#define DebugHttp2Ss0(msg) Debug("http2_ss", "[%" PRId64 "] " msg, this->con_id)
+
+#define DebugHttp2Stream(fmt, ...) Debug("http2_ss", "[%p] [%u] " fmt, this->session, this->id, __VA_ARGS__)
+
+ClassAllocator<Http2ServerSession> http2ServerSessionAllocator("http2ServerSessionAllocator");
+ClassAllocator<Http2ServerStream> http2ServerStreamAllocator("http2ServerStreamAllocator");
+
+static int64_t next_con_id = 0;
+
+// Size of the payload of a HEADERS or CONTINUATION frame, and of a DATA frame.
+static const size_t HEADERS_PAYLOAD_LEN = BUFFER_SIZE_FOR_INDEX(BUFFER_SIZE_INDEX_16K) - HTTP2_FRAME_HEADER_LEN;
+static const size_t DATA_PAYLOAD_LEN = BUFFER_SIZE_FOR_INDEX(BUFFER_SIZE_INDEX_8K) - HTTP2_FRAME_HEADER_LEN;
+
+// Largest payload of the frames which are read into a local buffer.
+static const size_t CONTROL_PAYLOAD_LEN = 64;
+
+static const Http2StreamId MAX_STREAM_ID = 0x7FFFFFFF;
+
+// memcpy the requested bytes from the IOBufferReader, returning how many were
+// actually copied.
+static inline unsigned
+copy_from_buffer_reader(void *dst, IOBufferReader *reader, unsigned nbytes)
+{
+  char *end;
+
+  end = reader->memcpy(dst, nbytes, 0 /* offset */);
+  return end - (char *)dst;
+}
+
+// The connection flow control window. It is replenished as data arrives, the stream windows hold the responses back.
+static Http2WindowSize
+connection_window_size()
+{
+  uint64_t size = static_cast<uint64_t>(Http2::initial_window_size) * max(Http2::max_concurrent_streams_out, 1U);
+
+  return max(static_cast<uint64_t>(HTTP2_INITIAL_WINDOW_SIZE), min(size, static_cast<uint64_t>(HTTP2_MAX_WINDOW_SIZE)));
+}
+
+//
+// Http2ServerStream
+//
+
+void
+Http2ServerStream::init(Http2ServerSession *ssn, PluginVCCore *pvc)
+{
+  this->session = ssn;
+  this->core = pvc;
+  this->mutex = ssn->mutex;
+
+  this->req_buffer = new_MIOBuffer(HTTP2_HEADER_BUFFER_SIZE_INDEX);
+  this->req_reader = this->req_buffer->alloc_reader();
+  this->resp_buffer = new_MIOBuffer(HTTP2_HEADER_BUFFER_SIZE_INDEX);
+  this->resp_reader = this->resp_buffer->alloc_reader();
+
+  this->request.create(HTTP_TYPE_REQUEST);
+  http_parser_init(&this->http_parser);
+
+  this->send_window = ssn->peer_initial_window;
+  this->recv_window = Http2::initial_window_size;
+
+  HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_CURRENT_SERVER_STREAM_COUNT, this_ethread());
+  SET_HANDLER(&Http2ServerStream::main_event_handler);
+}
+
+void
+Http2ServerStream::destroy()
+{
+  ink_assert(this->session == NULL);
+
+  this->request.destroy();
+  http_parser_clear(&this->http_parser);
+  free_MIOBuffer(this->req_buffer);
+  free_MIOBuffer(this->resp_buffer);
+
+  HTTP2_DECREMENT_THREAD_DYN_STAT(HTTP2_STAT_CURRENT_SERVER_STREAM_COUNT, this_ethread());
+
+  this->mutex.clear();
+  http2ServerStreamAllocator.free(this);
+}
+
+int
+Http2ServerStream::main_event_handler(int event, void *edata)
+{
+  DebugHttp2Stream("[%s]", HttpDebugNames::get_event_name(event));
+
+  switch (event) {
+  case NET_EVENT_ACCEPT:
+    this->vc = static_cast<VConnection *>(edata);
+    if (this->aborted) {
+      this->close();
+      break;
+    }
+    this->read_vio = this->vc->do_io_read(this, INT64_MAX, this->req_buffer);
+    this->write_vio = this->vc->do_io_write(this, INT64_MAX, this->resp_reader);
+    this->process_request();
+    break;
+
+  case NET_EVENT_ACCEPT_FAILED:
+    this->detach();
+    this->destroy();
+    break;
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    if (this->session == NULL) {
+      // The stream is closed on the connection, the rest of the request is dropped.
+      this->req_reader->consume(this->req_reader->read_avail());
+      this->read_vio->reenable();
+    } else {
+      this->process_request();
+    }
+    break;
+
+  case VC_EVENT_WRITE_READY:
+    this->update_window();
+    break;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    if (this->response_done) {
+      this->close();
+    }
+    break;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    // The transaction went away.
+    if (!this->response_done) {
+      this->reset(HTTP2_ERROR_CANCEL);
+    }
+    this->close();
+    break;
+  }
+
+  return 0;
+}
+
+void
+Http2ServerStream::process_request()
+{
+  if (this->session == NULL) {
+    return;
+  }
+
+  if (!this->request_parsed) {
+    int bytes_used = 0;
+    int host_len = 0;
+    MIMEParseResult result = this->request.parse_req(&this->http_parser, this->req_reader, &bytes_used, false);
+
+    if (result == PARSE_CONT) {
+      this->read_vio->reenable();
+      return;
+    }
+
+    // A body of unknown length can not be framed into DATA frames before all of it is read.
+    if (result != PARSE_DONE || this->request.presence(MIME_PRESENCE_TRANSFER_ENCODING) ||
+        this->request.host_get(&host_len) == NULL || host_len == 0) {
+      DebugHttp2Stream("%s", "invalid request");
+      this->detach();
+      this->close();
+      return;
+    }
+
+    this->request_parsed = true;
+    this->head = this->request.method_get_wksidx() == HTTP_WKSIDX_HEAD;
+    if (this->request.presence(MIME_PRESENCE_CONTENT_LENGTH)) {
+      this->body_todo = this->request.get_content_length();
+    }
+
+    this->session->start_streams();
+    return;
+  }
+
+  this->send_body();
+}
+
+void
+Http2ServerStream::start()
+{
+  ink_assert(this->request_parsed && !this->started);
+
+  this->id = this->session->next_stream_id;
+  this->session->next_stream_id += 2;
+  this->started = true;
+  ++this->session->active_streams;
+  HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_TOTAL_SERVER_STREAM_COUNT, this_ethread());
+
+  DebugHttp2Stream("start stream, body %" PRId64 " bytes", this->body_todo);
+
+  URL *url = this->request.url_get();
+  if (this->session->tls) {
+    url->scheme_set(URL_SCHEME_HTTPS, URL_LEN_HTTPS);
+  } else {
+    url->scheme_set(URL_SCHEME_HTTP, URL_LEN_HTTP);
+  }
+  this->request.field_delete(MIME_FIELD_TE, MIME_LEN_TE);
+
+  this->end_stream_sent = this->body_todo == 0;
+  if (!this->session->write_headers(this, &this->request, this->end_stream_sent)) {
+    this->session->connection_error(HTTP2_ERROR_COMPRESSION_ERROR);
+    return;
+  }
+
+  this->send_body();
+}
+
+void
+Http2ServerStream::send_body()
+{
+  if (this->session == NULL || !this->started || this->end_stream_sent) {
+    return;
+  }
+
+  int64_t sent = 0;
+
+  while (this->body_todo > 0) {
+    int64_t len = min(this->req_reader->read_avail(), this->body_todo);
+    len = min(len, static_cast<int64_t>(min(this->session->send_window, this->send_window)));
+    len = min(len, static_cast<int64_t>(min(static_cast<size_t>(this->session->peer_max_frame_size), DATA_PAYLOAD_LEN)));
+    if (len <= 0) {
+      break;
+    }
+
+    uint8_t flags = 0;
+    if (len == this->body_todo) {
+      flags |= HTTP2_FLAGS_DATA_END_STREAM;
+      this->end_stream_sent = true;
+    }
+
+    Http2Frame data(HTTP2_FRAME_TYPE_DATA, this->id, flags);
+    data.alloc(BUFFER_SIZE_INDEX_8K);
+    copy_from_buffer_reader(data.write().iov_base, this->req_reader, len);
+    data.finalize(len);
+    this->req_reader->consume(len);
+
+    this->session->send_window -= len;
+    this->send_window -= len;
+    this->body_todo -= len;
+    sent += len;
+
+    this->session->xmit(data);
+  }
+
+  if (sent > 0) {
+    this->read_vio->reenable();
+  }
+}
+
+void
+Http2ServerStream::recv_headers(HTTPHdr *hdr, bool end_stream)
+{
+  if (this->headers_received) {
+    // Trailers are dropped, the HTTP/1.1 response is either chunked without them or has a Content-Length.
+    if (end_stream) {
+      this->finish_response();
+    } else {
+      this->reset(HTTP2_ERROR_PROTOCOL_ERROR);
+      this->close();
+    }
+    return;
+  }
+
+  if (convert_from_2_to_1_1_header(hdr) != PARSE_DONE) {
+    this->reset(HTTP2_ERROR_PROTOCOL_ERROR);
+    this->close();
+    return;
+  }
+
+  HTTPStatus status = hdr->status_get();
+  DebugHttp2Stream("received response headers, status %d", status);
+
+  // Interim responses are dropped, the HttpSM does not wait for a 100 Continue.
+  if (status >= HTTP_STATUS_CONTINUE && status < HTTP_STATUS_OK) {
+    return;
+  }
+
+  this->headers_received = true;
+
+  const char *reason = http_hdr_reason_lookup(status);
+  hdr->reason_set(reason, strlen(reason));
+
+  // The virtual server session is not reusable, the connection is.
+  hdr->value_set(MIME_FIELD_CONNECTION, MIME_LEN_CONNECTION, "close", 5);
+
+  if (!hdr->presence(MIME_PRESENCE_CONTENT_LENGTH) && !this->head && status != HTTP_STATUS_NO_CONTENT &&
+      status != HTTP_STATUS_NOT_MODIFIED) {
+    if (end_stream) {
+      hdr->set_content_length(0);
+    } else {
+      hdr->value_set(MIME_FIELD_TRANSFER_ENCODING, MIME_LEN_TRANSFER_ENCODING, HTTP_VALUE_CHUNKED, HTTP_LEN_CHUNKED);
+      this->chunked = true;
+    }
+  }
+
+  int len = hdr->length_get();
+  char *buf = static_cast<char *>(ats_malloc(len + 1));
+  int bufindex = 0, dumpoffset = 0;
+
+  hdr->print(buf, len + 1, &bufindex, &dumpoffset);
+  this->resp_buffer->write(buf, bufindex);
+  this->resp_bytes += bufindex;
+  ats_free(buf);
+
+  if (end_stream) {
+    this->finish_response();
+  } else {
+    this->write_vio->reenable();
+  }
+}
+
+void
+Http2ServerStream::recv_data(IOBufferReader *reader, int64_t offset, int64_t len, bool end_stream)
+{
+  if (!this->headers_received) {
+    this->reset(HTTP2_ERROR_PROTOCOL_ERROR);
+    this->close();
+    return;
+  }
+
+  if (len > 0) {
+    if (this->chunked) {
+      char chunk_size[32];
+      int n = snprintf(chunk_size, sizeof(chunk_size), "%" PRIx64 "\r\n", len);
+
+      this->resp_buffer->write(chunk_size, n);
+      this->resp_bytes += n;
+    }
+
+    this->resp_buffer->write(reader, len, offset);
+    this->resp_bytes += len;
+
+    if (this->chunked) {
+      this->resp_buffer->write("\r\n", 2);
+      this->resp_bytes += 2;
+    }
+  }
+
+  if (end_stream) {
+    this->finish_response();
+    return;
+  }
+
+  this->write_vio->reenable();
+  this->update_window();
+}
+
+void
+Http2ServerStream::recv_rst_stream(uint32_t error_code)
+{
+  DebugHttp2Stream("received RST_STREAM, error %u", error_code);
+
+  this->detach();
+  this->close();
+}
+
+void
+Http2ServerStream::finish_response()
+{
+  DebugHttp2Stream("response done, %" PRId64 " bytes", this->resp_bytes);
+
+  if (this->chunked) {
+    this->resp_buffer->write("0\r\n\r\n", 5);
+    this->resp_bytes += 5;
+  }
+  this->response_done = true;
+
+  // The origin does not need the rest of the request body.
+  if (!this->end_stream_sent) {
+    this->reset(HTTP2_ERROR_NO_ERROR);
+  } else {
+    this->detach();
+  }
+
+  this->write_vio->nbytes = this->resp_bytes;
+  if (this->write_vio->ntodo() == 0) {
+    this->close();
+  } else {
+    this->write_vio->reenable();
+  }
+}
+
+// Open the stream window as much as the HttpSM took from the response.
+void
+Http2ServerStream::update_window()
+{
+  if (this->session == NULL || this->response_done) {
+    return;
+  }
+
+  int64_t drained = static_cast<int64_t>(Http2::initial_window_size) - this->recv_window - this->resp_reader->read_avail();
+
+  if (drained >= Http2::initial_window_size / 2) {
+    this->session->send_window_update(this->id, drained);
+    this->recv_window += drained;
+  }
+}
+
+void
+Http2ServerStream::reset(Http2ErrorCode ec)
+{
+  if (this->session && this->started) {
+    this->session->send_rst_stream(this->id, ec);
+  }
+  this->detach();
+}
+
+void
+Http2ServerStream::detach()
+{
+  if (this->session) {
+    Http2ServerSession *ssn = this->session;
+
+    this->session = NULL;
+    ssn->stream_closed(this);
+  }
+}
+
+void
+Http2ServerStream::session_closed()
+{
+  this->session = NULL;
+  if (!this->response_done) {
+    this->close();
+  }
+}
+
+// Close the PluginVC, which the HttpSM sees as the end of the response. The stream is freed once it was accepted.
+void
+Http2ServerStream::close()
+{
+  ink_assert(this->session == NULL);
+
+  if (this->vc == NULL) {
+    this->aborted = true;
+    return;
+  }
+
+  this->vc->do_io_close();
+  this->vc = NULL;
+  this->destroy();
+}
+
+//
+// Http2ServerSession
+//
+
+void
+Http2ServerSession::init(Http2ServerSessionPool *p, Http2ServerOrigin *o, NetVCOptions const &options)
+{
+  this->con_id = ink_atomic_increment(&next_con_id, 1);
+  this->pool = p;
+  this->origin = o;
+  ats_ip_copy(&this->addr, &o->addr);
+  this->tls = o->tls;
+
+  this->opt = options;
+  this->opt.f_blocking_connect = false;
+#if TS_USE_TLS_ALPN
+  if (this->tls) {
+    static const unsigned char alpn_protos[] = {2, 'h', '2'};
+
+    this->opt.alpn_protos = alpn_protos;
+    this->opt.alpn_protos_len = sizeof(alpn_protos);
+  }
+#endif
+
+  this->read_buffer = new_MIOBuffer(HTTP2_HEADER_BUFFER_SIZE_INDEX);
+  // Keep reading until a whole frame of the largest size is buffered.
+  this->read_buffer->water_mark = HTTP2_FRAME_HEADER_LEN + HTTP2_MAX_FRAME_SIZE;
+  this->reader = this->read_buffer->alloc_reader();
+  this->write_buffer = new_MIOBuffer(HTTP2_HEADER_BUFFER_SIZE_INDEX);
+  this->write_reader = this->write_buffer->alloc_reader();
+
+  this->local_indexing_table = new Http2IndexingTable();
+  this->remote_indexing_table = new Http2IndexingTable();
+
+  // 3.5 HTTP/2 Connection Preface. The client sends it with its SETTINGS before anything else, which are queued
+  // until the connection is open.
+  this->write_buffer->write(HTTP2_CONNECTION_PREFACE, HTTP2_CONNECTION_PREFACE_LEN);
+
+  const Http2SettingsParameter params[] = {{HTTP2_SETTINGS_ENABLE_PUSH, 0},
+                                           {HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, Http2::initial_window_size}};
+  Http2Frame settings(HTTP2_FRAME_TYPE_SETTINGS, 0, 0);
+  settings.alloc(BUFFER_SIZE_INDEX_128);
+
+  IOVec iov = settings.write();
+  for (unsigned i = 0; i < countof(params); ++i) {
+    http2_write_settings(params[i], iov);
+    iov.iov_base = reinterpret_cast<uint8_t *>(iov.iov_base) + HTTP2_SETTINGS_PARAMETER_LEN;
+    iov.iov_len -= HTTP2_SETTINGS_PARAMETER_LEN;
+  }
+  settings.finalize(countof(params) * HTTP2_SETTINGS_PARAMETER_LEN);
+  settings.xmit(this->write_buffer);
+
+  Http2WindowSize window = connection_window_size();
+  if (window > this->recv_window) {
+    this->send_window_update(0, window - this->recv_window);
+    this->recv_window = window;
+  }
+
+  HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_CURRENT_SERVER_SESSION_COUNT, this_ethread());
+  DebugHttp2Ss("session born, %s", this->tls ? "h2" : "h2c");
+
+  SET_HANDLER(&Http2ServerSession::main_event_handler);
+  this_ethread()->schedule_imm(this);
+}
+
+void
+Http2ServerSession::destroy()
+{
+  DebugHttp2Ss0("session destroy");
+
+  ink_assert(this->closing);
+
+  if (this->close_event) {
+    this->close_event->cancel();
+    this->close_event = NULL;
+  }
+
+  // The session shares the mutex of the pool.
+  if (this->origin) {
+    this->pool->session_closed(this);
+  }
+
+  while (Http2ServerStream *stream = this->streams.pop()) {
+    stream->session_closed();
+  }
+
+  if (this->server_vc) {
+    this->server_vc->do_io_close();
+    this->server_vc = NULL;
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, -1);
+    ConnectionCount::getInstance()->incrementCount(this->addr, -1);
+  }
+
+  free_MIOBuffer(this->read_buffer);
+  free_MIOBuffer(this->write_buffer);
+  delete this->local_indexing_table;
+  delete this->remote_indexing_table;
+  ats_free(this->continued_buffer);
+  this->continued_buffer = NULL;
+
+  HTTP2_DECREMENT_THREAD_DYN_STAT(HTTP2_STAT_CURRENT_SERVER_SESSION_COUNT, this_ethread());
+
+  this->opt.reset();
+  this->mutex.clear();
+  http2ServerSessionAllocator.free(this);
+}
+
+int
+Http2ServerSession::main_event_handler(int event, void *edata)
+{
+  DebugHttp2Ss("[%s]", HttpDebugNames::get_event_name(event));
+
+  ++this->recursion;
+
+  switch (event) {
+  case EVENT_IMMEDIATE:
+    this->connect();
+    break;
+
+  case NET_EVENT_OPEN:
+    this->server_vc = static_cast<NetVConnection *>(edata);
+    this->server_vc->set_inactivity_timeout(HRTIME_SECONDS(Http2::no_activity_timeout_out));
+    HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_TOTAL_SERVER_CONNECTION_COUNT, this_ethread());
+    // The connection counts against the server connection limits once, for all the streams it carries.
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, 1);
+    HTTP_INCREMENT_DYN_STAT(http_total_server_connections_stat);
+    ConnectionCount::getInstance()->incrementCount(this->addr);
+    this->read_vio = this->server_vc->do_io_read(this, INT64_MAX, this->read_buffer);
+    this->write_vio = this->server_vc->do_io_write(this, INT64_MAX, this->write_reader);
+    break;
+
+  case NET_EVENT_OPEN_FAILED:
+    // The origin is left to HTTP/1.1 for a while, which retries the connection as configured.
+    this->negotiation_failed = true;
+    this->do_close();
+    break;
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    this->read_frames();
+    break;
+
+  case VC_EVENT_WRITE_READY:
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+
+  case HTTP2_SESSION_EVENT_FINI:
+    this->close_event = NULL;
+    break;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    if (!this->verified) {
+      this->negotiation_failed = true;
+    }
+    this->do_close();
+    break;
+  }
+
+  if (--this->recursion == 0 && this->closing) {
+    this->destroy();
+  }
+
+  return 0;
+}
+
+void
+Http2ServerSession::connect()
+{
+  char addrbuf[INET6_ADDRPORTSTRLEN];
+  DebugHttp2Ss("connect to %s", ats_ip_nptop(&this->addr.sa, addrbuf, sizeof(addrbuf)));
+
+  if (this->tls) {
+    sslNetProcessor.connect_re(this, &this->addr.sa, &this->opt);
+  } else {
+    netProcessor.connect_re(this, &this->addr.sa, &this->opt);
+  }
+}
+
+bool
+Http2ServerSession::has_capacity() const
+{
+  uint32_t limit = min(this->peer_max_streams, Http2::max_concurrent_streams_out);
+
+  return !this->closing && !this->goaway_received && this->open_streams < limit &&
+         this->next_stream_id + 2 * this->open_streams < MAX_STREAM_ID;
+}
+
+PluginVCCore *
+Http2ServerSession::new_stream(sockaddr const *to)
+{
+  Http2ServerStream *stream = http2ServerStreamAllocator.alloc();
+  PluginVCCore *core = PluginVCCore::alloc();
+
+  stream->init(this, core);
+  core->set_accept_cont(stream);
+  core->set_active_addr(to);
+
+  this->streams.enqueue(stream);
+  ++this->open_streams;
+
+  DebugHttp2Ss("new stream, %u open", this->open_streams);
+
+  return core;
+}
+
+void
+Http2ServerSession::xmit(Http2Frame &frame)
+{
+  frame.xmit(this->write_buffer);
+  if (this->write_vio) {
+    this->write_vio->reenable();
+  }
+}
+
+// Send the HEADERS of the streams whose requests are read, as far as the origin allows concurrent streams.
+void
+Http2ServerSession::start_streams()
+{
+  if (!this->verified || this->closing || this->starting) {
+    return;
+  }
+
+  this->starting = true;
+
+  Http2ServerStream *stream = this->streams.head;
+  while (stream && this->active_streams < this->peer_max_streams && !this->closing) {
+    Http2ServerStream *next = stream->link.next;
+
+    if (stream->request_parsed && !stream->started) {
+      stream->start();
+    }
+    stream = next;
+  }
+
+  this->starting = false;
+}
+
+void
+Http2ServerSession::stream_closed(Http2ServerStream *stream)
+{
+  this->streams.remove(stream);
+  --this->open_streams;
+  if (stream->started) {
+    --this->active_streams;
+  }
+
+  DebugHttp2Ss("stream %u closed, %u open", stream->id, this->open_streams);
+
+  if (this->goaway_received && this->open_streams == 0) {
+    this->do_close();
+  } else {
+    this->start_streams();
+  }
+}
+
+bool
+Http2ServerSession::write_headers(Http2ServerStream *stream, HTTPHdr *hdr, bool end_stream)
+{
+  uint8_t payload_buffer[HEADERS_PAYLOAD_LEN];
+  int64_t payload_length = 0;
+  int64_t len;
+
+  // [RFC 7541] 4.2. A change of the maximum table size is signaled at the start of the next header block
+  if (this->table_size_update >= 0) {
+    len = encode_integer(payload_buffer, payload_buffer + HEADERS_PAYLOAD_LEN, this->table_size_update, 5);
+    if (len == -1) {
+      return false;
+    }
+    payload_buffer[0] |= 0x20;
+    payload_length += len;
+    this->table_size_update = -1;
+  }
+
+  len = http2_write_psuedo_headers(hdr, payload_buffer + payload_length, HEADERS_PAYLOAD_LEN - payload_length,
+                                   *this->remote_indexing_table);
+  if (len == -1) {
+    return false;
+  }
+  payload_length += len;
+
+  // The Host is sent as :authority
+  hdr->field_delete(MIME_FIELD_HOST, MIME_LEN_HOST);
+
+  MIMEFieldIter field_iter;
+  bool cont = false;
+  Http2FrameType type = HTTP2_FRAME_TYPE_HEADERS;
+  uint8_t flags = end_stream ? HTTP2_FLAGS_HEADERS_END_STREAM : 0;
+
+  do {
+    len = http2_write_header_fragment(hdr, field_iter, payload_buffer + payload_length, HEADERS_PAYLOAD_LEN - payload_length,
+                                      *this->remote_indexing_table, cont);
+    if (len == -1) {
+      return false;
+    }
+    payload_length += len;
+
+    if (!cont) {
+      flags |= HTTP2_FLAGS_HEADERS_END_HEADERS;
+    }
+
+    Http2Frame headers(type, stream->id, flags);
+    headers.alloc(BUFFER_SIZE_INDEX_16K);
+    http2_write_headers(payload_buffer, payload_length, headers.write());
+    headers.finalize(payload_length);
+    this->xmit(headers);
+
+    type = HTTP2_FRAME_TYPE_CONTINUATION;
+    flags = 0;
+    payload_length = 0;
+  } while (cont);
+
+  return true;
+}
+
+void
+Http2ServerSession::send_window_update(Http2StreamId id, uint32_t size)
+{
+  Http2Frame window_update(HTTP2_FRAME_TYPE_WINDOW_UPDATE, id, 0);
+
+  window_update.alloc(BUFFER_SIZE_INDEX_128);
+  http2_write_window_update(size, window_update.write());
+  window_update.finalize(HTTP2_WINDOW_UPDATE_LEN);
+  this->xmit(window_update);
+}
+
+void
+Http2ServerSession::send_rst_stream(Http2StreamId id, Http2ErrorCode ec)
+{
+  DebugHttp2Ss("send RST_STREAM on stream %u, error %d", id, ec);
+
+  if (ec != HTTP2_ERROR_NO_ERROR && ec != HTTP2_ERROR_CANCEL) {
+    HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_STREAM_ERRORS_COUNT, this_ethread());
+  }
+
+  Http2Frame rst_stream(HTTP2_FRAME_TYPE_RST_STREAM, id, 0);
+
+  rst_stream.alloc(BUFFER_SIZE_INDEX_128);
+  http2_write_rst_stream(static_cast<uint32_t>(ec), rst_stream.write());
+  rst_stream.finalize(HTTP2_RST_STREAM_LEN);
+  this->xmit(rst_stream);
+}
+
+void
+Http2ServerSession::connection_error(Http2ErrorCode ec)
+{
+  DebugHttp2Ss("connection error %d", ec);
+
+  if (this->closing) {
+    return;
+  }
+
+  HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_CONNECTION_ERRORS_COUNT, this_ethread());
+
+  Http2Frame frame(HTTP2_FRAME_TYPE_GOAWAY, 0, 0);
+  Http2Goaway goaway;
+
+  goaway.last_streamid = 0;
+  goaway.error_code = ec;
+
+  frame.alloc(BUFFER_SIZE_INDEX_128);
+  http2_write_goaway(goaway, frame.write());
+  frame.finalize(HTTP2_GOAWAY_LEN);
+  this->xmit(frame);
+
+  this->do_close();
+}
+
+// Close the session once the handler returns, or right away if a stream closes it.
+void
+Http2ServerSession::do_close()
+{
+  if (this->closing) {
+    return;
+  }
+
+  this->closing = true;
+  if (this->recursion == 0 && this->close_event == NULL) {
+    this->close_event = this_ethread()->schedule_imm(this, HTTP2_SESSION_EVENT_FINI);
+  }
+}
+
+Http2ServerStream *
+Http2ServerSession::find_stream(Http2StreamId id) const
+{
+  for (Http2ServerStream *s = this->streams.head; s; s = s->link.next) {
+    if (s->id == id) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+// The origin talks HTTP/2 if it selected h2 by ALPN, and its first frame is SETTINGS.
+bool
+Http2ServerSession::check_negotiation(const Http2FrameHeader &hdr)
+{
+#if TS_USE_TLS_ALPN
+  if (this->tls) {
+    SSLNetVConnection *ssl_vc = dynamic_cast<SSLNetVConnection *>(this->server_vc);
+    const unsigned char *proto = NULL;
+    unsigned len = 0;
+
+    if (ssl_vc && ssl_vc->ssl) {
+      SSL_get0_alpn_selected(ssl_vc->ssl, &proto, &len);
+    }
+    if (len != 2 || memcmp(proto, "h2", 2) != 0) {
+      DebugHttp2Ss0("origin did not select h2");
+      return false;
+    }
+  }
+#endif
+
+  if (hdr.type != HTTP2_FRAME_TYPE_SETTINGS || (hdr.flags & HTTP2_FLAGS_SETTINGS_ACK) || hdr.streamid != 0) {
+    DebugHttp2Ss0("origin did not send SETTINGS");
+    return false;
+  }
+
+  return true;
+}
+
+void
+Http2ServerSession::read_frames()
+{
+  while (!this->closing && this->reader->read_avail() >= static_cast<int64_t>(HTTP2_FRAME_HEADER_LEN)) {
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+
+    copy_from_buffer_reader(buf, this->reader, sizeof(buf));
+    http2_parse_frame_header(make_iovec(buf), hdr);
+
+    if (!this->verified && !this->check_negotiation(hdr)) {
+      HTTP2_INCREMENT_THREAD_DYN_STAT(HTTP2_STAT_SERVER_NEGOTIATION_FAILURES, this_ethread());
+      this->negotiation_failed = true;
+      this->do_close();
+      return;
+    }
+
+    if (!http2_frame_header_is_valid(hdr, HTTP2_MAX_FRAME_SIZE)) {
+      this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+      return;
+    }
+
+    // We do not raise SETTINGS_MAX_FRAME_SIZE
+    if (hdr.length > HTTP2_MAX_FRAME_SIZE) {
+      this->connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+      return;
+    }
+
+    if (this->reader->read_avail() < static_cast<int64_t>(HTTP2_FRAME_HEADER_LEN + hdr.length)) {
+      break;
+    }
+
+    DebugHttp2Ss("received frame length=%u, type=%u, flags=0x%x, streamid=%u", hdr.length, hdr.type, hdr.flags, hdr.streamid);
+
+    this->reader->consume(HTTP2_FRAME_HEADER_LEN);
+    Http2Frame frame(hdr, this->reader);
+    this->recv_frame(frame);
+    this->reader->consume(hdr.length);
+  }
+
+  if (!this->closing) {
+    this->start_streams();
+    this->read_vio->reenable();
+  }
+}
+
+void
+Http2ServerSession::recv_frame(const Http2Frame &frame)
+{
+  const Http2FrameHeader &hdr = frame.header();
+  uint8_t buf[CONTROL_PAYLOAD_LEN];
+
+  // [RFC 7540] 6.10. A header block is a contiguous sequence of frames, without frames of any other type or stream.
+  if (this->continued_stream_id != 0 &&
+      (hdr.type != HTTP2_FRAME_TYPE_CONTINUATION || hdr.streamid != this->continued_stream_id)) {
+    this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+    return;
+  }
+
+  switch (hdr.type) {
+  case HTTP2_FRAME_TYPE_DATA: {
+    unsigned offset = 0;
+    unsigned pad_length = 0;
+
+    // Flow control covers the whole payload, also of streams which are closed already.
+    this->recv_window -= hdr.length;
+    if (this->recv_window < 0) {
+      this->connection_error(HTTP2_ERROR_FLOW_CONTROL_ERROR);
+      return;
+    }
+    if (this->recv_window < connection_window_size() / 2) {
+      this->send_window_update(0, connection_window_size() - this->recv_window);
+      this->recv_window = connection_window_size();
+    }
+
+    if (hdr.flags & HTTP2_FLAGS_DATA_PADDED) {
+      uint8_t pad;
+
+      if (hdr.length < 1 || copy_from_buffer_reader(&pad, frame.reader(), 1) != 1 || pad >= hdr.length) {
+        this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+        return;
+      }
+      offset = 1;
+      pad_length = pad;
+    }
+
+    Http2ServerStream *stream = this->find_stream(hdr.streamid);
+    if (stream == NULL) {
+      return;
+    }
+
+    stream->recv_window -= hdr.length;
+    if (stream->recv_window < 0) {
+      this->send_rst_stream(hdr.streamid, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+      stream->recv_rst_stream(HTTP2_ERROR_FLOW_CONTROL_ERROR);
+      return;
+    }
+
+    stream->recv_data(frame.reader(), offset, hdr.length - offset - pad_length, hdr.flags & HTTP2_FLAGS_DATA_END_STREAM);
+    break;
+  }
+
+  case HTTP2_FRAME_TYPE_HEADERS:
+  case HTTP2_FRAME_TYPE_CONTINUATION: {
+    unsigned offset = 0;
+    unsigned pad_length = 0;
+
+    if (hdr.streamid == 0) {
+      this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+      return;
+    }
+
+    if (hdr.type == HTTP2_FRAME_TYPE_HEADERS) {
+      if (hdr.flags & HTTP2_FLAGS_HEADERS_PADDED) {
+        uint8_t pad;
+
+        if (hdr.length < 1 || copy_from_buffer_reader(&pad, frame.reader(), 1) != 1) {
+          this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+          return;
+        }
+        offset += 1;
+        pad_length = pad;
+      }
+      if (hdr.flags & HTTP2_FLAGS_HEADERS_PRIORITY) {
+        offset += HTTP2_PRIORITY_LEN;
+      }
+      if (offset + pad_length > hdr.length) {
+        this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+        return;
+      }
+      this->continued_stream_id = hdr.streamid;
+      this->continued_end_stream = hdr.flags & HTTP2_FLAGS_HEADERS_END_STREAM;
+      this->continued_length = 0;
+    } else if (this->continued_stream_id == 0) {
+      this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+      return;
+    }
+
+    uint32_t fragment_length = hdr.length - offset - pad_length;
+    if (this->continued_length + fragment_length > Http2::max_request_header_size) {
+      this->connection_error(HTTP2_ERROR_ENHANCE_YOUR_CALM);
+      return;
+    }
+
+    this->continued_buffer = static_cast<uint8_t *>(ats_realloc(this->continued_buffer, this->continued_length + fragment_length));
+    frame.reader()->memcpy(this->continued_buffer + this->continued_length, fragment_length, offset);
+    this->continued_length += fragment_length;
+
+    if (hdr.flags & HTTP2_FLAGS_HEADERS_END_HEADERS) {
+      Http2StreamId id = this->continued_stream_id;
+
+      this->continued_stream_id = 0;
+      this->recv_headers(id, this->continued_buffer, this->continued_length, this->continued_end_stream);
+    }
+    break;
+  }
+
+  case HTTP2_FRAME_TYPE_RST_STREAM: {
+    Http2RstStream rst_stream;
+
+    if (hdr.streamid == 0 || hdr.length != HTTP2_RST_STREAM_LEN) {
+      this->connection_error(hdr.streamid == 0 ? HTTP2_ERROR_PROTOCOL_ERROR : HTTP2_ERROR_FRAME_SIZE_ERROR);
+      return;
+    }
+    copy_from_buffer_reader(buf, frame.reader(), hdr.length);
+    http2_parse_rst_stream(make_iovec(buf, hdr.length), rst_stream);
+
+    Http2ServerStream *stream = this->find_stream(hdr.streamid);
+    if (stream) {
+      stream->recv_rst_stream(rst_stream.error_code);
+    }
+    break;
+  }
+
+  case HTTP2_FRAME_TYPE_SETTINGS:
+    this->recv_settings(frame);
+    break;
+
+  case HTTP2_FRAME_TYPE_PING:
+    if (hdr.streamid != 0 || hdr.length != HTTP2_PING_LEN) {
+      this->connection_error(hdr.streamid != 0 ? HTTP2_ERROR_PROTOCOL_ERROR : HTTP2_ERROR_FRAME_SIZE_ERROR);
+      return;
+    }
+    if (!(hdr.flags & HTTP2_FLAGS_PING_ACK)) {
+      Http2Frame ping(HTTP2_FRAME_TYPE_PING, 0, HTTP2_FLAGS_PING_ACK);
+
+      copy_from_buffer_reader(buf, frame.reader(), HTTP2_PING_LEN);
+      ping.alloc(BUFFER_SIZE_INDEX_128);
+      http2_write_ping(buf, ping.write());
+      ping.finalize(HTTP2_PING_LEN);
+      this->xmit(ping);
+    }
+    break;
+
+  case HTTP2_FRAME_TYPE_GOAWAY:
+    this->recv_goaway(frame);
+    break;
+
+  case HTTP2_FRAME_TYPE_WINDOW_UPDATE:
+    this->recv_window_update(frame);
+    break;
+
+  case HTTP2_FRAME_TYPE_PUSH_PROMISE:
+    // Server push is disabled by our SETTINGS.
+    this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+    break;
+
+  default:
+    // [RFC 7540] 5.5. Extending HTTP/2. Frames of unknown types and PRIORITY are ignored.
+    break;
+  }
+}
+
+void
+Http2ServerSession::recv_headers(Http2StreamId id, const uint8_t *buf, uint32_t len, bool end_stream)
+{
+  Http2ServerStream *stream = this->find_stream(id);
+  HTTPHdr hdr;
+  bool trailing = stream && stream->headers_received;
+
+  // The header block is decoded also for unknown streams, to keep the indexing table in sync.
+  hdr.create(HTTP_TYPE_RESPONSE);
+  int64_t result = http2_decode_header_blocks(&hdr, buf, buf + len, *this->local_indexing_table, trailing);
+
+  if (result == HPACK_ERROR_COMPRESSION_ERROR) {
+    this->connection_error(HTTP2_ERROR_COMPRESSION_ERROR);
+  } else if (stream && result < 0) {
+    this->send_rst_stream(id, HTTP2_ERROR_PROTOCOL_ERROR);
+    stream->recv_rst_stream(HTTP2_ERROR_PROTOCOL_ERROR);
+  } else if (stream) {
+    stream->recv_headers(&hdr, end_stream);
+  }
+
+  hdr.destroy();
+}
+
+void
+Http2ServerSession::recv_settings(const Http2Frame &frame)
+{
+  const Http2FrameHeader &hdr = frame.header();
+
+  if (hdr.streamid != 0) {
+    this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+    return;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_SETTINGS_ACK) {
+    if (hdr.length != 0) {
+      this->connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+    }
+    return;
+  }
+
+  if (hdr.length % HTTP2_SETTINGS_PARAMETER_LEN != 0) {
+    this->connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+    return;
+  }
+
+  for (unsigned nbytes = 0; nbytes < hdr.length; nbytes += HTTP2_SETTINGS_PARAMETER_LEN) {
+    uint8_t buf[HTTP2_SETTINGS_PARAMETER_LEN];
+    Http2SettingsParameter param;
+
+    frame.reader()->memcpy(buf, HTTP2_SETTINGS_PARAMETER_LEN, nbytes);
+    http2_parse_settings_parameter(make_iovec(buf), param);
+
+    // Unknown settings are ignored.
+    if (param.id == 0 || param.id >= HTTP2_SETTINGS_MAX) {
+      continue;
+    }
+    if (!http2_settings_parameter_is_valid(param)) {
+      this->connection_error(param.id == HTTP2_SETTINGS_INITIAL_WINDOW_SIZE ? HTTP2_ERROR_FLOW_CONTROL_ERROR :
+                                                                                HTTP2_ERROR_PROTOCOL_ERROR);
+      return;
+    }
+
+    DebugHttp2Ss("origin setting %u=%u", param.id, param.value);
+
+    switch (param.id) {
+    case HTTP2_SETTINGS_HEADER_TABLE_SIZE:
+      // The table is only ever shrunk from the default size.
+      if (param.value < this->remote_indexing_table->get_dynamic_table_size()) {
+        this->remote_indexing_table->set_dynamic_table_size(param.value);
+        this->table_size_update = param.value;
+      }
+      break;
+
+    case HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS:
+      this->peer_max_streams = param.value;
+      break;
+
+    case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE: {
+      // [RFC 7540] 6.9.2. The change applies to the windows of all open streams.
+      int64_t delta = static_cast<int64_t>(param.value) - this->peer_initial_window;
+
+      for (Http2ServerStream *s = this->streams.head; s; s = s->link.next) {
+        if (s->send_window + delta > HTTP2_MAX_WINDOW_SIZE) {
+          this->connection_error(HTTP2_ERROR_FLOW_CONTROL_ERROR);
+          return;
+        }
+        s->send_window += delta;
+      }
+      this->peer_initial_window = param.value;
+      break;
+    }
+
+    case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+      this->peer_max_frame_size = param.value;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  Http2Frame ack(HTTP2_FRAME_TYPE_SETTINGS, 0, HTTP2_FLAGS_SETTINGS_ACK);
+  this->xmit(ack);
+
+  if (!this->verified) {
+    DebugHttp2Ss0("origin talks HTTP/2");
+    this->verified = true;
+  }
+
+  for (Http2ServerStream *s = this->streams.head; s && !this->closing;) {
+    Http2ServerStream *next = s->link.next;
+
+    s->send_body();
+    s = next;
+  }
+}
+
+void
+Http2ServerSession::recv_goaway(const Http2Frame &frame)
+{
+  const Http2FrameHeader &hdr = frame.header();
+  uint8_t buf[HTTP2_GOAWAY_LEN];
+  Http2Goaway goaway;
+
+  if (hdr.streamid != 0 || hdr.length < HTTP2_GOAWAY_LEN) {
+    this->connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+    return;
+  }
+
+  copy_from_buffer_reader(buf, frame.reader(), sizeof(buf));
+  http2_parse_goaway(make_iovec(buf), goaway);
+
+  DebugHttp2Ss("received GOAWAY, last stream %u, error %u", goaway.last_streamid, goaway.error_code);
+
+  // The streams after the last one, and those not started yet, are not processed by the origin.
+  this->goaway_received = true;
+
+  Http2ServerStream *stream = this->streams.head;
+  while (stream) {
+    Http2ServerStream *next = stream->link.next;
+
+    if (!stream->started || stream->id > goaway.last_streamid) {
+      stream->recv_rst_stream(HTTP2_ERROR_REFUSED_STREAM);
+    }
+    stream = next;
+  }
+
+  if (this->open_streams == 0) {
+    this->do_close();
+  }
+}
+
+void
+Http2ServerSession::recv_window_update(const Http2Frame &frame)
+{
+  const Http2FrameHeader &hdr = frame.header();
+  uint8_t buf[HTTP2_WINDOW_UPDATE_LEN];
+  uint32_t size;
+
+  if (hdr.length != HTTP2_WINDOW_UPDATE_LEN) {
+    this->connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+    return;
+  }
+
+  copy_from_buffer_reader(buf, frame.reader(), sizeof(buf));
+  http2_parse_window_update(make_iovec(buf), size);
+
+  if (hdr.streamid == 0) {
+    if (size == 0 || static_cast<int64_t>(this->send_window) + size > HTTP2_MAX_WINDOW_SIZE) {
+      this->connection_error(size == 0 ? HTTP2_ERROR_PROTOCOL_ERROR : HTTP2_ERROR_FLOW_CONTROL_ERROR);
+      return;
+    }
+    this->send_window += size;
+
+    for (Http2ServerStream *s = this->streams.head; s && this->send_window > 0;) {
+      Http2ServerStream *next = s->link.next;
+
+      s->send_body();
+      s = next;
+    }
+    return;
+  }
+
+  Http2ServerStream *stream = this->find_stream(hdr.streamid);
+  if (stream == NULL) {
+    return;
+  }
+
+  if (size == 0 || static_cast<int64_t>(stream->send_window) + size > HTTP2_MAX_WINDOW_SIZE) {
+    this->send_rst_stream(hdr.streamid, size == 0 ? HTTP2_ERROR_PROTOCOL_ERROR : HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    stream->recv_rst_stream(HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    return;
+  }
+  stream->send_window += size;
+  stream->send_body();
+}
+
+//
+// Http2ServerSessionPool
+//
+
+Http2ServerSessionPool::Http2ServerSessionPool() : Continuation(new_ProxyMutex())
+{
+}
+
+PluginVCCore *
+Http2ServerSessionPool::acquire_stream(sockaddr const *addr, INK_MD5 const &hostname_hash, bool tls, NetVCOptions const &opt)
+{
+  EThread *ethread = this_ethread();
+  // Only the sessions of the pool, on this thread, hold the lock besides the transactions.
+  SCOPED_MUTEX_LOCK(lock, mutex, ethread);
+
+  // Forget the origins whose fall back to HTTP/1.1 is over.
+  ink_hrtime now = Thread::get_hrtime();
+  while (Http2ServerOrigin *o = m_fallback.head) {
+    if (o->fallback_until > now) {
+      break;
+    }
+    m_fallback.remove(o);
+    o->fallback_until = 0;
+    if (o->sessions.empty()) {
+      m_origins.remove(m_origins.find(o));
+      delete o;
+    }
+  }
+
+  Http2ServerOrigin key;
+  ats_ip_copy(&key.addr, addr);
+  key.hostname_hash = hostname_hash;
+  key.tls = tls;
+
+  OriginHashTable::Location loc = m_origins.find(static_cast<OriginHashing::Key>(&key));
+  Http2ServerOrigin *origin = loc;
+
+  if (origin == NULL) {
+    origin = new Http2ServerOrigin;
+    ats_ip_copy(&origin->addr, addr);
+    origin->hostname_hash = hostname_hash;
+    origin->tls = tls;
+    m_origins.insert(origin);
+  } else if (origin->fallback_until) {
+    return NULL;
+  }
+
+  // Streams only go on sessions which talk HTTP/2 already, a session which fails to negotiate, or to connect,
+  // would fail the transactions on it.
+  bool opening = false;
+  for (Http2ServerSession *session = origin->sessions.head; session; session = session->origin_link.next) {
+    if (session->verified && session->has_capacity()) {
+      return session->new_stream(addr);
+    }
+    if (!session->verified && !session->closing) {
+      opening = true;
+    }
+  }
+
+  // Open one session at a time, the transaction uses HTTP/1.1 meanwhile.
+  if (!opening) {
+    Http2ServerSession *session = http2ServerSessionAllocator.alloc();
+
+    session->mutex = mutex;
+    session->init(this, origin, opt);
+    origin->sessions.push(session);
+  }
+
+  return NULL;
+}
+
+void
+Http2ServerSessionPool::session_closed(Http2ServerSession *session)
+{
+  Http2ServerOrigin *origin = session->origin;
+
+  origin->sessions.remove(session);
+  session->origin = NULL;
+
+  if (session->negotiation_failed) {
+    char addrbuf[INET6_ADDRPORTSTRLEN];
+    Debug("http2_ss", "origin %s falls back to HTTP/1.1 for %u seconds", ats_ip_nptop(&origin->addr.sa, addrbuf, sizeof(addrbuf)),
+          Http2::origin_fallback_time);
+
+    if (origin->fallback_until) {
+      m_fallback.remove(origin);
+    }
+    origin->fallback_until = Thread::get_hrtime() + HRTIME_SECONDS(Http2::origin_fallback_time);
+    m_fallback.enqueue(origin);
+  }
+
+  if (origin->sessions.empty() && origin->fallback_until == 0) {
+    m_origins.remove(m_origins.find(origin));
+    delete origin;
+  }
+}
+
+#if TS_HAS_TESTS
+
+void forceLinkRegressionHttp2ServerSession();
+void
+forceLinkRegressionHttp2ServerSessionCaller()
+{
+  forceLinkRegressionHttp2ServerSession();
+}
+
+#endif /* TS_HAS_TESTS */
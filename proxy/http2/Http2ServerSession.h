@@ -0,0 +1,275 @@
+/** @file
+
+  Http2ServerSession.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HTTP2_SERVER_SESSION_H__
+#define __HTTP2_SERVER_SESSION_H__
+
+#include "HTTP2.h"
+#include "HPACK.h"
+#include "Http2ClientSession.h"
+#include "PluginVC.h"
+#include "ts/INK_MD5.h"
+#include "ts/Map.h"
+
+class Http2ServerSession;
+class Http2ServerSessionPool;
+struct Http2ServerOrigin;
+
+// Http2ServerStream
+//
+// One transaction to an origin over a HTTP/2 connection. The HttpSM talks HTTP/1.1 to the stream through a
+// PluginVC, as it does to a server intercept, and the stream translates the request into HEADERS and DATA
+// frames, and the frames of the response back into a HTTP/1.1 response.
+
+class Http2ServerStream : public Continuation
+{
+public:
+  Http2ServerStream()
+    : Continuation(NULL), session(NULL), id(0), core(NULL), vc(NULL), req_buffer(NULL), req_reader(NULL), read_vio(NULL),
+      resp_buffer(NULL), resp_reader(NULL), write_vio(NULL), resp_bytes(0), body_todo(0), send_window(0), recv_window(0),
+      request_parsed(false), started(false), head(false), chunked(false), headers_received(false), response_done(false),
+      end_stream_sent(false), aborted(false)
+  {
+  }
+
+  void init(Http2ServerSession *ssn, PluginVCCore *pvc);
+  int main_event_handler(int event, void *edata);
+
+  // Called by the session, with its mutex held.
+  void start();
+  void send_body();
+  void recv_headers(HTTPHdr *hdr, bool end_stream);
+  void recv_data(IOBufferReader *reader, int64_t offset, int64_t len, bool end_stream);
+  void recv_rst_stream(uint32_t error_code);
+  void update_window();
+  void session_closed();
+
+  Http2ServerSession *session; ///< @c NULL once the stream is closed on the connection.
+  Http2StreamId id;            ///< 0 until the HEADERS are sent.
+  PluginVCCore *core;
+  VConnection *vc; ///< Passive side of @a core, once accepted.
+
+  MIOBuffer *req_buffer;
+  IOBufferReader *req_reader;
+  VIO *read_vio;
+
+  MIOBuffer *resp_buffer;
+  IOBufferReader *resp_reader;
+  VIO *write_vio;
+  int64_t resp_bytes;
+
+  HTTPParser http_parser;
+  HTTPHdr request;
+  int64_t body_todo;
+
+  Http2WindowSize send_window;
+  Http2WindowSize recv_window;
+
+  bool request_parsed;
+  bool started;
+  bool head;
+  bool chunked;
+  bool headers_received;
+  bool response_done;
+  bool end_stream_sent;
+  bool aborted;
+
+  LINK(Http2ServerStream, link);
+
+private:
+  void process_request();
+  void finish_response();
+  void reset(Http2ErrorCode ec);
+  void detach();
+  void close();
+  void destroy();
+};
+
+// Http2ServerSession
+//
+// A HTTP/2 connection to an origin, which multiplexes the streams of many transactions.
+
+class Http2ServerSession : public Continuation
+{
+public:
+  Http2ServerSession()
+    : Continuation(NULL), con_id(0), pool(NULL), origin(NULL), server_vc(NULL), read_buffer(NULL), reader(NULL), read_vio(NULL),
+      write_buffer(NULL), write_reader(NULL), write_vio(NULL), local_indexing_table(NULL), remote_indexing_table(NULL),
+      close_event(NULL), next_stream_id(1), open_streams(0), active_streams(0), send_window(HTTP2_INITIAL_WINDOW_SIZE),
+      recv_window(HTTP2_INITIAL_WINDOW_SIZE), peer_max_streams(UINT32_MAX), peer_initial_window(HTTP2_INITIAL_WINDOW_SIZE),
+      peer_max_frame_size(HTTP2_MAX_FRAME_SIZE), table_size_update(-1), continued_buffer(NULL), continued_length(0),
+      continued_stream_id(0), continued_end_stream(false), tls(false), verified(false), goaway_received(false), closing(false),
+      negotiation_failed(false), starting(false), recursion(0)
+  {
+    ink_zero(addr);
+  }
+
+  void init(Http2ServerSessionPool *p, Http2ServerOrigin *o, NetVCOptions const &opt);
+  void destroy();
+  int main_event_handler(int event, void *edata);
+
+  /// Check if another stream can be opened on the session.
+  bool has_capacity() const;
+  /// Attach a new stream, for which a PluginVC is returned.
+  PluginVCCore *new_stream(sockaddr const *addr);
+
+  // Called by the streams.
+  void xmit(Http2Frame &frame);
+  void start_streams();
+  void stream_closed(Http2ServerStream *stream);
+  bool write_headers(Http2ServerStream *stream, HTTPHdr *hdr, bool end_stream);
+  void send_window_update(Http2StreamId id, uint32_t size);
+  void send_rst_stream(Http2StreamId id, Http2ErrorCode ec);
+  void connection_error(Http2ErrorCode ec);
+
+  int64_t con_id;
+  Http2ServerSessionPool *pool;
+  Http2ServerOrigin *origin; ///< @c NULL once the session is removed from the pool.
+  IpEndpoint addr;
+  NetVCOptions opt;
+
+  NetVConnection *server_vc;
+  MIOBuffer *read_buffer;
+  IOBufferReader *reader;
+  VIO *read_vio;
+  MIOBuffer *write_buffer;
+  IOBufferReader *write_reader;
+  VIO *write_vio;
+
+  Http2IndexingTable *local_indexing_table;
+  Http2IndexingTable *remote_indexing_table;
+  Event *close_event;
+
+  Queue<Http2ServerStream> streams;
+  Http2StreamId next_stream_id;
+  uint32_t open_streams;   ///< Attached streams, including those which are not started yet.
+  uint32_t active_streams; ///< Streams which are started.
+
+  Http2WindowSize send_window;
+  Http2WindowSize recv_window;
+
+  // Settings of the origin.
+  uint32_t peer_max_streams;
+  uint32_t peer_initial_window;
+  uint32_t peer_max_frame_size;
+  int64_t table_size_update; ///< Pending dynamic table size update to send, or -1.
+
+  uint8_t *continued_buffer;
+  uint32_t continued_length;
+  Http2StreamId continued_stream_id;
+  bool continued_end_stream;
+
+  bool tls;
+  bool verified; ///< The origin sent its SETTINGS.
+  bool goaway_received;
+  bool closing;
+  bool negotiation_failed;
+  bool starting;
+  int recursion;
+
+  LINK(Http2ServerSession, origin_link);
+
+private:
+  void connect();
+  void read_frames();
+  bool check_negotiation(const Http2FrameHeader &hdr);
+  void recv_frame(const Http2Frame &frame);
+  void recv_headers(Http2StreamId id, const uint8_t *buf, uint32_t len, bool end_stream);
+  void recv_settings(const Http2Frame &frame);
+  void recv_goaway(const Http2Frame &frame);
+  void recv_window_update(const Http2Frame &frame);
+  Http2ServerStream *find_stream(Http2StreamId id) const;
+  void do_close();
+};
+
+/// An origin which is reached over HTTP/2.
+struct Http2ServerOrigin {
+  Http2ServerOrigin() : tls(false), fallback_until(0) { ink_zero(addr); }
+
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  bool tls;
+  ink_hrtime fallback_until; ///< HTTP/1.1 is used until then, as the origin failed to negotiate HTTP/2.
+  DLL<Http2ServerSession, Http2ServerSession::Link_origin_link> sessions;
+
+  LINK(Http2ServerOrigin, hash_link);
+  LINK(Http2ServerOrigin, fallback_link);
+};
+
+/** The HTTP/2 connections to origins of a net thread.
+
+    Sessions are kept per origin address and host name. A transaction gets a stream on a session which
+    received the SETTINGS of the origin and has spare capacity. If there is none, a new session is opened,
+    and the transaction uses HTTP/1.1, as it does while the origin has yet to tell whether it talks HTTP/2,
+    and for a while if it did not. So no transaction waits for a connection which may fail to negotiate.
+
+    The sessions share the mutex of their pool, and run on its thread.
+*/
+class Http2ServerSessionPool : public Continuation
+{
+public:
+  Http2ServerSessionPool();
+
+  /** Get a stream to the origin at @a addr. This must be called on the thread of the pool.
+
+      @return The PluginVC core which the transaction connects to, or @c NULL to use HTTP/1.1.
+  */
+  PluginVCCore *acquire_stream(sockaddr const *addr, INK_MD5 const &hostname_hash, bool tls, NetVCOptions const &opt);
+
+  /// Remove a closing session from its origin, with the mutex of the pool held.
+  void session_closed(Http2ServerSession *session);
+
+private:
+  /// Interface class for the origin map.
+  struct OriginHashing {
+    typedef uint64_t ID;
+    typedef Http2ServerOrigin const *Key;
+    typedef Http2ServerOrigin Value;
+    typedef DList(Http2ServerOrigin, hash_link) ListHead;
+
+    static ID
+    hash(Key key)
+    {
+      return key->hostname_hash.fold() ^ ats_ip_hash(&key->addr.sa);
+    }
+    static Key
+    key(Value const *value)
+    {
+      return value;
+    }
+    static bool
+    equal(Key lhs, Key rhs)
+    {
+      return ats_ip_addr_port_eq(&lhs->addr.sa, &rhs->addr.sa) && lhs->hostname_hash == rhs->hostname_hash &&
+             lhs->tls == rhs->tls;
+    }
+  };
+
+  typedef TSHashTable<OriginHashing> OriginHashTable;
+
+  OriginHashTable m_origins;
+  /// Origins which fell back to HTTP/1.1, by the end of the fall back.
+  Queue<Http2ServerOrigin, Http2ServerOrigin::Link_fallback_link> m_fallback;
+};
+
+#endif // __HTTP2_SERVER_SESSION_H__
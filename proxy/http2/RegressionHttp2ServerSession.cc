@@ -0,0 +1,981 @@
+/** @file
+
+  Regression tests for the HTTP/2 sessions to origin servers.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "Http2ServerSession.h"
+#include "ts/ink_code.h"
+#include "ts/TestBox.h"
+
+/***********************************************************************************
+ *                                                                                 *
+ *                Regression test for the HTTP/2 origin sessions                   *
+ *                                                                                 *
+ *  The transactions are played by test clients which write HTTP/1.1 requests on   *
+ *  the streams of an Http2ServerSessionPool of their own, as the HttpSM does, to  *
+ *  a fake origin server on the loopback.                                          *
+ *                                                                                 *
+ ***********************************************************************************/
+
+// The stream window of the fake origin, small enough for a request body to take several WINDOW_UPDATEs.
+const static uint32_t ORIGIN_WINDOW_SIZE = 16384;
+const static int MAX_ORIGIN_STREAMS = 8;
+const static int MAX_TEST_CLIENTS = 3;
+const static char ORIGIN_HOST[] = "origin.test";
+
+const static ink_hrtime TEST_POLL_INTERVAL = HRTIME_MSECONDS(10);
+const static ink_hrtime TEST_TIMEOUT = HRTIME_SECONDS(30);
+
+enum FakeOriginMode {
+  FAKE_ORIGIN_H2,        ///< Answers the streams once @a hold requests arrived on the connection.
+  FAKE_ORIGIN_H2_GOAWAY, ///< As above, but the first connection sends a GOAWAY and answers only its first stream.
+  FAKE_ORIGIN_H1,        ///< Answers the preface with an HTTP/1.1 error.
+};
+
+static void
+write_frame(MIOBuffer *buffer, uint8_t type, uint8_t flags, Http2StreamId id, const uint8_t *payload, uint32_t len)
+{
+  Http2FrameHeader hdr = {len, type, flags, id};
+  uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+
+  http2_write_frame_header(hdr, make_iovec(buf));
+  buffer->write(buf, sizeof(buf));
+  if (len > 0) {
+    buffer->write(payload, len);
+  }
+}
+
+static void
+write_window_update(MIOBuffer *buffer, Http2StreamId id, uint32_t size)
+{
+  uint8_t buf[HTTP2_WINDOW_UPDATE_LEN];
+
+  http2_write_window_update(size, make_iovec(buf));
+  write_frame(buffer, HTTP2_FRAME_TYPE_WINDOW_UPDATE, 0, id, buf, sizeof(buf));
+}
+
+struct FakeOrigin;
+
+struct FakeOriginStream {
+  FakeOriginStream()
+    : id(0), body_received(0), resp_len(0), resp_sent(0), send_window(0), recv_window(ORIGIN_WINDOW_SIZE), fill(0),
+      request_done(false), refused(false), headers_sent(false), closed(false)
+  {
+    text[0] = '\0';
+  }
+
+  Http2StreamId id;
+  int64_t body_received;
+  int64_t resp_len;
+  int64_t resp_sent;
+  int64_t send_window;
+  int64_t recv_window;
+  char fill;     ///< The bytes of a GET response.
+  char text[32]; ///< The response to a POST, the length of its body.
+  bool request_done;
+  bool refused;
+  bool headers_sent;
+  bool closed;
+};
+
+/** A connection of the fake origin. It runs the server side of HTTP/2, and checks the flow control of the client.
+ */
+struct FakeOriginConnection : public Continuation {
+  FakeOriginConnection(FakeOrigin *o, NetVConnection *netvc);
+
+  int main_event_handler(int event, void *edata);
+
+  void read_frames();
+  void recv_frame(const Http2FrameHeader &hdr);
+  void recv_headers(const Http2FrameHeader &hdr);
+  void recv_data(const Http2FrameHeader &hdr);
+  void send_responses();
+  void close();
+
+  FakeOriginStream *find_stream(Http2StreamId id);
+
+  FakeOrigin *origin;
+  NetVConnection *vc;
+  MIOBuffer *read_buffer;
+  IOBufferReader *reader;
+  VIO *read_vio;
+  MIOBuffer *write_buffer;
+  IOBufferReader *write_reader;
+  VIO *write_vio;
+
+  Http2IndexingTable indexing_table;
+  FakeOriginStream streams[MAX_ORIGIN_STREAMS];
+  int nstreams;
+  int open_streams;
+  int hold;
+  bool goaway;
+
+  int64_t send_window;
+  int64_t recv_window;
+  int64_t peer_initial_window;
+  bool preface_received;
+
+  uint8_t payload[HTTP2_MAX_FRAME_SIZE];
+};
+
+/** The fake origin server. It listens on an ephemeral port of the loopback, and counts what it saw.
+ */
+struct FakeOrigin : public Continuation {
+  FakeOrigin(FakeOriginMode m, int h)
+    : Continuation(new_ProxyMutex()), mode(m), hold(h), accept_action(NULL), connections(0), closed(0), requests(0),
+      max_open_streams(0), violations(0), goaway_sent(false)
+  {
+    ink_zero(addr);
+    SET_HANDLER(&FakeOrigin::accept_event);
+  }
+
+  bool
+  start()
+  {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    socklen_t len = sizeof(this->addr.sin);
+
+    ats_ip4_set(&this->addr, htonl(INADDR_LOOPBACK), 0);
+    if (fd < 0 || bind(fd, &this->addr.sa, sizeof(this->addr.sin)) < 0 || listen(fd, 16) < 0 ||
+        getsockname(fd, &this->addr.sa, &len) < 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return false;
+    }
+
+    NetProcessor::AcceptOptions opt;
+    opt.local_port = ats_ip_port_host_order(&this->addr);
+    opt.localhost_only = true;
+    opt.accept_threads = 0;
+    opt.frequent_accept = false;
+
+    this->accept_action = netProcessor.main_accept(this, fd, opt);
+    return true;
+  }
+
+  void
+  stop()
+  {
+    if (this->accept_action) {
+      this->accept_action->cancel();
+      this->accept_action = NULL;
+    }
+  }
+
+  int
+  accept_event(int event, void *edata)
+  {
+    if (event == NET_EVENT_ACCEPT) {
+      ++this->connections;
+      new FakeOriginConnection(this, static_cast<NetVConnection *>(edata));
+    }
+    return EVENT_CONT;
+  }
+
+  FakeOriginMode mode;
+  int hold;
+  IpEndpoint addr;
+  Action *accept_action;
+
+  int connections;
+  int closed;
+  int requests;
+  int max_open_streams;
+  int violations; ///< Frames which broke the protocol or the flow control.
+  bool goaway_sent;
+};
+
+FakeOriginConnection::FakeOriginConnection(FakeOrigin *o, NetVConnection *netvc)
+  : Continuation(o->mutex), origin(o), vc(netvc), nstreams(0), open_streams(0), hold(o->hold), goaway(false),
+    send_window(HTTP2_INITIAL_WINDOW_SIZE), recv_window(HTTP2_INITIAL_WINDOW_SIZE), peer_initial_window(HTTP2_INITIAL_WINDOW_SIZE),
+    preface_received(false)
+{
+  // Only the first connection goes away, the requests retried on the next one are answered one by one.
+  if (o->mode == FAKE_ORIGIN_H2_GOAWAY) {
+    this->goaway = !o->goaway_sent;
+    if (!this->goaway) {
+      this->hold = 1;
+    }
+  }
+
+  this->read_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  // Keep reading until a whole frame of the largest size is buffered.
+  this->read_buffer->water_mark = HTTP2_FRAME_HEADER_LEN + HTTP2_MAX_FRAME_SIZE;
+  this->reader = this->read_buffer->alloc_reader();
+  this->write_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  this->write_reader = this->write_buffer->alloc_reader();
+
+  if (o->mode != FAKE_ORIGIN_H1) {
+    const Http2SettingsParameter params[] = {{HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, MAX_ORIGIN_STREAMS},
+                                             {HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, ORIGIN_WINDOW_SIZE}};
+    uint8_t buf[sizeof(params) / sizeof(params[0]) * HTTP2_SETTINGS_PARAMETER_LEN];
+
+    for (unsigned i = 0; i < sizeof(params) / sizeof(params[0]); ++i) {
+      http2_write_settings(params[i], make_iovec(buf + i * HTTP2_SETTINGS_PARAMETER_LEN, HTTP2_SETTINGS_PARAMETER_LEN));
+    }
+    write_frame(this->write_buffer, HTTP2_FRAME_TYPE_SETTINGS, 0, 0, buf, sizeof(buf));
+  }
+
+  SET_HANDLER(&FakeOriginConnection::main_event_handler);
+  this->read_vio = this->vc->do_io_read(this, INT64_MAX, this->read_buffer);
+  this->write_vio = this->vc->do_io_write(this, INT64_MAX, this->write_reader);
+}
+
+int
+FakeOriginConnection::main_event_handler(int event, void * /* edata ATS_UNUSED */)
+{
+  switch (event) {
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    this->read_frames();
+    break;
+
+  case VC_EVENT_WRITE_READY:
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+
+  default:
+    this->close();
+    break;
+  }
+
+  return EVENT_CONT;
+}
+
+void
+FakeOriginConnection::close()
+{
+  ++this->origin->closed;
+
+  this->vc->do_io_close();
+  free_MIOBuffer(this->read_buffer);
+  free_MIOBuffer(this->write_buffer);
+  this->mutex.clear();
+  delete this;
+}
+
+FakeOriginStream *
+FakeOriginConnection::find_stream(Http2StreamId id)
+{
+  for (int i = 0; i < this->nstreams; ++i) {
+    if (this->streams[i].id == id) {
+      return &this->streams[i];
+    }
+  }
+  return NULL;
+}
+
+void
+FakeOriginConnection::read_frames()
+{
+  if (this->origin->mode == FAKE_ORIGIN_H1) {
+    static const char response[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    if (!this->preface_received) {
+      this->preface_received = true;
+      this->write_buffer->write(response, sizeof(response) - 1);
+      this->write_vio->reenable();
+    }
+    this->reader->consume(this->reader->read_avail());
+    this->read_vio->reenable();
+    return;
+  }
+
+  if (!this->preface_received) {
+    char preface[HTTP2_CONNECTION_PREFACE_LEN];
+
+    if (this->reader->read_avail() < static_cast<int64_t>(HTTP2_CONNECTION_PREFACE_LEN)) {
+      this->read_vio->reenable();
+      return;
+    }
+    this->reader->memcpy(preface, sizeof(preface));
+    this->reader->consume(sizeof(preface));
+    if (memcmp(preface, HTTP2_CONNECTION_PREFACE, HTTP2_CONNECTION_PREFACE_LEN) != 0) {
+      ++this->origin->violations;
+    }
+    this->preface_received = true;
+  }
+
+  while (this->reader->read_avail() >= static_cast<int64_t>(HTTP2_FRAME_HEADER_LEN)) {
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+
+    this->reader->memcpy(buf, sizeof(buf));
+    http2_parse_frame_header(make_iovec(buf), hdr);
+    if (hdr.length > HTTP2_MAX_FRAME_SIZE) {
+      ++this->origin->violations;
+      this->close();
+      return;
+    }
+    if (this->reader->read_avail() < static_cast<int64_t>(HTTP2_FRAME_HEADER_LEN + hdr.length)) {
+      break;
+    }
+
+    this->reader->consume(HTTP2_FRAME_HEADER_LEN);
+    this->reader->memcpy(this->payload, hdr.length);
+    this->reader->consume(hdr.length);
+    this->recv_frame(hdr);
+  }
+
+  this->send_responses();
+  this->read_vio->reenable();
+}
+
+void
+FakeOriginConnection::recv_frame(const Http2FrameHeader &hdr)
+{
+  switch (hdr.type) {
+  case HTTP2_FRAME_TYPE_SETTINGS:
+    if (hdr.flags & HTTP2_FLAGS_SETTINGS_ACK) {
+      break;
+    }
+    for (unsigned nbytes = 0; nbytes + HTTP2_SETTINGS_PARAMETER_LEN <= hdr.length; nbytes += HTTP2_SETTINGS_PARAMETER_LEN) {
+      Http2SettingsParameter param;
+
+      http2_parse_settings_parameter(make_iovec(this->payload + nbytes, HTTP2_SETTINGS_PARAMETER_LEN), param);
+      if (param.id == HTTP2_SETTINGS_INITIAL_WINDOW_SIZE) {
+        for (int i = 0; i < this->nstreams; ++i) {
+          this->streams[i].send_window += static_cast<int64_t>(param.value) - this->peer_initial_window;
+        }
+        this->peer_initial_window = param.value;
+      }
+    }
+    write_frame(this->write_buffer, HTTP2_FRAME_TYPE_SETTINGS, HTTP2_FLAGS_SETTINGS_ACK, 0, NULL, 0);
+    break;
+
+  case HTTP2_FRAME_TYPE_WINDOW_UPDATE: {
+    uint32_t size = 0;
+
+    http2_parse_window_update(make_iovec(this->payload, HTTP2_WINDOW_UPDATE_LEN), size);
+    if (hdr.streamid == 0) {
+      this->send_window += size;
+    } else if (FakeOriginStream *stream = this->find_stream(hdr.streamid)) {
+      stream->send_window += size;
+    }
+    break;
+  }
+
+  case HTTP2_FRAME_TYPE_HEADERS:
+    this->recv_headers(hdr);
+    break;
+
+  case HTTP2_FRAME_TYPE_DATA:
+    this->recv_data(hdr);
+    break;
+
+  case HTTP2_FRAME_TYPE_RST_STREAM:
+    if (FakeOriginStream *stream = this->find_stream(hdr.streamid)) {
+      if (!stream->closed) {
+        stream->closed = true;
+        --this->open_streams;
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void
+FakeOriginConnection::recv_headers(const Http2FrameHeader &hdr)
+{
+  // The requests are small, and sent without padding or priority.
+  if (!(hdr.flags & HTTP2_FLAGS_HEADERS_END_HEADERS) || (hdr.flags & (HTTP2_FLAGS_HEADERS_PADDED | HTTP2_FLAGS_HEADERS_PRIORITY)) ||
+      this->nstreams == MAX_ORIGIN_STREAMS || this->find_stream(hdr.streamid)) {
+    ++this->origin->violations;
+    return;
+  }
+
+  FakeOriginStream &stream = this->streams[this->nstreams++];
+  HTTPHdr request;
+  bool trailing = false;
+  int method_len = 0, path_len = 0;
+  const char *method = NULL, *path = NULL;
+
+  request.create(HTTP_TYPE_REQUEST);
+  if (http2_decode_header_blocks(&request, this->payload, this->payload + hdr.length, this->indexing_table, trailing) < 0) {
+    ++this->origin->violations;
+  }
+
+  MIMEField *field = request.field_find(HPACK_VALUE_METHOD, HPACK_LEN_METHOD);
+  if (field) {
+    method = field->value_get(&method_len);
+  }
+  field = request.field_find(HPACK_VALUE_PATH, HPACK_LEN_PATH);
+  if (field) {
+    path = field->value_get(&path_len);
+  }
+
+  stream.id = hdr.streamid;
+  stream.send_window = this->peer_initial_window;
+  stream.request_done = hdr.flags & HTTP2_FLAGS_HEADERS_END_STREAM;
+
+  // GET /<length>/<byte> is answered with the byte repeated, a POST with the length of its body.
+  if (method && method_len == 3 && memcmp(method, "GET", 3) == 0 && path && path_len < 64) {
+    char buf[64];
+
+    memcpy(buf, path, path_len);
+    buf[path_len] = '\0';
+    if (sscanf(buf, "/%" PRId64 "/%c", &stream.resp_len, &stream.fill) != 2) {
+      ++this->origin->violations;
+    }
+  }
+
+  request.destroy();
+
+  ++this->origin->requests;
+  ++this->open_streams;
+  this->origin->max_open_streams = max(this->origin->max_open_streams, this->open_streams);
+
+  if (this->goaway && this->nstreams == this->hold) {
+    Http2Goaway goaway;
+    uint8_t buf[HTTP2_GOAWAY_LEN];
+
+    goaway.last_streamid = this->streams[0].id;
+    goaway.error_code = HTTP2_ERROR_NO_ERROR;
+    http2_write_goaway(goaway, make_iovec(buf));
+    write_frame(this->write_buffer, HTTP2_FRAME_TYPE_GOAWAY, 0, 0, buf, sizeof(buf));
+    this->origin->goaway_sent = true;
+
+    for (int i = 1; i < this->nstreams; ++i) {
+      this->streams[i].refused = true;
+    }
+  }
+}
+
+void
+FakeOriginConnection::recv_data(const Http2FrameHeader &hdr)
+{
+  FakeOriginStream *stream = this->find_stream(hdr.streamid);
+
+  this->recv_window -= hdr.length;
+  if (this->recv_window < 0) {
+    ++this->origin->violations;
+  }
+  if (hdr.length > 0) {
+    write_window_update(this->write_buffer, 0, hdr.length);
+    this->recv_window += hdr.length;
+  }
+
+  if (stream == NULL || stream->request_done) {
+    ++this->origin->violations;
+    return;
+  }
+
+  stream->recv_window -= hdr.length;
+  if (stream->recv_window < 0) {
+    ++this->origin->violations;
+  }
+  stream->body_received += hdr.length;
+
+  if (hdr.flags & HTTP2_FLAGS_DATA_END_STREAM) {
+    stream->request_done = true;
+    stream->resp_len = snprintf(stream->text, sizeof(stream->text), "%" PRId64, stream->body_received);
+  } else if (hdr.length > 0) {
+    write_window_update(this->write_buffer, stream->id, hdr.length);
+    stream->recv_window += hdr.length;
+  }
+}
+
+// Answer the requests which are read, within the windows the client gave.
+void
+FakeOriginConnection::send_responses()
+{
+  if (this->nstreams >= this->hold) {
+    for (int i = 0; i < this->nstreams; ++i) {
+      FakeOriginStream &stream = this->streams[i];
+
+      if (!stream.request_done || stream.refused || stream.closed) {
+        continue;
+      }
+
+      if (!stream.headers_sent) {
+        uint8_t buf[64];
+        uint8_t *p = buf;
+        char len[32];
+        int n = snprintf(len, sizeof(len), "%" PRId64, stream.resp_len);
+
+        // :status 200, and content-length as a literal without indexing of the indexed name.
+        *p++ = 0x88;
+        *p++ = 0x0f;
+        *p++ = 0x0d;
+        p += encode_string(p, buf + sizeof(buf), len, n);
+
+        write_frame(this->write_buffer, HTTP2_FRAME_TYPE_HEADERS,
+                    HTTP2_FLAGS_HEADERS_END_HEADERS | (stream.resp_len == 0 ? HTTP2_FLAGS_HEADERS_END_STREAM : 0), stream.id, buf,
+                    p - buf);
+        stream.headers_sent = true;
+      }
+
+      while (stream.resp_sent < stream.resp_len) {
+        int64_t len = min(stream.resp_len - stream.resp_sent, static_cast<int64_t>(ORIGIN_WINDOW_SIZE));
+        len = min(len, min(this->send_window, stream.send_window));
+        if (len <= 0) {
+          break;
+        }
+
+        if (stream.fill) {
+          memset(this->payload, stream.fill, len);
+        } else {
+          memcpy(this->payload, stream.text + stream.resp_sent, len);
+        }
+        stream.resp_sent += len;
+        this->send_window -= len;
+        stream.send_window -= len;
+        uint8_t flags = stream.resp_sent == stream.resp_len ? HTTP2_FLAGS_DATA_END_STREAM : 0;
+        write_frame(this->write_buffer, HTTP2_FRAME_TYPE_DATA, flags, stream.id, this->payload, len);
+      }
+
+      if (stream.resp_sent == stream.resp_len) {
+        stream.closed = true;
+        --this->open_streams;
+      }
+    }
+  }
+
+  this->write_vio->reenable();
+}
+
+/** A transaction, which writes an HTTP/1.1 request on a stream and reads the response until the stream closes.
+ */
+struct TestClient : public Continuation {
+  TestClient(ProxyMutex *m)
+    : Continuation(m), vc(NULL), req_buffer(NULL), resp_buffer(NULL), resp_reader(NULL), fill(0), status(0), body_len(0),
+      head_len(0), body_ok(true), head_done(false), done(false)
+  {
+    head[0] = '\0';
+    body[0] = '\0';
+    SET_HANDLER(&TestClient::main_event_handler);
+  }
+
+  ~TestClient()
+  {
+    if (this->vc) {
+      this->vc->do_io_close();
+    }
+    if (this->req_buffer) {
+      free_MIOBuffer(this->req_buffer);
+    }
+    if (this->resp_buffer) {
+      free_MIOBuffer(this->resp_buffer);
+    }
+    this->mutex.clear();
+  }
+
+  /// GET a response of @a len times @a c, or POST a body of @a len bytes if @a c is 0.
+  void
+  start(PluginVCCore *core, int64_t len, char c)
+  {
+    char request[256];
+    int n;
+
+    this->fill = c;
+    this->req_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+    this->resp_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+    this->resp_reader = this->resp_buffer->alloc_reader();
+
+    if (c) {
+      n = snprintf(request, sizeof(request), "GET /%" PRId64 "/%c HTTP/1.1\r\nHost: %s\r\n\r\n", len, c, ORIGIN_HOST);
+    } else {
+      n = snprintf(request, sizeof(request), "POST /post HTTP/1.1\r\nHost: %s\r\nContent-Length: %" PRId64 "\r\n\r\n", ORIGIN_HOST,
+                   len);
+    }
+
+    IOBufferReader *req_reader = this->req_buffer->alloc_reader();
+    int64_t total = n;
+
+    this->req_buffer->write(request, n);
+    if (c == 0) {
+      memset(request, 'p', sizeof(request));
+      for (int64_t todo = len; todo > 0; todo -= sizeof(request)) {
+        this->req_buffer->write(request, min(todo, static_cast<int64_t>(sizeof(request))));
+      }
+      total += len;
+    }
+
+    Action *action = core->connect_re(this);
+    ink_release_assert(action == ACTION_RESULT_DONE && this->vc != NULL);
+    this->vc->do_io_write(this, total, req_reader);
+    this->vc->do_io_read(this, INT64_MAX, this->resp_buffer);
+  }
+
+  int
+  main_event_handler(int event, void *edata)
+  {
+    switch (event) {
+    case NET_EVENT_OPEN:
+      this->vc = static_cast<VConnection *>(edata);
+      break;
+
+    case VC_EVENT_READ_READY:
+    case VC_EVENT_READ_COMPLETE:
+      this->read_response(static_cast<VIO *>(edata));
+      break;
+
+    case VC_EVENT_WRITE_READY:
+    case VC_EVENT_WRITE_COMPLETE:
+      break;
+
+    default:
+      this->read_response(NULL);
+      this->done = true;
+      break;
+    }
+
+    return EVENT_CONT;
+  }
+
+  void
+  read_response(VIO *vio)
+  {
+    char buf[4096];
+    int64_t n;
+
+    while ((n = min(this->resp_reader->read_avail(), static_cast<int64_t>(sizeof(buf)))) > 0) {
+      this->resp_reader->memcpy(buf, n);
+      this->resp_reader->consume(n);
+
+      for (int64_t i = 0; i < n; ++i) {
+        if (!this->head_done) {
+          if (this->head_len < static_cast<int>(sizeof(this->head)) - 1) {
+            this->head[this->head_len++] = buf[i];
+            this->head[this->head_len] = '\0';
+          }
+          if (this->head_len >= 4 && memcmp(this->head + this->head_len - 4, "\r\n\r\n", 4) == 0) {
+            this->head_done = true;
+            sscanf(this->head, "HTTP/1.1 %d", &this->status);
+          }
+          continue;
+        }
+
+        if (this->body_len < static_cast<int64_t>(sizeof(this->body)) - 1) {
+          this->body[this->body_len] = buf[i];
+          this->body[this->body_len + 1] = '\0';
+        }
+        if (this->fill && buf[i] != this->fill) {
+          this->body_ok = false;
+        }
+        ++this->body_len;
+      }
+    }
+
+    if (vio) {
+      vio->reenable();
+    }
+  }
+
+  VConnection *vc;
+  MIOBuffer *req_buffer;
+  MIOBuffer *resp_buffer;
+  IOBufferReader *resp_reader;
+
+  char fill;
+  int status;
+  int64_t body_len;
+  char head[4096];
+  int head_len;
+  char body[32]; ///< The start of the body.
+  bool body_ok;  ///< All bytes of the body were @a fill.
+  bool head_done;
+  bool done; ///< The stream closed.
+};
+
+/** Runs a test step by step on one thread, polling the pool as the transactions would.
+ */
+struct Http2ServerSessionTest : public Continuation {
+  Http2ServerSessionTest(RegressionTest *t, int *pstatus, FakeOriginMode mode, int hold)
+    : Continuation(new_ProxyMutex()), box(t, pstatus), pool(new Http2ServerSessionPool), origin(new FakeOrigin(mode, hold)),
+      nclients(0), stage(0), deadline(Thread::get_hrtime() + TEST_TIMEOUT)
+  {
+    ink_code_md5((unsigned char const *)ORIGIN_HOST, strlen(ORIGIN_HOST), (unsigned char *)&this->hostname_hash);
+    SET_HANDLER(&Http2ServerSessionTest::main_event_handler);
+  }
+
+  virtual ~Http2ServerSessionTest()
+  {
+    for (int i = 0; i < this->nclients; ++i) {
+      delete this->clients[i];
+    }
+    this->mutex.clear();
+  }
+
+  /// Do the next step, and return @c true once the test is over.
+  virtual bool step() = 0;
+
+  void
+  start()
+  {
+    this->box = REGRESSION_TEST_INPROGRESS;
+    if (!this->box.check(this->origin->start(), "failed to listen for the fake origin")) {
+      delete this;
+      return;
+    }
+    this_ethread()->schedule_imm(this);
+  }
+
+  int
+  main_event_handler(int /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */)
+  {
+    bool over = this->step();
+
+    if (!over && Thread::get_hrtime() > this->deadline) {
+      this->box.check(false, "timed out in stage %d", this->stage);
+      over = true;
+    }
+
+    if (over) {
+      if (*this->box._status == REGRESSION_TEST_INPROGRESS) {
+        this->box = REGRESSION_TEST_PASSED;
+      }
+      // The pool and the origin are left to the sessions, which go away on their inactivity timeout.
+      this->origin->stop();
+      delete this;
+    } else {
+      // The sessions of the pool run on this thread.
+      this_ethread()->schedule_in(this, TEST_POLL_INTERVAL);
+    }
+
+    return EVENT_DONE;
+  }
+
+  PluginVCCore *
+  acquire()
+  {
+    NetVCOptions opt;
+
+    return this->pool->acquire_stream(&this->origin->addr.sa, this->hostname_hash, false, opt);
+  }
+
+  TestClient *
+  start_client(PluginVCCore *core, int64_t len, char c)
+  {
+    TestClient *client = new TestClient(this->mutex);
+
+    ink_release_assert(this->nclients < MAX_TEST_CLIENTS);
+    this->clients[this->nclients++] = client;
+    client->start(core, len, c);
+    return client;
+  }
+
+  bool
+  clients_done() const
+  {
+    for (int i = 0; i < this->nclients; ++i) {
+      if (!this->clients[i]->done) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void
+  check_response(TestClient *client, int64_t len, const char *body)
+  {
+    this->box.check(client->status == 200, "expected status 200, got %d", client->status);
+    this->box.check(client->body_len == len, "expected a body of %" PRId64 " bytes, got %" PRId64, len, client->body_len);
+    this->box.check(client->body_ok, "the body has bytes other than '%c'", client->fill);
+    if (body) {
+      this->box.check(strcmp(client->body, body) == 0, "expected the body '%s', got '%s'", body, client->body);
+    }
+  }
+
+  TestBox box;
+  Http2ServerSessionPool *pool;
+  FakeOrigin *origin;
+  INK_MD5 hostname_hash;
+  TestClient *clients[MAX_TEST_CLIENTS];
+  int nclients;
+  int stage;
+  ink_hrtime deadline;
+};
+
+// Two downloads larger than the stream window, and an upload which the origin takes in small windows, all on one
+// connection at the same time.
+struct Http2ServerSessionMultiplexTest : public Http2ServerSessionTest {
+  Http2ServerSessionMultiplexTest(RegressionTest *t, int *pstatus) : Http2ServerSessionTest(t, pstatus, FAKE_ORIGIN_H2, 3) {}
+
+  bool
+  step()
+  {
+    PluginVCCore *core;
+
+    switch (this->stage) {
+    case 0:
+      // The first transaction opens the session, and uses HTTP/1.1.
+      if (!this->box.check(this->acquire() == NULL, "got a stream before the origin sent SETTINGS")) {
+        return true;
+      }
+      ++this->stage;
+      return false;
+
+    case 1:
+      if ((core = this->acquire()) == NULL) {
+        return false;
+      }
+      this->start_client(core, 2 * Http2::initial_window_size + 1000, 'a');
+      for (int i = 1; i < 3; ++i) {
+        if (!this->box.check((core = this->acquire()) != NULL, "no stream on a session with capacity")) {
+          return true;
+        }
+        this->start_client(core, i == 1 ? 2 * Http2::initial_window_size + 1000 : 200000, i == 1 ? 'b' : 0);
+      }
+      ++this->stage;
+      return false;
+
+    default:
+      if (!this->clients_done()) {
+        return false;
+      }
+      this->check_response(this->clients[0], 2 * Http2::initial_window_size + 1000, NULL);
+      this->check_response(this->clients[1], 2 * Http2::initial_window_size + 1000, NULL);
+      this->check_response(this->clients[2], 6, "200000");
+      this->box.check(this->origin->connections == 1, "expected 1 connection, got %d", this->origin->connections);
+      this->box.check(this->origin->max_open_streams == 3, "expected 3 concurrent streams, got %d", this->origin->max_open_streams);
+      this->box.check(this->origin->violations == 0, "the origin saw %d protocol or flow control errors", this->origin->violations);
+      return true;
+    }
+  }
+};
+
+// The origin goes away after the first of two streams. The second stream closes without a response, and the next
+// transaction gets a stream on a new connection.
+struct Http2ServerSessionGoawayTest : public Http2ServerSessionTest {
+  Http2ServerSessionGoawayTest(RegressionTest *t, int *pstatus) : Http2ServerSessionTest(t, pstatus, FAKE_ORIGIN_H2_GOAWAY, 2) {}
+
+  bool
+  step()
+  {
+    PluginVCCore *core;
+
+    switch (this->stage) {
+    case 0:
+      this->acquire();
+      ++this->stage;
+      return false;
+
+    case 1:
+      if ((core = this->acquire()) == NULL) {
+        return false;
+      }
+      this->start_client(core, 1000, 'a');
+      if (!this->box.check((core = this->acquire()) != NULL, "no stream on a session with capacity")) {
+        return true;
+      }
+      this->start_client(core, 1000, 'b');
+      ++this->stage;
+      return false;
+
+    case 2: {
+      if (!this->clients_done()) {
+        return false;
+      }
+
+      TestClient *answered = this->clients[0]->status ? this->clients[0] : this->clients[1];
+      TestClient *refused = this->clients[0]->status ? this->clients[1] : this->clients[0];
+
+      this->check_response(answered, 1000, NULL);
+      this->box.check(refused->head_len == 0, "got a response on a stream after the last stream of the GOAWAY");
+      ++this->stage;
+      return false;
+    }
+
+    case 3:
+      if ((core = this->acquire()) == NULL) {
+        return false;
+      }
+      this->start_client(core, 1000, 'c');
+      ++this->stage;
+      return false;
+
+    default:
+      if (!this->clients_done()) {
+        return false;
+      }
+      this->check_response(this->clients[2], 1000, NULL);
+      this->box.check(this->origin->connections == 2, "expected 2 connections, got %d", this->origin->connections);
+      this->box.check(this->origin->violations == 0, "the origin saw %d protocol or flow control errors", this->origin->violations);
+      return true;
+    }
+  }
+};
+
+// An origin which does not talk HTTP/2 is left to HTTP/1.1, and not connected to again.
+struct Http2ServerSessionFallbackTest : public Http2ServerSessionTest {
+  Http2ServerSessionFallbackTest(RegressionTest *t, int *pstatus) : Http2ServerSessionTest(t, pstatus, FAKE_ORIGIN_H1, 1), polls(0)
+  {
+  }
+
+  bool
+  step()
+  {
+    switch (this->stage) {
+    case 0:
+      if (!this->box.check(this->acquire() == NULL, "got a stream before the origin sent SETTINGS")) {
+        return true;
+      }
+      ++this->stage;
+      return false;
+
+    case 1:
+      // The session is gone once the origin saw the connection close.
+      if (this->origin->closed == 0) {
+        return false;
+      }
+      ++this->stage;
+      return false;
+
+    default:
+      if (!this->box.check(this->acquire() == NULL, "got a stream to an origin which does not talk HTTP/2")) {
+        return true;
+      }
+      if (++this->polls < 10) {
+        return false;
+      }
+      this->box.check(this->origin->connections == 1, "expected 1 connection, got %d", this->origin->connections);
+      return true;
+    }
+  }
+
+  int polls;
+};
+
+REGRESSION_TEST(HTTP2_SERVER_SESSION_Multiplex)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  (new Http2ServerSessionMultiplexTest(t, pstatus))->start();
+}
+
+REGRESSION_TEST(HTTP2_SERVER_SESSION_Goaway)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  (new Http2ServerSessionGoawayTest(t, pstatus))->start();
+}
+
+REGRESSION_TEST(HTTP2_SERVER_SESSION_Fallback)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  (new Http2ServerSessionFallbackTest(t, pstatus))->start();
+}
+
+void
+forceLinkRegressionHttp2ServerSession()
+{
+  // NOTE: Do Nothing
+}
@@ -41,6 +41,7 @@
 #include "LogObject.h"
 #include "LogConfig.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogUtils.h"
 #include "LogSock.h"
 #include "Log.h"
@@ -51,6 +52,7 @@ static int follow_flag = 0;
 static int clf_flag = 0;
 static int elf_flag = 0;
 static int elf2_flag = 0;
+static int columnar_flag = 0;
 static int auto_filenames = 0;
 static int overwrite_existing_file = 0;
 static char output_file[1024];
@@ -67,9 +69,41 @@ static const ArgumentDescription argument_descriptions[] = {
   {"debug_tags", 'T', "Colon-Separated Debug Tags", "S1023", error_tags, NULL, NULL},
   {"overwrite_output", 'w', "Overwrite existing output file(s)", "T", &overwrite_existing_file, NULL, NULL},
   {"elf2", '2', "Convert to Extended2 Logging Format", "T", &elf2_flag, NULL, NULL},
+  {"columnar", 'c', "Convert to the columnar binary format", "T", &columnar_flag, NULL, NULL},
   HELP_ARGUMENT_DESCRIPTION(),
   VERSION_ARGUMENT_DESCRIPTION()};
 
+// byte counts of the columnar conversion, reported on exit
+static int64_t columnar_bytes_in = 0;
+static int64_t columnar_bytes_out = 0;
+
+/*-------------------------------------------------------------------------
+  write_columnar
+
+  Re-encode a row oriented segment as a columnar block; segments that are
+  already columnar (or that do not shrink) are copied unchanged.
+  -------------------------------------------------------------------------*/
+
+static int
+write_columnar(LogBufferHeader *header, int out_fd)
+{
+  int len = header->byte_count;
+  char *block = NULL;
+
+  if (header->cookie == LOG_SEGMENT_COOKIE) {
+    block = LogColumnarWriter::encode(header, &len);
+  }
+
+  int rc = write(out_fd, block ? block : (char *)header, len);
+  ats_free(block);
+
+  columnar_bytes_in += header->byte_count;
+  if (rc > 0) {
+    columnar_bytes_out += rc;
+  }
+  return rc == len ? 0 : 1;
+}
+
 static int
 process_file(int in_fd, int out_fd)
 {
@@ -94,9 +128,12 @@ process_file(int in_fd, int out_fd)
     if (!nread || nread == EOF)
       return 0;
 
-    // ensure that this is a valid logbuffer header
+    // ensure that this is a valid logbuffer header; columnar blocks share
+    // the leading cookie, version, format_type and byte_count words
     //
-    if (header->cookie != LOG_SEGMENT_COOKIE) {
+    if (header->cookie == LOG_COLUMNAR_COOKIE) {
+      header_size = sizeof(LogColumnarHeader);
+    } else if (header->cookie != LOG_SEGMENT_COOKIE) {
       fprintf(stderr, "Bad LogBuffer!\n");
       return 1;
     }
@@ -145,17 +182,38 @@ process_file(int in_fd, int out_fd)
       fprintf(stderr, "Read too many bytes!\n");
       return 1;
     }
+    if (columnar_flag) {
+      if (write_columnar(header, out_fd) != 0) {
+        fprintf(stderr, "Failed to write columnar block!\n");
+        return 1;
+      }
+      continue;
+    }
+    // expand columnar blocks back into a regular segment
+    //
+    LogBufferHeader *segment = header;
+    if (header->cookie == LOG_COLUMNAR_COOKIE) {
+      LogColumnarReader reader((LogColumnarHeader *)header);
+      segment = reader.to_log_buffer();
+      if (!segment) {
+        fprintf(stderr, "Bad columnar LogBuffer!\n");
+        return 1;
+      }
+    }
     // see if there is an alternate format request from the command
     // line
     //
     const char *alt_format = NULL;
     // convert the buffer to ascii entries and place onto stdout
     //
-    if (header->fmt_fieldlist()) {
-      bytes += LogFile::write_ascii_logbuffer(header, out_fd, ".", alt_format);
+    if (segment->fmt_fieldlist()) {
+      bytes += LogFile::write_ascii_logbuffer(segment, out_fd, ".", alt_format);
     } else {
       // TODO investigate why this buffer goes wonky
     }
+    if (segment != header) {
+      ats_free(segment);
+    }
   }
 }
 
@@ -246,7 +304,8 @@ main(int /* argc ATS_UNUSED */, const char *argv[])
 
   if (n_file_arguments) {
     int bin_ext_len = strlen(LOG_FILE_BINARY_OBJECT_FILENAME_EXTENSION);
-    int ascii_ext_len = strlen(LOG_FILE_ASCII_OBJECT_FILENAME_EXTENSION);
+    const char *out_ext = columnar_flag ? LOG_FILE_COLUMNAR_OBJECT_FILENAME_EXTENSION : LOG_FILE_ASCII_OBJECT_FILENAME_EXTENSION;
+    int ascii_ext_len = strlen(out_ext);
 
     for (unsigned i = 0; i < n_file_arguments; ++i) {
       int in_fd = open(file_arguments[i], O_RDONLY);
@@ -259,7 +318,7 @@ main(int /* argc ATS_UNUSED */, const char *argv[])
         posix_fadvise(in_fd, 0, 0, POSIX_FADV_DONTNEED);
 #endif
         if (auto_filenames) {
-          // change .blog to .log
+          // change .blog to .log (or to .clog when converting to columnar)
           //
           int n = strlen(file_arguments[i]);
           int copy_len =
@@ -270,7 +329,7 @@ main(int /* argc ATS_UNUSED */, const char *argv[])
           char *out_filename = (char *)ats_malloc(copy_len + ascii_ext_len + 1);
 
           memcpy(out_filename, file_arguments[i], copy_len);
-          memcpy(&out_filename[copy_len], LOG_FILE_ASCII_OBJECT_FILENAME_EXTENSION, ascii_ext_len);
+          memcpy(&out_filename[copy_len], out_ext, ascii_ext_len);
           out_filename[copy_len + ascii_ext_len] = 0;
 
           out_fd = open_output_file(out_filename);
@@ -306,5 +365,10 @@ main(int /* argc ATS_UNUSED */, const char *argv[])
     }
   }
 
+  if (columnar_flag && columnar_bytes_in > 0) {
+    fprintf(stderr, "columnar: %" PRId64 " bytes in, %" PRId64 " bytes out (%.1f%%)\n", columnar_bytes_in, columnar_bytes_out,
+            100.0 * columnar_bytes_out / columnar_bytes_in);
+  }
+
   _exit(error);
 }
@@ -236,6 +236,10 @@ Log::periodic_tasks(long time_now)
     //
     Log::config->log_object_manager.check_buffer_expiration(time_now);
 
+    // Export the stats of histogram objects that are due
+    //
+    Log::config->log_object_manager.export_histograms(time_now);
+
     // Check if we received a request to roll, and roll if so, otherwise
     // give objects a chance to roll if they need to
     //
@@ -1212,7 +1216,8 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
         buf = (char *)buffer_header;
         total_bytes = buffer_header->byte_count;
 
-      } else if (logfile->m_file_format == LOG_FILE_ASCII || logfile->m_file_format == LOG_FILE_PIPE) {
+      } else if (logfile->m_file_format == LOG_FILE_ASCII || logfile->m_file_format == LOG_FILE_PIPE ||
+                 logfile->m_file_format == LOG_FILE_COLUMNAR) {
         buf = (char *)fdata->m_data;
         total_bytes = fdata->m_len;
 
@@ -1428,9 +1433,14 @@ Log::match_logobject(LogBufferHeader *header)
     LogFormat fmt("__collation_format__", header->fmt_fieldlist(), header->fmt_printf());
 
     if (fmt.valid()) {
-      LogFileFormat file_format = header->log_object_flags & LogObject::BINARY ?
-                                    LOG_FILE_BINARY :
-                                    (header->log_object_flags & LogObject::WRITES_TO_PIPE ? LOG_FILE_PIPE : LOG_FILE_ASCII);
+      LogFileFormat file_format = LOG_FILE_ASCII;
+      if (header->log_object_flags & LogObject::COLUMNAR) {
+        file_format = LOG_FILE_COLUMNAR;
+      } else if (header->log_object_flags & LogObject::BINARY) {
+        file_format = LOG_FILE_BINARY;
+      } else if (header->log_object_flags & LogObject::WRITES_TO_PIPE) {
+        file_format = LOG_FILE_PIPE;
+      }
 
       obj = new LogObject(&fmt, Log::config->logfile_dir, header->log_filename(), file_format, NULL,
                           (Log::RollingEnabledValues)Log::config->rolling_enabled, Log::config->collation_preproc_threads,
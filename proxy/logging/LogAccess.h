@@ -113,13 +113,13 @@
     return len;                   \
   }
 
-#define DEFAULT_IP_FIELD           \
-  {                                \
-    int len = sizeof(LogFieldIp);  \
-    if (buf) {                     \
-      len = marshal_ip(buf, NULL); \
-    }                              \
-    return len;                    \
+#define DEFAULT_IP_FIELD                             \
+  {                                                  \
+    int len = INK_ALIGN_DEFAULT(sizeof(LogFieldIp)); \
+    if (buf) {                                       \
+      len = marshal_ip(buf, NULL);                   \
+    }                                                \
+    return len;                                      \
   }
 
 // should be at least 22 bytes to always accomodate a converted
@@ -0,0 +1,1049 @@
+/** @file
+
+  Columnar, block compressed representation of LogBuffer segments.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+/***************************************************************************
+ LogColumnar.cc
+
+ A LogBuffer segment stores one marshalled entry after the other, so any
+ consumer has to walk every field of every entry.  The columnar block
+ produced here stores each field of a segment contiguously instead:
+ integers as zigzag encoded deltas, strings either plainly or through a
+ per-block dictionary (hosts, methods and content types repeat a lot),
+ and each column is compressed separately with fastlz so that a reader
+ only pays for the columns it actually looks at.
+
+ ***************************************************************************/
+
+#include "ts/ink_platform.h"
+#include "ts/fastlz.h"
+
+#include "Error.h"
+
+#include "LogField.h"
+#include "LogFormat.h"
+#include "LogBuffer.h"
+#include "LogAccess.h"
+#include "LogColumnar.h"
+#include "ts/TestBox.h"
+
+// Columns 0 and 1 hold the LogEntryHeader timestamp and timestamp_usec.
+#define LOG_COLUMNAR_ENTRY_COLUMNS 2
+
+// Columns smaller than this are not worth running through fastlz.
+#define LOG_COLUMNAR_MIN_COMPRESS 64
+
+// Encoding for fields whose marshalled layout is not a single int, string
+// or address (e.g. dINT fields, or cqtx which packs several values); such
+// fields are stored as opaque length prefixed byte runs.
+#define LOG_COLUMN_BLOB 0xff
+
+namespace
+{
+/*-------------------------------------------------------------------------
+  varint helpers
+  -------------------------------------------------------------------------*/
+
+struct ColumnBuf {
+  char *data;
+  size_t len;
+  size_t cap;
+
+  ColumnBuf() : data(NULL), len(0), cap(0) {}
+  ~ColumnBuf() { ats_free(data); }
+
+  void
+  reserve(size_t n)
+  {
+    if (len + n > cap) {
+      cap = (cap * 2 > len + n) ? cap * 2 : len + n + 256;
+      data = (char *)ats_realloc(data, cap);
+    }
+  }
+
+  void
+  put_varint(uint64_t v)
+  {
+    reserve(10);
+    while (v >= 0x80) {
+      data[len++] = (char)(v | 0x80);
+      v >>= 7;
+    }
+    data[len++] = (char)v;
+  }
+
+  void
+  put_bytes(const char *p, size_t n)
+  {
+    reserve(n);
+    memcpy(data + len, p, n);
+    len += n;
+  }
+};
+
+inline bool
+get_varint(const char **p, const char *end, uint64_t *v)
+{
+  uint64_t result = 0;
+  int shift = 0;
+
+  while (*p < end && shift < 64) {
+    uint8_t b = (uint8_t) * (*p)++;
+    result |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+}
+
+inline uint64_t
+zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t
+unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+inline int
+ip_field_len(const LogFieldIp *ip)
+{
+  if (AF_INET == ip->_family) {
+    return sizeof(LogFieldIp4);
+  } else if (AF_INET6 == ip->_family) {
+    return sizeof(LogFieldIp6);
+  }
+  return sizeof(LogFieldIp);
+}
+
+// One marshalled field of one entry, as seen by the writer.
+struct Slot {
+  const char *ptr;
+  int64_t val;     // int value, or string length
+  uint32_t extent; // marshalled length of the field
+};
+
+/*-------------------------------------------------------------------------
+  StringDict
+
+  Small open addressing table mapping the strings of one column to their
+  dictionary index.  The keys point into the segment being encoded.
+  -------------------------------------------------------------------------*/
+
+struct StringDict {
+  struct Bucket {
+    const char *ptr;
+    int len;
+    int index;
+  };
+
+  Bucket *buckets;
+  unsigned mask;
+  int count;
+
+  explicit StringDict(unsigned n) : count(0)
+  {
+    unsigned size = 16;
+    while (size < n * 2) {
+      size <<= 1;
+    }
+    mask = size - 1;
+    buckets = (Bucket *)ats_malloc(size * sizeof(Bucket));
+    memset(buckets, 0, size * sizeof(Bucket));
+  }
+  ~StringDict() { ats_free(buckets); }
+
+  // Returns the dictionary index of the string, adding it if necessary.
+  int
+  lookup(const char *ptr, int len)
+  {
+    uint32_t hash = 2166136261U; // FNV-1a
+    for (int i = 0; i < len; ++i) {
+      hash = (hash ^ (uint8_t)ptr[i]) * 16777619U;
+    }
+
+    for (unsigned i = hash & mask;; i = (i + 1) & mask) {
+      Bucket &b = buckets[i];
+      if (!b.ptr) {
+        b.ptr = ptr;
+        b.len = len;
+        b.index = count++;
+        return b.index;
+      }
+      if (b.len == len && memcmp(b.ptr, ptr, len) == 0) {
+        return b.index;
+      }
+    }
+  }
+};
+
+void
+encode_int_column(const Slot *slots, unsigned n, ColumnBuf &out)
+{
+  int64_t prev = 0;
+
+  for (unsigned i = 0; i < n; ++i) {
+    out.put_varint(zigzag((int64_t)((uint64_t)slots[i].val - (uint64_t)prev)));
+    prev = slots[i].val;
+  }
+}
+
+uint8_t
+encode_string_column(const Slot *slots, unsigned n, ColumnBuf &out)
+{
+  StringDict dict(n);
+  int *indexes = (int *)ats_malloc(n * sizeof(int));
+
+  for (unsigned i = 0; i < n; ++i) {
+    indexes[i] = dict.lookup(slots[i].ptr, (int)slots[i].val);
+  }
+
+  uint8_t encoding;
+  if ((unsigned)dict.count * 2 <= n) {
+    // Emit the dictionary in index order, then the per-row indexes.
+    const StringDict::Bucket **order = (const StringDict::Bucket **)ats_malloc(dict.count * sizeof(StringDict::Bucket *));
+    for (unsigned i = 0; i <= dict.mask; ++i) {
+      if (dict.buckets[i].ptr) {
+        order[dict.buckets[i].index] = &dict.buckets[i];
+      }
+    }
+    out.put_varint(dict.count);
+    for (int i = 0; i < dict.count; ++i) {
+      out.put_varint(order[i]->len);
+      out.put_bytes(order[i]->ptr, order[i]->len);
+    }
+    for (unsigned i = 0; i < n; ++i) {
+      out.put_varint(indexes[i]);
+    }
+    ats_free(order);
+    encoding = LOG_COLUMN_STR_DICT;
+  } else {
+    for (unsigned i = 0; i < n; ++i) {
+      out.put_varint(slots[i].val);
+      out.put_bytes(slots[i].ptr, slots[i].val);
+    }
+    encoding = LOG_COLUMN_STR_PLAIN;
+  }
+
+  ats_free(indexes);
+  return encoding;
+}
+
+void
+encode_ip_column(const Slot *slots, unsigned n, ColumnBuf &out)
+{
+  for (unsigned i = 0; i < n; ++i) {
+    const LogFieldIp *ip = reinterpret_cast<const LogFieldIp *>(slots[i].ptr);
+    out.put_varint(ip->_family);
+    if (AF_INET == ip->_family) {
+      out.put_bytes(reinterpret_cast<const char *>(&static_cast<const LogFieldIp4 *>(ip)->_addr), sizeof(in_addr_t));
+    } else if (AF_INET6 == ip->_family) {
+      out.put_bytes(reinterpret_cast<const char *>(&static_cast<const LogFieldIp6 *>(ip)->_addr), sizeof(in6_addr));
+    }
+  }
+}
+
+void
+encode_blob_column(const Slot *slots, unsigned n, ColumnBuf &out)
+{
+  for (unsigned i = 0; i < n; ++i) {
+    out.put_varint(slots[i].extent);
+    out.put_bytes(slots[i].ptr, slots[i].extent);
+  }
+}
+
+} // namespace
+
+/*-------------------------------------------------------------------------
+  LogColumnarWriter::encode
+  -------------------------------------------------------------------------*/
+
+char *
+LogColumnarWriter::encode(LogBufferHeader *buffer_header, int *len)
+{
+  ink_assert(buffer_header != NULL);
+  ink_assert(len != NULL);
+
+  if (buffer_header->version != LOG_SEGMENT_VERSION || buffer_header->entry_count == 0 ||
+      buffer_header->data_offset < sizeof(LogBufferHeader) || buffer_header->data_offset > buffer_header->byte_count) {
+    return NULL;
+  }
+
+  bool text = (buffer_header->format_type == LOG_FORMAT_TEXT);
+  LogFieldList fieldlist;
+  int nfields = 1;
+
+  if (!text) {
+    char *fieldlist_str = buffer_header->fmt_fieldlist();
+    bool contains_aggregates = false;
+
+    if (!fieldlist_str || LogFormat::parse_symbol_string(fieldlist_str, &fieldlist, &contains_aggregates) <= 0) {
+      return NULL;
+    }
+    nfields = fieldlist.count();
+  }
+
+  unsigned n = buffer_header->entry_count;
+  int ncols = LOG_COLUMNAR_ENTRY_COLUMNS + nfields;
+  Slot *slots = (Slot *)ats_malloc((size_t)ncols * n * sizeof(Slot));
+  LogColumnarColumn *dir = (LogColumnarColumn *)ats_malloc(ncols * sizeof(LogColumnarColumn));
+  ColumnBuf *raw = new ColumnBuf[ncols];
+  char **stored = (char **)ats_malloc(ncols * sizeof(char *));
+  char *block = NULL;
+  char scratch[LOG_MAX_FORMATTED_LINE];
+
+  memset(dir, 0, ncols * sizeof(LogColumnarColumn));
+  memset(stored, 0, ncols * sizeof(char *));
+
+  // Initial column types; a column is demoted to a blob if any entry does
+  // not have the layout its type implies.
+  dir[0].type = dir[1].type = LogField::sINT;
+  dir[0].encoding = dir[1].encoding = LOG_COLUMN_INT_DELTA;
+  if (text) {
+    dir[LOG_COLUMNAR_ENTRY_COLUMNS].type = LogField::STRING;
+    dir[LOG_COLUMNAR_ENTRY_COLUMNS].encoding = LOG_COLUMN_STR_PLAIN;
+  } else {
+    int col = LOG_COLUMNAR_ENTRY_COLUMNS;
+    for (LogField *f = fieldlist.first(); f; f = fieldlist.next(f), ++col) {
+      dir[col].type = f->type();
+      switch (f->type()) {
+      case LogField::sINT:
+        dir[col].encoding = LOG_COLUMN_INT_DELTA;
+        break;
+      case LogField::STRING:
+        dir[col].encoding = LOG_COLUMN_STR_PLAIN;
+        break;
+      case LogField::IP:
+        dir[col].encoding = LOG_COLUMN_IP;
+        break;
+      default:
+        dir[col].encoding = LOG_COLUMN_BLOB;
+        break;
+      }
+    }
+  }
+
+  //
+  // Split the entries into their fields.  The extent of each field is
+  // determined by its own unmarshal function, just like LogBuffer::to_ascii
+  // walks the entries, so fields with an unusual layout stay intact.
+  //
+  LogBufferIterator iter(buffer_header);
+  LogEntryHeader *entry;
+  unsigned row = 0;
+  size_t total_len = 0, segment_len = 0;
+
+  while ((entry = iter.next())) {
+    if (row >= n) {
+      goto fail;
+    }
+
+    char *read_from = (char *)entry + sizeof(LogEntryHeader);
+    char *entry_end = (char *)entry + entry->entry_len;
+
+    slots[row].val = entry->timestamp;
+    slots[n + row].val = entry->timestamp_usec;
+
+    LogField *f = text ? NULL : fieldlist.first();
+    for (int col = LOG_COLUMNAR_ENTRY_COLUMNS; col < ncols; ++col) {
+      Slot &slot = slots[(size_t)col * n + row];
+      char *start = read_from;
+
+      if (text) {
+        read_from = entry_end;
+      } else {
+        f->unmarshal(&read_from, scratch, sizeof(scratch));
+        f = fieldlist.next(f);
+      }
+      if (read_from > entry_end || read_from < start) {
+        goto fail;
+      }
+
+      int extent = read_from - start;
+      slot.ptr = start;
+      slot.val = 0;
+      slot.extent = extent;
+
+      switch (dir[col].encoding) {
+      case LOG_COLUMN_INT_DELTA:
+        if (extent == INK_MIN_ALIGN) {
+          slot.val = *((int64_t *)start);
+        } else {
+          dir[col].encoding = LOG_COLUMN_BLOB;
+        }
+        break;
+      case LOG_COLUMN_STR_PLAIN: {
+        const char *nul = (const char *)memchr(start, 0, extent);
+        if (nul && LogAccess::round_strlen(nul - start + 1) == extent) {
+          slot.val = nul - start;
+        } else {
+          dir[col].encoding = LOG_COLUMN_BLOB;
+        }
+      } break;
+      case LOG_COLUMN_IP:
+        if (extent < (int)sizeof(LogFieldIp) || INK_ALIGN_DEFAULT(ip_field_len((LogFieldIp *)start)) != extent) {
+          dir[col].encoding = LOG_COLUMN_BLOB;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    if (read_from != entry_end) {
+      goto fail;
+    }
+    ++row;
+  }
+
+  if (row != n) {
+    goto fail;
+  }
+
+  //
+  // Encode and compress each column.
+  //
+  for (int col = 0; col < ncols; ++col) {
+    Slot *col_slots = &slots[(size_t)col * n];
+
+    switch (dir[col].encoding) {
+    case LOG_COLUMN_INT_DELTA:
+      encode_int_column(col_slots, n, raw[col]);
+      break;
+    case LOG_COLUMN_STR_PLAIN:
+      dir[col].encoding = encode_string_column(col_slots, n, raw[col]);
+      break;
+    case LOG_COLUMN_IP:
+      encode_ip_column(col_slots, n, raw[col]);
+      break;
+    default:
+      encode_blob_column(col_slots, n, raw[col]);
+      break;
+    }
+  }
+
+  for (int col = 0; col < ncols; ++col) {
+    dir[col].raw_len = raw[col].len;
+    dir[col].stored_len = raw[col].len;
+    dir[col].compressed = 0;
+
+    if (raw[col].len >= LOG_COLUMNAR_MIN_COMPRESS) {
+      // fastlz needs 5% slack and at least 66 bytes of output space.
+      stored[col] = (char *)ats_malloc(raw[col].len + raw[col].len / 16 + 66);
+      int clen = fastlz_compress(raw[col].data, (int)raw[col].len, stored[col]);
+      if (clen > 0 && (size_t)clen < raw[col].len) {
+        dir[col].stored_len = clen;
+        dir[col].compressed = 1;
+      }
+    }
+    total_len += dir[col].stored_len;
+  }
+
+  //
+  // Lay down the block: header, segment header copy, directory, columns.
+  //
+  segment_len = buffer_header->data_offset;
+  {
+    size_t segment_offset = INK_ALIGN_DEFAULT(sizeof(LogColumnarHeader));
+    size_t column_offset = INK_ALIGN_DEFAULT(segment_offset + segment_len);
+    size_t data_offset = column_offset + ncols * sizeof(LogColumnarColumn);
+    size_t block_len = INK_ALIGN_DEFAULT(data_offset + total_len);
+
+    if (block_len >= buffer_header->byte_count) {
+      goto fail;
+    }
+
+    block = (char *)ats_malloc(block_len);
+    memset(block, 0, block_len);
+
+    LogColumnarHeader *header = (LogColumnarHeader *)block;
+    header->cookie = LOG_COLUMNAR_COOKIE;
+    header->version = LOG_COLUMNAR_VERSION;
+    header->format_type = buffer_header->format_type;
+    header->byte_count = block_len;
+    header->entry_count = n;
+    header->low_timestamp = buffer_header->low_timestamp;
+    header->high_timestamp = buffer_header->high_timestamp;
+    header->column_count = ncols;
+    header->segment_offset = segment_offset;
+    header->segment_len = segment_len;
+    header->column_offset = column_offset;
+
+    memcpy(block + segment_offset, buffer_header, segment_len);
+
+    size_t offset = data_offset;
+    for (int col = 0; col < ncols; ++col) {
+      dir[col].offset = offset;
+      memcpy(block + offset, dir[col].compressed ? stored[col] : raw[col].data, dir[col].stored_len);
+      offset += dir[col].stored_len;
+    }
+    memcpy(block + column_offset, dir, ncols * sizeof(LogColumnarColumn));
+
+    *len = (int)block_len;
+  }
+
+fail:
+  for (int col = 0; col < ncols; ++col) {
+    ats_free(stored[col]);
+  }
+  ats_free(stored);
+  delete[] raw;
+  ats_free(dir);
+  ats_free(slots);
+  return block;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnarReader
+  -------------------------------------------------------------------------*/
+
+struct LogColumnarReader::Column {
+  bool selected;
+  bool decoded;
+  bool failed;
+  int64_t *ints;
+  char **strs;
+  char *storage;
+  LogFieldIpStorage *ips;
+  uint32_t *blob_lens;
+};
+
+LogColumnarReader::LogColumnarReader(LogColumnarHeader *header)
+  : m_header(header), m_segment(NULL), m_dir(NULL), m_columns(NULL), m_fieldlist(NULL), m_valid(false)
+{
+  ink_assert(header != NULL);
+
+  if (header->cookie != LOG_COLUMNAR_COOKIE || header->version != LOG_COLUMNAR_VERSION ||
+      header->column_count <= LOG_COLUMNAR_ENTRY_COLUMNS) {
+    return;
+  }
+
+  uint64_t byte_count = header->byte_count;
+  if ((uint64_t)header->segment_offset + header->segment_len > byte_count ||
+      (uint64_t)header->column_offset + (uint64_t)header->column_count * sizeof(LogColumnarColumn) > byte_count ||
+      header->segment_len < sizeof(LogBufferHeader)) {
+    return;
+  }
+
+  m_segment = (LogBufferHeader *)((char *)header + header->segment_offset);
+  m_dir = (LogColumnarColumn *)((char *)header + header->column_offset);
+  for (unsigned col = 0; col < header->column_count; ++col) {
+    if ((uint64_t)m_dir[col].offset + m_dir[col].stored_len > byte_count) {
+      return;
+    }
+  }
+
+  // A copy of the field list with the symbols split in place.
+  if (header->format_type != LOG_FORMAT_TEXT) {
+    char *fieldlist = m_segment->fmt_fieldlist();
+    if (!fieldlist || m_segment->fmt_fieldlist_offset >= header->segment_len ||
+        !memchr(fieldlist, 0, header->segment_len - m_segment->fmt_fieldlist_offset)) {
+      return;
+    }
+    m_fieldlist = ats_strdup(fieldlist);
+  }
+
+  m_columns = (Column *)ats_malloc(header->column_count * sizeof(Column));
+  memset(m_columns, 0, header->column_count * sizeof(Column));
+  for (unsigned col = 0; col < header->column_count; ++col) {
+    m_columns[col].selected = true;
+  }
+
+  m_valid = true;
+}
+
+LogColumnarReader::~LogColumnarReader()
+{
+  if (m_columns) {
+    for (unsigned col = 0; col < m_header->column_count; ++col) {
+      ats_free(m_columns[col].ints);
+      ats_free(m_columns[col].strs);
+      ats_free(m_columns[col].storage);
+      ats_free(m_columns[col].ips);
+      ats_free(m_columns[col].blob_lens);
+    }
+    ats_free(m_columns);
+  }
+  ats_free(m_fieldlist);
+}
+
+int
+LogColumnarReader::field_count() const
+{
+  return m_valid ? (int)m_header->column_count - LOG_COLUMNAR_ENTRY_COLUMNS : 0;
+}
+
+int
+LogColumnarReader::field_index(const char *symbol) const
+{
+  if (!m_valid || !m_fieldlist || !symbol) {
+    return -1;
+  }
+
+  int symbol_len = strlen(symbol);
+  const char *p = m_fieldlist;
+  for (int idx = 0; idx < field_count(); ++idx) {
+    const char *comma = strchr(p, ',');
+    int len = comma ? comma - p : strlen(p);
+
+    if (len == symbol_len && strncmp(p, symbol, len) == 0) {
+      return idx;
+    }
+    if (!comma) {
+      break;
+    }
+    p = comma + 1;
+  }
+  return -1;
+}
+
+LogField::Type
+LogColumnarReader::field_type(int idx) const
+{
+  ink_assert(idx >= 0 && idx < field_count());
+  return (LogField::Type)m_dir[idx + LOG_COLUMNAR_ENTRY_COLUMNS].type;
+}
+
+void
+LogColumnarReader::select(const char *symbols)
+{
+  if (!m_valid) {
+    return;
+  }
+
+  for (int idx = 0; idx < field_count(); ++idx) {
+    m_columns[idx + LOG_COLUMNAR_ENTRY_COLUMNS].selected = false;
+  }
+
+  char *list = ats_strdup(symbols);
+  char *saveptr = NULL;
+  for (char *sym = strtok_r(list, ",", &saveptr); sym; sym = strtok_r(NULL, ",", &saveptr)) {
+    int idx = field_index(sym);
+    if (idx >= 0) {
+      m_columns[idx + LOG_COLUMNAR_ENTRY_COLUMNS].selected = true;
+    }
+  }
+  ats_free(list);
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnarReader::column_data
+
+  Return the encoded bytes of a column, decompressing into *scratch (which
+  the caller must free) when it was stored compressed.
+  -------------------------------------------------------------------------*/
+
+const char *
+LogColumnarReader::column_data(int col, char **scratch)
+{
+  LogColumnarColumn &c = m_dir[col];
+  const char *data = (const char *)m_header + c.offset;
+
+  *scratch = NULL;
+  if (!c.compressed) {
+    return c.stored_len == c.raw_len ? data : NULL;
+  }
+
+  *scratch = (char *)ats_malloc(c.raw_len + 1);
+  if ((uint32_t)fastlz_decompress(data, c.stored_len, *scratch, c.raw_len) != c.raw_len) {
+    return NULL;
+  }
+  return *scratch;
+}
+
+bool
+LogColumnarReader::decode(int col)
+{
+  Column &column = m_columns[col];
+
+  if (column.decoded || column.failed) {
+    return column.decoded;
+  }
+  column.failed = true;
+
+  unsigned n = m_header->entry_count;
+  char *scratch = NULL;
+  const char *p = column_data(col, &scratch);
+  const char *end = p + m_dir[col].raw_len;
+  uint64_t v;
+
+  if (!p) {
+    ats_free(scratch);
+    return false;
+  }
+
+  switch (m_dir[col].encoding) {
+  case LOG_COLUMN_INT_DELTA: {
+    int64_t prev = 0;
+    column.ints = (int64_t *)ats_malloc(n * sizeof(int64_t));
+    for (unsigned i = 0; i < n; ++i) {
+      if (!get_varint(&p, end, &v)) {
+        goto done;
+      }
+      prev = (int64_t)((uint64_t)prev + (uint64_t)unzigzag(v));
+      column.ints[i] = prev;
+    }
+  } break;
+
+  case LOG_COLUMN_STR_PLAIN:
+  case LOG_COLUMN_BLOB: {
+    // Copy every value into NUL terminated storage; the encoded column
+    // size bounds the storage needed.  The storage is padded, so that the
+    // first word of any value can be read, as in a row segment.
+    char *dst = column.storage = (char *)ats_malloc(m_dir[col].raw_len + n + sizeof(int));
+    column.strs = (char **)ats_malloc(n * sizeof(char *));
+    if (m_dir[col].encoding == LOG_COLUMN_BLOB) {
+      column.blob_lens = (uint32_t *)ats_malloc(n * sizeof(uint32_t));
+    }
+    for (unsigned i = 0; i < n; ++i) {
+      if (!get_varint(&p, end, &v) || v > (uint64_t)(end - p)) {
+        goto done;
+      }
+      memcpy(dst, p, v);
+      dst[v] = 0;
+      column.strs[i] = dst;
+      if (column.blob_lens) {
+        column.blob_lens[i] = (uint32_t)v;
+      }
+      dst += v + 1;
+      p += v;
+    }
+  } break;
+
+  case LOG_COLUMN_STR_DICT: {
+    uint64_t count;
+    if (!get_varint(&p, end, &count) || count > n) {
+      goto done;
+    }
+    char **dict = (char **)ats_malloc((count ? count : 1) * sizeof(char *));
+    char *dst = column.storage = (char *)ats_malloc(m_dir[col].raw_len + count + sizeof(int));
+    for (uint64_t i = 0; i < count; ++i) {
+      if (!get_varint(&p, end, &v) || v > (uint64_t)(end - p)) {
+        ats_free(dict);
+        goto done;
+      }
+      memcpy(dst, p, v);
+      dst[v] = 0;
+      dict[i] = dst;
+      dst += v + 1;
+      p += v;
+    }
+    column.strs = (char **)ats_malloc(n * sizeof(char *));
+    for (unsigned i = 0; i < n; ++i) {
+      if (!get_varint(&p, end, &v) || v >= count) {
+        ats_free(dict);
+        goto done;
+      }
+      column.strs[i] = dict[v];
+    }
+    ats_free(dict);
+  } break;
+
+  case LOG_COLUMN_IP:
+    column.ips = (LogFieldIpStorage *)ats_malloc(n * sizeof(LogFieldIpStorage));
+    memset(column.ips, 0, n * sizeof(LogFieldIpStorage));
+    for (unsigned i = 0; i < n; ++i) {
+      if (!get_varint(&p, end, &v)) {
+        goto done;
+      }
+      column.ips[i]._ip._family = (uint16_t)v;
+      if (AF_INET == v) {
+        if (end - p < (int)sizeof(in_addr_t)) {
+          goto done;
+        }
+        memcpy(&column.ips[i]._ip4._addr, p, sizeof(in_addr_t));
+        p += sizeof(in_addr_t);
+      } else if (AF_INET6 == v) {
+        if (end - p < (int)sizeof(in6_addr)) {
+          goto done;
+        }
+        memcpy(&column.ips[i]._ip6._addr, p, sizeof(in6_addr));
+        p += sizeof(in6_addr);
+      }
+    }
+    break;
+
+  default:
+    goto done;
+  }
+
+  column.decoded = true;
+  column.failed = false;
+
+done:
+  ats_free(scratch);
+  return column.decoded;
+}
+
+const int64_t *
+LogColumnarReader::int_field(int idx)
+{
+  int col = idx + LOG_COLUMNAR_ENTRY_COLUMNS;
+
+  if (idx < 0 || idx >= field_count() || m_dir[col].encoding != LOG_COLUMN_INT_DELTA || !decode(col)) {
+    return NULL;
+  }
+  return m_columns[col].ints;
+}
+
+const char *const *
+LogColumnarReader::string_field(int idx)
+{
+  int col = idx + LOG_COLUMNAR_ENTRY_COLUMNS;
+
+  if (idx < 0 || idx >= field_count() ||
+      (m_dir[col].encoding != LOG_COLUMN_STR_PLAIN && m_dir[col].encoding != LOG_COLUMN_STR_DICT) || !decode(col)) {
+    return NULL;
+  }
+  return m_columns[col].strs;
+}
+
+const LogFieldIpStorage *
+LogColumnarReader::ip_field(int idx)
+{
+  int col = idx + LOG_COLUMNAR_ENTRY_COLUMNS;
+
+  if (idx < 0 || idx >= field_count() || m_dir[col].encoding != LOG_COLUMN_IP || !decode(col)) {
+    return NULL;
+  }
+  return m_columns[col].ips;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnarReader::to_log_buffer
+  -------------------------------------------------------------------------*/
+
+LogBufferHeader *
+LogColumnarReader::to_log_buffer()
+{
+  if (!m_valid) {
+    return NULL;
+  }
+
+  unsigned n = m_header->entry_count;
+  int ncols = m_header->column_count;
+
+  // The entry header columns are always needed, and blobs cannot be
+  // replaced by a placeholder since their layout is unknown.
+  for (int col = 0; col < ncols; ++col) {
+    if (col < LOG_COLUMNAR_ENTRY_COLUMNS || m_dir[col].encoding == LOG_COLUMN_BLOB) {
+      m_columns[col].selected = true;
+    }
+    if (m_columns[col].selected && !decode(col)) {
+      return NULL;
+    }
+  }
+
+  // Size the segment
+  size_t total = m_header->segment_len;
+  for (unsigned i = 0; i < n; ++i) {
+    total += sizeof(LogEntryHeader);
+    for (int col = LOG_COLUMNAR_ENTRY_COLUMNS; col < ncols; ++col) {
+      Column &column = m_columns[col];
+      switch (m_dir[col].encoding) {
+      case LOG_COLUMN_INT_DELTA:
+        total += INK_MIN_ALIGN;
+        break;
+      case LOG_COLUMN_STR_PLAIN:
+      case LOG_COLUMN_STR_DICT:
+        total += column.selected ? LogAccess::strlen(column.strs[i]) : LogAccess::strlen(NULL);
+        break;
+      case LOG_COLUMN_IP:
+        total += INK_ALIGN_DEFAULT(column.selected ? ip_field_len(&column.ips[i]._ip) : sizeof(LogFieldIp));
+        break;
+      default:
+        total += column.blob_lens[i];
+        break;
+      }
+    }
+  }
+
+  if (total > UINT32_MAX) {
+    return NULL;
+  }
+
+  char *buf = (char *)ats_malloc(total);
+  LogBufferHeader *header = (LogBufferHeader *)buf;
+
+  memcpy(buf, m_segment, m_header->segment_len);
+  header->byte_count = total;
+  header->entry_count = n;
+  header->data_offset = m_header->segment_len;
+
+  char *write_to = buf + m_header->segment_len;
+  for (unsigned i = 0; i < n; ++i) {
+    LogEntryHeader *entry = (LogEntryHeader *)write_to;
+    entry->timestamp = m_columns[0].ints[i];
+    entry->timestamp_usec = (int32_t)m_columns[1].ints[i];
+    write_to += sizeof(LogEntryHeader);
+
+    for (int col = LOG_COLUMNAR_ENTRY_COLUMNS; col < ncols; ++col) {
+      Column &column = m_columns[col];
+      switch (m_dir[col].encoding) {
+      case LOG_COLUMN_INT_DELTA:
+        LogAccess::marshal_int(write_to, column.selected ? column.ints[i] : 0);
+        write_to += INK_MIN_ALIGN;
+        break;
+      case LOG_COLUMN_STR_PLAIN:
+      case LOG_COLUMN_STR_DICT: {
+        const char *str = column.selected ? column.strs[i] : NULL;
+        int padded_len = LogAccess::strlen(str);
+        memset(write_to, 0, padded_len);
+        LogAccess::marshal_str(write_to, str, padded_len);
+        write_to += padded_len;
+      } break;
+      case LOG_COLUMN_IP: {
+        int ip_len = column.selected ? ip_field_len(&column.ips[i]._ip) : sizeof(LogFieldIp);
+        int padded_len = INK_ALIGN_DEFAULT(ip_len);
+        memset(write_to, 0, padded_len);
+        if (column.selected) {
+          memcpy(write_to, &column.ips[i], ip_len);
+        } else {
+          reinterpret_cast<LogFieldIp *>(write_to)->_family = AF_UNSPEC;
+        }
+        write_to += padded_len;
+      } break;
+      default:
+        memcpy(write_to, column.strs[i], column.blob_lens[i]);
+        write_to += column.blob_lens[i];
+        break;
+      }
+    }
+    entry->entry_len = write_to - (char *)entry;
+  }
+
+  ink_assert((size_t)(write_to - buf) == total);
+  return header;
+}
+
+#if TS_HAS_TESTS
+
+static size_t
+test_header_str(const char *str, char *buf)
+{
+  size_t len = strlen(str) + 1;
+  memcpy(buf, str, len);
+  return len;
+}
+
+REGRESSION_TEST(LogColumnar_RoundTrip)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  box = REGRESSION_TEST_PASSED;
+
+  static const char *methods[] = {"GET", "POST", "HEAD"};
+  static const char *types[] = {"text/html", "image/png", "application/javascript", ""};
+  const char *fieldlist = "cqtq,chi,crc,cqhm,psct,cqhv";
+  const unsigned n = 200;
+
+  // Lay down a segment the way LogBuffer does.
+  size_t size = 64 * 1024;
+  char *buf = (char *)ats_malloc(size);
+  memset(buf, 0, size);
+
+  LogBufferHeader *segment = (LogBufferHeader *)buf;
+  segment->cookie = LOG_SEGMENT_COOKIE;
+  segment->version = LOG_SEGMENT_VERSION;
+  segment->format_type = LOG_FORMAT_CUSTOM;
+  segment->low_timestamp = 1000;
+  segment->high_timestamp = 1000 + n;
+
+  size_t offset = sizeof(LogBufferHeader);
+  segment->fmt_fieldlist_offset = offset;
+  offset += test_header_str(fieldlist, buf + offset);
+  segment->fmt_printf_offset = offset;
+  offset += test_header_str("\377 \377 \377 \377 \377 \377", buf + offset);
+  offset = INK_ALIGN_DEFAULT(offset);
+  segment->data_offset = offset;
+
+  for (unsigned i = 0; i < n; ++i) {
+    LogEntryHeader *entry = (LogEntryHeader *)(buf + offset);
+    char *p = (char *)entry + sizeof(LogEntryHeader);
+    LogFieldIpStorage ip;
+
+    entry->timestamp = 1000 + i;
+    entry->timestamp_usec = i * 997;
+
+    LogAccess::marshal_int(p, 1000 + i);
+    p += INK_MIN_ALIGN;
+    // LogAccess::marshal_ip() copies the struct padding uninitialized,
+    // which would not survive the round trip, so lay down a clean record.
+    memset(&ip, 0, sizeof(ip));
+    ip._ip4._family = AF_INET;
+    ip._ip4._addr = htonl(0x0a000001 + (i % 4));
+    memcpy(p, &ip._ip4, sizeof(ip._ip4));
+    p += INK_ALIGN_DEFAULT(sizeof(ip._ip4));
+    LogAccess::marshal_int(p, i % 7);
+    p += INK_MIN_ALIGN;
+    LogAccess::marshal_str(p, methods[i % 3], LogAccess::strlen(methods[i % 3]));
+    p += LogAccess::strlen(methods[i % 3]);
+    LogAccess::marshal_str(p, types[i % 4], LogAccess::strlen(types[i % 4]));
+    p += LogAccess::strlen(types[i % 4]);
+    LogAccess::marshal_int(p, 1);
+    LogAccess::marshal_int(p + INK_MIN_ALIGN, 1);
+    p += 2 * INK_MIN_ALIGN;
+
+    entry->entry_len = p - (char *)entry;
+    offset += entry->entry_len;
+  }
+  segment->byte_count = offset;
+  segment->entry_count = n;
+
+  int len = 0;
+  char *block = LogColumnarWriter::encode(segment, &len);
+  if (box.check(block != NULL, "failed to encode segment")) {
+    box.check((unsigned)len < segment->byte_count, "columnar block (%d) not smaller than the segment (%u)", len,
+              segment->byte_count);
+
+    LogColumnarReader reader((LogColumnarHeader *)block);
+    box.check(reader.valid(), "reader rejected the block");
+    box.check(reader.entry_count() == n, "wrong entry count %u", reader.entry_count());
+    box.check(reader.field_index("crc") == 2, "wrong index %d for crc", reader.field_index("crc"));
+
+    const int64_t *crc = reader.int_field(2);
+    const char *const *cqhm = reader.string_field(3);
+    if (box.check(crc && cqhm, "failed to decode columns")) {
+      for (unsigned i = 0; i < n; ++i) {
+        box.check(crc[i] == i % 7, "crc[%u] is %" PRId64, i, crc[i]);
+        box.check(strcmp(cqhm[i], methods[i % 3]) == 0, "cqhm[%u] is %s", i, cqhm[i]);
+      }
+    }
+
+    LogBufferHeader *rows = reader.to_log_buffer();
+    if (box.check(rows != NULL, "failed to rebuild the segment")) {
+      box.check(rows->byte_count == segment->byte_count && memcmp(rows, segment, segment->byte_count) == 0,
+                "rebuilt segment differs from the original");
+      ats_free(rows);
+    }
+    ats_free(block);
+  }
+
+  ats_free(buf);
+}
+
+#endif
@@ -0,0 +1,165 @@
+/** @file
+
+  Columnar, block compressed representation of LogBuffer segments.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+
+#ifndef LOG_COLUMNAR_H
+#define LOG_COLUMNAR_H
+
+#include "ts/ink_platform.h"
+#include "LogField.h"
+
+struct LogBufferHeader;
+
+#define LOG_COLUMNAR_COOKIE 0xc01face
+#define LOG_COLUMNAR_VERSION 1
+
+/*-------------------------------------------------------------------------
+  LogColumnarHeader
+
+  This struct is laid down at the head of each columnar block.  The first
+  four words mirror LogBufferHeader (cookie, version, format_type and
+  byte_count), so readers can tell the two segment types apart after the
+  same initial read and can mix both kinds of segments in a single file.
+
+  A block holds a verbatim copy of the original LogBufferHeader (with its
+  format strings), a directory of LogColumnarColumn descriptors and the
+  column data.  Columns 0 and 1 carry the LogEntryHeader timestamps; the
+  remaining columns follow the order of the format's field list.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnarHeader {
+  uint32_t cookie;         // LOG_COLUMNAR_COOKIE
+  uint32_t version;        // LOG_COLUMNAR_VERSION
+  uint32_t format_type;    // copied from the LogBufferHeader
+  uint32_t byte_count;     // total bytes of the block, this header included
+  uint32_t entry_count;    // number of log entries in the block
+  uint32_t low_timestamp;  // lowest timestamp value of entries
+  uint32_t high_timestamp; // highest timestamp value of entries
+  uint32_t column_count;   // number of LogColumnarColumn descriptors
+  uint32_t segment_offset; // offset to the copy of the LogBufferHeader
+  uint32_t segment_len;    // length of the LogBufferHeader copy (its data_offset)
+  uint32_t column_offset;  // offset to the column directory
+  uint32_t reserved;
+};
+
+enum LogColumnEncoding {
+  LOG_COLUMN_INT_DELTA = 0, // zigzag varint of the delta to the previous row
+  LOG_COLUMN_STR_PLAIN,     // varint length + bytes per row
+  LOG_COLUMN_STR_DICT,      // per-block dictionary followed by varint indexes
+  LOG_COLUMN_IP,            // family + address bytes per row
+};
+
+struct LogColumnarColumn {
+  uint8_t type;        // LogField::Type
+  uint8_t encoding;    // LogColumnEncoding
+  uint8_t compressed;  // stored with fastlz
+  uint8_t reserved;
+  uint32_t raw_len;    // length of the encoded column
+  uint32_t stored_len; // length on disk (differs from raw_len when compressed)
+  uint32_t offset;     // offset of the column data from the start of the block
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarWriter
+  -------------------------------------------------------------------------*/
+
+class LogColumnarWriter
+{
+public:
+  // Convert a row oriented LogBuffer segment into a columnar block.  The
+  // block is ats_malloc'ed and its size is returned in len.  Returns NULL
+  // if the segment cannot be represented, or if the columnar block would
+  // not be smaller than the segment; callers should then write the
+  // original segment, which all readers accept as well.
+  static char *encode(LogBufferHeader *buffer_header, int *len);
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarReader
+
+  Decodes a columnar block lazily: only the columns that are selected (or
+  explicitly requested) are decompressed and decoded.
+  -------------------------------------------------------------------------*/
+
+class LogColumnarReader
+{
+public:
+  LogColumnarReader(LogColumnarHeader *header);
+  ~LogColumnarReader();
+
+  bool
+  valid() const
+  {
+    return m_valid;
+  }
+
+  unsigned
+  entry_count() const
+  {
+    return m_header->entry_count;
+  }
+
+  // The original segment header; its format strings are usable as is.
+  LogBufferHeader *
+  segment_header() const
+  {
+    return m_segment;
+  }
+
+  int field_count() const;
+  int field_index(const char *symbol) const;
+  LogField::Type field_type(int idx) const;
+
+  // Restrict decoding to the given comma separated list of field symbols.
+  // By default all fields are selected.
+  void select(const char *symbols);
+
+  // Column accessors; these return NULL if the field could not be decoded.
+  const int64_t *int_field(int idx);
+  const char *const *string_field(int idx);
+  const LogFieldIpStorage *ip_field(int idx);
+
+  // Rebuild a row oriented segment (ats_malloc'ed), suitable for the
+  // regular LogBufferIterator based consumers.  Fields which are not
+  // selected are filled in with empty values.
+  LogBufferHeader *to_log_buffer();
+
+private:
+  struct Column;
+
+  bool decode(int col);
+  const char *column_data(int col, char **scratch);
+
+  LogColumnarHeader *m_header;
+  LogBufferHeader *m_segment;
+  LogColumnarColumn *m_dir;
+  Column *m_columns;
+  char *m_fieldlist;
+  bool m_valid;
+
+  // -- member functions not allowed --
+  LogColumnarReader(const LogColumnarReader &);
+  LogColumnarReader &operator=(const LogColumnarReader &);
+};
+
+#endif
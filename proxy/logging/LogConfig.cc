@@ -1239,6 +1239,8 @@ LogConfig::read_xml_log_config()
       NameList rollingIntervalSec;
       NameList rollingOffsetHr;
       NameList rollingSizeMb;
+      NameList dimensions;
+      NameList interval;
 
       for (xattr = xobj->first(); xattr; xattr = xobj->next(xattr)) {
         Debug("xml", "XmlAttr  : <%s,%s>", xattr->tag(), xattr->value());
@@ -1266,6 +1268,10 @@ LogConfig::read_xml_log_config()
           rollingOffsetHr.enqueue(xattr->value());
         } else if (strcasecmp(xattr->tag(), "RollingSizeMb") == 0) {
           rollingSizeMb.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "Dimensions") == 0) {
+          dimensions.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "Interval") == 0) {
+          interval.enqueue(xattr->value());
         } else {
           Note("Unknown attribute %s for %s; ignoring", xattr->tag(), xobj->object_name());
         }
@@ -1318,6 +1324,12 @@ LogConfig::read_xml_log_config()
       if (rollingSizeMb.count() > 1) {
         Note("Multiple values for 'RollingSizeMb' attribute in %s; using the first one", xobj->object_name());
       }
+      if (dimensions.count() > 1) {
+        Note("Multiple values for 'Dimensions' attribute in %s; using the first one", xobj->object_name());
+      }
+      if (interval.count() > 1) {
+        Note("Multiple values for 'Interval' attribute in %s; using the first one", xobj->object_name());
+      }
       // create new LogObject and start adding to it
       //
 
@@ -1330,11 +1342,22 @@ LogConfig::read_xml_log_config()
       // file format
       //
       LogFileFormat file_type = LOG_FILE_ASCII; // default value
+      bool histogram = false;
       if (mode.count()) {
         char *mode_str = mode.dequeue();
-        file_type = (strncasecmp(mode_str, "bin", 3) == 0 || (mode_str[0] == 'b' && mode_str[1] == 0) ?
-                       LOG_FILE_BINARY :
-                       (strcasecmp(mode_str, "ascii_pipe") == 0 ? LOG_FILE_PIPE : LOG_FILE_ASCII));
+        if (strncasecmp(mode_str, "bin", 3) == 0 || (mode_str[0] == 'b' && mode_str[1] == 0)) {
+          file_type = LOG_FILE_BINARY;
+        } else if (strcasecmp(mode_str, "columnar") == 0) {
+          file_type = LOG_FILE_COLUMNAR;
+        } else if (strcasecmp(mode_str, "ascii_pipe") == 0) {
+          file_type = LOG_FILE_PIPE;
+        } else if (strcasecmp(mode_str, "histogram") == 0) {
+          histogram = true;
+        }
+      }
+      if (histogram && fmt->is_aggregate()) {
+        Warning("Format %s uses aggregate operators and cannot be used for histogram object %s", fmt_name, xobj->object_name());
+        continue;
       }
       // rolling
       //
@@ -1356,10 +1379,27 @@ LogConfig::read_xml_log_config()
 
       // create the new object
       //
-      LogObject *obj = new LogObject(fmt, logfile_dir, filename.dequeue(), file_type, header.dequeue(),
+      char *filename_str = filename.dequeue();
+      LogObject *obj = new LogObject(fmt, logfile_dir, filename_str, file_type, header.dequeue(),
                                      (Log::RollingEnabledValues)obj_rolling_enabled, collation_preproc_threads,
                                      obj_rolling_interval_sec, obj_rolling_offset_hr, obj_rolling_size_mb);
 
+      // histogram objects aggregate entries into stats named after the object
+      //
+      if (histogram) {
+        char *interval_str = interval.dequeue();
+        LogHistogramSink *sink = new LogHistogramSink(filename_str, obj->m_format, dimensions.dequeue(),
+                                                      interval_str ? ink_atoui(interval_str) : LOG_HISTOGRAM_DEFAULT_INTERVAL);
+
+        if (!sink->valid()) {
+          Warning("Format %s has no integer fields to build histograms from; cannot create LogObject %s", fmt_name, filename_str);
+          delete sink;
+          delete obj;
+          continue;
+        }
+        obj->set_histogram_sink(sink);
+      }
+
       // filters
       //
       char *filters_str = filters.dequeue();
@@ -710,6 +710,78 @@ LogFieldList::marshal_agg(char *buf)
   return bytes;
 }
 
+/*-------------------------------------------------------------------------
+  LogMarshalPlan
+  -------------------------------------------------------------------------*/
+
+LogMarshalPlan::LogMarshalPlan() : m_ops(NULL), m_op_count(0), m_var_ops(NULL), m_var_count(0), m_fixed_len(0)
+{
+}
+
+LogMarshalPlan::~LogMarshalPlan()
+{
+  clear();
+}
+
+void
+LogMarshalPlan::clear()
+{
+  ats_free(m_ops);
+  ats_free(m_var_ops);
+  m_ops = NULL;
+  m_var_ops = NULL;
+  m_op_count = m_var_count = m_fixed_len = 0;
+}
+
+void
+LogMarshalPlan::compile(LogFieldList *list)
+{
+  unsigned n = list->count();
+
+  clear();
+  if (n == 0) {
+    return;
+  }
+
+  m_ops = (Op *)ats_malloc(n * sizeof(Op));
+  m_var_ops = (Op *)ats_malloc(n * sizeof(Op));
+
+  for (LogField *f = list->first(); f; f = list->next(f)) {
+    Op &op = m_ops[m_op_count++];
+
+    op.func = f->marshal_func();
+    op.field = f;
+    if (f->type() == LogField::sINT) {
+      m_fixed_len += INK_MIN_ALIGN;
+    } else {
+      m_var_ops[m_var_count++] = op;
+    }
+  }
+}
+
+unsigned
+LogMarshalPlan::marshal_len(LogAccess *lad) const
+{
+  unsigned bytes = m_fixed_len;
+
+  for (const Op *op = m_var_ops, *end = m_var_ops + m_var_count; op < end; ++op) {
+    bytes += op->func ? (lad->*(op->func))(NULL) : op->field->marshal_len(lad);
+  }
+  return bytes;
+}
+
+unsigned
+LogMarshalPlan::marshal(LogAccess *lad, char *buf) const
+{
+  char *ptr = buf;
+
+  for (const Op *op = m_ops, *end = m_ops + m_op_count; op < end; ++op) {
+    ptr += op->func ? (lad->*(op->func))(ptr) : op->field->marshal(lad, ptr);
+    ink_assert((ptr - buf) % INK_MIN_ALIGN == 0);
+  }
+  return ptr - buf;
+}
+
 unsigned
 LogFieldList::count()
 {
@@ -167,6 +167,13 @@ public:
   {
     return m_time_field;
   }
+  // The LogAccess routine which marshals this field, or NULL if the
+  // field lives in a container and has to go through marshal().
+  MarshalFunc
+  marshal_func() const
+  {
+    return m_container == NO_CONTAINER ? m_marshal_func : NULL;
+  }
 
   void set_aggregate_op(Aggregate agg_op);
   void update_aggregate(int64_t val);
@@ -253,6 +260,51 @@ private:
   LogFieldList &operator=(const LogFieldList &rhs);
 };
 
+/*-------------------------------------------------------------------------
+  LogMarshalPlan
+
+  A LogFieldList flattened into an array when its LogFormat is built, so
+  that logging an entry does not have to walk the list.  Container fields
+  are dispatched through LogField::marshal(), all other fields call their
+  LogAccess routine directly.  The fixed size (sINT) fields are summed up
+  into a single constant, so sizing an entry only visits the variable
+  length fields.  The marshalled layout is identical to LogFieldList's.
+  -------------------------------------------------------------------------*/
+
+class LogMarshalPlan
+{
+public:
+  LogMarshalPlan();
+  ~LogMarshalPlan();
+
+  void compile(LogFieldList *list);
+  void clear();
+  unsigned marshal_len(LogAccess *lad) const;
+  unsigned marshal(LogAccess *lad, char *buf) const;
+
+  bool
+  valid() const
+  {
+    return m_ops != NULL;
+  }
+
+private:
+  struct Op {
+    LogField::MarshalFunc func;
+    LogField *field;
+  };
+
+  Op *m_ops;
+  unsigned m_op_count;
+  Op *m_var_ops; // the variable length subset of m_ops
+  unsigned m_var_count;
+  unsigned m_fixed_len;
+
+  // -- member functions that are not allowed --
+  LogMarshalPlan(const LogMarshalPlan &rhs);
+  LogMarshalPlan &operator=(const LogMarshalPlan &rhs);
+};
+
 /** Base IP address data.
     To unpack an IP address, the generic memory is first cast to
     this type to get the family. That pointer can then be static_cast
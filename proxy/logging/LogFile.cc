@@ -47,6 +47,7 @@
 #include "LogFilter.h"
 #include "LogFormat.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogFile.h"
 #include "LogHost.h"
 #include "LogObject.h"
@@ -200,7 +201,7 @@ LogFile::open_file()
   // file.
   //
   if (!file_exists) {
-    if (m_file_format != LOG_FILE_BINARY && m_header && m_log) {
+    if (m_file_format != LOG_FILE_BINARY && m_file_format != LOG_FILE_COLUMNAR && m_header && m_log) {
       Debug("log-file", "writing header to LogFile %s", m_name);
       writeln(m_header, strlen(m_header), fileno(m_log->m_fp), m_name);
     }
@@ -318,6 +319,34 @@ LogFile::preproc_and_try_delete(LogBuffer *lb)
     // LogBuffer will be deleted in flush thread
     //
     return 0;
+  } else if (m_file_format == LOG_FILE_COLUMNAR) {
+    //
+    // Re-encode the buffer as a columnar block.  If that is not possible
+    // (or would not save any space), write the row oriented segment; the
+    // readers accept both kinds of segments in the same file.
+    //
+    int block_len = 0;
+    char *block = LogColumnarWriter::encode(buffer_header, &block_len);
+
+    if (block == NULL) {
+      block_len = buffer_header->byte_count;
+      block = (char *)ats_malloc(block_len);
+      memcpy(block, buffer_header, block_len);
+    }
+
+    LogFlushData *flush_data = new LogFlushData(this, block, block_len);
+
+    ProxyMutex *mutex = this_thread()->mutex;
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_flush_to_disk_stat, buffer_header->entry_count);
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_flush_to_disk_stat, block_len);
+
+    ink_atomiclist_push(Log::flush_data_list, flush_data);
+
+    Log::flush_notify->signal();
+
+    ret = 0;
   } else if (m_file_format == LOG_FILE_ASCII || m_file_format == LOG_FILE_PIPE) {
     write_ascii_logbuffer3(buffer_header);
     ret = 0;
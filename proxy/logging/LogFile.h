@@ -80,7 +80,16 @@ public:
   const char *
   get_format_name() const
   {
-    return (m_file_format == LOG_FILE_BINARY ? "binary" : (m_file_format == LOG_FILE_PIPE ? "ascii_pipe" : "ascii"));
+    switch (m_file_format) {
+    case LOG_FILE_BINARY:
+      return "binary";
+    case LOG_FILE_PIPE:
+      return "ascii_pipe";
+    case LOG_FILE_COLUMNAR:
+      return "columnar";
+    default:
+      return "ascii";
+    }
   }
 
   static int write_ascii_logbuffer(LogBufferHeader *buffer_header, int fd, const char *path, const char *alt_format = NULL);
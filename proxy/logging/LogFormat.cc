@@ -143,6 +143,8 @@ LogFormat::init_variables(const char *name, const char *fieldlist_str, const cha
   } else {
     if (m_aggregate) {
       m_agg_marshal_space = (char *)ats_malloc(m_field_count * INK_MIN_ALIGN);
+    } else {
+      m_marshal_plan.compile(&m_field_list);
     }
 
     if (m_name_str) {
@@ -351,7 +353,7 @@ LogFormat::format_from_specification(char *spec, char **file_name, char **file_h
   *file_name = ats_strdup(token);
 
   //
-  // Next should be the file type, either "ASCII" or "BINARY"
+  // Next should be the file type, either "ASCII", "BINARY" or "COLUMNAR"
   //
   token = tok.getNext();
   if (token == NULL) {
@@ -362,8 +364,10 @@ LogFormat::format_from_specification(char *spec, char **file_name, char **file_h
     *file_type = LOG_FILE_ASCII;
   } else if (!strcasecmp(token, "BINARY")) {
     *file_type = LOG_FILE_BINARY;
+  } else if (!strcasecmp(token, "COLUMNAR")) {
+    *file_type = LOG_FILE_COLUMNAR;
   } else {
-    Debug("log-format", "%s is not a valid file format (ASCII or BINARY)", token);
+    Debug("log-format", "%s is not a valid file format (ASCII, BINARY or COLUMNAR)", token);
     return NULL;
   }
 
@@ -40,7 +40,8 @@ enum LogFormatType {
 enum LogFileFormat {
   LOG_FILE_BINARY,
   LOG_FILE_ASCII,
-  LOG_FILE_PIPE, // ie. ASCII pipe
+  LOG_FILE_PIPE,     // ie. ASCII pipe
+  LOG_FILE_COLUMNAR, // binary, stored as compressed columnar blocks
   N_LOGFILE_TYPES
 };
 
@@ -144,6 +145,7 @@ private:
 
 public:
   LogFieldList m_field_list;
+  LogMarshalPlan m_marshal_plan; // m_field_list, compiled for LogObject::log
   long m_interval_sec;
   long m_interval_next;
   char *m_agg_marshal_space;
@@ -0,0 +1,481 @@
+/** @file
+
+  In-memory latency histograms fed by log entries.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "ts/ink_platform.h"
+#include "ts/HashFNV.h"
+#include "ts/ParseRules.h"
+#include "ts/SimpleTokenizer.h"
+#include "Error.h"
+#include "Log.h"
+#include "LogAccess.h"
+#include "LogField.h"
+#include "LogFormat.h"
+#include "LogUtils.h"
+#include "LogHistogram.h"
+#include "ts/TestBox.h"
+
+#define LOG_HISTOGRAM_KEY_LEN 256
+#define LOG_HISTOGRAM_DIMENSION_LEN 64
+
+// Stat names are dot separated, so anything but [A-Za-z0-9_-] in a name
+// component is replaced.
+static void
+sanitize_component(char *str)
+{
+  for (char *p = str; *p; ++p) {
+    if (!ParseRules::is_alnum(*p) && *p != '-' && *p != '_') {
+      *p = '_';
+    }
+  }
+}
+
+static uint64_t
+hash_key(const char *name)
+{
+  ATSHash64FNV1a hash;
+
+  hash.update(name, strlen(name));
+  hash.final();
+  return hash.get();
+}
+
+// Match a dimension token ("pssc", or "{Host}cqh" for container fields)
+// against the fields of a format.
+static LogField *
+find_field(LogFormat *format, const char *token)
+{
+  for (LogField *f = format->m_field_list.first(); f; f = format->m_field_list.next(f)) {
+    if (f->marshal_func()) {
+      if (strcmp(f->symbol(), token) == 0) {
+        return f;
+      }
+    } else if (token[0] == '{') {
+      size_t name_len = strlen(f->name());
+      if (strncmp(token + 1, f->name(), name_len) == 0 && token[name_len + 1] == '}' &&
+          strcmp(token + name_len + 2, f->symbol()) == 0) {
+        return f;
+      }
+    }
+  }
+  return NULL;
+}
+
+/*-------------------------------------------------------------------------
+  LogHistogramSink::LogHistogramSink
+  -------------------------------------------------------------------------*/
+
+LogHistogramSink::LogHistogramSink(const char *name, LogFormat *format, const char *dimensions, int interval_sec)
+  : m_name(ats_strdup(name)), m_dimension_str(ats_strdup(dimensions)), m_spec(NULL),
+    m_interval_sec(interval_sec > 0 ? interval_sec : LOG_HISTOGRAM_DEFAULT_INTERVAL), m_next_export(0), m_measures(NULL),
+    m_measure_count(0), m_dimensions(NULL), m_dimension_count(0), m_key_count(0), m_other(NULL)
+{
+  unsigned n_fields = format->field_count();
+
+  ink_mutex_init(&m_mutex, "LogHistogramSink");
+  memset((void *)m_table, 0, sizeof(m_table));
+  memset(m_keys, 0, sizeof(m_keys));
+  sanitize_component(m_name);
+
+  m_measures = (LogField **)ats_malloc(n_fields * sizeof(LogField *));
+  m_dimensions = (Dimension *)ats_malloc(n_fields * sizeof(Dimension));
+
+  if (dimensions) {
+    char *dims = ats_strdup(dimensions);
+    SimpleTokenizer tok(dims, ',');
+    char *t;
+
+    while ((t = tok.getNext()) != NULL) {
+      char *modifier = strchr(t, ':');
+      LogField *f;
+
+      if (modifier) {
+        *modifier++ = 0;
+      }
+      if ((f = find_field(format, t)) == NULL) {
+        Warning("histogram dimension '%s' is not a field of format %s; ignoring it", t, format->name());
+        continue;
+      }
+      if (m_dimension_count == (int)n_fields) {
+        break;
+      }
+
+      Dimension &dim = m_dimensions[m_dimension_count++];
+      dim.field = f;
+      dim.status_class = modifier && strcasecmp(modifier, "class") == 0 && f->type() == LogField::sINT;
+      if (modifier && !dim.status_class) {
+        Warning("unsupported modifier ':%s' for histogram dimension %s; ignoring it", modifier, t);
+      }
+    }
+    ats_free(dims);
+  }
+
+  for (LogField *f = format->m_field_list.first(); f; f = format->m_field_list.next(f)) {
+    bool is_dimension = false;
+
+    for (int i = 0; i < m_dimension_count; ++i) {
+      is_dimension = is_dimension || m_dimensions[i].field == f;
+    }
+    if (is_dimension) {
+      continue;
+    }
+    if (f->type() == LogField::sINT) {
+      m_measures[m_measure_count++] = f;
+    } else {
+      Note("histogram %s: field %s is neither an integer nor a dimension; ignoring it", m_name, f->symbol());
+    }
+  }
+
+  m_spec = (char *)ats_malloc(strlen(format->fieldlist()) + (dimensions ? strlen(dimensions) : 0) + 32);
+  sprintf(m_spec, "%s|%s|%d", format->fieldlist(), dimensions ? dimensions : "", m_interval_sec);
+  m_next_export = LogUtils::timestamp() + m_interval_sec;
+
+  Debug("log-histogram", "histogram %s: %d measured fields, %d dimensions", m_name, m_measure_count, m_dimension_count);
+}
+
+LogHistogramSink::~LogHistogramSink()
+{
+  for (int i = 0; i <= LOG_HISTOGRAM_MAX_KEYS; ++i) {
+    if (m_keys[i]) {
+      ats_free(m_keys[i]->name);
+      delete[] m_keys[i]->live;
+      delete[] m_keys[i]->exported;
+      delete m_keys[i];
+    }
+  }
+  ats_free(m_measures);
+  ats_free(m_dimensions);
+  ats_free(m_name);
+  ats_free(m_dimension_str);
+  ats_free(m_spec);
+  ink_mutex_destroy(&m_mutex);
+}
+
+LogHistogramSink *
+LogHistogramSink::clone(LogFormat *format) const
+{
+  return new LogHistogramSink(m_name, format, m_dimension_str, m_interval_sec);
+}
+
+bool
+LogHistogramSink::same_spec(const LogHistogramSink *a, const LogHistogramSink *b)
+{
+  if (a == NULL || b == NULL) {
+    return a == b;
+  }
+  return strcmp(a->m_name, b->m_name) == 0 && strcmp(a->m_spec, b->m_spec) == 0;
+}
+
+/*-------------------------------------------------------------------------
+  LogHistogramSink::record
+
+  Called for every log entry, from any thread.  Keys are looked up without
+  locking; only the first entry of a new key takes the mutex.
+  -------------------------------------------------------------------------*/
+
+void
+LogHistogramSink::record(LogAccess *lad)
+{
+  char key[LOG_HISTOGRAM_KEY_LEN];
+  int key_len = 0;
+
+  key[0] = 0;
+  for (int i = 0; i < m_dimension_count; ++i) {
+    char value[LOG_HISTOGRAM_DIMENSION_LEN];
+
+    render_dimension(lad, m_dimensions[i], value, sizeof(value));
+    key_len += snprintf(key + key_len, sizeof(key) - key_len, i ? ".%s" : "%s", value);
+    if (key_len >= (int)sizeof(key)) {
+      break;
+    }
+  }
+
+  Key *k = find_key(key);
+
+  for (int i = 0; i < m_measure_count; ++i) {
+    int64_t value;
+
+    if (m_measures[i]->marshal(lad, (char *)&value) == INK_MIN_ALIGN && value >= 0) {
+      k->live[i].record_atomic(value);
+    }
+  }
+}
+
+void
+LogHistogramSink::render_dimension(LogAccess *lad, const Dimension &dim, char *dest, int dest_len)
+{
+  union {
+    int64_t align;
+    char data[LOG_HISTOGRAM_DIMENSION_LEN * 2];
+  } buf;
+  unsigned len = dim.field->marshal_len(lad);
+
+  if (len == 0 || len > sizeof(buf.data)) {
+    ink_strlcpy(dest, "-", dest_len);
+    return;
+  }
+
+  dim.field->marshal(lad, buf.data);
+  if (dim.status_class) {
+    int64_t status = buf.align;
+
+    if (status >= 100 && status < 1000) {
+      snprintf(dest, dest_len, "%dxx", (int)(status / 100));
+    } else {
+      ink_strlcpy(dest, "-", dest_len);
+    }
+  } else {
+    char *ptr = buf.data;
+    int n = dim.field->unmarshal(&ptr, dest, dest_len - 1);
+
+    dest[n > 0 ? n : 0] = 0;
+  }
+  sanitize_component(dest);
+}
+
+LogHistogramSink::Key *
+LogHistogramSink::find_key(const char *name)
+{
+  const unsigned mask = countof(m_table) - 1;
+  uint64_t hash = hash_key(name);
+
+  for (unsigned i = 0; i < countof(m_table); ++i) {
+    Key *k = m_table[(hash + i) & mask];
+
+    if (k == NULL) {
+      break;
+    }
+    if (k->hash == hash && strcmp(k->name, name) == 0) {
+      return k;
+    }
+  }
+
+  // Once all keys are taken every new dimension value counts as "other",
+  // which needs no lock.
+  if (Key *other = m_other) {
+    return other;
+  }
+  return new_key(name, hash);
+}
+
+LogHistogramSink::Key *
+LogHistogramSink::new_key(const char *name, uint64_t hash)
+{
+  const unsigned mask = countof(m_table) - 1;
+  Key *k = NULL;
+  unsigned slot = 0;
+
+  ink_mutex_acquire(&m_mutex);
+
+  // another thread may have added the key since we looked
+  for (unsigned i = 0; i < countof(m_table); ++i) {
+    slot = (hash + i) & mask;
+    k = m_table[slot];
+    if (k == NULL || (k->hash == hash && strcmp(k->name, name) == 0)) {
+      break;
+    }
+  }
+
+  if (k == NULL) {
+    bool overflow = m_key_count >= LOG_HISTOGRAM_MAX_KEYS;
+
+    if (overflow && m_other) {
+      k = m_other;
+    } else {
+      k = new Key;
+      k->name = ats_strdup(overflow ? "other" : name);
+      k->hash = hash;
+      k->registered = false;
+      k->live = new LogLinearHistogram[m_measure_count];
+      k->exported = new LogLinearHistogram[m_measure_count];
+
+      if (overflow) {
+        Warning("histogram %s has more than %d keys, counting new keys as 'other'", m_name, LOG_HISTOGRAM_MAX_KEYS);
+        m_keys[LOG_HISTOGRAM_MAX_KEYS] = k;
+        ink_atomic_cas(&m_other, (Key *)NULL, k);
+      } else {
+        m_keys[m_key_count++] = k;
+        ink_atomic_cas(&m_table[slot], (Key *)NULL, k);
+      }
+    }
+  }
+
+  ink_mutex_release(&m_mutex);
+  return k;
+}
+
+/*-------------------------------------------------------------------------
+  LogHistogramSink::export_stats
+  -------------------------------------------------------------------------*/
+
+void
+LogHistogramSink::periodic_tasks(long time_now)
+{
+  if (time_now >= m_next_export) {
+    export_stats();
+    m_next_export = time_now + m_interval_sec;
+  }
+}
+
+int
+LogHistogramSink::export_stats()
+{
+  int n = 0;
+
+  ink_mutex_acquire(&m_mutex);
+  for (int i = 0; i <= LOG_HISTOGRAM_MAX_KEYS; ++i) {
+    if (m_keys[i]) {
+      export_key(m_keys[i]);
+      ++n;
+    }
+  }
+  ink_mutex_release(&m_mutex);
+
+  return n;
+}
+
+void
+LogHistogramSink::export_key(Key *key)
+{
+  LogLinearHistogram snapshot, window;
+  char stat[512];
+
+  for (int i = 0; i < m_measure_count; ++i) {
+    LogField *f = m_measures[i];
+    char field[LOG_HISTOGRAM_DIMENSION_LEN];
+    int base_len;
+
+    // container fields (e.g. milestones) share their symbol, use the name
+    ink_strlcpy(field, f->marshal_func() ? f->symbol() : f->name(), sizeof(field));
+    sanitize_component(field);
+    base_len =
+      snprintf(stat, sizeof(stat), LOG_HISTOGRAM_STAT_PREFIX "%s%s%s.%s.", m_name, *key->name ? "." : "", key->name, field);
+    if (base_len + 8 > (int)sizeof(stat)) {
+      continue;
+    }
+
+    snapshot = key->live[i];
+    window.delta(snapshot, key->exported[i]);
+    key->exported[i] = snapshot;
+
+    struct {
+      const char *metric;
+      uint64_t value;
+    } values[] = {
+      {"count", snapshot.count()},         {"sum", snapshot.sum()},             {"p50", window.percentile(0.5)},
+      {"p90", window.percentile(0.9)},     {"p99", window.percentile(0.99)},    {"p999", window.percentile(0.999)},
+      {"max", window.max()},
+    };
+
+    for (unsigned j = 0; j < countof(values); ++j) {
+      ink_strlcpy(stat + base_len, values[j].metric, sizeof(stat) - base_len);
+      if (!key->registered) {
+        RecRegisterStatInt(RECT_PROCESS, stat, 0, RECP_NON_PERSISTENT);
+      }
+      RecSetRecordInt(stat, (RecInt)values[j].value, REC_SOURCE_DEFAULT);
+    }
+  }
+  key->registered = true;
+}
+
+#if TS_HAS_TESTS
+
+#include "HTTP.h"
+
+class LogAccessHistogramTest : public LogAccess
+{
+public:
+  LogAccessHistogramTest() : n(0) {}
+
+  LogEntryType
+  entry_type()
+  {
+    return LOG_ENTRY_HTTP;
+  }
+
+  int
+  marshal_proxy_resp_status_code(char *buf)
+  {
+    if (buf) {
+      marshal_int(buf, n % 10 ? 200 : 503);
+    }
+    return INK_MIN_ALIGN;
+  }
+
+  int
+  marshal_cache_result_code(char *buf)
+  {
+    if (buf) {
+      marshal_int(buf, n % 2 ? SQUID_LOG_TCP_HIT : SQUID_LOG_TCP_MISS);
+    }
+    return INK_MIN_ALIGN;
+  }
+
+  int
+  marshal_transfer_time_ms(char *buf)
+  {
+    if (buf) {
+      marshal_int(buf, n % 1000);
+    }
+    return INK_MIN_ALIGN;
+  }
+
+  int n;
+};
+
+REGRESSION_TEST(LogHistogramSink)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  LogFormat format("histogram_test", "%<pssc> %<crc> %<ttms> %<cqhm>");
+  LogHistogramSink sink("regression.test", &format, "pssc:class,crc,nosuchfield", 60);
+  LogAccessHistogramTest lad;
+  RecInt count = 0, p50 = 0, max = 0;
+
+  box = REGRESSION_TEST_PASSED;
+  box.check(sink.valid(), "histogram sink should be valid");
+
+  for (lad.n = 0; lad.n < 10000; ++lad.n) {
+    sink.record(&lad);
+  }
+  box.check(sink.export_stats() == 3, "expected 3 keys (2xx.TCP_HIT, 2xx.TCP_MISS, 5xx.TCP_MISS)");
+
+  RecGetRecordInt(LOG_HISTOGRAM_STAT_PREFIX "regression_test.2xx.TCP_HIT.ttms.count", &count);
+  RecGetRecordInt(LOG_HISTOGRAM_STAT_PREFIX "regression_test.2xx.TCP_HIT.ttms.p50", &p50);
+  RecGetRecordInt(LOG_HISTOGRAM_STAT_PREFIX "regression_test.5xx.TCP_MISS.ttms.max", &max);
+  rprintf(t, "2xx.TCP_HIT: count %" PRId64 ", p50 %" PRId64 "; 5xx.TCP_MISS: max %" PRId64 "\n", count, p50, max);
+
+  box.check(count == 5000, "expected 5000 2xx hits, got %" PRId64, count);
+  box.check(p50 >= 500 && p50 <= 500 + 500 / LogLinearHistogram::SUB_BUCKETS, "2xx hit p50 should be ~500, got %" PRId64, p50);
+  box.check(max == 990, "5xx misses max should be 990, got %" PRId64, max);
+
+  // the next interval only holds the new samples
+  for (lad.n = 0; lad.n < 10; ++lad.n) {
+    sink.record(&lad);
+  }
+  sink.export_stats();
+  RecGetRecordInt(LOG_HISTOGRAM_STAT_PREFIX "regression_test.2xx.TCP_HIT.ttms.max", &max);
+  RecGetRecordInt(LOG_HISTOGRAM_STAT_PREFIX "regression_test.2xx.TCP_HIT.ttms.count", &count);
+  box.check(max == 9, "2xx hits max over the last interval should be 9, got %" PRId64, max);
+  box.check(count == 5005, "expected 5005 2xx hits, got %" PRId64, count);
+}
+
+#endif
@@ -0,0 +1,120 @@
+/** @file
+
+  In-memory latency histograms fed by log entries.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef LOG_HISTOGRAM_H
+#define LOG_HISTOGRAM_H
+
+#include "ts/ink_platform.h"
+#include "ts/ink_mutex.h"
+#include "ts/Histogram.h"
+
+class LogAccess;
+class LogField;
+class LogFormat;
+
+#define LOG_HISTOGRAM_MAX_KEYS 64
+#define LOG_HISTOGRAM_DEFAULT_INTERVAL 60
+#define LOG_HISTOGRAM_STAT_PREFIX "proxy.process.log.histogram."
+
+/*-------------------------------------------------------------------------
+  LogHistogramSink
+
+  A LogObject with a histogram sink does not write log entries.  Instead,
+  every integer field of its format that is not a dimension is recorded
+  into a LogLinearHistogram, one set of histograms per distinct value of
+  the dimension fields (e.g. "pssc:class,crc" keys by status class and
+  cache result).  Every interval, the histograms are exported as process
+  stats named
+
+      proxy.process.log.histogram.<name>[.<key>].<symbol>.<metric>
+
+  where metric is one of count and sum (since startup), or p50, p90, p99,
+  p999 and max (over the last interval).  Keys past LOG_HISTOGRAM_MAX_KEYS
+  are folded into the "other" key.
+  -------------------------------------------------------------------------*/
+
+class LogHistogramSink
+{
+public:
+  LogHistogramSink(const char *name, LogFormat *format, const char *dimensions, int interval_sec);
+  ~LogHistogramSink();
+
+  bool
+  valid() const
+  {
+    return m_measure_count > 0;
+  }
+
+  // a fresh sink with the same configuration, for a copy of its LogObject
+  LogHistogramSink *clone(LogFormat *format) const;
+
+  void record(LogAccess *lad);
+  void periodic_tasks(long time_now);
+
+  // export the current histograms immediately; returns the number of keys
+  int export_stats();
+
+  static bool same_spec(const LogHistogramSink *a, const LogHistogramSink *b);
+
+private:
+  struct Dimension {
+    LogField *field;
+    bool status_class; // render a status code as "2xx"
+  };
+
+  struct Key {
+    char *name;
+    uint64_t hash;
+    bool registered;
+    LogLinearHistogram *live;     // one per measured field, updated atomically
+    LogLinearHistogram *exported; // snapshot of live at the last export
+  };
+
+  Key *find_key(const char *name);
+  Key *new_key(const char *name, uint64_t hash);
+  void render_dimension(LogAccess *lad, const Dimension &dim, char *dest, int dest_len);
+  void export_key(Key *key);
+
+  char *m_name;
+  char *m_dimension_str;
+  char *m_spec;
+  int m_interval_sec;
+  long m_next_export;
+
+  LogField **m_measures;
+  int m_measure_count;
+  Dimension *m_dimensions;
+  int m_dimension_count;
+
+  ink_mutex m_mutex; // serializes key creation and exports
+  Key *volatile m_table[LOG_HISTOGRAM_MAX_KEYS * 2];
+  Key *m_keys[LOG_HISTOGRAM_MAX_KEYS + 1];
+  int m_key_count;
+  Key *volatile m_other; // set once all keys are taken, and never cleared
+
+  // -- member functions not allowed --
+  LogHistogramSink(const LogHistogramSink &);
+  LogHistogramSink &operator=(const LogHistogramSink &);
+};
+
+#endif
@@ -92,7 +92,7 @@ LogObject::LogObject(const LogFormat *format, const char *log_dir, const char *b
                      int rolling_offset_hr, int rolling_size_mb, bool auto_created)
   : m_auto_created(auto_created), m_alt_filename(NULL), m_flags(0), m_signature(0), m_flush_threads(flush_threads),
     m_rolling_interval_sec(rolling_interval_sec), m_rolling_offset_hr(rolling_offset_hr), m_rolling_size_mb(rolling_size_mb),
-    m_last_roll_time(0), m_buffer_manager_idx(0)
+    m_last_roll_time(0), m_buffer_manager_idx(0), m_histogram_sink(NULL)
 {
   ink_release_assert(format);
   m_format = new LogFormat(*format);
@@ -100,6 +100,8 @@ LogObject::LogObject(const LogFormat *format, const char *log_dir, const char *b
 
   if (file_format == LOG_FILE_BINARY) {
     m_flags |= BINARY;
+  } else if (file_format == LOG_FILE_COLUMNAR) {
+    m_flags |= BINARY | COLUMNAR;
   } else if (file_format == LOG_FILE_PIPE) {
     m_flags |= WRITES_TO_PIPE;
   }
@@ -126,11 +128,15 @@ LogObject::LogObject(const LogFormat *format, const char *log_dir, const char *b
 LogObject::LogObject(LogObject &rhs)
   : m_basename(ats_strdup(rhs.m_basename)), m_filename(ats_strdup(rhs.m_filename)), m_alt_filename(ats_strdup(rhs.m_alt_filename)),
     m_flags(rhs.m_flags), m_signature(rhs.m_signature), m_flush_threads(rhs.m_flush_threads),
-    m_rolling_interval_sec(rhs.m_rolling_interval_sec), m_last_roll_time(rhs.m_last_roll_time)
+    m_rolling_interval_sec(rhs.m_rolling_interval_sec), m_last_roll_time(rhs.m_last_roll_time), m_histogram_sink(NULL)
 {
   m_format = new LogFormat(*(rhs.m_format));
   m_buffer_manager = new LogBufferManager[m_flush_threads];
 
+  if (rhs.m_histogram_sink) {
+    m_histogram_sink = rhs.m_histogram_sink->clone(m_format);
+  }
+
   if (rhs.m_logFile) {
     m_logFile = new LogFile(*(rhs.m_logFile));
   } else {
@@ -176,6 +182,7 @@ LogObject::~LogObject()
   delete m_format;
   delete[] m_buffer_manager;
   delete (LogBuffer *)FREELIST_POINTER(m_log_buffer);
+  delete m_histogram_sink;
 }
 
 //-----------------------------------------------------------------------------
@@ -223,6 +230,10 @@ LogObject::generate_filenames(const char *log_dir, const char *basename, LogFile
       ext = LOG_FILE_PIPE_OBJECT_FILENAME_EXTENSION;
       ext_len = 5;
       break;
+    case LOG_FILE_COLUMNAR:
+      ext = LOG_FILE_COLUMNAR_OBJECT_FILENAME_EXTENSION;
+      ext_len = 5;
+      break;
     default:
       ink_assert(!"unknown file format");
     }
@@ -316,8 +327,18 @@ LogObject::compute_signature(LogFormat *format, char *filename, unsigned int fla
     int buf_size = strlen(fl) + strlen(ps) + strlen(filename) + 2;
     char *buffer = (char *)ats_malloc(buf_size);
 
-    ink_string_concatenate_strings(buffer, fl, ps, filename,
-                                   flags & LogObject::BINARY ? "B" : (flags & LogObject::WRITES_TO_PIPE ? "P" : "A"), NULL);
+    const char *mode = "A";
+    if (flags & LogObject::HISTOGRAM) {
+      mode = "H";
+    } else if (flags & LogObject::COLUMNAR) {
+      mode = "C";
+    } else if (flags & LogObject::BINARY) {
+      mode = "B";
+    } else if (flags & LogObject::WRITES_TO_PIPE) {
+      mode = "P";
+    }
+
+    ink_string_concatenate_strings(buffer, fl, ps, filename, mode, NULL);
 
     CryptoHash hash;
     MD5Context().hash_immediate(hash, buffer, buf_size - 1);
@@ -360,7 +381,8 @@ LogObject::displayAsXML(FILE *fd, bool extended)
               "  <Mode        = \"%s\"/>\n"
               "  <Format      = \"%s\"/>\n"
               "  <Filename    = \"%s\"/>\n",
-          (m_flags & BINARY ? "binary" : "ascii"), m_format->name(), m_filename);
+          (m_flags & HISTOGRAM ? "histogram" : m_flags & COLUMNAR ? "columnar" : (m_flags & BINARY ? "binary" : "ascii")),
+          m_format->name(), m_filename);
 
   LogFilter *filter;
   for (filter = m_filter_list.first(); filter != NULL; filter = m_filter_list.next(filter)) {
@@ -521,7 +543,7 @@ LogObject::log(LogAccess *lad, const char *text_entry)
   // log to a pipe even if space is exhausted since pipe uses no space
   // likewise, send data to a remote client even if local space is exhausted
   // (if there is a remote client, m_logFile will be NULL
-  if (Log::config->logging_space_exhausted && !writes_to_pipe() && m_logFile) {
+  if (Log::config->logging_space_exhausted && !writes_to_pipe() && !writes_histograms() && m_logFile) {
     Debug("log", "logging space exhausted, can't write to:%s, drop this entry", m_logFile->get_name());
     return Log::FULL;
   }
@@ -541,6 +563,14 @@ LogObject::log(LogAccess *lad, const char *text_entry)
     Debug("log", "entry wiped, ...");
   }
 
+  if (m_histogram_sink) {
+    // histogram objects only aggregate the entry, they never write it
+    if (lad) {
+      m_histogram_sink->record(lad);
+    }
+    return Log::LOG_OK;
+  }
+
   if (lad && m_format->is_aggregate()) {
     // marshal the field data into the temp space provided by the
     // LogFormat object for aggregate formats
@@ -575,7 +605,7 @@ LogObject::log(LogAccess *lad, const char *text_entry)
     // and will use INK_MIN_ALIGN each
     bytes_needed = m_format->field_count() * INK_MIN_ALIGN;
   } else if (lad) {
-    bytes_needed = m_format->m_field_list.marshal_len(lad);
+    bytes_needed = m_format->m_marshal_plan.marshal_len(lad);
   } else if (text_entry) {
     bytes_needed = LogAccess::strlen(text_entry);
   }
@@ -608,7 +638,7 @@ LogObject::log(LogAccess *lad, const char *text_entry)
     m_format->m_interval_next += m_format->m_interval_sec;
     Debug("log-agg", "Aggregate entry created; next time is %ld", m_format->m_interval_next);
   } else if (lad) {
-    bytes_used = m_format->m_field_list.marshal(lad, &(*buffer)[offset]);
+    bytes_used = m_format->m_marshal_plan.marshal(lad, &(*buffer)[offset]);
     ink_assert(bytes_needed >= bytes_used);
   } else if (text_entry) {
     ink_strlcpy(&(*buffer)[offset], text_entry, bytes_needed);
@@ -752,8 +782,8 @@ LogObject::_roll_files(long last_roll_time, long time_now)
   unsigned num_rolled = 0;
 
   if (m_logFile) {
-    // no need to roll if object writes to a pipe
-    if (!writes_to_pipe()) {
+    // no need to roll if object writes to a pipe, or writes no file at all
+    if (!writes_to_pipe() && !writes_histograms()) {
       num_rolled += m_logFile->roll(last_roll_time, time_now);
     }
   } else {
@@ -773,12 +803,34 @@ LogObject::_roll_files(long last_roll_time, long time_now)
 void
 LogObject::check_buffer_expiration(long time_now)
 {
+  // histogram objects never put entries in their buffers, which are never
+  // flushed so that their LogFile is never opened
+  if (writes_histograms()) {
+    return;
+  }
+
   LogBuffer *b = (LogBuffer *)FREELIST_POINTER(m_log_buffer);
   if (b && time_now > b->expiration_time()) {
     force_new_buffer();
   }
 }
 
+void
+LogObject::set_histogram_sink(LogHistogramSink *sink)
+{
+  delete m_histogram_sink;
+  m_histogram_sink = sink;
+  m_flags |= HISTOGRAM;
+  m_signature = compute_signature(m_format, m_basename, m_flags);
+}
+
+void
+LogObject::export_histograms(long time_now)
+{
+  if (m_histogram_sink) {
+    m_histogram_sink->periodic_tasks(time_now);
+  }
+}
 
 // make sure that we will be able to write the logs to the disk
 //
@@ -1117,6 +1169,18 @@ LogObjectManager::check_buffer_expiration(long time_now)
   RELEASE_API_MUTEX("R LogObjectManager::check_buffer_expiration");
 }
 
+void
+LogObjectManager::export_histograms(long time_now)
+{
+  ACQUIRE_API_MUTEX("A LogObjectManager::export_histograms");
+
+  for (unsigned i = 0; i < this->_objects.length(); i++) {
+    this->_objects[i]->export_histograms(time_now);
+  }
+
+  RELEASE_API_MUTEX("R LogObjectManager::export_histograms");
+}
+
 size_t
 LogObjectManager::preproc_buffers(int idx)
 {
@@ -1401,4 +1465,103 @@ REGRESSION_TEST(LogObjectManager_Transfer)(RegressionTest *t, int /* atype ATS_U
   box = REGRESSION_TEST_PASSED;
 }
 
+// A 30 field custom format, mixing integers, strings, IPs and header fields.
+static const char *bench_fields[] = {"cqtq", "ttms", "chi",  "chp",  "crc",  "pssc", "psql", "cqhm", "cquc", "caun",
+                                     "phr",  "pqsn", "psct", "cqhv", "pscl", "cqbl", "sscl", "sssc", "shi",  "cqtr",
+                                     "cqhl", "pshl", "stms", "pqbl", "cluc", "{Via}psh", "{Host}cqh", "{Referer}cqh",
+                                     "{User-Agent}cqh", "{Content-Type}ssh"};
+
+class LogAccessBench : public LogAccess
+{
+public:
+  LogEntryType
+  entry_type()
+  {
+    return LOG_ENTRY_HTTP;
+  }
+
+  int
+  marshal_client_req_url_canon(char *buf)
+  {
+    return marshal_string(buf, "http://www.example.com/some/path/to/an/object.jpg?w=640&h=480");
+  }
+
+  int
+  marshal_http_header_field(LogField::Container /* container ATS_UNUSED */, char *field, char *buf)
+  {
+    return marshal_string(buf, field);
+  }
+
+private:
+  static int
+  marshal_string(char *buf, const char *str)
+  {
+    int len = round_strlen(::strlen(str) + 1);
+    if (buf) {
+      marshal_str(buf, str, len);
+    }
+    return len;
+  }
+};
+
+REGRESSION_TEST(LogMarshalPlan_Benchmark)(RegressionTest *t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  const int iterations = 100000;
+  char format_str[512] = "";
+
+  box = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < countof(bench_fields); ++i) {
+    ink_strlcat(format_str, i ? " %<" : "%<", sizeof(format_str));
+    ink_strlcat(format_str, bench_fields[i], sizeof(format_str));
+    ink_strlcat(format_str, ">", sizeof(format_str));
+  }
+
+  LogFormat format("marshal_bench", format_str);
+  LogAccessBench lad;
+
+  box.check(format.valid() && format.field_count() == countof(bench_fields), "invalid benchmark format '%s'", format_str);
+  box.check(format.m_marshal_plan.valid(), "no marshalling plan for '%s'", format_str);
+  if (!format.m_marshal_plan.valid()) {
+    return;
+  }
+
+  unsigned list_len = format.m_field_list.marshal_len(&lad);
+  unsigned plan_len = format.m_marshal_plan.marshal_len(&lad);
+  box.check(list_len == plan_len, "marshal_len mismatch: list %u, plan %u", list_len, plan_len);
+
+  char *list_buf = (char *)ats_malloc(list_len);
+  char *plan_buf = (char *)ats_malloc(list_len);
+  memset(list_buf, 0, list_len);
+  memset(plan_buf, 0, list_len);
+  unsigned list_used = format.m_field_list.marshal(&lad, list_buf);
+  unsigned plan_used = format.m_marshal_plan.marshal(&lad, plan_buf);
+  box.check(list_used <= list_len && list_used == plan_used, "marshal mismatch: list %u, plan %u", list_used, plan_used);
+  box.check(memcmp(list_buf, plan_buf, list_len) == 0, "marshalled entries differ");
+
+  // Size and marshal the entry, as LogObject::log does.
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int i = 0; i < iterations; ++i) {
+    if (format.m_field_list.marshal_len(&lad) == list_len) {
+      format.m_field_list.marshal(&lad, list_buf);
+    }
+  }
+  ink_hrtime list_time = ink_get_hrtime_internal() - start;
+
+  start = ink_get_hrtime_internal();
+  for (int i = 0; i < iterations; ++i) {
+    if (format.m_marshal_plan.marshal_len(&lad) == list_len) {
+      format.m_marshal_plan.marshal(&lad, plan_buf);
+    }
+  }
+  ink_hrtime plan_time = ink_get_hrtime_internal() - start;
+
+  rprintf(t, "%u fields, %u bytes per entry: LogFieldList %.1f ns/entry, LogMarshalPlan %.1f ns/entry\n", format.field_count(),
+          list_len, (double)list_time / iterations, (double)plan_time / iterations);
+
+  ats_free(list_buf);
+  ats_free(plan_buf);
+}
+
 #endif
@@ -34,6 +34,7 @@
 #include "LogBuffer.h"
 #include "LogAccess.h"
 #include "LogFilter.h"
+#include "LogHistogram.h"
 #include "ts/Vec.h"
 
 /*-------------------------------------------------------------------------
@@ -51,6 +52,7 @@
 #define LOG_FILE_ASCII_OBJECT_FILENAME_EXTENSION ".log"
 #define LOG_FILE_BINARY_OBJECT_FILENAME_EXTENSION ".blog"
 #define LOG_FILE_PIPE_OBJECT_FILENAME_EXTENSION ".pipe"
+#define LOG_FILE_COLUMNAR_OBJECT_FILENAME_EXTENSION ".clog"
 
 #define FLUSH_ARRAY_SIZE (512 * 4)
 
@@ -93,12 +95,18 @@ public:
     REMOTE_DATA = 2,
     WRITES_TO_PIPE = 4,
     LOG_OBJECT_FMT_TIMESTAMP = 8, // always format a timestamp into each log line (for raw text logs)
+    COLUMNAR = 16,
+    HISTOGRAM = 32,
   };
 
   // BINARY: log is written in binary format (rather than ascii)
   // REMOTE_DATA: object receives data from remote collation clients, so
   //              it should not be destroyed during a reconfiguration
   // WRITES_TO_PIPE: object writes to a named pipe rather than to a file
+  // COLUMNAR: binary log is written as compressed columnar blocks (always
+  //           set together with BINARY)
+  // HISTOGRAM: entries are aggregated into in-memory histograms that are
+  //            exported as stats; nothing is written to the log file
 
   LogObject(const LogFormat *format, const char *log_dir, const char *basename, LogFileFormat file_format, const char *header,
             Log::RollingEnabledValues rolling_enabled, int flush_threads, int rolling_interval_sec = 0, int rolling_offset_hr = 0,
@@ -120,6 +128,7 @@ public:
   {
     m_flags |= LOG_OBJECT_FMT_TIMESTAMP;
   }
+  void set_histogram_sink(LogHistogramSink *sink);
 
   int log(LogAccess *lad, const char *text_entry = NULL);
   int va_log(LogAccess *lad, const char *fmt, va_list ap);
@@ -153,6 +162,7 @@ public:
   }
 
   void check_buffer_expiration(long time_now);
+  void export_histograms(long time_now);
 
   void display(FILE *fd = stdout);
   void displayAsXML(FILE *fd = stdout, bool extended = false);
@@ -236,7 +246,12 @@ public:
   bool
   writes_to_disk()
   {
-    return (m_logFile && !(m_flags & WRITES_TO_PIPE) ? true : false);
+    return (m_logFile && !(m_flags & (WRITES_TO_PIPE | HISTOGRAM)) ? true : false);
+  }
+  bool
+  writes_histograms() const
+  {
+    return m_flags & HISTOGRAM ? true : false;
   }
 
   unsigned int
@@ -301,6 +316,7 @@ private:
   volatile head_p m_log_buffer; // current work buffer
   unsigned m_buffer_manager_idx;
   LogBufferManager *m_buffer_manager;
+  LogHistogramSink *m_histogram_sink; // only set for HISTOGRAM objects
 
   void generate_filenames(const char *log_dir, const char *basename, LogFileFormat file_format);
   void _setup_rolling(Log::RollingEnabledValues rolling_enabled, int rolling_interval_sec, int rolling_offset_hr,
@@ -408,6 +424,7 @@ public:
 
   LogObject *get_object_with_signature(uint64_t signature);
   void check_buffer_expiration(long time_now);
+  void export_histograms(long time_now);
 
   unsigned roll_files(long time_now);
 
@@ -439,7 +456,7 @@ inline bool LogObject::operator==(LogObject &old)
             (is_collation_client() && old.is_collation_client() ?
                m_host_list == old.m_host_list :
                m_logFile && old.m_logFile && strcmp(m_logFile->get_name(), old.m_logFile->get_name()) == 0) &&
-            (m_filter_list == old.m_filter_list) &&
+            (m_filter_list == old.m_filter_list) && LogHistogramSink::same_spec(m_histogram_sink, old.m_histogram_sink) &&
             (m_rolling_interval_sec == old.m_rolling_interval_sec && m_rolling_offset_hr == old.m_rolling_offset_hr &&
              m_rolling_size_mb == old.m_rolling_size_mb));
   }
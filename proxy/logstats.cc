@@ -33,6 +33,7 @@
 #include "LogStandalone.cc"
 
 #include "LogObject.h"
+#include "LogColumnar.h"
 #include "hdrs/HTTP.h"
 
 #include <math.h>
@@ -1123,6 +1124,334 @@ update_schemes(OriginStats *stat, int scheme, int size)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Classify the method of a record. The flag is set if the URL should not be
+// parsed.
+static HTTPMethod
+parse_method(const char *str, int *flag)
+{
+  int len;
+
+  *flag = 0;
+
+  // Small optimization for common (3-4 char) cases
+  switch (*reinterpret_cast<const int *>(str)) {
+  case GET_AS_INT:
+    return METHOD_GET;
+  case PUT_AS_INT:
+    return METHOD_PUT;
+  case HEAD_AS_INT:
+    return METHOD_HEAD;
+  case POST_AS_INT:
+    return METHOD_POST;
+  default:
+    len = strlen(str);
+    if ((5 == len) && (0 == strncmp(str, "PURGE", 5)))
+      return METHOD_PURGE;
+    else if ((6 == len) && (0 == strncmp(str, "DELETE", 6)))
+      return METHOD_DELETE;
+    else if ((7 == len) && (0 == strncmp(str, "OPTIONS", 7)))
+      return METHOD_OPTIONS;
+    else if ((1 == len) && ('-' == *str)) {
+      *flag = 1; // No method, so no need to parse the URL
+      return METHOD_NONE;
+    } else {
+      const char *ptr = str;
+      while (*ptr && isupper(*ptr))
+        ++ptr;
+      // Skip URL if it doesn't look like an HTTP method
+      if (*ptr != '\0')
+        *flag = 1;
+    }
+    break;
+  }
+
+  return METHOD_OTHER;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update the stats of a record from its URL on, which is where the origin is
+// known. Returns the stats of the origin, if they are kept.
+static OriginStats *
+update_url(const char *url, int flag, bool summary, HTTPMethod method, int result, int http_code, int size, int elapsed)
+{
+  OriginStats *o_stats = NULL;
+  URLScheme scheme = SCHEME_OTHER;
+  const char *tok = url;
+
+  if (urls)
+    urls->add_stat(url, size, elapsed, result, http_code, cl.as_object);
+
+  // TODO check for url being empty string
+  if (0 == flag) {
+    if (HTTP_AS_INT == *reinterpret_cast<const int *>(tok)) {
+      tok += 4;
+      if (':' == *tok) {
+        scheme = SCHEME_HTTP;
+        tok += 3;
+      } else if ('s' == *tok) {
+        scheme = SCHEME_HTTPS;
+        tok += 4;
+      }
+    } else if ('/' == *tok) {
+      scheme = SCHEME_NONE;
+    }
+    if ('/' == *tok) // This is to handle crazy stuff like http:///origin.com
+      tok++;
+
+    const char *ptr = strchr(tok, '/');
+    char origin[1024];
+
+    if (ptr && !summary && (size_t)(ptr - tok) < sizeof(origin)) { // Find the origin
+      memcpy(origin, tok, ptr - tok);
+      origin[ptr - tok] = '\0';
+
+      // TODO: If we save state (struct) for a run, we probably need to always
+      // update the origin data, no matter what the origin_set is.
+      if (origin_set->empty() || (origin_set->find(origin) != origin_set->end())) {
+        OriginStorage::iterator o_iter = origins.find(origin);
+        if (origins.end() == o_iter) {
+          o_stats = (OriginStats *)ats_malloc(sizeof(OriginStats));
+          memset(o_stats, 0, sizeof(OriginStats));
+          init_elapsed(o_stats);
+          char *o_server = ats_strdup(origin);
+          if (o_stats && o_server) {
+            o_stats->server = o_server;
+            origins[o_server] = o_stats;
+          }
+        } else
+          o_stats = o_iter->second;
+      }
+    }
+  } else {
+    // No method given
+    if ('/' == *tok)
+      scheme = SCHEME_NONE;
+  }
+
+  // Update the stats so far, since now we have the Origin (maybe)
+  update_results_elapsed(&totals, result, elapsed, size);
+  update_codes(&totals, http_code, size);
+  update_methods(&totals, method, size);
+  update_schemes(&totals, scheme, size);
+  update_counter(totals.total, size);
+  if (o_stats != NULL) {
+    update_results_elapsed(o_stats, result, elapsed, size);
+    update_codes(o_stats, http_code, size);
+    update_methods(o_stats, method, size);
+    update_schemes(o_stats, scheme, size);
+    update_counter(o_stats->total, size);
+  }
+
+  return o_stats;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update the "hierarchies" stats for a particular record
+static void
+update_hierarchy(OriginStats *o_stats, int64_t hier, int size)
+{
+  switch (hier) {
+  case SQUID_HIER_NONE:
+    update_counter(totals.hierarchies.none, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->hierarchies.none, size);
+    break;
+  case SQUID_HIER_DIRECT:
+    update_counter(totals.hierarchies.direct, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->hierarchies.direct, size);
+    break;
+  case SQUID_HIER_SIBLING_HIT:
+    update_counter(totals.hierarchies.sibling, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->hierarchies.sibling, size);
+    break;
+  case SQUID_HIER_PARENT_HIT:
+    update_counter(totals.hierarchies.parent, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->hierarchies.direct, size);
+    break;
+  case SQUID_HIER_EMPTY:
+    update_counter(totals.hierarchies.empty, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->hierarchies.empty, size);
+    break;
+  default:
+    if ((hier >= SQUID_HIER_EMPTY) && (hier < SQUID_HIER_INVALID_ASSIGNED_CODE)) {
+      update_counter(totals.hierarchies.other, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->hierarchies.other, size);
+    } else {
+      update_counter(totals.hierarchies.invalid, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->hierarchies.invalid, size);
+    }
+    break;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update the "content" stats for a particular record
+static void
+update_content_type(OriginStats *o_stats, const char *type, int size)
+{
+  const char *tok;
+
+  if (IMAG_AS_INT == *reinterpret_cast<const int *>(type)) {
+    update_counter(totals.content.image.total, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.image.total, size);
+    tok = type + 6;
+    switch (*reinterpret_cast<const int *>(tok)) {
+    case JPEG_AS_INT:
+    case JPG_AS_INT:
+      update_counter(totals.content.image.jpeg, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.image.jpeg, size);
+      break;
+    case GIF_AS_INT:
+      update_counter(totals.content.image.gif, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.image.gif, size);
+      break;
+    case PNG_AS_INT:
+      update_counter(totals.content.image.png, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.image.png, size);
+      break;
+    case BMP_AS_INT:
+      update_counter(totals.content.image.bmp, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.image.bmp, size);
+      break;
+    default:
+      update_counter(totals.content.image.other, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.image.other, size);
+      break;
+    }
+  } else if (TEXT_AS_INT == *reinterpret_cast<const int *>(type)) {
+    tok = type + 5;
+    update_counter(totals.content.text.total, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.text.total, size);
+    switch (*reinterpret_cast<const int *>(tok)) {
+    case JAVA_AS_INT:
+      // TODO verify if really "javascript"
+      update_counter(totals.content.text.javascript, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.javascript, size);
+      break;
+    case CSS_AS_INT:
+      update_counter(totals.content.text.css, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.css, size);
+      break;
+    case XML_AS_INT:
+      update_counter(totals.content.text.xml, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.xml, size);
+      break;
+    case HTML_AS_INT:
+      update_counter(totals.content.text.html, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.html, size);
+      break;
+    case PLAI_AS_INT:
+      update_counter(totals.content.text.plain, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.plain, size);
+      break;
+    default:
+      update_counter(totals.content.text.other, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.text.other, size);
+      break;
+    }
+  } else if (0 == strncmp(type, "application", 11)) {
+    tok = type + 12;
+    update_counter(totals.content.application.total, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.application.total, size);
+    switch (*reinterpret_cast<const int *>(tok)) {
+    case ZIP_AS_INT:
+      update_counter(totals.content.application.zip, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.application.zip, size);
+      break;
+    case JAVA_AS_INT:
+      update_counter(totals.content.application.javascript, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.application.javascript, size);
+    case X_JA_AS_INT:
+      update_counter(totals.content.application.javascript, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.application.javascript, size);
+      break;
+    case RSSp_AS_INT:
+      if (0 == strcmp(tok + 4, "xml")) {
+        update_counter(totals.content.application.rss_xml, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.rss_xml, size);
+      } else if (0 == strcmp(tok + 4, "atom")) {
+        update_counter(totals.content.application.rss_atom, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.rss_atom, size);
+      } else {
+        update_counter(totals.content.application.rss_other, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.rss_other, size);
+      }
+      break;
+    default:
+      if (0 == strcmp(tok, "x-shockwave-flash")) {
+        update_counter(totals.content.application.shockwave_flash, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.shockwave_flash, size);
+      } else if (0 == strcmp(tok, "x-quicktimeplayer")) {
+        update_counter(totals.content.application.quicktime, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.quicktime, size);
+      } else {
+        update_counter(totals.content.application.other, size);
+        if (o_stats != NULL)
+          update_counter(o_stats->content.application.other, size);
+      }
+    }
+  } else if (0 == strncmp(type, "audio", 5)) {
+    tok = type + 6;
+    update_counter(totals.content.audio.total, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.audio.total, size);
+    if ((0 == strcmp(tok, "x-wav")) || (0 == strcmp(tok, "wav"))) {
+      update_counter(totals.content.audio.wav, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.audio.wav, size);
+    } else if ((0 == strcmp(tok, "x-mpeg")) || (0 == strcmp(tok, "mpeg"))) {
+      update_counter(totals.content.audio.mpeg, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.audio.mpeg, size);
+    } else {
+      update_counter(totals.content.audio.other, size);
+      if (o_stats != NULL)
+        update_counter(o_stats->content.audio.other, size);
+    }
+  } else if ('-' == *type) {
+    update_counter(totals.content.none, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.none, size);
+  } else {
+    update_counter(totals.content.other, size);
+    if (o_stats != NULL)
+      update_counter(o_stats->content.other, size);
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Parse a log buffer
 int
@@ -1133,21 +1462,15 @@ parse_log_buff(LogBufferHeader *buf_header, bool summary = false)
   LogEntryHeader *entry;
   LogBufferIterator buf_iter(buf_header);
   LogField *field;
-  OriginStorage::iterator o_iter;
   ParseStates state;
 
   char *read_from;
-  char *tok;
-  char *ptr;
-  int tok_len;
   int flag = 0; // Flag used in state machine to carry "state" forward
 
   // Parsed results
-  int http_code = 0, size = 0, result = 0, hier = 0, elapsed = 0;
+  int http_code = 0, size = 0, result = 0, elapsed = 0;
   OriginStats *o_stats;
-  char *o_server;
   HTTPMethod method;
-  URLScheme scheme;
 
   if (!fieldlist) {
     fieldlist = new LogFieldList;
@@ -1166,9 +1489,7 @@ parse_log_buff(LogBufferHeader *buf_header, bool summary = false)
 
     state = P_STATE_ELAPSED;
     o_stats = NULL;
-    o_server = NULL;
     method = METHOD_OTHER;
-    scheme = SCHEME_OTHER;
 
     while ((field = fieldlist->next(field))) {
       switch (state) {
@@ -1222,360 +1543,36 @@ parse_log_buff(LogBufferHeader *buf_header, bool summary = false)
 
       case P_STATE_METHOD:
         state = P_STATE_URL;
-        flag = 0;
-
-        // Small optimization for common (3-4 char) cases
-        switch (*reinterpret_cast<int *>(read_from)) {
-        case GET_AS_INT:
-          method = METHOD_GET;
-          read_from += LogAccess::round_strlen(3 + 1);
-          break;
-        case PUT_AS_INT:
-          method = METHOD_PUT;
-          read_from += LogAccess::round_strlen(3 + 1);
-          break;
-        case HEAD_AS_INT:
-          method = METHOD_HEAD;
-          read_from += LogAccess::round_strlen(4 + 1);
-          break;
-        case POST_AS_INT:
-          method = METHOD_POST;
-          read_from += LogAccess::round_strlen(4 + 1);
-          break;
-        default:
-          tok_len = strlen(read_from);
-          if ((5 == tok_len) && (0 == strncmp(read_from, "PURGE", 5)))
-            method = METHOD_PURGE;
-          else if ((6 == tok_len) && (0 == strncmp(read_from, "DELETE", 6)))
-            method = METHOD_DELETE;
-          else if ((7 == tok_len) && (0 == strncmp(read_from, "OPTIONS", 7)))
-            method = METHOD_OPTIONS;
-          else if ((1 == tok_len) && ('-' == *read_from)) {
-            method = METHOD_NONE;
-            flag = 1; // No method, so no need to parse the URL
-          } else {
-            ptr = read_from;
-            while (*ptr && isupper(*ptr))
-              ++ptr;
-            // Skip URL if it doesn't look like an HTTP method
-            if (*ptr != '\0')
-              flag = 1;
-          }
-          read_from += LogAccess::round_strlen(tok_len + 1);
-          break;
-        }
+        method = parse_method(read_from, &flag);
+        read_from += LogAccess::strlen(read_from);
         break;
 
       case P_STATE_URL:
         state = P_STATE_RFC931;
-        if (urls)
-          urls->add_stat(read_from, size, elapsed, result, http_code, cl.as_object);
-
-        // TODO check for read_from being empty string
-        if (0 == flag) {
-          tok = read_from;
-          if (HTTP_AS_INT == *reinterpret_cast<int *>(tok)) {
-            tok += 4;
-            if (':' == *tok) {
-              scheme = SCHEME_HTTP;
-              tok += 3;
-              tok_len = strlen(tok) + 7;
-            } else if ('s' == *tok) {
-              scheme = SCHEME_HTTPS;
-              tok += 4;
-              tok_len = strlen(tok) + 8;
-            } else
-              tok_len = strlen(tok) + 4;
-          } else {
-            if ('/' == *tok)
-              scheme = SCHEME_NONE;
-            tok_len = strlen(tok);
-          }
-          if ('/' == *tok) // This is to handle crazy stuff like http:///origin.com
-            tok++;
-          ptr = strchr(tok, '/');
-          if (ptr && !summary) { // Find the origin
-            *ptr = '\0';
-
-            // TODO: If we save state (struct) for a run, we probably need to always
-            // update the origin data, no matter what the origin_set is.
-            if (origin_set->empty() || (origin_set->find(tok) != origin_set->end())) {
-              o_iter = origins.find(tok);
-              if (origins.end() == o_iter) {
-                o_stats = (OriginStats *)ats_malloc(sizeof(OriginStats));
-                memset(o_stats, 0, sizeof(OriginStats));
-                init_elapsed(o_stats);
-                o_server = ats_strdup(tok);
-                if (o_stats && o_server) {
-                  o_stats->server = o_server;
-                  origins[o_server] = o_stats;
-                }
-              } else
-                o_stats = o_iter->second;
-            }
-          }
-        } else {
-          // No method given
-          if ('/' == *read_from)
-            scheme = SCHEME_NONE;
-          tok_len = strlen(read_from);
-        }
-        read_from += LogAccess::round_strlen(tok_len + 1);
-
-        // Update the stats so far, since now we have the Origin (maybe)
-        update_results_elapsed(&totals, result, elapsed, size);
-        update_codes(&totals, http_code, size);
-        update_methods(&totals, method, size);
-        update_schemes(&totals, scheme, size);
-        update_counter(totals.total, size);
-        if (o_stats != NULL) {
-          update_results_elapsed(o_stats, result, elapsed, size);
-          update_codes(o_stats, http_code, size);
-          update_methods(o_stats, method, size);
-          update_schemes(o_stats, scheme, size);
-          update_counter(o_stats->total, size);
-        }
+        o_stats = update_url(read_from, flag, summary, method, result, http_code, size, elapsed);
+        read_from += LogAccess::strlen(read_from);
         break;
 
       case P_STATE_RFC931:
         state = P_STATE_HIERARCHY;
-        if ('-' == *read_from)
-          read_from += LogAccess::round_strlen(1 + 1);
-        else
-          read_from += LogAccess::strlen(read_from);
+        read_from += LogAccess::strlen(read_from);
         break;
 
       case P_STATE_HIERARCHY:
         state = P_STATE_PEER;
-        hier = *((int64_t *)(read_from));
-        switch (hier) {
-        case SQUID_HIER_NONE:
-          update_counter(totals.hierarchies.none, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->hierarchies.none, size);
-          break;
-        case SQUID_HIER_DIRECT:
-          update_counter(totals.hierarchies.direct, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->hierarchies.direct, size);
-          break;
-        case SQUID_HIER_SIBLING_HIT:
-          update_counter(totals.hierarchies.sibling, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->hierarchies.sibling, size);
-          break;
-        case SQUID_HIER_PARENT_HIT:
-          update_counter(totals.hierarchies.parent, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->hierarchies.direct, size);
-          break;
-        case SQUID_HIER_EMPTY:
-          update_counter(totals.hierarchies.empty, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->hierarchies.empty, size);
-          break;
-        default:
-          if ((hier >= SQUID_HIER_EMPTY) && (hier < SQUID_HIER_INVALID_ASSIGNED_CODE)) {
-            update_counter(totals.hierarchies.other, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->hierarchies.other, size);
-          } else {
-            update_counter(totals.hierarchies.invalid, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->hierarchies.invalid, size);
-          }
-          break;
-        }
+        update_hierarchy(o_stats, *((int64_t *)(read_from)), size);
         read_from += INK_MIN_ALIGN;
         break;
 
       case P_STATE_PEER:
         state = P_STATE_TYPE;
-        if ('-' == *read_from)
-          read_from += LogAccess::round_strlen(1 + 1);
-        else
-          read_from += LogAccess::strlen(read_from);
+        read_from += LogAccess::strlen(read_from);
         break;
 
       case P_STATE_TYPE:
         state = P_STATE_END;
-        if (IMAG_AS_INT == *reinterpret_cast<int *>(read_from)) {
-          update_counter(totals.content.image.total, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.image.total, size);
-          tok = read_from + 6;
-          switch (*reinterpret_cast<int *>(tok)) {
-          case JPEG_AS_INT:
-            tok_len = 10;
-            update_counter(totals.content.image.jpeg, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.jpeg, size);
-            break;
-          case JPG_AS_INT:
-            tok_len = 9;
-            update_counter(totals.content.image.jpeg, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.jpeg, size);
-            break;
-          case GIF_AS_INT:
-            tok_len = 9;
-            update_counter(totals.content.image.gif, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.gif, size);
-            break;
-          case PNG_AS_INT:
-            tok_len = 9;
-            update_counter(totals.content.image.png, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.png, size);
-            break;
-          case BMP_AS_INT:
-            tok_len = 9;
-            update_counter(totals.content.image.bmp, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.bmp, size);
-            break;
-          default:
-            tok_len = 6 + strlen(tok);
-            update_counter(totals.content.image.other, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.image.other, size);
-            break;
-          }
-        } else if (TEXT_AS_INT == *reinterpret_cast<int *>(read_from)) {
-          tok = read_from + 5;
-          update_counter(totals.content.text.total, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.text.total, size);
-          switch (*reinterpret_cast<int *>(tok)) {
-          case JAVA_AS_INT:
-            // TODO verify if really "javascript"
-            tok_len = 15;
-            update_counter(totals.content.text.javascript, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.javascript, size);
-            break;
-          case CSS_AS_INT:
-            tok_len = 8;
-            update_counter(totals.content.text.css, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.css, size);
-            break;
-          case XML_AS_INT:
-            tok_len = 8;
-            update_counter(totals.content.text.xml, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.xml, size);
-            break;
-          case HTML_AS_INT:
-            tok_len = 9;
-            update_counter(totals.content.text.html, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.html, size);
-            break;
-          case PLAI_AS_INT:
-            tok_len = 10;
-            update_counter(totals.content.text.plain, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.plain, size);
-            break;
-          default:
-            tok_len = 5 + strlen(tok);
-            ;
-            update_counter(totals.content.text.other, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.text.other, size);
-            break;
-          }
-        } else if (0 == strncmp(read_from, "application", 11)) {
-          tok = read_from + 12;
-          update_counter(totals.content.application.total, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.application.total, size);
-          switch (*reinterpret_cast<int *>(tok)) {
-          case ZIP_AS_INT:
-            tok_len = 15;
-            update_counter(totals.content.application.zip, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.application.zip, size);
-            break;
-          case JAVA_AS_INT:
-            update_counter(totals.content.application.javascript, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.application.javascript, size);
-          case X_JA_AS_INT:
-            tok_len = 24;
-            update_counter(totals.content.application.javascript, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.application.javascript, size);
-            break;
-          case RSSp_AS_INT:
-            if (0 == strcmp(tok + 4, "xml")) {
-              tok_len = 19;
-              update_counter(totals.content.application.rss_xml, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.rss_xml, size);
-            } else if (0 == strcmp(tok + 4, "atom")) {
-              tok_len = 20;
-              update_counter(totals.content.application.rss_atom, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.rss_atom, size);
-            } else {
-              tok_len = 12 + strlen(tok);
-              update_counter(totals.content.application.rss_other, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.rss_other, size);
-            }
-            break;
-          default:
-            if (0 == strcmp(tok, "x-shockwave-flash")) {
-              tok_len = 29;
-              update_counter(totals.content.application.shockwave_flash, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.shockwave_flash, size);
-            } else if (0 == strcmp(tok, "x-quicktimeplayer")) {
-              tok_len = 29;
-              update_counter(totals.content.application.quicktime, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.quicktime, size);
-            } else {
-              tok_len = 12 + strlen(tok);
-              update_counter(totals.content.application.other, size);
-              if (o_stats != NULL)
-                update_counter(o_stats->content.application.other, size);
-            }
-          }
-        } else if (0 == strncmp(read_from, "audio", 5)) {
-          tok = read_from + 6;
-          tok_len = 6 + strlen(tok);
-          update_counter(totals.content.audio.total, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.audio.total, size);
-          if ((0 == strcmp(tok, "x-wav")) || (0 == strcmp(tok, "wav"))) {
-            update_counter(totals.content.audio.wav, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.audio.wav, size);
-          } else if ((0 == strcmp(tok, "x-mpeg")) || (0 == strcmp(tok, "mpeg"))) {
-            update_counter(totals.content.audio.mpeg, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.audio.mpeg, size);
-          } else {
-            update_counter(totals.content.audio.other, size);
-            if (o_stats != NULL)
-              update_counter(o_stats->content.audio.other, size);
-          }
-        } else if ('-' == *read_from) {
-          tok_len = 1;
-          update_counter(totals.content.none, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.none, size);
-        } else {
-          tok_len = strlen(read_from);
-          update_counter(totals.content.other, size);
-          if (o_stats != NULL)
-            update_counter(o_stats->content.other, size);
-        }
-        read_from += LogAccess::round_strlen(tok_len + 1);
+        update_content_type(o_stats, read_from, size);
+        read_from += LogAccess::strlen(read_from);
         flag = 0; // We exited this state without errors
         break;
 
@@ -1593,6 +1590,65 @@ parse_log_buff(LogBufferHeader *buf_header, bool summary = false)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Parse a columnar block. The columns parse_log_buff() looks at are decoded,
+// and scanned one record at a time without building rows.
+int
+parse_columnar_buff(LogColumnarHeader *col_header, bool summary = false)
+{
+  LogColumnarReader reader(col_header);
+
+  if (!reader.valid()) {
+    Debug("logstats", "Invalid columnar block.");
+    return 1;
+  }
+  reader.select("ttms,crc,pssc,psql,cqhm,cquc,phr,psct");
+
+  int i_crc = reader.field_index("crc");
+  int i_pssc = reader.field_index("pssc");
+  const int64_t *ttms = reader.int_field(reader.field_index("ttms"));
+  const int64_t *crc = reader.int_field(i_crc);
+  const int64_t *pssc = reader.int_field(i_pssc);
+  const int64_t *psql = reader.int_field(reader.field_index("psql"));
+  const int64_t *phr = reader.int_field(reader.field_index("phr"));
+  const char *const *cqhm = reader.string_field(reader.field_index("cqhm"));
+  const char *const *cquc = reader.string_field(reader.field_index("cquc"));
+  const char *const *psct = reader.string_field(reader.field_index("psct"));
+
+  if (!ttms || !crc || !pssc || !psql || !phr || !cqhm || !cquc || !psct) {
+    Debug("logstats", "Failed to decode columnar block.");
+    return 1;
+  }
+
+  // A record with a bad result or status code counts a parse error for
+  // every field which follows, as in parse_log_buff().
+  int crc_errors = reader.field_count() - i_crc - 1;
+  int pssc_errors = reader.field_count() - i_pssc - 1;
+
+  for (unsigned i = 0; i < reader.entry_count(); ++i) {
+    int result = crc[i], http_code = pssc[i], size = psql[i], elapsed = ttms[i];
+    int flag;
+
+    if ((result < 32) || (result > 255)) {
+      parse_errors += crc_errors;
+      continue;
+    }
+    if ((http_code < 0) || (http_code > 999)) {
+      parse_errors += pssc_errors;
+      continue;
+    }
+
+    HTTPMethod method = parse_method(cqhm[i], &flag);
+    OriginStats *o_stats = update_url(cquc[i], flag, summary, method, result, http_code, size, elapsed);
+
+    update_hierarchy(o_stats, phr[i], size);
+    update_content_type(o_stats, psct[i], size);
+  }
+
+  return 0;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Process a file (FD)
 int
@@ -1627,7 +1683,7 @@ process_file(int in_fd, off_t offset, unsigned max_age)
           return 0;
         }
         // ensure that this is a valid logbuffer header
-        if (header->cookie && (LOG_SEGMENT_COOKIE == header->cookie)) {
+        if (header->cookie && (LOG_SEGMENT_COOKIE == header->cookie || LOG_COLUMNAR_COOKIE == header->cookie)) {
           offset = 0;
           break;
         }
@@ -1642,18 +1698,23 @@ process_file(int in_fd, off_t offset, unsigned max_age)
         return 0;
 
       // ensure that this is a valid logbuffer header
-      if (header->cookie != LOG_SEGMENT_COOKIE) {
+      if (header->cookie != LOG_SEGMENT_COOKIE && header->cookie != LOG_COLUMNAR_COOKIE) {
         Debug("logstats", "Invalid segment cookie (expected %d, got %d)", LOG_SEGMENT_COOKIE, header->cookie);
         return 1;
       }
     }
 
-    Debug("logstats", "LogBuffer version %d, current = %d", header->version, LOG_SEGMENT_VERSION);
-    if (header->version != LOG_SEGMENT_VERSION)
+    // Columnar blocks share the leading words of the LogBufferHeader
+    bool columnar = (LOG_COLUMNAR_COOKIE == header->cookie);
+    unsigned header_size = columnar ? sizeof(LogColumnarHeader) : sizeof(LogBufferHeader);
+
+    Debug("logstats", "LogBuffer version %d, current = %d", header->version,
+          columnar ? LOG_COLUMNAR_VERSION : LOG_SEGMENT_VERSION);
+    if (header->version != (columnar ? LOG_COLUMNAR_VERSION : LOG_SEGMENT_VERSION))
       return 1;
 
     // read the rest of the header
-    unsigned second_read_size = sizeof(LogBufferHeader) - first_read_size;
+    unsigned second_read_size = header_size - first_read_size;
     nread = read(in_fd, &buffer[first_read_size], second_read_size);
     if (!nread || EOF == nread) {
       Debug("logstats", "Second read of header failed (attemped %d bytes at offset %d, got nothing), errno=%d.", second_read_size,
@@ -1667,8 +1728,8 @@ process_file(int in_fd, off_t offset, unsigned max_age)
       return 1;
     }
 
-    buffer_bytes = header->byte_count - sizeof(LogBufferHeader);
-    if (buffer_bytes <= 0 || (unsigned int)buffer_bytes > (sizeof(buffer) - sizeof(LogBufferHeader))) {
+    buffer_bytes = header->byte_count - header_size;
+    if (buffer_bytes <= 0 || (unsigned int)buffer_bytes > (sizeof(buffer) - header_size)) {
       Debug("logstats", "Buffer payload [%d] is wrong.", buffer_bytes);
       return 1;
     }
@@ -1677,7 +1738,7 @@ process_file(int in_fd, off_t offset, unsigned max_age)
     int total_read = 0;
     int read_tries_remaining = MAX_READ_TRIES; // since the data will be old anyway, let's only try a few times.
     do {
-      nread = read(in_fd, &buffer[sizeof(LogBufferHeader) + total_read], buffer_bytes - total_read);
+      nread = read(in_fd, &buffer[header_size + total_read], buffer_bytes - total_read);
       if (EOF == nread || !nread) { // just bail on error
         Debug("logstats", "Read failed while reading log buffer, wanted %d bytes, nread=%d, errno=%d", buffer_bytes - total_read,
               nread, errno);
@@ -1701,7 +1762,17 @@ process_file(int in_fd, off_t offset, unsigned max_age)
     } while (total_read < buffer_bytes);
 
     // Possibly skip too old entries (the entire buffer is skipped)
-    if (header->high_timestamp >= max_age) {
+    if (columnar) {
+      LogColumnarHeader *col_header = (LogColumnarHeader *)header;
+      if (col_header->high_timestamp >= max_age) {
+        if (parse_columnar_buff(col_header, cl.summary != 0) != 0) {
+          Debug("logstats", "Failed to parse columnar log buffer.");
+          return 1;
+        }
+      } else {
+        Debug("logstats", "Skipping old buffer (age=%d, max=%d)", col_header->high_timestamp, max_age);
+      }
+    } else if (header->high_timestamp >= max_age) {
       if (parse_log_buff(header, cl.summary != 0) != 0) {
         Debug("logstats", "Failed to parse log buffer.");
         return 1;